@@ -490,6 +490,15 @@ void LLCharacter::addVisualParam(LLVisualParam *param)
 //-----------------------------------------------------------------------------
 void LLCharacter::updateVisualParams()
 {
+	applyChangedVisualParams();
+}
+
+//-----------------------------------------------------------------------------
+// applyChangedVisualParams()
+//-----------------------------------------------------------------------------
+S32 LLCharacter::applyChangedVisualParams()
+{
+	S32 num_applied = 0;
 	for (LLVisualParam *param = getFirstVisualParam(); 
 		param;
 		param = getNextVisualParam())
@@ -503,8 +512,10 @@ void LLCharacter::updateVisualParams()
 		if (effective_weight != param->getLastWeight())
 		{
 			param->apply( mSex );
+			num_applied++;
 		}
 	}
+	return num_applied;
 }
  
 LLAnimPauseRequest LLCharacter::requestPause()
@@ -130,6 +130,10 @@ public:
 	// updates all visual parameters for this character
 	virtual void updateVisualParams();
 
+	// applies the visual parameters whose effective weight has changed,
+	// and returns how many there were
+	S32 applyChangedVisualParams();
+
 	virtual void addDebugText( const std::string& text ) = 0;
 
 	virtual const LLUUID&	getID() = 0;
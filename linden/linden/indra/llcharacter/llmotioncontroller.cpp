@@ -46,11 +46,18 @@
 
 const S32 NUM_JOINT_SIGNATURE_STRIDES = LL_CHARACTER_MAX_JOINTS / 4;
 const U32 MAX_MOTION_INSTANCES = 32;
+const S32 TIME_STEP_LEVELS = 4;
 
 //-----------------------------------------------------------------------------
 // Constants and statics
 //-----------------------------------------------------------------------------
 LLMotionRegistry LLMotionController::sRegistry;
+F32 LLMotionController::sMaxTimeStep = 0.25f;
+F32 LLMotionController::sFullRateDistance = 32.f;
+F32 LLMotionController::sMinRateDistance = 96.f;
+S32 LLMotionController::sMotionBudget = 0;
+S32 LLMotionController::sMotionsUpdated = 0;
+S32 LLMotionController::sUpdatesDeferred = 0;
 
 //-----------------------------------------------------------------------------
 //-----------------------------------------------------------------------------
@@ -136,6 +143,7 @@ LLMotionController::LLMotionController()
 	: mTimeFactor(1.f),
 	  mCharacter(NULL),
 	  mAnimTime(0.f),
+	  mQuantumTime(0.f),
 	  mPrevTimerElapsed(0.f),
 	  mLastTime(0.0f),
 	  mHasRunOnce(FALSE),
@@ -143,7 +151,9 @@ LLMotionController::LLMotionController()
 	  mPauseTime(0.f),
 	  mTimeStep(0.f),
 	  mTimeStepCount(0),
-	  mLastInterp(0.f)
+	  mLastInterp(0.f),
+	  mBudgeted(FALSE),
+	  mUpdatesDeferred(0)
 {
 }
 
@@ -283,6 +293,63 @@ void LLMotionController::setTimeStep(F32 step)
 	}
 }
 
+//-----------------------------------------------------------------------------
+// calcTimeStep()
+//-----------------------------------------------------------------------------
+// static
+F32 LLMotionController::calcTimeStep(S32 num_characters, F32 pixel_area, F32 distance)
+{
+	if (sMaxTimeStep <= 0.f)
+	{
+		return 0.f;
+	}
+	F32 crowd_scale = clamp_rescale((F32)num_characters, 10.f, 35.f, 0.f, 1.f);
+	F32 pixel_area_scale = clamp_rescale(pixel_area, 100.f, 5000.f, 1.f, 0.f);
+	F32 distance_scale = clamp_rescale(distance, sFullRateDistance, sMinRateDistance, 0.f, 1.f);
+	F32 time_step = sMaxTimeStep * crowd_scale * llmax(pixel_area_scale, distance_scale);
+	// A few steps only, a step that changes every frame would start a new
+	// time quantum every frame.
+	return llround(time_step, sMaxTimeStep / (F32)TIME_STEP_LEVELS);
+}
+
+//-----------------------------------------------------------------------------
+// setTimeStepLimits()
+//-----------------------------------------------------------------------------
+// static
+void LLMotionController::setTimeStepLimits(F32 max_time_step, F32 full_rate_distance, F32 min_rate_distance)
+{
+	sMaxTimeStep = llmax(max_time_step, 0.f);
+	sFullRateDistance = llmax(full_rate_distance, 0.f);
+	sMinRateDistance = llmax(min_rate_distance, sFullRateDistance + 1.f);
+}
+
+//-----------------------------------------------------------------------------
+// startFrame()
+//-----------------------------------------------------------------------------
+// static
+void LLMotionController::startFrame()
+{
+	sMotionsUpdated = 0;
+	sUpdatesDeferred = 0;
+}
+
+//-----------------------------------------------------------------------------
+// deferUpdate()
+//-----------------------------------------------------------------------------
+BOOL LLMotionController::deferUpdate(bool force_update)
+{
+	if (force_update || !mBudgeted || !mHasRunOnce || !sMotionBudget
+		|| sMotionsUpdated < sMotionBudget || mUpdatesDeferred >= MAX_DEFERRED_UPDATES)
+	{
+		mUpdatesDeferred = 0;
+		sMotionsUpdated += (S32)mActiveMotions.size();
+		return FALSE;
+	}
+	mUpdatesDeferred++;
+	sUpdatesDeferred++;
+	return TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // setTimeFactor()
 //-----------------------------------------------------------------------------
@@ -818,7 +885,7 @@ void LLMotionController::updateMotions(bool force_update)
 	// Update timing info for this time step.
 	if (!mPaused)
 	{
-		F32 update_time = mAnimTime + delta_time * mTimeFactor;
+		F32 update_time = mQuantumTime + delta_time * mTimeFactor;
 		if (use_quantum)
 		{
 			F32 time_interval = fmodf(update_time, mTimeStep);
@@ -828,11 +895,17 @@ void LLMotionController::updateMotions(bool force_update)
 			if (quantum_count == mTimeStepCount)
 			{
 				// we're still in same time quantum as before, so just interpolate and exit
+				mQuantumTime = update_time;
 				if (!mPaused)
 				{
+					// The joints are mLastInterp of the way to the cached
+					// pose, take them on to interp of the way there.
 					F32 interp = time_interval / mTimeStep;
-					mPoseBlender.interpolate(interp - mLastInterp);
-					mLastInterp = interp;
+					if (mLastInterp < 1.f && interp > mLastInterp)
+					{
+						mPoseBlender.interpolate((interp - mLastInterp) / (1.f - mLastInterp));
+						mLastInterp = interp;
+					}
 				}
 
 				updateLoadingMotions();
@@ -841,15 +914,31 @@ void LLMotionController::updateMotions(bool force_update)
 			
 			// is calculating a new keyframe pose, make sure the last one gets applied
 			mPoseBlender.interpolate(1.f);
+			mLastInterp = 1.f;
+
+			if (deferUpdate(force_update))
+			{
+				// Hold the pose until there is budget, the time carries over.
+				mPrevTimerElapsed -= delta_time;
+				updateLoadingMotions();
+				return;
+			}
 			clearBlenders();
 
+			mQuantumTime = update_time;
 			mTimeStepCount = quantum_count;
 			mAnimTime = (F32)quantum_count * mTimeStep;
 			mLastInterp = 0.f;
 		}
 		else
 		{
-			mAnimTime = update_time;
+			if (deferUpdate(force_update))
+			{
+				mPrevTimerElapsed -= delta_time;
+				updateLoadingMotions();
+				return;
+			}
+			mAnimTime = mQuantumTime = update_time;
 		}
 	}
 
@@ -157,6 +157,31 @@ public:
 
 	void setTimeStep(F32 step);
 
+	// Returns the time step for a character distance meters from the
+	// camera that covers pixel_area pixels, with num_characters around.
+	// That is 0, for an update every frame, unless there is a crowd, in
+	// which case small or distant characters step up to the max time step.
+	// Poses are interpolated in between.
+	static F32 calcTimeStep(S32 num_characters, F32 pixel_area, F32 distance);
+	static void setTimeStepLimits(F32 max_time_step, F32 full_rate_distance, F32 min_rate_distance);
+
+	// A frame wide budget on the motions updated, shared by the
+	// controllers that are budgeted. A budgeted controller that finds the
+	// budget spent holds its last pose and tries again the next frame,
+	// though never more than MAX_DEFERRED_UPDATES frames running. 0 for no
+	// budget.
+	enum { MAX_DEFERRED_UPDATES = 3 };
+	static void setMotionBudget(S32 max_motions)	{ sMotionBudget = max_motions; }
+	static S32 getMotionBudget()					{ return sMotionBudget; }
+	// Call once a frame, before the characters update.
+	static void startFrame();
+	// Motions updated and updates put off so far this frame.
+	static S32 getMotionsUpdated()					{ return sMotionsUpdated; }
+	static S32 getUpdatesDeferred()					{ return sUpdatesDeferred; }
+
+	void setBudgeted(BOOL budgeted)					{ mBudgeted = budgeted; }
+	BOOL isBudgeted() const							{ return mBudgeted; }
+
 	void setTimeFactor(F32 time_factor);
 	F32 getTimeFactor() { return mTimeFactor; }
 
@@ -186,6 +211,8 @@ protected:
 	void updateIdleActiveMotions();
 	void purgeExcessMotions();
 	void deactivateStoppedMotions();
+	// Whether to put off a full update for being over budget.
+	BOOL deferUpdate(bool force_update);
 
 protected:
 	F32					mTimeFactor;
@@ -213,6 +240,7 @@ protected:
 	LLFrameTimer		mTimer;
 	F32					mPrevTimerElapsed;
 	F32					mAnimTime;
+	F32					mQuantumTime;	// mAnimTime runs ahead of it with a time step
 	F32					mLastTime;
 	BOOL				mHasRunOnce;
 	BOOL				mPaused;
@@ -220,8 +248,17 @@ protected:
 	F32					mTimeStep;
 	S32					mTimeStepCount;
 	F32					mLastInterp;
+	BOOL				mBudgeted;
+	S32					mUpdatesDeferred;	// in a row
 
 	U8					mJointSignature[2][LL_CHARACTER_MAX_JOINTS];
+
+	static F32			sMaxTimeStep;
+	static F32			sFullRateDistance;
+	static F32			sMinRateDistance;
+	static S32			sMotionBudget;
+	static S32			sMotionsUpdated;
+	static S32			sUpdatesDeferred;
 };
 
 //-----------------------------------------------------------------------------
@@ -42,6 +42,7 @@
 #include "lljointstate.h"
 #include "lljoint.h"
 #include <map>
+#include <vector>
 
 
 //-----------------------------------------------------------------------------
@@ -102,6 +103,7 @@ public:
 
 public:
 	LLJoint mJointCache;
+	BOOL mIsActive;		// on LLPoseBlender's active list
 };
 
 class LLMotion;
@@ -109,7 +111,9 @@ class LLMotion;
 class LLPoseBlender
 {
 protected:
-	typedef std::list<LLJointStateBlender*> blender_list_t;
+	// Kept from frame to frame, so the blend pass allocates nothing once
+	// every joint has been animated.
+	typedef std::vector<LLJointStateBlender*> blender_list_t;
 	typedef std::map<LLJoint*,LLJointStateBlender*> blender_map_t;
 	blender_map_t mJointStateBlenderPool;
 	blender_list_t mActiveBlenders;
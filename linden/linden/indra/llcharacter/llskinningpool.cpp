@@ -0,0 +1,337 @@
+/**
+ * @file llskinningpool.cpp
+ * @brief Joint updates and software skinning for many avatars at once, on worker threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llskinningpool.h"
+
+#include "llfasttimer.h"
+#include "llmath.h"
+#include "llthread.h"
+
+static LLFastTimer::DeclareTimer FTM_SKIN_JOINTS("Avatar Joints");
+static LLFastTimer::DeclareTimer FTM_SKIN_MESHES("Avatar Skinning");
+
+//----------------------------------------------------------------------------
+
+LLSkinJob::LLSkinJob()
+	: mNumJoints(0),
+	  mWeights(NULL),
+	  mCoords(NULL),
+	  mNormals(NULL),
+	  mNumVertices(0)
+{
+}
+
+//----------------------------------------------------------------------------
+
+class LLSkinningPool::Worker : public LLThread
+{
+public:
+	Worker(LLSkinningPool* pool)
+		: LLThread("Skinning"),
+		  mPool(pool)
+	{
+	}
+
+	/*virtual*/ void run()
+	{
+		mPool->workerLoop();
+	}
+
+private:
+	LLSkinningPool* mPool;
+};
+
+//----------------------------------------------------------------------------
+
+LLSkinningPool::LLSkinningPool(S32 num_threads)
+	: mStage(STAGE_JOINTS),
+	  mCount(0),
+	  mNext(0),
+	  mGeneration(0),
+	  mQuit(FALSE),
+	  mBusy(0)
+{
+	mWake = new LLCondition;
+	mDone = new LLCondition;
+	for (S32 i = 0; i < num_threads; i++)
+	{
+		Worker* worker = new Worker(this);
+		mThreads.push_back(worker);
+		worker->start();
+	}
+}
+
+LLSkinningPool::~LLSkinningPool()
+{
+	mWake->lock();
+	mQuit = TRUE;
+	mWake->broadcast();
+	mWake->unlock();
+
+	BOOL stopped = TRUE;
+	for (std::vector<Worker*>::iterator iter = mThreads.begin(); iter != mThreads.end(); ++iter)
+	{
+		if ((*iter)->stopAndWait(1000))
+		{
+			delete *iter;
+		}
+		else
+		{
+			stopped = FALSE;
+		}
+	}
+	mThreads.clear();
+
+	// A worker that didn't stop still has hold of the conditions.
+	if (stopped)
+	{
+		delete mDone;
+		delete mWake;
+	}
+}
+
+void LLSkinningPool::addJoints(LLJoint* root)
+{
+	mJoints.push_back(root);
+}
+
+void LLSkinningPool::addMesh(const LLSkinJob& job)
+{
+	mMeshes.push_back(job);
+}
+
+void LLSkinningPool::run()
+{
+	if (!mJoints.empty())
+	{
+		runStage(STAGE_JOINTS, (S32)mJoints.size());
+		mJoints.clear();
+	}
+	if (!mMeshes.empty())
+	{
+		runStage(STAGE_MESHES, (S32)mMeshes.size());
+		mMeshes.clear();
+	}
+}
+
+void LLSkinningPool::runStage(EStage stage, S32 count)
+{
+	mStage = stage;
+	mCount = count;
+	mNext = 0;
+
+	if (!mThreads.empty() && count > 1)
+	{
+		mDone->lock();
+		mBusy = (S32)mThreads.size();
+		mDone->unlock();
+
+		mWake->lock();
+		mGeneration++;
+		mWake->broadcast();
+		mWake->unlock();
+
+		work();
+
+		mDone->lock();
+		while (mBusy)
+		{
+			mDone->wait();
+		}
+		mDone->unlock();
+	}
+	else
+	{
+		work();
+	}
+}
+
+void LLSkinningPool::work()
+{
+	if (mStage == STAGE_JOINTS)
+	{
+		LLFastTimer t(FTM_SKIN_JOINTS);
+		for (S32 i = mNext++; i < mCount; i = mNext++)
+		{
+			mJoints[i]->updateWorldMatrixChildren();
+		}
+	}
+	else
+	{
+		LLFastTimer t(FTM_SKIN_MESHES);
+		for (S32 i = mNext++; i < mCount; i = mNext++)
+		{
+			skin(mMeshes[i]);
+		}
+	}
+}
+
+void LLSkinningPool::workerLoop()
+{
+	U32 generation = 0;
+	while (true)
+	{
+		mWake->lock();
+		while (mGeneration == generation && !mQuit)
+		{
+			mWake->wait();
+		}
+		generation = mGeneration;
+		BOOL quit = mQuit;
+		mWake->unlock();
+		if (quit)
+		{
+			break;
+		}
+
+		work();
+
+		// runStage() doesn't touch the job lists again until every worker
+		// has been through here.
+		mDone->lock();
+		if (--mBusy == 0)
+		{
+			mDone->signal();
+		}
+		mDone->unlock();
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// static
+void LLSkinningPool::skin(const LLSkinJob& job)
+{
+	LLMatrix4 mats[LL_CHARACTER_MAX_JOINTS];
+	LLMatrix3 rots[LL_CHARACTER_MAX_JOINTS];
+	buildPalette(job, mats, rots);
+	skinVertices(mats, rots, job.mWeights, job.mCoords, job.mNormals, job.mNumVertices,
+				 job.mVertices, job.mVertexNormals);
+}
+
+// static
+void LLSkinningPool::buildPalette(const LLSkinJob& job, LLMatrix4* mats, LLMatrix3* rots)
+{
+	llassert(job.mNumJoints <= (S32)LL_CHARACTER_MAX_JOINTS);
+	for (S32 j = 0; j < job.mNumJoints; j++)
+	{
+		mats[j] = *job.mWorldMatrices[j];
+		rots[j] = mats[j].getMat3();
+		mats[j].translate(job.mSkinOffsets[j] * rots[j]);
+	}
+}
+
+// static
+void LLSkinningPool::skinVertices(const LLMatrix4* mats, const LLMatrix3* rots,
+								  const F32* weights, const LLVector3* coords, const LLVector3* normals,
+								  U32 num_vertices, LLStrider<LLVector3> out_vertices,
+								  LLStrider<LLVector3> out_normals)
+{
+	F32 last_weight = F32_MAX;
+	LLMatrix4 blend_mat;
+	LLMatrix3 blend_rot_mat;
+
+	for (U32 index = 0; index < num_vertices; index++)
+	{
+		// blend by first matrix
+		F32 w = weights[index]; 
+		
+		// Maybe we don't have to change blend_mat.
+		// Profiles of a single-avatar scene on a Mac show this to be a very
+		// common case.  JC
+		if (w == last_weight)
+		{
+			out_vertices[index] = coords[index] * blend_mat;
+			out_normals[index] = normals[index] * blend_rot_mat;
+			continue;
+		}
+		
+		last_weight = w;
+
+		S32 joint = llfloor(w);
+		w -= joint;
+		
+		// No lerp required in this case.
+		if (w == 1.0f)
+		{
+			blend_mat = mats[joint+1];
+			out_vertices[index] = coords[index] * blend_mat;
+			blend_rot_mat = rots[joint+1];
+			out_normals[index] = normals[index] * blend_rot_mat;
+			continue;
+		}
+		
+		// Try to keep all the accesses to the matrix data as close
+		// together as possible.  This function is a hot spot on the
+		// Mac. JC
+		const LLMatrix4 &m0 = mats[joint+1];
+		const LLMatrix4 &m1 = mats[joint+0];
+		
+		blend_mat.mMatrix[VX][VX] = lerp(m1.mMatrix[VX][VX], m0.mMatrix[VX][VX], w);
+		blend_mat.mMatrix[VX][VY] = lerp(m1.mMatrix[VX][VY], m0.mMatrix[VX][VY], w);
+		blend_mat.mMatrix[VX][VZ] = lerp(m1.mMatrix[VX][VZ], m0.mMatrix[VX][VZ], w);
+
+		blend_mat.mMatrix[VY][VX] = lerp(m1.mMatrix[VY][VX], m0.mMatrix[VY][VX], w);
+		blend_mat.mMatrix[VY][VY] = lerp(m1.mMatrix[VY][VY], m0.mMatrix[VY][VY], w);
+		blend_mat.mMatrix[VY][VZ] = lerp(m1.mMatrix[VY][VZ], m0.mMatrix[VY][VZ], w);
+
+		blend_mat.mMatrix[VZ][VX] = lerp(m1.mMatrix[VZ][VX], m0.mMatrix[VZ][VX], w);
+		blend_mat.mMatrix[VZ][VY] = lerp(m1.mMatrix[VZ][VY], m0.mMatrix[VZ][VY], w);
+		blend_mat.mMatrix[VZ][VZ] = lerp(m1.mMatrix[VZ][VZ], m0.mMatrix[VZ][VZ], w);
+
+		blend_mat.mMatrix[VW][VX] = lerp(m1.mMatrix[VW][VX], m0.mMatrix[VW][VX], w);
+		blend_mat.mMatrix[VW][VY] = lerp(m1.mMatrix[VW][VY], m0.mMatrix[VW][VY], w);
+		blend_mat.mMatrix[VW][VZ] = lerp(m1.mMatrix[VW][VZ], m0.mMatrix[VW][VZ], w);
+
+		out_vertices[index] = coords[index] * blend_mat;
+		
+		const LLMatrix3 &n0 = rots[joint+1];
+		const LLMatrix3 &n1 = rots[joint+0];
+		
+		blend_rot_mat.mMatrix[VX][VX] = lerp(n1.mMatrix[VX][VX], n0.mMatrix[VX][VX], w);
+		blend_rot_mat.mMatrix[VX][VY] = lerp(n1.mMatrix[VX][VY], n0.mMatrix[VX][VY], w);
+		blend_rot_mat.mMatrix[VX][VZ] = lerp(n1.mMatrix[VX][VZ], n0.mMatrix[VX][VZ], w);
+
+		blend_rot_mat.mMatrix[VY][VX] = lerp(n1.mMatrix[VY][VX], n0.mMatrix[VY][VX], w);
+		blend_rot_mat.mMatrix[VY][VY] = lerp(n1.mMatrix[VY][VY], n0.mMatrix[VY][VY], w);
+		blend_rot_mat.mMatrix[VY][VZ] = lerp(n1.mMatrix[VY][VZ], n0.mMatrix[VY][VZ], w);
+
+		blend_rot_mat.mMatrix[VZ][VX] = lerp(n1.mMatrix[VZ][VX], n0.mMatrix[VZ][VX], w);
+		blend_rot_mat.mMatrix[VZ][VY] = lerp(n1.mMatrix[VZ][VY], n0.mMatrix[VZ][VY], w);
+		blend_rot_mat.mMatrix[VZ][VZ] = lerp(n1.mMatrix[VZ][VZ], n0.mMatrix[VZ][VZ], w);
+		
+		out_normals[index] = normals[index] * blend_rot_mat;
+	}
+}
@@ -0,0 +1,151 @@
+/**
+ * @file llskinningpool.h
+ * @brief Joint updates and software skinning for many avatars at once, on worker threads.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLSKINNINGPOOL_H
+#define LL_LLSKINNINGPOOL_H
+
+#include <vector>
+
+#include "llapr.h"
+#include "llstrider.h"
+#include "lljoint.h"
+#include "m3math.h"
+#include "m4math.h"
+#include "v3math.h"
+
+class LLCondition;
+
+// One mesh to skin: the joints it is weighted to, its bind pose and where
+// the skinned vertices go. Everything pointed at has to stay put until the
+// LLSkinningPool::run() it was queued for returns.
+struct LLSkinJob
+{
+	LLSkinJob();
+
+	// The mesh's joint palette, in the order its weights index it: the
+	// world matrix of each joint, and the skin offset (root to joint pivot)
+	// to turn the joint about.
+	S32 mNumJoints;
+	const LLMatrix4* mWorldMatrices[LL_CHARACTER_MAX_JOINTS];
+	LLVector3 mSkinOffsets[LL_CHARACTER_MAX_JOINTS];
+
+	// Bind pose. The integer part of a weight is the palette entry, the
+	// fraction how far to blend towards the next one.
+	const F32* mWeights;
+	const LLVector3* mCoords;
+	const LLVector3* mNormals;
+	U32 mNumVertices;
+
+	// Output, one per vertex.
+	LLStrider<LLVector3> mVertices;
+	LLStrider<LLVector3> mVertexNormals;
+};
+
+// Spreads joint hierarchy updates and software skinning over worker threads.
+//
+// Work is queued with addJoints() and addMesh(), and run() then does it all
+// before returning, with the calling thread taking a share. Queued joints
+// are all updated before any mesh is skinned, so a mesh may use the joints
+// queued with it. Otherwise jobs must not share anything they write:
+// updating two joint hierarchies that are connected, or skinning two meshes
+// into the same vertices, is a race.
+//
+// Queueing and run() are for one thread only, normally the main thread.
+class LLSkinningPool
+{
+public:
+	// num_threads workers are started, besides the thread calling run().
+	// With none, run() does everything itself.
+	LLSkinningPool(S32 num_threads);
+	~LLSkinningPool();
+
+	// Queues root->updateWorldMatrixChildren().
+	void addJoints(LLJoint* root);
+	// Queues skinning a mesh. The job is copied.
+	void addMesh(const LLSkinJob& job);
+
+	// Does everything queued, then empties the queues.
+	void run();
+
+	S32 getNumThreads() const			{ return (S32)mThreads.size(); }
+	S32 getNumQueued() const			{ return (S32)(mJoints.size() + mMeshes.size()); }
+
+	// Skins job on the calling thread.
+	static void skin(const LLSkinJob& job);
+
+	// Builds the blend matrices for a palette: each joint's world matrix
+	// moved to turn about its pivot, and its rotation for the normals.
+	static void buildPalette(const LLSkinJob& job, LLMatrix4* mats, LLMatrix3* rots);
+
+	// Blends mats and rots per vertex as weights say and transforms coords
+	// and normals with the result.
+	static void skinVertices(const LLMatrix4* mats, const LLMatrix3* rots,
+							 const F32* weights, const LLVector3* coords, const LLVector3* normals,
+							 U32 num_vertices, LLStrider<LLVector3> out_vertices,
+							 LLStrider<LLVector3> out_normals);
+
+private:
+	class Worker;
+	friend class Worker;
+
+	enum EStage
+	{
+		STAGE_JOINTS,
+		STAGE_MESHES
+	};
+
+	// Has the workers and the calling thread work through stage.
+	void runStage(EStage stage, S32 count);
+	// Takes jobs of the current stage until there are none left.
+	void work();
+	// What a worker does between stages.
+	void workerLoop();
+
+	std::vector<Worker*> mThreads;
+	std::vector<LLJoint*> mJoints;
+	std::vector<LLSkinJob> mMeshes;
+
+	// The stage being worked on. Set under mWake, read by the workers once
+	// it has woken them.
+	EStage mStage;
+	S32 mCount;
+	LLAtomicS32 mNext;			// next job to take
+
+	LLCondition* mWake;			// guards mGeneration and mQuit
+	U32 mGeneration;			// bumped for every stage
+	BOOL mQuit;
+	LLCondition* mDone;			// guards mBusy
+	S32 mBusy;					// workers still on the current stage
+};
+
+#endif // LL_LLSKINNINGPOOL_H
@@ -0,0 +1,511 @@
+/**
+ * @file llmotioncontroller_test.cpp
+ * @brief LLMotionController update budget tests and crowd benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../llmotioncontroller.h"
+#include "../llcharacter.h"
+#include "../llhandmotion.h"
+#include "../llkeyframemotion.h"
+#include "../test/lltut.h"
+
+#include "lldatapacker.h"
+#include "llframetimer.h"
+#include "llquantize.h"
+#include "lltimer.h"
+#include "llxmltree.h"
+
+namespace
+{
+	const S32 NUM_CHARACTERS = 300;
+	const S32 NUM_FRAMES = 150;
+	const F32 FRAME_TIME = 1.f / 30.f;
+	const S32 NUM_KEYS = 9;
+
+	// Each character plays one animation of each layer, on top of each other.
+	enum { LOCOMOTION, GESTURE, LOOK, NUM_LAYERS };
+	const S32 NUM_VARIANTS = 2;
+
+	std::string character_dir()
+	{
+		std::string dir(__FILE__);
+		dir.erase(dir.find_last_of("/\\") + 1);
+		return dir + "../../newview/character/";
+	}
+
+	// The motion controllers keep time with LLFrameTimer.
+	class FrameClock : public LLFrameTimer
+	{
+	public:
+		static void advance(F32 seconds)	{ sFrameTime += seconds; }
+	};
+
+	LLUUID animation_id(S32 layer, S32 variant)
+	{
+		LLUUID id;
+		id.mData[0] = (U8)(layer + 1);
+		id.mData[1] = (U8)(variant + 1);
+		id.mData[15] = 0xa;
+		return id;
+	}
+
+	BOOL animates(S32 layer, const std::string& joint_name)
+	{
+		switch (layer)
+		{
+		case GESTURE:
+			return joint_name.find("Collar") != std::string::npos
+				|| joint_name.find("Shoulder") != std::string::npos
+				|| joint_name.find("Elbow") != std::string::npos
+				|| joint_name.find("Wrist") != std::string::npos;
+		case LOOK:
+			return joint_name == "mNeck" || joint_name == "mHead";
+		default:
+			return TRUE;
+		}
+	}
+
+	// A looping animation in the format LLKeyframeMotion::serialize()
+	// writes, every joint of the layer swinging back and forth.
+	S32 make_animation(S32 layer, S32 variant, const std::vector<std::string>& joint_names,
+					   U8* buffer, S32 size)
+	{
+		LLDataPackerBinaryBuffer dp(buffer, size);
+		F32 duration = 1.f + 0.5f * variant + 0.25f * layer;
+		std::vector<std::string> names;
+		for (S32 i = 0; i < (S32)joint_names.size(); i++)
+		{
+			if (animates(layer, joint_names[i]))
+			{
+				names.push_back(joint_names[i]);
+			}
+		}
+
+		dp.packU16(KEYFRAME_MOTION_VERSION, "version");
+		dp.packU16(KEYFRAME_MOTION_SUBVERSION, "sub_version");
+		dp.packS32(layer + 1, "base_priority");
+		dp.packF32(duration, "duration");
+		dp.packString(std::string(), "emote_name");
+		dp.packF32(0.f, "loop_in_point");
+		dp.packF32(duration, "loop_out_point");
+		dp.packS32(1, "loop");
+		dp.packF32(0.3f, "ease_in_duration");
+		dp.packF32(0.3f, "ease_out_duration");
+		dp.packU32(LLHandMotion::HAND_POSE_RELAXED, "hand_pose");
+		dp.packU32((U32)names.size(), "num_joints");
+		for (S32 j = 0; j < (S32)names.size(); j++)
+		{
+			dp.packString(names[j], "joint_name");
+			dp.packS32(layer + 1, "joint_priority");
+			dp.packS32(NUM_KEYS, "num_rot_keys");
+			LLVector3 axis((F32)(j % 3 == 0), (F32)(j % 3 == 1), (F32)(j % 3 == 2));
+			for (S32 k = 0; k < NUM_KEYS; k++)
+			{
+				F32 phase = F_TWO_PI * (F32)k / (F32)(NUM_KEYS - 1);
+				F32 angle = 0.4f * sinf(phase + 0.7f * j + variant);
+				dp.packU16(F32_to_U16(duration * k / (NUM_KEYS - 1), 0.f, duration), "time");
+				LLVector3 rot_angles = LLQuaternion(angle, axis).packToVector3();
+				dp.packU16(F32_to_U16(rot_angles.mV[VX], -1.f, 1.f), "rot_angle_x");
+				dp.packU16(F32_to_U16(rot_angles.mV[VY], -1.f, 1.f), "rot_angle_y");
+				dp.packU16(F32_to_U16(rot_angles.mV[VZ], -1.f, 1.f), "rot_angle_z");
+			}
+			if (names[j] != "mPelvis")
+			{
+				dp.packS32(0, "num_pos_keys");
+				continue;
+			}
+			dp.packS32(NUM_KEYS, "num_pos_keys");
+			for (S32 k = 0; k < NUM_KEYS; k++)
+			{
+				F32 bob = 0.05f * sinf(2.f * F_TWO_PI * (F32)k / (F32)(NUM_KEYS - 1));
+				dp.packU16(F32_to_U16(duration * k / (NUM_KEYS - 1), 0.f, duration), "time");
+				dp.packU16(F32_to_U16(0.f, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_x");
+				dp.packU16(F32_to_U16(0.f, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_y");
+				dp.packU16(F32_to_U16(bob, -LL_MAX_PELVIS_OFFSET, LL_MAX_PELVIS_OFFSET), "pos_z");
+			}
+		}
+		dp.packS32(0, "num_constraints");
+		return dp.getCurrentSize();
+	}
+
+	// An avatar_skeleton.xml skeleton, numbered as LLVOAvatar numbers its
+	// joints, without any meshes.
+	class Character : public LLCharacter
+	{
+	public:
+		Character(LLXmlTreeNode* root, S32 index)
+			: mPixelArea(10000.f)
+		{
+			mID.mData[0] = (U8)index;
+			mID.mData[1] = (U8)(index >> 8);
+			mID.mData[15] = 0xc;
+			mRoot = new LLJoint("mRoot");
+			mJoints.push_back(mRoot);
+			for (LLXmlTreeNode* node = root->getChildByName("bone"); node; node = root->getNextNamedChild())
+			{
+				addBone(node, mRoot);
+			}
+		}
+
+		~Character()
+		{
+			flushAllMotions();
+			for_each(mJoints.begin(), mJoints.end(), DeletePointer());
+		}
+
+		/*virtual*/ const char* getAnimationPrefix()		{ return "avatar"; }
+		/*virtual*/ LLJoint* getRootJoint()				{ return mRoot; }
+		/*virtual*/ LLVector3 getCharacterPosition()		{ return mRoot->getWorldPosition(); }
+		/*virtual*/ LLQuaternion getCharacterRotation()	{ return mRoot->getWorldRotation(); }
+		/*virtual*/ LLVector3 getCharacterVelocity()		{ return LLVector3::zero; }
+		/*virtual*/ LLVector3 getCharacterAngularVelocity()	{ return LLVector3::zero; }
+		/*virtual*/ void getGround(const LLVector3& in_pos, LLVector3& out_pos, LLVector3& out_norm)
+		{
+			out_pos = in_pos;
+			out_pos.mV[VZ] = 0.f;
+			out_norm = LLVector3::z_axis;
+		}
+		/*virtual*/ BOOL allocateCharacterJoints(U32 num)	{ return FALSE; }
+		/*virtual*/ LLJoint* getCharacterJoint(U32 i)		{ return i < mJoints.size() ? mJoints[i] : NULL; }
+		/*virtual*/ F32 getTimeDilation()					{ return 1.f; }
+		/*virtual*/ F32 getPixelArea() const				{ return mPixelArea; }
+		/*virtual*/ LLPolyMesh* getHeadMesh()				{ return NULL; }
+		/*virtual*/ LLPolyMesh* getUpperBodyMesh()			{ return NULL; }
+		/*virtual*/ LLVector3d getPosGlobalFromAgent(const LLVector3& position)	{ return LLVector3d(position); }
+		/*virtual*/ LLVector3 getPosAgentFromGlobal(const LLVector3d& position)	{ return LLVector3(position); }
+		/*virtual*/ void addDebugText(const std::string& text)	{ }
+		/*virtual*/ const LLUUID& getID()					{ return mID; }
+
+		void startAnimations(S32 variant)
+		{
+			for (S32 layer = 0; layer < NUM_LAYERS; layer++)
+			{
+				LLUUID id = animation_id(layer, (variant + layer) % NUM_VARIANTS);
+				registerMotion(id, LLKeyframeMotion::create);
+				startMotion(id);
+			}
+		}
+
+		// Only changes when the motions are updated, or interpolated.
+		LLQuaternion getPose()
+		{
+			return getJoint("mPelvis")->getRotation() * getJoint("mHead")->getRotation()
+				* getJoint("mShoulderLeft")->getRotation();
+		}
+
+		LLMotionController& getMotionController()			{ return mMotionController; }
+
+		LLJoint* mRoot;
+		std::vector<LLJoint*> mJoints;
+		F32 mPixelArea;
+
+	private:
+		void addBone(LLXmlTreeNode* node, LLJoint* parent)
+		{
+			std::string name;
+			LLVector3 pos, rot, scale;
+			node->getAttributeString("name", name);
+			node->getAttributeVector3("pos", pos);
+			node->getAttributeVector3("rot", rot);
+			node->getAttributeVector3("scale", scale);
+
+			LLJoint* joint = new LLJoint(name, parent);
+			joint->setJointNum((S32)mJoints.size());
+			mJoints.push_back(joint);
+			joint->setPosition(pos);
+			joint->setRotation(mayaQ(rot.mV[VX], rot.mV[VY], rot.mV[VZ], LLQuaternion::XYZ));
+			joint->setScale(scale);
+
+			for (LLXmlTreeNode* child = node->getChildByName("bone"); child; child = node->getNextNamedChild())
+			{
+				addBone(child, joint);
+			}
+		}
+
+		LLUUID mID;
+	};
+
+	// Deserializes animations into LLKeyframeDataCache, where the
+	// characters' LLKeyframeMotions find them instead of asking the asset
+	// system.
+	class AnimationLoader : public LLKeyframeMotion
+	{
+	public:
+		AnimationLoader(const LLUUID& id, LLCharacter* character)
+			: LLKeyframeMotion(id)
+		{
+			mCharacter = character;
+		}
+	};
+}
+
+namespace tut
+{
+	struct motioncontroller_test
+	{
+		motioncontroller_test()
+		{
+			mSkeleton.parseFile(character_dir() + "avatar_skeleton.xml", FALSE);
+			LLMotionController::setTimeStepLimits(0.25f, 32.f, 96.f);
+			LLMotionController::setMotionBudget(0);
+			LLMotionController::startFrame();
+		}
+
+		~motioncontroller_test()
+		{
+			for_each(mCharacters.begin(), mCharacters.end(), DeletePointer());
+			LLMotionController::setMotionBudget(0);
+		}
+
+		void makeCharacters(S32 count, S32 num_variants = NUM_VARIANTS)
+		{
+			for (S32 i = 0; i < count; i++)
+			{
+				mCharacters.push_back(new Character(mSkeleton.getRoot(), i));
+			}
+			loadAnimations(mCharacters[0]);
+			for (S32 i = 0; i < count; i++)
+			{
+				mCharacters[i]->startAnimations(i % num_variants);
+			}
+		}
+
+		void loadAnimations(Character* character)
+		{
+			std::vector<std::string> joint_names;
+			for (S32 i = 1; i < (S32)character->mJoints.size(); i++)
+			{
+				joint_names.push_back(character->mJoints[i]->getName());
+			}
+			std::vector<U8> buffer(64 * 1024);
+			for (S32 layer = 0; layer < NUM_LAYERS; layer++)
+			{
+				for (S32 variant = 0; variant < NUM_VARIANTS; variant++)
+				{
+					LLUUID id = animation_id(layer, variant);
+					if (LLKeyframeDataCache::getKeyframeData(id))
+					{
+						continue;
+					}
+					S32 size = make_animation(layer, variant, joint_names, &buffer[0], (S32)buffer.size());
+					LLDataPackerBinaryBuffer dp(&buffer[0], size);
+					AnimationLoader loader(id, character);
+					ensure("animation loads", loader.deserialize(dp));
+				}
+			}
+		}
+
+		// One viewer frame: set the time steps as LLVOAvatar does, then
+		// update every character. Returns the motions updated.
+		S32 frame(BOOL rates)
+		{
+			FrameClock::advance(FRAME_TIME);
+			LLMotionController::startFrame();
+			for (S32 i = 0; i < (S32)mCharacters.size(); i++)
+			{
+				Character* character = mCharacters[i];
+				if (rates)
+				{
+					F32 distance = 5.f * (F32)(i % 40);
+					character->getMotionController().setTimeStep(
+						LLMotionController::calcTimeStep((S32)mCharacters.size(), character->mPixelArea, distance));
+				}
+				character->getMotionController().setBudgeted(TRUE);
+				character->updateMotions(LLCharacter::NORMAL_UPDATE);
+			}
+			return LLMotionController::getMotionsUpdated();
+		}
+
+		LLXmlTree mSkeleton;
+		std::vector<Character*> mCharacters;
+	};
+
+	typedef test_group<motioncontroller_test> motioncontroller_test_t;
+	typedef motioncontroller_test_t::object motioncontroller_test_object_t;
+	tut::motioncontroller_test_t tut_motioncontroller_test("motioncontroller_test");
+
+	template<> template<>
+	void motioncontroller_test_object_t::test<1>()
+	{
+		// crowds step small and distant characters, up to the max time step
+		ensure_equals("no crowd", LLMotionController::calcTimeStep(5, 50.f, 500.f), 0.f);
+		ensure_equals("near and large", LLMotionController::calcTimeStep(50, 10000.f, 10.f), 0.f);
+		ensure_equals("far", LLMotionController::calcTimeStep(50, 10000.f, 200.f), 0.25f);
+		ensure_equals("tiny", LLMotionController::calcTimeStep(50, 50.f, 10.f), 0.25f);
+		ensure_equals("halfway", LLMotionController::calcTimeStep(50, 10000.f, 64.f), 0.125f);
+		ensure_equals("small crowd", LLMotionController::calcTimeStep(20, 50.f, 200.f), 0.125f);
+		F32 last = 0.f;
+		for (F32 distance = 0.f; distance < 150.f; distance += 0.5f)
+		{
+			F32 time_step = LLMotionController::calcTimeStep(50, 10000.f, distance);
+			ensure("never shorter further away", time_step >= last);
+			ensure_equals("in quarters", fmodf(time_step, 0.0625f), 0.f);
+			last = time_step;
+		}
+
+		LLMotionController::setTimeStepLimits(0.f, 32.f, 96.f);
+		ensure_equals("disabled", LLMotionController::calcTimeStep(50, 50.f, 200.f), 0.f);
+		LLMotionController::setTimeStepLimits(0.5f, 50.f, 10.f);
+		ensure_equals("min rate distance past full rate distance",
+					  LLMotionController::calcTimeStep(50, 10000.f, 51.f), 0.5f);
+	}
+
+	template<> template<>
+	void motioncontroller_test_object_t::test<2>()
+	{
+		// the budget holds, and no character waits too long
+		const S32 count = 100;
+		const S32 budget = 150;
+		makeCharacters(count);
+		std::vector<LLQuaternion> poses(count);
+		std::vector<S32> deferred(count, 0);
+		frame(FALSE);
+		for (S32 i = 0; i < count; i++)
+		{
+			poses[i] = mCharacters[i]->getPose();
+		}
+		ensure_equals("all updated at first", LLMotionController::getUpdatesDeferred(), 0);
+
+		LLMotionController::setMotionBudget(budget);
+		S32 total_deferred = 0;
+		for (S32 f = 0; f < 40; f++)
+		{
+			// Those that waited longest go over budget.
+			S32 forced = 0;
+			for (S32 i = 0; i < count; i++)
+			{
+				forced += deferred[i] == LLMotionController::MAX_DEFERRED_UPDATES;
+			}
+			frame(FALSE);
+			S32 updated = 0;
+			for (S32 i = 0; i < count; i++)
+			{
+				LLQuaternion pose = mCharacters[i]->getPose();
+				if (pose == poses[i])
+				{
+					deferred[i]++;
+					ensure("deferred at most MAX_DEFERRED_UPDATES times running",
+						   deferred[i] <= LLMotionController::MAX_DEFERRED_UPDATES);
+				}
+				else
+				{
+					deferred[i] = 0;
+					updated++;
+				}
+				poses[i] = pose;
+			}
+			ensure_equals("deferrals counted", LLMotionController::getUpdatesDeferred(), count - updated);
+			ensure("within budget", updated - forced <= (budget + NUM_LAYERS - 1) / NUM_LAYERS);
+			total_deferred += count - updated;
+		}
+		ensure("some deferred", total_deferred > 0);
+	}
+
+	template<> template<>
+	void motioncontroller_test_object_t::test<3>()
+	{
+		// poses between updates do not depend on the frame rate
+		makeCharacters(2, 1);
+		Character* fast = mCharacters[0];
+		Character* slow = mCharacters[1];
+		fast->getMotionController().setTimeStep(0.25f);
+		slow->getMotionController().setTimeStep(0.25f);
+
+		// A few quanta in, so the pose to interpolate from is not the bind
+		// pose.
+		for (S32 i = 0; i < 20; i++)
+		{
+			FrameClock::advance(0.05f);
+			fast->updateMotions(LLCharacter::NORMAL_UPDATE);
+			slow->updateMotions(LLCharacter::NORMAL_UPDATE);
+		}
+		ensure("same start", fast->getPose() == slow->getPose());
+
+		// Into the quantum from 1.0 to 1.25, then through most of it in
+		// four frames or in one.
+		FrameClock::advance(0.01f);
+		fast->updateMotions(LLCharacter::NORMAL_UPDATE);
+		slow->updateMotions(LLCharacter::NORMAL_UPDATE);
+		LLQuaternion start = fast->getPose();
+		for (S32 i = 0; i < 4; i++)
+		{
+			FrameClock::advance(0.05f);
+			fast->updateMotions(LLCharacter::NORMAL_UPDATE);
+		}
+		slow->updateMotions(LLCharacter::NORMAL_UPDATE);
+
+		LLQuaternion fast_pose = fast->getPose();
+		LLQuaternion slow_pose = slow->getPose();
+		ensure("moved", dot(start, fast_pose) < 0.99999f);
+		for (S32 i = 0; i < 4; i++)
+		{
+			ensure_approximately_equals("same pose", fast_pose.mQ[i], slow_pose.mQ[i], 12);
+		}
+	}
+
+	template<> template<>
+	void motioncontroller_test_object_t::test<4>()
+	{
+		// a crowd at full rate, at distance based rates and with a budget on top
+		makeCharacters(NUM_CHARACTERS);
+		for (S32 i = 0; i < NUM_CHARACTERS; i++)
+		{
+			mCharacters[i]->mPixelArea = 40000.f / (F32)(1 + i % 40);
+		}
+
+		S32 updated[3];
+		F32 times[3];
+		for (S32 mode = 0; mode < 3; mode++)
+		{
+			LLMotionController::setMotionBudget(mode == 2 ? NUM_CHARACTERS * NUM_LAYERS / 4 : 0);
+			frame(mode != 0);
+			updated[mode] = 0;
+			LLTimer timer;
+			for (S32 f = 0; f < NUM_FRAMES; f++)
+			{
+				updated[mode] += frame(mode != 0);
+			}
+			times[mode] = timer.getElapsedTimeF32();
+		}
+
+		llinfos << NUM_CHARACTERS << " characters, " << NUM_FRAMES << " frames: "
+				<< updated[0] << " motion updates in " << times[0] * 1000.f / NUM_FRAMES << "ms a frame at full rate, "
+				<< updated[1] << " in " << times[1] * 1000.f / NUM_FRAMES << "ms with distance based rates, "
+				<< updated[2] << " in " << times[2] * 1000.f / NUM_FRAMES << "ms with a budget of "
+				<< LLMotionController::getMotionBudget() << " as well" << llendl;
+
+		ensure_equals("every motion every frame", updated[0], NUM_CHARACTERS * NUM_LAYERS * NUM_FRAMES);
+		ensure("rates update less", updated[1] < updated[0] / 2);
+		ensure("budget updates less", updated[2] <= updated[1]);
+	}
+}
@@ -0,0 +1,424 @@
+/**
+ * @file llskinningpool_test.cpp
+ * @brief LLSkinningPool unit tests and skinning benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../llskinningpool.h"
+#include "../test/lltut.h"
+
+#include "llendianswizzle.h"
+#include "lltimer.h"
+#include "llxmltree.h"
+#include "v2math.h"
+
+namespace
+{
+	const S32 NUM_AVATARS = 100;
+	const S32 NUM_THREADS = 4;
+	const S32 NUM_FRAMES = 20;
+
+	std::string character_dir()
+	{
+		std::string dir(__FILE__);
+		dir.erase(dir.find_last_of("/\\") + 1);
+		return dir + "../../newview/character/";
+	}
+
+	// What LLPolyMeshSharedData::loadMesh() reads of a base mesh, minus
+	// the morphs.
+	struct Mesh
+	{
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mNormals;
+		std::vector<F32> mWeights;
+		std::vector<std::string> mJointNames;
+	};
+
+	template<class T>
+	bool read_array(LLFILE* fp, std::vector<T>& data, size_t count, size_t components)
+	{
+		data.resize(count);
+		if (fread(&data[0], sizeof(T), count, fp) != count)
+		{
+			return false;
+		}
+		llendianswizzle(&data[0], sizeof(T) / components, count * components);
+		return true;
+	}
+
+	bool load_mesh(const std::string& filename, Mesh& mesh)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (!fp)
+		{
+			return false;
+		}
+		char header[24];
+		U8 has_weights = 0;
+		U8 has_detail = 0;
+		F32 position_rotation[6];
+		U8 rotation_order = 0;
+		F32 scale[3];
+		U16 num_vertices = 0;
+		bool ok = fread(header, 1, 24, fp) == 24
+			&& !strncmp(header, "Linden Binary Mesh 1.0", 22)
+			&& fread(&has_weights, 1, 1, fp) == 1
+			&& fread(&has_detail, 1, 1, fp) == 1
+			&& fread(position_rotation, 4, 6, fp) == 6
+			&& fread(&rotation_order, 1, 1, fp) == 1
+			&& fread(scale, 4, 3, fp) == 3
+			&& fread(&num_vertices, 2, 1, fp) == 1
+			&& has_weights;
+		llendianswizzle(&num_vertices, sizeof(U16), 1);
+
+		std::vector<LLVector3> binormals;
+		std::vector<LLVector2> tex_coords;
+		std::vector<U16> faces;
+		U16 num_faces = 0;
+		U16 num_joints = 0;
+		ok = ok
+			&& read_array(fp, mesh.mCoords, num_vertices, 3)
+			&& read_array(fp, mesh.mNormals, num_vertices, 3)
+			&& read_array(fp, binormals, num_vertices, 3)
+			&& read_array(fp, tex_coords, num_vertices, 2)
+			&& (!has_detail || read_array(fp, tex_coords, num_vertices, 2))
+			&& read_array(fp, mesh.mWeights, num_vertices, 1)
+			&& fread(&num_faces, 2, 1, fp) == 1;
+		llendianswizzle(&num_faces, sizeof(U16), 1);
+		ok = ok
+			&& read_array(fp, faces, num_faces * 3, 1)
+			&& fread(&num_joints, 2, 1, fp) == 1;
+		llendianswizzle(&num_joints, sizeof(U16), 1);
+		for (U16 i = 0; ok && i < num_joints; i++)
+		{
+			char name[65];
+			ok = fread(name, 64, 1, fp) == 1;
+			name[64] = '\0';
+			mesh.mJointNames.push_back(name);
+		}
+		fclose(fp);
+		return ok && !mesh.mCoords.empty();
+	}
+
+	// The weighted base meshes avatar_lad.xml names.
+	void load_meshes(std::vector<Mesh>& meshes)
+	{
+		LLXmlTree tree;
+		if (!tree.parseFile(character_dir() + "avatar_lad.xml", FALSE))
+		{
+			return;
+		}
+		std::set<std::string> loaded;
+		for (LLXmlTreeNode* node = tree.getRoot()->getChildByName("mesh");
+			 node; node = tree.getRoot()->getNextNamedChild())
+		{
+			S32 lod = 0;
+			std::string file_name;
+			node->getAttributeS32("lod", lod);
+			if (lod || !node->getAttributeString("file_name", file_name)
+				|| !loaded.insert(file_name).second)
+			{
+				continue;
+			}
+			Mesh mesh;
+			if (load_mesh(character_dir() + file_name, mesh))
+			{
+				meshes.push_back(mesh);
+			}
+		}
+	}
+
+	// An avatar_skeleton.xml skeleton, set up as LLVOAvatar::setupBone()
+	// does, in some pose of its own.
+	class Avatar
+	{
+	public:
+		Avatar(LLXmlTreeNode* root, S32 pose)
+		{
+			// Like LLVOAvatar::mRoot, above the pelvis.
+			mRoot = new LLJoint("mRoot");
+			mJoints.push_back(mRoot);
+			for (LLXmlTreeNode* node = root->getChildByName("bone"); node; node = root->getNextNamedChild())
+			{
+				addBone(node, mRoot, pose);
+			}
+			mRoot->setPosition(LLVector3((F32)(pose % 10) * 2.f, (F32)(pose / 10) * 2.f, 0.f));
+		}
+
+		~Avatar()
+		{
+			for_each(mJoints.begin(), mJoints.end(), DeletePointer());
+		}
+
+		// Mirrors LLViewerJointMesh::setupJoint() and addSkinJobs().
+		void addSkinJob(const Mesh& mesh, std::vector<LLVector3>& vertices, std::vector<LLVector3>& normals,
+						LLSkinJob& job)
+		{
+			addJoints(mRoot, mesh, job);
+			job.mWeights = &mesh.mWeights[0];
+			job.mCoords = &mesh.mCoords[0];
+			job.mNormals = &mesh.mNormals[0];
+			job.mNumVertices = (U32)mesh.mCoords.size();
+			vertices.resize(job.mNumVertices);
+			normals.resize(job.mNumVertices);
+			job.mVertices = &vertices[0];
+			job.mVertexNormals = &normals[0];
+		}
+
+		LLJoint* mRoot;
+		std::vector<LLJoint*> mJoints;
+
+	private:
+		void addBone(LLXmlTreeNode* node, LLJoint* parent, S32 pose)
+		{
+			std::string name;
+			LLVector3 pos, rot, scale, pivot;
+			node->getAttributeString("name", name);
+			node->getAttributeVector3("pos", pos);
+			node->getAttributeVector3("rot", rot);
+			node->getAttributeVector3("scale", scale);
+			node->getAttributeVector3("pivot", pivot);
+
+			LLJoint* joint = new LLJoint(name, parent);
+			mJoints.push_back(joint);
+			joint->setPosition(pos);
+			// The bind pose for pose 0, otherwise bent a little at every joint.
+			F32 bend = (F32)((pose * 7 + mJoints.size() * 3) % 41 - 20) * (pose ? 1.f : 0.f);
+			joint->setRotation(mayaQ(rot.mV[VX] + bend, rot.mV[VY] - bend * 0.5f, rot.mV[VZ], LLQuaternion::XYZ));
+			joint->setScale(scale);
+			joint->setSkinOffset(pivot);
+
+			for (LLXmlTreeNode* child = node->getChildByName("bone"); child; child = node->getNextNamedChild())
+			{
+				addBone(child, joint, pose);
+			}
+		}
+
+		static LLVector3 rootToJoint(LLJoint* joint)
+		{
+			LLVector3 offset;
+			for (; joint; joint = joint->getParent())
+			{
+				offset -= joint->getSkinOffset();
+			}
+			return offset;
+		}
+
+		void addJoints(LLJoint* joint, const Mesh& mesh, LLSkinJob& job)
+		{
+			if (std::find(mesh.mJointNames.begin(), mesh.mJointNames.end(), joint->getName())
+				!= mesh.mJointNames.end())
+			{
+				LLJoint* parent = joint->getParent();
+				if (!job.mNumJoints || job.mWorldMatrices[job.mNumJoints - 1] != &parent->getXform()->getWorldMatrix())
+				{
+					job.mWorldMatrices[job.mNumJoints] = &parent->getXform()->getWorldMatrix();
+					job.mSkinOffsets[job.mNumJoints++] = rootToJoint(joint) + joint->getSkinOffset();
+				}
+				job.mWorldMatrices[job.mNumJoints] = &joint->getXform()->getWorldMatrix();
+				job.mSkinOffsets[job.mNumJoints++] = rootToJoint(joint);
+			}
+			for (LLJoint::child_list_t::iterator iter = joint->mChildren.begin();
+				 iter != joint->mChildren.end(); ++iter)
+			{
+				addJoints(*iter, mesh, job);
+			}
+		}
+	};
+}
+
+namespace tut
+{
+	struct skinningpool_test
+	{
+		skinningpool_test()
+		{
+			load_meshes(mMeshes);
+			mSkeleton.parseFile(character_dir() + "avatar_skeleton.xml", FALSE);
+		}
+
+		~skinningpool_test()
+		{
+			for_each(mAvatars.begin(), mAvatars.end(), DeletePointer());
+		}
+
+		void makeAvatars(S32 count)
+		{
+			for (S32 i = 0; i < count; i++)
+			{
+				mAvatars.push_back(new Avatar(mSkeleton.getRoot(), i));
+			}
+			S32 num_outputs = count * (S32)mMeshes.size();
+			mVertices.resize(num_outputs);
+			mNormals.resize(num_outputs);
+			mJobs.resize(num_outputs);
+			for (S32 i = 0; i < num_outputs; i++)
+			{
+				mAvatars[i / mMeshes.size()]->addSkinJob(mMeshes[i % mMeshes.size()], mVertices[i], mNormals[i], mJobs[i]);
+			}
+		}
+
+		// Poses and skins every avatar, on pool if there is one.
+		void update(LLSkinningPool* pool)
+		{
+			for (S32 i = 0; i < (S32)mAvatars.size(); i++)
+			{
+				mAvatars[i]->mRoot->touch();
+				if (pool)
+				{
+					pool->addJoints(mAvatars[i]->mRoot);
+				}
+				else
+				{
+					mAvatars[i]->mRoot->updateWorldMatrixChildren();
+				}
+			}
+			for (S32 i = 0; i < (S32)mJobs.size(); i++)
+			{
+				if (pool)
+				{
+					pool->addMesh(mJobs[i]);
+				}
+				else
+				{
+					LLSkinningPool::skin(mJobs[i]);
+				}
+			}
+			if (pool)
+			{
+				pool->run();
+			}
+		}
+
+		U32 numVertices() const
+		{
+			U32 count = 0;
+			for (S32 i = 0; i < (S32)mJobs.size(); i++)
+			{
+				count += mJobs[i].mNumVertices;
+			}
+			return count;
+		}
+
+		std::vector<Mesh> mMeshes;
+		LLXmlTree mSkeleton;
+		std::vector<Avatar*> mAvatars;
+		std::vector<std::vector<LLVector3> > mVertices;
+		std::vector<std::vector<LLVector3> > mNormals;
+		std::vector<LLSkinJob> mJobs;
+	};
+
+	typedef test_group<skinningpool_test> skinningpool_test_t;
+	typedef skinningpool_test_t::object skinningpool_test_object_t;
+	tut::skinningpool_test_t tut_skinningpool_test("skinningpool_test");
+
+	template<> template<>
+	void skinningpool_test_object_t::test<1>()
+	{
+		// in the bind pose, skinning gives back the mesh as it was modelled
+		ensure("meshes loaded", mMeshes.size() >= 5);
+		ensure("skeleton loaded", mSkeleton.getRoot() != NULL);
+		makeAvatars(1);
+		LLSkinningPool pool(NUM_THREADS);
+		update(&pool);
+		for (S32 i = 0; i < (S32)mJobs.size(); i++)
+		{
+			ensure("has joints", mJobs[i].mNumJoints > 1);
+			for (U32 v = 0; v < mJobs[i].mNumVertices; v++)
+			{
+				ensure("vertex", dist_vec(mVertices[i][v], mMeshes[i].mCoords[v]) < 0.002f);
+				ensure("normal", dist_vec(mNormals[i][v], mMeshes[i].mNormals[v]) < 0.002f);
+			}
+		}
+	}
+
+	template<> template<>
+	void skinningpool_test_object_t::test<2>()
+	{
+		// the pool does what the calling thread would have
+		makeAvatars(NUM_AVATARS);
+
+		LLTimer timer;
+		for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			update(NULL);
+		}
+		F32 sync_time = timer.getElapsedTimeF32() / NUM_FRAMES;
+		std::vector<std::vector<LLVector3> > expected_vertices = mVertices;
+		std::vector<std::vector<LLVector3> > expected_normals = mNormals;
+
+		LLSkinningPool pool(NUM_THREADS);
+		timer.reset();
+		for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			update(&pool);
+		}
+		F32 async_time = timer.getElapsedTimeF32() / NUM_FRAMES;
+
+		llinfos << mAvatars.size() << " avatars, " << numVertices() << " vertices, posed and skinned in "
+				<< sync_time * 1000.f << "ms per frame on the calling thread, " << async_time * 1000.f
+				<< "ms with " << pool.getNumThreads() << " more threads" << llendl;
+
+		ensure_equals("nothing left queued", pool.getNumQueued(), 0);
+		for (S32 i = 0; i < (S32)mJobs.size(); i++)
+		{
+			ensure("same vertices", mVertices[i] == expected_vertices[i]);
+			ensure("same normals", mNormals[i] == expected_normals[i]);
+		}
+	}
+
+	template<> template<>
+	void skinningpool_test_object_t::test<3>()
+	{
+		// without threads, or work, it still does what it is told
+		makeAvatars(3);
+		update(NULL);
+		std::vector<std::vector<LLVector3> > expected_vertices = mVertices;
+
+		LLSkinningPool none(0);
+		ensure_equals("no threads", none.getNumThreads(), 0);
+		none.run();
+		for (S32 i = 0; i < (S32)mVertices.size(); i++)
+		{
+			mVertices[i].assign(mVertices[i].size(), LLVector3::zero);
+		}
+		update(&none);
+		for (S32 i = 0; i < (S32)mJobs.size(); i++)
+		{
+			ensure("same vertices", mVertices[i] == expected_vertices[i]);
+		}
+
+		// started and stopped without ever being used
+		LLSkinningPool idle(NUM_THREADS);
+	}
+}
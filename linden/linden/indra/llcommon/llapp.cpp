@@ -311,6 +311,7 @@ void LLApp::runErrorHandler()
 	{
 		LLApp::sErrorHandler();
 	}
+	LLError::flushLogs();
 
 	//llinfos << "App status now STOPPED" << llendl;
 	LLApp::setStopped();
@@ -329,6 +330,8 @@ void LLApp::setError()
 {
 	if (!isError())
 	{
+		// Get what led up to this into the log file.
+		LLError::flushLogs();
 		// perform any needed synchronous error-handling
 		runSyncErrorHandler();
 		// set app status to ERROR so that the LLErrorThread notices
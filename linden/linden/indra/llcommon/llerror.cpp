@@ -60,6 +60,7 @@
 #include "llsd.h"
 #include "llsdserialize.h"
 #include "llstl.h"
+#include "llthread.h"
 #include "lltimer.h"
 
 extern apr_thread_mutex_t* gCallStacksLogMutexp;
@@ -102,37 +103,180 @@ namespace {
 	};
 #endif
 
+	// Appends messages to a file. recordMessage() only copies the message
+	// into a ring buffer, which a thread of its own writes out in batches,
+	// so nothing that logs waits on the disk.
 	class RecordToFile : public LLError::Recorder
 	{
 	public:
 		RecordToFile(const std::string& filename)
+			: mWriter(NULL), mHead(0), mTail(0), mDropped(0)
 		{
-			mFile.open(filename, llofstream::out | llofstream::app);
+			mRing.resize(RING_SIZE);
+			mFile = LLFile::fopen(filename, "a");
 			if (!mFile)
 			{
 				llinfos << "Error setting log file to " << filename << llendl;
+				return;
 			}
+			mWriter = new Writer(*this);
+			mWriter->start();
 		}
 		
 		~RecordToFile()
 		{
-			mFile.close();
+			if (mWriter)
+			{
+				if (!mWriter->stopAndWait(5000))
+				{
+					// It is stuck writing, so leave the file to it.
+					return;
+				}
+				delete mWriter;
+			}
+			if (mFile)
+			{
+				drain();
+				if (mDropped)
+				{
+					fprintf(mFile, "%s\n", droppedNote().c_str());
+				}
+				fclose(mFile);
+			}
 		}
 		
-		bool okay() { return mFile; }
+		bool okay() { return mFile != NULL; }
 		
 		virtual bool wantsTime() { return true; }
 		
 		virtual void recordMessage(LLError::ELevel level,
 									const std::string& message)
 		{
-			mFile << message << std::endl;
-			// mFile.flush();
-				// *FIX: should we do this? 
+			// Only called with the log lock held, so only one thread at a
+			// time adds to the ring. Writing out here when the writer thread
+			// falls behind would hold up everyone waiting on that lock, so
+			// what doesn't fit is dropped, and counted where it would have
+			// been.
+			if (mDropped && addLine(droppedNote()))
+			{
+				mDropped = 0;
+			}
+			if (mDropped || !addLine(message))
+			{
+				mDropped++;
+			}
 		}
-	
+
+		// Writes out all that has been recorded so far, from any thread.
+		// When crashing, the writer thread might never let go, so this only
+		// waits so long for it.
+		void flush()
+		{
+			for (S32 attempts = 0; attempts < 100; ++attempts)
+			{
+				if (mWriteMutex.tryLock())
+				{
+					drainLocked();
+					mWriteMutex.unlock();
+					return;
+				}
+				ms_sleep(1);
+			}
+		}
+
 	private:
-		llofstream mFile;
+		enum { RING_SIZE = 1 << 20 };
+
+		class Writer : public LLThread
+		{
+		public:
+			Writer(RecordToFile& recorder)
+				: LLThread("Log writer"), mRecorder(recorder)
+			{ }
+
+			/*virtual*/ void run()
+			{
+				while (!isQuitting())
+				{
+					if (!mRecorder.drain())
+					{
+						ms_sleep(10);
+					}
+				}
+			}
+
+		private:
+			RecordToFile& mRecorder;
+		};
+
+		// Copies line into the ring for the writer thread. Returns false if
+		// there is no room for it.
+		bool addLine(const std::string& line)
+		{
+			U32 size = line.size() + 1;
+			if (size > RING_SIZE - (mHead - mTail))
+			{
+				return false;
+			}
+			U32 head = mHead;
+			copyToRing(head, line.data(), size - 1);
+			copyToRing(head + size - 1, "\n", 1);
+			// Publishing the new head hands the line over to the writer.
+			mHead = head + size;
+			return true;
+		}
+
+		std::string droppedNote() const
+		{
+			return llformat("(%u log messages dropped)", mDropped);
+		}
+
+		void copyToRing(U32 pos, const char* src, U32 size)
+		{
+			pos &= RING_SIZE - 1;
+			U32 first = llmin(size, (U32)RING_SIZE - pos);
+			memcpy(&mRing[pos], src, first);		/* Flawfinder: ignore */
+			if (first < size)
+			{
+				memcpy(&mRing[0], src + first, size - first);		/* Flawfinder: ignore */
+			}
+		}
+
+		bool drain()
+		{
+			LLMutexLock lock(&mWriteMutex);
+			return drainLocked();
+		}
+
+		bool drainLocked()
+		{
+			U32 head = mHead;
+			U32 tail = mTail;
+			if (head == tail)
+			{
+				return false;
+			}
+			U32 pos = tail & (RING_SIZE - 1);
+			U32 avail = head - tail;
+			U32 first = llmin(avail, (U32)RING_SIZE - pos);
+			fwrite(&mRing[pos], 1, first, mFile);
+			if (first < avail)
+			{
+				fwrite(&mRing[0], 1, avail - first, mFile);
+			}
+			fflush(mFile);
+			// Hands the space back to recordMessage().
+			mTail = head;
+			return true;
+		}
+
+		LLFILE* mFile;
+		Writer* mWriter;
+		LLMutex mWriteMutex;	// held while writing to mFile
+		std::vector<char> mRing;
+		LLAtomicU32 mHead;
+		LLAtomicU32 mTail;
+		U32 mDropped;			// messages that found the ring full, under the log lock
 	};
 	
 	
@@ -356,9 +500,6 @@ namespace
 	class Globals
 	{
 	public:
-		std::ostringstream messageStream;
-		bool messageStreamInUse;
-
 		void addCallSite(LLError::CallSite&);
 		void invalidateCallSites();
 		
@@ -368,9 +509,7 @@ namespace
 	private:
 		CallSiteVector callSites;
 
-		Globals()
-			:	messageStreamInUse(false)
-			{ }
+		Globals() { }
 		
 	};
 
@@ -814,6 +953,15 @@ namespace LLError
 		LLError::Settings& s = LLError::Settings::get();
 		return s.fileRecorderFileName;
 	}
+	void flushLogs()
+	{
+		// No log lock: whoever holds it may be the thread that crashed.
+		LLError::Settings& s = LLError::Settings::get();
+		if (s.fileRecorder)
+		{
+			static_cast<RecordToFile*>(s.fileRecorder)->flush();
+		}
+	}
 }
 
 namespace
@@ -904,6 +1052,10 @@ namespace {
 		bool mOK;
 	};
 	
+	// The thread holding gLogMutexp, which mustn't wait for itself when it
+	// logs again while holding it (from a signal handler, say).
+	volatile U32 sLogLockOwner = 0;
+
 	LogLock::LogLock()
 		: mLocked(false), mOK(false)
 	{
@@ -913,35 +1065,83 @@ namespace {
 			return;
 		}
 		
-		const int MAX_RETRIES = 10;
-		for (int attempts = 0; attempts < MAX_RETRIES; ++attempts)
+		U32 self = LLThread::currentID();
+		if (sLogLockOwner == self)
 		{
-			apr_status_t s = apr_thread_mutex_trylock(gLogMutexp);
-			if (!APR_STATUS_IS_EBUSY(s))
+			// Logging from inside the logging code, which would deadlock.
+			std::cerr << "LogLock::LogLock: failed to get mutex for log"
+						<< std::endl;
+			return;
+		}
+
+		if (LLApp::isError())
+		{
+			// A thread that hit llerrs keeps hold of the lock while it waits
+			// for the error thread, which logs too. So once things have gone
+			// wrong, only try for the lock for so long. (Not when stopped:
+			// that is also what the status says before the app gets going.)
+			const int MAX_RETRIES = 10;
+			for (int attempts = 0; attempts < MAX_RETRIES; ++attempts)
 			{
-				mLocked = true;
-				mOK = true;
-				return;
+				apr_status_t s = apr_thread_mutex_trylock(gLogMutexp);
+				if (!APR_STATUS_IS_EBUSY(s))
+				{
+					sLogLockOwner = self;
+					mLocked = true;
+					mOK = true;
+					return;
+				}
+
+				ms_sleep(1);
+				apr_thread_yield();
 			}
 
-			ms_sleep(1);
-			apr_thread_yield();
+			// We're hosed, we can't get the mutex.  Blah.
+			std::cerr << "LogLock::LogLock: failed to get mutex for log"
+						<< std::endl;
+			return;
 		}
 
-		// We're hosed, we can't get the mutex.  Blah.
-		std::cerr << "LogLock::LogLock: failed to get mutex for log"
-					<< std::endl;
+		// Other threads only ever hold it for a moment, as nothing is
+		// written out under it any more.
+		apr_thread_mutex_lock(gLogMutexp);
+		sLogLockOwner = self;
+		mLocked = true;
+		mOK = true;
 	}
 	
 	LogLock::~LogLock()
 	{
 		if (mLocked)
 		{
+			sLogLockOwner = 0;
 			apr_thread_mutex_unlock(gLogMutexp);
 		}
 	}
 }
 
+namespace
+{
+	// Returns what was written to a stream from LLError::Log::out(), and
+	// gives the stream back.
+	std::string takeMessage(std::ostringstream* out)
+	{
+		std::string message = out->str();
+		AIThreadLocalData* tldata = AIThreadLocalData::peek();
+		if (tldata && out == &tldata->mLogStream)
+		{
+			out->clear();
+			out->str("");
+			tldata->mLogStreamInUse = false;
+		}
+		else
+		{
+			delete out;
+		}
+		return message;
+	}
+}
+
 namespace LLError
 {
 	bool Log::shouldLog(CallSite& site)
@@ -984,16 +1184,12 @@ namespace LLError
 
 	std::ostringstream* Log::out()
 	{
-		LogLock lock;
-		if (lock.ok())
+		// Each thread formats into a stream of its own, without locking.
+		AIThreadLocalData* tldata = AIThreadLocalData::peek();
+		if (tldata && !tldata->mLogStreamInUse)
 		{
-			Globals& g = Globals::get();
-
-			if (!g.messageStreamInUse)
-			{
-				g.messageStreamInUse = true;
-				return &g.messageStream;
-			}
+			tldata->mLogStreamInUse = true;
+			return &tldata->mLogStream;
 		}
 		
 		return new std::ostringstream;
@@ -1001,59 +1197,31 @@ namespace LLError
 	
 	void Log::flush(std::ostringstream* out, char* message)
     {
-       LogLock lock;
-       if (!lock.ok())
-       {
-           return;
-       }
-       
-	   if(strlen(out->str().c_str()) < 128)
+	   std::string text = takeMessage(out);
+	   if(text.size() < 128)
 	   {
-		   strcpy(message, out->str().c_str());
+		   strcpy(message, text.c_str());
 	   }
 	   else
 	   {
-		   strncpy(message, out->str().c_str(), 127);
+		   strncpy(message, text.c_str(), 127);
 		   message[127] = '\0' ;
 	   }
-	   
-	   Globals& g = Globals::get();
-       if (out == &g.messageStream)
-       {
-           g.messageStream.clear();
-           g.messageStream.str("");
-           g.messageStreamInUse = false;
-       }
-       else
-       {
-           delete out;
-       }
 	   return ;
     }
 
 	void Log::flush(std::ostringstream* out, const CallSite& site)
 	{
+		std::string message = takeMessage(out);
+
 		LogLock lock;
 		if (!lock.ok())
 		{
 			return;
 		}
 		
-		Globals& g = Globals::get();
 		Settings& s = Settings::get();
 
-		std::string message = out->str();
-		if (out == &g.messageStream)
-		{
-			g.messageStream.clear();
-			g.messageStream.str("");
-			g.messageStreamInUse = false;
-		}
-		else
-		{
-			delete out;
-		}
-
 		if (site.mLevel == LEVEL_ERROR)
 		{
 			std::ostringstream fatalMessage;
@@ -1144,6 +1312,7 @@ namespace LLError
 		
 		if (site.mLevel == LEVEL_ERROR  &&  s.crashFunction)
 		{
+			flushLogs();
 			s.crashFunction(message);
 		}
 	}
@@ -129,6 +129,10 @@ namespace LLError
 		// Passing the empty string or NULL to just removes any prior.
 	LL_COMMON_API std::string logFileName();
 		// returns name of current logging file, empty string if none
+	LL_COMMON_API void flushLogs();
+		// The log file is written by a thread of its own; this writes out
+		// what it hasn't got to yet. Safe to call when crashing, and done
+		// before the fatal function is called.
 
 
 	/*
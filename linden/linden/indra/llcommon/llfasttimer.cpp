@@ -33,7 +33,10 @@
 
 #include "llfasttimer.h"
 
+#include "apr_atomic.h"
+
 #include "llprocessor.h"
+#include "llthread.h"
 
 
 #if LL_WINDOWS
@@ -41,8 +44,7 @@
 #include <sys/time.h>
 #include <sched.h>
 #elif LL_DARWIN
-#include <sys/time.h>
-#include "lltimer.h"	// get_clock_count()
+#include <mach/mach_time.h>
 #else 
 #error "architecture not supported"
 #endif
@@ -64,15 +66,53 @@ S32 LLFastTimer::sCurFrameIndex = -1;
 S32 LLFastTimer::sLastFrameIndex = -1;
 int LLFastTimer::sPauseHistory = 0;
 int LLFastTimer::sResetHistory = 0;
+volatile U32 LLFastTimer::sTracing = 0;
 
 F64 LLFastTimer::sCPUClockFrequency = 0.0;
 
-#if LL_LINUX || LL_SOLARIS
+#if LL_LINUX || LL_SOLARIS || LL_DARWIN
 U64 LLFastTimer::sClockResolution = 1e9; // Nanosecond resolution
 #else 
 U64 LLFastTimer::sClockResolution = 1e6; // Microsecond resolution
 #endif
 
+static const char* sTypeNames[] =
+{
+	"FTM_FRAME", "FTM_UPDATE", "FTM_RENDER", "FTM_SWAP", "FTM_CLIENT_COPY", "FTM_IDLE",
+	"FTM_SLEEP", "FTM_PUMP", "FTM_CURL", "FTM_UPDATE_ANIMATION", "FTM_UPDATE_TERRAIN",
+	"FTM_UPDATE_PRIMITIVES", "FTM_UPDATE_PARTICLES", "FTM_SIMULATE_PARTICLES", "FTM_UPDATE_SKY",
+	"FTM_UPDATE_TEXTURES", "FTM_UPDATE_WLPARAM", "FTM_UPDATE_WATER", "FTM_UPDATE_CLOUDS",
+	"FTM_UPDATE_GRASS", "FTM_UPDATE_TREE", "FTM_UPDATE_AVATAR", "FTM_SHADOW_GEOMETRY",
+	"FTM_SHADOW_RENDER", "FTM_SHADOW_TERRAIN", "FTM_SHADOW_AVATAR", "FTM_SHADOW_SIMPLE",
+	"FTM_SHADOW_ALPHA", "FTM_SHADOW_TREE", "FTM_RENDER_GEOMETRY", "FTM_RENDER_TERRAIN",
+	"FTM_RENDER_SIMPLE", "FTM_RENDER_FULLBRIGHT", "FTM_RENDER_GLOW", "FTM_RENDER_GRASS",
+	"FTM_RENDER_INVISIBLE", "FTM_RENDER_SHINY", "FTM_RENDER_BUMP", "FTM_RENDER_TREES",
+	"FTM_RENDER_CHARACTERS", "FTM_RENDER_OCCLUSION", "FTM_RENDER_ALPHA", "FTM_RENDER_CLOUDS",
+	"FTM_RENDER_HUD", "FTM_RENDER_PARTICLES", "FTM_RENDER_WATER", "FTM_RENDER_WL_SKY",
+	"FTM_RENDER_FAKE_VBO_UPDATE", "FTM_RENDER_TIMER", "FTM_RENDER_UI", "FTM_RENDER_BLOOM",
+	"FTM_RENDER_BLOOM_FBO", "FTM_RENDER_FONTS", "FTM_MESSAGES", "FTM_MOUSEHANDLER",
+	"FTM_KEYHANDLER", "FTM_REBUILD", "FTM_STATESORT", "FTM_STATESORT_DRAWABLE",
+	"FTM_STATESORT_POSTSORT", "FTM_REBUILD_VBO", "FTM_REBUILD_VOLUME_VB", "FTM_REBUILD_BRIDGE_VB",
+	"FTM_REBUILD_HUD_VB", "FTM_REBUILD_TERRAIN_VB", "FTM_REBUILD_WATER_VB", "FTM_REBUILD_TREE_VB",
+	"FTM_REBUILD_PARTICLE_VB", "FTM_REBUILD_CLOUD_VB", "FTM_REBUILD_GRASS_VB",
+	"FTM_REBUILD_NONE_VB", "FTM_REBUILD_OCCLUSION_VB", "FTM_POOLS", "FTM_POOLRENDER",
+	"FTM_IDLE_CB", "FTM_WORLD_UPDATE", "FTM_UPDATE_MOVE", "FTM_OCTREE_BALANCE",
+	"FTM_UPDATE_LIGHTS", "FTM_CULL", "FTM_CULL_REBOUND", "FTM_FRUSTUM_CULL", "FTM_GEO_UPDATE",
+	"FTM_GEO_RESERVE", "FTM_GEO_LIGHT", "FTM_GEO_SHADOW", "FTM_GEO_SKY", "FTM_GEN_VOLUME",
+	"FTM_GEN_TRIANGLES", "FTM_GEN_FLEX", "FTM_AUDIO_UPDATE", "FTM_RESET_DRAWORDER",
+	"FTM_OBJECTLIST_UPDATE", "FTM_AVATAR_UPDATE", "FTM_JOINT_UPDATE", "FTM_ATTACHMENT_UPDATE",
+	"FTM_LOD_UPDATE", "FTM_REGION_UPDATE", "FTM_CLEANUP", "FTM_NETWORK", "FTM_IDLE_NETWORK",
+	"FTM_CREATE_OBJECT", "FTM_LOAD_AVATAR", "FTM_PROCESS_MESSAGES", "FTM_PROCESS_OBJECTS",
+	"FTM_PROCESS_IMAGES", "FTM_IMAGE_UPDATE", "FTM_IMAGE_CREATE", "FTM_IMAGE_DECODE",
+	"FTM_IMAGE_READBACK", "FTM_IMAGE_MARK_DIRTY", "FTM_PIPELINE", "FTM_VFILE_WAIT",
+	"FTM_FLEXIBLE_UPDATE", "FTM_OCCLUSION_READBACK", "FTM_HUD_EFFECTS", "FTM_HUD_UPDATE",
+	"FTM_INVENTORY", "FTM_AUTO_SELECT", "FTM_ARRANGE", "FTM_FILTER", "FTM_REFRESH", "FTM_SORT",
+	"FTM_PICK", "FTM_TEMP1", "FTM_TEMP2", "FTM_TEMP3", "FTM_TEMP4", "FTM_TEMP5", "FTM_TEMP6",
+	"FTM_TEMP7", "FTM_TEMP8", "FTM_OTHER",
+};
+// One name for each EFastTimerType
+typedef char type_names_check[LL_ARRAY_SIZE(sTypeNames) == LLFastTimer::FTM_NUM_TYPES ? 1 : -1];
+
 //////////////////////////////////////////////////////////////////////////////
 
 //
@@ -123,22 +163,34 @@ U64 get_cpu_clock_count()
 //
 // Mac implementation of CPU clock
 //
-// Just use gettimeofday implementation for now
+// The kernel keeps mach_absolute_time() in step across cores, and unlike
+// gettimeofday() it costs no system call and counts in nanoseconds or so.
 
 U64 get_cpu_clock_count()
 {
-	return get_clock_count();
+	return mach_absolute_time();
 }
 #endif
 
 //////////////////////////////////////////////////////////////////////////////
 
 //static
-#if LL_DARWIN || LL_LINUX || LL_SOLARIS
-// Both Linux and Mac use gettimeofday for accurate time
+#if LL_LINUX || LL_SOLARIS
+// Linux uses clock_gettime for accurate time
+U64 LLFastTimer::countsPerSecond()
+{
+	return sClockResolution; // nanoseconds, so 1 Ghz.
+}
+#elif LL_DARWIN
 U64 LLFastTimer::countsPerSecond()
 {
-	return sClockResolution; // microseconds, so 1 Mhz.
+	if (!sCPUClockFrequency)
+	{
+		mach_timebase_info_data_t timebase;
+		mach_timebase_info(&timebase);
+		sCPUClockFrequency = (F64)sClockResolution * timebase.denom / timebase.numer;
+	}
+	return U64(sCPUClockFrequency);
 }
 #else 
 U64 LLFastTimer::countsPerSecond()
@@ -189,6 +241,12 @@ void LLFastTimer::reset()
 			sCallAverage[i] = 0;
 		}
 	}
+
+	mergeThreadTimers();
+	if (sTracing)
+	{
+		writeTrace();
+	}
 	
 	sCurFrameIndex++;
 	
@@ -201,3 +259,423 @@ void LLFastTimer::reset()
 }
 
 //////////////////////////////////////////////////////////////////////////////
+
+//
+// Declared timers
+//
+
+// Threads that can have declared timers at once. Ended threads hand theirs
+// on to new ones.
+const U32 MAX_TIMER_THREADS = 64;
+// Trace events each thread can have waiting for reset() to write them out
+const U32 TRACE_RING_SIZE = 32768;
+
+struct LLTraceEvent
+{
+	U32 mTimer;		// EFastTimerType, or FTM_NUM_TYPES + declared timer index
+	U64 mStart;
+	U64 mEnd;
+};
+
+// What one thread's declared timers counted, and the trace events it
+// recorded. Once created these live as long as the process, so that
+// reset() never has to worry about them going away.
+class LLThreadTimers
+{
+public:
+	LLThreadTimers(const std::string& name)
+	:	mDepth(0),
+		mWriteSequence(0),
+		mSequence(0),
+		mInUse(1),
+		mHead(0),
+		mTail(0),
+		mDropped(0)
+	{
+		setName(name);
+		memset(mCounts, 0, sizeof(mCounts));
+		memset(mCalls, 0, sizeof(mCalls));
+		memset(mMergedCounts, 0, sizeof(mMergedCounts));
+		memset(mMergedCalls, 0, sizeof(mMergedCalls));
+	}
+
+	void setName(const std::string& name)
+	{
+		// A fixed buffer: reset() may be reading it.
+		strncpy(mName, name.c_str(), sizeof(mName) - 1);		/* Flawfinder: ignore */
+		mName[sizeof(mName) - 1] = '\0';
+	}
+
+	void trace(U32 timer, U64 start, U64 end)
+	{
+		if (mEvents.empty())
+		{
+			mEvents.resize(TRACE_RING_SIZE);
+		}
+		U32 head = mHead;
+		if (head - mTail >= TRACE_RING_SIZE)
+		{
+			mDropped++;
+			return;
+		}
+		LLTraceEvent& event = mEvents[head & (TRACE_RING_SIZE - 1)];
+		event.mTimer = timer;
+		event.mStart = start;
+		event.mEnd = end;
+		// Publishing the new head hands the event over to reset().
+		mHead = head + 1;
+	}
+
+	// Owner thread only
+	U64 mChildTime[LLFastTimer::FTM_MAX_DEPTH];	// of the timers running
+	S32 mDepth;
+	U32 mWriteSequence;
+
+	// Written by the owner thread and read by reset(). mSequence is odd
+	// while mCounts and mCalls are being changed.
+	LLAtomicU32 mSequence;
+	U64 mCounts[LLFastTimer::MAX_DECLARED_TIMERS];
+	U64 mCalls[LLFastTimer::MAX_DECLARED_TIMERS];
+
+	// reset() only: what it has merged so far
+	U64 mMergedCounts[LLFastTimer::MAX_DECLARED_TIMERS];
+	U64 mMergedCalls[LLFastTimer::MAX_DECLARED_TIMERS];
+
+	volatile apr_uint32_t mInUse;
+	char mName[64];
+
+	// Trace ring; the owner thread moves mHead and reset() moves mTail.
+	std::vector<LLTraceEvent> mEvents;
+	LLAtomicU32 mHead;
+	LLAtomicU32 mTail;
+	U32 mDropped;
+};
+
+static volatile void* sThreadTimers[MAX_TIMER_THREADS];
+
+static LLThreadTimers* get_thread_timers()
+{
+	AIThreadLocalData& tldata = LLThread::tldata();
+	if (tldata.mThreadTimers)
+	{
+		return tldata.mThreadTimers;
+	}
+
+	for (U32 i = 0; i < MAX_TIMER_THREADS; i++)
+	{
+		LLThreadTimers* timers = (LLThreadTimers*)sThreadTimers[i];
+		if (!timers)
+		{
+			timers = new LLThreadTimers(tldata.mName);
+			if (apr_atomic_casptr(&sThreadTimers[i], timers, NULL) == NULL)
+			{
+				tldata.mThreadTimers = timers;
+				return timers;
+			}
+			// Another thread got there first.
+			delete timers;
+			timers = (LLThreadTimers*)sThreadTimers[i];
+		}
+		if (apr_atomic_cas32(&timers->mInUse, 1, 0) == 0)
+		{
+			// Left by a thread that ended. Its counts carry on from where
+			// they were, which doesn't upset reset().
+			timers->setName(tldata.mName);
+			timers->mDepth = 0;
+			tldata.mThreadTimers = timers;
+			return timers;
+		}
+	}
+	// Declared timers don't count on this thread.
+	return NULL;
+}
+
+//static
+void LLFastTimer::releaseThreadTimers(LLThreadTimers* timers)
+{
+	if (timers)
+	{
+		apr_atomic_set32(&timers->mInUse, 0);
+	}
+}
+
+static std::vector<LLFastTimer::DeclareTimer*>& declared_timers()
+{
+	static std::vector<LLFastTimer::DeclareTimer*> timers;
+	return timers;
+}
+
+LLFastTimer::DeclareTimer::DeclareTimer(const std::string& name, DeclareTimer* parent)
+:	mName(name),
+	mParent(parent),
+	mFrameCount(0),
+	mFrameCalls(0),
+	mCountAverage(0),
+	mCallAverage(0)
+{
+	std::vector<DeclareTimer*>& timers = declared_timers();
+	// Past MAX_DECLARED_TIMERS a timer is never counted.
+	mIndex = timers.size() < MAX_DECLARED_TIMERS ? (S32)timers.size() : -1;
+	timers.push_back(this);
+}
+
+//static
+const std::vector<LLFastTimer::DeclareTimer*>& LLFastTimer::DeclareTimer::getTimers()
+{
+	return declared_timers();
+}
+
+void LLFastTimer::startDeclared()
+{
+	mThreadTimers = NULL;
+	if (mDeclared->mIndex < 0)
+	{
+		return;
+	}
+	LLThreadTimers* timers = get_thread_timers();
+	if (!timers || timers->mDepth >= FTM_MAX_DEPTH)
+	{
+		return;
+	}
+	timers->mChildTime[timers->mDepth++] = 0;
+	mThreadTimers = timers;
+	mStart = get_cpu_clock_count();
+}
+
+void LLFastTimer::stopDeclared()
+{
+	if (!mThreadTimers)
+	{
+		return;
+	}
+	U64 end = get_cpu_clock_count();
+	LLThreadTimers* timers = mThreadTimers;
+	S32 depth = --timers->mDepth;
+	U64 delta = end - mStart;
+	if (depth > 0)
+	{
+		timers->mChildTime[depth - 1] += delta;
+	}
+
+	S32 index = mDeclared->mIndex;
+	U32 sequence = timers->mWriteSequence;
+	timers->mSequence = sequence + 1;
+	timers->mCounts[index] += delta - timers->mChildTime[depth];
+	timers->mCalls[index]++;
+	timers->mSequence = sequence + 2;
+	timers->mWriteSequence = sequence + 2;
+
+	if (sTracing)
+	{
+		timers->trace(FTM_NUM_TYPES + index, mStart, end);
+	}
+}
+
+//static
+void LLFastTimer::mergeThreadTimers()
+{
+	std::vector<DeclareTimer*>& declared = declared_timers();
+	S32 num_timers = llmin((S32)declared.size(), (S32)MAX_DECLARED_TIMERS);
+	std::vector<U64> frame_counts(num_timers, 0);
+	std::vector<U64> frame_calls(num_timers, 0);
+	U64 counts[MAX_DECLARED_TIMERS];
+	U64 calls[MAX_DECLARED_TIMERS];
+
+	for (U32 i = 0; i < MAX_TIMER_THREADS; i++)
+	{
+		LLThreadTimers* timers = (LLThreadTimers*)sThreadTimers[i];
+		if (!timers)
+		{
+			continue;
+		}
+
+		// Retried while the thread is in the middle of an update, which is
+		// only ever a few instructions long.
+		for (S32 tries = 0; tries < 1000; tries++)
+		{
+			U32 before = timers->mSequence;
+			if (before & 1)
+			{
+				continue;
+			}
+			memcpy(counts, timers->mCounts, num_timers * sizeof(U64));		/* Flawfinder: ignore */
+			memcpy(calls, timers->mCalls, num_timers * sizeof(U64));		/* Flawfinder: ignore */
+			if (timers->mSequence == before)
+			{
+				for (S32 t = 0; t < num_timers; t++)
+				{
+					frame_counts[t] += counts[t] - timers->mMergedCounts[t];
+					frame_calls[t] += calls[t] - timers->mMergedCalls[t];
+					timers->mMergedCounts[t] = counts[t];
+					timers->mMergedCalls[t] = calls[t];
+				}
+				break;
+			}
+		}
+	}
+
+	// Averaged over about as many frames as the fixed timers keep history of
+	U64 frames = (U64)llclamp(sCurFrameIndex, 0, FTM_HISTORY_NUM - 1);
+	for (S32 t = 0; t < num_timers; t++)
+	{
+		DeclareTimer* timer = declared[t];
+		timer->mFrameCount = frame_counts[t];
+		timer->mFrameCalls = frame_calls[t];
+		timer->mCountAverage = (timer->mCountAverage * frames + frame_counts[t]) / (frames + 1);
+		timer->mCallAverage = (timer->mCallAverage * frames + frame_calls[t]) / (frames + 1);
+	}
+}
+
+//
+// Tracing
+//
+
+static LLFILE* sTraceFile = NULL;
+static U64 sTraceStart = 0;
+static U64 sTraceEvents = 0;
+static U64 sTraceThreads = 0;	// bit for each sThreadTimers slot named in the trace
+
+static void write_trace_string(const char* str)
+{
+	fputc('"', sTraceFile);
+	for (; *str; ++str)
+	{
+		if (*str == '"' || *str == '\\')
+		{
+			fputc('\\', sTraceFile);
+		}
+		if ((U8)*str >= 0x20)
+		{
+			fputc(*str, sTraceFile);
+		}
+	}
+	fputc('"', sTraceFile);
+}
+
+//static
+void LLFastTimer::traceEvent(EFastTimerType type, U64 start, U64 end)
+{
+	LLThreadTimers* timers = get_thread_timers();
+	if (timers)
+	{
+		timers->trace(type, start, end);
+	}
+}
+
+//static
+bool LLFastTimer::startTrace(const std::string& filename)
+{
+	stopTrace();
+
+	sTraceFile = LLFile::fopen(filename, "wb");
+	if (!sTraceFile)
+	{
+		llwarns << "Unable to open " << filename << " for the timer trace" << llendl;
+		return false;
+	}
+	// The JSON array form, which viewers still read if the viewer dies
+	// before stopTrace() closes the array.
+	fputs("[\n", sTraceFile);
+	sTraceStart = get_cpu_clock_count();
+	sTraceEvents = 0;
+	sTraceThreads = 0;
+	for (U32 i = 0; i < MAX_TIMER_THREADS; i++)
+	{
+		LLThreadTimers* timers = (LLThreadTimers*)sThreadTimers[i];
+		if (timers)
+		{
+			timers->mTail = (U32)timers->mHead;
+			timers->mDropped = 0;
+		}
+	}
+	sTracing = 1;
+	llinfos << "Recording timer trace to " << filename << llendl;
+	return true;
+}
+
+//static
+void LLFastTimer::stopTrace()
+{
+	if (!sTraceFile)
+	{
+		return;
+	}
+	sTracing = 0;
+	writeTrace();
+
+	U32 dropped = 0;
+	for (U32 i = 0; i < MAX_TIMER_THREADS; i++)
+	{
+		LLThreadTimers* timers = (LLThreadTimers*)sThreadTimers[i];
+		if (timers)
+		{
+			dropped += timers->mDropped;
+		}
+	}
+	fputs("{}]\n", sTraceFile);
+	fclose(sTraceFile);
+	sTraceFile = NULL;
+	llinfos << "Timer trace stopped, " << sTraceEvents << " events written, "
+			<< dropped << " dropped" << llendl;
+}
+
+//static
+void LLFastTimer::writeTrace()
+{
+	if (!sTraceFile)
+	{
+		return;
+	}
+	std::vector<DeclareTimer*>& declared = declared_timers();
+	F64 usec_per_count = 1000000.0 / (F64)countsPerSecond();
+
+	for (U32 i = 0; i < MAX_TIMER_THREADS; i++)
+	{
+		LLThreadTimers* timers = (LLThreadTimers*)sThreadTimers[i];
+		if (!timers)
+		{
+			continue;
+		}
+		U32 head = timers->mHead;
+		U32 tail = timers->mTail;
+		if (head == tail)
+		{
+			continue;
+		}
+
+		if (!(sTraceThreads & ((U64)1 << i)))
+		{
+			sTraceThreads |= (U64)1 << i;
+			fprintf(sTraceFile, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", i);
+			write_trace_string(timers->mName);
+			fputs("}},\n", sTraceFile);
+		}
+
+		for (; tail != head; ++tail)
+		{
+			const LLTraceEvent& event = timers->mEvents[tail & (TRACE_RING_SIZE - 1)];
+			if (event.mStart < sTraceStart)
+			{
+				// Started before the trace did.
+				continue;
+			}
+			const char* name = event.mTimer < (U32)FTM_NUM_TYPES
+							   ? sTypeNames[event.mTimer]
+							   : declared[event.mTimer - FTM_NUM_TYPES]->getName().c_str();
+			fputs("{\"name\":", sTraceFile);
+			write_trace_string(name);
+			fprintf(sTraceFile, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f},\n", i,
+					(F64)(event.mStart - sTraceStart) * usec_per_count,
+					(F64)(event.mEnd - event.mStart) * usec_per_count);
+			sTraceEvents++;
+		}
+		// Hands the space back to the thread.
+		timers->mTail = head;
+	}
+}
+
+//static
+const char* LLFastTimer::getTypeName(EFastTimerType type)
+{
+	return (type >= 0 && type < FTM_NUM_TYPES) ? sTypeNames[type] : "";
+}
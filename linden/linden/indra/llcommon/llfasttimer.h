@@ -35,11 +35,58 @@
 
 #define FAST_TIMER_ON 1
 
+#include <string>
+#include <vector>
+
 LL_COMMON_API U64 get_cpu_clock_count();
 
+class LLThreadTimers;
+
 class LL_COMMON_API LLFastTimer
 {
 public:
+	// A timer declared where it is used, rather than in EFastTimerType,
+	// which works on any thread:
+	//
+	//   static LLFastTimer::DeclareTimer FTM_DECODE("Image Decode", &FTM_WORKERS);
+	//   ...
+	//   LLFastTimer t(FTM_DECODE);
+	//
+	// Each thread adds up its own time without taking any lock, and reset()
+	// merges what all of them did into the totals for the frame. Like the
+	// fixed timers, a declared timer doesn't count the time of the declared
+	// timers started inside it on the same thread. The parent only groups
+	// timers for display.
+	class LL_COMMON_API DeclareTimer
+	{
+	public:
+		DeclareTimer(const std::string& name, DeclareTimer* parent = NULL);
+
+		const std::string& getName() const	{ return mName; }
+		DeclareTimer* getParent() const		{ return mParent; }
+		S32 getIndex() const				{ return mIndex; }
+
+		// Summed over all threads, as of the last reset()
+		U64 getFrameCount() const			{ return mFrameCount; }
+		U64 getFrameCalls() const			{ return mFrameCalls; }
+		U64 getCountAverage() const			{ return mCountAverage; }
+		U64 getCallAverage() const			{ return mCallAverage; }
+
+		// In the order they were declared in
+		static const std::vector<DeclareTimer*>& getTimers();
+
+	private:
+		friend class LLFastTimer;
+
+		std::string mName;
+		DeclareTimer* mParent;
+		S32 mIndex;
+		U64 mFrameCount;
+		U64 mFrameCalls;
+		U64 mCountAverage;
+		U64 mCallAverage;
+	};
+
 	enum EFastTimerType
 	{
 		// high level
@@ -193,6 +240,7 @@ public:
 	};
 	enum { FTM_HISTORY_NUM = 60 };
 	enum { FTM_MAX_DEPTH = 64 };
+	enum { MAX_DECLARED_TIMERS = 256 };
 	
 public:
 	static EFastTimerType sCurType;
@@ -201,6 +249,7 @@ public:
 	{
 #if FAST_TIMER_ON
 		mType = type;
+		mDeclared = NULL;
 		sCurType = type;
 		// These don't get counted, because they use CPU clockticks
 		//gTimerBins[gCurTimerBin]++;
@@ -208,13 +257,28 @@ public:
 
 		U64 cpu_clocks = get_cpu_clock_count();
 
+		mStart = cpu_clocks;
 		sStart[sCurDepth] = cpu_clocks;
 		sCurDepth++;
 #endif
 	};
+	LLFastTimer(DeclareTimer& timer)
+	{
+#if FAST_TIMER_ON
+		mType = FTM_OTHER;
+		mDeclared = &timer;
+		startDeclared();
+#endif
+	}
 	~LLFastTimer()
 	{
 #if FAST_TIMER_ON
+		if (mDeclared)
+		{
+			stopDeclared();
+			return;
+		}
+
 		U64 end,delta;
 		int i;
 
@@ -230,12 +294,32 @@ public:
 		// Subtract delta from parents
 		for (i=0; i<sCurDepth; i++)
 			sStart[i] += delta;
+
+		if (sTracing)
+		{
+			traceEvent(mType, mStart, end);
+		}
 #endif
 	}
 
+	// Also merges what the declared timers did on every thread since the
+	// last call, and writes out the trace, if one is being recorded.
 	static void reset();
 	static U64 countsPerSecond();
 
+	static const char* getTypeName(EFastTimerType type);
+
+	// Records every timer on every thread, with when it started and
+	// stopped, to filename in the Trace Event format of chrome://tracing
+	// and other flame chart viewers, until stopTrace(). reset() writes out
+	// each frame as it ends.
+	static bool startTrace(const std::string& filename);
+	static void stopTrace();
+	static bool isTracing()					{ return sTracing != 0; }
+
+	// Called when a thread ends, so that another can have its timers.
+	static void releaseThreadTimers(LLThreadTimers* timers);
+
 public:
 	static int sCurDepth;
 	static U64 sStart[FTM_MAX_DEPTH];
@@ -251,9 +335,19 @@ public:
 	static int sResetHistory;
 	static F64 sCPUClockFrequency;
     static U64 sClockResolution;
+	static volatile U32 sTracing;
 	
 private:
+	void startDeclared();
+	void stopDeclared();
+	static void traceEvent(EFastTimerType type, U64 start, U64 end);
+	static void mergeThreadTimers();
+	static void writeTrace();
+
 	EFastTimerType mType;
+	DeclareTimer* mDeclared;
+	LLThreadTimers* mThreadTimers;
+	U64 mStart;
 };
 
 
@@ -37,6 +37,7 @@
 #include "llthread.h"
 
 #include "lltimer.h"
+#include "llfasttimer.h"
 
 #if LL_LINUX || LL_SOLARIS
 #include <sched.h>
@@ -69,8 +70,8 @@ void *APR_THREAD_FUNC LLThread::staticRun(apr_thread_t *apr_threadp, void *datap
 {
 	LLThread *threadp = (LLThread *)datap;
 
-	// Set thread state to running
-	threadp->mStatus = RUNNING;
+	// start() already set the state to RUNNING; setting it again here
+	// would undo a setQuitting() that came before the thread got going.
 
 	// Create a thread local data.
 	AIThreadLocalData::create(threadp);
@@ -119,19 +120,7 @@ void LLThread::shutdown()
 			// Now wait a bit for the thread to exit
 			// It's unclear whether I should even bother doing this - this destructor
 			// should netver get called unless we're already stopped, really...
-			S32 counter = 0;
-			const S32 MAX_WAIT = 600;
-			while (counter < MAX_WAIT)
-			{
-				if (isStopped())
-				{
-					break;
-				}
-				// Sleep for a tenth of a second
-				ms_sleep(100);
-				yield();
-				counter++;
-			}
+			stopAndWait(60000);
 		}
 
 		if (!isStopped())
@@ -148,12 +137,41 @@ void LLThread::shutdown()
 
 void LLThread::start()
 {
-	apr_thread_create(&mAPRThreadp, NULL, staticRun, (void *)this, tldata().mRootPool());
+	// Say RUNNING from here on rather than once the new thread gets going,
+	// so that a stop asked for straight away isn't mistaken for having
+	// happened already.
+	mStatus = RUNNING;
+	if (apr_thread_create(&mAPRThreadp, NULL, staticRun, (void *)this, tldata().mRootPool()) != APR_SUCCESS)
+	{
+		llwarns << "LLThread::start() failed to create thread " << mName << llendl;
+		mAPRThreadp = NULL;
+		mStatus = STOPPED;
+		return;
+	}
 
 	// We won't bother joining
 	apr_thread_detach(mAPRThreadp);
 }
 
+bool LLThread::stopAndWait(U32 max_wait_ms)
+{
+	setQuitting();
+
+	LLTimer timer;
+	while (!isStopped())
+	{
+		if (timer.getElapsedTimeF32() * 1000.f >= (F32)max_wait_ms)
+		{
+			llwarns << "LLThread::stopAndWait() thread " << mName << " didn't stop within "
+					<< max_wait_ms << " ms" << llendl;
+			return false;
+		}
+		ms_sleep(1);
+		yield();
+	}
+	return true;
+}
+
 //============================================================================
 // Called from MAIN THREAD.
 
@@ -285,13 +303,17 @@ void AIThreadLocalData::init(void)
 //static
 void AIThreadLocalData::destroy(void* thread_local_data)
 {
-	delete reinterpret_cast<AIThreadLocalData*>(thread_local_data);
+	AIThreadLocalData* tldata = reinterpret_cast<AIThreadLocalData*>(thread_local_data);
+	// Lets a later thread have this one's timers.
+	LLFastTimer::releaseThreadTimers(tldata->mThreadTimers);
+	delete tldata;
 }
 
 //static
 void AIThreadLocalData::create(LLThread* threadp)
 {
 	AIThreadLocalData* new_tld = new AIThreadLocalData;
+	new_tld->mName = threadp ? threadp->mName : "Main";
 	if (threadp)
 	{
 		threadp->mThreadLocalData = new_tld;
@@ -312,6 +334,18 @@ AIThreadLocalData& AIThreadLocalData::tldata(void)
 	return *static_cast<AIThreadLocalData*>(data);
 }
 
+//static
+AIThreadLocalData* AIThreadLocalData::peek(void)
+{
+	void* data = NULL;
+	if (!sThreadLocalDataKey
+		|| apr_threadkey_private_get(&data, sThreadLocalDataKey) != APR_SUCCESS)
+	{
+		return NULL;
+	}
+	return static_cast<AIThreadLocalData*>(data);
+}
+
 //============================================================================
 
 bool LLMutexBase::isLocked()
@@ -40,9 +40,12 @@
 #include "apr_thread_cond.h"
 #include "aiaprpool.h"
 
+#include <sstream>
+
 class LLThread;
 class LLMutex;
 class LLCondition;
+class LLThreadTimers;
 
 class LL_COMMON_API AIThreadLocalData
 {
@@ -50,14 +53,27 @@ private:
 	static apr_threadkey_t* sThreadLocalDataKey;
 
 public:
+	AIThreadLocalData() : mThreadTimers(NULL), mLogStreamInUse(false) {}
+
 	// Thread-local memory pool.
 	AIAPRRootPool mRootPool;
 	AIVolatileAPRPool mVolatileAPRPool;
 
+	// The LLThread's name, or "Main".
+	std::string mName;
+	// What LLFastTimer's declared timers counted on this thread.
+	LLThreadTimers* mThreadTimers;
+	// What LLError::Log::out() hands out to this thread.
+	std::ostringstream mLogStream;
+	bool mLogStreamInUse;
+
 	static void init(void);
 	static void destroy(void* thread_local_data);
 	static void create(LLThread* pthread);
 	static AIThreadLocalData& tldata(void);
+	// Like tldata(), but returns NULL rather than setting anything up, for
+	// threads LLThread didn't start and for before init().
+	static AIThreadLocalData* peek(void);
 };
 
 class LL_COMMON_API LLThread
@@ -99,6 +115,10 @@ public:
 	// this kicks off the apr thread
 	void start(void);
 
+	// Asks the thread to quit and waits up to max_wait_ms for its run()
+	// function to return. Returns false if it was still going by then.
+	bool stopAndWait(U32 max_wait_ms);
+
 	// Return thread-local data for the current thread.
 	static AIThreadLocalData& tldata(void) { return AIThreadLocalData::tldata(); }
 
@@ -0,0 +1,489 @@
+/**
+ * @file llimagecompositor.cpp
+ * @brief Composites avatar texture layers on the CPU.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llimagecompositor.h"
+
+#include "llfasttimer.h"
+#include "v4color.h"
+
+LLImageCompositor::blend_func_t LLImageCompositor::sBlend = &LLImageCompositor::blendScalar;
+
+// GL_LINEAR with GL_CLAMP_TO_EDGE: pixel i of out_size samples the input
+// at (i + 0.5) * in_size / out_size - 0.5, which falls between texels i0
+// and i1, frac 256ths of the way.
+static void linear_tap(S32 i, S32 in_size, S32 out_size, S32& i0, S32& i1, U16& frac)
+{
+	S32 pos = (S32)(((S64)(2 * i + 1) * in_size * 256) / (2 * out_size)) - 128;
+	if (pos <= 0)
+	{
+		i0 = i1 = 0;
+		frac = 0;
+		return;
+	}
+	i0 = pos >> 8;
+	if (i0 >= in_size - 1)
+	{
+		i0 = i1 = in_size - 1;
+		frac = 0;
+		return;
+	}
+	i1 = i0 + 1;
+	frac = (U16)(pos & 0xff);
+}
+
+// The next mip level down, box filtered the way the GL mipmap generation
+// does it.
+static LLPointer<LLImageRaw> half_size(const LLImageRaw* image)
+{
+	S32 width = image->getWidth();
+	S32 height = image->getHeight();
+	S32 comps = image->getComponents();
+	S32 half_width = llmax(width / 2, 1);
+	S32 half_height = llmax(height / 2, 1);
+	S32 step_x = width > 1 ? comps : 0;
+	S32 step_y = height > 1 ? width * comps : 0;
+
+	LLPointer<LLImageRaw> half = new LLImageRaw(half_width, half_height, comps);
+	const U8* src = image->getData();
+	U8* dst = half->getData();
+	for (S32 y = 0; y < half_height; y++)
+	{
+		const U8* row = src + (y * 2 * width) * comps;
+		if (height == 1)
+		{
+			row = src;
+		}
+		for (S32 x = 0; x < half_width; x++)
+		{
+			const U8* p = row + (width > 1 ? x * 2 * comps : 0);
+			for (S32 c = 0; c < comps; c++)
+			{
+				*dst++ = (U8)((p[c] + p[c + step_x] + p[c + step_y] + p[c + step_x + step_y] + 2) >> 2);
+			}
+		}
+	}
+	return half;
+}
+
+LLImageCompositor::LLImageCompositor(S32 width, S32 height)
+	: mWidth(width),
+	  mHeight(height),
+	  mNumAlphas(0)
+{
+	setColor(LLColor4::white);
+	setBlendFunc(BF_SOURCE_ALPHA, BF_ONE_MINUS_SOURCE_ALPHA);
+	setColorMask(TRUE, TRUE);
+	setAlphaTest(TRUE);
+	setTextureBlendType(TB_MULT);
+}
+
+LLImageCompositor::~LLImageCompositor()
+{
+}
+
+void LLImageCompositor::setColor(const LLColor4& color)
+{
+	for (S32 c = 0; c < 4; c++)
+	{
+		// glColor4fv() -> 8 bit frame buffer
+		mState.mColor[c] = (U8)llround(llclamp(color.mV[c], 0.f, 1.f) * 255.f);
+	}
+}
+
+void LLImageCompositor::setBlendFunc(EBlendFactor sfactor, EBlendFactor dfactor)
+{
+	mState.mSourceFactor = (U8)sfactor;
+	mState.mDestFactor = (U8)dfactor;
+}
+
+void LLImageCompositor::setColorMask(BOOL write_color, BOOL write_alpha)
+{
+	mState.mWriteMask[0] = mState.mWriteMask[1] = mState.mWriteMask[2] = write_color ? 0xff : 0;
+	mState.mWriteMask[3] = write_alpha ? 0xff : 0;
+}
+
+void LLImageCompositor::setAlphaTest(BOOL alpha_test)
+{
+	mState.mAlphaTest = alpha_test;
+}
+
+void LLImageCompositor::setTextureBlendType(ETextureBlendType type)
+{
+	mState.mModulate = (type == TB_MULT);
+}
+
+void LLImageCompositor::drawRect()
+{
+	Draw draw;
+	draw.mPass = mState;
+	draw.mIsAlpha = FALSE;
+	draw.mUseMipMaps = FALSE;
+	draw.mAlpha = -1;
+	mDraws.push_back(draw);
+}
+
+void LLImageCompositor::drawImage(LLImageRaw* image, BOOL is_alpha, BOOL use_mipmaps)
+{
+	if (!image || !image->getData() || !image->getWidth() || !image->getHeight())
+	{
+		llwarns << "Compositing an empty image" << llendl;
+		return;
+	}
+	Draw draw;
+	draw.mPass = mState;
+	draw.mImage = image;
+	draw.mIsAlpha = is_alpha && image->getComponents() == 1;
+	draw.mUseMipMaps = use_mipmaps;
+	draw.mAlpha = -1;
+	mDraws.push_back(draw);
+}
+
+S32 LLImageCompositor::readAlpha()
+{
+	Draw draw;
+	draw.mPass = mState;
+	draw.mIsAlpha = FALSE;
+	draw.mUseMipMaps = FALSE;
+	draw.mAlpha = mNumAlphas++;
+	mDraws.push_back(draw);
+	return draw.mAlpha;
+}
+
+void LLImageCompositor::prepareSource(Source& source, LLImageRaw* image, BOOL use_mipmaps)
+{
+	// GL picks the level whose size is nearest the canvas.
+	source.mLevel = image;
+	while (use_mipmaps
+		   && ((S64)source.mLevel->getWidth() * source.mLevel->getWidth() > (S64)2 * mWidth * mWidth
+			   || (S64)source.mLevel->getHeight() * source.mLevel->getHeight() > (S64)2 * mHeight * mHeight))
+	{
+		source.mLevel = half_size(source.mLevel);
+	}
+
+	S32 level_width = source.mLevel->getWidth();
+	source.mX0.resize(mWidth);
+	source.mX1.resize(mWidth);
+	source.mFracX.resize(mWidth);
+	for (S32 x = 0; x < mWidth; x++)
+	{
+		linear_tap(x, level_width, mWidth, source.mX0[x], source.mX1[x], source.mFracX[x]);
+	}
+	source.mDirect = (level_width == mWidth && source.mLevel->getHeight() == mHeight);
+}
+
+const U8* LLImageCompositor::fetchRow(const Source& source, const Draw& draw, S32 y, U8* rgba) const
+{
+	const LLImageRaw* level = source.mLevel;
+	S32 comps = level->getComponents();
+	S32 level_width = level->getWidth();
+	const U8* data = level->getData();
+
+	if (source.mDirect && comps == 4)
+	{
+		return data + y * mWidth * 4;
+	}
+
+	// Missing channels are white for GL_MODULATE and the fragment color
+	// for GL_REPLACE.
+	U8 fill[4];
+	for (S32 c = 0; c < 4; c++)
+	{
+		fill[c] = draw.mPass.mModulate ? 0xff : draw.mPass.mColor[c];
+	}
+
+	S32 y0, y1;
+	U16 frac_y;
+	linear_tap(y, level->getHeight(), mHeight, y0, y1, frac_y);
+	const U8* row0 = data + y0 * level_width * comps;
+	const U8* row1 = data + y1 * level_width * comps;
+
+	U8 texel[4];
+	for (S32 x = 0; x < mWidth; x++, rgba += 4)
+	{
+		if (source.mDirect)
+		{
+			for (S32 c = 0; c < comps; c++)
+			{
+				texel[c] = row0[x * comps + c];
+			}
+		}
+		else
+		{
+			U32 frac_x = source.mFracX[x];
+			const U8* p00 = row0 + source.mX0[x] * comps;
+			const U8* p01 = row0 + source.mX1[x] * comps;
+			const U8* p10 = row1 + source.mX0[x] * comps;
+			const U8* p11 = row1 + source.mX1[x] * comps;
+			for (S32 c = 0; c < comps; c++)
+			{
+				U32 top = p00[c] * (256 - frac_x) + p01[c] * frac_x;
+				U32 bottom = p10[c] * (256 - frac_x) + p11[c] * frac_x;
+				texel[c] = (U8)((top * (256 - frac_y) + bottom * frac_y + 32768) >> 16);
+			}
+		}
+
+		switch (comps)
+		{
+		case 1:
+			if (draw.mIsAlpha)
+			{
+				rgba[0] = fill[0];
+				rgba[1] = fill[1];
+				rgba[2] = fill[2];
+				rgba[3] = texel[0];
+			}
+			else
+			{
+				rgba[0] = rgba[1] = rgba[2] = texel[0];
+				rgba[3] = fill[3];
+			}
+			break;
+		case 2:
+			rgba[0] = rgba[1] = rgba[2] = texel[0];
+			rgba[3] = texel[1];
+			break;
+		case 3:
+			rgba[0] = texel[0];
+			rgba[1] = texel[1];
+			rgba[2] = texel[2];
+			rgba[3] = fill[3];
+			break;
+		default:
+			rgba[0] = texel[0];
+			rgba[1] = texel[1];
+			rgba[2] = texel[2];
+			rgba[3] = texel[3];
+			break;
+		}
+	}
+	return rgba - mWidth * 4;
+}
+
+static LLFastTimer::DeclareTimer FTM_IMAGE_COMPOSITE("Image Compositing");
+
+void LLImageCompositor::composite()
+{
+	LLFastTimer t(FTM_IMAGE_COMPOSITE);
+
+	mCanvas = new LLImageRaw(mWidth, mHeight, 4);
+	memset(mCanvas->getData(), 0, mWidth * mHeight * 4);
+	mAlphas.resize(mNumAlphas);
+	for (S32 i = 0; i < mNumAlphas; i++)
+	{
+		mAlphas[i] = new LLImageRaw(mWidth, mHeight, 1);
+	}
+
+	S32 num_draws = (S32)mDraws.size();
+	std::vector<Source> sources(num_draws);
+	for (S32 i = 0; i < num_draws; i++)
+	{
+		if (mDraws[i].mImage.isNull())
+		{
+			continue;
+		}
+		// Layers often draw the same image more than once.
+		S32 j = 0;
+		while (j < i && (mDraws[j].mImage != mDraws[i].mImage
+						 || mDraws[j].mUseMipMaps != mDraws[i].mUseMipMaps))
+		{
+			j++;
+		}
+		if (j < i)
+		{
+			sources[i] = sources[j];
+		}
+		else
+		{
+			prepareSource(sources[i], mDraws[i].mImage, mDraws[i].mUseMipMaps);
+		}
+	}
+
+	// A row at a time, so that it stays in the cache through all the draws.
+	std::vector<U8> rgba(mWidth * 4);
+	for (S32 y = 0; y < mHeight; y++)
+	{
+		U8* row = mCanvas->getData() + y * mWidth * 4;
+		for (S32 i = 0; i < num_draws; i++)
+		{
+			const Draw& draw = mDraws[i];
+			if (draw.mAlpha >= 0)
+			{
+				U8* alpha = mAlphas[draw.mAlpha]->getData() + y * mWidth;
+				for (S32 x = 0; x < mWidth; x++)
+				{
+					alpha[x] = row[x * 4 + 3];
+				}
+				continue;
+			}
+			const U8* src = NULL;
+			if (draw.mImage.notNull())
+			{
+				src = fetchRow(sources[i], draw, y, &rgba[0]);
+			}
+			sBlend(row, src, draw.mPass, mWidth);
+		}
+	}
+}
+
+// static
+void LLImageCompositor::useSSE2(BOOL use_sse2)
+{
+	sBlend = (use_sse2 && hasSSE2()) ? &blendSSE2 : &blendScalar;
+}
+
+static inline U8 blend_factor(U8 factor, U8 src_alpha, U8 dst_alpha)
+{
+	switch (factor)
+	{
+	case LLImageCompositor::BF_ZERO:					return 0;
+	case LLImageCompositor::BF_ONE:						return 0xff;
+	case LLImageCompositor::BF_SOURCE_ALPHA:			return src_alpha;
+	case LLImageCompositor::BF_ONE_MINUS_SOURCE_ALPHA:	return 0xff - src_alpha;
+	case LLImageCompositor::BF_DEST_ALPHA:				return dst_alpha;
+	default:											return 0xff - dst_alpha;
+	}
+}
+
+// static
+void LLImageCompositor::blendScalar(U8* dst, const U8* src, const Pass& pass, S32 count)
+{
+	U8 frag[4];
+	for (S32 i = 0; i < count; i++, dst += 4)
+	{
+		for (S32 c = 0; c < 4; c++)
+		{
+			if (!src)
+			{
+				frag[c] = pass.mColor[c];
+			}
+			else if (pass.mModulate)
+			{
+				frag[c] = mul255(src[i * 4 + c], pass.mColor[c]);
+			}
+			else
+			{
+				frag[c] = src[i * 4 + c];
+			}
+		}
+		if (pass.mAlphaTest && frag[3] <= ALPHA_TEST_DISCARD)
+		{
+			continue;
+		}
+
+		U8 src_factor = blend_factor(pass.mSourceFactor, frag[3], dst[3]);
+		U8 dst_factor = blend_factor(pass.mDestFactor, frag[3], dst[3]);
+		for (S32 c = 0; c < 4; c++)
+		{
+			U32 result = llmin((U32)mul255(frag[c], src_factor) + mul255(dst[c], dst_factor), (U32)0xff);
+			dst[c] = (U8)((result & pass.mWriteMask[c]) | (dst[c] & ~pass.mWriteMask[c]));
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+// MAIN THREAD
+LLImageCompositorThread::LLImageCompositorThread(bool threaded)
+	: LLQueuedThread("imagecompositor", threaded)
+{
+}
+
+// MAIN THREAD
+LLImageCompositorThread::handle_t LLImageCompositorThread::composite(LLImageCompositor* compositor, U32 priority)
+{
+	handle_t handle = generateHandle();
+	CompositeRequest* req = new CompositeRequest(handle, priority, compositor);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLImageCompositorThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+BOOL LLImageCompositorThread::getResult(handle_t handle, LLImageCompositor*& compositor)
+{
+	compositor = NULL;
+	status_t status = getRequestStatus(handle);
+	if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+	{
+		return FALSE;
+	}
+	CompositeRequest* req = (CompositeRequest*)getRequest(handle);
+	if (req)
+	{
+		compositor = req->takeCompositor();
+		if (status != STATUS_COMPLETE)
+		{
+			delete compositor;
+			compositor = NULL;
+		}
+		completeRequest(handle);
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------------
+
+LLImageCompositorThread::CompositeRequest::CompositeRequest(handle_t handle, U32 priority,
+															LLImageCompositor* compositor)
+	: LLQueuedThread::QueuedRequest(handle, priority, 0),
+	  mCompositor(compositor)
+{
+}
+
+LLImageCompositorThread::CompositeRequest::~CompositeRequest()
+{
+	delete mCompositor;
+}
+
+bool LLImageCompositorThread::CompositeRequest::processRequest()
+{
+	mCompositor->composite();
+	return true;
+}
+
+void LLImageCompositorThread::CompositeRequest::finishRequest(bool completed)
+{
+	// Collected by LLImageCompositorThread::getResult()
+}
+
+// MAIN THREAD
+LLImageCompositor* LLImageCompositorThread::CompositeRequest::takeCompositor()
+{
+	LLImageCompositor* compositor = mCompositor;
+	mCompositor = NULL;
+	return compositor;
+}
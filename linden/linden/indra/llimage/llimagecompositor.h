@@ -0,0 +1,227 @@
+/**
+ * @file llimagecompositor.h
+ * @brief Composites avatar texture layers on the CPU.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLIMAGECOMPOSITOR_H
+#define LL_LLIMAGECOMPOSITOR_H
+
+#include <vector>
+
+#include "llimage.h"
+#include "llqueuedthread.h"
+
+class LLColor4;
+
+// Composites images into an RGBA canvas the way LLTexLayerSet renders its
+// layers with GL, so that avatar textures can be baked without a GL
+// context, on any thread.
+//
+// Draws are recorded along with the GL state they would be rendered with,
+// which is the fixed function subset the layers use: a flat color or a
+// texture stretched over the whole canvas, the texture environment, the
+// alpha test, the blend function and the color mask. composite() then
+// runs them a canvas row at a time. Everything is 8 bits a channel as in
+// the frame buffer, textures are sampled bilinearly from a box filtered
+// mip level when they are minified, and products of two channels are
+// rounded, which keeps results within a step or two of GL's.
+class LLImageCompositor
+{
+public:
+	enum EBlendFactor
+	{
+		BF_ZERO,
+		BF_ONE,
+		BF_SOURCE_ALPHA,
+		BF_ONE_MINUS_SOURCE_ALPHA,
+		BF_DEST_ALPHA,
+		BF_ONE_MINUS_DEST_ALPHA
+	};
+
+	enum ETextureBlendType
+	{
+		TB_MULT,		// GL_MODULATE
+		TB_REPLACE		// GL_REPLACE
+	};
+
+	// The alpha test, GL_GREATER 0.01, discards fragments with alphas of
+	// up to this.
+	enum { ALPHA_TEST_DISCARD = 2 };
+
+	// Everything the blending kernel needs for one draw.
+	struct Pass
+	{
+		U8 mColor[4];
+		U8 mWriteMask[4];	// 0xff for the channels the color mask lets through
+		U8 mSourceFactor;
+		U8 mDestFactor;
+		BOOL mAlphaTest;	// GL_GREATER 0.01
+		BOOL mModulate;
+	};
+
+	LLImageCompositor(S32 width, S32 height);
+	~LLImageCompositor();
+
+	S32 getWidth() const				{ return mWidth; }
+	S32 getHeight() const				{ return mHeight; }
+
+	// The state later draws use, as set through gGL and LLTexUnit. It
+	// starts out as LLGLSUIDefault leaves it: BT_ALPHA blending, color and
+	// alpha writes on, the alpha test on, TB_MULT, white.
+	void setColor(const LLColor4& color);
+	void setBlendFunc(EBlendFactor sfactor, EBlendFactor dfactor);
+	void setColorMask(BOOL write_color, BOOL write_alpha);
+	void setAlphaTest(BOOL alpha_test);
+	void setTextureBlendType(ETextureBlendType type);
+
+	// gl_rect_2d_simple() over the whole canvas.
+	void drawRect();
+	// gl_rect_2d_simple_tex() over the whole canvas with image bound. A
+	// single channel image is GL_ALPHA if is_alpha, GL_LUMINANCE otherwise.
+	// Without use_mipmaps, a larger image is sampled at full size the way a
+	// GL texture without mipmaps would be. The image must not change until
+	// composite() is done with it.
+	void drawImage(LLImageRaw* image, BOOL is_alpha = FALSE, BOOL use_mipmaps = TRUE);
+	// glReadPixels() of the alpha channel as it is at this point. Returns
+	// the index of the getAlpha() it ends up in.
+	S32 readAlpha();
+
+	S32 getNumDraws() const				{ return (S32)mDraws.size(); }
+
+	// Runs the draws on a canvas that starts out all zero. Safe on any
+	// thread, as long as nothing else uses the compositor meanwhile.
+	void composite();
+
+	// Results of composite(): the RGBA canvas, and the single channel
+	// planes readAlpha() asked for.
+	LLImageRaw* getCanvas() const		{ return mCanvas; }
+	S32 getNumAlphas() const			{ return mNumAlphas; }
+	LLImageRaw* getAlpha(S32 i) const	{ return mAlphas[i]; }
+
+	// Blends count pixels of a draw into the canvas row dst. src is the
+	// texture row, already expanded to RGBA, or NULL for a flat color.
+	//
+	// As with LLVertexXform, sBlend is the one to call, and the SSE2
+	// version gives exactly the same results as the scalar one.
+	typedef void (*blend_func_t)(U8* dst, const U8* src, const Pass& pass, S32 count);
+
+	static blend_func_t sBlend;
+
+	// Falls back to the scalar version if this build has no SSE2 version.
+	// Don't turn SSE2 on for CPUs that lack it.
+	static void useSSE2(BOOL use_sse2);
+	static BOOL usingSSE2()				{ return sBlend == &blendSSE2; }
+	// Whether the SSE2 version was compiled in.
+	static BOOL hasSSE2();
+
+	static void blendScalar(U8* dst, const U8* src, const Pass& pass, S32 count);
+	// llimagecompositor_sse2.cpp
+	static void blendSSE2(U8* dst, const U8* src, const Pass& pass, S32 count);
+
+	// a * b / 255, rounded, as GL does it.
+	static inline U8 mul255(U32 a, U32 b)
+	{
+		U32 t = a * b + 128;
+		return (U8)((t + (t >> 8)) >> 8);
+	}
+
+private:
+	struct Draw
+	{
+		Pass mPass;
+		LLPointer<LLImageRaw> mImage;
+		BOOL mIsAlpha;
+		BOOL mUseMipMaps;
+		S32 mAlpha;			// >= 0 for a readAlpha()
+	};
+
+	// A draw's image, at the mip level GL would sample it from, with the
+	// bilinear taps and weights of every canvas column.
+	struct Source
+	{
+		LLPointer<LLImageRaw> mLevel;
+		std::vector<S32> mX0;
+		std::vector<S32> mX1;
+		std::vector<U16> mFracX;
+		BOOL mDirect;			// level is canvas sized
+	};
+
+	void prepareSource(Source& source, LLImageRaw* image, BOOL use_mipmaps);
+	// Samples row y of a draw's texture, and expands it to RGBA the way the
+	// texture environment fills in the channels a format lacks. Returns
+	// rgba, or the image row itself when that already is what it would be.
+	const U8* fetchRow(const Source& source, const Draw& draw, S32 y, U8* rgba) const;
+
+	S32 mWidth;
+	S32 mHeight;
+	Pass mState;
+	std::vector<Draw> mDraws;
+	S32 mNumAlphas;
+
+	LLPointer<LLImageRaw> mCanvas;
+	std::vector<LLPointer<LLImageRaw> > mAlphas;
+};
+
+// Runs LLImageCompositors on a thread of its own.
+class LLImageCompositorThread : public LLQueuedThread
+{
+public:
+	class CompositeRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~CompositeRequest(); // use deleteRequest()
+
+	public:
+		// Takes ownership of compositor.
+		CompositeRequest(handle_t handle, U32 priority, LLImageCompositor* compositor);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		LLImageCompositor* takeCompositor();
+
+	private:
+		LLImageCompositor* mCompositor;
+	};
+
+public:
+	LLImageCompositorThread(bool threaded = true);
+
+	// Takes ownership of compositor, and runs it.
+	handle_t composite(LLImageCompositor* compositor, U32 priority = PRIORITY_NORMAL);
+
+	// Returns FALSE while the request is still being worked on. Otherwise
+	// ends the request and hands back its compositor, with the results
+	// filled in, or NULL if it was aborted.
+	BOOL getResult(handle_t handle, LLImageCompositor*& compositor);
+};
+
+#endif // LL_LLIMAGECOMPOSITOR_H
@@ -0,0 +1,149 @@
+/**
+ * @file llimagecompositor_sse2.cpp
+ * @brief SSE2 version of the LLImageCompositor blending kernel.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llimagecompositor.h"
+
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#if LL_VECTORIZE && (defined(__SSE2__) || _M_IX86_FP >= 2 || defined(_M_X64))
+
+#include <emmintrin.h>
+
+// LLImageCompositor::mul255() of 8 bytes, widened to 16 bits.
+inline __m128i mul255_epi16(__m128i a, __m128i b)
+{
+	__m128i t = _mm_add_epi16(_mm_mullo_epi16(a, b), _mm_set1_epi16(128));
+	return _mm_srli_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), 8);
+}
+
+// mul255() of all 16 bytes.
+inline __m128i mul255_epu8(__m128i a, __m128i b)
+{
+	const __m128i zero = _mm_setzero_si128();
+	__m128i lo = mul255_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+	__m128i hi = mul255_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+	return _mm_packus_epi16(lo, hi);
+}
+
+// The alpha of each of four RGBA pixels, in all four of its bytes.
+inline __m128i splat_alpha(__m128i v)
+{
+	__m128i a = _mm_srli_epi32(v, 24);
+	a = _mm_or_si128(a, _mm_slli_epi32(a, 8));
+	return _mm_or_si128(a, _mm_slli_epi32(a, 16));
+}
+
+inline __m128i blend_factor(U8 factor, __m128i src_alpha, __m128i dst_alpha)
+{
+	const __m128i ones = _mm_set1_epi32(-1);
+	switch (factor)
+	{
+	case LLImageCompositor::BF_ZERO:					return _mm_setzero_si128();
+	case LLImageCompositor::BF_ONE:						return ones;
+	case LLImageCompositor::BF_SOURCE_ALPHA:			return src_alpha;
+	case LLImageCompositor::BF_ONE_MINUS_SOURCE_ALPHA:	return _mm_xor_si128(src_alpha, ones);
+	case LLImageCompositor::BF_DEST_ALPHA:				return dst_alpha;
+	default:											return _mm_xor_si128(dst_alpha, ones);
+	}
+}
+
+// static
+BOOL LLImageCompositor::hasSSE2()
+{
+	return TRUE;
+}
+
+// static
+void LLImageCompositor::blendSSE2(U8* dst, const U8* src, const Pass& pass, S32 count)
+{
+	const __m128i color = _mm_set1_epi32(*(const S32*)pass.mColor);
+	const __m128i write_mask = _mm_set1_epi32(*(const S32*)pass.mWriteMask);
+	const __m128i discard = _mm_set1_epi8(LLImageCompositor::ALPHA_TEST_DISCARD);
+	const __m128i zero = _mm_setzero_si128();
+
+	// Four pixels at a time, same order of operations as blendScalar()
+	S32 vector_count = count & ~3;
+	for (S32 i = 0; i < vector_count; i += 4)
+	{
+		__m128i d = _mm_loadu_si128((const __m128i*)(dst + i * 4));
+		__m128i f = color;
+		if (src)
+		{
+			f = _mm_loadu_si128((const __m128i*)(src + i * 4));
+			if (pass.mModulate)
+			{
+				f = mul255_epu8(f, color);
+			}
+		}
+		__m128i src_alpha = splat_alpha(f);
+		__m128i dst_alpha = splat_alpha(d);
+
+		__m128i mask = write_mask;
+		if (pass.mAlphaTest)
+		{
+			// 0xff where alpha > ALPHA_TEST_DISCARD
+			__m128i fail = _mm_cmpeq_epi8(_mm_subs_epu8(src_alpha, discard), zero);
+			mask = _mm_andnot_si128(fail, mask);
+		}
+
+		__m128i result = _mm_adds_epu8(mul255_epu8(f, blend_factor(pass.mSourceFactor, src_alpha, dst_alpha)),
+									   mul255_epu8(d, blend_factor(pass.mDestFactor, src_alpha, dst_alpha)));
+		result = _mm_or_si128(_mm_and_si128(result, mask), _mm_andnot_si128(mask, d));
+		_mm_storeu_si128((__m128i*)(dst + i * 4), result);
+	}
+
+	blendScalar(dst + vector_count * 4, src ? src + vector_count * 4 : NULL, pass, count - vector_count);
+}
+
+#else
+
+// static
+BOOL LLImageCompositor::hasSSE2()
+{
+	return FALSE;
+}
+
+// static
+void LLImageCompositor::blendSSE2(U8* dst, const U8* src, const Pass& pass, S32 count)
+{
+	blendScalar(dst, src, pass, count);
+}
+
+#endif
@@ -34,6 +34,7 @@
 
 #include "llimageworker.h"
 #include "llimagedxt.h"
+#include "llfasttimer.h"
 
 //----------------------------------------------------------------------------
 
@@ -114,9 +115,12 @@ LLImageDecodeThread::ImageRequest::~ImageRequest()
 //----------------------------------------------------------------------------
 
 
+static LLFastTimer::DeclareTimer FTM_IMAGE_DECODE("Image Decode");
+
 // Returns true when done, whether or not decode was successful.
 bool LLImageDecodeThread::ImageRequest::processRequest()
 {
+	LLFastTimer t(FTM_IMAGE_DECODE);
 	const F32 decode_time_slice = .1f;
 	bool done = true;
 	if (!mDecodedRaw && mFormattedImage.notNull())
@@ -0,0 +1,510 @@
+/**
+ * @file llterraincomposer.cpp
+ * @brief LLTerrainComposer implementation
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "llterraincomposer.h"
+
+#include "llfasttimer.h"
+#include "llstl.h"
+
+LLTerrainComposer::row_func_t LLTerrainComposer::sComposeValues = &LLTerrainComposer::composeValuesScalar;
+LLTerrainComposer::row_func_t LLTerrainComposer::sComposeTexels = &LLTerrainComposer::composeTexelsScalar;
+
+// The noise2() lattice is offset by this much, to keep coordinates positive.
+static const F32 NOISE_OFFSET = 4096.f;
+
+// As in LLVLComposition::generateHeights().
+static const F32 XY_SCALE_INV = 1.f / 4.9215f;
+static const F32 LOW_FREQUENCY_SCALE = 0.2222222222f;
+static const F32 LOW_FREQUENCY_MAGNITUDE = 6.5f;
+static const F32 SLOPE_SQUARED = 1.5f * 1.5f;
+static const F32 NOISE_MAGNITUDE = 2.f;
+static const F32 NUM_TEXTURES = 4.f;
+
+static inline F32 bilinear(const F32 v00, const F32 v01, const F32 v10, const F32 v11, const F32 x_frac, const F32 y_frac)
+{
+	const F32 inv_x_frac = 1.f - x_frac;
+	const F32 inv_y_frac = 1.f - y_frac;
+	return inv_x_frac*inv_y_frac*v00
+			+ x_frac*inv_y_frac*v10
+			+ inv_x_frac*y_frac*v01
+			+ x_frac*y_frac*v11;
+}
+
+static inline F32 s_curve(F32 t)
+{
+	return t * t * (3.f - 2.f * t);
+}
+
+LLTerrainComposer::LLTerrainComposer(const NoiseTables& noise, S32 layer_width, F32 layer_scale, void* user_data)
+	: mNoise(noise),
+	  mLayerWidth(layer_width),
+	  mLayerScale(layer_scale),
+	  mLayerScaleInv(1.f / layer_scale),
+	  mUserData(user_data),
+	  mGenerate(FALSE),
+	  mOriginX(0.0),
+	  mOriginY(0.0),
+	  mTexWidth(0),
+	  mTexHeight(0),
+	  mTexScaleX(1.f),
+	  mTexScaleY(1.f)
+{
+	for (S32 i = 0; i < 4; i++)
+	{
+		mStartHeight[i] = 0.f;
+		mHeightRange[i] = 1.f;
+	}
+	for (S32 i = 0; i < NUM_DETAILS; i++)
+	{
+		mDetailData[i] = NULL;
+		mDetailDataSize[i] = 0;
+	}
+}
+
+void LLTerrainComposer::setValuesRect(const LLRect& rect, BOOL generate)
+{
+	mValuesRect = rect;
+	mGenerate = generate;
+	S32 size = rect.getWidth() * rect.getHeight();
+	mValues.resize(size);
+	mHeights.resize(generate ? size : 0);
+}
+
+void LLTerrainComposer::setCorners(const F32* start_heights, const F32* height_ranges)
+{
+	for (S32 i = 0; i < 4; i++)
+	{
+		mStartHeight[i] = start_heights[i];
+		mHeightRange[i] = height_ranges[i];
+	}
+}
+
+void LLTerrainComposer::setTexture(const LLRect& rect, S32 tex_width, S32 tex_height, F32 tex_scale_x, F32 tex_scale_y)
+{
+	mGridRect = rect;
+	mTexWidth = tex_width;
+	mTexHeight = tex_height;
+	mTexScaleX = tex_scale_x;
+	mTexScaleY = tex_scale_y;
+
+	F32 tex_x_scalef = (F32)tex_width / (F32)mLayerWidth;
+	F32 tex_y_scalef = (F32)tex_height / (F32)mLayerWidth;
+	mTextureRect.mLeft = (S32)((F32)rect.mLeft * tex_x_scalef);
+	mTextureRect.mBottom = (S32)((F32)rect.mBottom * tex_y_scalef);
+	mTextureRect.mRight = (S32)((F32)rect.mRight * tex_x_scalef);
+	mTextureRect.mTop = (S32)((F32)rect.mTop * tex_y_scalef);
+
+	mTexture = new LLImageRaw(llmax(mTextureRect.getWidth(), 1), llmax(mTextureRect.getHeight(), 1), 3);
+	// Texels that would come from past the end of a detail texture are
+	// skipped, as they always were.
+	memset(mTexture->getData(), 0, mTexture->getDataSize());
+}
+
+static LLFastTimer::DeclareTimer FTM_TERRAIN_COMPOSE("Terrain Composition");
+
+void LLTerrainComposer::compose()
+{
+	LLFastTimer t(FTM_TERRAIN_COMPOSE);
+
+	if (mGenerate)
+	{
+		setupValues();
+		for (S32 y = 0; y < mValuesRect.getHeight(); y++)
+		{
+			sComposeValues(*this, y, 0, mValuesRect.getWidth());
+		}
+	}
+	if (mTexture.notNull())
+	{
+		setupTexels();
+		for (S32 y = 0; y < mTextureRect.getHeight(); y++)
+		{
+			sComposeTexels(*this, y, 0, mTextureRect.getWidth());
+		}
+	}
+}
+
+void LLTerrainComposer::NoiseAxis::resize(S32 size)
+{
+	mB0.resize(size);
+	mB1.resize(size);
+	mR0.resize(size);
+	mR1.resize(size);
+	mS.resize(size);
+}
+
+// What noise2() works out from one of its coordinates.
+void LLTerrainComposer::NoiseAxis::setup(S32 i, F32 v, const S32* perm)
+{
+	F32 t = v + NOISE_OFFSET;
+	S32 t_S32 = lltrunc(t);
+	U8 b0 = (U8)t_S32;
+	U8 b1 = b0 + 1;
+	F32 r0 = t - t_S32;
+	mB0[i] = perm ? perm[b0] : b0;
+	mB1[i] = perm ? perm[b1] : b1;
+	mR0[i] = r0;
+	mR1[i] = r0 - 1.f;
+	mS[i] = s_curve(r0);
+}
+
+void LLTerrainComposer::setupValues()
+{
+	S32 width = mValuesRect.getWidth();
+	S32 height = mValuesRect.getHeight();
+	const F32 inv_width = 1.f / mLayerWidth;
+
+	mCornerFracX.resize(width);
+	mCornerFracY.resize(height);
+	for (S32 k = 0; k < NUM_OCTAVES; k++)
+	{
+		mNoiseX[k].resize(width);
+		mNoiseY[k].resize(height);
+	}
+
+	// The lattice coordinates of a point only depend on its column and row,
+	// so noise2() is set up a column and a row at a time.
+	for (S32 i = 0; i < width; i++)
+	{
+		S32 x = mValuesRect.mLeft + i;
+		F32 v = (F32)(mOriginX + x * mLayerScale) * XY_SCALE_INV;
+		mNoiseX[0].setup(i, v * LOW_FREQUENCY_SCALE, mNoise.mPerm);
+		mNoiseX[1].setup(i, 2.f * v, mNoise.mPerm);
+		mNoiseX[2].setup(i, v, mNoise.mPerm);
+		mCornerFracX[i] = x * inv_width;
+	}
+	for (S32 j = 0; j < height; j++)
+	{
+		S32 y = mValuesRect.mBottom + j;
+		F32 v = (F32)(mOriginY + y * mLayerScale) * XY_SCALE_INV;
+		mNoiseY[0].setup(j, v * LOW_FREQUENCY_SCALE, NULL);
+		mNoiseY[1].setup(j, 2.f * v, NULL);
+		mNoiseY[2].setup(j, v, NULL);
+		mCornerFracY[j] = y * inv_width;
+	}
+}
+
+void LLTerrainComposer::setupTexels()
+{
+	const S32 st_width = DETAIL_SIZE;
+	const S32 st_height = DETAIL_SIZE;
+	S32 width = mTextureRect.getWidth();
+	S32 height = mTextureRect.getHeight();
+	S32 values_width = mValuesRect.getWidth();
+	S32 values_height = mValuesRect.getHeight();
+
+	for (S32 i = 0; i < NUM_DETAILS; i++)
+	{
+		mDetailData[i] = mDetails[i]->getData();
+		mDetailDataSize[i] = mDetails[i]->getDataSize();
+	}
+
+	F32 tex_x_ratiof = (F32)mLayerWidth*mLayerScale / (F32)mTexWidth;
+	F32 tex_y_ratiof = (F32)mLayerWidth*mLayerScale / (F32)mTexHeight;
+
+	F32 st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mLayerWidth / (F32)mTexWidth);
+	F32 st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mLayerWidth / (F32)mTexHeight);
+	llassert(st_x_stride > 0.f);
+	llassert(st_y_stride > 0.f);
+
+	// LLViewerLayer::getValueScaled() at every column, then every row,
+	// clamped to the layer and to the values we have of it.
+	mSampleX0.resize(width);
+	mSampleX1.resize(width);
+	mSampleFracX.resize(width);
+	mDetailX.resize(width);
+	S32 tex_x_begin = mTextureRect.mLeft;
+	F32 sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
+	for (S32 i = 0; i < width; i++)
+	{
+		F32 x_frac = (tex_x_begin + i) * tex_x_ratiof * mLayerScaleInv;
+		S32 x1 = llfloor(x_frac);
+		S32 x2 = x1 + 1;
+		x_frac -= x1;
+		x1 = llclamp(x1, 0, mLayerWidth - 1) - mValuesRect.mLeft;
+		x2 = llclamp(x2, 0, mLayerWidth - 1) - mValuesRect.mLeft;
+		mSampleX0[i] = llclamp(x1, 0, values_width - 1);
+		mSampleX1[i] = llclamp(x2, 0, values_width - 1);
+		mSampleFracX[i] = x_frac;
+
+		mDetailX[i] = lltrunc(sti);
+		sti += st_x_stride;
+		if (sti >= st_width)
+		{
+			sti -= st_width;
+		}
+	}
+
+	mSampleY0.resize(height);
+	mSampleY1.resize(height);
+	mSampleFracY.resize(height);
+	mDetailY.resize(height);
+	S32 tex_y_begin = mTextureRect.mBottom;
+	F32 stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+	for (S32 j = 0; j < height; j++)
+	{
+		F32 y_frac = (tex_y_begin + j) * tex_y_ratiof * mLayerScaleInv;
+		S32 y1 = llfloor(y_frac);
+		S32 y2 = y1 + 1;
+		y_frac -= y1;
+		y1 = llclamp(y1, 0, mLayerWidth - 1) - mValuesRect.mBottom;
+		y2 = llclamp(y2, 0, mLayerWidth - 1) - mValuesRect.mBottom;
+		mSampleY0[j] = llclamp(y1, 0, values_height - 1) * values_width;
+		mSampleY1[j] = llclamp(y2, 0, values_height - 1) * values_width;
+		mSampleFracY[j] = y_frac;
+
+		mDetailY[j] = lltrunc(stj) * st_width;
+		stj += st_y_stride;
+		if (stj >= st_height)
+		{
+			stj -= st_height;
+		}
+	}
+}
+
+// static
+void LLTerrainComposer::useSSE2(BOOL use_sse2)
+{
+	BOOL sse2 = use_sse2 && hasSSE2();
+	sComposeValues = sse2 ? &composeValuesSSE2 : &composeValuesScalar;
+	sComposeTexels = sse2 ? &composeTexelsSSE2 : &composeTexelsScalar;
+}
+
+// static
+F32 LLTerrainComposer::noise2(const NoiseTables& noise, F32 x, F32 y)
+{
+	NoiseAxis axis_x;
+	NoiseAxis axis_y;
+	axis_x.resize(1);
+	axis_y.resize(1);
+	axis_x.setup(0, x, noise.mPerm);
+	axis_y.setup(0, y, NULL);
+
+	const S32* p = noise.mPerm;
+	const F32* q;
+	F32 rx0 = axis_x.mR0[0], rx1 = axis_x.mR1[0], sx = axis_x.mS[0];
+	F32 ry0 = axis_y.mR0[0], ry1 = axis_y.mR1[0], sy = axis_y.mS[0];
+	S32 i = axis_x.mB0[0], j = axis_x.mB1[0];
+	S32 by0 = axis_y.mB0[0], by1 = axis_y.mB1[0];
+
+	q = noise.mGrad2 + 2 * p[i + by0];
+	F32 u = rx0 * q[0] + ry0 * q[1];
+	q = noise.mGrad2 + 2 * p[j + by0];
+	F32 v = rx1 * q[0] + ry0 * q[1];
+	F32 a = u + sx * (v - u);
+
+	q = noise.mGrad2 + 2 * p[i + by1];
+	u = rx0 * q[0] + ry1 * q[1];
+	q = noise.mGrad2 + 2 * p[j + by1];
+	v = rx1 * q[0] + ry1 * q[1];
+	F32 b = u + sx * (v - u);
+
+	return a + sy * (b - a);
+}
+
+// static
+void LLTerrainComposer::composeValuesScalar(LLTerrainComposer& composer, S32 row, S32 begin, S32 end)
+{
+	const S32* p = composer.mNoise.mPerm;
+	const F32* g2 = composer.mNoise.mGrad2;
+	S32 offset = row * composer.mValuesRect.getWidth();
+	F32 y_frac = composer.mCornerFracY[row];
+
+	const F32* heights = &composer.mHeights[offset];
+	F32* values = &composer.mValues[offset];
+	for (S32 x = begin; x < end; x++)
+	{
+		F32 noise[NUM_OCTAVES];
+		for (S32 k = 0; k < NUM_OCTAVES; k++)
+		{
+			const NoiseAxis& nx = composer.mNoiseX[k];
+			const NoiseAxis& ny = composer.mNoiseY[k];
+			S32 i = nx.mB0[x], j = nx.mB1[x];
+			S32 by0 = ny.mB0[row], by1 = ny.mB1[row];
+			F32 rx0 = nx.mR0[x], rx1 = nx.mR1[x], sx = nx.mS[x];
+			F32 ry0 = ny.mR0[row], ry1 = ny.mR1[row];
+			const F32* q;
+
+			q = g2 + 2 * p[i + by0];
+			F32 u = rx0 * q[0] + ry0 * q[1];
+			q = g2 + 2 * p[j + by0];
+			F32 v = rx1 * q[0] + ry0 * q[1];
+			F32 a = u + sx * (v - u);
+
+			q = g2 + 2 * p[i + by1];
+			u = rx0 * q[0] + ry1 * q[1];
+			q = g2 + 2 * p[j + by1];
+			v = rx1 * q[0] + ry1 * q[1];
+			F32 b = u + sx * (v - u);
+
+			noise[k] = a + ny.mS[row] * (b - a);
+		}
+
+		// Low frequency for large divisions, turbulence2() at a frequency of
+		// 2 for the high.
+		F32 twiddle = noise[0] * LOW_FREQUENCY_MAGNITUDE;
+		twiddle += (noise[1] / 2.f + noise[2]) * SLOPE_SQUARED;
+		twiddle *= NOISE_MAGNITUDE;
+
+		F32 x_frac = composer.mCornerFracX[x];
+		F32 start_height = bilinear(composer.mStartHeight[0], composer.mStartHeight[1],
+									composer.mStartHeight[2], composer.mStartHeight[3],
+									x_frac, y_frac);
+		F32 height_range = bilinear(composer.mHeightRange[0], composer.mHeightRange[1],
+									composer.mHeightRange[2], composer.mHeightRange[3],
+									x_frac, y_frac);
+
+		F32 scaled_noisy_height = (heights[x] + twiddle - start_height) * NUM_TEXTURES / height_range;
+		scaled_noisy_height = llmax(0.f, scaled_noisy_height);
+		scaled_noisy_height = llmin(3.f, scaled_noisy_height);
+		values[x] = scaled_noisy_height;
+	}
+}
+
+// static
+void LLTerrainComposer::composeTexelsScalar(LLTerrainComposer& composer, S32 row, S32 begin, S32 end)
+{
+	const F32* values0 = &composer.mValues[composer.mSampleY0[row]];
+	const F32* values1 = &composer.mValues[composer.mSampleY1[row]];
+	F32 y_frac = composer.mSampleFracY[row];
+	S32 detail_y = composer.mDetailY[row];
+	U8* dst = composer.mTexture->getData() + (row * composer.mTextureRect.getWidth() + begin) * 3;
+
+	for (S32 x = begin; x < end; x++, dst += 3)
+	{
+		F32 x_frac = composer.mSampleFracX[x];
+		F32 left1 = values0[composer.mSampleX0[x]];
+		F32 right1 = values0[composer.mSampleX1[x]];
+		F32 left2 = values1[composer.mSampleX0[x]];
+		F32 right2 = values1[composer.mSampleX1[x]];
+		F32 interp1 = left1 - x_frac * (left1 - right1);
+		F32 interp2 = left2 - x_frac * (left2 - right2);
+		F32 composition = interp1 - y_frac * (interp1 - interp2);
+
+		S32 tex0 = llfloor(composition);
+		tex0 = llclamp(tex0, 0, 3);
+		composition -= tex0;
+		S32 tex1 = llclamp(tex0 + 1, 0, 3);
+
+		S32 st_offset = (composer.mDetailX[x] + detail_y) * 3;
+		for (S32 k = 0; k < 3; k++, st_offset++)
+		{
+			if (st_offset < composer.mDetailDataSize[tex0] && st_offset < composer.mDetailDataSize[tex1])
+			{
+				F32 a = composer.mDetailData[tex0][st_offset];
+				F32 b = composer.mDetailData[tex1][st_offset];
+				dst[k] = (U8)lltrunc(a + composition * (b - a));
+			}
+		}
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLTerrainComposerThread::LLTerrainComposerThread(bool threaded)
+	: LLQueuedThread("terraincomposer", threaded)
+{
+}
+
+// MAIN THREAD
+LLTerrainComposerThread::handle_t LLTerrainComposerThread::compose(terrain_composer_vec_t& batch, U32 priority)
+{
+	handle_t handle = generateHandle();
+	ComposeRequest* req = new ComposeRequest(handle, priority, batch);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLTerrainComposerThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+BOOL LLTerrainComposerThread::getResult(handle_t handle, terrain_composer_vec_t& batch)
+{
+	batch.clear();
+	status_t status = getRequestStatus(handle);
+	if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+	{
+		return FALSE;
+	}
+	ComposeRequest* req = (ComposeRequest*)getRequest(handle);
+	if (req)
+	{
+		req->takeBatch(batch);
+		if (status != STATUS_COMPLETE)
+		{
+			for_each(batch.begin(), batch.end(), DeletePointer());
+			batch.clear();
+		}
+		completeRequest(handle);
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------------
+
+LLTerrainComposerThread::ComposeRequest::ComposeRequest(handle_t handle, U32 priority,
+														terrain_composer_vec_t& batch)
+	: LLQueuedThread::QueuedRequest(handle, priority, 0)
+{
+	mBatch.swap(batch);
+}
+
+LLTerrainComposerThread::ComposeRequest::~ComposeRequest()
+{
+	for_each(mBatch.begin(), mBatch.end(), DeletePointer());
+}
+
+bool LLTerrainComposerThread::ComposeRequest::processRequest()
+{
+	for (terrain_composer_vec_t::iterator iter = mBatch.begin(); iter != mBatch.end(); ++iter)
+	{
+		(*iter)->compose();
+	}
+	return true;
+}
+
+void LLTerrainComposerThread::ComposeRequest::finishRequest(bool completed)
+{
+	// Collected by LLTerrainComposerThread::getResult()
+}
+
+// MAIN THREAD
+void LLTerrainComposerThread::ComposeRequest::takeBatch(terrain_composer_vec_t& batch)
+{
+	batch.clear();
+	mBatch.swap(batch);
+}
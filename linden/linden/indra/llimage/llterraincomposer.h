@@ -0,0 +1,241 @@
+/**
+ * @file llterraincomposer.h
+ * @brief Composes terrain patch textures from the detail textures, on any thread
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#ifndef LL_LLTERRAINCOMPOSER_H
+#define LL_LLTERRAINCOMPOSER_H
+
+#include <vector>
+
+#include "llimage.h"
+#include "llqueuedthread.h"
+#include "llrect.h"
+
+// Works out the composition values and the surface texture of a terrain
+// patch exactly as LLVLComposition::generateHeights() and generateTexture()
+// do, from a copy of everything they read, so that it can be done on any
+// thread.
+//
+// A composition value is the height of a grid point, pushed up or down by
+// noise and scaled by the start height and range of the corners, which
+// picks the pair of detail textures blended for the texels around it.
+// The values of the patch either are generated from its heights or, when
+// they already were, are copied in from the composition layer.
+class LLTerrainComposer
+{
+public:
+	enum { NUM_DETAILS = 4 };
+	enum { DETAIL_SIZE = 128 };		// detail textures are 128x128 RGB
+
+	// The tables noise2() looks its lattice up in: the permutation, of ints,
+	// and the gradients, of pairs of floats, 2 * 256 + 2 entries each.
+	struct NoiseTables
+	{
+		const S32* mPerm;
+		const F32* mGrad2;
+	};
+
+	// Composes into a layer of layer_width grid points on a side,
+	// layer_scale meters apart.
+	LLTerrainComposer(const NoiseTables& noise, S32 layer_width, F32 layer_scale, void* user_data = NULL);
+
+	void* getUserData() const						{ return mUserData; }
+
+	// The grid points whose values are generated or copied in, from
+	// rect.mLeft to rect.mRight - 1, and rect.mBottom to rect.mTop - 1.
+	void setValuesRect(const LLRect& rect, BOOL generate);
+	const LLRect& getValuesRect() const				{ return mValuesRect; }
+	BOOL getGeneratesValues() const					{ return mGenerate; }
+
+	// For generating: where the layer is in the world, the start heights
+	// and height ranges of its corners, SOUTHWEST, SOUTHEAST, NORTHWEST and
+	// NORTHEAST, and the height of every point.
+	void setOrigin(F64 x, F64 y)					{ mOriginX = x; mOriginY = y; }
+	void setCorners(const F32* start_heights, const F32* height_ranges);
+	void setHeight(S32 x, S32 y, F32 height)		{ mHeights[valueIndex(x, y)] = height; }
+	// For copying.
+	void setValue(S32 x, S32 y, F32 value)			{ mValues[valueIndex(x, y)] = value; }
+	F32 getValue(S32 x, S32 y) const				{ return mValues[valueIndex(x, y)]; }
+
+	// Also composes the texels of a texture of tex_width by tex_height that
+	// cover the grid points in rect, from the detail textures repeated
+	// tex_scale times across the layer. The values rect has to reach a point
+	// past rect to the north and east, where those are in the layer.
+	void setTexture(const LLRect& rect, S32 tex_width, S32 tex_height, F32 tex_scale_x, F32 tex_scale_y);
+	// DETAIL_SIZE square and RGB. They must not change until compose() is
+	// done with them.
+	void setDetail(S32 i, LLImageRaw* image)		{ mDetails[i] = image; }
+	BOOL hasTexture() const							{ return mTexture.notNull(); }
+
+	// Safe on any thread, as long as nothing else uses the composer meanwhile.
+	void compose();
+
+	// Results of compose() when there is a texture: the texels, which go at
+	// getTextureRect() in it.
+	const LLRect& getTextureRect() const			{ return mTextureRect; }
+	LLImageRaw* getTexture() const					{ return mTexture; }
+
+	// The noise2() of newview's noise.cpp, with the same results.
+	static F32 noise2(const NoiseTables& noise, F32 x, F32 y);
+
+	// Compose columns begin to end - 1 of a row of values or texels.
+	//
+	// As with LLVertexXform, these are the ones to call, and the SSE2
+	// versions give exactly the same results as the scalar ones.
+	typedef void (*row_func_t)(LLTerrainComposer& composer, S32 row, S32 begin, S32 end);
+
+	static row_func_t sComposeValues;
+	static row_func_t sComposeTexels;
+
+	// Falls back to the scalar versions if this build has no SSE2 versions.
+	// Don't turn SSE2 on for CPUs that lack it.
+	static void useSSE2(BOOL use_sse2);
+	static BOOL usingSSE2()							{ return sComposeValues == &composeValuesSSE2; }
+	// Whether the SSE2 versions were compiled in.
+	static BOOL hasSSE2();
+
+	static void composeValuesScalar(LLTerrainComposer& composer, S32 row, S32 begin, S32 end);
+	static void composeTexelsScalar(LLTerrainComposer& composer, S32 row, S32 begin, S32 end);
+	// llterraincomposer_sse2.cpp
+	static void composeValuesSSE2(LLTerrainComposer& composer, S32 row, S32 begin, S32 end);
+	static void composeTexelsSSE2(LLTerrainComposer& composer, S32 row, S32 begin, S32 end);
+
+private:
+	// noise2() split up along one axis, for a row or column of points: the
+	// lattice cells either side and the offsets into them, the s curve
+	// weight, and along x, the permutations of the cells.
+	struct NoiseAxis
+	{
+		std::vector<S32> mB0;
+		std::vector<S32> mB1;
+		std::vector<F32> mR0;
+		std::vector<F32> mR1;
+		std::vector<F32> mS;
+
+		void resize(S32 size);
+		void setup(S32 i, F32 v, const S32* perm);
+	};
+
+	// Generating takes noise2() at three scales of the lattice coordinates.
+	enum { NUM_OCTAVES = 3 };
+
+	S32 valueIndex(S32 x, S32 y) const
+	{
+		return (y - mValuesRect.mBottom) * mValuesRect.getWidth() + x - mValuesRect.mLeft;
+	}
+
+	void setupValues();
+	void setupTexels();
+
+	NoiseTables mNoise;
+	S32 mLayerWidth;
+	F32 mLayerScale;
+	F32 mLayerScaleInv;
+	void* mUserData;
+
+	LLRect mValuesRect;
+	BOOL mGenerate;
+	F64 mOriginX;
+	F64 mOriginY;
+	F32 mStartHeight[4];
+	F32 mHeightRange[4];
+	std::vector<F32> mHeights;
+	std::vector<F32> mValues;
+
+	// Values along the rows and columns.
+	NoiseAxis mNoiseX[NUM_OCTAVES];
+	NoiseAxis mNoiseY[NUM_OCTAVES];
+	std::vector<F32> mCornerFracX;
+	std::vector<F32> mCornerFracY;
+
+	LLRect mGridRect;
+	S32 mTexWidth;
+	S32 mTexHeight;
+	F32 mTexScaleX;
+	F32 mTexScaleY;
+	LLPointer<LLImageRaw> mDetails[NUM_DETAILS];
+	LLRect mTextureRect;
+	LLPointer<LLImageRaw> mTexture;
+	const U8* mDetailData[NUM_DETAILS];
+	S32 mDetailDataSize[NUM_DETAILS];
+
+	// Texels along the rows and columns: the values they are interpolated
+	// between, as offsets into mValues, and the texel of the detail
+	// textures they take, as an offset into those.
+	std::vector<S32> mSampleX0;
+	std::vector<S32> mSampleX1;
+	std::vector<F32> mSampleFracX;
+	std::vector<S32> mDetailX;
+	std::vector<S32> mSampleY0;
+	std::vector<S32> mSampleY1;
+	std::vector<F32> mSampleFracY;
+	std::vector<S32> mDetailY;
+};
+
+typedef std::vector<LLTerrainComposer*> terrain_composer_vec_t;
+
+// Runs LLTerrainComposers on a thread of its own, a batch at a time.
+class LLTerrainComposerThread : public LLQueuedThread
+{
+public:
+	class ComposeRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~ComposeRequest(); // use deleteRequest()
+
+	public:
+		// Takes ownership of the composers in batch, and empties it.
+		ComposeRequest(handle_t handle, U32 priority, terrain_composer_vec_t& batch);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		void takeBatch(terrain_composer_vec_t& batch);
+
+	private:
+		terrain_composer_vec_t mBatch;
+	};
+
+public:
+	LLTerrainComposerThread(bool threaded = true);
+
+	// Takes ownership of the composers in batch, and empties it.
+	handle_t compose(terrain_composer_vec_t& batch, U32 priority = PRIORITY_NORMAL);
+
+	// Returns FALSE while the request is still being worked on. Otherwise
+	// ends the request and hands back its composers, with their results
+	// filled in, or none if it was aborted.
+	BOOL getResult(handle_t handle, terrain_composer_vec_t& batch);
+};
+
+#endif // LL_LLTERRAINCOMPOSER_H
@@ -0,0 +1,280 @@
+/**
+ * @file llterraincomposer_sse2.cpp
+ * @brief SSE2 versions of the LLTerrainComposer kernels
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llterraincomposer.h"
+
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#if LL_VECTORIZE && (defined(__SSE2__) || _M_IX86_FP >= 2 || defined(_M_X64))
+
+#include <emmintrin.h>
+
+// static
+BOOL LLTerrainComposer::hasSSE2()
+{
+	return TRUE;
+}
+
+// Component i of the gradients q points at.
+inline __m128 gather(const F32* const* q, S32 i)
+{
+	return _mm_setr_ps(q[0][i], q[1][i], q[2][i], q[3][i]);
+}
+
+// Four points at a time. The lattice and gradient lookups are scalar, the
+// arithmetic is done the same way in the same order as the scalar version.
+//
+// static
+void LLTerrainComposer::composeValuesSSE2(LLTerrainComposer& composer, S32 row, S32 begin, S32 end)
+{
+	const S32* p = composer.mNoise.mPerm;
+	const F32* g2 = composer.mNoise.mGrad2;
+	S32 offset = row * composer.mValuesRect.getWidth();
+
+	const __m128 y_frac = _mm_set1_ps(composer.mCornerFracY[row]);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 inv_y_frac = _mm_sub_ps(one, y_frac);
+	__m128 start_height[4];
+	__m128 height_range[4];
+	for (S32 i = 0; i < 4; i++)
+	{
+		start_height[i] = _mm_set1_ps(composer.mStartHeight[i]);
+		height_range[i] = _mm_set1_ps(composer.mHeightRange[i]);
+	}
+
+	S32 x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		__m128 noise[NUM_OCTAVES];
+		for (S32 k = 0; k < NUM_OCTAVES; k++)
+		{
+			const NoiseAxis& nx = composer.mNoiseX[k];
+			const NoiseAxis& ny = composer.mNoiseY[k];
+			S32 by0 = ny.mB0[row], by1 = ny.mB1[row];
+
+			// The gradients at the corners of the four lattice cells.
+			const S32* b0 = &nx.mB0[x];
+			const S32* b1 = &nx.mB1[x];
+			const F32* q00[4];
+			const F32* q10[4];
+			const F32* q01[4];
+			const F32* q11[4];
+			for (S32 l = 0; l < 4; l++)
+			{
+				q00[l] = g2 + 2 * p[b0[l] + by0];
+				q10[l] = g2 + 2 * p[b1[l] + by0];
+				q01[l] = g2 + 2 * p[b0[l] + by1];
+				q11[l] = g2 + 2 * p[b1[l] + by1];
+			}
+
+			__m128 rx0 = _mm_loadu_ps(&nx.mR0[x]);
+			__m128 rx1 = _mm_loadu_ps(&nx.mR1[x]);
+			__m128 sx = _mm_loadu_ps(&nx.mS[x]);
+			__m128 ry0 = _mm_set1_ps(ny.mR0[row]);
+			__m128 ry1 = _mm_set1_ps(ny.mR1[row]);
+			__m128 sy = _mm_set1_ps(ny.mS[row]);
+
+			__m128 u = _mm_add_ps(_mm_mul_ps(rx0, gather(q00, 0)), _mm_mul_ps(ry0, gather(q00, 1)));
+			__m128 v = _mm_add_ps(_mm_mul_ps(rx1, gather(q10, 0)), _mm_mul_ps(ry0, gather(q10, 1)));
+			__m128 a = _mm_add_ps(u, _mm_mul_ps(sx, _mm_sub_ps(v, u)));
+
+			u = _mm_add_ps(_mm_mul_ps(rx0, gather(q01, 0)), _mm_mul_ps(ry1, gather(q01, 1)));
+			v = _mm_add_ps(_mm_mul_ps(rx1, gather(q11, 0)), _mm_mul_ps(ry1, gather(q11, 1)));
+			__m128 b = _mm_add_ps(u, _mm_mul_ps(sx, _mm_sub_ps(v, u)));
+
+			noise[k] = _mm_add_ps(a, _mm_mul_ps(sy, _mm_sub_ps(b, a)));
+		}
+
+		__m128 twiddle = _mm_mul_ps(noise[0], _mm_set1_ps(6.5f));
+		__m128 turbulence = _mm_add_ps(_mm_div_ps(noise[1], _mm_set1_ps(2.f)), noise[2]);
+		twiddle = _mm_add_ps(twiddle, _mm_mul_ps(turbulence, _mm_set1_ps(1.5f * 1.5f)));
+		twiddle = _mm_mul_ps(twiddle, _mm_set1_ps(2.f));
+
+		// bilinear() of the corners.
+		__m128 x_frac = _mm_loadu_ps(&composer.mCornerFracX[x]);
+		__m128 inv_x_frac = _mm_sub_ps(one, x_frac);
+		__m128 w00 = _mm_mul_ps(inv_x_frac, inv_y_frac);
+		__m128 w10 = _mm_mul_ps(x_frac, inv_y_frac);
+		__m128 w01 = _mm_mul_ps(inv_x_frac, y_frac);
+		__m128 w11 = _mm_mul_ps(x_frac, y_frac);
+		__m128 start = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w00, start_height[0]),
+															   _mm_mul_ps(w10, start_height[2])),
+												_mm_mul_ps(w01, start_height[1])),
+								  _mm_mul_ps(w11, start_height[3]));
+		__m128 range = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(w00, height_range[0]),
+															   _mm_mul_ps(w10, height_range[2])),
+												_mm_mul_ps(w01, height_range[1])),
+								  _mm_mul_ps(w11, height_range[3]));
+
+		__m128 height = _mm_loadu_ps(&composer.mHeights[offset + x]);
+		__m128 value = _mm_sub_ps(_mm_add_ps(height, twiddle), start);
+		value = _mm_div_ps(_mm_mul_ps(value, _mm_set1_ps(4.f)), range);
+		value = _mm_max_ps(_mm_setzero_ps(), value);
+		value = _mm_min_ps(_mm_set1_ps(3.f), value);
+		_mm_storeu_ps(&composer.mValues[offset + x], value);
+	}
+
+	composeValuesScalar(composer, row, x, end);
+}
+
+// Four texels at a time: the composition values are interpolated and split
+// into a pair of detail textures and a fraction with SSE2, the detail texels
+// are looked up one by one, and their channels blended with SSE2.
+//
+// static
+void LLTerrainComposer::composeTexelsSSE2(LLTerrainComposer& composer, S32 row, S32 begin, S32 end)
+{
+	const F32* values0 = &composer.mValues[composer.mSampleY0[row]];
+	const F32* values1 = &composer.mValues[composer.mSampleY1[row]];
+	const __m128 y_frac = _mm_set1_ps(composer.mSampleFracY[row]);
+	S32 detail_y = composer.mDetailY[row];
+	U8* dst = composer.mTexture->getData() + (row * composer.mTextureRect.getWidth()) * 3;
+
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i three = _mm_set1_epi32(3);
+
+	S32 x = begin;
+	for (; x + 4 <= end; x += 4)
+	{
+		const S32* x0 = &composer.mSampleX0[x];
+		const S32* x1 = &composer.mSampleX1[x];
+		__m128 left1 = _mm_setr_ps(values0[x0[0]], values0[x0[1]], values0[x0[2]], values0[x0[3]]);
+		__m128 right1 = _mm_setr_ps(values0[x1[0]], values0[x1[1]], values0[x1[2]], values0[x1[3]]);
+		__m128 left2 = _mm_setr_ps(values1[x0[0]], values1[x0[1]], values1[x0[2]], values1[x0[3]]);
+		__m128 right2 = _mm_setr_ps(values1[x1[0]], values1[x1[1]], values1[x1[2]], values1[x1[3]]);
+		__m128 x_frac = _mm_loadu_ps(&composer.mSampleFracX[x]);
+		__m128 interp1 = _mm_sub_ps(left1, _mm_mul_ps(x_frac, _mm_sub_ps(left1, right1)));
+		__m128 interp2 = _mm_sub_ps(left2, _mm_mul_ps(x_frac, _mm_sub_ps(left2, right2)));
+		__m128 composition = _mm_sub_ps(interp1, _mm_mul_ps(y_frac, _mm_sub_ps(interp1, interp2)));
+
+		// llfloor(), clamped to 0 to 3.
+		__m128i tex0 = _mm_cvttps_epi32(composition);
+		tex0 = _mm_add_epi32(tex0, _mm_castps_si128(_mm_cmpgt_ps(_mm_cvtepi32_ps(tex0), composition)));
+		tex0 = _mm_andnot_si128(_mm_cmplt_epi32(tex0, zero), tex0);
+		__m128i over = _mm_cmpgt_epi32(tex0, three);
+		tex0 = _mm_or_si128(_mm_and_si128(over, three), _mm_andnot_si128(over, tex0));
+		composition = _mm_sub_ps(composition, _mm_cvtepi32_ps(tex0));
+		__m128i tex1 = _mm_add_epi32(tex0, _mm_set1_epi32(1));
+		over = _mm_cmpgt_epi32(tex1, three);
+		tex1 = _mm_or_si128(_mm_and_si128(over, three), _mm_andnot_si128(over, tex1));
+
+		S32 t0[4], t1[4];
+		_mm_storeu_si128((__m128i*)t0, tex0);
+		_mm_storeu_si128((__m128i*)t1, tex1);
+
+		// The texels of both detail textures, RGB and a spare byte.
+		U32 a[4], b[4];
+		BOOL in_range = TRUE;
+		for (S32 l = 0; l < 4; l++)
+		{
+			S32 st_offset = (composer.mDetailX[x + l] + detail_y) * 3;
+			if (st_offset + 2 >= composer.mDetailDataSize[t0[l]] ||
+				st_offset + 2 >= composer.mDetailDataSize[t1[l]])
+			{
+				in_range = FALSE;
+				break;
+			}
+			const U8* texel0 = composer.mDetailData[t0[l]] + st_offset;
+			const U8* texel1 = composer.mDetailData[t1[l]] + st_offset;
+			a[l] = texel0[0] | (texel0[1] << 8) | (texel0[2] << 16);
+			b[l] = texel1[0] | (texel1[1] << 8) | (texel1[2] << 16);
+		}
+		if (!in_range)
+		{
+			// Some channels come from past the end of a detail texture, and
+			// are skipped.
+			composeTexelsScalar(composer, row, x, x + 4);
+			continue;
+		}
+
+		__m128i a8 = _mm_setr_epi32(a[0], a[1], a[2], a[3]);
+		__m128i b8 = _mm_setr_epi32(b[0], b[1], b[2], b[3]);
+		__m128i a16[2] = { _mm_unpacklo_epi8(a8, zero), _mm_unpackhi_epi8(a8, zero) };
+		__m128i b16[2] = { _mm_unpacklo_epi8(b8, zero), _mm_unpackhi_epi8(b8, zero) };
+		__m128 fraction[4] = { _mm_shuffle_ps(composition, composition, _MM_SHUFFLE(0, 0, 0, 0)),
+							   _mm_shuffle_ps(composition, composition, _MM_SHUFFLE(1, 1, 1, 1)),
+							   _mm_shuffle_ps(composition, composition, _MM_SHUFFLE(2, 2, 2, 2)),
+							   _mm_shuffle_ps(composition, composition, _MM_SHUFFLE(3, 3, 3, 3)) };
+		__m128i result[4];
+		for (S32 l = 0; l < 4; l++)
+		{
+			__m128 ta = _mm_cvtepi32_ps(l & 1 ? _mm_unpackhi_epi16(a16[l >> 1], zero) : _mm_unpacklo_epi16(a16[l >> 1], zero));
+			__m128 tb = _mm_cvtepi32_ps(l & 1 ? _mm_unpackhi_epi16(b16[l >> 1], zero) : _mm_unpacklo_epi16(b16[l >> 1], zero));
+			result[l] = _mm_cvttps_epi32(_mm_add_ps(ta, _mm_mul_ps(fraction[l], _mm_sub_ps(tb, ta))));
+		}
+		__m128i packed = _mm_packus_epi16(_mm_packs_epi32(result[0], result[1]), _mm_packs_epi32(result[2], result[3]));
+
+		// Each texel's spare byte is overwritten by the next one's red.
+		U8* texel = dst + x * 3;
+		for (S32 l = 0; l < 3; l++)
+		{
+			U32 rgb = _mm_cvtsi128_si32(packed);
+			memcpy(texel + l * 3, &rgb, 4);
+			packed = _mm_srli_si128(packed, 4);
+		}
+		U32 rgb = _mm_cvtsi128_si32(packed);
+		memcpy(texel + 9, &rgb, 3);
+	}
+
+	composeTexelsScalar(composer, row, x, end);
+}
+
+#else
+
+// static
+BOOL LLTerrainComposer::hasSSE2()
+{
+	return FALSE;
+}
+
+// static
+void LLTerrainComposer::composeValuesSSE2(LLTerrainComposer& composer, S32 row, S32 begin, S32 end)
+{
+	composeValuesScalar(composer, row, begin, end);
+}
+
+// static
+void LLTerrainComposer::composeTexelsSSE2(LLTerrainComposer& composer, S32 row, S32 begin, S32 end)
+{
+	composeTexelsScalar(composer, row, begin, end);
+}
+
+#endif
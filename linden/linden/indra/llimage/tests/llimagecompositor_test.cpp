@@ -0,0 +1,641 @@
+/**
+ * @file llimagecompositor_test.cpp
+ * @brief LLImageCompositor unit tests and bake benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "../llimagecompositor.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "lltimer.h"
+#include "v4color.h"
+
+namespace
+{
+	// Off by a step of rounding for the texel, one for each product and
+	// one for the sum, and the rounded fragment alpha can carry another
+	// into a source alpha blend factor.
+	const S32 TOLERANCE = 3;
+
+	U8 random_byte()
+	{
+		return (U8)ll_rand(256);
+	}
+
+	LLPointer<LLImageRaw> random_image(S32 width, S32 height, S32 comps)
+	{
+		LLPointer<LLImageRaw> image = new LLImageRaw(width, height, comps);
+		U8* data = image->getData();
+		for (S32 i = 0; i < width * height * comps; i++)
+		{
+			// Plenty of fully transparent and opaque texels, as in real layers.
+			S32 r = ll_rand(8);
+			data[i] = r == 0 ? 0 : (r == 1 ? 255 : random_byte());
+		}
+		return image;
+	}
+
+	// One draw, for both the compositor and the reference.
+	struct Op
+	{
+		LLColor4 mColor;
+		LLImageCompositor::EBlendFactor mSourceFactor;
+		LLImageCompositor::EBlendFactor mDestFactor;
+		BOOL mWriteColor;
+		BOOL mWriteAlpha;
+		BOOL mAlphaTest;
+		LLImageCompositor::ETextureBlendType mTextureBlendType;
+		LLPointer<LLImageRaw> mImage;
+		BOOL mIsAlpha;
+		BOOL mUseMipMaps;
+
+		Op()
+			: mColor(LLColor4::white),
+			  mSourceFactor(LLImageCompositor::BF_ONE),
+			  mDestFactor(LLImageCompositor::BF_ZERO),
+			  mWriteColor(TRUE),
+			  mWriteAlpha(TRUE),
+			  mAlphaTest(FALSE),
+			  mTextureBlendType(LLImageCompositor::TB_MULT),
+			  mIsAlpha(FALSE),
+			  mUseMipMaps(TRUE)
+		{
+		}
+
+		void record(LLImageCompositor& compositor) const
+		{
+			compositor.setColor(mColor);
+			compositor.setBlendFunc(mSourceFactor, mDestFactor);
+			compositor.setColorMask(mWriteColor, mWriteAlpha);
+			compositor.setAlphaTest(mAlphaTest);
+			compositor.setTextureBlendType(mTextureBlendType);
+			if (mImage.notNull())
+			{
+				compositor.drawImage(mImage, mIsAlpha, mUseMipMaps);
+			}
+			else
+			{
+				compositor.drawRect();
+			}
+		}
+	};
+
+	// A float model of the texture environment, alpha test and blending of
+	// the GL fixed function pipeline, over an 8 bit frame buffer.
+	class Reference
+	{
+	public:
+		Reference(S32 width, S32 height)
+			: mWidth(width),
+			  mHeight(height),
+			  mCanvas(width * height * 4, 0),
+			  mAmbiguous(width * height, FALSE)
+		{
+		}
+
+		void run(const Op& op)
+		{
+			std::vector<F32> level;
+			S32 level_width = 0;
+			S32 level_height = 0;
+			S32 comps = 0;
+			if (op.mImage.notNull())
+			{
+				makeLevel(op.mImage, op.mUseMipMaps, level, level_width, level_height);
+				comps = op.mImage->getComponents();
+			}
+
+			for (S32 y = 0; y < mHeight; y++)
+			{
+				for (S32 x = 0; x < mWidth; x++)
+				{
+					U8* dst = &mCanvas[(y * mWidth + x) * 4];
+					F32 frag[4];
+					for (S32 c = 0; c < 4; c++)
+					{
+						frag[c] = op.mColor.mV[c];
+					}
+					if (comps)
+					{
+						F32 texel[4];
+						sample(level, level_width, level_height, comps, x, y, texel);
+						F32 rgba[4];
+						F32 fill[4];
+						for (S32 c = 0; c < 4; c++)
+						{
+							fill[c] = op.mTextureBlendType == LLImageCompositor::TB_MULT ? 1.f : op.mColor.mV[c];
+						}
+						expand(texel, comps, op.mIsAlpha, fill, rgba);
+						for (S32 c = 0; c < 4; c++)
+						{
+							frag[c] = op.mTextureBlendType == LLImageCompositor::TB_MULT ? rgba[c] * op.mColor.mV[c] : rgba[c];
+						}
+					}
+
+					if (op.mAlphaTest)
+					{
+						// Hardware precision decides fragments this close.
+						if (fabs(frag[3] - 0.01f) < 1.f / 255.f)
+						{
+							mAmbiguous[y * mWidth + x] = TRUE;
+						}
+						if (frag[3] <= 0.01f)
+						{
+							continue;
+						}
+					}
+
+					F32 d[4];
+					for (S32 c = 0; c < 4; c++)
+					{
+						d[c] = dst[c] / 255.f;
+					}
+					F32 sf = factor(op.mSourceFactor, frag[3], d[3]);
+					F32 df = factor(op.mDestFactor, frag[3], d[3]);
+					for (S32 c = 0; c < 4; c++)
+					{
+						if (c < 3 ? op.mWriteColor : op.mWriteAlpha)
+						{
+							F32 result = llclamp(frag[c] * sf + d[c] * df, 0.f, 1.f);
+							dst[c] = (U8)llround(result * 255.f);
+						}
+					}
+				}
+			}
+		}
+
+		const U8* getPixel(S32 x, S32 y) const		{ return &mCanvas[(y * mWidth + x) * 4]; }
+		BOOL isAmbiguous(S32 x, S32 y) const		{ return mAmbiguous[y * mWidth + x]; }
+
+	private:
+		static F32 factor(LLImageCompositor::EBlendFactor factor, F32 src_alpha, F32 dst_alpha)
+		{
+			switch (factor)
+			{
+			case LLImageCompositor::BF_ZERO:					return 0.f;
+			case LLImageCompositor::BF_ONE:						return 1.f;
+			case LLImageCompositor::BF_SOURCE_ALPHA:			return src_alpha;
+			case LLImageCompositor::BF_ONE_MINUS_SOURCE_ALPHA:	return 1.f - src_alpha;
+			case LLImageCompositor::BF_DEST_ALPHA:				return dst_alpha;
+			default:											return 1.f - dst_alpha;
+			}
+		}
+
+		static void expand(const F32* texel, S32 comps, BOOL is_alpha, const F32* fill, F32* rgba)
+		{
+			switch (comps)
+			{
+			case 1:
+				rgba[0] = is_alpha ? fill[0] : texel[0];
+				rgba[1] = is_alpha ? fill[1] : texel[0];
+				rgba[2] = is_alpha ? fill[2] : texel[0];
+				rgba[3] = is_alpha ? texel[0] : fill[3];
+				break;
+			case 2:
+				rgba[0] = rgba[1] = rgba[2] = texel[0];
+				rgba[3] = texel[1];
+				break;
+			case 3:
+				rgba[0] = texel[0];
+				rgba[1] = texel[1];
+				rgba[2] = texel[2];
+				rgba[3] = fill[3];
+				break;
+			default:
+				for (S32 c = 0; c < 4; c++)
+				{
+					rgba[c] = texel[c];
+				}
+				break;
+			}
+		}
+
+		// The mip level GL would sample, by averaging texels in float.
+		void makeLevel(LLImageRaw* image, BOOL use_mipmaps, std::vector<F32>& level, S32& width, S32& height) const
+		{
+			S32 comps = image->getComponents();
+			width = image->getWidth();
+			height = image->getHeight();
+			level.resize(width * height * comps);
+			for (S32 i = 0; i < width * height * comps; i++)
+			{
+				level[i] = image->getData()[i] / 255.f;
+			}
+			while (use_mipmaps && (width * width > 2 * mWidth * mWidth || height * height > 2 * mHeight * mHeight))
+			{
+				S32 half_width = llmax(width / 2, 1);
+				S32 half_height = llmax(height / 2, 1);
+				std::vector<F32> half(half_width * half_height * comps);
+				for (S32 y = 0; y < half_height; y++)
+				{
+					for (S32 x = 0; x < half_width; x++)
+					{
+						S32 x0 = llmin(x * 2, width - 1), x1 = llmin(x * 2 + 1, width - 1);
+						S32 y0 = llmin(y * 2, height - 1), y1 = llmin(y * 2 + 1, height - 1);
+						for (S32 c = 0; c < comps; c++)
+						{
+							half[(y * half_width + x) * comps + c] =
+								(level[(y0 * width + x0) * comps + c] + level[(y0 * width + x1) * comps + c]
+								 + level[(y1 * width + x0) * comps + c] + level[(y1 * width + x1) * comps + c]) * 0.25f;
+						}
+					}
+				}
+				level.swap(half);
+				width = half_width;
+				height = half_height;
+			}
+		}
+
+		// GL_LINEAR, GL_CLAMP_TO_EDGE
+		void sample(const std::vector<F32>& level, S32 width, S32 height, S32 comps, S32 x, S32 y, F32* texel) const
+		{
+			F32 u = llclamp(((F32)x + 0.5f) * width / mWidth - 0.5f, 0.f, (F32)(width - 1));
+			F32 v = llclamp(((F32)y + 0.5f) * height / mHeight - 0.5f, 0.f, (F32)(height - 1));
+			S32 x0 = (S32)u, y0 = (S32)v;
+			S32 x1 = llmin(x0 + 1, width - 1), y1 = llmin(y0 + 1, height - 1);
+			F32 fx = u - x0, fy = v - y0;
+			for (S32 c = 0; c < comps; c++)
+			{
+				F32 top = level[(y0 * width + x0) * comps + c] * (1.f - fx) + level[(y0 * width + x1) * comps + c] * fx;
+				F32 bottom = level[(y1 * width + x0) * comps + c] * (1.f - fx) + level[(y1 * width + x1) * comps + c] * fx;
+				texel[c] = top * (1.f - fy) + bottom * fy;
+			}
+		}
+
+		S32 mWidth;
+		S32 mHeight;
+		std::vector<U8> mCanvas;
+		std::vector<BOOL> mAmbiguous;
+	};
+
+	// Largest difference from the reference, over pixels it is sure of.
+	S32 max_error(const LLImageCompositor& compositor, const Reference& reference)
+	{
+		S32 error = 0;
+		const U8* canvas = compositor.getCanvas()->getData();
+		for (S32 y = 0; y < compositor.getHeight(); y++)
+		{
+			for (S32 x = 0; x < compositor.getWidth(); x++)
+			{
+				if (reference.isAmbiguous(x, y))
+				{
+					continue;
+				}
+				const U8* expected = reference.getPixel(x, y);
+				const U8* actual = canvas + (y * compositor.getWidth() + x) * 4;
+				for (S32 c = 0; c < 4; c++)
+				{
+					error = llmax(error, llabs((S32)expected[c] - (S32)actual[c]));
+				}
+			}
+		}
+		return error;
+	}
+
+	// Puts a random image on the canvas, exactly.
+	Op background(S32 width, S32 height)
+	{
+		Op op;
+		op.mImage = random_image(width, height, 4);
+		return op;
+	}
+
+	// A synthetic body bake, laid out the way LLTexLayerSet renders one:
+	// a clear, then layers with alpha params masking a tinted texture,
+	// then the alpha masks.
+	LLImageCompositor* make_bake(const std::vector<LLPointer<LLImageRaw> >& images)
+	{
+		const S32 SIZE = 512;
+		const S32 NUM_LAYERS = 6;
+		LLImageCompositor* compositor = new LLImageCompositor(SIZE, SIZE);
+		compositor->setAlphaTest(FALSE);
+		compositor->setColor(LLColor4::black);
+		compositor->drawRect();
+		compositor->setAlphaTest(TRUE);
+
+		for (S32 i = 0; i < NUM_LAYERS; i++)
+		{
+			// LLTexLayer::renderAlphaMasks()
+			compositor->setColorMask(FALSE, TRUE);
+			compositor->setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ZERO);
+			compositor->setAlphaTest(FALSE);
+			compositor->setColor(LLColor4(0.f, 0.f, 0.f, 0.f));
+			compositor->drawRect();
+			compositor->setColor(LLColor4::white);
+			compositor->setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ONE);
+			compositor->drawImage(images[0], TRUE);
+			compositor->drawImage(images[1], TRUE);
+			compositor->setBlendFunc(LLImageCompositor::BF_DEST_ALPHA, LLImageCompositor::BF_ZERO);
+			compositor->drawImage(images[2 + i % 2]);
+			compositor->readAlpha();
+
+			// LLTexLayer::render()
+			compositor->setBlendFunc(LLImageCompositor::BF_DEST_ALPHA, LLImageCompositor::BF_ONE_MINUS_DEST_ALPHA);
+			compositor->setColorMask(TRUE, TRUE);
+			compositor->setColor(LLColor4(0.8f, 0.6f - i * 0.1f, 0.5f, 1.f));
+			compositor->setAlphaTest(TRUE);
+			compositor->drawImage(images[2 + i % 2]);
+		}
+
+		// LLTexLayerSet::renderAlphaMaskTextures()
+		compositor->setColorMask(FALSE, TRUE);
+		compositor->setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ZERO);
+		compositor->setAlphaTest(FALSE);
+		compositor->setColor(LLColor4::black);
+		compositor->drawRect();
+		compositor->setBlendFunc(LLImageCompositor::BF_DEST_ALPHA, LLImageCompositor::BF_ZERO);
+		compositor->setTextureBlendType(LLImageCompositor::TB_REPLACE);
+		compositor->drawImage(images[4], TRUE);
+		return compositor;
+	}
+
+	void make_bake_images(std::vector<LLPointer<LLImageRaw> >& images)
+	{
+		images.push_back(random_image(512, 512, 1));		// param alphas
+		images.push_back(random_image(256, 256, 1));
+		images.push_back(random_image(1024, 1024, 4));	// local textures
+		images.push_back(random_image(512, 512, 3));
+		images.push_back(random_image(512, 512, 1));		// alpha mask
+	}
+}
+
+namespace tut
+{
+	struct imagecompositor_test
+	{
+		~imagecompositor_test()
+		{
+			LLImageCompositor::useSSE2(FALSE);
+		}
+	};
+
+	typedef test_group<imagecompositor_test> imagecompositor_test_t;
+	typedef imagecompositor_test_t::object imagecompositor_test_object_t;
+	tut::imagecompositor_test_t tut_imagecompositor_test("imagecompositor_test");
+
+	template<> template<>
+	void imagecompositor_test_object_t::test<1>()
+	{
+		// every blend function, texture format and environment, color mask
+		// and alpha test matches GL's, for canvas sized textures
+		const S32 WIDTH = 37;	// not a whole number of SSE2 blocks
+		const S32 HEIGHT = 16;
+		const S32 comps[] = { 0, 1, 1, 2, 3, 4 };
+
+		for (S32 use_sse2 = 0; use_sse2 < (LLImageCompositor::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLImageCompositor::useSSE2(use_sse2);
+			for (S32 sf = 0; sf <= LLImageCompositor::BF_ONE_MINUS_DEST_ALPHA; sf++)
+			{
+				for (S32 df = 0; df <= LLImageCompositor::BF_ONE_MINUS_DEST_ALPHA; df++)
+				{
+					for (S32 format = 0; format < 6; format++)
+					{
+						for (S32 state = 0; state < 16; state++)
+						{
+							Op op;
+							op.mColor = LLColor4(ll_frand(), ll_frand(), ll_frand(), ll_frand());
+							op.mSourceFactor = (LLImageCompositor::EBlendFactor)sf;
+							op.mDestFactor = (LLImageCompositor::EBlendFactor)df;
+							op.mWriteColor = (state & 1) != 0;
+							op.mWriteAlpha = (state & 2) != 0;
+							op.mAlphaTest = (state & 4) != 0;
+							op.mTextureBlendType = (state & 8) ? LLImageCompositor::TB_REPLACE : LLImageCompositor::TB_MULT;
+							if (comps[format])
+							{
+								op.mImage = random_image(WIDTH, HEIGHT, comps[format]);
+								op.mIsAlpha = (format == 1);
+							}
+
+							LLImageCompositor compositor(WIDTH, HEIGHT);
+							Reference reference(WIDTH, HEIGHT);
+							Op first = background(WIDTH, HEIGHT);
+							first.record(compositor);
+							reference.run(first);
+							op.record(compositor);
+							reference.run(op);
+							compositor.composite();
+
+							S32 error = max_error(compositor, reference);
+							if (error > TOLERANCE)
+							{
+								fail(llformat("blend %d %d, format %d, state %d: off by %d", sf, df, format, state, error));
+							}
+						}
+					}
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void imagecompositor_test_object_t::test<2>()
+	{
+		// textures are filtered like GL's, magnified and minified
+		const S32 WIDTH = 64;
+		const S32 HEIGHT = 32;
+		const S32 sizes[][2] = { { 16, 16 }, { 64, 32 }, { 100, 20 }, { 128, 64 }, { 256, 64 }, { 1, 1 } };
+
+		for (S32 i = 0; i < 12; i++)
+		{
+			for (S32 comps = 1; comps <= 4; comps++)
+			{
+				Op op;
+				// and sampled from the full size image without mipmaps
+				op.mUseMipMaps = (i < 6);
+				op.mColor = LLColor4(0.9f, 0.7f, 0.5f, 0.8f);
+				op.mSourceFactor = LLImageCompositor::BF_SOURCE_ALPHA;
+				op.mDestFactor = LLImageCompositor::BF_ONE_MINUS_SOURCE_ALPHA;
+				const S32* size = sizes[i % 6];
+				op.mImage = new LLImageRaw(size[0], size[1], comps);
+				// Smooth, so that rounding the taps can't swing the result.
+				U8* data = op.mImage->getData();
+				for (S32 y = 0; y < size[1]; y++)
+				{
+					for (S32 x = 0; x < size[0]; x++)
+					{
+						for (S32 c = 0; c < comps; c++)
+						{
+							data[(y * size[0] + x) * comps + c] = (U8)(128 + 120 * sin(x * 0.3f + y * 0.2f + c));
+						}
+					}
+				}
+
+				LLImageCompositor compositor(WIDTH, HEIGHT);
+				Reference reference(WIDTH, HEIGHT);
+				Op first = background(WIDTH, HEIGHT);
+				first.record(compositor);
+				reference.run(first);
+				op.record(compositor);
+				reference.run(op);
+				compositor.composite();
+
+				S32 error = max_error(compositor, reference);
+				ensure(llformat("%dx%d, %d components, mipmaps %d: off by %d", size[0], size[1], comps, op.mUseMipMaps, error),
+					   error <= TOLERANCE);
+			}
+		}
+	}
+
+	template<> template<>
+	void imagecompositor_test_object_t::test<3>()
+	{
+		// SSE2 blends exactly as the scalar version does
+		if (!LLImageCompositor::hasSSE2())
+		{
+			return;
+		}
+		const S32 COUNT = 67;
+		std::vector<U8> src(COUNT * 4);
+		std::vector<U8> scalar(COUNT * 4);
+		std::vector<U8> sse2(COUNT * 4);
+		for (S32 i = 0; i < 2000; i++)
+		{
+			LLImageCompositor::Pass pass;
+			for (S32 c = 0; c < 4; c++)
+			{
+				pass.mColor[c] = random_byte();
+				pass.mWriteMask[c] = ll_rand(2) ? 0xff : 0;
+			}
+			pass.mWriteMask[1] = pass.mWriteMask[2] = pass.mWriteMask[0];
+			pass.mSourceFactor = (U8)ll_rand(LLImageCompositor::BF_ONE_MINUS_DEST_ALPHA + 1);
+			pass.mDestFactor = (U8)ll_rand(LLImageCompositor::BF_ONE_MINUS_DEST_ALPHA + 1);
+			pass.mAlphaTest = ll_rand(2);
+			pass.mModulate = ll_rand(2);
+			for (S32 j = 0; j < COUNT * 4; j++)
+			{
+				src[j] = ll_rand(4) ? random_byte() : (U8)ll_rand(4);
+				scalar[j] = sse2[j] = random_byte();
+			}
+			BOOL textured = ll_rand(2);
+			S32 count = ll_rand(COUNT + 1);
+			LLImageCompositor::blendScalar(&scalar[0], textured ? &src[0] : NULL, pass, count);
+			LLImageCompositor::blendSSE2(&sse2[0], textured ? &src[0] : NULL, pass, count);
+			ensure("SSE2 matches scalar", scalar == sse2);
+		}
+	}
+
+	template<> template<>
+	void imagecompositor_test_object_t::test<4>()
+	{
+		// bakes composited on threads come out the same as on this one,
+		// and how long a bake takes
+		const S32 NUM_BAKES = 12;
+		const S32 NUM_THREADS = 2;
+
+		std::vector<LLPointer<LLImageRaw> > images;
+		make_bake_images(images);
+
+		F32 times[2] = { 0.f, 0.f };
+		std::vector<LLPointer<LLImageRaw> > expected;
+		for (S32 use_sse2 = 0; use_sse2 < (LLImageCompositor::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLImageCompositor::useSSE2(use_sse2);
+			LLTimer timer;
+			for (S32 i = 0; i < NUM_BAKES; i++)
+			{
+				LLImageCompositor* compositor = make_bake(images);
+				compositor->composite();
+				if (use_sse2)
+				{
+					ensure("SSE2 bake matches scalar",
+						   !memcmp(compositor->getCanvas()->getData(), expected[i]->getData(), 512 * 512 * 4));
+				}
+				else
+				{
+					expected.push_back(compositor->getCanvas());
+				}
+				delete compositor;
+			}
+			times[use_sse2] = timer.getElapsedTimeF32();
+		}
+
+		std::vector<LLImageCompositorThread*> threads;
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			threads.push_back(new LLImageCompositorThread());
+		}
+		LLTimer timer;
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 i = 0; i < NUM_BAKES; i++)
+		{
+			handles.push_back(threads[i % NUM_THREADS]->composite(make_bake(images)));
+		}
+		S32 done = 0;
+		while (done < NUM_BAKES)
+		{
+			done = 0;
+			for (S32 i = 0; i < NUM_BAKES; i++)
+			{
+				LLImageCompositor* compositor = NULL;
+				if (handles[i] == LLQueuedThread::nullHandle())
+				{
+					done++;
+				}
+				else if (threads[i % NUM_THREADS]->getResult(handles[i], compositor))
+				{
+					ensure("composited", compositor != NULL);
+					ensure_equals("one alpha per layer", compositor->getNumAlphas(), 6);
+					ensure("threaded bake matches",
+						   !memcmp(compositor->getCanvas()->getData(), expected[i]->getData(), 512 * 512 * 4));
+					delete compositor;
+					handles[i] = LLQueuedThread::nullHandle();
+				}
+			}
+			for (S32 i = 0; i < NUM_THREADS; i++)
+			{
+				threads[i]->update(0);
+			}
+			if (done < NUM_BAKES)
+			{
+				ms_sleep(1);
+			}
+		}
+		F32 threaded_time = timer.getElapsedTimeF32();
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			delete threads[i];
+		}
+
+		LLImageCompositor* compositor = make_bake(images);
+		llinfos << NUM_BAKES << " 512x512 bakes of " << compositor->getNumDraws() << " draws: scalar "
+				<< times[0] * 1000.f / NUM_BAKES << "ms each";
+		if (times[1] > 0.f)
+		{
+			llcont << ", SSE2 " << times[1] * 1000.f / NUM_BAKES << "ms each";
+		}
+		llcont << ", " << NUM_THREADS << " threads " << threaded_time * 1000.f / NUM_BAKES << "ms each" << llendl;
+		delete compositor;
+	}
+}
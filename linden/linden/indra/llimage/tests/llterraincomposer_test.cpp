@@ -0,0 +1,727 @@
+/**
+ * @file llterraincomposer_test.cpp
+ * @brief LLTerrainComposer test cases
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+#include "linden_common.h"
+
+#include "../llterraincomposer.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	const S32 REGION_WIDTH = 256;		// grids, and meters
+	const S32 PATCH_WIDTH = 16;
+	const S32 TABLE_SIZE = 256 + 256 + 2;
+
+	// noise.cpp's tables, made the same way, from a generator of our own so
+	// that they are the same every run.
+	S32 sPerm[TABLE_SIZE];
+	F32 sGrad2[TABLE_SIZE][2];
+
+	U32 sSeed = 1;
+	S32 next_rand()
+	{
+		sSeed = sSeed * 1103515245 + 12345;
+		return (S32)((sSeed >> 16) & 0x7fff);
+	}
+
+	LLTerrainComposer::NoiseTables make_noise_tables()
+	{
+		sSeed = 1;
+		for (S32 i = 0; i < 256; i++)
+		{
+			sPerm[i] = i;
+			for (S32 j = 0; j < 2; j++)
+			{
+				sGrad2[i][j] = (F32)((next_rand() % 512) - 256) / 256;
+			}
+			F32 s = 1.f / (F32)sqrt(sGrad2[i][0] * sGrad2[i][0] + sGrad2[i][1] * sGrad2[i][1]);
+			sGrad2[i][0] *= s;
+			sGrad2[i][1] *= s;
+		}
+		for (S32 i = 255; i > 0; i--)
+		{
+			S32 j = next_rand() % 256;
+			std::swap(sPerm[i], sPerm[j]);
+		}
+		for (S32 i = 0; i < 256 + 2; i++)
+		{
+			sPerm[256 + i] = sPerm[i];
+			sGrad2[256 + i][0] = sGrad2[i][0];
+			sGrad2[256 + i][1] = sGrad2[i][1];
+		}
+		LLTerrainComposer::NoiseTables tables = { sPerm, &sGrad2[0][0] };
+		return tables;
+	}
+
+	// noise2() and turbulence2() as noise.cpp has them.
+	F32 ref_noise2(F32* vec)
+	{
+		U8 bx0, bx1, by0, by1;
+		U32 b00, b10, b01, b11;
+		F32 rx0, rx1, ry0, ry1, *q, sx, sy, a, b, u, v;
+		S32 i, j, t_S32;
+
+		rx1 = vec[0] + 4096.f;
+		t_S32 = lltrunc(rx1);
+		bx0 = (U8)t_S32;
+		bx1 = bx0 + 1;
+		rx0 = rx1 - t_S32;
+		rx1 = rx0 - 1.f;
+
+		ry1 = vec[1] + 4096.f;
+		t_S32 = lltrunc(ry1);
+		by0 = (U8)t_S32;
+		by1 = by0 + 1;
+		ry0 = ry1 - t_S32;
+		ry1 = ry0 - 1.f;
+
+		i = *(sPerm + bx0);
+		j = *(sPerm + bx1);
+
+		b00 = *(sPerm + i + by0);
+		b10 = *(sPerm + j + by0);
+		b01 = *(sPerm + i + by1);
+		b11 = *(sPerm + j + by1);
+
+		sx = rx0 * rx0 * (3.f - 2.f * rx0);
+		sy = ry0 * ry0 * (3.f - 2.f * ry0);
+
+		q = *(sGrad2 + b00);
+		u = rx0 * q[0] + ry0 * q[1];
+		q = *(sGrad2 + b10);
+		v = rx1 * q[0] + ry0 * q[1];
+		a = u + sx * (v - u);
+
+		q = *(sGrad2 + b01);
+		u = rx0 * q[0] + ry1 * q[1];
+		q = *(sGrad2 + b11);
+		v = rx1 * q[0] + ry1 * q[1];
+		b = u + sx * (v - u);
+
+		return a + sy * (b - a);
+	}
+
+	F32 ref_turbulence2(F32* v, F32 freq)
+	{
+		F32 t, vec[2];
+		for (t = 0.f ; freq >= 1.f ; freq *= 0.5f)
+		{
+			vec[0] = freq * v[0];
+			vec[1] = freq * v[1];
+			t += ref_noise2(vec)/freq;
+		}
+		return t;
+	}
+
+	F32 bilinear(const F32 v00, const F32 v01, const F32 v10, const F32 v11, const F32 x_frac, const F32 y_frac)
+	{
+		F32 result;
+		const F32 inv_x_frac = 1.f - x_frac;
+		const F32 inv_y_frac = 1.f - y_frac;
+		result = inv_x_frac*inv_y_frac*v00
+				+ x_frac*inv_y_frac*v10
+				+ inv_x_frac*y_frac*v01
+				+ x_frac*y_frac*v11;
+		return result;
+	}
+
+	// Rolling hills with a few cliffs, in meters.
+	F32 terrain_height(S32 x, S32 y)
+	{
+		F32 height = 20.f + 15.f * sinf(x * 0.05f) * cosf(y * 0.07f) + 0.02f * (x + y);
+		if ((x / 37 + y / 53) % 5 == 0)
+		{
+			height += 8.f;
+		}
+		return height;
+	}
+
+	// LLVLComposition as it was: a LLViewerLayer with the generateHeights()
+	// and generateTexture() loops.
+	struct RefComposition
+	{
+		S32 mWidth;
+		F32 mScale;
+		F32 mScaleInv;
+		std::vector<F32> mData;
+		F64 mOriginX;
+		F64 mOriginY;
+		F32 mStartHeight[4];
+		F32 mHeightRange[4];
+		F32 mTexScaleX;
+		F32 mTexScaleY;
+		LLPointer<LLImageRaw> mDetails[4];
+
+		RefComposition()
+			: mWidth(REGION_WIDTH), mScale(1.f), mScaleInv(1.f), mData(REGION_WIDTH * REGION_WIDTH, 0.f),
+			  mOriginX(256000.0), mOriginY(254976.0), mTexScaleX(16.f), mTexScaleY(16.f)
+		{
+			F32 start[4] = { 10.f, 12.f, 8.f, 14.f };
+			F32 range[4] = { 30.f, 40.f, 25.f, 60.f };
+			for (S32 i = 0; i < 4; i++)
+			{
+				mStartHeight[i] = start[i];
+				mHeightRange[i] = range[i];
+			}
+		}
+
+		F32 getValueScaled(const F32 x, const F32 y) const
+		{
+			S32 x1, x2, y1, y2;
+			F32 x_frac, y_frac;
+
+			x_frac = x*mScaleInv;
+			x1 = llfloor(x_frac);
+			x2 = x1 + 1;
+			x_frac -= x1;
+
+			y_frac = y*mScaleInv;
+			y1 = llfloor(y_frac);
+			y2 = y1 + 1;
+			y_frac -= y1;
+
+			x1 = llmin((S32)mWidth-1, x1);
+			x1 = llmax(0, x1);
+			x2 = llmin((S32)mWidth-1, x2);
+			x2 = llmax(0, x2);
+			y1 = llmin((S32)mWidth-1, y1);
+			y1 = llmax(0, y1);
+			y2 = llmin((S32)mWidth-1, y2);
+			y2 = llmax(0, y2);
+
+			S32 row1 = y1 * mWidth;
+			S32 row2 = y2 * mWidth;
+			F32 row1_left  = mData[ row1 + x1 ];
+			F32 row1_right = mData[ row1 + x2 ];
+			F32 row2_left  = mData[ row2 + x1 ];
+			F32 row2_right = mData[ row2 + x2 ];
+			F32 row1_interp = row1_left - x_frac * (row1_left - row1_right);
+			F32 row2_interp = row2_left - x_frac * (row2_left - row2_right);
+			return row1_interp - y_frac * (row1_interp - row2_interp);
+		}
+
+		void generateHeights(const F32 x, const F32 y, const F32 width)
+		{
+			S32 x_begin = llround( x * mScaleInv );
+			S32 y_begin = llround( y * mScaleInv );
+			S32 x_end = llmin(llround( (x + width) * mScaleInv ), mWidth);
+			S32 y_end = llmin(llround( (y + width) * mScaleInv ), mWidth);
+
+			const F32 slope_squared = 1.5f*1.5f;
+			const F32 xyScale = 4.9215f;
+			const F32 zScale = 4;
+			const F32 z_offset = 0.f;
+			const F32 noise_magnitude = 2.f;
+			const S32 NUM_TEXTURES = 4;
+			const F32 xyScaleInv = (1.f / xyScale);
+			const F32 zScaleInv = (1.f / zScale);
+			const F32 inv_width = 1.f/mWidth;
+
+			for (S32 j = y_begin; j < y_end; j++)
+			{
+				for (S32 i = x_begin; i < x_end; i++)
+				{
+					F32 vec[3];
+					F32 vec1[3];
+					F32 twiddle;
+
+					F32 start_height = bilinear(mStartHeight[0], mStartHeight[1], mStartHeight[2], mStartHeight[3],
+												i*inv_width, j*inv_width);
+					F32 height_range = bilinear(mHeightRange[0], mHeightRange[1], mHeightRange[2], mHeightRange[3],
+												i*inv_width, j*inv_width);
+
+					F32 location[2] = { i*mScale, j*mScale };
+					F32 height = terrain_height(i, j) + z_offset;
+
+					vec[0] = (F32)(mOriginX+location[0])*xyScaleInv;
+					vec[1] = (F32)(mOriginY+location[1])*xyScaleInv;
+					vec[2] = height*zScaleInv;
+					vec1[0] = vec[0]*(0.2222222222f);
+					vec1[1] = vec[1]*(0.2222222222f);
+					vec1[2] = vec[2]*(0.2222222222f);
+					twiddle = ref_noise2(vec1)*6.5f;
+					twiddle += ref_turbulence2(vec, 2)*slope_squared;
+					twiddle *= noise_magnitude;
+
+					F32 scaled_noisy_height = (height + twiddle - start_height) * F32(NUM_TEXTURES) / height_range;
+					scaled_noisy_height = llmax(0.f, scaled_noisy_height);
+					scaled_noisy_height = llmin(3.f, scaled_noisy_height);
+					mData[i + j*mWidth] = scaled_noisy_height;
+				}
+			}
+		}
+
+		void generateTexture(const F32 x, const F32 y, const F32 width, LLImageRaw* raw)
+		{
+			U8* st_data[4];
+			S32 st_data_size[4];
+			for (S32 i = 0; i < 4; i++)
+			{
+				st_data[i] = mDetails[i]->getData();
+				st_data_size[i] = mDetails[i]->getDataSize();
+			}
+
+			S32 x_begin = (S32)(x * mScaleInv);
+			S32 y_begin = (S32)(y * mScaleInv);
+			S32 x_end = llmin(llround( (x + width) * mScaleInv ), mWidth);
+			S32 y_end = llmin(llround( (y + width) * mScaleInv ), mWidth);
+
+			U32 tex_width = raw->getWidth();
+			U32 tex_height = raw->getHeight();
+			U32 tex_comps = 3;
+			U32 tex_stride = tex_width * tex_comps;
+			S32 st_comps = 3;
+			S32 st_width = 128;
+			S32 st_height = 128;
+
+			F32 tex_x_scalef = (F32)tex_width / (F32)mWidth;
+			F32 tex_y_scalef = (F32)tex_height / (F32)mWidth;
+			S32 tex_x_begin = (S32)((F32)x_begin * tex_x_scalef);
+			S32 tex_y_begin = (S32)((F32)y_begin * tex_y_scalef);
+			S32 tex_x_end = (S32)((F32)x_end * tex_x_scalef);
+			S32 tex_y_end = (S32)((F32)y_end * tex_y_scalef);
+
+			F32 tex_x_ratiof = (F32)mWidth*mScale / (F32)tex_width;
+			F32 tex_y_ratiof = (F32)mWidth*mScale / (F32)tex_height;
+
+			U8 *rawp = raw->getData();
+
+			F32 st_x_stride, st_y_stride;
+			st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
+			st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
+
+			F32 sti, stj;
+			S32 st_offset;
+			sti = (tex_x_begin * st_x_stride) - st_width*(llfloor((tex_x_begin * st_x_stride)/st_width));
+			stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
+
+			for (S32 j = tex_y_begin; j < tex_y_end; j++)
+			{
+				U32 offset = j * tex_stride + tex_x_begin * tex_comps;
+				sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
+				for (S32 i = tex_x_begin; i < tex_x_end; i++)
+				{
+					S32 tex0, tex1;
+					F32 composition = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
+
+					tex0 = llfloor( composition );
+					tex0 = llclamp(tex0, 0, 3);
+					composition -= tex0;
+					tex1 = tex0 + 1;
+					tex1 = llclamp(tex1, 0, 3);
+
+					st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
+					for (U32 k = 0; k < tex_comps; k++)
+					{
+						if (st_offset < st_data_size[tex0] && st_offset < st_data_size[tex1])
+						{
+							F32 a = *(st_data[tex0] + st_offset);
+							F32 b = *(st_data[tex1] + st_offset);
+							rawp[ offset ] = (U8)lltrunc( a + composition * (b - a) );
+						}
+						offset++;
+						st_offset++;
+					}
+
+					sti += st_x_stride;
+					if (sti >= st_width)
+					{
+						sti -= st_width;
+					}
+				}
+
+				stj += st_y_stride;
+				if (stj >= st_height)
+				{
+					stj -= st_height;
+				}
+			}
+		}
+	};
+
+	LLPointer<LLImageRaw> random_detail()
+	{
+		LLPointer<LLImageRaw> image = new LLImageRaw(128, 128, 3);
+		for (S32 i = 0; i < image->getDataSize(); i++)
+		{
+			image->getData()[i] = (U8)ll_rand(256);
+		}
+		return image;
+	}
+
+	LLPointer<LLImageRaw> solid_detail(U8 r, U8 g, U8 b)
+	{
+		LLPointer<LLImageRaw> image = new LLImageRaw(128, 128, 3);
+		image->clear(r, g, b, 255);
+		return image;
+	}
+
+	// The composer LLVLComposition would make for the patch at x, y, as
+	// LLSurfacePatch::updateTexture() asks for it.
+	LLTerrainComposer* make_composer(const LLTerrainComposer::NoiseTables& tables, const RefComposition& ref,
+									 S32 x, S32 y, BOOL generate, S32 tex_size)
+	{
+		LLTerrainComposer* composer = new LLTerrainComposer(tables, ref.mWidth, ref.mScale);
+		LLRect values(x, llmin(y + PATCH_WIDTH + 1, ref.mWidth), llmin(x + PATCH_WIDTH + 1, ref.mWidth), y);
+		composer->setValuesRect(values, generate);
+		composer->setOrigin(ref.mOriginX, ref.mOriginY);
+		composer->setCorners(ref.mStartHeight, ref.mHeightRange);
+		for (S32 j = values.mBottom; j < values.mTop; j++)
+		{
+			for (S32 i = values.mLeft; i < values.mRight; i++)
+			{
+				if (generate)
+				{
+					composer->setHeight(i, j, terrain_height(i, j));
+				}
+				else
+				{
+					composer->setValue(i, j, ref.mData[i + j * ref.mWidth]);
+				}
+			}
+		}
+		if (tex_size)
+		{
+			composer->setTexture(LLRect(x, y + PATCH_WIDTH, x + PATCH_WIDTH, y), tex_size, tex_size,
+								 ref.mTexScaleX, ref.mTexScaleY);
+			for (S32 i = 0; i < 4; i++)
+			{
+				composer->setDetail(i, ref.mDetails[i]);
+			}
+		}
+		return composer;
+	}
+
+	// Puts the texels of a composer where they go in the whole texture.
+	void copy_texels(const LLTerrainComposer& composer, LLImageRaw* raw)
+	{
+		const LLRect& rect = composer.getTextureRect();
+		for (S32 j = 0; j < rect.getHeight(); j++)
+		{
+			memcpy(raw->getData() + ((rect.mBottom + j) * raw->getWidth() + rect.mLeft) * 3,
+				   composer.getTexture()->getData() + j * rect.getWidth() * 3,
+				   rect.getWidth() * 3);
+		}
+	}
+}
+
+namespace tut
+{
+	struct terraincomposer_test
+	{
+		~terraincomposer_test()
+		{
+			LLTerrainComposer::useSSE2(FALSE);
+		}
+	};
+
+	typedef test_group<terraincomposer_test> terraincomposer_test_t;
+	typedef terraincomposer_test_t::object terraincomposer_test_object_t;
+	tut::terraincomposer_test_t tut_terraincomposer_test("terraincomposer_test");
+
+	template<> template<>
+	void terraincomposer_test_object_t::test<1>()
+	{
+		// noise and composition values are exactly what noise2() and
+		// generateHeights() work out, patch by patch over a region
+		LLTerrainComposer::NoiseTables tables = make_noise_tables();
+		for (S32 i = 0; i < 1000; i++)
+		{
+			F32 vec[2] = { ll_frand(100000.f), ll_frand(100000.f) };
+			ensure("noise2", LLTerrainComposer::noise2(tables, vec[0], vec[1]) == ref_noise2(vec));
+		}
+
+		RefComposition ref;
+		for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+		{
+			for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+			{
+				ref.generateHeights((F32)x, (F32)y, (F32)(PATCH_WIDTH + 1));
+			}
+		}
+
+		for (S32 use_sse2 = 0; use_sse2 < (LLTerrainComposer::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLTerrainComposer::useSSE2(use_sse2);
+			S32 mismatches = 0;
+			for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+			{
+				for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+				{
+					LLTerrainComposer* composer = make_composer(tables, ref, x, y, TRUE, 0);
+					composer->compose();
+					const LLRect& rect = composer->getValuesRect();
+					for (S32 j = rect.mBottom; j < rect.mTop; j++)
+					{
+						for (S32 i = rect.mLeft; i < rect.mRight; i++)
+						{
+							if (composer->getValue(i, j) != ref.mData[i + j * ref.mWidth])
+							{
+								mismatches++;
+							}
+						}
+					}
+					delete composer;
+				}
+			}
+			ensure_equals(use_sse2 ? "SSE2 values match" : "scalar values match", mismatches, 0);
+		}
+	}
+
+	template<> template<>
+	void terraincomposer_test_object_t::test<2>()
+	{
+		// texels are exactly what generateTexture() makes of the values, at
+		// the usual texture size and at others
+		LLTerrainComposer::NoiseTables tables = make_noise_tables();
+		RefComposition ref;
+		for (S32 i = 0; i < 4; i++)
+		{
+			ref.mDetails[i] = random_detail();
+		}
+		for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+		{
+			for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+			{
+				ref.generateHeights((F32)x, (F32)y, (F32)(PATCH_WIDTH + 1));
+			}
+		}
+
+		const S32 tex_sizes[] = { 256, 128, 512 };
+		for (S32 s = 0; s < 3; s++)
+		{
+			S32 tex_size = tex_sizes[s];
+			LLPointer<LLImageRaw> expected = new LLImageRaw(tex_size, tex_size, 3);
+			memset(expected->getData(), 0, expected->getDataSize());
+			for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+			{
+				for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+				{
+					ref.generateTexture((F32)x, (F32)y, (F32)PATCH_WIDTH, expected);
+				}
+			}
+
+			for (S32 use_sse2 = 0; use_sse2 < (LLTerrainComposer::hasSSE2() ? 2 : 1); use_sse2++)
+			{
+				LLTerrainComposer::useSSE2(use_sse2);
+				for (S32 generate = 0; generate < 2; generate++)
+				{
+					LLPointer<LLImageRaw> raw = new LLImageRaw(tex_size, tex_size, 3);
+					memset(raw->getData(), 0, raw->getDataSize());
+					for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+					{
+						for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+						{
+							LLTerrainComposer* composer = make_composer(tables, ref, x, y, generate, tex_size);
+							composer->compose();
+							copy_texels(*composer, raw);
+							delete composer;
+						}
+					}
+					ensure(llformat("%dx%d texture, SSE2 %d, generated %d", tex_size, tex_size, use_sse2, generate),
+						   !memcmp(raw->getData(), expected->getData(), raw->getDataSize()));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void terraincomposer_test_object_t::test<3>()
+	{
+		// golden texels: flat detail textures blended by known values
+		LLTerrainComposer::NoiseTables tables = make_noise_tables();
+		RefComposition ref;
+		ref.mDetails[0] = solid_detail(200, 100, 0);
+		ref.mDetails[1] = solid_detail(100, 200, 50);
+		ref.mDetails[2] = solid_detail(0, 50, 250);
+		ref.mDetails[3] = solid_detail(255, 255, 255);
+
+		// value  texels
+		// 0      detail 0
+		// 0.5    halfway from 0 to 1, rounded down
+		// 1.25   a quarter of the way from 1 to 2
+		// 3      detail 3
+		const F32 values[] = { 0.f, 0.5f, 1.25f, 3.f };
+		const U8 golden[][3] = { { 200, 100, 0 }, { 150, 150, 25 }, { 75, 162, 100 }, { 255, 255, 255 } };
+		for (S32 use_sse2 = 0; use_sse2 < (LLTerrainComposer::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLTerrainComposer::useSSE2(use_sse2);
+			for (S32 v = 0; v < 4; v++)
+			{
+				std::fill(ref.mData.begin(), ref.mData.end(), values[v]);
+				LLTerrainComposer* composer = make_composer(tables, ref, 32, 48, FALSE, 256);
+				composer->compose();
+				LLImageRaw* texture = composer->getTexture();
+				ensure_equals("patch texture width", texture->getWidth(), PATCH_WIDTH);
+				ensure_equals("patch texture height", texture->getHeight(), PATCH_WIDTH);
+				ensure("patch texture origin", composer->getTextureRect() == LLRect(32, 64, 48, 48));
+				for (S32 i = 0; i < texture->getDataSize(); i++)
+				{
+					ensure_equals(llformat("value %g, channel %d", values[v], i % 3),
+								  texture->getData()[i], golden[v][i % 3]);
+				}
+				delete composer;
+			}
+		}
+
+		// far below every start height is all detail 0, far above all detail 3
+		for (S32 use_sse2 = 0; use_sse2 < (LLTerrainComposer::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLTerrainComposer::useSSE2(use_sse2);
+			for (S32 high = 0; high < 2; high++)
+			{
+				LLTerrainComposer* composer = make_composer(tables, ref, 0, 0, TRUE, 256);
+				const LLRect& rect = composer->getValuesRect();
+				for (S32 j = rect.mBottom; j < rect.mTop; j++)
+				{
+					for (S32 i = rect.mLeft; i < rect.mRight; i++)
+					{
+						composer->setHeight(i, j, high ? 1000.f : -1000.f);
+					}
+				}
+				composer->compose();
+				LLImageRaw* texture = composer->getTexture();
+				for (S32 i = 0; i < texture->getDataSize(); i++)
+				{
+					ensure_equals(high ? "above" : "below", texture->getData()[i], golden[high ? 3 : 0][i % 3]);
+				}
+				delete composer;
+			}
+		}
+	}
+
+	template<> template<>
+	void terraincomposer_test_object_t::test<4>()
+	{
+		// regions composed on a thread come out the same as on this one, and
+		// how long a region takes
+		const S32 NUM_REGIONS = 4;
+		LLTerrainComposer::NoiseTables tables = make_noise_tables();
+		RefComposition ref;
+		for (S32 i = 0; i < 4; i++)
+		{
+			ref.mDetails[i] = random_detail();
+		}
+
+		LLTimer timer;
+		LLPointer<LLImageRaw> expected = new LLImageRaw(256, 256, 3);
+		for (S32 r = 0; r < NUM_REGIONS; r++)
+		{
+			for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+			{
+				for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+				{
+					ref.generateHeights((F32)x, (F32)y, (F32)(PATCH_WIDTH + 1));
+					ref.generateTexture((F32)x, (F32)y, (F32)PATCH_WIDTH, expected);
+				}
+			}
+		}
+		F32 ref_time = timer.getElapsedTimeF32();
+
+		F32 times[2] = { 0.f, 0.f };
+		for (S32 use_sse2 = 0; use_sse2 < (LLTerrainComposer::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLTerrainComposer::useSSE2(use_sse2);
+			LLPointer<LLImageRaw> raw = new LLImageRaw(256, 256, 3);
+			timer.reset();
+			for (S32 r = 0; r < NUM_REGIONS; r++)
+			{
+				for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+				{
+					for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+					{
+						LLTerrainComposer* composer = make_composer(tables, ref, x, y, TRUE, 256);
+						composer->compose();
+						copy_texels(*composer, raw);
+						delete composer;
+					}
+				}
+			}
+			times[use_sse2] = timer.getElapsedTimeF32();
+			ensure("region matches", !memcmp(raw->getData(), expected->getData(), raw->getDataSize()));
+		}
+
+		// A region's patches in batches of a row, as LLSurface hands them over.
+		LLTerrainComposerThread thread;
+		LLPointer<LLImageRaw> raw = new LLImageRaw(256, 256, 3);
+		timer.reset();
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 r = 0; r < NUM_REGIONS; r++)
+		{
+			for (S32 y = 0; y < REGION_WIDTH; y += PATCH_WIDTH)
+			{
+				terrain_composer_vec_t batch;
+				for (S32 x = 0; x < REGION_WIDTH; x += PATCH_WIDTH)
+				{
+					batch.push_back(make_composer(tables, ref, x, y, TRUE, 256));
+				}
+				handles.push_back(thread.compose(batch));
+				ensure("batch handed over", batch.empty());
+			}
+		}
+		for (size_t i = 0; i < handles.size(); )
+		{
+			terrain_composer_vec_t batch;
+			if (thread.getResult(handles[i], batch))
+			{
+				ensure_equals("batch composed", (S32)batch.size(), REGION_WIDTH / PATCH_WIDTH);
+				for (terrain_composer_vec_t::iterator iter = batch.begin(); iter != batch.end(); ++iter)
+				{
+					copy_texels(**iter, raw);
+				}
+				for_each(batch.begin(), batch.end(), DeletePointer());
+				i++;
+			}
+			else
+			{
+				thread.update(0);
+				ms_sleep(1);
+			}
+		}
+		F32 threaded_time = timer.getElapsedTimeF32();
+		ensure("threaded region matches", !memcmp(raw->getData(), expected->getData(), raw->getDataSize()));
+
+		llinfos << "Composing a region's terrain texture: generateHeights() and generateTexture() "
+				<< ref_time * 1000.f / NUM_REGIONS << "ms, scalar " << times[0] * 1000.f / NUM_REGIONS << "ms";
+		if (times[1] > 0.f)
+		{
+			llcont << ", SSE2 " << times[1] * 1000.f / NUM_REGIONS << "ms";
+		}
+		llcont << ", on a thread " << threaded_time * 1000.f / NUM_REGIONS << "ms" << llendl;
+	}
+}
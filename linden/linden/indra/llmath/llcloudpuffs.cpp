@@ -0,0 +1,346 @@
+/**
+ * @file llcloudpuffs.cpp
+ * @brief The cloud puffs of every cloud layer, in one pool
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llcloudpuffs.h"
+
+#include "llfasttimer.h"
+#include "llmath.h"
+
+#include <algorithm>
+
+LLCloudPuffs::update_func_t LLCloudPuffs::sUpdatePuffs = &LLCloudPuffs::updatePuffsScalar;
+
+LLCloudPuffs::LLCloudPuffs(F32 cell_width)
+:	mCellWidth(cell_width)
+{
+	mParams.mRegionWidth = 256.f;
+	mParams.mVelocityScale = 0.f;
+	mParams.mGrowRate = 0.f;
+	mParams.mDecayRate = 0.f;
+}
+
+U64 LLCloudPuffs::getCellKey(F64 x, F64 y) const
+{
+	U32 grid_x = (U32)(S32)floor(x / mCellWidth);
+	U32 grid_y = (U32)(S32)floor(y / mCellWidth);
+	return ((U64)grid_x << 32) | grid_y;
+}
+
+S32 LLCloudPuffs::addCell(const LLVector3d& center_global, const Wind& wind)
+{
+	S32 cell;
+	if (mFreeCells.empty())
+	{
+		cell = (S32)mCellUsed.size();
+		mCellUsed.push_back(TRUE);
+		mCellKey.push_back(0);
+		mCellWind.push_back(wind);
+		mCellBegin.push_back(0);
+		mCellEnd.push_back(0);
+		mCellCount.push_back(0);
+		mCellLiveCount.push_back(0);
+		mCellKill.push_back(0);
+	}
+	else
+	{
+		cell = mFreeCells.back();
+		mFreeCells.pop_back();
+		mCellUsed[cell] = TRUE;
+		mCellBegin[cell] = 0;
+		mCellEnd[cell] = 0;
+		mCellCount[cell] = 0;
+		mCellLiveCount[cell] = 0;
+		mCellKill[cell] = 0;
+	}
+	moveCell(cell, center_global, wind);
+	return cell;
+}
+
+void LLCloudPuffs::moveCell(S32 cell, const LLVector3d& center_global, const Wind& wind)
+{
+	cell_map_t::iterator iter = mCellMap.find(mCellKey[cell]);
+	if (iter != mCellMap.end() && iter->second == cell)
+	{
+		mCellMap.erase(iter);
+	}
+	mCellKey[cell] = getCellKey(center_global.mdV[VX], center_global.mdV[VY]);
+	mCellWind[cell] = wind;
+	mCellMap[mCellKey[cell]] = cell;
+}
+
+void LLCloudPuffs::removeCell(S32 cell)
+{
+	cell_map_t::iterator iter = mCellMap.find(mCellKey[cell]);
+	if (iter != mCellMap.end() && iter->second == cell)
+	{
+		mCellMap.erase(iter);
+	}
+	mCellUsed[cell] = FALSE;
+	mFreeCells.push_back(cell);
+
+	for (S32 i = mCellBegin[cell]; i < mCellEnd[cell]; i++)
+	{
+		mCell[i] = -1;
+	}
+	sortPuffs();
+}
+
+S32 LLCloudPuffs::findCell(const LLVector3d& pos_global) const
+{
+	cell_map_t::const_iterator iter = mCellMap.find(getCellKey(pos_global.mdV[VX], pos_global.mdV[VY]));
+	return iter != mCellMap.end() ? iter->second : -1;
+}
+
+void LLCloudPuffs::addPuff(S32 cell, const LLVector3d& pos_global, F32 alpha)
+{
+	mPosX.push_back(pos_global.mdV[VX]);
+	mPosY.push_back(pos_global.mdV[VY]);
+	mPosZ.push_back(pos_global.mdV[VZ]);
+	mAlpha.push_back(alpha);
+	mRate.push_back(mParams.mGrowRate);
+	mLifeState.push_back(GROWING);
+	mCell.push_back(cell);
+}
+
+void LLCloudPuffs::killPuffs(S32 cell, S32 count)
+{
+	mCellKill[cell] += count;
+}
+
+static LLFastTimer::DeclareTimer FTM_CLOUD_PUFFS("Cloud Puffs");
+
+void LLCloudPuffs::update(F32 dt)
+{
+	LLFastTimer t(FTM_CLOUD_PUFFS);
+
+	for (S32 cell = 0; cell < (S32)mCellUsed.size(); cell++)
+	{
+		if (mCellUsed[cell] && mCellBegin[cell] < mCellEnd[cell])
+		{
+			sUpdatePuffs(*this, mCellBegin[cell], mCellEnd[cell], mCellWind[cell], dt);
+		}
+	}
+}
+
+void LLCloudPuffs::updateOwnership()
+{
+	std::fill(mCellCount.begin(), mCellCount.end(), 0);
+	std::fill(mCellLiveCount.begin(), mCellLiveCount.end(), 0);
+
+	S32 count = getNumPuffs();
+	for (S32 i = 0; i < count; i++)
+	{
+		S32 cell = mCell[i];
+		if (mLifeState[i] != DYING)
+		{
+			U64 key = getCellKey(mPosX[i], mPosY[i]);
+			if (key != mCellKey[cell])
+			{
+				cell_map_t::const_iterator iter = mCellMap.find(key);
+				if (iter == mCellMap.end())
+				{
+					mLifeState[i] = DYING;
+					mRate[i] = mParams.mDecayRate;
+				}
+				else
+				{
+					cell = iter->second;
+					mCell[i] = cell;
+					mRate[i] = mParams.mGrowRate;
+				}
+			}
+		}
+
+		mCellCount[cell]++;
+		if (mLifeState[i] != DYING)
+		{
+			mCellLiveCount[cell]++;
+		}
+	}
+}
+
+void LLCloudPuffs::sortPuffs()
+{
+	S32 num_cells = (S32)mCellUsed.size();
+	S32 count = getNumPuffs();
+
+	// Kill the puffs asked for, and count the ones left in each cell.
+	std::fill(mCellEnd.begin(), mCellEnd.end(), 0);
+	for (S32 i = 0; i < count; i++)
+	{
+		S32 cell = mCell[i];
+		if (cell < 0)
+		{
+			continue;
+		}
+		if (mCellKill[cell] > 0 && mLifeState[i] != DYING)
+		{
+			mLifeState[i] = DYING;
+			mRate[i] = mParams.mDecayRate;
+			mCellKill[cell]--;
+		}
+		if (mAlpha[i] > 0.f)
+		{
+			mCellEnd[cell]++;
+		}
+	}
+
+	S32 sorted_count = 0;
+	for (S32 cell = 0; cell < num_cells; cell++)
+	{
+		mCellBegin[cell] = sorted_count;
+		sorted_count += mCellEnd[cell];
+		// Where the next puff of the cell goes, which ends up as its end
+		mCellEnd[cell] = mCellBegin[cell];
+		mCellKill[cell] = 0;
+	}
+
+	mSortPosX.resize(sorted_count);
+	mSortPosY.resize(sorted_count);
+	mSortPosZ.resize(sorted_count);
+	mSortAlpha.resize(sorted_count);
+	mSortRate.resize(sorted_count);
+	mSortLifeState.resize(sorted_count);
+	mSortCell.resize(sorted_count);
+	for (S32 i = 0; i < count; i++)
+	{
+		S32 cell = mCell[i];
+		if (cell < 0 || mAlpha[i] <= 0.f)
+		{
+			continue;
+		}
+		S32 j = mCellEnd[cell]++;
+		mSortPosX[j] = mPosX[i];
+		mSortPosY[j] = mPosY[i];
+		mSortPosZ[j] = mPosZ[i];
+		mSortAlpha[j] = mAlpha[i];
+		mSortRate[j] = mRate[i];
+		mSortLifeState[j] = mLifeState[i];
+		mSortCell[j] = cell;
+	}
+
+	mPosX.swap(mSortPosX);
+	mPosY.swap(mSortPosY);
+	mPosZ.swap(mSortPosZ);
+	mAlpha.swap(mSortAlpha);
+	mRate.swap(mSortRate);
+	mLifeState.swap(mSortLifeState);
+	mCell.swap(mSortCell);
+}
+
+// static
+void LLCloudPuffs::sampleWind(const Wind& wind, F32 region_width, F32 x, F32 y, F32& vel_x, F32& vel_y)
+{
+	if (x < 0.f)
+	{
+		x = 0.f;
+	}
+	else if (x >= region_width)
+	{
+		x = (F32)fmod(x, region_width);
+	}
+
+	if (y < 0.f)
+	{
+		y = 0.f;
+	}
+	else if (y >= region_width)
+	{
+		y = (F32)fmod(y, region_width);
+	}
+
+	const S32 size = wind.mSize;
+	F32 grid_x = x * size / region_width;
+	F32 grid_y = y * size / region_width;
+	// A point just short of the north or east edge can round up onto it,
+	// past the last grid point.
+	S32 i = llmin(llfloor(grid_x), size - 1);
+	S32 j = llmin(llfloor(grid_y), size - 1);
+	S32 k = i + j * size;
+
+	if ((i < size - 1) && (j < size - 1))
+	{
+		F32 dx = grid_x - (F32)i;
+		F32 dy = grid_y - (F32)j;
+		vel_x = wind.mVelX[k]*(1.0f - dx)*(1.0f - dy) +
+				wind.mVelX[k + 1]*dx*(1.0f - dy) +
+				wind.mVelX[k + size]*dy*(1.0f - dx) +
+				wind.mVelX[k + size + 1]*dx*dy;
+		vel_y = wind.mVelY[k]*(1.0f - dx)*(1.0f - dy) +
+				wind.mVelY[k + 1]*dx*(1.0f - dy) +
+				wind.mVelY[k + size]*dy*(1.0f - dx) +
+				wind.mVelY[k + size + 1]*dx*dy;
+	}
+	else
+	{
+		vel_x = wind.mVelX[k];
+		vel_y = wind.mVelY[k];
+	}
+}
+
+// static
+void LLCloudPuffs::driftPuffs(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind)
+{
+	const Params& params = puffs.mParams;
+	for (S32 i = begin; i < end; i++)
+	{
+		// Where LLViewerRegion::getPosRegionFromGlobal() puts the puff
+		F32 x = (F32)(puffs.mPosX[i] - wind.mOriginGlobal.mdV[VX]);
+		F32 y = (F32)(puffs.mPosY[i] - wind.mOriginGlobal.mdV[VY]);
+		F32 vel_x, vel_y;
+		sampleWind(wind, params.mRegionWidth, x, y, vel_x, vel_y);
+		puffs.mPosX[i] += (F64)(vel_x * params.mVelocityScale);
+		puffs.mPosY[i] += (F64)(vel_y * params.mVelocityScale);
+	}
+}
+
+// static
+void LLCloudPuffs::updatePuffsScalar(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind, F32 dt)
+{
+	driftPuffs(puffs, begin, end, wind);
+
+	for (S32 i = begin; i < end; i++)
+	{
+		F32 alpha = puffs.mAlpha[i] + puffs.mRate[i] * dt;
+		alpha = llmin(1.f, alpha);
+		puffs.mAlpha[i] = llmax(0.f, alpha);
+	}
+}
+
+// static
+void LLCloudPuffs::useSSE2(BOOL use_sse2)
+{
+	sUpdatePuffs = (use_sse2 && hasSSE2()) ? &updatePuffsSSE2 : &updatePuffsScalar;
+}
@@ -0,0 +1,192 @@
+/**
+ * @file llcloudpuffs.h
+ * @brief The cloud puffs of every cloud layer, in one pool
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLCLOUDPUFFS_H
+#define LL_LLCLOUDPUFFS_H
+
+#include <map>
+#include <vector>
+
+#include "v3dmath.h"
+
+// The cloud puffs of every cloud layer, kept together as a structure of
+// arrays, so that a frame's update is a loop over all of them and, once
+// the arrays have grown to fit, allocates nothing.
+//
+// Puffs belong to cells, the cloud groups of the layers: squares of the
+// same width lined up on one grid over the world. A puff that drifts out of
+// its cell is handed to the cell it drifted into by changing its cell, or
+// left to die if there is none. After each frame the puffs are sorted by
+// cell, so that those of a cell are next to each other.
+class LLCloudPuffs
+{
+public:
+	enum
+	{
+		GROWING = 0,
+		DYING = 1
+	};
+
+	// The cloud velocity grid of a cell's region, as LLWind keeps it, which
+	// the cell's puffs drift on.
+	struct Wind
+	{
+		const F32* mVelX;
+		const F32* mVelY;
+		S32 mSize;					// grid points on a side
+		LLVector3d mOriginGlobal;	// of the region
+	};
+
+	// The settings, read once a frame.
+	struct Params
+	{
+		F32 mRegionWidth;			// meters
+		F32 mVelocityScale;			// meters a frame a puff moves per unit of wind
+		F32 mGrowRate;				// alpha a second
+		F32 mDecayRate;				// likewise, negative
+	};
+
+	LLCloudPuffs(F32 cell_width);
+
+	void setParams(const Params& params)			{ mParams = params; }
+	const Params& getParams() const					{ return mParams; }
+
+	// Adds the cell with center_global in it, and returns it. Its puffs
+	// drift on wind.
+	S32 addCell(const LLVector3d& center_global, const Wind& wind);
+	void moveCell(S32 cell, const LLVector3d& center_global, const Wind& wind);
+	// Removes the cell and its puffs.
+	void removeCell(S32 cell);
+	// The cell pos_global is in, or -1 if there is none.
+	S32 findCell(const LLVector3d& pos_global) const;
+
+	S32 getNumPuffs() const							{ return (S32)mAlpha.size(); }
+	LLVector3d getPositionGlobal(S32 i) const		{ return LLVector3d(mPosX[i], mPosY[i], mPosZ[i]); }
+	F32 getAlpha(S32 i) const						{ return mAlpha[i]; }
+	U32 getLifeState(S32 i) const					{ return mLifeState[i]; }
+	S32 getCell(S32 i) const						{ return mCell[i]; }
+
+	// The puffs of a cell, as sortPuffs() left them, begin to end - 1.
+	S32 getCellBegin(S32 cell) const				{ return mCellBegin[cell]; }
+	S32 getCellEnd(S32 cell) const					{ return mCellEnd[cell]; }
+	// How many puffs a cell has, and how many of them aren't dying, as
+	// updateOwnership() left them.
+	S32 getCellCount(S32 cell) const				{ return mCellCount[cell]; }
+	S32 getCellLiveCount(S32 cell) const			{ return mCellLiveCount[cell]; }
+
+	// Adds a growing puff to a cell.
+	void addPuff(S32 cell, const LLVector3d& pos_global, F32 alpha);
+	// Starts count of a cell's live puffs dying, the first ones first, when
+	// next sortPuffs().
+	void killPuffs(S32 cell, S32 count);
+
+	// A frame goes: update(), updateOwnership(), then addPuff() and
+	// killPuffs() as the cells need, and sortPuffs().
+	//
+	// Moves every puff by the wind, and grows or fades it, dt seconds.
+	void update(F32 dt);
+	// Hands the live puffs that drifted out of their cells to the cells
+	// they are in, or starts them dying, and counts the puffs of each cell.
+	void updateOwnership();
+	// Kills the puffs killPuffs() asked for, drops the dead ones and sorts
+	// the rest by cell.
+	void sortPuffs();
+
+	// Moves and fades puffs begin to end - 1, all of one cell, dt seconds.
+	//
+	// As with LLVertexXform, sUpdatePuffs is the one to call, and the SSE2
+	// version gives exactly the same results as the scalar one.
+	typedef void (*update_func_t)(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind, F32 dt);
+
+	static update_func_t sUpdatePuffs;
+
+	// Falls back to the scalar version if this build has no SSE2 version.
+	// Don't turn SSE2 on for CPUs that lack it.
+	static void useSSE2(BOOL use_sse2);
+	static BOOL usingSSE2()							{ return sUpdatePuffs == &updatePuffsSSE2; }
+	// Whether the SSE2 version was compiled in.
+	static BOOL hasSSE2();
+
+	static void updatePuffsScalar(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind, F32 dt);
+	// llcloudpuffs_sse2.cpp
+	static void updatePuffsSSE2(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind, F32 dt);
+
+	// The wind at x, y in the region, as LLWind::getCloudVelocity() works
+	// it out, before its scale.
+	static void sampleWind(const Wind& wind, F32 region_width, F32 x, F32 y, F32& vel_x, F32& vel_y);
+
+private:
+	U64 getCellKey(F64 x, F64 y) const;
+
+	// Moves puffs begin to end - 1 by the wind, the scalar way.
+	static void driftPuffs(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind);
+
+	F32 mCellWidth;
+	Params mParams;
+
+	// The puffs, by field.
+	std::vector<F64> mPosX;
+	std::vector<F64> mPosY;
+	std::vector<F64> mPosZ;
+	std::vector<F32> mAlpha;
+	std::vector<F32> mRate;
+	std::vector<U8> mLifeState;
+	std::vector<S32> mCell;
+
+	// And sortPuffs()'s copy of them.
+	std::vector<F64> mSortPosX;
+	std::vector<F64> mSortPosY;
+	std::vector<F64> mSortPosZ;
+	std::vector<F32> mSortAlpha;
+	std::vector<F32> mSortRate;
+	std::vector<U8> mSortLifeState;
+	std::vector<S32> mSortCell;
+
+	// The cells, by field. A removed cell isn't used, and its number goes
+	// on mFreeCells for the next cell added.
+	std::vector<U8> mCellUsed;
+	std::vector<U64> mCellKey;
+	std::vector<Wind> mCellWind;
+	std::vector<S32> mCellBegin;
+	std::vector<S32> mCellEnd;
+	std::vector<S32> mCellCount;
+	std::vector<S32> mCellLiveCount;
+	std::vector<S32> mCellKill;
+	std::vector<S32> mFreeCells;
+
+	// The grid: the cell at each grid square that has one.
+	typedef std::map<U64, S32> cell_map_t;
+	cell_map_t mCellMap;
+};
+
+#endif // LL_LLCLOUDPUFFS_H
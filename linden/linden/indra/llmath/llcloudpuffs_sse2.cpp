@@ -0,0 +1,193 @@
+/**
+ * @file llcloudpuffs_sse2.cpp
+ * @brief SSE2 cloud puff update
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llcloudpuffs.h"
+
+#include "llmath.h"
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#if LL_VECTORIZE && (defined(__SSE2__) || _M_IX86_FP >= 2 || defined(_M_X64))
+
+#include <emmintrin.h>
+
+inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+// Four of the puffs' positions in the region, as floats.
+inline __m128 load_region(const F64* pos, __m128d origin)
+{
+	__m128 lo = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pos), origin));
+	__m128 hi = _mm_cvtpd_ps(_mm_sub_pd(_mm_loadu_pd(pos + 2), origin));
+	return _mm_movelh_ps(lo, hi);
+}
+
+inline void add_velocity(F64* pos, __m128 vel)
+{
+	_mm_storeu_pd(pos, _mm_add_pd(_mm_loadu_pd(pos), _mm_cvtps_pd(vel)));
+	_mm_storeu_pd(pos + 2, _mm_add_pd(_mm_loadu_pd(pos + 2), _mm_cvtps_pd(_mm_movehl_ps(vel, vel))));
+}
+
+// static
+BOOL LLCloudPuffs::hasSSE2()
+{
+	return TRUE;
+}
+
+// static
+void LLCloudPuffs::updatePuffsSSE2(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind, F32 dt)
+{
+	const Params& params = puffs.mParams;
+	const S32 size = wind.mSize;
+	const __m128d origin_x = _mm_set1_pd(wind.mOriginGlobal.mdV[VX]);
+	const __m128d origin_y = _mm_set1_pd(wind.mOriginGlobal.mdV[VY]);
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 width = _mm_set1_ps(params.mRegionWidth);
+	const __m128 grid_size = _mm_set1_ps((F32)size);
+	const __m128i last = _mm_set1_epi32(size - 1);
+	const __m128 scale = _mm_set1_ps(params.mVelocityScale);
+
+	F64* pos_x = &puffs.mPosX[0];
+	F64* pos_y = &puffs.mPosY[0];
+	S32 i = begin;
+	for ( ; i + 4 <= end; i += 4)
+	{
+		__m128 x = load_region(pos_x + i, origin_x);
+		__m128 y = load_region(pos_y + i, origin_y);
+
+		// Puffs off the region clamp or wrap, as the scalar version has it.
+		__m128 inside = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(x, zero), _mm_cmplt_ps(x, width)),
+								   _mm_and_ps(_mm_cmpge_ps(y, zero), _mm_cmplt_ps(y, width)));
+		if (_mm_movemask_ps(inside) != 0xf)
+		{
+			driftPuffs(puffs, i, i + 4, wind);
+			continue;
+		}
+
+		__m128 grid_x = _mm_div_ps(_mm_mul_ps(x, grid_size), width);
+		__m128 grid_y = _mm_div_ps(_mm_mul_ps(y, grid_size), width);
+		// Not negative, so truncating is llfloor()
+		__m128i gi = _mm_cvttps_epi32(grid_x);
+		__m128i gj = _mm_cvttps_epi32(grid_y);
+		__m128i over_i = _mm_cmpgt_epi32(gi, last);
+		__m128i over_j = _mm_cmpgt_epi32(gj, last);
+		gi = _mm_or_si128(_mm_and_si128(over_i, last), _mm_andnot_si128(over_i, gi));
+		gj = _mm_or_si128(_mm_and_si128(over_j, last), _mm_andnot_si128(over_j, gj));
+		__m128 interior = _mm_castsi128_ps(_mm_and_si128(_mm_cmplt_epi32(gi, last), _mm_cmplt_epi32(gj, last)));
+		__m128 dx = _mm_sub_ps(grid_x, _mm_cvtepi32_ps(gi));
+		__m128 dy = _mm_sub_ps(grid_y, _mm_cvtepi32_ps(gj));
+
+		S32 ii[4], jj[4];
+		_mm_storeu_si128((__m128i*)ii, gi);
+		_mm_storeu_si128((__m128i*)jj, gj);
+		S32 interior_mask = _mm_movemask_ps(interior);
+		F32 x00[4], x10[4], x01[4], x11[4];
+		F32 y00[4], y10[4], y01[4], y11[4];
+		for (S32 lane = 0; lane < 4; lane++)
+		{
+			S32 k = ii[lane] + jj[lane] * size;
+			// The nearest grid point only, at the edges.
+			S32 right = (interior_mask & (1 << lane)) ? 1 : 0;
+			S32 up = right * size;
+			x00[lane] = wind.mVelX[k];
+			x10[lane] = wind.mVelX[k + right];
+			x01[lane] = wind.mVelX[k + up];
+			x11[lane] = wind.mVelX[k + up + right];
+			y00[lane] = wind.mVelY[k];
+			y10[lane] = wind.mVelY[k + right];
+			y01[lane] = wind.mVelY[k + up];
+			y11[lane] = wind.mVelY[k + up + right];
+		}
+
+		__m128 omdx = _mm_sub_ps(one, dx);
+		__m128 omdy = _mm_sub_ps(one, dy);
+
+		__m128 v00 = _mm_loadu_ps(x00);
+		__m128 vel_x = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(v00, omdx), omdy),
+														_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(x10), dx), omdy)),
+											 _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(x01), dy), omdx)),
+								  _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(x11), dx), dy));
+		vel_x = select_ps(interior, vel_x, v00);
+
+		v00 = _mm_loadu_ps(y00);
+		__m128 vel_y = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(_mm_mul_ps(v00, omdx), omdy),
+														_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(y10), dx), omdy)),
+											 _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(y01), dy), omdx)),
+								  _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(y11), dx), dy));
+		vel_y = select_ps(interior, vel_y, v00);
+
+		add_velocity(pos_x + i, _mm_mul_ps(vel_x, scale));
+		add_velocity(pos_y + i, _mm_mul_ps(vel_y, scale));
+	}
+	driftPuffs(puffs, i, end, wind);
+
+	// Then grow or fade them all.
+	F32* alpha = &puffs.mAlpha[0];
+	const F32* rate = &puffs.mRate[0];
+	const __m128 dt4 = _mm_set1_ps(dt);
+	for (i = begin; i + 4 <= end; i += 4)
+	{
+		__m128 a = _mm_add_ps(_mm_loadu_ps(alpha + i), _mm_mul_ps(_mm_loadu_ps(rate + i), dt4));
+		_mm_storeu_ps(alpha + i, _mm_max_ps(zero, _mm_min_ps(one, a)));
+	}
+	for ( ; i < end; i++)
+	{
+		F32 a = alpha[i] + rate[i] * dt;
+		a = llmin(1.f, a);
+		alpha[i] = llmax(0.f, a);
+	}
+}
+
+#else
+
+// static
+BOOL LLCloudPuffs::hasSSE2()
+{
+	return FALSE;
+}
+
+// static
+void LLCloudPuffs::updatePuffsSSE2(LLCloudPuffs& puffs, S32 begin, S32 end, const Wind& wind, F32 dt)
+{
+	updatePuffsScalar(puffs, begin, end, wind, dt);
+}
+
+#endif
@@ -0,0 +1,224 @@
+/**
+ * @file llgridindex.h
+ * @brief A grid of buckets indexing things by where they are on a plane
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLGRIDINDEX_H
+#define LL_LLGRIDINDEX_H
+
+#include <map>
+#include <vector>
+
+#include "llmath.h"
+
+// Indexes values by the rectangles they cover on a plane, so that those
+// overlapping a rectangle can be found without looking at the others.
+//
+// The plane is cut into square cells of one width. A value is kept in the
+// bucket of every cell its rectangle overlaps; only the cells that have any
+// have a bucket. Rectangles include their edges, and a point is a
+// rectangle with none of its own.
+//
+// T is copied into the buckets and compared with == by remove(), so it is
+// meant to be something small like a pointer or an index.
+template <class T>
+class LLGridIndex
+{
+public:
+	LLGridIndex(F64 cell_width)
+	:	mCellWidth(cell_width),
+		mOOCellWidth(1.0 / cell_width),
+		mCount(0)
+	{
+	}
+
+	void insert(const T& value, F64 min_x, F64 min_y, F64 max_x, F64 max_y)
+	{
+		Entry entry;
+		entry.mValue = value;
+		entry.mMinX = min_x;
+		entry.mMinY = min_y;
+		entry.mMaxX = max_x;
+		entry.mMaxY = max_y;
+
+		S32 cell_min_x = cellOf(min_x);
+		S32 cell_max_x = cellOf(max_x);
+		S32 cell_min_y = cellOf(min_y);
+		S32 cell_max_y = cellOf(max_y);
+		for (S32 cell_x = cell_min_x; cell_x <= cell_max_x; ++cell_x)
+		{
+			for (S32 cell_y = cell_min_y; cell_y <= cell_max_y; ++cell_y)
+			{
+				mBuckets[cellKey(cell_x, cell_y)].push_back(entry);
+			}
+		}
+		++mCount;
+	}
+
+	void insert(const T& value, F64 x, F64 y)
+	{
+		insert(value, x, y, x, y);
+	}
+
+	// Takes out the value inserted with this rectangle. Returns FALSE if
+	// there is none.
+	BOOL remove(const T& value, F64 min_x, F64 min_y, F64 max_x, F64 max_y)
+	{
+		BOOL found = FALSE;
+		S32 cell_min_x = cellOf(min_x);
+		S32 cell_max_x = cellOf(max_x);
+		S32 cell_min_y = cellOf(min_y);
+		S32 cell_max_y = cellOf(max_y);
+		for (S32 cell_x = cell_min_x; cell_x <= cell_max_x; ++cell_x)
+		{
+			for (S32 cell_y = cell_min_y; cell_y <= cell_max_y; ++cell_y)
+			{
+				typename bucket_map_t::iterator iter = mBuckets.find(cellKey(cell_x, cell_y));
+				if (iter == mBuckets.end())
+				{
+					continue;
+				}
+				bucket_t& bucket = iter->second;
+				for (U32 i = 0; i < bucket.size(); ++i)
+				{
+					if (bucket[i].mValue == value)
+					{
+						bucket[i] = bucket.back();
+						bucket.pop_back();
+						found = TRUE;
+						break;
+					}
+				}
+				if (bucket.empty())
+				{
+					mBuckets.erase(iter);
+				}
+			}
+		}
+		if (found)
+		{
+			--mCount;
+		}
+		return found;
+	}
+
+	BOOL remove(const T& value, F64 x, F64 y)
+	{
+		return remove(value, x, y, x, y);
+	}
+
+	void clear()
+	{
+		mBuckets.clear();
+		mCount = 0;
+	}
+
+	S32 size() const			{ return mCount; }
+	BOOL isEmpty() const		{ return mCount == 0; }
+	F64 getCellWidth() const	{ return mCellWidth; }
+
+	// Appends the values whose rectangles overlap this one to results, each
+	// once, in no particular order.
+	void query(F64 min_x, F64 min_y, F64 max_x, F64 max_y, std::vector<T>& results) const
+	{
+		if (mBuckets.empty())
+		{
+			return;
+		}
+		S32 cell_min_x = cellOf(min_x);
+		S32 cell_max_x = cellOf(max_x);
+		S32 cell_min_y = cellOf(min_y);
+		S32 cell_max_y = cellOf(max_y);
+
+		// Keys sort by x then y, so each column of the rectangle is a run
+		// of the map, and the cells in it without a bucket cost nothing.
+		for (S32 cell_x = cell_min_x; cell_x <= cell_max_x; ++cell_x)
+		{
+			typename bucket_map_t::const_iterator iter = mBuckets.lower_bound(cellKey(cell_x, cell_min_y));
+			typename bucket_map_t::const_iterator end = mBuckets.upper_bound(cellKey(cell_x, cell_max_y));
+			for ( ; iter != end; ++iter)
+			{
+				S32 cell_y = (S32)((U32)iter->first - CELL_BIAS);
+				const bucket_t& bucket = iter->second;
+				for (typename bucket_t::const_iterator entry = bucket.begin(); entry != bucket.end(); ++entry)
+				{
+					if (entry->mMaxX < min_x || entry->mMinX > max_x ||
+						entry->mMaxY < min_y || entry->mMinY > max_y)
+					{
+						continue;
+					}
+					// A value in several buckets is reported from the first
+					// of them the rectangle overlaps.
+					if (cell_x != llmax(cellOf(entry->mMinX), cell_min_x) ||
+						cell_y != llmax(cellOf(entry->mMinY), cell_min_y))
+					{
+						continue;
+					}
+					results.push_back(entry->mValue);
+				}
+			}
+		}
+	}
+
+private:
+	// Bias added to cell coordinates in keys, so that negative ones sort
+	// before positive ones.
+	static const U32 CELL_BIAS = 0x80000000;
+
+	S32 cellOf(F64 coord) const
+	{
+		return (S32)floor(coord * mOOCellWidth);
+	}
+
+	static U64 cellKey(S32 cell_x, S32 cell_y)
+	{
+		return ((U64)((U32)cell_x + CELL_BIAS) << 32) | (U64)((U32)cell_y + CELL_BIAS);
+	}
+
+	struct Entry
+	{
+		T mValue;
+		F64 mMinX;
+		F64 mMinY;
+		F64 mMaxX;
+		F64 mMaxY;
+	};
+
+	typedef std::vector<Entry> bucket_t;
+	typedef std::map<U64, bucket_t> bucket_map_t;
+
+	F64 mCellWidth;
+	F64 mOOCellWidth;
+	bucket_map_t mBuckets;
+	S32 mCount;
+};
+
+#endif // LL_LLGRIDINDEX_H
@@ -0,0 +1,141 @@
+/**
+ * @file llmorphdeltas.cpp
+ * @brief Sparse morph target deltas in structure of arrays form.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llmorphdeltas.h"
+
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+LLMorphDeltas::apply_func_t LLMorphDeltas::sApply = &LLMorphDeltas::applyScalar;
+
+LLMorphDeltas::LLMorphDeltas()
+	: mCount(0),
+	  mNumVectorBlocks(0)
+{
+}
+
+void LLMorphDeltas::set(U32 count, const U32* indices, const LLVector3* coords, const LLVector3* normals,
+						const LLVector3* binormals, const LLVector2* tex_coords)
+{
+	mCount = count;
+	mBlocks.clear();
+	mBlocks.resize((count + BLOCK_SIZE - 1) / BLOCK_SIZE);
+	mNumVectorBlocks = count / BLOCK_SIZE;
+	for (U32 i = 0; i < count; i++)
+	{
+		Block& block = mBlocks[i / BLOCK_SIZE];
+		U32 lane = i % BLOCK_SIZE;
+		block.mCoordX[lane] = coords[i].mV[VX];
+		block.mCoordY[lane] = coords[i].mV[VY];
+		block.mCoordZ[lane] = coords[i].mV[VZ];
+		block.mNormalX[lane] = normals[i].mV[VX];
+		block.mNormalY[lane] = normals[i].mV[VY];
+		block.mNormalZ[lane] = normals[i].mV[VZ];
+		block.mBinormalX[lane] = binormals[i].mV[VX];
+		block.mBinormalY[lane] = binormals[i].mV[VY];
+		block.mBinormalZ[lane] = binormals[i].mV[VZ];
+		block.mTexCoordS[lane] = tex_coords[i].mV[VX];
+		block.mTexCoordT[lane] = tex_coords[i].mV[VY];
+		block.mIndices[lane] = indices[i];
+
+		// Four at a time, a vertex that appears twice in a block would only
+		// get one of its deltas.
+		for (U32 j = 0; j < lane; j++)
+		{
+			if (block.mIndices[j] == indices[i])
+			{
+				mNumVectorBlocks = llmin(mNumVectorBlocks, i / BLOCK_SIZE);
+			}
+		}
+	}
+}
+
+// static
+void LLMorphDeltas::useSSE2(BOOL use_sse2)
+{
+	sApply = (use_sse2 && hasSSE2()) ? &applySSE2 : &applyScalar;
+}
+
+// static
+void LLMorphDeltas::applyScalar(const LLMorphDeltas& deltas, const Target& target,
+								F32 weight, const F32* mask_weights, F32 normal_factor)
+{
+	applyRange(deltas, target, weight, mask_weights, normal_factor, 0, deltas.mCount);
+}
+
+// static
+void LLMorphDeltas::applyRange(const LLMorphDeltas& deltas, const Target& target,
+							   F32 weight, const F32* mask_weights, F32 normal_factor,
+							   U32 first, U32 last)
+{
+	for (U32 i = first; i < last; i++)
+	{
+		const Block& block = deltas.mBlocks[i / BLOCK_SIZE];
+		U32 lane = i % BLOCK_SIZE;
+		U32 vert = block.mIndices[lane];
+		F32 mask_weight = mask_weights ? mask_weights[i] : 1.f;
+
+		LLVector3 coord(block.mCoordX[lane], block.mCoordY[lane], block.mCoordZ[lane]);
+		LLVector3 offset = coord * weight * mask_weight;
+		target.mCoords[vert] += offset;
+		if (target.mClothingWeights)
+		{
+			LLVector4& clothing_weight = target.mClothingWeights[vert];
+			clothing_weight.mV[VX] += offset.mV[VX];
+			clothing_weight.mV[VY] += offset.mV[VY];
+			clothing_weight.mV[VZ] += offset.mV[VZ];
+			clothing_weight.mV[VW] = mask_weight;
+		}
+
+		// calculate new normals based on half angles
+		LLVector3 normal(block.mNormalX[lane], block.mNormalY[lane], block.mNormalZ[lane]);
+		target.mScaledNormals[vert] += normal * weight * mask_weight * normal_factor;
+		LLVector3 normalized_normal = target.mScaledNormals[vert];
+		normalized_normal.normVec();
+		target.mNormals[vert] = normalized_normal;
+
+		// calculate new binormals
+		LLVector3 binormal(block.mBinormalX[lane], block.mBinormalY[lane], block.mBinormalZ[lane]);
+		target.mScaledBinormals[vert] += binormal * weight * mask_weight * normal_factor;
+		LLVector3 tangent = target.mScaledBinormals[vert] % normalized_normal;
+		LLVector3 normalized_binormal = normalized_normal % tangent;
+		normalized_binormal.normVec();
+		target.mBinormals[vert] = normalized_binormal;
+
+		LLVector2 tex_coord(block.mTexCoordS[lane], block.mTexCoordT[lane]);
+		target.mTexCoords[vert] += tex_coord * weight * mask_weight;
+	}
+}
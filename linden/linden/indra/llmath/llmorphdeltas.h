@@ -0,0 +1,131 @@
+/**
+ * @file llmorphdeltas.h
+ * @brief Sparse morph target deltas in structure of arrays form.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLMORPHDELTAS_H
+#define LL_LLMORPHDELTAS_H
+
+#include <vector>
+
+#include "stdtypes.h"
+
+class LLVector2;
+class LLVector3;
+class LLVector4;
+
+// The per vertex deltas of a morph target. Morphs only move a part of a
+// mesh, so the deltas are sparse, and they are kept as structure of arrays
+// in blocks of four vertices, which the SSE2 version applies a block at a
+// time.
+//
+// As with LLVertexXform, the scalar reference version does exactly what
+// the per vertex LLVector3 math in LLPolyMorphTarget::apply() always did,
+// the SSE2 version agrees with it to within rounding, and sApply is the
+// one to call.
+class LLMorphDeltas
+{
+public:
+	enum { BLOCK_SIZE = 4 };
+
+	// The mesh arrays a morph is applied to. mClothingWeights is NULL
+	// unless it is a clothing morph.
+	struct Target
+	{
+		LLVector3* mCoords;
+		LLVector3* mScaledNormals;
+		LLVector3* mNormals;
+		LLVector3* mScaledBinormals;
+		LLVector3* mBinormals;
+		LLVector2* mTexCoords;
+		LLVector4* mClothingWeights;
+	};
+
+	LLMorphDeltas();
+
+	// Copies count deltas for the mesh vertices in indices.
+	void set(U32 count, const U32* indices, const LLVector3* coords, const LLVector3* normals,
+			 const LLVector3* binormals, const LLVector2* tex_coords);
+
+	U32 getCount() const			{ return mCount; }
+
+	// Adds the deltas times weight, and times mask_weights[i] for the i-th
+	// delta if there is a mask, to the target. Normal and binormal deltas
+	// are scaled by normal_factor as well, and the normals and binormals
+	// are then recomputed from the scaled ones.
+	typedef void (*apply_func_t)(const LLMorphDeltas& deltas, const Target& target,
+								 F32 weight, const F32* mask_weights, F32 normal_factor);
+
+	static apply_func_t sApply;
+
+	// Falls back to the scalar version if this build has no SSE2 version.
+	// Don't turn SSE2 on for CPUs that lack it.
+	static void useSSE2(BOOL use_sse2);
+	static BOOL usingSSE2()			{ return sApply == &applySSE2; }
+	// Whether the SSE2 version was compiled in.
+	static BOOL hasSSE2();
+
+	static void applyScalar(const LLMorphDeltas& deltas, const Target& target,
+							F32 weight, const F32* mask_weights, F32 normal_factor);
+	// llmorphdeltas_sse2.cpp
+	static void applySSE2(const LLMorphDeltas& deltas, const Target& target,
+						  F32 weight, const F32* mask_weights, F32 normal_factor);
+
+private:
+	// Deltas first through last - 1, the scalar way.
+	static void applyRange(const LLMorphDeltas& deltas, const Target& target,
+						   F32 weight, const F32* mask_weights, F32 normal_factor,
+						   U32 first, U32 last);
+
+	struct Block
+	{
+		F32 mCoordX[BLOCK_SIZE];
+		F32 mCoordY[BLOCK_SIZE];
+		F32 mCoordZ[BLOCK_SIZE];
+		F32 mNormalX[BLOCK_SIZE];
+		F32 mNormalY[BLOCK_SIZE];
+		F32 mNormalZ[BLOCK_SIZE];
+		F32 mBinormalX[BLOCK_SIZE];
+		F32 mBinormalY[BLOCK_SIZE];
+		F32 mBinormalZ[BLOCK_SIZE];
+		F32 mTexCoordS[BLOCK_SIZE];
+		F32 mTexCoordT[BLOCK_SIZE];
+		U32 mIndices[BLOCK_SIZE];
+	};
+
+	std::vector<Block> mBlocks;
+	U32 mCount;
+	// Number of leading whole blocks the SSE2 version may do four at a
+	// time, which is all of them unless a block touches a vertex twice.
+	U32 mNumVectorBlocks;
+};
+
+#endif // LL_LLMORPHDELTAS_H
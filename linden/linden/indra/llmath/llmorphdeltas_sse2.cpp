@@ -0,0 +1,219 @@
+/**
+ * @file llmorphdeltas_sse2.cpp
+ * @brief SSE2 versions of the LLMorphDeltas kernels.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llmorphdeltas.h"
+
+#include "llv4math.h"		// for LL_VECTORIZE
+#include "v2math.h"
+#include "v3math.h"
+#include "v4math.h"
+
+#if LL_VECTORIZE && (defined(__SSE2__) || _M_IX86_FP >= 2 || defined(_M_X64))
+
+#include <emmintrin.h>
+
+// Reads exactly 12 bytes, a morph may well move the last vertex of a mesh.
+inline __m128 load_vector3(const LLVector3& v)
+{
+	__m128 xy = _mm_loadl_pi(_mm_setzero_ps(), (const __m64*)v.mV);
+	return _mm_movelh_ps(xy, _mm_load_ss(&v.mV[VZ]));
+}
+
+inline void store_vector3(LLVector3& v, __m128 r)
+{
+	_mm_storel_pi((__m64*)v.mV, r);
+	_mm_store_ss(&v.mV[VZ], _mm_movehl_ps(r, r));
+}
+
+// Gathers the vectors for the four vertices of a block into x, y and z.
+inline void gather(const LLVector3* array, const U32* indices, __m128& x, __m128& y, __m128& z)
+{
+	__m128 r0 = load_vector3(array[indices[0]]);
+	__m128 r1 = load_vector3(array[indices[1]]);
+	__m128 r2 = load_vector3(array[indices[2]]);
+	__m128 r3 = load_vector3(array[indices[3]]);
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	x = r0;
+	y = r1;
+	z = r2;
+}
+
+inline void scatter(LLVector3* array, const U32* indices, __m128 x, __m128 y, __m128 z)
+{
+	__m128 w = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	store_vector3(array[indices[0]], x);
+	store_vector3(array[indices[1]], y);
+	store_vector3(array[indices[2]], z);
+	store_vector3(array[indices[3]], w);
+}
+
+// LLVector3::normVec(). The single precision square root rounds the same
+// as fsqrtf()'s double one, and short vectors come out as zero.
+inline void normalize(__m128& x, __m128& y, __m128& z)
+{
+	__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, x), _mm_mul_ps(y, y)), _mm_mul_ps(z, z)));
+	__m128 keep = _mm_cmpgt_ps(mag, _mm_set1_ps(FP_MAG_THRESHOLD));
+	__m128 oomag = _mm_div_ps(_mm_set1_ps(1.f), mag);
+	x = _mm_and_ps(keep, _mm_mul_ps(x, oomag));
+	y = _mm_and_ps(keep, _mm_mul_ps(y, oomag));
+	z = _mm_and_ps(keep, _mm_mul_ps(z, oomag));
+}
+
+// a % b
+inline void cross(__m128 ax, __m128 ay, __m128 az, __m128 bx, __m128 by, __m128 bz,
+				  __m128& x, __m128& y, __m128& z)
+{
+	x = _mm_sub_ps(_mm_mul_ps(ay, bz), _mm_mul_ps(by, az));
+	y = _mm_sub_ps(_mm_mul_ps(az, bx), _mm_mul_ps(bz, ax));
+	z = _mm_sub_ps(_mm_mul_ps(ax, by), _mm_mul_ps(bx, ay));
+}
+
+// static
+BOOL LLMorphDeltas::hasSSE2()
+{
+	return TRUE;
+}
+
+// static
+void LLMorphDeltas::applySSE2(const LLMorphDeltas& deltas, const Target& target,
+							  F32 weight, const F32* mask_weights, F32 normal_factor)
+{
+	const __m128 w = _mm_set1_ps(weight);
+	const __m128 factor = _mm_set1_ps(normal_factor);
+	__m128 mask = _mm_set1_ps(1.f);
+
+	for (U32 b = 0; b < deltas.mNumVectorBlocks; b++)
+	{
+		const Block& block = deltas.mBlocks[b];
+		const U32* indices = block.mIndices;
+		if (mask_weights)
+		{
+			mask = _mm_loadu_ps(mask_weights + b * BLOCK_SIZE);
+		}
+
+		// Same order of operations as applyRange()
+		__m128 ox = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mCoordX), w), mask);
+		__m128 oy = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mCoordY), w), mask);
+		__m128 oz = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mCoordZ), w), mask);
+		__m128 x, y, z;
+		gather(target.mCoords, indices, x, y, z);
+		scatter(target.mCoords, indices, _mm_add_ps(x, ox), _mm_add_ps(y, oy), _mm_add_ps(z, oz));
+
+		if (target.mClothingWeights)
+		{
+			F32 offset[3][BLOCK_SIZE];
+			F32 lane_mask[BLOCK_SIZE];
+			_mm_storeu_ps(offset[VX], ox);
+			_mm_storeu_ps(offset[VY], oy);
+			_mm_storeu_ps(offset[VZ], oz);
+			_mm_storeu_ps(lane_mask, mask);
+			for (U32 lane = 0; lane < BLOCK_SIZE; lane++)
+			{
+				LLVector4& clothing_weight = target.mClothingWeights[indices[lane]];
+				clothing_weight.mV[VX] += offset[VX][lane];
+				clothing_weight.mV[VY] += offset[VY][lane];
+				clothing_weight.mV[VZ] += offset[VZ][lane];
+				clothing_weight.mV[VW] = lane_mask[lane];
+			}
+		}
+
+		// normals
+		gather(target.mScaledNormals, indices, x, y, z);
+		__m128 snx = _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mNormalX), w), mask), factor));
+		__m128 sny = _mm_add_ps(y, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mNormalY), w), mask), factor));
+		__m128 snz = _mm_add_ps(z, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mNormalZ), w), mask), factor));
+		scatter(target.mScaledNormals, indices, snx, sny, snz);
+		__m128 nx = snx, ny = sny, nz = snz;
+		normalize(nx, ny, nz);
+		scatter(target.mNormals, indices, nx, ny, nz);
+
+		// binormals
+		gather(target.mScaledBinormals, indices, x, y, z);
+		__m128 sbx = _mm_add_ps(x, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mBinormalX), w), mask), factor));
+		__m128 sby = _mm_add_ps(y, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mBinormalY), w), mask), factor));
+		__m128 sbz = _mm_add_ps(z, _mm_mul_ps(_mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mBinormalZ), w), mask), factor));
+		scatter(target.mScaledBinormals, indices, sbx, sby, sbz);
+		__m128 tx, ty, tz;
+		cross(sbx, sby, sbz, nx, ny, nz, tx, ty, tz);
+		__m128 bx, by, bz;
+		cross(nx, ny, nz, tx, ty, tz, bx, by, bz);
+		normalize(bx, by, bz);
+		scatter(target.mBinormals, indices, bx, by, bz);
+
+		// texture coordinates, two at a time
+		__m128 ds = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mTexCoordS), w), mask);
+		__m128 dt = _mm_mul_ps(_mm_mul_ps(_mm_loadu_ps(block.mTexCoordT), w), mask);
+		__m128 lo = _mm_unpacklo_ps(ds, dt);
+		__m128 hi = _mm_unpackhi_ps(ds, dt);
+		__m64* t0 = (__m64*)target.mTexCoords[indices[0]].mV;
+		__m64* t1 = (__m64*)target.mTexCoords[indices[1]].mV;
+		__m64* t2 = (__m64*)target.mTexCoords[indices[2]].mV;
+		__m64* t3 = (__m64*)target.mTexCoords[indices[3]].mV;
+		__m128 st01 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), t0), t1);
+		__m128 st23 = _mm_loadh_pi(_mm_loadl_pi(_mm_setzero_ps(), t2), t3);
+		st01 = _mm_add_ps(st01, lo);
+		st23 = _mm_add_ps(st23, hi);
+		_mm_storel_pi(t0, st01);
+		_mm_storeh_pi(t1, st01);
+		_mm_storel_pi(t2, st23);
+		_mm_storeh_pi(t3, st23);
+	}
+
+	applyRange(deltas, target, weight, mask_weights, normal_factor,
+			   deltas.mNumVectorBlocks * BLOCK_SIZE, deltas.mCount);
+}
+
+#else
+
+// static
+BOOL LLMorphDeltas::hasSSE2()
+{
+	return FALSE;
+}
+
+// static
+void LLMorphDeltas::applySSE2(const LLMorphDeltas& deltas, const Target& target,
+							  F32 weight, const F32* mask_weights, F32 normal_factor)
+{
+	applyScalar(deltas, target, weight, mask_weights, normal_factor);
+}
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @file llpatchnormals.cpp
+ * @brief Terrain patch normals, worked out a dirty rectangle at a time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llpatchnormals.h"
+
+#include "llfasttimer.h"
+#include "llstl.h"
+
+LLPatchNormals::LLPatchNormals(S32 patch_width, F32 meters_per_grid, void* user_data)
+	: mPatchWidth(patch_width),
+	  mOffset(meters_per_grid * BORDER),
+	  mUserData(user_data),
+	  mRect(0, 0, 0, 0),
+	  mMask((patch_width + 1) * (patch_width + 1), 0),
+	  mHeights((patch_width + 1 + 2 * BORDER) * (patch_width + 1 + 2 * BORDER), 0.f),
+	  mNormals((patch_width + 1) * (patch_width + 1))
+{
+}
+
+void LLPatchNormals::addRect(const LLRect& rect)
+{
+	LLRect clipped = rect;
+	clipped.intersectWith(LLRect(0, mPatchWidth + 1, mPatchWidth + 1, 0));
+	if (clipped.isEmpty())
+	{
+		return;
+	}
+	for (S32 y = clipped.mBottom; y < clipped.mTop; y++)
+	{
+		for (S32 x = clipped.mLeft; x < clipped.mRight; x++)
+		{
+			mMask[index(x, y)] = 1;
+		}
+	}
+	if (mRect.isEmpty())
+	{
+		mRect = clipped;
+	}
+	else
+	{
+		mRect.unionWith(clipped);
+	}
+}
+
+LLRect LLPatchNormals::getHeightsRect() const
+{
+	if (mRect.isEmpty())
+	{
+		return mRect;
+	}
+	LLRect rect = mRect;
+	return rect.stretch(BORDER);
+}
+
+// static
+LLRect LLPatchNormals::getAffectedRect(const LLRect& changed, S32 patch_width, S32 dx, S32 dy)
+{
+	if (changed.isEmpty())
+	{
+		return LLRect(0, 0, 0, 0);
+	}
+	LLRect rect = changed;
+	rect.stretch(BORDER);
+	rect.translate(-dx * patch_width, -dy * patch_width);
+	rect.intersectWith(LLRect(0, patch_width + 1, patch_width + 1, 0));
+	return rect;
+}
+
+static LLFastTimer::DeclareTimer FTM_PATCH_NORMALS("Patch Normals");
+
+void LLPatchNormals::calculate()
+{
+	LLFastTimer t(FTM_PATCH_NORMALS);
+
+	for (S32 y = mRect.mBottom; y < mRect.mTop; y++)
+	{
+		for (S32 x = mRect.mLeft; x < mRect.mRight; x++)
+		{
+			if (mMask[index(x, y)])
+			{
+				mNormals[index(x, y)] = calcNormal(getHeight(x - BORDER, y - BORDER),
+												   getHeight(x - BORDER, y + BORDER),
+												   getHeight(x + BORDER, y - BORDER),
+												   getHeight(x + BORDER, y + BORDER),
+												   mOffset);
+			}
+		}
+	}
+}
+
+// static
+LLVector3 LLPatchNormals::calcNormal(F32 z00, F32 z01, F32 z10, F32 z11, F32 offset)
+{
+	LLVector3 p00(-offset, -offset, z00);
+	LLVector3 p01(-offset, +offset, z01);
+	LLVector3 p10(+offset, -offset, z10);
+	LLVector3 p11(+offset, +offset, z11);
+
+	LLVector3 c1 = p11 - p00;
+	LLVector3 c2 = p01 - p10;
+
+	LLVector3 normal = c1;
+	normal %= c2;
+	normal.normVec();
+	return normal;
+}
+
+//----------------------------------------------------------------------------
+
+LLPatchNormalsThread::LLPatchNormalsThread(bool threaded)
+	: LLQueuedThread("patchnormals", threaded)
+{
+}
+
+// MAIN THREAD
+LLPatchNormalsThread::handle_t LLPatchNormalsThread::calculate(patch_normals_vec_t& batch, U32 priority)
+{
+	handle_t handle = generateHandle();
+	NormalsRequest* req = new NormalsRequest(handle, priority, batch);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLPatchNormalsThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+BOOL LLPatchNormalsThread::getResult(handle_t handle, patch_normals_vec_t& batch)
+{
+	batch.clear();
+	status_t status = getRequestStatus(handle);
+	if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+	{
+		return FALSE;
+	}
+	NormalsRequest* req = (NormalsRequest*)getRequest(handle);
+	if (req)
+	{
+		req->takeBatch(batch);
+		if (status != STATUS_COMPLETE)
+		{
+			for_each(batch.begin(), batch.end(), DeletePointer());
+			batch.clear();
+		}
+		completeRequest(handle);
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------------
+
+LLPatchNormalsThread::NormalsRequest::NormalsRequest(handle_t handle, U32 priority,
+													 patch_normals_vec_t& batch)
+	: LLQueuedThread::QueuedRequest(handle, priority, 0)
+{
+	mBatch.swap(batch);
+}
+
+LLPatchNormalsThread::NormalsRequest::~NormalsRequest()
+{
+	for_each(mBatch.begin(), mBatch.end(), DeletePointer());
+}
+
+bool LLPatchNormalsThread::NormalsRequest::processRequest()
+{
+	for (patch_normals_vec_t::iterator iter = mBatch.begin(); iter != mBatch.end(); ++iter)
+	{
+		(*iter)->calculate();
+	}
+	return true;
+}
+
+void LLPatchNormalsThread::NormalsRequest::finishRequest(bool completed)
+{
+	// Collected by LLPatchNormalsThread::getResult()
+}
+
+// MAIN THREAD
+void LLPatchNormalsThread::NormalsRequest::takeBatch(patch_normals_vec_t& batch)
+{
+	batch.swap(mBatch);
+	mBatch.clear();
+}
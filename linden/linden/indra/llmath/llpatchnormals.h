@@ -0,0 +1,144 @@
+/**
+ * @file llpatchnormals.h
+ * @brief Terrain patch normals, worked out a dirty rectangle at a time.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLPATCHNORMALS_H
+#define LL_LLPATCHNORMALS_H
+
+#include <vector>
+
+#include "llqueuedthread.h"
+#include "llrect.h"
+#include "v3math.h"
+
+// The normals of one terrain patch, as LLSurfacePatch::calcNormal() works
+// them out: each from the four heights BORDER grids away along the
+// diagonals.
+//
+// The heights come in a window that reaches BORDER grids past every side
+// of the patch, already looked up across the neighboring patches, so the
+// normals can be worked out anywhere, a thread included. Only the points
+// in the rectangles added are worked out, and only the heights within
+// BORDER grids of those need to be set.
+class LLPatchNormals
+{
+public:
+	static const S32 BORDER = 2;
+
+	// A patch patch_width grids on a side has normals for patch_width + 1
+	// points on a side, the last row and column being shared with the
+	// neighbors to the north and east.
+	LLPatchNormals(S32 patch_width, F32 meters_per_grid, void* user_data = NULL);
+
+	S32 getPatchWidth() const						{ return mPatchWidth; }
+	void* getUserData() const						{ return mUserData; }
+
+	// Adds the points from rect.mLeft to rect.mRight - 1, and rect.mBottom
+	// to rect.mTop - 1, clipped to the patch.
+	void addRect(const LLRect& rect);
+	// All of the points added, and the heights they need.
+	const LLRect& getRect() const					{ return mRect; }
+	LLRect getHeightsRect() const;
+	BOOL isEmpty() const							{ return mRect.isEmpty(); }
+	BOOL contains(S32 x, S32 y) const				{ return mMask[index(x, y)]; }
+
+	// x and y run from -BORDER to patch_width + BORDER.
+	void setHeight(S32 x, S32 y, F32 z)				{ mHeights[heightIndex(x, y)] = z; }
+	F32 getHeight(S32 x, S32 y) const				{ return mHeights[heightIndex(x, y)]; }
+
+	// Works out the normals of the points added.
+	void calculate();
+	const LLVector3& getNormal(S32 x, S32 y) const	{ return mNormals[index(x, y)]; }
+
+	// The points whose normals see the heights in changed, in the grid of
+	// the patch dx patches east and dy patches north of the one changed.
+	// Empty if there are none, that patch not being within BORDER grids.
+	static LLRect getAffectedRect(const LLRect& changed, S32 patch_width, S32 dx = 0, S32 dy = 0);
+
+	// The normal of the point in the middle of heights z00 at (-offset,
+	// -offset), z01 at (-offset, offset), z10 at (offset, -offset) and z11
+	// at (offset, offset).
+	static LLVector3 calcNormal(F32 z00, F32 z01, F32 z10, F32 z11, F32 offset);
+
+private:
+	S32 index(S32 x, S32 y) const					{ return y * (mPatchWidth + 1) + x; }
+	S32 heightIndex(S32 x, S32 y) const
+	{
+		return (y + BORDER) * (mPatchWidth + 1 + 2 * BORDER) + x + BORDER;
+	}
+
+	S32 mPatchWidth;
+	F32 mOffset;
+	void* mUserData;
+	LLRect mRect;
+	std::vector<U8> mMask;
+	std::vector<F32> mHeights;
+	std::vector<LLVector3> mNormals;
+};
+
+typedef std::vector<LLPatchNormals*> patch_normals_vec_t;
+
+// Works out LLPatchNormals on a thread of its own, a batch at a time.
+class LLPatchNormalsThread : public LLQueuedThread
+{
+public:
+	class NormalsRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~NormalsRequest(); // use deleteRequest()
+
+	public:
+		// Takes ownership of the patches in batch, and empties it.
+		NormalsRequest(handle_t handle, U32 priority, patch_normals_vec_t& batch);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		void takeBatch(patch_normals_vec_t& batch);
+
+	private:
+		patch_normals_vec_t mBatch;
+	};
+
+public:
+	LLPatchNormalsThread(bool threaded = true);
+
+	// Takes ownership of the patches in batch, and empties it.
+	handle_t calculate(patch_normals_vec_t& batch, U32 priority = PRIORITY_NORMAL);
+
+	// Returns FALSE while the request is still being worked on. Otherwise
+	// ends the request and hands back its patches, with their normals
+	// worked out, or none if it was aborted.
+	BOOL getResult(handle_t handle, patch_normals_vec_t& batch);
+};
+
+#endif // LL_LLPATCHNORMALS_H
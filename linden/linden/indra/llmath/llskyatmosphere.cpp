@@ -0,0 +1,447 @@
+/**
+ * @file llskyatmosphere.cpp
+ * @brief The WindLight sky colors of the sky and environment cube maps.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "llskyatmosphere.h"
+
+#include "llfasttimer.h"
+#include "llmath.h"
+#include "llstl.h"
+
+#include <algorithm>
+
+// Under the horizon.
+static const LLColor3 DARK_BROWN(0.082f, 0.076f, 0.066f);
+static const LLColor3 BROWN(0.430f, 0.386f, 0.322f);
+
+// How much of its color the shiny map keeps.
+static const F32 SATURATION = 0.3f;
+
+// Settings closer than this look the same, and the sun has moved by less
+// than a tenth of a degree.
+static const F32 KEY_SCALE = 1024.f;
+
+LLSkyCubeFace::texels_func_t LLSkyCubeFace::sCalcTexels = &LLSkyCubeFace::calcTexelsScalar;
+
+static void add_key(LLSkyAtmosphere::key_t& key, F32 value)
+{
+	key.push_back(llround(value * KEY_SCALE));
+}
+
+static void add_key(LLSkyAtmosphere::key_t& key, const LLColor3& value)
+{
+	for (S32 i = 0; i < 3; i++)
+	{
+		add_key(key, value.mV[i]);
+	}
+}
+
+// static
+LLSkyAtmosphere::key_t LLSkyAtmosphere::getKey(const Params& params)
+{
+	key_t key;
+	key.reserve(40);
+	add_key(key, params.mDomeRadius);
+	add_key(key, params.mDomeOffsetRatio);
+	add_key(key, params.mSunlightColor);
+	add_key(key, params.mAmbient);
+	add_key(key, params.mBlueDensity);
+	add_key(key, params.mBlueHorizon);
+	add_key(key, params.mHazeDensity);
+	add_key(key, params.mHazeHorizon);
+	add_key(key, params.mDensityMultiplier);
+	add_key(key, params.mMaxY);
+	add_key(key, params.mGlow);
+	add_key(key, params.mCloudShadow);
+	add_key(key, LLColor3(params.mLightNorm.mV[0], params.mLightNorm.mV[1], params.mLightNorm.mV[2]));
+	add_key(key, LLColor3(params.mFogColor));
+	key.push_back(params.mWindLightShaders);
+	return key;
+}
+
+LLSkyAtmosphere::LLSkyAtmosphere(const Params& params)
+	: mParams(params)
+{
+	// As LLVOSky::calcSkyColorWLVert() used to work them out for every
+	// direction.
+	LLColor3 light_atten =
+		(params.mBlueDensity * 1.0 + LLColor3(params.mHazeDensity * 0.25f, params.mHazeDensity * 0.25f, params.mHazeDensity * 0.25f))
+		* (params.mDensityMultiplier * params.mMaxY);
+	mNegLightAtten = light_atten * -1.f;
+
+	LLColor3 haze_density(params.mHazeDensity, params.mHazeDensity, params.mHazeDensity);
+	LLColor3 density = params.mBlueDensity + haze_density;
+	mNegDensity = density * -1.f;
+
+	LLColor3 blue_weight;
+	LLColor3 haze_weight;
+	for (S32 i = 0; i < 3; i++)
+	{
+		blue_weight.mV[i] = params.mBlueDensity.mV[i] / density.mV[i];
+		haze_weight.mV[i] = haze_density.mV[i] / density.mV[i];
+	}
+	mBlueTerm = params.mBlueHorizon * blue_weight;
+	mHazeTerm = params.mHazeHorizon.mV[0] * haze_weight;
+
+	mCloudAmbient = params.mAmbient + (LLColor3::white - params.mAmbient) * params.mCloudShadow * 0.5f;
+	mCloudSunlight = 1.f - params.mCloudShadow;
+
+	F32 atten = llmax(0.f, params.mLightNorm.mV[1] * 2.f);
+	atten = 1.f / atten;
+	LLColor3 sunlight = params.mSunlightColor;
+	for (S32 i = 0; i < 3; i++)
+	{
+		sunlight.mV[i] *= expf(mNegLightAtten.mV[i] * atten);
+	}
+	mSkyLighting = sunlight + params.mAmbient;
+
+	// And LLVOSky::calcSkyColorInDir() under the horizon.
+	const LLColor4& fog = params.mFogColor;
+	mFogSky = LLColor4(llmax(fog.mV[0], 0.2f), llmax(fog.mV[1], 0.2f), llmax(fog.mV[2], 0.22f), 0.f);
+	LLColor3 desat_fog = LLColor3(fog);
+	F32 brightness = desat_fog.brightness();
+	// So that shiny somewhat shows up at night.
+	if (brightness < 0.15f)
+	{
+		brightness = 0.15f;
+		desat_fog = LLColor3(0.15f, 0.15f, 0.15f);
+	}
+	LLColor3 greyscale(brightness, brightness, brightness);
+	desat_fog = desat_fog * SATURATION + greyscale * (1.0f - SATURATION);
+	if (!params.mWindLightShaders)
+	{
+		mFogShiny = LLColor4(desat_fog, 0.f);
+	}
+	else
+	{
+		mFogShiny = LLColor4(desat_fog * 0.5f, 0.f);
+	}
+}
+
+LLColor4 LLSkyAtmosphere::calcColor(const LLVector3& dir, BOOL shiny) const
+{
+	LLColor4 sky;
+	LLColor4 shiny_sky;
+	calcColors(dir, sky, shiny_sky);
+	return shiny ? shiny_sky : sky;
+}
+
+// turn on floating point precision
+// in vs2003 for this function.  Otherwise
+// sky is aliased looking 7:10 - 8:50
+#if LL_MSVC && __MSVC_VER__ < 8
+#pragma optimize("p", on)
+#endif
+
+void LLSkyAtmosphere::calcColors(const LLVector3& dir, LLColor4& sky, LLColor4& shiny) const
+{
+	if (dir.mV[VZ] < -0.02f)
+	{
+		sky = mFogSky;
+		shiny = mFogShiny;
+		float x = 1.0f-fabsf(-0.1f-dir.mV[VZ]);
+		x *= x;
+		F32 x2 = x*x;
+		F32 x25 = powf(x, 2.5f);
+		F32 x3 = x*x*x;
+		sky.mV[0] *= x2;
+		sky.mV[1] *= x25;
+		sky.mV[2] *= x3;
+		shiny.mV[0] *= x2;
+		shiny.mV[1] *= x25;
+		shiny.mV[2] *= x3;
+		return;
+	}
+
+	// undo OGL_TO_CFR_ROTATION and negate vertical direction.
+	LLVector3 Pn = LLVector3(-dir[1] , -dir[2], -dir[0]);
+
+	// project the direction ray onto the sky dome.
+	F32 phi = acosf(Pn[1]);
+	F32 sinA = sinf(F_PI - phi);
+	F32 Plen = mParams.mDomeRadius * sinf(F_PI + phi + asinf(mParams.mDomeOffsetRatio * sinA)) / sinA;
+
+	Pn *= Plen;
+
+	// Set altitude
+	if (Pn[1] > 0.f)
+	{
+		Pn *= (mParams.mMaxY / Pn[1]);
+	}
+	else
+	{
+		Pn *= (-32000.f / Pn[1]);
+	}
+
+	Plen = Pn.length();
+	Pn /= Plen;
+
+	// Compute sunlight from P & lightnorm (for long rays like sky)
+	F32 atten = llmax(F_APPROXIMATELY_ZERO, llmax(0.f, Pn[1]) * 1.0f + mParams.mLightNorm[1]);
+	atten = 1.f / atten;
+
+	// Distance
+	F32 distance = Plen * mParams.mDensityMultiplier;
+
+	// Compute haze glow
+	F32 glow = Pn * LLVector3(mParams.mLightNorm);
+	glow = 1.f - glow;
+		// glow is 0 at the sun and increases away from sun
+	glow = llmax(glow, .001f);
+		// Set a minimum "angle" (smaller glow.y allows tighter, brighter hotspot)
+	glow *= mParams.mGlow.mV[0];
+		// Higher glow.x gives dimmer glow (because next step is 1 / "angle")
+	glow = powf(glow, mParams.mGlow.mV[2]);
+		// glow.z should be negative, so we're doing a sort of (1 / "angle") function
+
+	// Add "minimum anti-solar illumination"
+	glow += .25f;
+
+	LLColor3 haze_color;
+	for (S32 i = 0; i < 3; i++)
+	{
+		// Sunlight attenuation effect (hue and brightness) due to atmosphere
+		F32 sunlight = mParams.mSunlightColor.mV[i];
+		sunlight *= expf(mNegLightAtten.mV[i] * atten);
+
+		// Transparency
+		F32 transparency = expf(mNegDensity.mV[i] * distance);
+
+		// Haze color above cloud
+		F32 haze = mBlueTerm.mV[i] * (sunlight + mParams.mAmbient.mV[i])
+				+ mHazeTerm.mV[i] * (sunlight * glow + mParams.mAmbient.mV[i]);
+
+		// Dim sunlight by cloud shadow percentage
+		sunlight *= mCloudSunlight;
+
+		// Haze color below cloud
+		F32 below_cloud = mBlueTerm.mV[i] * (sunlight + mCloudAmbient.mV[i])
+				+ mHazeTerm.mV[i] * (sunlight * glow + mCloudAmbient.mV[i]);
+
+		// Final atmosphere additive
+		haze *= 1.f - transparency;
+
+		// Attenuate cloud color by atmosphere
+		transparency = sqrtf(transparency);	//less atmos opacity (more transparency) below clouds
+
+		// At horizon, blend high altitude sky color towards the darker color below the clouds
+		haze += (below_cloud - haze) * (1.f - sqrtf(transparency));
+		haze_color.mV[i] = haze;
+	}
+
+	if (Pn[1] < 0.f)
+	{
+		F32 haze_brightness = haze_color.brightness();
+
+		if (Pn[1] < -0.05f)
+		{
+			haze_color = (DARK_BROWN + ((BROWN - DARK_BROWN) * (-Pn[1] * 0.9f))) * mSkyLighting * haze_brightness;
+		}
+
+		if (Pn[1] > -0.1f)
+		{
+			LLColor3 white = LLColor3::white * haze_brightness;
+			haze_color = white + ((haze_color - white) * fabs((Pn[1] + 0.05f) * -20.f));
+		}
+	}
+
+	LLColor3 sky_color = haze_color;
+	if (!mParams.mWindLightShaders)
+	{
+		for (S32 i = 0; i < 3; i++)
+		{
+			F32 color = 1.f - std::max(std::min(haze_color.mV[i] * 2.0f, 1.f), 0.f);
+			sky_color.mV[i] = 1.f - color;
+		}
+	}
+	sky = LLColor4(sky_color, 0.f);
+
+	F32 brightness = sky_color.brightness();
+	LLColor3 greyscale(brightness, brightness, brightness);
+	sky_color = sky_color * SATURATION + greyscale * (1.0f - SATURATION);
+	sky_color *= (0.5f + 0.5f * brightness);
+	shiny = LLColor4(sky_color, 0.f);
+}
+
+#if LL_MSVC && __MSVC_VER__ < 8
+#pragma optimize("p", off)
+#endif
+
+//----------------------------------------------------------------------------
+
+LLSkyCubeFace::LLSkyCubeFace(const LLSkyAtmosphere::Params& params, S32 face, S32 resolution, void* user_data)
+	: mAtmosphere(params),
+	  mFace(face),
+	  mResolution(resolution),
+	  mUserData(user_data),
+	  mDirX(resolution * resolution),
+	  mDirY(resolution * resolution),
+	  mDirZ(resolution * resolution),
+	  mSky(resolution * resolution),
+	  mShiny(resolution * resolution)
+{
+	for (S32 x = 0; x < resolution; x++)
+	{
+		for (S32 y = 0; y < resolution; y++)
+		{
+			LLVector3 dir = getDir(face, x, y, resolution);
+			S32 offset = x * resolution + y;
+			mDirX[offset] = dir.mV[VX];
+			mDirY[offset] = dir.mV[VY];
+			mDirZ[offset] = dir.mV[VZ];
+		}
+	}
+}
+
+// static
+LLVector3 LLSkyCubeFace::getDir(S32 face, S32 x, S32 y, S32 resolution)
+{
+	F32 coeff[3] = {0, 0, 0};
+	const S32 curr_coef = face >> 1; // 0/1 = Z axis, 2/3 = Y, 4/5 = X
+	const S32 side_dir = (((face & 1) << 1) - 1);  // even = -1, odd = 1
+	const S32 x_coef = (curr_coef + 1) % 3;
+	const S32 y_coef = (x_coef + 1) % 3;
+
+	coeff[curr_coef] = (F32)side_dir;
+
+	F32 inv_res = 1.f/resolution;
+	coeff[x_coef] = F32((x<<1) + 1) * inv_res - 1.f;
+	coeff[y_coef] = F32((y<<1) + 1) * inv_res - 1.f;
+	LLVector3 dir(coeff[0], coeff[1], coeff[2]);
+	dir.normalize();
+	return dir;
+}
+
+// static
+void LLSkyCubeFace::useSSE2(BOOL use_sse2)
+{
+	sCalcTexels = (use_sse2 && hasSSE2()) ? &calcTexelsSSE2 : &calcTexelsScalar;
+}
+
+static LLFastTimer::DeclareTimer FTM_SKY_CUBE_FACE("Sky Cube Map");
+
+void LLSkyCubeFace::calculate(S32 begin, S32 end)
+{
+	LLFastTimer t(FTM_SKY_CUBE_FACE);
+
+	sCalcTexels(*this, begin, end);
+}
+
+// static
+void LLSkyCubeFace::calcTexelsScalar(LLSkyCubeFace& face, S32 begin, S32 end)
+{
+	for (S32 i = begin; i < end; i++)
+	{
+		LLVector3 dir(face.mDirX[i], face.mDirY[i], face.mDirZ[i]);
+		face.mAtmosphere.calcColors(dir, face.mSky[i], face.mShiny[i]);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLSkyCubeFaceThread::LLSkyCubeFaceThread(bool threaded)
+	: LLQueuedThread("skycubeface", threaded)
+{
+}
+
+// MAIN THREAD
+LLSkyCubeFaceThread::handle_t LLSkyCubeFaceThread::calculate(sky_cube_face_vec_t& batch, U32 priority)
+{
+	handle_t handle = generateHandle();
+	FacesRequest* req = new FacesRequest(handle, priority, batch);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLSkyCubeFaceThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+BOOL LLSkyCubeFaceThread::getResult(handle_t handle, sky_cube_face_vec_t& batch)
+{
+	batch.clear();
+	status_t status = getRequestStatus(handle);
+	if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+	{
+		return FALSE;
+	}
+	FacesRequest* req = (FacesRequest*)getRequest(handle);
+	if (req)
+	{
+		req->takeBatch(batch);
+		if (status != STATUS_COMPLETE)
+		{
+			for_each(batch.begin(), batch.end(), DeletePointer());
+			batch.clear();
+		}
+		completeRequest(handle);
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------------
+
+LLSkyCubeFaceThread::FacesRequest::FacesRequest(handle_t handle, U32 priority,
+												sky_cube_face_vec_t& batch)
+	: LLQueuedThread::QueuedRequest(handle, priority, 0)
+{
+	mBatch.swap(batch);
+}
+
+LLSkyCubeFaceThread::FacesRequest::~FacesRequest()
+{
+	for_each(mBatch.begin(), mBatch.end(), DeletePointer());
+}
+
+bool LLSkyCubeFaceThread::FacesRequest::processRequest()
+{
+	for (sky_cube_face_vec_t::iterator iter = mBatch.begin(); iter != mBatch.end(); ++iter)
+	{
+		(*iter)->calculate();
+	}
+	return true;
+}
+
+void LLSkyCubeFaceThread::FacesRequest::finishRequest(bool completed)
+{
+	// Collected by LLSkyCubeFaceThread::getResult()
+}
+
+// MAIN THREAD
+void LLSkyCubeFaceThread::FacesRequest::takeBatch(sky_cube_face_vec_t& batch)
+{
+	batch.swap(mBatch);
+	mBatch.clear();
+}
@@ -0,0 +1,199 @@
+/**
+ * @file llskyatmosphere.h
+ * @brief The WindLight sky colors of the sky and environment cube maps.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#ifndef LL_LLSKYATMOSPHERE_H
+#define LL_LLSKYATMOSPHERE_H
+
+#include <vector>
+
+#include "llqueuedthread.h"
+#include "v3color.h"
+#include "v3math.h"
+#include "v4color.h"
+#include "v4math.h"
+
+// The colors LLVOSky gives the sky in every direction, and the shiny
+// environment map from them, the same as the WindLight sky shaders work
+// them out. Set up from a copy of the settings, so that it can be used on
+// any thread.
+class LLSkyAtmosphere
+{
+public:
+	// The WindLight settings as LLVOSky::initAtmospherics() reads them, the
+	// fog color, and whether the WindLight shaders are in use.
+	struct Params
+	{
+		F32 mDomeRadius;
+		F32 mDomeOffsetRatio;
+		LLColor3 mSunlightColor;
+		LLColor3 mAmbient;
+		LLColor3 mBlueDensity;
+		LLColor3 mBlueHorizon;
+		F32 mHazeDensity;
+		LLColor3 mHazeHorizon;
+		F32 mDensityMultiplier;
+		F32 mMaxY;
+		LLColor3 mGlow;
+		F32 mCloudShadow;
+		LLVector4 mLightNorm;		// clamped, with GL axes
+		LLColor4 mFogColor;
+		BOOL mWindLightShaders;
+	};
+
+	// Params rounded off finely enough that any that round to the same key
+	// give skies that look the same.
+	typedef std::vector<S32> key_t;
+	static key_t getKey(const Params& params);
+
+	LLSkyAtmosphere(const Params& params);
+
+	const Params& getParams() const					{ return mParams; }
+
+	// The colors in the unit direction dir, in the sky and in the shiny
+	// environment map, alpha 0.
+	void calcColors(const LLVector3& dir, LLColor4& sky, LLColor4& shiny) const;
+	LLColor4 calcColor(const LLVector3& dir, BOOL shiny = FALSE) const;
+
+private:
+	friend class LLSkyCubeFace;
+
+	Params mParams;
+
+	// Worked out from the settings alone.
+	LLColor3 mNegLightAtten;		// sunlight attenuation by the atmosphere
+	LLColor3 mNegDensity;			// and transparency
+	LLColor3 mBlueTerm;				// blue_horizon * blue_weight
+	LLColor3 mHazeTerm;				// haze_horizon * haze_weight
+	LLColor3 mCloudAmbient;			// ambient, more with more clouds
+	F32 mCloudSunlight;				// and sunlight, less
+	LLColor3 mSkyLighting;			// under the horizon
+	LLColor4 mFogSky;				// and under the fog
+	LLColor4 mFogShiny;
+};
+
+// The colors of one face of the sky cube map, and of the shiny environment
+// map with it, as LLVOSky puts them in its LLSkyTex: a texel at x, y is at
+// x * resolution + y. Holds its own copy of the atmosphere, so a face can
+// be worked out on any thread, in pieces if need be.
+class LLSkyCubeFace
+{
+public:
+	enum { NUM_FACES = 6 };
+
+	LLSkyCubeFace(const LLSkyAtmosphere::Params& params, S32 face, S32 resolution, void* user_data = NULL);
+
+	S32 getFace() const								{ return mFace; }
+	S32 getResolution() const						{ return mResolution; }
+	void* getUserData() const						{ return mUserData; }
+	const LLSkyAtmosphere& getAtmosphere() const	{ return mAtmosphere; }
+
+	// The unit direction of the texel at x, y of a face.
+	static LLVector3 getDir(S32 face, S32 x, S32 y, S32 resolution);
+
+	// Works out texels begin to end - 1, or all of them.
+	void calculate(S32 begin, S32 end);
+	void calculate()								{ calculate(0, mResolution * mResolution); }
+
+	const LLColor4* getSky() const					{ return &mSky[0]; }
+	const LLColor4* getShiny() const				{ return &mShiny[0]; }
+
+	// As with LLVertexXform, this is the one to call, and the SSE2 version
+	// gives exactly the same results as the scalar one.
+	typedef void (*texels_func_t)(LLSkyCubeFace& face, S32 begin, S32 end);
+
+	static texels_func_t sCalcTexels;
+
+	// Falls back to the scalar version if this build has no SSE2 version.
+	// Don't turn SSE2 on for CPUs that lack it.
+	static void useSSE2(BOOL use_sse2);
+	static BOOL usingSSE2()							{ return sCalcTexels == &calcTexelsSSE2; }
+	// Whether the SSE2 version was compiled in.
+	static BOOL hasSSE2();
+
+	static void calcTexelsScalar(LLSkyCubeFace& face, S32 begin, S32 end);
+	// llskyatmosphere_sse2.cpp
+	static void calcTexelsSSE2(LLSkyCubeFace& face, S32 begin, S32 end);
+
+private:
+	LLSkyAtmosphere mAtmosphere;
+	S32 mFace;
+	S32 mResolution;
+	void* mUserData;
+
+	// The directions of the texels, by axis.
+	std::vector<F32> mDirX;
+	std::vector<F32> mDirY;
+	std::vector<F32> mDirZ;
+
+	std::vector<LLColor4> mSky;
+	std::vector<LLColor4> mShiny;
+};
+
+typedef std::vector<LLSkyCubeFace*> sky_cube_face_vec_t;
+
+// Works out LLSkyCubeFaces on a thread of its own, a batch at a time.
+class LLSkyCubeFaceThread : public LLQueuedThread
+{
+public:
+	class FacesRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~FacesRequest(); // use deleteRequest()
+
+	public:
+		// Takes ownership of the faces in batch, and empties it.
+		FacesRequest(handle_t handle, U32 priority, sky_cube_face_vec_t& batch);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		void takeBatch(sky_cube_face_vec_t& batch);
+
+	private:
+		sky_cube_face_vec_t mBatch;
+	};
+
+public:
+	LLSkyCubeFaceThread(bool threaded = true);
+
+	// Takes ownership of the faces in batch, and empties it.
+	handle_t calculate(sky_cube_face_vec_t& batch, U32 priority = PRIORITY_NORMAL);
+
+	// Returns FALSE while the request is still being worked on. Otherwise
+	// ends the request and hands back its faces, worked out, or none if it
+	// was aborted.
+	BOOL getResult(handle_t handle, sky_cube_face_vec_t& batch);
+};
+
+#endif // LL_LLSKYATMOSPHERE_H
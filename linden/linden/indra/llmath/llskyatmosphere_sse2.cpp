@@ -0,0 +1,280 @@
+/**
+ * @file llskyatmosphere_sse2.cpp
+ * @brief SSE2 versions of the LLSkyAtmosphere kernels.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llskyatmosphere.h"
+
+#include "llmath.h"
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#if LL_VECTORIZE && (defined(__SSE2__) || _M_IX86_FP >= 2 || defined(_M_X64))
+
+#include <emmintrin.h>
+
+// The transcendentals are left to the C library a lane at a time, so as to
+// get exactly what the scalar version gets.
+inline __m128 expf_lanes(__m128 v)
+{
+	F32 f[4];
+	_mm_storeu_ps(f, v);
+	return _mm_setr_ps(expf(f[0]), expf(f[1]), expf(f[2]), expf(f[3]));
+}
+
+inline __m128 powf_lanes(__m128 v, F32 e)
+{
+	F32 f[4];
+	_mm_storeu_ps(f, v);
+	return _mm_setr_ps(powf(f[0], e), powf(f[1], e), powf(f[2], e), powf(f[3], e));
+}
+
+inline __m128 select_ps(__m128 mask, __m128 a, __m128 b)
+{
+	return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+}
+
+inline void store_colors(LLColor4* colors, __m128 r, __m128 g, __m128 b)
+{
+	__m128 a = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(r, g, b, a);
+	_mm_storeu_ps(colors[0].mV, r);
+	_mm_storeu_ps(colors[1].mV, g);
+	_mm_storeu_ps(colors[2].mV, b);
+	_mm_storeu_ps(colors[3].mV, a);
+}
+
+// static
+BOOL LLSkyCubeFace::hasSSE2()
+{
+	return TRUE;
+}
+
+// Four texels at a time, as LLSkyAtmosphere::calcColors() works each out.
+// static
+void LLSkyCubeFace::calcTexelsSSE2(LLSkyCubeFace& face, S32 begin, S32 end)
+{
+	const LLSkyAtmosphere& atmos = face.mAtmosphere;
+	const LLSkyAtmosphere::Params& params = atmos.mParams;
+
+	const __m128 zero = _mm_setzero_ps();
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 sign = _mm_set1_ps(-0.f);
+	const __m128 light_norm[3] = { _mm_set1_ps(params.mLightNorm.mV[0]),
+								   _mm_set1_ps(params.mLightNorm.mV[1]),
+								   _mm_set1_ps(params.mLightNorm.mV[2]) };
+	const LLColor3 brown_mix = LLColor3(0.430f, 0.386f, 0.322f) - LLColor3(0.082f, 0.076f, 0.066f);
+	const F32 dark_brown[3] = { 0.082f, 0.076f, 0.066f };
+	const F32 saturation = 0.3f;
+
+	S32 i = begin;
+	for (; i + 4 <= end; i += 4)
+	{
+		__m128 dir_x = _mm_loadu_ps(&face.mDirX[i]);
+		__m128 dir_y = _mm_loadu_ps(&face.mDirY[i]);
+		__m128 dir_z = _mm_loadu_ps(&face.mDirZ[i]);
+		__m128 under = _mm_cmplt_ps(dir_z, _mm_set1_ps(-0.02f));
+		S32 under_mask = _mm_movemask_ps(under);
+
+		__m128 sky[3];
+		__m128 shiny[3];
+		if (under_mask != 0xf)
+		{
+			// undo OGL_TO_CFR_ROTATION and negate vertical direction.
+			__m128 pn_x = _mm_xor_ps(dir_y, sign);
+			__m128 pn_y = _mm_xor_ps(dir_z, sign);
+			__m128 pn_z = _mm_xor_ps(dir_x, sign);
+
+			// project the direction ray onto the sky dome.
+			F32 pn_y_lanes[4];
+			F32 plen_lanes[4];
+			_mm_storeu_ps(pn_y_lanes, pn_y);
+			for (S32 l = 0; l < 4; l++)
+			{
+				F32 phi = acosf(pn_y_lanes[l]);
+				F32 sinA = sinf(F_PI - phi);
+				plen_lanes[l] = params.mDomeRadius * sinf(F_PI + phi + asinf(params.mDomeOffsetRatio * sinA)) / sinA;
+			}
+			__m128 plen = _mm_loadu_ps(plen_lanes);
+			pn_x = _mm_mul_ps(pn_x, plen);
+			pn_y = _mm_mul_ps(pn_y, plen);
+			pn_z = _mm_mul_ps(pn_z, plen);
+
+			// Set altitude
+			__m128 altitude = select_ps(_mm_cmpgt_ps(pn_y, zero), _mm_set1_ps(params.mMaxY), _mm_set1_ps(-32000.f));
+			__m128 scale = _mm_div_ps(altitude, pn_y);
+			pn_x = _mm_mul_ps(pn_x, scale);
+			pn_y = _mm_mul_ps(pn_y, scale);
+			pn_z = _mm_mul_ps(pn_z, scale);
+
+			plen = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(pn_x, pn_x), _mm_mul_ps(pn_y, pn_y)),
+										  _mm_mul_ps(pn_z, pn_z)));
+			__m128 plen_inv = _mm_div_ps(one, plen);
+			pn_x = _mm_mul_ps(pn_x, plen_inv);
+			pn_y = _mm_mul_ps(pn_y, plen_inv);
+			pn_z = _mm_mul_ps(pn_z, plen_inv);
+
+			__m128 atten = _mm_max_ps(_mm_set1_ps(F_APPROXIMATELY_ZERO),
+									  _mm_add_ps(_mm_max_ps(zero, pn_y), light_norm[1]));
+			atten = _mm_div_ps(one, atten);
+
+			__m128 distance = _mm_mul_ps(plen, _mm_set1_ps(params.mDensityMultiplier));
+
+			__m128 glow = _mm_add_ps(_mm_add_ps(_mm_mul_ps(pn_x, light_norm[0]), _mm_mul_ps(pn_y, light_norm[1])),
+									 _mm_mul_ps(pn_z, light_norm[2]));
+			glow = _mm_sub_ps(one, glow);
+			glow = _mm_max_ps(glow, _mm_set1_ps(.001f));
+			glow = _mm_mul_ps(glow, _mm_set1_ps(params.mGlow.mV[0]));
+			glow = powf_lanes(glow, params.mGlow.mV[2]);
+			glow = _mm_add_ps(glow, _mm_set1_ps(.25f));
+
+			__m128 haze[3];
+			for (S32 c = 0; c < 3; c++)
+			{
+				__m128 ambient = _mm_set1_ps(params.mAmbient.mV[c]);
+				__m128 cloud_ambient = _mm_set1_ps(atmos.mCloudAmbient.mV[c]);
+				__m128 blue_term = _mm_set1_ps(atmos.mBlueTerm.mV[c]);
+				__m128 haze_term = _mm_set1_ps(atmos.mHazeTerm.mV[c]);
+
+				__m128 sunlight = _mm_mul_ps(_mm_set1_ps(params.mSunlightColor.mV[c]),
+											 expf_lanes(_mm_mul_ps(_mm_set1_ps(atmos.mNegLightAtten.mV[c]), atten)));
+				__m128 transparency = expf_lanes(_mm_mul_ps(_mm_set1_ps(atmos.mNegDensity.mV[c]), distance));
+
+				__m128 above = _mm_add_ps(_mm_mul_ps(blue_term, _mm_add_ps(sunlight, ambient)),
+										  _mm_mul_ps(haze_term, _mm_add_ps(_mm_mul_ps(sunlight, glow), ambient)));
+				sunlight = _mm_mul_ps(sunlight, _mm_set1_ps(atmos.mCloudSunlight));
+				__m128 below = _mm_add_ps(_mm_mul_ps(blue_term, _mm_add_ps(sunlight, cloud_ambient)),
+										  _mm_mul_ps(haze_term, _mm_add_ps(_mm_mul_ps(sunlight, glow), cloud_ambient)));
+
+				above = _mm_mul_ps(above, _mm_sub_ps(one, transparency));
+				transparency = _mm_sqrt_ps(transparency);
+				haze[c] = _mm_add_ps(above, _mm_mul_ps(_mm_sub_ps(below, above),
+													   _mm_sub_ps(one, _mm_sqrt_ps(transparency))));
+			}
+
+			__m128 horizon = _mm_cmplt_ps(pn_y, zero);
+			if (_mm_movemask_ps(horizon))
+			{
+				__m128 brightness = _mm_div_ps(_mm_add_ps(_mm_add_ps(haze[0], haze[1]), haze[2]), _mm_set1_ps(3.0f));
+
+				__m128 brown = _mm_and_ps(horizon, _mm_cmplt_ps(pn_y, _mm_set1_ps(-0.05f)));
+				__m128 amount = _mm_mul_ps(_mm_xor_ps(pn_y, sign), _mm_set1_ps(0.9f));
+				for (S32 c = 0; c < 3; c++)
+				{
+					__m128 color = _mm_add_ps(_mm_set1_ps(dark_brown[c]), _mm_mul_ps(_mm_set1_ps(brown_mix.mV[c]), amount));
+					color = _mm_mul_ps(_mm_mul_ps(color, _mm_set1_ps(atmos.mSkyLighting.mV[c])), brightness);
+					haze[c] = select_ps(brown, color, haze[c]);
+				}
+
+				__m128 white = _mm_and_ps(horizon, _mm_cmpgt_ps(pn_y, _mm_set1_ps(-0.1f)));
+				amount = _mm_andnot_ps(sign, _mm_mul_ps(_mm_add_ps(pn_y, _mm_set1_ps(0.05f)), _mm_set1_ps(-20.f)));
+				for (S32 c = 0; c < 3; c++)
+				{
+					__m128 color = _mm_add_ps(brightness, _mm_mul_ps(_mm_sub_ps(haze[c], brightness), amount));
+					haze[c] = select_ps(white, color, haze[c]);
+				}
+			}
+
+			for (S32 c = 0; c < 3; c++)
+			{
+				sky[c] = haze[c];
+				if (!params.mWindLightShaders)
+				{
+					__m128 color = _mm_max_ps(zero, _mm_min_ps(one, _mm_mul_ps(haze[c], _mm_set1_ps(2.0f))));
+					sky[c] = _mm_sub_ps(one, _mm_sub_ps(one, color));
+				}
+			}
+
+			__m128 brightness = _mm_div_ps(_mm_add_ps(_mm_add_ps(sky[0], sky[1]), sky[2]), _mm_set1_ps(3.0f));
+			__m128 grey = _mm_mul_ps(brightness, _mm_set1_ps(1.0f - saturation));
+			__m128 scale_shiny = _mm_add_ps(_mm_set1_ps(0.5f), _mm_mul_ps(_mm_set1_ps(0.5f), brightness));
+			for (S32 c = 0; c < 3; c++)
+			{
+				shiny[c] = _mm_add_ps(_mm_mul_ps(sky[c], _mm_set1_ps(saturation)), grey);
+				shiny[c] = _mm_mul_ps(shiny[c], scale_shiny);
+			}
+		}
+
+		if (under_mask)
+		{
+			__m128 x = _mm_sub_ps(one, _mm_andnot_ps(sign, _mm_sub_ps(_mm_set1_ps(-0.1f), dir_z)));
+			x = _mm_mul_ps(x, x);
+			__m128 falloff[3] = { _mm_mul_ps(x, x),
+								  powf_lanes(x, 2.5f),
+								  _mm_mul_ps(_mm_mul_ps(x, x), x) };
+			for (S32 c = 0; c < 3; c++)
+			{
+				__m128 fog_sky = _mm_mul_ps(_mm_set1_ps(atmos.mFogSky.mV[c]), falloff[c]);
+				__m128 fog_shiny = _mm_mul_ps(_mm_set1_ps(atmos.mFogShiny.mV[c]), falloff[c]);
+				if (under_mask == 0xf)
+				{
+					sky[c] = fog_sky;
+					shiny[c] = fog_shiny;
+				}
+				else
+				{
+					sky[c] = select_ps(under, fog_sky, sky[c]);
+					shiny[c] = select_ps(under, fog_shiny, shiny[c]);
+				}
+			}
+		}
+
+		store_colors(&face.mSky[i], sky[0], sky[1], sky[2]);
+		store_colors(&face.mShiny[i], shiny[0], shiny[1], shiny[2]);
+	}
+
+	for (; i < end; i++)
+	{
+		LLVector3 dir(face.mDirX[i], face.mDirY[i], face.mDirZ[i]);
+		atmos.calcColors(dir, face.mSky[i], face.mShiny[i]);
+	}
+}
+
+#else
+
+// static
+BOOL LLSkyCubeFace::hasSSE2()
+{
+	return FALSE;
+}
+
+// static
+void LLSkyCubeFace::calcTexelsSSE2(LLSkyCubeFace& face, S32 begin, S32 end)
+{
+	calcTexelsScalar(face, begin, end);
+}
+
+#endif
@@ -0,0 +1,135 @@
+/**
+ * @file llvertexxform.cpp
+ * @brief Batch transforms of volume face vertices into vertex buffers.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llvertexxform.h"
+
+#include "m3math.h"
+#include "m4math.h"
+#include "v2math.h"
+#include "v3math.h"
+
+LLVertexXform::points_func_t		LLVertexXform::sTransformPoints = &LLVertexXform::transformPointsScalar;
+LLVertexXform::normals_func_t		LLVertexXform::sTransformNormals = &LLVertexXform::transformNormalsScalar;
+LLVertexXform::tex_coords_func_t	LLVertexXform::sTransformTexCoords = &LLVertexXform::transformTexCoordsScalar;
+
+// static
+void LLVertexXform::useSSE2(BOOL use_sse2)
+{
+	if (use_sse2 && hasSSE2())
+	{
+		sTransformPoints = &transformPointsSSE2;
+		sTransformNormals = &transformNormalsSSE2;
+		sTransformTexCoords = &transformTexCoordsSSE2;
+	}
+	else
+	{
+		sTransformPoints = &transformPointsScalar;
+		sTransformNormals = &transformNormalsScalar;
+		sTransformTexCoords = &transformTexCoordsScalar;
+	}
+}
+
+// static
+void LLVertexXform::transformTexCoord(const TexCoordXform& xform, LLVector2& tex_coord)
+{
+	F32 s = tex_coord.mV[0];
+	F32 t = tex_coord.mV[1];
+
+	// Texture transforms are done about the center of the face.
+	s -= 0.5; 
+	t -= 0.5;
+
+	// Handle rotation
+	F32 temp = s;
+	s  = s     * xform.mCos + t * xform.mSin;
+	t  = -temp * xform.mSin + t * xform.mCos;
+
+	// Then scale
+	s *= xform.mScaleS;
+	t *= xform.mScaleT;
+
+	// Then offset
+	s += xform.mOffsetS + 0.5f; 
+	t += xform.mOffsetT + 0.5f;
+
+	tex_coord.mV[0] = s;
+	tex_coord.mV[1] = t;
+}
+
+// static
+void LLVertexXform::transformPointsScalar(const LLMatrix4& mat, const LLVector3* src, U32 src_stride,
+										  LLVector3* dst, U32 dst_stride, S32 count)
+{
+	const U8* srcp = (const U8*)src;
+	U8* dstp = (U8*)dst;
+	for (S32 i = 0; i < count; i++)
+	{
+		*(LLVector3*)dstp = *(const LLVector3*)srcp * mat;
+		srcp += src_stride;
+		dstp += dst_stride;
+	}
+}
+
+// static
+void LLVertexXform::transformNormalsScalar(const LLMatrix3& mat, const LLVector3* src, U32 src_stride,
+										   LLVector3* dst, U32 dst_stride, S32 count)
+{
+	const U8* srcp = (const U8*)src;
+	U8* dstp = (U8*)dst;
+	for (S32 i = 0; i < count; i++)
+	{
+		LLVector3 normal = *(const LLVector3*)srcp * mat;
+		normal.normVec();
+		*(LLVector3*)dstp = normal;
+		srcp += src_stride;
+		dstp += dst_stride;
+	}
+}
+
+// static
+void LLVertexXform::transformTexCoordsScalar(const TexCoordXform& xform, const LLVector2* src, U32 src_stride,
+											 LLVector2* dst, U32 dst_stride, S32 count)
+{
+	const U8* srcp = (const U8*)src;
+	U8* dstp = (U8*)dst;
+	for (S32 i = 0; i < count; i++)
+	{
+		LLVector2 tc = *(const LLVector2*)srcp;
+		transformTexCoord(xform, tc);
+		*(LLVector2*)dstp = tc;
+		srcp += src_stride;
+		dstp += dst_stride;
+	}
+}
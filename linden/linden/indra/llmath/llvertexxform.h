@@ -0,0 +1,110 @@
+/**
+ * @file llvertexxform.h
+ * @brief Batch transforms of volume face vertices into vertex buffers.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLVERTEXXFORM_H
+#define LL_LLVERTEXXFORM_H
+
+#include "stdtypes.h"
+
+class LLMatrix3;
+class LLMatrix4;
+class LLVector2;
+class LLVector3;
+
+// Transforms runs of vertex attributes from one strided array into
+// another, which is what rebuilding a face into an interleaved
+// LLVertexBuffer amounts to. Strides are in bytes, as LLStrider has them.
+//
+// Each transform has a scalar reference version, which does exactly what
+// the per vertex LLVector3/LLMatrix4 math does, and an SSE2 version, which
+// transposes four vertices at a time into structure of arrays form and
+// agrees with the reference to within rounding. The s* function pointers
+// are the ones to call; useSSE2() picks between the two.
+class LLVertexXform
+{
+public:
+	// A texture entry's rotation, scale and offset, which are applied about
+	// the center of the face.
+	struct TexCoordXform
+	{
+		F32 mCos;
+		F32 mSin;
+		F32 mOffsetS;
+		F32 mOffsetT;
+		F32 mScaleS;
+		F32 mScaleT;
+	};
+
+	// dst = src * mat
+	typedef void (*points_func_t)(const LLMatrix4& mat,
+								  const LLVector3* src, U32 src_stride,
+								  LLVector3* dst, U32 dst_stride, S32 count);
+	// dst = src * mat, normalized with LLVector3::normVec()
+	typedef void (*normals_func_t)(const LLMatrix3& mat,
+								   const LLVector3* src, U32 src_stride,
+								   LLVector3* dst, U32 dst_stride, S32 count);
+	typedef void (*tex_coords_func_t)(const TexCoordXform& xform,
+									  const LLVector2* src, U32 src_stride,
+									  LLVector2* dst, U32 dst_stride, S32 count);
+
+	static points_func_t		sTransformPoints;
+	static normals_func_t		sTransformNormals;
+	static tex_coords_func_t	sTransformTexCoords;
+
+	// Falls back to the scalar versions if this build has no SSE2 versions.
+	// Don't turn SSE2 on for CPUs that lack it.
+	static void useSSE2(BOOL use_sse2);
+	static BOOL usingSSE2()			{ return sTransformPoints == &transformPointsSSE2; }
+	// Whether the SSE2 versions were compiled in.
+	static BOOL hasSSE2();
+
+	// Texture coordinate xform as LLFace has always done it.
+	static void transformTexCoord(const TexCoordXform& xform, LLVector2& tex_coord);
+
+	static void transformPointsScalar(const LLMatrix4& mat, const LLVector3* src, U32 src_stride,
+									  LLVector3* dst, U32 dst_stride, S32 count);
+	static void transformNormalsScalar(const LLMatrix3& mat, const LLVector3* src, U32 src_stride,
+									   LLVector3* dst, U32 dst_stride, S32 count);
+	static void transformTexCoordsScalar(const TexCoordXform& xform, const LLVector2* src, U32 src_stride,
+										 LLVector2* dst, U32 dst_stride, S32 count);
+
+	// llvertexxform_sse2.cpp
+	static void transformPointsSSE2(const LLMatrix4& mat, const LLVector3* src, U32 src_stride,
+									LLVector3* dst, U32 dst_stride, S32 count);
+	static void transformNormalsSSE2(const LLMatrix3& mat, const LLVector3* src, U32 src_stride,
+									 LLVector3* dst, U32 dst_stride, S32 count);
+	static void transformTexCoordsSSE2(const TexCoordXform& xform, const LLVector2* src, U32 src_stride,
+									   LLVector2* dst, U32 dst_stride, S32 count);
+};
+
+#endif // LL_LLVERTEXXFORM_H
@@ -0,0 +1,237 @@
+/**
+ * @file llvertexxform_sse2.cpp
+ * @brief SSE2 versions of the LLVertexXform batch transforms.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llvertexxform.h"
+
+#include "llv4math.h"		// for LL_VECTORIZE
+#include "m3math.h"
+#include "m4math.h"
+#include "v2math.h"
+#include "v3math.h"
+
+#if LL_VECTORIZE && (defined(__SSE2__) || _M_IX86_FP >= 2 || defined(_M_X64))
+
+#include <emmintrin.h>
+
+// Loads four vectors and transposes them into x, y and z. Reads 16 bytes
+// for each, so the last vector of an array has to be left to the scalar
+// version.
+inline void load_soa(const U8* p, U32 stride, __m128& x, __m128& y, __m128& z)
+{
+	__m128 r0 = _mm_loadu_ps((const F32*)p);
+	__m128 r1 = _mm_loadu_ps((const F32*)(p + stride));
+	__m128 r2 = _mm_loadu_ps((const F32*)(p + 2 * stride));
+	__m128 r3 = _mm_loadu_ps((const F32*)(p + 3 * stride));
+	_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+	x = r0;
+	y = r1;
+	z = r2;
+}
+
+// Writes exactly 12 bytes, vertex buffers are interleaved.
+inline void store_vector3(U8* p, __m128 v)
+{
+	_mm_storel_pi((__m64*)p, v);
+	_mm_store_ss((F32*)p + 2, _mm_movehl_ps(v, v));
+}
+
+inline void store_aos(U8* p, U32 stride, __m128 x, __m128 y, __m128 z)
+{
+	__m128 w = _mm_setzero_ps();
+	_MM_TRANSPOSE4_PS(x, y, z, w);
+	store_vector3(p, x);
+	store_vector3(p + stride, y);
+	store_vector3(p + 2 * stride, z);
+	store_vector3(p + 3 * stride, w);
+}
+
+// static
+BOOL LLVertexXform::hasSSE2()
+{
+	return TRUE;
+}
+
+// static
+void LLVertexXform::transformPointsSSE2(const LLMatrix4& mat, const LLVector3* src, U32 src_stride,
+										LLVector3* dst, U32 dst_stride, S32 count)
+{
+	const __m128 m00 = _mm_set1_ps(mat.mMatrix[VX][VX]);
+	const __m128 m01 = _mm_set1_ps(mat.mMatrix[VX][VY]);
+	const __m128 m02 = _mm_set1_ps(mat.mMatrix[VX][VZ]);
+	const __m128 m10 = _mm_set1_ps(mat.mMatrix[VY][VX]);
+	const __m128 m11 = _mm_set1_ps(mat.mMatrix[VY][VY]);
+	const __m128 m12 = _mm_set1_ps(mat.mMatrix[VY][VZ]);
+	const __m128 m20 = _mm_set1_ps(mat.mMatrix[VZ][VX]);
+	const __m128 m21 = _mm_set1_ps(mat.mMatrix[VZ][VY]);
+	const __m128 m22 = _mm_set1_ps(mat.mMatrix[VZ][VZ]);
+	const __m128 m30 = _mm_set1_ps(mat.mMatrix[VW][VX]);
+	const __m128 m31 = _mm_set1_ps(mat.mMatrix[VW][VY]);
+	const __m128 m32 = _mm_set1_ps(mat.mMatrix[VW][VZ]);
+
+	const U8* srcp = (const U8*)src;
+	U8* dstp = (U8*)dst;
+	S32 i = 0;
+	for ( ; i + 4 < count; i += 4)
+	{
+		__m128 x, y, z;
+		load_soa(srcp, src_stride, x, y, z);
+
+		// Same order of operations as LLVector3 * LLMatrix4
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_mul_ps(z, m20)), m30);
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m21)), m31);
+		__m128 oz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_mul_ps(z, m22)), m32);
+
+		store_aos(dstp, dst_stride, ox, oy, oz);
+		srcp += 4 * src_stride;
+		dstp += 4 * dst_stride;
+	}
+	transformPointsScalar(mat, (const LLVector3*)srcp, src_stride, (LLVector3*)dstp, dst_stride, count - i);
+}
+
+// static
+void LLVertexXform::transformNormalsSSE2(const LLMatrix3& mat, const LLVector3* src, U32 src_stride,
+										 LLVector3* dst, U32 dst_stride, S32 count)
+{
+	const __m128 m00 = _mm_set1_ps(mat.mMatrix[VX][VX]);
+	const __m128 m01 = _mm_set1_ps(mat.mMatrix[VX][VY]);
+	const __m128 m02 = _mm_set1_ps(mat.mMatrix[VX][VZ]);
+	const __m128 m10 = _mm_set1_ps(mat.mMatrix[VY][VX]);
+	const __m128 m11 = _mm_set1_ps(mat.mMatrix[VY][VY]);
+	const __m128 m12 = _mm_set1_ps(mat.mMatrix[VY][VZ]);
+	const __m128 m20 = _mm_set1_ps(mat.mMatrix[VZ][VX]);
+	const __m128 m21 = _mm_set1_ps(mat.mMatrix[VZ][VY]);
+	const __m128 m22 = _mm_set1_ps(mat.mMatrix[VZ][VZ]);
+	const __m128 one = _mm_set1_ps(1.f);
+	const __m128 threshold = _mm_set1_ps(FP_MAG_THRESHOLD);
+
+	const U8* srcp = (const U8*)src;
+	U8* dstp = (U8*)dst;
+	S32 i = 0;
+	for ( ; i + 4 < count; i += 4)
+	{
+		__m128 x, y, z;
+		load_soa(srcp, src_stride, x, y, z);
+
+		__m128 ox = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m00), _mm_mul_ps(y, m10)), _mm_mul_ps(z, m20));
+		__m128 oy = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m01), _mm_mul_ps(y, m11)), _mm_mul_ps(z, m21));
+		__m128 oz = _mm_add_ps(_mm_add_ps(_mm_mul_ps(x, m02), _mm_mul_ps(y, m12)), _mm_mul_ps(z, m22));
+
+		// normVec(). The single precision square root rounds the same as
+		// fsqrtf()'s double one, and short vectors come out as zero.
+		__m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(ox, ox), _mm_mul_ps(oy, oy)), _mm_mul_ps(oz, oz)));
+		__m128 keep = _mm_cmpgt_ps(mag, threshold);
+		__m128 oomag = _mm_div_ps(one, mag);
+		ox = _mm_and_ps(keep, _mm_mul_ps(ox, oomag));
+		oy = _mm_and_ps(keep, _mm_mul_ps(oy, oomag));
+		oz = _mm_and_ps(keep, _mm_mul_ps(oz, oomag));
+
+		store_aos(dstp, dst_stride, ox, oy, oz);
+		srcp += 4 * src_stride;
+		dstp += 4 * dst_stride;
+	}
+	transformNormalsScalar(mat, (const LLVector3*)srcp, src_stride, (LLVector3*)dstp, dst_stride, count - i);
+}
+
+// static
+void LLVertexXform::transformTexCoordsSSE2(const TexCoordXform& xform, const LLVector2* src, U32 src_stride,
+										   LLVector2* dst, U32 dst_stride, S32 count)
+{
+	const __m128 half = _mm_set1_ps(0.5f);
+	const __m128 cos_ang = _mm_set1_ps(xform.mCos);
+	const __m128 sin_ang = _mm_set1_ps(xform.mSin);
+	const __m128 scale_s = _mm_set1_ps(xform.mScaleS);
+	const __m128 scale_t = _mm_set1_ps(xform.mScaleT);
+	const __m128 offset_s = _mm_set1_ps(xform.mOffsetS + 0.5f);
+	const __m128 offset_t = _mm_set1_ps(xform.mOffsetT + 0.5f);
+
+	const U8* srcp = (const U8*)src;
+	U8* dstp = (U8*)dst;
+	S32 i = 0;
+	for ( ; i + 4 <= count; i += 4)
+	{
+		__m128 v01 = _mm_loadh_pi(_mm_loadl_pi(half, (const __m64*)srcp), (const __m64*)(srcp + src_stride));
+		__m128 v23 = _mm_loadh_pi(_mm_loadl_pi(half, (const __m64*)(srcp + 2 * src_stride)),
+								  (const __m64*)(srcp + 3 * src_stride));
+		__m128 s = _mm_sub_ps(_mm_shuffle_ps(v01, v23, _MM_SHUFFLE(2, 0, 2, 0)), half);
+		__m128 t = _mm_sub_ps(_mm_shuffle_ps(v01, v23, _MM_SHUFFLE(3, 1, 3, 1)), half);
+
+		__m128 os = _mm_add_ps(_mm_mul_ps(s, cos_ang), _mm_mul_ps(t, sin_ang));
+		__m128 ot = _mm_sub_ps(_mm_mul_ps(t, cos_ang), _mm_mul_ps(s, sin_ang));
+		os = _mm_add_ps(_mm_mul_ps(os, scale_s), offset_s);
+		ot = _mm_add_ps(_mm_mul_ps(ot, scale_t), offset_t);
+
+		__m128 lo = _mm_unpacklo_ps(os, ot);
+		__m128 hi = _mm_unpackhi_ps(os, ot);
+		_mm_storel_pi((__m64*)dstp, lo);
+		_mm_storeh_pi((__m64*)(dstp + dst_stride), lo);
+		_mm_storel_pi((__m64*)(dstp + 2 * dst_stride), hi);
+		_mm_storeh_pi((__m64*)(dstp + 3 * dst_stride), hi);
+		srcp += 4 * src_stride;
+		dstp += 4 * dst_stride;
+	}
+	transformTexCoordsScalar(xform, (const LLVector2*)srcp, src_stride, (LLVector2*)dstp, dst_stride, count - i);
+}
+
+#else
+
+// static
+BOOL LLVertexXform::hasSSE2()
+{
+	return FALSE;
+}
+
+void LLVertexXform::transformPointsSSE2(const LLMatrix4& mat, const LLVector3* src, U32 src_stride,
+										LLVector3* dst, U32 dst_stride, S32 count)
+{
+	transformPointsScalar(mat, src, src_stride, dst, dst_stride, count);
+}
+
+void LLVertexXform::transformNormalsSSE2(const LLMatrix3& mat, const LLVector3* src, U32 src_stride,
+										 LLVector3* dst, U32 dst_stride, S32 count)
+{
+	transformNormalsScalar(mat, src, src_stride, dst, dst_stride, count);
+}
+
+void LLVertexXform::transformTexCoordsSSE2(const TexCoordXform& xform, const LLVector2* src, U32 src_stride,
+										   LLVector2* dst, U32 dst_stride, S32 count)
+{
+	transformTexCoordsScalar(xform, src, src_stride, dst, dst_stride, count);
+}
+
+#endif
@@ -1661,7 +1661,7 @@ LLProfile::~LLProfile()
 }
 
 
-S32 LLVolume::sNumMeshPoints = 0;
+LLAtomicS32 LLVolume::sNumMeshPoints(0);
 
 LLVolume::LLVolume(const LLVolumeParams &params, const F32 detail, const BOOL generate_single_face, const BOOL is_unique)
 	: mParams(params)
@@ -2263,7 +2263,19 @@ void LLVolume::sculpt(U16 sculpt_width, U16 sculpt_height, S8 sculpt_components,
 	createVolumeFaces();
 }
 
-
+void LLVolume::swapGeometry(LLVolume* volumep)
+{
+	llassert_always(volumep->mParams == mParams);
+	llassert_always(volumep->mDetail == mDetail);
+
+	std::swap(mPathp, volumep->mPathp);
+	std::swap(mProfilep, volumep->mProfilep);
+	mMesh.swap(volumep->mMesh);
+	mVolumeFaces.swap(volumep->mVolumeFaces);
+	std::swap(mSculptLevel, volumep->mSculptLevel);
+	std::swap(mFaceMask, volumep->mFaceMask);
+	std::swap(mLODScaleBias, volumep->mLODScaleBias);
+}
 
 
 BOOL LLVolume::isCap(S32 face)
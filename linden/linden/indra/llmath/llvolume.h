@@ -54,6 +54,7 @@ class LLVolume;
 #include "v4coloru.h"
 #include "llmemory.h"
 #include "llfile.h"
+#include "llapr.h"
 
 //============================================================================
 
@@ -938,7 +939,7 @@ public:
 	LLFaceID generateFaceMask();
 
 	BOOL isFaceMaskValid(LLFaceID face_mask);
-	static S32 sNumMeshPoints;
+	static LLAtomicS32 sNumMeshPoints;	// volumes may be generated off the main thread
 
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume &volume);
 	friend std::ostream& operator<<(std::ostream &s, const LLVolume *volumep);		// HACK to bypass Windoze confusion over 
@@ -950,6 +951,11 @@ public:
 	
 	void sculpt(U16 sculpt_width, U16 sculpt_height, S8 sculpt_components, const U8* sculpt_data, S32 sculpt_level);
 
+	// Trades geometry with a volume generated from the same params and
+	// detail, e.g. one resculpted by LLVolumeGenThread, so that everything
+	// sharing this volume picks up the new shape.
+	void swapGeometry(LLVolume* volumep);
+
 	F32 sculptGetSurfaceArea();
 
 private:
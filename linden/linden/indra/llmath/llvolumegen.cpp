@@ -0,0 +1,293 @@
+/**
+ * @file llvolumegen.cpp
+ * @brief Background generation of volume and sculpt geometry.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llvolumegen.h"
+#include "llvolumemgr.h"
+#include "llstl.h"
+#include "llfasttimer.h"
+
+//----------------------------------------------------------------------------
+
+// MAIN THREAD
+LLVolumeGenThread::LLVolumeGenThread(bool threaded)
+	: LLQueuedThread("volumegen", threaded)
+{
+}
+
+// MAIN THREAD
+LLVolumeGenThread::handle_t LLVolumeGenThread::generateVolume(const LLVolumeParams& params, F32 detail,
+	S32 sculpt_level, U16 sculpt_width, U16 sculpt_height, S8 sculpt_components, const U8* sculpt_data,
+	U32 priority)
+{
+	handle_t handle = generateHandle();
+	VolumeRequest* req = new VolumeRequest(handle, priority, params, detail,
+										   sculpt_level, sculpt_width, sculpt_height,
+										   sculpt_components, sculpt_data);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLVolumeGenThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+BOOL LLVolumeGenThread::getResult(handle_t handle, LLPointer<LLVolume>& volume)
+{
+	volume = NULL;
+	status_t status = getRequestStatus(handle);
+	if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+	{
+		return FALSE;
+	}
+	VolumeRequest* req = (VolumeRequest*)getRequest(handle);
+	if (req)
+	{
+		if (status == STATUS_COMPLETE)
+		{
+			volume = req->takeVolume();
+		}
+		// The worker deletes the request, which no longer holds a volume.
+		completeRequest(handle);
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------------
+
+LLVolumeGenThread::VolumeRequest::VolumeRequest(handle_t handle, U32 priority,
+												const LLVolumeParams& params, F32 detail,
+												S32 sculpt_level, U16 sculpt_width, U16 sculpt_height,
+												S8 sculpt_components, const U8* sculpt_data)
+	: LLQueuedThread::QueuedRequest(handle, priority, 0),
+	  mParams(params),
+	  mDetail(detail),
+	  mSculptLevel(sculpt_level),
+	  mSculptWidth(sculpt_width),
+	  mSculptHeight(sculpt_height),
+	  mSculptComponents(sculpt_components)
+{
+	if (sculpt_data && sculpt_width && sculpt_height && sculpt_components > 0)
+	{
+		mSculptData.assign(sculpt_data, sculpt_data + (S32)sculpt_width * sculpt_height * sculpt_components);
+	}
+}
+
+LLVolumeGenThread::VolumeRequest::~VolumeRequest()
+{
+	// The worker deletes requests once getResult() has taken their volume,
+	// so only LLQueuedThread::shutdown() on the main thread gets here with
+	// one still attached.
+	mVolume = NULL;
+}
+
+static LLFastTimer::DeclareTimer FTM_VOLUME_GEN("Volume Generation");
+
+bool LLVolumeGenThread::VolumeRequest::processRequest()
+{
+	LLFastTimer t(FTM_VOLUME_GEN);
+	mVolume = new LLVolume(mParams, mDetail);
+	if (mParams.getSculptID().notNull())
+	{
+		if (mSculptData.empty())
+		{
+			mVolume->sculpt(0, 0, 0, NULL, mSculptLevel);
+		}
+		else
+		{
+			mVolume->sculpt(mSculptWidth, mSculptHeight, mSculptComponents, &mSculptData[0], mSculptLevel);
+		}
+	}
+	return true;
+}
+
+void LLVolumeGenThread::VolumeRequest::finishRequest(bool completed)
+{
+	// Collected by LLVolumeGenThread::getResult()
+}
+
+// MAIN THREAD
+LLPointer<LLVolume> LLVolumeGenThread::VolumeRequest::takeVolume()
+{
+	LLPointer<LLVolume> volume = mVolume;
+	mVolume = NULL;
+	return volume;
+}
+
+//----------------------------------------------------------------------------
+
+LLVolumeGenPool::LLVolumeGenPool(S32 num_threads, bool threaded)
+	: mNextThread(0)
+{
+	num_threads = llmax(num_threads, 1);
+	for (S32 i = 0; i < num_threads; i++)
+	{
+		mThreads.push_back(new LLVolumeGenThread(threaded));
+	}
+}
+
+LLVolumeGenPool::~LLVolumeGenPool()
+{
+	// Requests still outstanding are deleted along with their thread,
+	// here on the main thread.
+	for_each(mThreads.begin(), mThreads.end(), DeletePointer());
+	mThreads.clear();
+}
+
+LLVolumeGenPool::Request LLVolumeGenPool::queue(const LLVolumeParams& params, F32 detail, S32 sculpt_level,
+												U16 sculpt_width, U16 sculpt_height, S8 sculpt_components,
+												const U8* sculpt_data)
+{
+	Request request;
+	request.mThread = mNextThread;
+	request.mHandle = mThreads[mNextThread]->generateVolume(params, detail, sculpt_level,
+															sculpt_width, sculpt_height,
+															sculpt_components, sculpt_data);
+	request.mDetail = 0;
+	request.mSculptLevel = sculpt_level;
+	mNextThread = (mNextThread + 1) % (S32)mThreads.size();
+	return request;
+}
+
+void LLVolumeGenPool::requestLOD(const LLVolumeParams& params, S32 detail,
+								 S32 sculpt_level, U16 sculpt_width, U16 sculpt_height,
+								 S8 sculpt_components, const U8* sculpt_data)
+{
+	lod_key_t key(params, detail);
+	if (mLODRequests.find(key) != mLODRequests.end())
+	{
+		return;
+	}
+	Request request = queue(params, LLVolumeLODGroup::getVolumeScaleFromDetail(detail), sculpt_level,
+							sculpt_width, sculpt_height, sculpt_components, sculpt_data);
+	request.mDetail = detail;
+	mLODRequests[key] = request;
+}
+
+void LLVolumeGenPool::requestSculpt(LLVolume* volumep, S32 sculpt_level, U16 sculpt_width, U16 sculpt_height,
+									S8 sculpt_components, const U8* sculpt_data)
+{
+	sculpt_map_t::iterator iter = mSculptRequests.find(volumep);
+	if (iter != mSculptRequests.end())
+	{
+		if (iter->second.mSculptLevel == sculpt_level)
+		{
+			return;
+		}
+		mThreads[iter->second.mThread]->abortRequest(iter->second.mHandle, false);
+		mAbandoned.push_back(iter->second);
+		mSculptRequests.erase(iter);
+	}
+	Request request = queue(volumep->getParams(), volumep->getDetail(), sculpt_level,
+							sculpt_width, sculpt_height, sculpt_components, sculpt_data);
+	request.mTarget = volumep;
+	mSculptRequests[volumep] = request;
+}
+
+BOOL LLVolumeGenPool::isLODPending(const LLVolumeParams& params, S32 detail) const
+{
+	return mLODRequests.find(lod_key_t(params, detail)) != mLODRequests.end();
+}
+
+S32 LLVolumeGenPool::getSculptPending(const LLVolume* volumep) const
+{
+	sculpt_map_t::const_iterator iter = mSculptRequests.find(volumep);
+	return iter == mSculptRequests.end() ? -2 : iter->second.mSculptLevel;
+}
+
+S32 LLVolumeGenPool::update(LLVolumeMgr* volume_mgr, std::vector<LLPointer<LLVolume> >* sculpted)
+{
+	for (S32 i = 0; i < (S32)mThreads.size(); i++)
+	{
+		mThreads[i]->update(0); // unpauses the thread
+	}
+
+	LLPointer<LLVolume> volume;
+	for (lod_map_t::iterator iter = mLODRequests.begin(); iter != mLODRequests.end(); )
+	{
+		lod_map_t::iterator cur = iter++;
+		Request& request = cur->second;
+		if (!mThreads[request.mThread]->getResult(request.mHandle, volume))
+		{
+			continue;
+		}
+		if (volume.notNull() && volume_mgr)
+		{
+			// Refused if nothing uses these params any more, or the LOD got
+			// built the slow way in the meantime.
+			volume_mgr->addLOD(volume, request.mDetail);
+		}
+		mLODRequests.erase(cur);
+	}
+
+	for (sculpt_map_t::iterator iter = mSculptRequests.begin(); iter != mSculptRequests.end(); )
+	{
+		sculpt_map_t::iterator cur = iter++;
+		Request& request = cur->second;
+		if (!mThreads[request.mThread]->getResult(request.mHandle, volume))
+		{
+			continue;
+		}
+		if (volume.notNull())
+		{
+			request.mTarget->swapGeometry(volume);
+			if (sculpted)
+			{
+				sculpted->push_back(request.mTarget);
+			}
+		}
+		mSculptRequests.erase(cur);
+	}
+
+	for (S32 i = 0; i < (S32)mAbandoned.size(); )
+	{
+		if (mThreads[mAbandoned[i].mThread]->getResult(mAbandoned[i].mHandle, volume))
+		{
+			mAbandoned[i] = mAbandoned.back();
+			mAbandoned.pop_back();
+		}
+		else
+		{
+			i++;
+		}
+	}
+	// The last result goes away here, on the main thread.
+	volume = NULL;
+
+	return getPending();
+}
+
+S32 LLVolumeGenPool::getPending() const
+{
+	return (S32)(mLODRequests.size() + mSculptRequests.size() + mAbandoned.size());
+}
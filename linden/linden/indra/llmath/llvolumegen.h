@@ -0,0 +1,157 @@
+/**
+ * @file llvolumegen.h
+ * @brief Background generation of volume and sculpt geometry.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLVOLUMEGEN_H
+#define LL_LLVOLUMEGEN_H
+
+#include <map>
+#include <vector>
+
+#include "llqueuedthread.h"
+#include "llvolume.h"
+
+class LLVolumeMgr;
+
+// Builds LLVolumes on its own thread.
+//
+// LLVolume is not thread safe refcounted and deleting one is not thread
+// safe either (see profile_delete_lock), so a finished volume stays with
+// its request until the main thread takes it with getResult(). Every
+// request must be collected that way, even abandoned ones.
+class LLVolumeGenThread : public LLQueuedThread
+{
+public:
+	class VolumeRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~VolumeRequest(); // use deleteRequest()
+
+	public:
+		// sculpt_data, if any, is copied.
+		VolumeRequest(handle_t handle, U32 priority,
+					  const LLVolumeParams& params, F32 detail,
+					  S32 sculpt_level, U16 sculpt_width, U16 sculpt_height,
+					  S8 sculpt_components, const U8* sculpt_data);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		LLPointer<LLVolume> takeVolume();
+
+	private:
+		// input
+		LLVolumeParams mParams;
+		F32 mDetail;
+		S32 mSculptLevel;
+		U16 mSculptWidth;
+		U16 mSculptHeight;
+		S8 mSculptComponents;
+		std::vector<U8> mSculptData;
+		// output
+		LLPointer<LLVolume> mVolume;
+	};
+
+public:
+	LLVolumeGenThread(bool threaded = true);
+
+	// Generates params at detail (a volume scale, not a LOD index). Sculpted
+	// params are sculpted from the given map, or get a placeholder without one.
+	handle_t generateVolume(const LLVolumeParams& params, F32 detail,
+							S32 sculpt_level = -2, U16 sculpt_width = 0, U16 sculpt_height = 0,
+							S8 sculpt_components = 0, const U8* sculpt_data = NULL,
+							U32 priority = PRIORITY_NORMAL);
+
+	// Returns FALSE while the request is still being worked on. Otherwise
+	// ends the request and hands over its volume, which is NULL if it was
+	// aborted.
+	BOOL getResult(handle_t handle, LLPointer<LLVolume>& volume);
+};
+
+// Spreads volume generation over several LLVolumeGenThreads and installs
+// the results from the main thread.
+//
+// A LOD request builds the volume a later LLVolumeMgr::refVolume() for
+// the same params and LOD will return. A sculpt request resculpts a volume
+// that is already in use, and on completion its geometry is swapped into
+// that volume, so everything sharing it sees the change at once.
+//
+// All of this is main thread only, apart from the generation itself.
+class LLVolumeGenPool
+{
+public:
+	LLVolumeGenPool(S32 num_threads, bool threaded = true);
+	~LLVolumeGenPool();
+
+	// Queues the volume for params at LOD detail, unless it is already queued.
+	void requestLOD(const LLVolumeParams& params, S32 detail,
+					S32 sculpt_level = -2, U16 sculpt_width = 0, U16 sculpt_height = 0,
+					S8 sculpt_components = 0, const U8* sculpt_data = NULL);
+	// Queues resculpting volumep, replacing any older request for it.
+	void requestSculpt(LLVolume* volumep, S32 sculpt_level, U16 sculpt_width, U16 sculpt_height,
+					   S8 sculpt_components, const U8* sculpt_data);
+
+	BOOL isLODPending(const LLVolumeParams& params, S32 detail) const;
+	// Returns the sculpt level volumep is being resculpted to, or -2.
+	S32 getSculptPending(const LLVolume* volumep) const;
+
+	// Hands finished LODs to volume_mgr and swaps finished sculpts into
+	// their volumes, which are added to sculpted. Returns the number of
+	// requests still pending.
+	S32 update(LLVolumeMgr* volume_mgr, std::vector<LLPointer<LLVolume> >* sculpted = NULL);
+
+	S32 getNumThreads() const			{ return (S32)mThreads.size(); }
+	S32 getPending() const;
+
+private:
+	struct Request
+	{
+		S32 mThread;
+		LLQueuedThread::handle_t mHandle;
+		S32 mDetail;
+		S32 mSculptLevel;
+		LLPointer<LLVolume> mTarget;	// volume to resculpt
+	};
+	typedef std::pair<LLVolumeParams, S32> lod_key_t;
+	typedef std::map<lod_key_t, Request> lod_map_t;
+	typedef std::map<const LLVolume*, Request> sculpt_map_t;
+
+	Request queue(const LLVolumeParams& params, F32 detail, S32 sculpt_level,
+				  U16 sculpt_width, U16 sculpt_height, S8 sculpt_components, const U8* sculpt_data);
+
+	std::vector<LLVolumeGenThread*> mThreads;
+	S32 mNextThread;
+	lod_map_t mLODRequests;
+	sculpt_map_t mSculptRequests;
+	std::vector<Request> mAbandoned;	// still have to be collected
+};
+
+#endif // LL_LLVOLUMEGEN_H
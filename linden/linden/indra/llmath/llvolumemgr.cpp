@@ -112,11 +112,52 @@ LLVolume* LLVolumeMgr::refVolume(const LLVolumeParams &volume_params, const S32
 	{
 		volgroupp = iter->second;
 	}
+	// Keep the lock while the group is in use, another thread may delete it
+	// in unrefVolume() the moment it is released.
+	LLVolume* volumep = volgroupp->refLOD(detail);
 	if (mDataMutex)
 	{
 		mDataMutex->unlock();
 	}
-	return volgroupp->refLOD(detail);
+	return volumep;
+}
+
+BOOL LLVolumeMgr::hasVolume(const LLVolumeParams &volume_params, const S32 detail) const
+{
+	BOOL res = FALSE;
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	volume_lod_group_map_t::const_iterator iter = mVolumeLODGroups.find(&volume_params);
+	if (iter != mVolumeLODGroups.end())
+	{
+		res = iter->second->hasLOD(detail);
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+	return res;
+}
+
+BOOL LLVolumeMgr::addLOD(LLVolume *volumep, const S32 detail)
+{
+	BOOL res = FALSE;
+	if (mDataMutex)
+	{
+		mDataMutex->lock();
+	}
+	volume_lod_group_map_t::iterator iter = mVolumeLODGroups.find(&volumep->getParams());
+	if (iter != mVolumeLODGroups.end())
+	{
+		res = iter->second->addLOD(volumep, detail);
+	}
+	if (mDataMutex)
+	{
+		mDataMutex->unlock();
+	}
+	return res;
 }
 
 // virtual
@@ -310,6 +351,19 @@ LLVolume* LLVolumeLODGroup::refLOD(const S32 detail)
 	return mVolumeLODs[detail];
 }
 
+BOOL LLVolumeLODGroup::addLOD(LLVolume *volumep, const S32 detail)
+{
+	llassert(detail >=0 && detail < NUM_LODS);
+	if (mVolumeLODs[detail].notNull()
+		|| volumep->getDetail() != mDetailScales[detail])
+	{
+		return FALSE;
+	}
+	// Stays unreferenced, and is only dropped with the group, until refLOD()
+	mVolumeLODs[detail] = volumep;
+	return TRUE;
+}
+
 BOOL LLVolumeLODGroup::derefLOD(LLVolume *volumep)
 {
 	llassert_always(mRefs > 0);
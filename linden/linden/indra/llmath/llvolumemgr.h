@@ -62,6 +62,9 @@ public:
 
 	LLVolume* refLOD(const S32 detail);
 	BOOL derefLOD(LLVolume *volumep);
+	BOOL hasLOD(const S32 detail) const { return mVolumeLODs[detail].notNull(); }
+	// Takes a volume generated elsewhere for an empty LOD, see LLVolumeMgr::addLOD()
+	BOOL addLOD(LLVolume* volumep, const S32 detail);
 	S32 getNumRefs() const { return mRefs; }
 	
 	const LLVolumeParams* getVolumeParams() const { return &mVolumeParams; };
@@ -95,6 +98,17 @@ public:
 	LLVolume *refVolume(const LLVolumeParams &volume_params, const S32 detail);
 	void unrefVolume(LLVolume *volumep);
 
+	// TRUE if refVolume() would not have to generate anything
+	BOOL hasVolume(const LLVolumeParams &volume_params, const S32 detail) const;
+	// Hands over a volume generated in the background, which the next
+	// refVolume() for its params and detail returns. Refused, and left to
+	// the caller, if nothing references those params any more or the LOD
+	// exists already.
+	// Volumes are not refcounted thread safely, so like everything else
+	// here that must be done from the main thread. The mutex only protects
+	// the groups themselves.
+	BOOL addLOD(LLVolume *volumep, const S32 detail);
+
 	void dump();
 
 	// manually call this for mutex magic
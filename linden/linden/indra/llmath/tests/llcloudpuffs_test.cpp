@@ -0,0 +1,741 @@
+/**
+ * @file llcloudpuffs_test.cpp
+ * @brief LLCloudPuffs tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+
+#include "linden_common.h"
+
+#include "../llcloudpuffs.h"
+#include "../test/lltut.h"
+
+#include "indra_constants.h"
+#include "llmath.h"
+#include "llrand.h"
+#include "llstl.h"
+#include "lltimer.h"
+#include "v3math.h"
+
+#include <algorithm>
+#include <map>
+
+namespace
+{
+	const F32 REGION_WIDTH = 256.f;
+	const S32 WIND_SIZE = 16;
+	const S32 GROUPS_PER_EDGE = 4;		// CLOUD_GROUPS_PER_EDGE
+	const F32 GROUP_WIDTH = REGION_WIDTH / GROUPS_PER_EDGE;
+	const F32 CLOUD_HEIGHT = 192.f;		// ClassicCloudHeight
+	const F32 CLOUD_RANGE = 48.f;		// ClassicCloudRange
+
+	// The settings, looked up by name as gSavedSettings does.
+	std::map<std::string, F32> sSettings;
+
+	F32 get_setting(const std::string& name)
+	{
+		return sSettings[name];
+	}
+
+	void init_settings(F32 velocity_scale)
+	{
+		sSettings["CloudVelocityScale"] = velocity_scale;
+		sSettings["CloudUpdateRate"] = 1.f;
+		sSettings["CloudGrowRate"] = 5.f;
+		sSettings["CloudDecayRate"] = -5.f;
+		sSettings["CloudDensity"] = 25.f;
+		sSettings["CloudCountMax"] = 20.f;
+		sSettings["ClassicCloudRange"] = CLOUD_RANGE;
+	}
+
+	LLCloudPuffs::Params get_params()
+	{
+		LLCloudPuffs::Params params;
+		params.mRegionWidth = REGION_WIDTH;
+		params.mVelocityScale = WIND_SCALE_HACK * (get_setting("CloudVelocityScale")/100)*get_setting("CloudUpdateRate");
+		params.mGrowRate = (get_setting("CloudGrowRate")/100)*get_setting("CloudUpdateRate");
+		params.mDecayRate = (get_setting("CloudDecayRate")/100)*get_setting("CloudUpdateRate");
+		return params;
+	}
+
+	struct Region
+	{
+		LLVector3d mOrigin;
+		F32 mVelX[WIND_SIZE * WIND_SIZE];
+		F32 mVelY[WIND_SIZE * WIND_SIZE];
+
+		Region(const LLVector3d& origin, F32 speed) : mOrigin(origin)
+		{
+			for (S32 i = 0; i < WIND_SIZE * WIND_SIZE; i++)
+			{
+				mVelX[i] = ll_frand(2.f * speed) - speed;
+				mVelY[i] = ll_frand(2.f * speed) - speed;
+			}
+		}
+
+		LLCloudPuffs::Wind getWind() const
+		{
+			LLCloudPuffs::Wind wind;
+			wind.mVelX = mVelX;
+			wind.mVelY = mVelY;
+			wind.mSize = WIND_SIZE;
+			wind.mOriginGlobal = mOrigin;
+			return wind;
+		}
+
+		LLVector3d getGroupCenter(S32 i, S32 j) const
+		{
+			return mOrigin + LLVector3d((0.5f + j)*GROUP_WIDTH, (0.5f + i)*GROUP_WIDTH, CLOUD_HEIGHT);
+		}
+
+		// LLWind::getCloudVelocity() as it was
+		LLVector3 getCloudVelocity(const LLVector3 &pos_region) const
+		{
+			LLVector3 r_val;
+			F32 dx,dy;
+			S32 k;
+			S32 mSize = WIND_SIZE;
+
+			LLVector3 pos_clamped_region(pos_region);
+
+			F32 region_width_meters = REGION_WIDTH;
+
+			if (pos_clamped_region.mV[VX] < 0.f)
+			{
+				pos_clamped_region.mV[VX] = 0.f;
+			}
+			else if (pos_clamped_region.mV[VX] >= region_width_meters)
+			{
+				pos_clamped_region.mV[VX] = (F32) fmod(pos_clamped_region.mV[VX], region_width_meters);
+			}
+
+			if (pos_clamped_region.mV[VY] < 0.f)
+			{
+				pos_clamped_region.mV[VY] = 0.f;
+			}
+			else if (pos_clamped_region.mV[VY] >= region_width_meters)
+			{
+				pos_clamped_region.mV[VY] = (F32) fmod(pos_clamped_region.mV[VY], region_width_meters);
+			}
+
+			S32 i = llfloor(pos_clamped_region.mV[VX] * mSize / region_width_meters);
+			S32 j = llfloor(pos_clamped_region.mV[VY] * mSize / region_width_meters);
+			k = i + j*mSize;
+			dx = ((pos_clamped_region.mV[VX] * mSize / region_width_meters) - (F32) i);
+			dy = ((pos_clamped_region.mV[VY] * mSize / region_width_meters) - (F32) j);
+
+			if ((i < mSize-1) && (j < mSize-1))
+			{
+				//  Interior points, no edges
+				r_val.mV[VX] =  mVelX[k]*(1.0f - dx)*(1.0f - dy) + 
+								mVelX[k + 1]*dx*(1.0f - dy) + 
+								mVelX[k + mSize]*dy*(1.0f - dx) + 
+								mVelX[k + mSize + 1]*dx*dy;
+				r_val.mV[VY] =  mVelY[k]*(1.0f - dx)*(1.0f - dy) + 
+								mVelY[k + 1]*dx*(1.0f - dy) + 
+								mVelY[k + mSize]*dy*(1.0f - dx) + 
+								mVelY[k + mSize + 1]*dx*dy;
+			}
+			else 
+			{
+				r_val.mV[VX] = mVelX[k];
+				r_val.mV[VY] = mVelY[k];
+			}
+
+			r_val.mV[VZ] = 0.f;
+			return r_val * WIND_SCALE_HACK;
+		}
+	};
+
+	// The puffs of one LLCloudGroup, as LLCloudGroup kept them.
+	enum
+	{
+		LL_PUFF_GROWING = 0,
+		LL_PUFF_DYING = 1
+	};
+
+	struct OldPuff
+	{
+		OldPuff() :
+			mAlpha(0.01f),
+			mRate((get_setting("CloudGrowRate")/100)*get_setting("CloudUpdateRate")),
+			mLifeState(LL_PUFF_GROWING)
+		{
+		}
+
+		F32 mAlpha;
+		F32 mRate;
+		LLVector3d mPositionGlobal;
+		BOOL mLifeState;
+	};
+
+	struct OldWorld;
+
+	struct OldGroup
+	{
+		OldWorld* mWorld;
+		const Region* mRegion;
+		LLVector3 mCenterRegion;
+		std::vector<OldPuff> mCloudPuffs;
+
+		BOOL inGroup(const OldPuff &puff) const
+		{
+			F32 delta = 128.f/GROUPS_PER_EDGE;
+			LLVector3 pos_region;
+			pos_region.setVec(puff.mPositionGlobal - mRegion->mOrigin);
+			return !((pos_region.mV[VX] < mCenterRegion.mV[VX] - delta)
+					 || (pos_region.mV[VY] < mCenterRegion.mV[VY] - delta)
+					 || (pos_region.mV[VX] > mCenterRegion.mV[VX] + delta)
+					 || (pos_region.mV[VY] > mCenterRegion.mV[VY] + delta));
+		}
+
+		void updatePuffs(const F32 dt);
+		void updatePuffOwnership();
+		void updatePuffCount(F32 density);
+	};
+
+	// LLWorld::updateClouds() and findCloudGroup() as they were
+	struct OldWorld
+	{
+		std::vector<OldGroup> mGroups;
+
+		OldGroup* findCloudGroup(const OldPuff& puff)
+		{
+			for (U32 i = 0; i < mGroups.size(); i++)
+			{
+				if (mGroups[i].inGroup(puff))
+				{
+					return &mGroups[i];
+				}
+			}
+			return NULL;
+		}
+
+		void update(F32 dt, F32 density)
+		{
+			for (U32 i = 0; i < mGroups.size(); i++)
+			{
+				mGroups[i].updatePuffs(dt);
+			}
+			for (U32 i = 0; i < mGroups.size(); i++)
+			{
+				mGroups[i].updatePuffOwnership();
+			}
+			for (U32 i = 0; i < mGroups.size(); i++)
+			{
+				mGroups[i].updatePuffCount(density);
+			}
+		}
+
+		S32 getNumPuffs() const
+		{
+			S32 count = 0;
+			for (U32 i = 0; i < mGroups.size(); i++)
+			{
+				count += (S32)mGroups[i].mCloudPuffs.size();
+			}
+			return count;
+		}
+	};
+
+	void OldGroup::updatePuffs(const F32 dt)
+	{
+		LLVector3 velocity;
+		LLVector3d vel_d;
+		for (U32 i = 0; i < mCloudPuffs.size(); i++)
+		{
+			OldPuff &puff = mCloudPuffs[i];
+			LLVector3 pos_region;
+			pos_region.setVec(puff.mPositionGlobal - mRegion->mOrigin);
+			velocity = mRegion->getCloudVelocity(pos_region);
+			velocity *= (get_setting("CloudVelocityScale")/100)*get_setting("CloudUpdateRate");
+			vel_d.setVec(velocity);
+			mCloudPuffs[i].mPositionGlobal += vel_d;
+			mCloudPuffs[i].mAlpha += mCloudPuffs[i].mRate * dt;
+			mCloudPuffs[i].mAlpha = llmin(1.f, mCloudPuffs[i].mAlpha);
+			mCloudPuffs[i].mAlpha = llmax(0.f, mCloudPuffs[i].mAlpha);
+		}
+	}
+
+	void OldGroup::updatePuffOwnership()
+	{
+		U32 i = 0;
+		while (i < mCloudPuffs.size())
+		{
+			if (mCloudPuffs[i].mLifeState == LL_PUFF_DYING || inGroup(mCloudPuffs[i]))
+			{
+				i++;
+				continue;
+			}
+
+			OldGroup *new_cgp = mWorld->findCloudGroup(mCloudPuffs[i]);
+			if (!new_cgp)
+			{
+				mCloudPuffs[i].mLifeState = LL_PUFF_DYING;
+				mCloudPuffs[i].mRate = (get_setting("CloudDecayRate")/100)*get_setting("CloudUpdateRate");
+				i++;
+				continue;
+			}
+			OldPuff puff;
+			puff.mPositionGlobal = mCloudPuffs[i].mPositionGlobal;
+			puff.mAlpha = mCloudPuffs[i].mAlpha;
+			mCloudPuffs.erase(mCloudPuffs.begin() + i);
+			new_cgp->mCloudPuffs.push_back(puff);
+		}
+	}
+
+	void OldGroup::updatePuffCount(F32 density)
+	{
+		S32 i;
+		S32 target_puff_count = llround((S32)get_setting("CloudDensity") * density);
+		target_puff_count = llmax(0, target_puff_count);
+		target_puff_count = llmin((S32)get_setting("CloudCountMax"), target_puff_count);
+		S32 current_puff_count = (S32) mCloudPuffs.size();
+		if (current_puff_count < target_puff_count)
+		{
+			LLVector3d puff_pos_global;
+			mCloudPuffs.resize(target_puff_count);
+			for (i = current_puff_count; i < target_puff_count; i++)
+			{
+				puff_pos_global = mRegion->mOrigin + LLVector3d(mCenterRegion);
+				F32 x = ll_frand(256.f/GROUPS_PER_EDGE) - 128.f/GROUPS_PER_EDGE;
+				F32 y = ll_frand(256.f/GROUPS_PER_EDGE) - 128.f/GROUPS_PER_EDGE;
+				F32 z = ll_frand(get_setting("ClassicCloudRange")) - 0.5f*get_setting("ClassicCloudRange");
+				puff_pos_global += LLVector3d(x, y, z);
+				mCloudPuffs[i].mPositionGlobal = puff_pos_global;
+				mCloudPuffs[i].mAlpha = 0.01f;
+			}
+		}
+
+		S32 live_puff_count = 0;
+		for (i = 0; i < (S32) mCloudPuffs.size(); i++)
+		{
+			if (mCloudPuffs[i].mLifeState != LL_PUFF_DYING)
+			{
+				live_puff_count++;
+			}
+		}
+
+		S32 new_dying_count = llmax(0, live_puff_count - target_puff_count);
+		i = 0;
+		while (new_dying_count > 0)
+		{
+			if (mCloudPuffs[i].mLifeState != LL_PUFF_DYING)
+			{
+				mCloudPuffs[i].mLifeState = LL_PUFF_DYING;
+				mCloudPuffs[i].mRate = (get_setting("CloudDecayRate")/100)*get_setting("CloudUpdateRate");
+				new_dying_count--;
+			}
+			i++;
+		}
+
+		i = 0;
+		while (i < (S32) mCloudPuffs.size())
+		{
+			if (mCloudPuffs[i].mAlpha <= 0.f)
+			{
+				mCloudPuffs.erase(mCloudPuffs.begin() + i);
+			}
+			else
+			{
+				i++;
+			}
+		}
+	}
+
+	// The same clouds in an LLCloudPuffs, as LLCloudGroup and LLWorld now
+	// keep them.
+	struct NewWorld
+	{
+		LLCloudPuffs mPuffs;
+		std::vector<S32> mCells;
+		std::vector<LLVector3d> mCenters;
+
+		NewWorld() : mPuffs(GROUP_WIDTH) {}
+
+		void addRegion(const Region& region)
+		{
+			for (S32 i = 0; i < GROUPS_PER_EDGE; i++)
+			{
+				for (S32 j = 0; j < GROUPS_PER_EDGE; j++)
+				{
+					mCenters.push_back(region.getGroupCenter(i, j));
+					mCells.push_back(mPuffs.addCell(mCenters.back(), region.getWind()));
+				}
+			}
+		}
+
+		void update(F32 dt, F32 density)
+		{
+			mPuffs.setParams(get_params());
+			mPuffs.update(dt);
+			mPuffs.updateOwnership();
+
+			F32 range = get_setting("ClassicCloudRange");
+			S32 target_puff_count = llround((S32)get_setting("CloudDensity") * density);
+			target_puff_count = llmax(0, target_puff_count);
+			target_puff_count = llmin((S32)get_setting("CloudCountMax"), target_puff_count);
+			for (U32 c = 0; c < mCells.size(); c++)
+			{
+				S32 cell = mCells[c];
+				S32 current_puff_count = mPuffs.getCellCount(cell);
+				S32 live_puff_count = mPuffs.getCellLiveCount(cell);
+				for (S32 i = current_puff_count; i < target_puff_count; i++)
+				{
+					F32 x = ll_frand(256.f/GROUPS_PER_EDGE) - 128.f/GROUPS_PER_EDGE;
+					F32 y = ll_frand(256.f/GROUPS_PER_EDGE) - 128.f/GROUPS_PER_EDGE;
+					F32 z = ll_frand(range) - 0.5f*range;
+					mPuffs.addPuff(cell, mCenters[c] + LLVector3d(x, y, z), 0.01f);
+					live_puff_count++;
+				}
+				mPuffs.killPuffs(cell, llmax(0, live_puff_count - target_puff_count));
+			}
+
+			mPuffs.sortPuffs();
+		}
+	};
+
+	U32 bits(F32 val)
+	{
+		U32 b;
+		memcpy(&b, &val, sizeof(b));
+		return b;
+	}
+
+	U64 bits(F64 val)
+	{
+		U64 b;
+		memcpy(&b, &val, sizeof(b));
+		return b;
+	}
+
+	// Puffs over a region and a bit past it, some growing and some dying.
+	void add_test_puffs(LLCloudPuffs& puffs, const std::vector<S32>& cells, const Region& region, S32 per_cell)
+	{
+		for (U32 c = 0; c < cells.size(); c++)
+		{
+			for (S32 n = 0; n < per_cell; n++)
+			{
+				LLVector3d pos = region.mOrigin + LLVector3d(ll_frand(REGION_WIDTH + 40.f) - 20.f,
+															 ll_frand(REGION_WIDTH + 40.f) - 20.f,
+															 CLOUD_HEIGHT + ll_frand(CLOUD_RANGE));
+				puffs.addPuff(cells[c], pos, ll_frand());
+			}
+			puffs.killPuffs(cells[c], per_cell / 3);
+		}
+		// The edges and corners of the wind grid
+		puffs.addPuff(cells[0], region.mOrigin, 0.5f);
+		puffs.addPuff(cells[0], region.mOrigin + LLVector3d(REGION_WIDTH - 0.001f, REGION_WIDTH - 0.001f, 0.f), 0.5f);
+		puffs.addPuff(cells[0], region.mOrigin + LLVector3d(REGION_WIDTH, 240.f, 0.f), 0.5f);
+		puffs.addPuff(cells[0], region.mOrigin + LLVector3d(240.f, 0.f, 0.f), 0.5f);
+		puffs.sortPuffs();
+	}
+
+	std::vector<S32> add_region_cells(LLCloudPuffs& puffs, const Region& region)
+	{
+		std::vector<S32> cells;
+		for (S32 i = 0; i < GROUPS_PER_EDGE; i++)
+		{
+			for (S32 j = 0; j < GROUPS_PER_EDGE; j++)
+			{
+				cells.push_back(puffs.addCell(region.getGroupCenter(i, j), region.getWind()));
+			}
+		}
+		return cells;
+	}
+}
+
+namespace tut
+{
+	struct cloudpuffs_test
+	{
+		cloudpuffs_test()
+		{
+			init_settings(1.f);
+		}
+
+		~cloudpuffs_test()
+		{
+			LLCloudPuffs::useSSE2(FALSE);
+		}
+	};
+
+	typedef test_group<cloudpuffs_test> cloudpuffs_test_t;
+	typedef cloudpuffs_test_t::object cloudpuffs_test_object_t;
+	tut::cloudpuffs_test_t tut_cloudpuffs_test("cloudpuffs_test");
+
+	template<> template<>
+	void cloudpuffs_test_object_t::test<1>()
+	{
+		// puffs move and grow or fade exactly as LLCloudGroup::updatePuffs()
+		// moved them, for any velocity scale, and however long a frame
+		const F32 VELOCITY_SCALES[] = { 1.f, 3.7f, 250.f };
+		const F32 DTS[] = { 0.02f, 0.5f, 30.f };
+		for (S32 s = 0; s < 3; s++)
+		{
+			init_settings(VELOCITY_SCALES[s]);
+			Region region(LLVector3d(256000.0, 255744.0, 0.0), 8.f);
+			LLCloudPuffs puffs(GROUP_WIDTH);
+			puffs.setParams(get_params());
+			std::vector<S32> cells = add_region_cells(puffs, region);
+			add_test_puffs(puffs, cells, region, 25);
+
+			S32 count = puffs.getNumPuffs();
+			ensure("dying puffs", puffs.getLifeState(0) == LLCloudPuffs::DYING);
+			ensure("growing puffs", puffs.getLifeState(count - 1) == LLCloudPuffs::GROWING);
+			for (S32 d = 0; d < 3; d++)
+			{
+				std::vector<OldPuff> old_puffs(count);
+				for (S32 i = 0; i < count; i++)
+				{
+					old_puffs[i].mPositionGlobal = puffs.getPositionGlobal(i);
+					old_puffs[i].mAlpha = puffs.getAlpha(i);
+					old_puffs[i].mLifeState = puffs.getLifeState(i);
+					if (old_puffs[i].mLifeState == LL_PUFF_DYING)
+					{
+						old_puffs[i].mRate = (get_setting("CloudDecayRate")/100)*get_setting("CloudUpdateRate");
+					}
+				}
+				OldGroup group;
+				group.mRegion = &region;
+				group.mCloudPuffs = old_puffs;
+				group.updatePuffs(DTS[d]);
+
+				puffs.update(DTS[d]);
+				for (S32 i = 0; i < count; i++)
+				{
+					LLVector3d pos = puffs.getPositionGlobal(i);
+					const LLVector3d& old_pos = group.mCloudPuffs[i].mPositionGlobal;
+					ensure_equals("x", bits(pos.mdV[VX]), bits(old_pos.mdV[VX]));
+					ensure_equals("y", bits(pos.mdV[VY]), bits(old_pos.mdV[VY]));
+					ensure_equals("z", bits(pos.mdV[VZ]), bits(old_pos.mdV[VZ]));
+					ensure_equals("alpha", bits(puffs.getAlpha(i)), bits(group.mCloudPuffs[i].mAlpha));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void cloudpuffs_test_object_t::test<2>()
+	{
+		// SSE2 moves and fades them the same, whatever the cells' sizes
+		if (!LLCloudPuffs::hasSSE2())
+		{
+			return;
+		}
+		Region region(LLVector3d(512.0, 1024.0, 0.0), 12.f);
+		for (S32 per_cell = 1; per_cell < 12; per_cell++)
+		{
+			LLCloudPuffs scalar_puffs(GROUP_WIDTH);
+			scalar_puffs.setParams(get_params());
+			add_test_puffs(scalar_puffs, add_region_cells(scalar_puffs, region), region, per_cell);
+			LLCloudPuffs puffs[2] = { scalar_puffs, scalar_puffs };
+
+			for (S32 frame = 0; frame < 20; frame++)
+			{
+				for (S32 pass = 0; pass < 2; pass++)
+				{
+					LLCloudPuffs::useSSE2(pass == 1);
+					puffs[pass].update(frame == 10 ? 20.f : 0.3f);
+				}
+				for (S32 i = 0; i < puffs[0].getNumPuffs(); i++)
+				{
+					LLVector3d pos = puffs[0].getPositionGlobal(i);
+					LLVector3d pos_sse2 = puffs[1].getPositionGlobal(i);
+					ensure_equals("x", bits(pos_sse2.mdV[VX]), bits(pos.mdV[VX]));
+					ensure_equals("y", bits(pos_sse2.mdV[VY]), bits(pos.mdV[VY]));
+					ensure_equals("alpha", bits(puffs[1].getAlpha(i)), bits(puffs[0].getAlpha(i)));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void cloudpuffs_test_object_t::test<3>()
+	{
+		// puffs go to the cell they drift into, or die if there is none,
+		// and the dead go
+		Region west(LLVector3d(256000.0, 256000.0, 0.0), 0.f);
+		Region east(LLVector3d(256256.0, 256000.0, 0.0), 0.f);
+		LLCloudPuffs puffs(GROUP_WIDTH);
+		puffs.setParams(get_params());
+		std::vector<S32> west_cells = add_region_cells(puffs, west);
+		std::vector<S32> east_cells = add_region_cells(puffs, east);
+
+		ensure_equals("find west", puffs.findCell(west.mOrigin + LLVector3d(10.0, 70.0, 0.0)), west_cells[4]);
+		ensure_equals("find east", puffs.findCell(east.mOrigin + LLVector3d(255.0, 255.0, 0.0)), east_cells[15]);
+		ensure_equals("find none", puffs.findCell(east.mOrigin + LLVector3d(256.0, 10.0, 0.0)), -1);
+		ensure_equals("find none south", puffs.findCell(west.mOrigin + LLVector3d(10.0, -0.5, 0.0)), -1);
+
+		// Put puffs in the wrong cells, as if they had drifted
+		const S32 cell_of[] = { 3, 3, 3, 0, 0 };
+		const F64 x_of[] = { 250.0, 300.0, 520.0, -3.0, 10.0 };
+		for (S32 n = 0; n < 5; n++)
+		{
+			puffs.addPuff(west_cells[cell_of[n]], west.mOrigin + LLVector3d(x_of[n], 10.0, CLOUD_HEIGHT), 0.5f);
+		}
+		puffs.sortPuffs();
+		puffs.updateOwnership();
+
+		ensure_equals("stays", puffs.getCellLiveCount(west_cells[3]), 1);
+		ensure_equals("handed east", puffs.getCellLiveCount(east_cells[0]), 1);
+		ensure_equals("off the world", puffs.getCellCount(west_cells[3]) - puffs.getCellLiveCount(west_cells[3]), 1);
+		ensure_equals("off the world west", puffs.getCellCount(west_cells[0]), 2);
+		ensure_equals("west stays", puffs.getCellLiveCount(west_cells[0]), 1);
+
+		puffs.addPuff(west_cells[5], west.mOrigin + LLVector3d(80.0, 80.0, CLOUD_HEIGHT), 0.5f);
+		puffs.addPuff(west_cells[5], west.mOrigin + LLVector3d(90.0, 80.0, CLOUD_HEIGHT), 0.5f);
+		puffs.killPuffs(west_cells[5], 1);
+		puffs.sortPuffs();
+
+		ensure_equals("sorted", puffs.getNumPuffs(), 7);
+		for (U32 c = 0; c < west_cells.size(); c++)
+		{
+			for (S32 i = puffs.getCellBegin(west_cells[c]); i < puffs.getCellEnd(west_cells[c]); i++)
+			{
+				ensure_equals("cell", puffs.getCell(i), west_cells[c]);
+			}
+		}
+		S32 first = puffs.getCellBegin(west_cells[5]);
+		ensure_equals("two", puffs.getCellEnd(west_cells[5]) - first, 2);
+		ensure("first killed", puffs.getLifeState(first) == LLCloudPuffs::DYING);
+		ensure("second lives", puffs.getLifeState(first + 1) == LLCloudPuffs::GROWING);
+
+		// Fade the dying ones out
+		puffs.update(10.f);
+		puffs.updateOwnership();
+		puffs.sortPuffs();
+		ensure_equals("dead dropped", puffs.getNumPuffs(), 4);
+		for (S32 i = 0; i < puffs.getNumPuffs(); i++)
+		{
+			ensure("only growing", puffs.getLifeState(i) == LLCloudPuffs::GROWING);
+			ensure_equals("grown", puffs.getAlpha(i), 1.f);
+		}
+
+		puffs.removeCell(east_cells[0]);
+		ensure_equals("removed with its cell", puffs.getNumPuffs(), 3);
+		ensure_equals("gone from the grid", puffs.findCell(east.mOrigin + LLVector3d(10.0, 10.0, 0.0)), -1);
+		S32 cell = puffs.addCell(east.getGroupCenter(0, 0), east.getWind());
+		ensure_equals("number reused", cell, east_cells[0]);
+		ensure_equals("back on the grid", puffs.findCell(east.mOrigin + LLVector3d(10.0, 10.0, 0.0)), cell);
+		ensure_equals("empty", puffs.getCellEnd(cell) - puffs.getCellBegin(cell), 0);
+	}
+
+	template<> template<>
+	void cloudpuffs_test_object_t::test<4>()
+	{
+		// clouds over a 5x5 grid of regions, the way LLCloudGroup kept them
+		// and in an LLCloudPuffs, and how long a frame takes
+		const S32 REGIONS_PER_EDGE = 5;
+		const S32 NUM_FRAMES = 300;
+		const F32 DT = 1.f / 30.f;
+		const F32 DENSITY = 0.8f;
+		init_settings(20.f);
+
+		std::vector<Region*> regions;
+		for (S32 y = 0; y < REGIONS_PER_EDGE; y++)
+		{
+			for (S32 x = 0; x < REGIONS_PER_EDGE; x++)
+			{
+				regions.push_back(new Region(LLVector3d(256000.0 + x * REGION_WIDTH, 256000.0 + y * REGION_WIDTH, 0.0), 10.f));
+			}
+		}
+
+		OldWorld old_world;
+		for (U32 r = 0; r < regions.size(); r++)
+		{
+			for (S32 i = 0; i < GROUPS_PER_EDGE; i++)
+			{
+				for (S32 j = 0; j < GROUPS_PER_EDGE; j++)
+				{
+					OldGroup group;
+					group.mWorld = &old_world;
+					group.mRegion = regions[r];
+					group.mCenterRegion.setVec((0.5f + j)*GROUP_WIDTH, (0.5f + i)*GROUP_WIDTH, CLOUD_HEIGHT);
+					old_world.mGroups.push_back(group);
+				}
+			}
+		}
+
+		NewWorld new_worlds[2];
+		for (S32 pass = 0; pass < 2; pass++)
+		{
+			for (U32 r = 0; r < regions.size(); r++)
+			{
+				new_worlds[pass].addRegion(*regions[r]);
+			}
+		}
+
+		LLTimer timer;
+		for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+		{
+			old_world.update(DT, DENSITY);
+		}
+		F32 old_time = timer.getElapsedTimeF32();
+
+		F32 new_times[2];
+		for (S32 pass = 0; pass < 2; pass++)
+		{
+			LLCloudPuffs::useSSE2(pass == 1);
+			timer.reset();
+			for (S32 frame = 0; frame < NUM_FRAMES; frame++)
+			{
+				new_worlds[pass].update(DT, DENSITY);
+			}
+			new_times[pass] = timer.getElapsedTimeF32();
+
+			LLCloudPuffs& puffs = new_worlds[pass].mPuffs;
+			for (U32 c = 0; c < new_worlds[pass].mCells.size(); c++)
+			{
+				S32 cell = new_worlds[pass].mCells[c];
+				S32 live = 0;
+				for (S32 i = puffs.getCellBegin(cell); i < puffs.getCellEnd(cell); i++)
+				{
+					if (puffs.getLifeState(i) != LLCloudPuffs::DYING)
+					{
+						live++;
+					}
+				}
+				ensure("live puffs", live <= 20);
+			}
+		}
+		F32 ratio = (F32)new_worlds[0].mPuffs.getNumPuffs() / old_world.getNumPuffs();
+		ensure("as many puffs", ratio > 0.8f && ratio < 1.25f);
+
+		llinfos << "Clouds over " << REGIONS_PER_EDGE << "x" << REGIONS_PER_EDGE << " regions, "
+				<< old_world.getNumPuffs() << " and " << new_worlds[0].mPuffs.getNumPuffs() << " puffs: per group "
+				<< old_time * 1000.f / NUM_FRAMES << "ms, pooled scalar " << new_times[0] * 1000.f / NUM_FRAMES
+				<< "ms, SSE2 " << new_times[1] * 1000.f / NUM_FRAMES << "ms a frame" << llendl;
+
+		for_each(regions.begin(), regions.end(), DeletePointer());
+	}
+}
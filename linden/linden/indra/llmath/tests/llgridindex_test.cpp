@@ -0,0 +1,277 @@
+/**
+ * @file llgridindex_test.cpp
+ * @brief LLGridIndex tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../llgridindex.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "lltimer.h"
+
+#include <algorithm>
+
+namespace
+{
+	const F64 REGION_WIDTH = 256.0;
+	const F64 CELL_WIDTH = 8.0 * REGION_WIDTH;	// one map block
+
+	struct Rect
+	{
+		F64 mMinX, mMinY, mMaxX, mMaxY;
+	};
+
+	Rect random_rect(F64 world_width, F64 max_width)
+	{
+		Rect rect;
+		rect.mMinX = ll_frand() * world_width;
+		rect.mMinY = ll_frand() * world_width;
+		rect.mMaxX = rect.mMinX + ll_frand() * max_width;
+		rect.mMaxY = rect.mMinY + ll_frand() * max_width;
+		return rect;
+	}
+
+	// What the index should find, by looking at every rectangle.
+	void scan(const std::vector<Rect>& rects, const Rect& query, std::vector<S32>& results)
+	{
+		for (U32 i = 0; i < rects.size(); ++i)
+		{
+			const Rect& rect = rects[i];
+			if (rect.mMaxX < query.mMinX || rect.mMinX > query.mMaxX ||
+				rect.mMaxY < query.mMinY || rect.mMinY > query.mMaxY)
+			{
+				continue;
+			}
+			results.push_back(i);
+		}
+	}
+
+	std::vector<S32> query_sorted(const LLGridIndex<S32>& index, const Rect& query)
+	{
+		std::vector<S32> results;
+		index.query(query.mMinX, query.mMinY, query.mMaxX, query.mMaxY, results);
+		std::sort(results.begin(), results.end());
+		return results;
+	}
+}
+
+namespace tut
+{
+	struct gridindex_test
+	{
+	};
+
+	typedef test_group<gridindex_test> gridindex_test_t;
+	typedef gridindex_test_t::object gridindex_test_object_t;
+	tut::gridindex_test_t tut_gridindex_test("gridindex_test");
+
+	template<> template<>
+	void gridindex_test_object_t::test<1>()
+	{
+		// edges count, values spanning cells are found once, and removed
+		// values are gone
+		LLGridIndex<S32> index(10.0);
+		index.insert(1, 5.0, 5.0);
+		index.insert(2, 10.0, 10.0);
+		index.insert(3, -15.0, -15.0, 25.0, 25.0);
+		index.insert(4, -0.5, 3.0);
+		ensure_equals("size", index.size(), 4);
+
+		std::vector<S32> results;
+		index.query(0.0, 0.0, 9.0, 9.0, results);
+		std::sort(results.begin(), results.end());
+		ensure_equals("found", results.size(), 2U);
+		ensure_equals("point", results[0], 1);
+		ensure_equals("spanning once", results[1], 3);
+
+		results.clear();
+		index.query(10.0, 10.0, 10.0, 10.0, results);
+		std::sort(results.begin(), results.end());
+		ensure_equals("on the edge", results.size(), 2U);
+		ensure_equals("edge point", results[0], 2);
+
+		results.clear();
+		index.query(-1.0, 2.0, -0.5, 3.0, results);
+		std::sort(results.begin(), results.end());
+		ensure_equals("negative", results.size(), 2U);
+		ensure_equals("negative point", results[1], 4);
+
+		results.clear();
+		index.query(30.0, 30.0, 1000.0, 1000.0, results);
+		ensure("none", results.empty());
+
+		ensure("removed", index.remove(3, -15.0, -15.0, 25.0, 25.0));
+		ensure("not twice", !index.remove(3, -15.0, -15.0, 25.0, 25.0));
+		ensure_equals("smaller", index.size(), 3);
+		results.clear();
+		index.query(-100.0, -100.0, 100.0, 100.0, results);
+		std::sort(results.begin(), results.end());
+		ensure_equals("rest", results.size(), 3U);
+		ensure_equals("rest first", results[0], 1);
+		ensure_equals("rest last", results[2], 4);
+
+		index.clear();
+		ensure("cleared", index.isEmpty());
+		results.clear();
+		index.query(-100.0, -100.0, 100.0, 100.0, results);
+		ensure("nothing left", results.empty());
+	}
+
+	template<> template<>
+	void gridindex_test_object_t::test<2>()
+	{
+		// random rectangles and points are found just as looking at all of
+		// them finds them
+		const F64 WORLD_WIDTH = 100.0 * REGION_WIDTH;
+		LLGridIndex<S32> index(CELL_WIDTH);
+		std::vector<Rect> rects;
+		for (S32 i = 0; i < 2000; ++i)
+		{
+			Rect rect = random_rect(WORLD_WIDTH, (i % 2) ? 0.0 : 4.0 * CELL_WIDTH);
+			index.insert(i, rect.mMinX, rect.mMinY, rect.mMaxX, rect.mMaxY);
+			rects.push_back(rect);
+		}
+
+		for (S32 i = 0; i < 200; ++i)
+		{
+			Rect query = random_rect(WORLD_WIDTH, (i % 4 + 1) * 3.0 * CELL_WIDTH);
+			std::vector<S32> expected;
+			scan(rects, query, expected);
+			ensure("same", query_sorted(index, query) == expected);
+		}
+
+		// take out every third one, and look again
+		for (S32 i = 0; i < (S32)rects.size(); i += 3)
+		{
+			ensure("removed", index.remove(i, rects[i].mMinX, rects[i].mMinY, rects[i].mMaxX, rects[i].mMaxY));
+			rects[i].mMinX = rects[i].mMaxX = -1.0e10;
+		}
+		for (S32 i = 0; i < 200; ++i)
+		{
+			Rect query = random_rect(WORLD_WIDTH, 8.0 * CELL_WIDTH);
+			std::vector<S32> expected;
+			scan(rects, query, expected);
+			ensure("same after removal", query_sorted(index, query) == expected);
+		}
+	}
+
+	template<> template<>
+	void gridindex_test_object_t::test<3>()
+	{
+		// 50k sims and 200k map items, as a long session of panning about
+		// the world map leaves them, and how long finding those in a map
+		// view takes, against looking at every one of them
+		const S32 NUM_SIMS = 50000;
+		const S32 ITEMS_PER_SIM = 4;
+		const S32 NUM_QUERIES = 200;
+		const F64 WORLD_WIDTH = 1000.0 * REGION_WIDTH;
+
+		LLGridIndex<S32> sims(CELL_WIDTH);
+		LLGridIndex<S32> items(CELL_WIDTH);
+		std::vector<Rect> sim_rects;
+		std::vector<Rect> item_rects;
+		for (S32 i = 0; i < NUM_SIMS; ++i)
+		{
+			// Mostly single regions, and every hundredth a var region.
+			Rect rect;
+			rect.mMinX = ll_rand(1000) * REGION_WIDTH;
+			rect.mMinY = ll_rand(1000) * REGION_WIDTH;
+			F64 width = (i % 100) ? REGION_WIDTH : 4.0 * REGION_WIDTH;
+			rect.mMaxX = rect.mMinX + width;
+			rect.mMaxY = rect.mMinY + width;
+			sims.insert(i, rect.mMinX, rect.mMinY, rect.mMaxX, rect.mMaxY);
+			sim_rects.push_back(rect);
+
+			for (S32 j = 0; j < ITEMS_PER_SIM; ++j)
+			{
+				Rect point;
+				point.mMinX = point.mMaxX = rect.mMinX + ll_frand() * REGION_WIDTH;
+				point.mMinY = point.mMaxY = rect.mMinY + ll_frand() * REGION_WIDTH;
+				items.insert((S32)item_rects.size(), point.mMinX, point.mMinY);
+				item_rects.push_back(point);
+			}
+		}
+
+		// Map views from a few regions across to a hundred.
+		std::vector<Rect> queries;
+		for (S32 i = 0; i < NUM_QUERIES; ++i)
+		{
+			F64 width = (1 + i % 4 * 33) * REGION_WIDTH;
+			Rect query;
+			query.mMinX = ll_frand() * (WORLD_WIDTH - width);
+			query.mMinY = ll_frand() * (WORLD_WIDTH - width);
+			query.mMaxX = query.mMinX + width;
+			query.mMaxY = query.mMinY + width * 0.75;
+			queries.push_back(query);
+		}
+
+		LLTimer timer;
+		U32 scanned = 0;
+		for (S32 i = 0; i < NUM_QUERIES; ++i)
+		{
+			std::vector<S32> results;
+			scan(sim_rects, queries[i], results);
+			scan(item_rects, queries[i], results);
+			scanned += results.size();
+		}
+		F32 scan_time = timer.getElapsedTimeF32();
+
+		timer.reset();
+		U32 found = 0;
+		std::vector<S32> results;
+		for (S32 i = 0; i < NUM_QUERIES; ++i)
+		{
+			results.clear();
+			sims.query(queries[i].mMinX, queries[i].mMinY, queries[i].mMaxX, queries[i].mMaxY, results);
+			items.query(queries[i].mMinX, queries[i].mMinY, queries[i].mMaxX, queries[i].mMaxY, results);
+			found += results.size();
+		}
+		F32 index_time = timer.getElapsedTimeF32();
+
+		ensure_equals("as many found", found, scanned);
+		for (S32 i = 0; i < NUM_QUERIES; i += 10)
+		{
+			std::vector<S32> expected;
+			scan(sim_rects, queries[i], expected);
+			ensure("same sims", query_sorted(sims, queries[i]) == expected);
+			expected.clear();
+			scan(item_rects, queries[i], expected);
+			ensure("same items", query_sorted(items, queries[i]) == expected);
+		}
+
+		llinfos << NUM_SIMS << " sims and " << item_rects.size() << " items, "
+				<< found / NUM_QUERIES << " in a view on average: every one "
+				<< scan_time * 1000.f / NUM_QUERIES << "ms, indexed "
+				<< index_time * 1000.f / NUM_QUERIES << "ms a view" << llendl;
+	}
+}
@@ -0,0 +1,534 @@
+/**
+ * @file llmorphdeltas_test.cpp
+ * @brief LLMorphDeltas unit tests and morph benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../llmorphdeltas.h"
+#include "../v2math.h"
+#include "../v3math.h"
+#include "../v4math.h"
+#include "../test/lltut.h"
+
+#include "llendianswizzle.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	const F32 NORMAL_SOFTEN_FACTOR = 0.65f;	// as llpolymorph.cpp has it
+	const F32 TOLERANCE = 1.0e-5f;
+
+	std::string character_dir()
+	{
+		std::string dir(__FILE__);
+		dir.erase(dir.find_last_of("/\\") + 1);
+		return dir + "../../newview/character/";
+	}
+
+	// A morph as LLPolyMorphData::loadBinary() reads it.
+	struct Morph
+	{
+		std::string mName;
+		std::vector<U32> mIndices;
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mNormals;
+		std::vector<LLVector3> mBinormals;
+		std::vector<LLVector2> mTexCoords;
+		LLMorphDeltas mDeltas;
+	};
+
+	// What LLPolyMeshSharedData::loadMesh() reads of a base mesh and its
+	// morphs.
+	struct Mesh
+	{
+		std::string mFileName;
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mNormals;
+		std::vector<LLVector3> mBinormals;
+		std::vector<LLVector2> mTexCoords;
+		std::vector<Morph> mMorphs;
+	};
+
+	// A copy of a mesh's vertices for morphs to be applied to.
+	struct MeshState
+	{
+		MeshState(const Mesh& mesh)
+			: mCoords(mesh.mCoords),
+			  mScaledNormals(mesh.mNormals),
+			  mNormals(mesh.mNormals),
+			  mScaledBinormals(mesh.mBinormals),
+			  mBinormals(mesh.mBinormals),
+			  mTexCoords(mesh.mTexCoords),
+			  mClothingWeights(mesh.mCoords.size(), LLVector4(0.f, 0.f, 0.f, 0.f))
+		{
+		}
+
+		LLMorphDeltas::Target getTarget(BOOL clothing)
+		{
+			LLMorphDeltas::Target target;
+			target.mCoords = &mCoords[0];
+			target.mScaledNormals = &mScaledNormals[0];
+			target.mNormals = &mNormals[0];
+			target.mScaledBinormals = &mScaledBinormals[0];
+			target.mBinormals = &mBinormals[0];
+			target.mTexCoords = &mTexCoords[0];
+			target.mClothingWeights = clothing ? &mClothingWeights[0] : NULL;
+			return target;
+		}
+
+		std::vector<LLVector3> mCoords;
+		std::vector<LLVector3> mScaledNormals;
+		std::vector<LLVector3> mNormals;
+		std::vector<LLVector3> mScaledBinormals;
+		std::vector<LLVector3> mBinormals;
+		std::vector<LLVector2> mTexCoords;
+		std::vector<LLVector4> mClothingWeights;
+	};
+
+	template<class T>
+	bool read_array(LLFILE* fp, std::vector<T>& data, size_t count, size_t components)
+	{
+		data.resize(count);
+		if (count && fread(&data[0], sizeof(T), count, fp) != count)
+		{
+			return false;
+		}
+		if (count)
+		{
+			llendianswizzle(&data[0], sizeof(T) / components, count * components);
+		}
+		return true;
+	}
+
+	bool load_morph(LLFILE* fp, Morph& morph)
+	{
+		S32 count = 0;
+		if (fread(&count, sizeof(S32), 1, fp) != 1)
+		{
+			return false;
+		}
+		llendianswizzle(&count, sizeof(S32), 1);
+		for (S32 v = 0; v < count; v++)
+		{
+			U32 index;
+			LLVector3 coord, normal, binormal;
+			LLVector2 tex_coord;
+			if (fread(&index, sizeof(U32), 1, fp) != 1
+				|| fread(coord.mV, sizeof(F32), 3, fp) != 3
+				|| fread(normal.mV, sizeof(F32), 3, fp) != 3
+				|| fread(binormal.mV, sizeof(F32), 3, fp) != 3
+				|| fread(tex_coord.mV, sizeof(F32), 2, fp) != 2)
+			{
+				return false;
+			}
+			llendianswizzle(&index, sizeof(U32), 1);
+			llendianswizzle(coord.mV, sizeof(F32), 3);
+			llendianswizzle(normal.mV, sizeof(F32), 3);
+			llendianswizzle(binormal.mV, sizeof(F32), 3);
+			llendianswizzle(tex_coord.mV, sizeof(F32), 2);
+			morph.mIndices.push_back(index);
+			morph.mCoords.push_back(coord);
+			morph.mNormals.push_back(normal);
+			morph.mBinormals.push_back(binormal);
+			morph.mTexCoords.push_back(tex_coord);
+		}
+		return true;
+	}
+
+	bool load_mesh(const std::string& file_name, Mesh& mesh)
+	{
+		LLFILE* fp = LLFile::fopen(character_dir() + file_name, "rb");
+		if (!fp)
+		{
+			return false;
+		}
+		mesh.mFileName = file_name;
+		char header[24];
+		U8 has_weights = 0;
+		U8 has_detail = 0;
+		F32 position_rotation[6];
+		U8 rotation_order = 0;
+		F32 scale[3];
+		U16 num_vertices = 0;
+		bool ok = fread(header, 1, 24, fp) == 24
+			&& !strncmp(header, "Linden Binary Mesh 1.0", 22)
+			&& fread(&has_weights, 1, 1, fp) == 1
+			&& fread(&has_detail, 1, 1, fp) == 1
+			&& fread(position_rotation, 4, 6, fp) == 6
+			&& fread(&rotation_order, 1, 1, fp) == 1
+			&& fread(scale, 4, 3, fp) == 3
+			&& fread(&num_vertices, 2, 1, fp) == 1;
+		llendianswizzle(&num_vertices, sizeof(U16), 1);
+
+		std::vector<LLVector2> detail_tex_coords;
+		std::vector<F32> weights;
+		std::vector<U16> faces;
+		U16 num_faces = 0;
+		ok = ok
+			&& read_array(fp, mesh.mCoords, num_vertices, 3)
+			&& read_array(fp, mesh.mNormals, num_vertices, 3)
+			&& read_array(fp, mesh.mBinormals, num_vertices, 3)
+			&& read_array(fp, mesh.mTexCoords, num_vertices, 2)
+			&& (!has_detail || read_array(fp, detail_tex_coords, num_vertices, 2))
+			&& (!has_weights || read_array(fp, weights, num_vertices, 1))
+			&& fread(&num_faces, 2, 1, fp) == 1;
+		llendianswizzle(&num_faces, sizeof(U16), 1);
+		ok = ok && read_array(fp, faces, num_faces * 3, 1);
+		if (ok && has_weights)
+		{
+			U16 num_joints = 0;
+			ok = fread(&num_joints, 2, 1, fp) == 1;
+			llendianswizzle(&num_joints, sizeof(U16), 1);
+			char name[64];
+			for (U16 i = 0; ok && i < num_joints; i++)
+			{
+				ok = fread(name, 64, 1, fp) == 1;
+			}
+		}
+
+		char morph_name[65];
+		morph_name[64] = '\0';
+		while (ok && fread(morph_name, 1, 64, fp) == 64 && strcmp(morph_name, "End Morphs"))
+		{
+			mesh.mMorphs.push_back(Morph());
+			Morph& morph = mesh.mMorphs.back();
+			morph.mName = morph_name;
+			ok = load_morph(fp, morph);
+			if (ok)
+			{
+				morph.mDeltas.set((U32)morph.mIndices.size(), morph.mIndices.empty() ? NULL : &morph.mIndices[0],
+								  morph.mCoords.empty() ? NULL : &morph.mCoords[0],
+								  morph.mNormals.empty() ? NULL : &morph.mNormals[0],
+								  morph.mBinormals.empty() ? NULL : &morph.mBinormals[0],
+								  morph.mTexCoords.empty() ? NULL : &morph.mTexCoords[0]);
+			}
+		}
+		fclose(fp);
+		return ok && !mesh.mCoords.empty();
+	}
+
+	// The base meshes, which are the ones with morphs.
+	void load_meshes(std::vector<Mesh>& meshes)
+	{
+		static const char* file_names[] = {
+			"avatar_head.llm", "avatar_upper_body.llm", "avatar_lower_body.llm",
+			"avatar_eye.llm", "avatar_hair.llm", "avatar_eyelashes.llm", "avatar_skirt.llm" };
+		for (U32 i = 0; i < LL_ARRAY_SIZE(file_names); i++)
+		{
+			Mesh mesh;
+			if (load_mesh(file_names[i], mesh))
+			{
+				meshes.push_back(mesh);
+			}
+		}
+	}
+
+	// LLPolyMorphTarget::apply() the way it used to be, straight off the
+	// morph's arrays of vectors.
+	void apply_reference(const Morph& morph, MeshState& state, BOOL clothing, F32 delta_weight, const F32* mask_weights)
+	{
+		for (U32 vert_index_morph = 0; vert_index_morph < morph.mIndices.size(); vert_index_morph++)
+		{
+			S32 vert_index_mesh = morph.mIndices[vert_index_morph];
+			F32 maskWeight = mask_weights ? mask_weights[vert_index_morph] : 1.f;
+
+			state.mCoords[vert_index_mesh] += morph.mCoords[vert_index_morph] * delta_weight * maskWeight;
+			if (clothing)
+			{
+				LLVector3 clothing_offset = morph.mCoords[vert_index_morph] * delta_weight * maskWeight;
+				LLVector4* clothing_weight = &state.mClothingWeights[vert_index_mesh];
+				clothing_weight->mV[VX] += clothing_offset.mV[VX];
+				clothing_weight->mV[VY] += clothing_offset.mV[VY];
+				clothing_weight->mV[VZ] += clothing_offset.mV[VZ];
+				clothing_weight->mV[VW] = maskWeight;
+			}
+
+			state.mScaledNormals[vert_index_mesh] += morph.mNormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
+			LLVector3 normalized_normal = state.mScaledNormals[vert_index_mesh];
+			normalized_normal.normVec();
+			state.mNormals[vert_index_mesh] = normalized_normal;
+
+			state.mScaledBinormals[vert_index_mesh] += morph.mBinormals[vert_index_morph] * delta_weight * maskWeight * NORMAL_SOFTEN_FACTOR;
+			LLVector3 tangent = state.mScaledBinormals[vert_index_mesh] % normalized_normal;
+			LLVector3 normalized_binormal = normalized_normal % tangent;
+			normalized_binormal.normVec();
+			state.mBinormals[vert_index_mesh] = normalized_binormal;
+
+			state.mTexCoords[vert_index_mesh] += morph.mTexCoords[vert_index_morph] * delta_weight * maskWeight;
+		}
+	}
+
+	BOOL close(const F32* a, const F32* b, S32 n)
+	{
+		for (S32 i = 0; i < n; i++)
+		{
+			if (fabsf(a[i] - b[i]) > TOLERANCE * llmax(1.f, fabsf(b[i])))
+			{
+				return FALSE;
+			}
+		}
+		return TRUE;
+	}
+
+	BOOL close(const MeshState& a, const MeshState& b)
+	{
+		for (U32 i = 0; i < a.mCoords.size(); i++)
+		{
+			if (!close(a.mCoords[i].mV, b.mCoords[i].mV, 3)
+				|| !close(a.mScaledNormals[i].mV, b.mScaledNormals[i].mV, 3)
+				|| !close(a.mNormals[i].mV, b.mNormals[i].mV, 3)
+				|| !close(a.mScaledBinormals[i].mV, b.mScaledBinormals[i].mV, 3)
+				|| !close(a.mBinormals[i].mV, b.mBinormals[i].mV, 3)
+				|| !close(a.mTexCoords[i].mV, b.mTexCoords[i].mV, 2)
+				|| !close(a.mClothingWeights[i].mV, b.mClothingWeights[i].mV, 4))
+			{
+				return FALSE;
+			}
+		}
+		return TRUE;
+	}
+
+	BOOL identical(const MeshState& a, const MeshState& b)
+	{
+		U32 n = (U32)a.mCoords.size();
+		return !memcmp(&a.mCoords[0], &b.mCoords[0], n * sizeof(LLVector3))
+			&& !memcmp(&a.mScaledNormals[0], &b.mScaledNormals[0], n * sizeof(LLVector3))
+			&& !memcmp(&a.mNormals[0], &b.mNormals[0], n * sizeof(LLVector3))
+			&& !memcmp(&a.mScaledBinormals[0], &b.mScaledBinormals[0], n * sizeof(LLVector3))
+			&& !memcmp(&a.mBinormals[0], &b.mBinormals[0], n * sizeof(LLVector3))
+			&& !memcmp(&a.mTexCoords[0], &b.mTexCoords[0], n * sizeof(LLVector2))
+			&& !memcmp(&a.mClothingWeights[0], &b.mClothingWeights[0], n * sizeof(LLVector4));
+	}
+
+	// Some mask weights for a morph, as a clothing layer's alpha gives it.
+	void make_mask(const Morph& morph, std::vector<F32>& mask_weights)
+	{
+		mask_weights.resize(morph.mIndices.size() + 1);
+		for (U32 i = 0; i < mask_weights.size(); i++)
+		{
+			mask_weights[i] = (i % 3) ? ll_frand() : (F32)(i % 2);
+		}
+	}
+}
+
+namespace tut
+{
+	struct morphdeltas_test
+	{
+		morphdeltas_test()
+		{
+			load_meshes(mMeshes);
+			mNumMorphs = 0;
+			for (U32 m = 0; m < mMeshes.size(); m++)
+			{
+				mNumMorphs += (S32)mMeshes[m].mMorphs.size();
+			}
+		}
+
+		~morphdeltas_test()
+		{
+			LLMorphDeltas::useSSE2(FALSE);
+		}
+
+		std::vector<Mesh> mMeshes;
+		S32 mNumMorphs;
+	};
+
+	typedef test_group<morphdeltas_test> morphdeltas_test_t;
+	typedef morphdeltas_test_t::object morphdeltas_test_object_t;
+	tut::morphdeltas_test_t tut_morphdeltas_test("morphdeltas_test");
+
+	template<> template<>
+	void morphdeltas_test_object_t::test<1>()
+	{
+		// the scalar version is the old per vertex math, exactly, for
+		// every stock morph
+		ensure("stock meshes loaded", mMeshes.size() >= 4 && mNumMorphs > 100);
+		LLMorphDeltas::useSSE2(FALSE);
+		for (U32 m = 0; m < mMeshes.size(); m++)
+		{
+			const Mesh& mesh = mMeshes[m];
+			MeshState expected(mesh);
+			MeshState actual(mesh);
+			std::vector<F32> mask_weights;
+			for (U32 i = 0; i < mesh.mMorphs.size(); i++)
+			{
+				const Morph& morph = mesh.mMorphs[i];
+				ensure_equals(morph.mName, morph.mDeltas.getCount(), (U32)morph.mIndices.size());
+				BOOL clothing = (i % 3 == 0);
+				make_mask(morph, mask_weights);
+				const F32* mask = (i % 2) ? &mask_weights[0] : NULL;
+				F32 weight = ll_frand(2.f) - 0.5f;
+				apply_reference(morph, expected, clothing, weight, mask);
+				LLMorphDeltas::sApply(morph.mDeltas, actual.getTarget(clothing), weight, mask, NORMAL_SOFTEN_FACTOR);
+			}
+			ensure(mesh.mFileName, identical(actual, expected));
+		}
+	}
+
+	template<> template<>
+	void morphdeltas_test_object_t::test<2>()
+	{
+		// SSE2 matches the reference, whatever the number of deltas
+		if (!LLMorphDeltas::hasSSE2())
+		{
+			llinfos << "Built without SSE2, nothing to compare" << llendl;
+			return;
+		}
+
+		S32 exact = 0;
+		for (U32 m = 0; m < mMeshes.size(); m++)
+		{
+			const Mesh& mesh = mMeshes[m];
+			MeshState expected(mesh);
+			MeshState actual(mesh);
+			std::vector<F32> mask_weights;
+			for (U32 i = 0; i < mesh.mMorphs.size(); i++)
+			{
+				const Morph& morph = mesh.mMorphs[i];
+				BOOL clothing = (i % 3 == 0);
+				make_mask(morph, mask_weights);
+				const F32* mask = (i % 2) ? &mask_weights[0] : NULL;
+				F32 weight = ll_frand(2.f) - 0.5f;
+				LLMorphDeltas::useSSE2(FALSE);
+				LLMorphDeltas::sApply(morph.mDeltas, expected.getTarget(clothing), weight, mask, NORMAL_SOFTEN_FACTOR);
+				LLMorphDeltas::useSSE2(TRUE);
+				ensure("using SSE2", LLMorphDeltas::usingSSE2());
+				LLMorphDeltas::sApply(morph.mDeltas, actual.getTarget(clothing), weight, mask, NORMAL_SOFTEN_FACTOR);
+			}
+			ensure(mesh.mFileName, close(actual, expected));
+			exact += identical(actual, expected);
+		}
+		llinfos << exact << " of " << mMeshes.size() << " meshes bit for bit identical to the reference" << llendl;
+
+		// short morphs, and ones that move a vertex twice
+		Mesh mesh;
+		for (U32 i = 0; i < 16; i++)
+		{
+			mesh.mCoords.push_back(LLVector3(ll_frand(), ll_frand(), ll_frand()));
+			mesh.mNormals.push_back(LLVector3(0.f, 0.f, 1.f));
+			mesh.mBinormals.push_back(LLVector3(1.f, 0.f, 0.f));
+			mesh.mTexCoords.push_back(LLVector2(ll_frand(), ll_frand()));
+		}
+		for (U32 count = 0; count <= 13; count++)
+		{
+			std::vector<U32> indices;
+			std::vector<LLVector3> coords, normals, binormals;
+			std::vector<LLVector2> tex_coords;
+			for (U32 i = 0; i < count + 1; i++)
+			{
+				// the last vertex of the mesh, and the fifth one twice over
+				indices.push_back(i == 0 ? 15 : (i == 6 ? 5 : i));
+				coords.push_back(LLVector3(ll_frand() - 0.5f, ll_frand() - 0.5f, ll_frand() - 0.5f));
+				normals.push_back(LLVector3(ll_frand() - 0.5f, ll_frand() - 0.5f, ll_frand() - 0.5f));
+				binormals.push_back(LLVector3(ll_frand() - 0.5f, ll_frand() - 0.5f, ll_frand() - 0.5f));
+				tex_coords.push_back(LLVector2(ll_frand() - 0.5f, ll_frand() - 0.5f));
+			}
+			LLMorphDeltas deltas;
+			deltas.set(count, &indices[0], &coords[0], &normals[0], &binormals[0], &tex_coords[0]);
+
+			MeshState expected(mesh);
+			MeshState actual(mesh);
+			LLMorphDeltas::useSSE2(FALSE);
+			LLMorphDeltas::sApply(deltas, expected.getTarget(TRUE), 0.75f, NULL, NORMAL_SOFTEN_FACTOR);
+			LLMorphDeltas::useSSE2(TRUE);
+			LLMorphDeltas::sApply(deltas, actual.getTarget(TRUE), 0.75f, NULL, NORMAL_SOFTEN_FACTOR);
+			ensure("short morph", close(actual, expected));
+		}
+	}
+
+	template<> template<>
+	void morphdeltas_test_object_t::test<3>()
+	{
+		// morph throughput: every stock morph applied to a crowd of
+		// avatars, as loading their appearances would
+		const S32 NUM_AVATARS = 50;
+
+		S32 num_deltas = 0;
+		for (U32 m = 0; m < mMeshes.size(); m++)
+		{
+			for (U32 i = 0; i < mMeshes[m].mMorphs.size(); i++)
+			{
+				num_deltas += (S32)mMeshes[m].mMorphs[i].mIndices.size();
+			}
+		}
+
+		F32 times[3] = { 0.f, 0.f, 0.f };
+		for (S32 pass = 0; pass < (LLMorphDeltas::hasSSE2() ? 3 : 2); pass++)
+		{
+			LLMorphDeltas::useSSE2(pass == 2);
+			std::vector<MeshState> states;
+			for (S32 a = 0; a < NUM_AVATARS; a++)
+			{
+				for (U32 m = 0; m < mMeshes.size(); m++)
+				{
+					states.push_back(MeshState(mMeshes[m]));
+				}
+			}
+
+			LLTimer timer;
+			for (S32 a = 0; a < NUM_AVATARS; a++)
+			{
+				for (U32 m = 0; m < mMeshes.size(); m++)
+				{
+					MeshState& state = states[a * mMeshes.size() + m];
+					for (U32 i = 0; i < mMeshes[m].mMorphs.size(); i++)
+					{
+						const Morph& morph = mMeshes[m].mMorphs[i];
+						F32 weight = (F32)((a + i) % 7) / 7.f;
+						if (pass == 0)
+						{
+							apply_reference(morph, state, FALSE, weight, NULL);
+						}
+						else
+						{
+							LLMorphDeltas::sApply(morph.mDeltas, state.getTarget(FALSE), weight, NULL, NORMAL_SOFTEN_FACTOR);
+						}
+					}
+				}
+			}
+			times[pass] = timer.getElapsedTimeF32();
+		}
+
+		F32 deltas = (F32)num_deltas * NUM_AVATARS;
+		llinfos << mNumMorphs << " morphs, " << num_deltas << " deltas, applied to " << NUM_AVATARS
+				<< " avatars: arrays of vectors " << deltas / llmax(times[0], 0.000001f) / 1000000.f
+				<< "M deltas/s, scalar " << deltas / llmax(times[1], 0.000001f) / 1000000.f << "M deltas/s";
+		if (times[2] > 0.f)
+		{
+			llcont << ", SSE2 " << deltas / llmax(times[2], 0.000001f) / 1000000.f << "M deltas/s ("
+				   << times[0] / times[2] << "x)";
+		}
+		llcont << llendl;
+	}
+}
@@ -0,0 +1,315 @@
+/**
+ * @file llpatchnormals_test.cpp
+ * @brief LLPatchNormals unit tests and region benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+#include "linden_common.h"
+
+#include "../llpatchnormals.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	const S32 PATCH_WIDTH = 16;
+	const S32 PATCHES_PER_EDGE = 16;
+	const S32 GRIDS_PER_EDGE = PATCH_WIDTH * PATCHES_PER_EDGE + 1;
+	const F32 METERS_PER_GRID = 1.f;
+
+	// A region's worth of height field, on its own, with no neighbors.
+	struct Region
+	{
+		std::vector<F32> mHeights;
+		std::vector<LLVector3> mNormals;
+
+		Region()
+			: mHeights(GRIDS_PER_EDGE * GRIDS_PER_EDGE),
+			  mNormals(GRIDS_PER_EDGE * GRIDS_PER_EDGE)
+		{
+			for (S32 y = 0; y < GRIDS_PER_EDGE; y++)
+			{
+				for (S32 x = 0; x < GRIDS_PER_EDGE; x++)
+				{
+					mHeights[y * GRIDS_PER_EDGE + x] = 20.f + 15.f * sinf(x * 0.05f) * cosf(y * 0.07f)
+													   + ll_frand(0.5f);
+				}
+			}
+		}
+
+		// As LLSurfacePatch::calcNormal() finds heights, past the edges of
+		// a region without neighbors, the patches on its edge clamp to the
+		// points just inside them.
+		F32 getHeight(S32 x, S32 y) const
+		{
+			const S32 last = GRIDS_PER_EDGE - 2;
+			return mHeights[llclamp(y, 0, last) * GRIDS_PER_EDGE + llclamp(x, 0, last)];
+		}
+
+		// LLSurfacePatch::calcNormal(), with stride 2.
+		LLVector3 calcNormal(S32 x, S32 y) const
+		{
+			const F32 mpg = METERS_PER_GRID * 2;
+			LLVector3 p00(-mpg, -mpg, getHeight(x - 2, y - 2));
+			LLVector3 p01(-mpg, +mpg, getHeight(x - 2, y + 2));
+			LLVector3 p10(+mpg, -mpg, getHeight(x + 2, y - 2));
+			LLVector3 p11(+mpg, +mpg, getHeight(x + 2, y + 2));
+
+			LLVector3 c1 = p11 - p00;
+			LLVector3 c2 = p01 - p10;
+
+			LLVector3 normal = c1;
+			normal %= c2;
+			normal.normVec();
+			return normal;
+		}
+
+		// Heights for the points of patch (i, j) in rect.
+		LLPatchNormals* makePatch(S32 i, S32 j, const LLRect& rect) const
+		{
+			LLPatchNormals* normals = new LLPatchNormals(PATCH_WIDTH, METERS_PER_GRID);
+			normals->addRect(rect);
+			LLRect heights = normals->getHeightsRect();
+			for (S32 y = heights.mBottom; y < heights.mTop; y++)
+			{
+				for (S32 x = heights.mLeft; x < heights.mRight; x++)
+				{
+					normals->setHeight(x, y, getHeight(i * PATCH_WIDTH + x, j * PATCH_WIDTH + y));
+				}
+			}
+			return normals;
+		}
+
+		void applyPatch(S32 i, S32 j, const LLPatchNormals& normals)
+		{
+			for (S32 y = 0; y <= PATCH_WIDTH; y++)
+			{
+				for (S32 x = 0; x <= PATCH_WIDTH; x++)
+				{
+					if (normals.contains(x, y))
+					{
+						mNormals[(j * PATCH_WIDTH + y) * GRIDS_PER_EDGE + i * PATCH_WIDTH + x] = normals.getNormal(x, y);
+					}
+				}
+			}
+		}
+
+		LLRect fullRect() const
+		{
+			return LLRect(0, PATCH_WIDTH + 1, PATCH_WIDTH + 1, 0);
+		}
+
+		void updateAll()
+		{
+			for (S32 j = 0; j < PATCHES_PER_EDGE; j++)
+			{
+				for (S32 i = 0; i < PATCHES_PER_EDGE; i++)
+				{
+					LLPatchNormals* normals = makePatch(i, j, fullRect());
+					normals->calculate();
+					applyPatch(i, j, *normals);
+					delete normals;
+				}
+			}
+		}
+
+		// Changes the heights in rect of patch (i, j) and updates the
+		// normals of it and its neighbors that see them. Returns the number
+		// of normals worked out.
+		S32 edit(S32 i, S32 j, const LLRect& rect, F32 delta)
+		{
+			for (S32 y = rect.mBottom; y < rect.mTop; y++)
+			{
+				for (S32 x = rect.mLeft; x < rect.mRight; x++)
+				{
+					mHeights[(j * PATCH_WIDTH + y) * GRIDS_PER_EDGE + i * PATCH_WIDTH + x] += delta;
+				}
+			}
+
+			S32 count = 0;
+			for (S32 dy = -1; dy <= 1; dy++)
+			{
+				for (S32 dx = -1; dx <= 1; dx++)
+				{
+					if (i + dx < 0 || i + dx >= PATCHES_PER_EDGE || j + dy < 0 || j + dy >= PATCHES_PER_EDGE)
+					{
+						continue;
+					}
+					LLRect affected = LLPatchNormals::getAffectedRect(rect, PATCH_WIDTH, dx, dy);
+					if (affected.isEmpty())
+					{
+						continue;
+					}
+					LLPatchNormals* normals = makePatch(i + dx, j + dy, affected);
+					normals->calculate();
+					applyPatch(i + dx, j + dy, *normals);
+					count += affected.getWidth() * affected.getHeight();
+					delete normals;
+				}
+			}
+			return count;
+		}
+	};
+}
+
+namespace tut
+{
+	struct patchnormals_test
+	{
+	};
+
+	typedef test_group<patchnormals_test> patchnormals_test_t;
+	typedef patchnormals_test_t::object patchnormals_test_object_t;
+	tut::patchnormals_test_t tut_patchnormals_test("patchnormals_test");
+
+	template<> template<>
+	void patchnormals_test_object_t::test<1>()
+	{
+		// every normal of every patch is calcNormal()'s, bit for bit,
+		// including those on the edges of the region
+		Region region;
+		region.updateAll();
+		for (S32 y = 0; y < GRIDS_PER_EDGE; y++)
+		{
+			for (S32 x = 0; x < GRIDS_PER_EDGE; x++)
+			{
+				LLVector3 expected = region.calcNormal(x, y);
+				ensure(llformat("normal at %d, %d", x, y),
+					   !memcmp(expected.mV, region.mNormals[y * GRIDS_PER_EDGE + x].mV, sizeof(expected.mV)));
+			}
+		}
+	}
+
+	template<> template<>
+	void patchnormals_test_object_t::test<2>()
+	{
+		// only the affected rectangles, across the seams too
+		ensure("middle", LLPatchNormals::getAffectedRect(LLRect(6, 10, 10, 6), PATCH_WIDTH) == LLRect(4, 12, 12, 4));
+		ensure("clipped", LLPatchNormals::getAffectedRect(LLRect(0, 16, 2, 14), PATCH_WIDTH) == LLRect(0, 17, 4, 12));
+		ensure("west neighbor", LLPatchNormals::getAffectedRect(LLRect(0, 16, 2, 14), PATCH_WIDTH, -1, 0) == LLRect(14, 17, 17, 12));
+		ensure("northwest neighbor", LLPatchNormals::getAffectedRect(LLRect(0, 16, 2, 14), PATCH_WIDTH, -1, 1) == LLRect(14, 2, 17, 0));
+		ensure("too far", LLPatchNormals::getAffectedRect(LLRect(6, 10, 10, 6), PATCH_WIDTH, 1, 0).isEmpty());
+		ensure("nothing changed", LLPatchNormals::getAffectedRect(LLRect(3, 3, 3, 3), PATCH_WIDTH).isEmpty());
+
+		LLPatchNormals normals(PATCH_WIDTH, METERS_PER_GRID);
+		ensure("empty", normals.isEmpty());
+		normals.addRect(LLRect(-5, 3, 2, -5));
+		normals.addRect(LLRect(15, 20, 20, 15));
+		ensure("bounds", normals.getRect() == LLRect(0, 17, 17, 0));
+		ensure("heights", normals.getHeightsRect() == LLRect(-2, 19, 19, -2));
+		ensure("added", normals.contains(0, 0) && normals.contains(1, 2) && normals.contains(16, 16));
+		ensure("not added", !normals.contains(2, 2) && !normals.contains(8, 8) && !normals.contains(14, 16));
+	}
+
+	template<> template<>
+	void patchnormals_test_object_t::test<3>()
+	{
+		// edits in the middle of a patch, on its edges and in its corners
+		// give the same normals as working all of them out again, and how
+		// long full and partial updates take
+		const S32 NUM_EDITS = 200;
+		Region region;
+		LLTimer timer;
+		region.updateAll();
+		F32 full_time = timer.getElapsedTimeF32();
+
+		S32 count = 0;
+		timer.reset();
+		for (S32 e = 0; e < NUM_EDITS; e++)
+		{
+			S32 left = ll_rand(PATCH_WIDTH);
+			S32 bottom = ll_rand(PATCH_WIDTH);
+			LLRect rect(left, llmin(bottom + 1 + ll_rand(4), PATCH_WIDTH + 1),
+						llmin(left + 1 + ll_rand(4), PATCH_WIDTH + 1), bottom);
+			count += region.edit(ll_rand(PATCHES_PER_EDGE), ll_rand(PATCHES_PER_EDGE), rect, ll_frand(2.f) - 1.f);
+		}
+		F32 partial_time = timer.getElapsedTimeF32();
+
+		Region expected(region);
+		expected.updateAll();
+		ensure("edited normals match",
+			   !memcmp(&region.mNormals[0], &expected.mNormals[0], region.mNormals.size() * sizeof(LLVector3)));
+
+		llinfos << "Normals for a region: " << full_time * 1000.f << "ms, for a terraform brush stroke: "
+				<< partial_time * 1000.f / NUM_EDITS << "ms (" << count / NUM_EDITS << " points)" << llendl;
+	}
+
+	template<> template<>
+	void patchnormals_test_object_t::test<4>()
+	{
+		// batches worked out on a thread come out the same, and how long a
+		// region takes
+		Region region;
+		region.updateAll();
+
+		LLPatchNormalsThread thread;
+		LLTimer timer;
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 j = 0; j < PATCHES_PER_EDGE; j++)
+		{
+			patch_normals_vec_t batch;
+			for (S32 i = 0; i < PATCHES_PER_EDGE; i++)
+			{
+				LLPatchNormals* normals = region.makePatch(i, j, region.fullRect());
+				ensure("empty", !normals->isEmpty());
+				batch.push_back(normals);
+			}
+			handles.push_back(thread.calculate(batch));
+			ensure("taken", batch.empty());
+		}
+
+		Region threaded(region);
+		threaded.mNormals.assign(threaded.mNormals.size(), LLVector3::zero);
+		for (S32 j = 0; j < PATCHES_PER_EDGE; j++)
+		{
+			patch_normals_vec_t batch;
+			while (!thread.getResult(handles[j], batch))
+			{
+				thread.update(0);
+				ms_sleep(1);
+			}
+			ensure_equals("whole row", (S32)batch.size(), PATCHES_PER_EDGE);
+			for (S32 i = 0; i < PATCHES_PER_EDGE; i++)
+			{
+				threaded.applyPatch(i, j, *batch[i]);
+				delete batch[i];
+			}
+		}
+		F32 threaded_time = timer.getElapsedTimeF32();
+		ensure("threaded normals match",
+			   !memcmp(&region.mNormals[0], &threaded.mNormals[0], region.mNormals.size() * sizeof(LLVector3)));
+
+		llinfos << "Normals for a region on a thread: " << threaded_time * 1000.f << "ms" << llendl;
+	}
+}
@@ -0,0 +1,537 @@
+/**
+ * @file llskyatmosphere_test.cpp
+ * @brief Tests for LLSkyAtmosphere and LLSkyCubeFace
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+#include "linden_common.h"
+
+#include "../llskyatmosphere.h"
+#include "../test/lltut.h"
+
+#include "llmath.h"
+#include "llstl.h"
+#include "lltimer.h"
+
+#include <algorithm>
+
+namespace
+{
+	const S32 RESOLUTION = 64;		// LLSkyTex::sResolution
+	const S32 NUM_TEXELS = RESOLUTION * RESOLUTION;
+
+	LLColor3 smear(F32 val)
+	{
+		return LLColor3(val, val, val);
+	}
+
+	LLColor3 componentDiv(LLColor3 const &left, LLColor3 const & right)
+	{
+		return LLColor3(left.mV[0]/right.mV[0],
+						 left.mV[1]/right.mV[1],
+						 left.mV[2]/right.mV[2]);
+	}
+
+	LLColor3 componentMult(LLColor3 const &left, LLColor3 const & right)
+	{
+		return LLColor3(left.mV[0]*right.mV[0],
+						 left.mV[1]*right.mV[1],
+						 left.mV[2]*right.mV[2]);
+	}
+
+	LLColor3 componentExp(LLColor3 const &v)
+	{
+		return LLColor3(expf(v.mV[0]),
+						 expf(v.mV[1]),
+						 expf(v.mV[2]));
+	}
+
+	LLColor3 componentSaturate(LLColor3 const &v)
+	{
+		return LLColor3(std::max(std::min(v.mV[0], 1.f), 0.f),
+						 std::max(std::min(v.mV[1], 1.f), 0.f),
+						 std::max(std::min(v.mV[2], 1.f), 0.f));
+	}
+
+	LLColor3 componentSqrt(LLColor3 const &v)
+	{
+		return LLColor3(sqrtf(v.mV[0]),
+						 sqrtf(v.mV[1]),
+						 sqrtf(v.mV[2]));
+	}
+
+	void componentMultBy(LLColor3 & left, LLColor3 const & right)
+	{
+		left.mV[0] *= right.mV[0];
+		left.mV[1] *= right.mV[1];
+		left.mV[2] *= right.mV[2];
+	}
+
+	LLColor3 colorMix(LLColor3 const & left, LLColor3 const & right, F32 amount)
+	{
+		return (left + ((right - left) * amount));
+	}
+
+	// LLVOSky::calcSkyColorWLVert() as it was, with the haze color for
+	// LLVOSky::calcSkyColorWLFrag() to return. The math functions are the
+	// float ones its overloads came to in llvosky.cpp.
+	LLColor3 calc_haze_color(const LLSkyAtmosphere::Params& p, LLVector3& Pn)
+	{
+		// project the direction ray onto the sky dome.
+		F32 phi = acosf(Pn[1]);
+		F32 sinA = sinf(F_PI - phi);
+		F32 Plen = p.mDomeRadius * sinf(F_PI + phi + asinf(p.mDomeOffsetRatio * sinA)) / sinA;
+
+		Pn *= Plen;
+
+		// Set altitude
+		if (Pn[1] > 0.f)
+		{
+			Pn *= (p.mMaxY / Pn[1]);
+		}
+		else
+		{
+			Pn *= (-32000.f / Pn[1]);
+		}
+
+		Plen = Pn.length();
+		Pn /= Plen;
+
+		LLColor3 sunlight = p.mSunlightColor;
+		LLColor3 light_atten =
+			(p.mBlueDensity * 1.0 + smear(p.mHazeDensity * 0.25f)) * (p.mDensityMultiplier * p.mMaxY);
+
+		LLColor3 temp2(0.f, 0.f, 0.f);
+		LLColor3 temp1 = p.mBlueDensity + smear(p.mHazeDensity);
+		LLColor3 blue_weight = componentDiv(p.mBlueDensity, temp1);
+		LLColor3 haze_weight = componentDiv(smear(p.mHazeDensity), temp1);
+
+		temp2.mV[1] = llmax(F_APPROXIMATELY_ZERO, llmax(0.f, Pn[1]) * 1.0f + p.mLightNorm[1] );
+
+		temp2.mV[1] = 1.f / temp2.mV[1];
+		componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
+
+		temp2.mV[2] = Plen * p.mDensityMultiplier;
+
+		temp1 = componentExp((temp1 * -1.f) * temp2.mV[2]);
+
+		temp2.mV[0] = Pn * LLVector3(p.mLightNorm);
+
+		temp2.mV[0] = 1.f - temp2.mV[0];
+		temp2.mV[0] = llmax(temp2.mV[0], .001f);
+		temp2.mV[0] *= p.mGlow.mV[0];
+		temp2.mV[0] = powf(temp2.mV[0], p.mGlow.mV[2]);
+
+		temp2.mV[0] += .25f;
+
+		LLColor3 vary_HazeColor = (p.mBlueHorizon * blue_weight * (sunlight + p.mAmbient)
+					+ componentMult(p.mHazeHorizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + p.mAmbient)
+				 );
+
+		LLColor3 tmpAmbient = p.mAmbient + (LLColor3::white - p.mAmbient) * p.mCloudShadow * 0.5f;
+
+		sunlight *= (1.f - p.mCloudShadow);
+
+		LLColor3 additiveColorBelowCloud = (p.mBlueHorizon * blue_weight * (sunlight + tmpAmbient)
+					+ componentMult(p.mHazeHorizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + tmpAmbient)
+				 );
+
+		componentMultBy(vary_HazeColor, LLColor3::white - temp1);
+
+		sunlight = p.mSunlightColor;
+		temp2.mV[1] = llmax(0.f, p.mLightNorm[1] * 2.f);
+		temp2.mV[1] = 1.f / temp2.mV[1];
+		componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
+
+		temp1 = componentSqrt(temp1);
+
+		vary_HazeColor +=
+			componentMult(additiveColorBelowCloud - vary_HazeColor, LLColor3::white - componentSqrt(temp1));
+
+		if (Pn[1] < 0.f)
+		{
+			LLColor3 dark_brown(0.082f, 0.076f, 0.066f);
+			LLColor3 brown(0.430f, 0.386f, 0.322f);
+			LLColor3 sky_lighting = sunlight + p.mAmbient;
+			F32 haze_brightness = vary_HazeColor.brightness();
+
+			if (Pn[1] < -0.05f)
+			{
+				vary_HazeColor = colorMix(dark_brown, brown, -Pn[1] * 0.9f) * sky_lighting * haze_brightness;
+			}
+
+			if (Pn[1] > -0.1f)
+			{
+				vary_HazeColor = colorMix(LLColor3::white * haze_brightness, vary_HazeColor, fabs((Pn[1] + 0.05f) * -20.f));
+			}
+		}
+		return vary_HazeColor;
+	}
+
+	// LLVOSky::calcSkyColorInDir() as it was, which LLVOSky::createSkyTexture()
+	// called twice for every texel.
+	LLColor4 calc_sky_color_in_dir(const LLSkyAtmosphere::Params& p, const LLVector3 &dir, bool isShiny = false)
+	{
+		F32 saturation = 0.3f;
+		const LLColor4& fog_color = p.mFogColor;
+		if (dir.mV[VZ] < -0.02f)
+		{
+			LLColor4 col = LLColor4(llmax(fog_color[0],0.2f), llmax(fog_color[1],0.2f), llmax(fog_color[2],0.22f),0.f);
+			if (isShiny)
+			{
+				LLColor3 desat_fog = LLColor3(fog_color);
+				F32 brightness = desat_fog.brightness();
+				if (brightness < 0.15f)
+				{
+					brightness = 0.15f;
+					desat_fog = smear(0.15f);
+				}
+				LLColor3 greyscale = smear(brightness);
+				desat_fog = desat_fog * saturation + greyscale * (1.0f - saturation);
+				if (!p.mWindLightShaders)
+				{
+					col = LLColor4(desat_fog, 0.f);
+				}
+				else
+				{
+					col = LLColor4(desat_fog * 0.5f, 0.f);
+				}
+			}
+			float x = 1.0f-fabsf(-0.1f-dir.mV[VZ]);
+			x *= x;
+			col.mV[0] *= x*x;
+			col.mV[1] *= powf(x, 2.5f);
+			col.mV[2] *= x*x*x;
+			return col;
+		}
+
+		LLVector3 Pn = LLVector3(-dir[1] , -dir[2], -dir[0]);
+		LLColor3 color0 = calc_haze_color(p, Pn);
+
+		LLColor3 sky_color;
+		if (!p.mWindLightShaders)
+		{
+			LLColor3 color1 = color0 * 2.0f;
+			color1 = smear(1.f) - componentSaturate(color1);
+			sky_color = smear(1.f) - color1;
+		}
+		else
+		{
+			sky_color = color0;
+		}
+
+		if (isShiny)
+		{
+			F32 brightness = sky_color.brightness();
+			LLColor3 greyscale = smear(brightness);
+			sky_color = sky_color * saturation + greyscale * (1.0f - saturation);
+			sky_color *= (0.5f + 0.5f * brightness);
+		}
+		return LLColor4(sky_color, 0.0f);
+	}
+
+	// Default, Coastal Sunset and Night from app_settings/windlight/skies,
+	// with the sun at elevation and azimuth, in degrees.
+	LLSkyAtmosphere::Params make_params(S32 preset, F32 elevation, F32 azimuth, BOOL wl_shaders)
+	{
+		LLSkyAtmosphere::Params params;
+		params.mDomeRadius = 15000.f;
+		params.mDomeOffsetRatio = 0.96f;
+		switch (preset)
+		{
+		case 0:
+			params.mSunlightColor.setVec(0.734211f, 0.781579f, 0.9f);
+			params.mAmbient.setVec(1.05f, 1.05f, 1.05f);
+			params.mBlueDensity.setVec(0.244758f, 0.448723f, 0.76f);
+			params.mBlueHorizon.setVec(0.495484f, 0.495484f, 0.64f);
+			params.mHazeDensity = 0.7f;
+			params.mHazeHorizon.setVec(0.19f, 0.199156f, 0.199156f);
+			params.mDensityMultiplier = 0.00018f;
+			params.mMaxY = 1605.f;
+			params.mGlow.setVec(5.f, 0.001f, -0.48f);
+			params.mCloudShadow = 0.27f;
+			params.mFogColor.setVec(0.6f, 0.65f, 0.75f, 1.f);
+			break;
+		case 1:
+			params.mSunlightColor.setVec(3.f, 3.f, 3.f);
+			params.mAmbient.setVec(0.315351f, 0.374719f, 0.51f);
+			params.mBlueDensity.setVec(0.116454f, 0.320751f, 0.641509f);
+			params.mBlueHorizon.setVec(0.0541764f, 0.107415f, 0.125786f);
+			params.mHazeDensity = 0.679245f;
+			params.mHazeHorizon.setVec(0.132109f, 0.132109f, 0.132109f);
+			params.mDensityMultiplier = 0.000158491f;
+			params.mMaxY = 1308.18f;
+			params.mGlow.setVec(6.86792f, 0.00137359f, -0.453283f);
+			params.mCloudShadow = 0.32704401f;
+			params.mFogColor.setVec(0.45f, 0.35f, 0.3f, 1.f);
+			break;
+		default:
+			params.mSunlightColor.setVec(0.348767f, 0.355742f, 0.66f);
+			params.mAmbient.setVec(0.20405f, 0.242467f, 0.33f);
+			params.mBlueDensity.setVec(0.45f, 0.45f, 0.45f);
+			params.mBlueHorizon.setVec(0.24f, 0.24f, 0.24f);
+			params.mHazeDensity = 4.f;
+			params.mHazeHorizon.setVec(1.79016e-10f, 0.199156f, 0.199156f);
+			params.mDensityMultiplier = 0.0003f;
+			params.mMaxY = 906.2f;
+			params.mGlow.setVec(5.f, 0.001f, -0.48f);
+			params.mCloudShadow = 0.36f;
+			params.mFogColor.setVec(0.05f, 0.06f, 0.1f, 1.f);
+			break;
+		}
+
+		// As LLVOSky::initAtmospherics() sets up the light norm from the
+		// sun direction.
+		F32 theta = elevation * DEG_TO_RAD;
+		F32 phi = azimuth * DEG_TO_RAD;
+		LLVector3 sun_dir(cosf(theta) * cosf(phi), cosf(theta) * sinf(phi), sinf(theta));
+		params.mLightNorm.setVec(sun_dir.mV[1], sun_dir.mV[2], sun_dir.mV[0], 0.f);
+		if (params.mLightNorm.mV[1] < -0.1f)
+		{
+			params.mLightNorm.mV[1] = -0.1f;
+		}
+		params.mWindLightShaders = wl_shaders;
+		return params;
+	}
+
+	const S32 NUM_PRESETS = 3;
+	const S32 NUM_ELEVATIONS = 9;
+	const F32 ELEVATIONS[NUM_ELEVATIONS] = { -30.f, -8.f, -2.f, 0.f, 3.f, 10.f, 25.f, 50.f, 89.f };
+
+	bool same_colors(const LLColor4* a, const LLColor4* b, S32 count)
+	{
+		return !memcmp(a, b, count * sizeof(LLColor4));
+	}
+}
+
+namespace tut
+{
+	struct skyatmosphere_test
+	{
+		~skyatmosphere_test()
+		{
+			LLSkyCubeFace::useSSE2(FALSE);
+		}
+	};
+
+	typedef test_group<skyatmosphere_test> skyatmosphere_test_t;
+	typedef skyatmosphere_test_t::object skyatmosphere_test_object_t;
+	tut::skyatmosphere_test_t tut_skyatmosphere_test("skyatmosphere_test");
+
+	template<> template<>
+	void skyatmosphere_test_object_t::test<1>()
+	{
+		// every texel of every face, in the sky and the shiny map, is what
+		// calcSkyColorInDir() gave, bit for bit, for the sun all over the
+		// sky, with and without the WindLight shaders
+		for (S32 preset = 0; preset < NUM_PRESETS; preset++)
+		{
+			for (S32 e = 0; e < NUM_ELEVATIONS; e++)
+			{
+				LLSkyAtmosphere::Params params = make_params(preset, ELEVATIONS[e], e * 40.f, e & 1);
+				for (S32 face = 0; face < LLSkyCubeFace::NUM_FACES; face++)
+				{
+					LLSkyCubeFace cube_face(params, face, RESOLUTION);
+					cube_face.calculate();
+					for (S32 x = 0; x < RESOLUTION; x++)
+					{
+						for (S32 y = 0; y < RESOLUTION; y++)
+						{
+							LLVector3 dir = LLSkyCubeFace::getDir(face, x, y, RESOLUTION);
+							LLColor4 sky = calc_sky_color_in_dir(params, dir);
+							LLColor4 shiny = calc_sky_color_in_dir(params, dir, true);
+							S32 offset = x * RESOLUTION + y;
+							ensure(llformat("sky %d %d face %d at %d, %d", preset, e, face, x, y),
+								   same_colors(&sky, cube_face.getSky() + offset, 1));
+							ensure(llformat("shiny %d %d face %d at %d, %d", preset, e, face, x, y),
+								   same_colors(&shiny, cube_face.getShiny() + offset, 1));
+						}
+					}
+					LLColor4 one = cube_face.getAtmosphere().calcColor(LLSkyCubeFace::getDir(face, 1, 36, RESOLUTION));
+					ensure("one direction", same_colors(&one, cube_face.getSky() + 1 * RESOLUTION + 36, 1));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void skyatmosphere_test_object_t::test<2>()
+	{
+		// SSE2 gives the same texels, in pieces of any size too
+		if (!LLSkyCubeFace::hasSSE2())
+		{
+			skip("no SSE2 in this build");
+		}
+		for (S32 preset = 0; preset < NUM_PRESETS; preset++)
+		{
+			for (S32 e = 0; e < NUM_ELEVATIONS; e++)
+			{
+				LLSkyAtmosphere::Params params = make_params(preset, ELEVATIONS[e], e * 40.f, !(e & 1));
+				for (S32 face = 0; face < LLSkyCubeFace::NUM_FACES; face++)
+				{
+					LLSkyCubeFace scalar(params, face, RESOLUTION);
+					LLSkyCubeFace::useSSE2(FALSE);
+					scalar.calculate();
+
+					LLSkyCubeFace sse2(params, face, RESOLUTION);
+					LLSkyCubeFace::useSSE2(TRUE);
+					ensure("using SSE2", LLSkyCubeFace::usingSSE2());
+					for (S32 begin = 0; begin < NUM_TEXELS; begin += 123)
+					{
+						sse2.calculate(begin, llmin(begin + 123, NUM_TEXELS));
+					}
+					ensure(llformat("sky %d %d face %d", preset, e, face),
+						   same_colors(scalar.getSky(), sse2.getSky(), NUM_TEXELS));
+					ensure(llformat("shiny %d %d face %d", preset, e, face),
+						   same_colors(scalar.getShiny(), sse2.getShiny(), NUM_TEXELS));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void skyatmosphere_test_object_t::test<3>()
+	{
+		// settings that look the same share a key, and ones that don't, don't
+		LLSkyAtmosphere::Params params = make_params(0, 30.f, 10.f, TRUE);
+		LLSkyAtmosphere::key_t key = LLSkyAtmosphere::getKey(params);
+		ensure("same settings", key == LLSkyAtmosphere::getKey(make_params(0, 30.f, 10.f, TRUE)));
+
+		LLSkyAtmosphere::Params nudged = params;
+		nudged.mHazeDensity += 0.00001f;
+		nudged.mAmbient.mV[2] -= 0.00001f;
+		ensure("too small to see", key == LLSkyAtmosphere::getKey(nudged));
+
+		ensure("sun moved", key != LLSkyAtmosphere::getKey(make_params(0, 31.f, 10.f, TRUE)));
+		ensure("other preset", key != LLSkyAtmosphere::getKey(make_params(1, 30.f, 10.f, TRUE)));
+		ensure("shaders", key != LLSkyAtmosphere::getKey(make_params(0, 30.f, 10.f, FALSE)));
+
+		LLSkyAtmosphere::Params foggy = params;
+		foggy.mFogColor.mV[1] += 0.1f;
+		ensure("fog", key != LLSkyAtmosphere::getKey(foggy));
+	}
+
+	template<> template<>
+	void skyatmosphere_test_object_t::test<4>()
+	{
+		// faces worked out on threads come out the same, and how long a
+		// whole cube map takes, for the sun all over the sky
+		const S32 NUM_THREADS = 2;
+		std::vector<LLSkyCubeFaceThread*> threads;
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			threads.push_back(new LLSkyCubeFaceThread);
+		}
+
+		F32 original_time = 0.f;
+		F32 scalar_time = 0.f;
+		F32 sse2_time = 0.f;
+		F32 threaded_time = 0.f;
+		S32 num_cubes = 0;
+		LLTimer timer;
+		for (S32 preset = 0; preset < NUM_PRESETS; preset++)
+		{
+			for (S32 e = 0; e < NUM_ELEVATIONS; e++)
+			{
+				LLSkyAtmosphere::Params params = make_params(preset, ELEVATIONS[e], e * 40.f, TRUE);
+				num_cubes++;
+
+				timer.reset();
+				std::vector<LLColor4> original(NUM_TEXELS * 2);
+				for (S32 face = 0; face < LLSkyCubeFace::NUM_FACES; face++)
+				{
+					for (S32 x = 0; x < RESOLUTION; x++)
+					{
+						for (S32 y = 0; y < RESOLUTION; y++)
+						{
+							LLVector3 dir = LLSkyCubeFace::getDir(face, x, y, RESOLUTION);
+							original[x * RESOLUTION + y] = calc_sky_color_in_dir(params, dir);
+							original[NUM_TEXELS + x * RESOLUTION + y] = calc_sky_color_in_dir(params, dir, true);
+						}
+					}
+				}
+				original_time += timer.getElapsedTimeF32();
+
+				sky_cube_face_vec_t faces;
+				for (S32 pass = 0; pass < 2; pass++)
+				{
+					LLSkyCubeFace::useSSE2(pass == 1);
+					timer.reset();
+					for (S32 face = 0; face < LLSkyCubeFace::NUM_FACES; face++)
+					{
+						LLSkyCubeFace* cube_face = new LLSkyCubeFace(params, face, RESOLUTION);
+						cube_face->calculate();
+						faces.push_back(cube_face);
+					}
+					(pass == 1 ? sse2_time : scalar_time) += timer.getElapsedTimeF32();
+				}
+
+				timer.reset();
+				std::vector<LLQueuedThread::handle_t> handles;
+				for (S32 face = 0; face < LLSkyCubeFace::NUM_FACES; face++)
+				{
+					sky_cube_face_vec_t batch;
+					batch.push_back(new LLSkyCubeFace(params, face, RESOLUTION, (void*)(intptr_t)face));
+					handles.push_back(threads[face % NUM_THREADS]->calculate(batch));
+					ensure("taken", batch.empty());
+				}
+				for (S32 face = 0; face < LLSkyCubeFace::NUM_FACES; face++)
+				{
+					LLSkyCubeFaceThread* thread = threads[face % NUM_THREADS];
+					sky_cube_face_vec_t batch;
+					while (!thread->getResult(handles[face], batch))
+					{
+						thread->update(0);
+						ms_sleep(1);
+					}
+					ensure_equals("one face", (S32)batch.size(), 1);
+					ensure_equals("user data", (S32)(intptr_t)batch[0]->getUserData(), face);
+					ensure("threaded sky", same_colors(faces[face]->getSky(), batch[0]->getSky(), NUM_TEXELS));
+					ensure("threaded shiny", same_colors(faces[face]->getShiny(), batch[0]->getShiny(), NUM_TEXELS));
+					delete batch[0];
+				}
+				threaded_time += timer.getElapsedTimeF32();
+
+				ensure("last face sky", same_colors(&original[0], faces[LLSkyCubeFace::NUM_FACES - 1]->getSky(), NUM_TEXELS));
+				ensure("last face shiny", same_colors(&original[NUM_TEXELS], faces[LLSkyCubeFace::NUM_FACES - 1]->getShiny(), NUM_TEXELS));
+				for_each(faces.begin(), faces.end(), DeletePointer());
+			}
+		}
+
+		for_each(threads.begin(), threads.end(), DeletePointer());
+
+		llinfos << "Sky cube map: calcSkyColorInDir() " << original_time * 1000.f / num_cubes
+				<< "ms, scalar " << scalar_time * 1000.f / num_cubes
+				<< "ms, SSE2 " << sse2_time * 1000.f / num_cubes
+				<< "ms, " << NUM_THREADS << " threads " << threaded_time * 1000.f / num_cubes << "ms" << llendl;
+	}
+}
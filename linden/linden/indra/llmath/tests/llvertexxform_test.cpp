@@ -0,0 +1,317 @@
+/**
+ * @file llvertexxform_test.cpp
+ * @brief LLVertexXform unit tests and face rebuild benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../llvertexxform.h"
+#include "../llvolume.h"
+#include "../llvolumemgr.h"
+#include "../m3math.h"
+#include "../m4math.h"
+#include "../llquaternion.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	// Interleaved like an LLVertexBuffer with positions, normals,
+	// binormals, two sets of texture coordinates and colors.
+	struct BufferVertex
+	{
+		LLVector3 mPosition;
+		LLVector3 mNormal;
+		LLVector3 mBinormal;
+		LLVector2 mTexCoord0;
+		LLVector2 mTexCoord1;
+		U32 mColor;
+	};
+
+	const U32 GUARD = 0xdeadbeef;
+	const F32 TOLERANCE = 1.0e-6f;
+
+	LLVolumeParams make_params(S32 i)
+	{
+		static const U8 profiles[] = { LL_PCODE_PROFILE_SQUARE, LL_PCODE_PROFILE_CIRCLE,
+									   LL_PCODE_PROFILE_EQUALTRI, LL_PCODE_PROFILE_CIRCLE_HALF };
+		static const U8 paths[] = { LL_PCODE_PATH_LINE, LL_PCODE_PATH_CIRCLE };
+
+		LLVolumeParams params;
+		params.setType(profiles[i % 4], paths[(i / 4) % 2]);
+		params.setBeginAndEndS(0.f, 1.f);
+		params.setBeginAndEndT(0.f, 1.f);
+		params.setHollow((i % 3) * 0.3f);
+		params.setTwistEnd((i % 5) * 0.1f);
+		return params;
+	}
+
+	// A transform like a prim's render matrix, scaled and rotated out of
+	// the axes.
+	void make_matrices(S32 i, LLMatrix4& mat_vert, LLMatrix3& mat_normal)
+	{
+		LLQuaternion rot(0.3f * i + 0.1f, LLVector3(1.f, 2.f, 3.f));
+		LLVector3 scale(0.5f + i, 2.f, 10.f - i * 0.5f);
+		LLVector3 pos(128.f + i, 64.f, 25.f * i);
+		mat_vert.initAll(scale, rot, pos);
+		mat_normal = rot.getMatrix3();
+		// inverse scale, as LLVOVolume's normal matrix has it
+		mat_normal.mMatrix[VX][VX] /= scale.mV[VX];
+		mat_normal.mMatrix[VY][VY] /= scale.mV[VY];
+		mat_normal.mMatrix[VZ][VZ] /= scale.mV[VZ];
+	}
+
+	BOOL close(const LLVector3& a, const LLVector3& b)
+	{
+		for (S32 i = 0; i < 3; i++)
+		{
+			if (fabsf(a.mV[i] - b.mV[i]) > TOLERANCE * llmax(1.f, fabsf(b.mV[i])))
+			{
+				return FALSE;
+			}
+		}
+		return TRUE;
+	}
+
+	BOOL close(const LLVector2& a, const LLVector2& b)
+	{
+		return close(LLVector3(a.mV[0], a.mV[1], 0.f), LLVector3(b.mV[0], b.mV[1], 0.f));
+	}
+
+	void clear(std::vector<BufferVertex>& buffer)
+	{
+		for (U32 i = 0; i < buffer.size(); i++)
+		{
+			U32* p = (U32*)&buffer[i];
+			for (U32 j = 0; j < sizeof(BufferVertex) / sizeof(U32); j++)
+			{
+				p[j] = GUARD;
+			}
+		}
+	}
+
+	// What LLFace::getGeometryVolume() does with a face.
+	void rebuild(const LLVolumeFace& vf, const LLMatrix4& mat_vert, const LLMatrix3& mat_normal,
+				 const LLVertexXform::TexCoordXform& tc_xform, BufferVertex* dst)
+	{
+		S32 count = (S32)vf.mVertices.size();
+		if (!count)
+		{
+			return;
+		}
+		const LLVolumeFace::VertexData* src = &vf.mVertices[0];
+		const U32 src_stride = sizeof(LLVolumeFace::VertexData);
+		const U32 dst_stride = sizeof(BufferVertex);
+		LLVertexXform::sTransformTexCoords(tc_xform, &src->mTexCoord, src_stride, &dst->mTexCoord0, dst_stride, count);
+		LLVertexXform::sTransformPoints(mat_vert, &src->mPosition, src_stride, &dst->mPosition, dst_stride, count);
+		LLVertexXform::sTransformNormals(mat_normal, &src->mNormal, src_stride, &dst->mNormal, dst_stride, count);
+		LLVertexXform::sTransformNormals(mat_normal, &src->mBinormal, src_stride, &dst->mBinormal, dst_stride, count);
+	}
+}
+
+namespace tut
+{
+	struct vertexxform_test
+	{
+		vertexxform_test()
+		{
+			mTexCoordXform.mCos = cosf(0.7f);
+			mTexCoordXform.mSin = sinf(0.7f);
+			mTexCoordXform.mOffsetS = 0.25f;
+			mTexCoordXform.mOffsetT = -0.125f;
+			mTexCoordXform.mScaleS = 2.f;
+			mTexCoordXform.mScaleT = 0.5f;
+		}
+
+		~vertexxform_test()
+		{
+			LLVertexXform::useSSE2(FALSE);
+		}
+
+		LLVertexXform::TexCoordXform mTexCoordXform;
+	};
+
+	typedef test_group<vertexxform_test> vertexxform_test_t;
+	typedef vertexxform_test_t::object vertexxform_test_object_t;
+	tut::vertexxform_test_t tut_vertexxform_test("vertexxform_test");
+
+	template<> template<>
+	void vertexxform_test_object_t::test<1>()
+	{
+		// the scalar versions are the per vertex math, exactly
+		LLMatrix4 mat_vert;
+		LLMatrix3 mat_normal;
+		make_matrices(3, mat_vert, mat_normal);
+		LLPointer<LLVolume> volume = new LLVolume(make_params(5), 1.f);
+		volume->genBinormals(0);
+		const LLVolumeFace& vf = volume->getVolumeFace(0);
+		S32 count = (S32)vf.mVertices.size();
+
+		std::vector<BufferVertex> buffer(count);
+		clear(buffer);
+		LLVertexXform::useSSE2(FALSE);
+		rebuild(vf, mat_vert, mat_normal, mTexCoordXform, &buffer[0]);
+
+		for (S32 i = 0; i < count; i++)
+		{
+			LLVector3 normal = vf.mVertices[i].mNormal * mat_normal;
+			normal.normVec();
+			LLVector3 binormal = vf.mVertices[i].mBinormal * mat_normal;
+			binormal.normVec();
+			LLVector2 tc = vf.mVertices[i].mTexCoord;
+			LLVertexXform::transformTexCoord(mTexCoordXform, tc);
+
+			ensure("position", buffer[i].mPosition == vf.mVertices[i].mPosition * mat_vert);
+			ensure("normal", buffer[i].mNormal == normal);
+			ensure("binormal", buffer[i].mBinormal == binormal);
+			ensure("tex coord", buffer[i].mTexCoord0 == tc);
+			ensure_equals("untouched", buffer[i].mColor, GUARD);
+		}
+	}
+
+	template<> template<>
+	void vertexxform_test_object_t::test<2>()
+	{
+		// SSE2 matches the reference, whatever the vertex count
+		if (!LLVertexXform::hasSSE2())
+		{
+			llinfos << "Built without SSE2, nothing to compare" << llendl;
+			return;
+		}
+
+		LLMatrix4 mat_vert;
+		LLMatrix3 mat_normal;
+		make_matrices(1, mat_vert, mat_normal);
+
+		std::vector<LLVolumeFace::VertexData> verts(64);
+		for (U32 i = 0; i < verts.size(); i++)
+		{
+			verts[i].mPosition.setVec(ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f);
+			verts[i].mNormal.setVec(ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f, ll_frand(2.f) - 1.f);
+			verts[i].mBinormal = verts[i].mNormal % LLVector3::z_axis;
+			verts[i].mTexCoord.setVec(ll_frand(), ll_frand());
+		}
+		// degenerate normals come out as zero either way
+		verts[5].mNormal.clearVec();
+		verts[6].mNormal.setVec(1.e-9f, 0.f, 0.f);
+
+		S32 exact = 0;
+		S32 total = 0;
+		for (S32 count = 0; count <= 13; count++)
+		{
+			LLVolumeFace vf;
+			vf.mVertices.assign(verts.begin(), verts.begin() + count);
+
+			std::vector<BufferVertex> expected(count + 1);
+			std::vector<BufferVertex> actual(count + 1);
+			clear(expected);
+			clear(actual);
+			LLVertexXform::useSSE2(FALSE);
+			rebuild(vf, mat_vert, mat_normal, mTexCoordXform, &expected[0]);
+			LLVertexXform::useSSE2(TRUE);
+			ensure("using SSE2", LLVertexXform::usingSSE2());
+			rebuild(vf, mat_vert, mat_normal, mTexCoordXform, &actual[0]);
+
+			for (S32 i = 0; i < count; i++)
+			{
+				ensure("position", close(actual[i].mPosition, expected[i].mPosition));
+				ensure("normal", close(actual[i].mNormal, expected[i].mNormal));
+				ensure("binormal", close(actual[i].mBinormal, expected[i].mBinormal));
+				ensure("tex coord", close(actual[i].mTexCoord0, expected[i].mTexCoord0));
+				ensure_equals("untouched tex coord", *(U32*)&actual[i].mTexCoord1.mV[0], GUARD);
+				ensure_equals("untouched color", actual[i].mColor, GUARD);
+				exact += !memcmp(&actual[i], &expected[i], sizeof(BufferVertex));
+				total++;
+			}
+			ensure("zero normal", count <= 6 || (actual[5].mNormal.isExactlyZero() && actual[6].mNormal.isExactlyZero()));
+			// nothing written past the end
+			ensure("past the end", !memcmp(&actual[count], &expected[count], sizeof(BufferVertex)));
+		}
+		llinfos << exact << " of " << total << " vertices bit for bit identical to the reference" << llendl;
+	}
+
+	template<> template<>
+	void vertexxform_test_object_t::test<3>()
+	{
+		// face rebuild throughput
+		const S32 NUM_FACES = 200;
+		const S32 NUM_PASSES = 20;
+
+		std::vector<LLPointer<LLVolume> > volumes;
+		std::vector<const LLVolumeFace*> faces;
+		S32 num_verts = 0;
+		for (S32 i = 0; i < NUM_FACES / 4; i++)
+		{
+			LLPointer<LLVolume> volume = new LLVolume(make_params(i), 1.f);
+			volumes.push_back(volume);
+			for (S32 f = 0; f < volume->getNumVolumeFaces() && (S32)faces.size() < NUM_FACES; f++)
+			{
+				volume->genBinormals(f);
+				faces.push_back(&volume->getVolumeFace(f));
+				num_verts += (S32)volume->getVolumeFace(f).mVertices.size();
+			}
+		}
+
+		LLMatrix4 mat_vert;
+		LLMatrix3 mat_normal;
+		make_matrices(2, mat_vert, mat_normal);
+		std::vector<BufferVertex> buffer(num_verts);
+
+		F32 times[2] = { 0.f, 0.f };
+		for (S32 sse2 = 0; sse2 < (LLVertexXform::hasSSE2() ? 2 : 1); sse2++)
+		{
+			LLVertexXform::useSSE2(sse2);
+			LLTimer timer;
+			for (S32 pass = 0; pass < NUM_PASSES; pass++)
+			{
+				BufferVertex* dst = &buffer[0];
+				for (U32 f = 0; f < faces.size(); f++)
+				{
+					rebuild(*faces[f], mat_vert, mat_normal, mTexCoordXform, dst);
+					dst += faces[f]->mVertices.size();
+				}
+			}
+			times[sse2] = timer.getElapsedTimeF32();
+		}
+
+		F32 verts = (F32)num_verts * NUM_PASSES;
+		llinfos << faces.size() << " faces, " << num_verts << " vertices, rebuilt " << NUM_PASSES << " times: scalar "
+				<< verts / llmax(times[0], 0.000001f) / 1000000.f << "M vertices/s";
+		if (times[1] > 0.f)
+		{
+			llcont << ", SSE2 " << verts / llmax(times[1], 0.000001f) / 1000000.f << "M vertices/s ("
+				   << times[0] / times[1] << "x)";
+		}
+		llcont << llendl;
+	}
+}
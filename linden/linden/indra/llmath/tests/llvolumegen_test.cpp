@@ -0,0 +1,299 @@
+/**
+ * @file llvolumegen_test.cpp
+ * @brief LLVolumeGenPool unit tests and generation benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llvolumegen.h"
+#include "../llvolumemgr.h"
+#include "../test/lltut.h"
+
+#include "lltimer.h"
+
+namespace
+{
+	const S32 NUM_SHAPES = 1000;	// times NUM_LODS volumes
+	const S32 NUM_THREADS = 4;
+	const S32 SCULPT_SIZE = 64;
+
+	// Every fourth shape is a sculpt, the rest are prims of all kinds.
+	LLVolumeParams make_params(S32 i)
+	{
+		static const U8 profiles[] = { LL_PCODE_PROFILE_SQUARE, LL_PCODE_PROFILE_CIRCLE,
+									   LL_PCODE_PROFILE_EQUALTRI, LL_PCODE_PROFILE_CIRCLE_HALF };
+		static const U8 paths[] = { LL_PCODE_PATH_LINE, LL_PCODE_PATH_CIRCLE };
+
+		LLVolumeParams params;
+		if (i % 4 == 0)
+		{
+			params.setType(LL_PCODE_PROFILE_CIRCLE, LL_PCODE_PATH_CIRCLE);
+			LLUUID id;
+			id.mData[0] = (U8)i;
+			id.mData[1] = (U8)(i >> 8);
+			id.mData[15] = 1;
+			params.setSculptID(id, LL_SCULPT_TYPE_SPHERE);
+			return params;
+		}
+		params.setType(profiles[i % 4], paths[(i / 4) % 2]);
+		params.setBeginAndEndS(0.f, 1.f - (i % 5) * 0.1f);
+		params.setBeginAndEndT(0.f, 1.f);
+		params.setHollow((i % 3) * 0.3f);
+		params.setRatio(1.f - (i % 7) * 0.1f);
+		params.setTwistEnd((i % 11) * 0.05f);
+		return params;
+	}
+
+	// A lumpy sphere, different for each shape.
+	void make_sculpt_map(S32 i, std::vector<U8>& data)
+	{
+		data.resize(SCULPT_SIZE * SCULPT_SIZE * 3);
+		for (S32 y = 0; y < SCULPT_SIZE; y++)
+		{
+			F32 v = F_PI * y / (SCULPT_SIZE - 1);
+			for (S32 x = 0; x < SCULPT_SIZE; x++)
+			{
+				F32 u = F_TWO_PI * x / SCULPT_SIZE;
+				F32 r = 0.4f + 0.1f * sinf(u * (1 + i % 5)) * sinf(v * 3);
+				U8* p = &data[(y * SCULPT_SIZE + x) * 3];
+				p[0] = (U8)llclamp((S32)(128 + 255 * r * sinf(v) * cosf(u)), 0, 255);
+				p[1] = (U8)llclamp((S32)(128 + 255 * r * sinf(v) * sinf(u)), 0, 255);
+				p[2] = (U8)llclamp((S32)(128 + 255 * r * cosf(v)), 0, 255);
+			}
+		}
+	}
+
+	LLVolume* generate(const LLVolumeParams& params, S32 detail, const std::vector<U8>& sculpt_data)
+	{
+		LLVolume* volumep = new LLVolume(params, LLVolumeLODGroup::getVolumeScaleFromDetail(detail));
+		if (params.getSculptID().notNull())
+		{
+			volumep->sculpt(SCULPT_SIZE, SCULPT_SIZE, 3, &sculpt_data[0], 0);
+		}
+		return volumep;
+	}
+
+	BOOL same_geometry(const LLVolume* a, const LLVolume* b)
+	{
+		if (a->getNumVolumeFaces() != b->getNumVolumeFaces()
+			|| a->getSculptLevel() != b->getSculptLevel())
+		{
+			return FALSE;
+		}
+		for (S32 f = 0; f < a->getNumVolumeFaces(); f++)
+		{
+			const LLVolumeFace& fa = a->getVolumeFace(f);
+			const LLVolumeFace& fb = b->getVolumeFace(f);
+			if (fa.mVertices.size() != fb.mVertices.size()
+				|| fa.mIndices != fb.mIndices)
+			{
+				return FALSE;
+			}
+			for (U32 v = 0; v < fa.mVertices.size(); v++)
+			{
+				if (fa.mVertices[v].mPosition != fb.mVertices[v].mPosition
+					|| fa.mVertices[v].mNormal != fb.mVertices[v].mNormal)
+				{
+					return FALSE;
+				}
+			}
+		}
+		return TRUE;
+	}
+}
+
+namespace tut
+{
+	struct volumegen_test
+	{
+		volumegen_test()
+		{
+			mSculptData.resize(NUM_SHAPES);
+			for (S32 i = 0; i < NUM_SHAPES; i += 4)
+			{
+				make_sculpt_map(i, mSculptData[i]);
+			}
+		}
+
+		// Makes the LOD groups exist, as the viewer's current LOD would.
+		void refAll(LLVolumeMgr& mgr, std::vector<LLVolume*>& refs)
+		{
+			for (S32 i = 0; i < NUM_SHAPES; i++)
+			{
+				refs.push_back(mgr.refVolume(make_params(i), 0));
+			}
+		}
+
+		void unrefAll(LLVolumeMgr& mgr, std::vector<LLVolume*>& refs)
+		{
+			for (S32 i = 0; i < (S32)refs.size(); i++)
+			{
+				mgr.unrefVolume(refs[i]);
+			}
+			refs.clear();
+		}
+
+		std::vector<std::vector<U8> > mSculptData;
+	};
+
+	typedef test_group<volumegen_test> volumegen_test_t;
+	typedef volumegen_test_t::object volumegen_test_object_t;
+	tut::volumegen_test_t tut_volumegen_test("volumegen_test");
+
+	template<> template<>
+	void volumegen_test_object_t::test<1>()
+	{
+		// the pool builds what the main thread would have
+		const S32 count = NUM_SHAPES * LLVolumeLODGroup::NUM_LODS;
+		std::vector<LLPointer<LLVolume> > expected;
+		expected.reserve(count);
+		LLTimer timer;
+		for (S32 i = 0; i < NUM_SHAPES; i++)
+		{
+			for (S32 detail = 0; detail < LLVolumeLODGroup::NUM_LODS; detail++)
+			{
+				expected.push_back(generate(make_params(i), detail, mSculptData[i]));
+			}
+		}
+		F32 sync_time = timer.getElapsedTimeF32();
+
+		LLVolumeMgr mgr;
+		mgr.useMutex();
+		std::vector<LLVolume*> refs;
+		refAll(mgr, refs);
+
+		LLVolumeGenPool pool(NUM_THREADS);
+		timer.reset();
+		for (S32 i = 0; i < NUM_SHAPES; i++)
+		{
+			for (S32 detail = 1; detail < LLVolumeLODGroup::NUM_LODS; detail++)
+			{
+				if (mSculptData[i].empty())
+				{
+					pool.requestLOD(make_params(i), detail);
+				}
+				else
+				{
+					pool.requestLOD(make_params(i), detail, 0, SCULPT_SIZE, SCULPT_SIZE, 3, &mSculptData[i][0]);
+				}
+			}
+		}
+		// What a frame would be held up by: queueing and installing.
+		F32 main_time = timer.getElapsedTimeF32();
+		LLTimer update_timer;
+		S32 pending = 1;
+		while (pending)
+		{
+			update_timer.reset();
+			pending = pool.update(&mgr);
+			main_time += update_timer.getElapsedTimeF32();
+			if (pending)
+			{
+				ms_sleep(1);
+			}
+		}
+		F32 async_time = timer.getElapsedTimeF32();
+
+		llinfos << count << " volumes generated in " << sync_time << "s on the main thread. LODs 1-"
+				<< LLVolumeLODGroup::NUM_LODS - 1 << " generated in " << async_time << "s on "
+				<< pool.getNumThreads() << " threads, of which the main thread spent "
+				<< main_time << "s" << llendl;
+
+		for (S32 i = 0; i < NUM_SHAPES; i++)
+		{
+			if (!mSculptData[i].empty())
+			{
+				// LOD 0 was built without its map by refAll()
+				refs[i]->sculpt(SCULPT_SIZE, SCULPT_SIZE, 3, &mSculptData[i][0], 0);
+			}
+			ensure("LOD 0 matches", same_geometry(refs[i], expected[i * LLVolumeLODGroup::NUM_LODS]));
+			for (S32 detail = 1; detail < LLVolumeLODGroup::NUM_LODS; detail++)
+			{
+				ensure("generated", mgr.hasVolume(make_params(i), detail));
+				LLPointer<LLVolume> volumep = mgr.refVolume(make_params(i), detail);
+				ensure("matches", same_geometry(volumep, expected[i * LLVolumeLODGroup::NUM_LODS + detail]));
+				mgr.unrefVolume(volumep);
+			}
+		}
+		unrefAll(mgr, refs);
+	}
+
+	template<> template<>
+	void volumegen_test_object_t::test<2>()
+	{
+		// the volume manager only takes what it has a use for
+		LLVolumeMgr mgr;
+		LLVolumeParams params = make_params(1);
+		std::vector<U8> none;
+
+		LLPointer<LLVolume> orphan = generate(params, 2, none);
+		ensure("no group, refused", !mgr.addLOD(orphan, 2));
+
+		LLPointer<LLVolume> current = mgr.refVolume(params, 0);
+		ensure("wrong detail refused", !mgr.addLOD(orphan, 1));
+		ensure("taken", mgr.addLOD(orphan, 2));
+		ensure("has it", mgr.hasVolume(params, 2));
+		ensure("LOD exists, refused", !mgr.addLOD(generate(params, 2, none), 2));
+
+		LLPointer<LLVolume> adopted = mgr.refVolume(params, 2);
+		ensure("refVolume returns it", adopted == orphan);
+		mgr.unrefVolume(adopted);
+		mgr.unrefVolume(current);
+		ensure("all released", mgr.cleanup());
+	}
+
+	template<> template<>
+	void volumegen_test_object_t::test<3>()
+	{
+		// resculpts land in the volume everybody shares
+		LLVolumeMgr mgr;
+		LLVolumeParams params = make_params(0);
+		LLPointer<LLVolume> shared = mgr.refVolume(params, 3);
+		shared->sculpt(0, 0, 0, NULL, -1);
+		ensure_equals("placeholder", shared->getSculptLevel(), -1);
+
+		LLVolumeGenPool pool(1, false);
+		pool.requestSculpt(shared, 2, SCULPT_SIZE, SCULPT_SIZE, 3, &mSculptData[4][0]);
+		// replaced before it ran, the older request is dropped
+		pool.requestSculpt(shared, 0, SCULPT_SIZE, SCULPT_SIZE, 3, &mSculptData[0][0]);
+		ensure_equals("pending", pool.getSculptPending(shared), 0);
+
+		std::vector<LLPointer<LLVolume> > sculpted;
+		ensure_equals("all done", pool.update(&mgr, &sculpted), 0);
+		ensure_equals("one sculpted", (S32)sculpted.size(), 1);
+		ensure("the shared one", sculpted[0] == shared);
+		ensure_equals("no longer pending", pool.getSculptPending(shared), -2);
+
+		LLPointer<LLVolume> expected = generate(params, 3, mSculptData[0]);
+		ensure("resculpted", same_geometry(shared, expected));
+		sculpted.clear();
+		mgr.unrefVolume(shared);
+	}
+}
@@ -43,6 +43,9 @@
 #include "lluuid.h"
 #include "message.h"
 
+#include <boost/unordered_map.hpp>
+#include <boost/unordered_set.hpp>
+
 // Constants
 static const std::string CN_WAITING("(Loading...)"); // *TODO: translate
 static const std::string CN_NOBODY("(nobody)"); // *TODO: translate
@@ -63,6 +66,13 @@ const U32 PENDING_TIMEOUT_SECS = 5 * 60;
 // File version number
 const S32 CN_FILE_VERSION = 2;
 
+// Binary snapshot header and version number
+static const char CN_BINARY_MAGIC[4] = { 'L', 'L', 'C', 'N' };
+const U32 CN_BINARY_VERSION = 1;
+
+// Default time between two batches of name requests
+const F32 CN_DEFAULT_FLUSH_INTERVAL = 0.1f;
+
 // Globals
 LLCacheName* gCacheName = NULL;
 
@@ -186,11 +196,17 @@ void ReplySender::flush()
 }
 
 
-typedef std::set<LLUUID>					AskQueue;
-typedef std::vector<PendingReply>			ReplyQueue;
-typedef std::map<LLUUID,U32>				PendingQueue;
-typedef std::map<LLUUID, LLCacheNameEntry*> Cache;
-typedef std::vector<LLCacheNameCallback>	Observers;
+// UUIDs are random, so folding the words together hashes them well enough.
+struct LLCacheNameHash
+{
+	size_t operator()(const LLUUID& id) const { return id.getCRC32(); }
+};
+
+typedef boost::unordered_set<LLUUID, LLCacheNameHash>						AskQueue;
+typedef std::vector<PendingReply>											ReplyQueue;
+typedef boost::unordered_map<LLUUID, U32, LLCacheNameHash>					PendingQueue;
+typedef boost::unordered_map<LLUUID, LLCacheNameEntry*, LLCacheNameHash>	Cache;
+typedef std::vector<LLCacheNameCallback>									Observers;
 
 class LLCacheName::Impl
 {
@@ -214,10 +230,15 @@ public:
 	Observers			mObservers;
 
 	LLFrameTimer		mProcessTimer;
+	F32					mFlushInterval;
+	U32					mFlushBatch;
 
 	Impl(LLMessageSystem* msg);
 	~Impl();
 
+	LLCacheNameEntry* getEntry(const LLUUID& id) const;
+	void addEntry(const LLUUID& id, LLCacheNameEntry* entry);
+
 	void processPendingAsks();
 	void processPendingReplies();
 	void sendRequest(const char* msg_name, const AskQueue& queue);
@@ -256,7 +277,8 @@ LLCacheName::~LLCacheName()
 }
 
 LLCacheName::Impl::Impl(LLMessageSystem* msg)
-	: mMsg(msg), mUpstreamHost(LLHost::invalid)
+	: mMsg(msg), mUpstreamHost(LLHost::invalid),
+	  mFlushInterval(CN_DEFAULT_FLUSH_INTERVAL), mFlushBatch(0)
 {
 	mMsg->setHandlerFuncFast(
 		_PREHASH_UUIDNameRequest, handleUUIDNameRequest, (void**)this);
@@ -274,6 +296,22 @@ LLCacheName::Impl::~Impl()
 	for_each(mCache.begin(), mCache.end(), DeletePairedPointer());
 }
 
+LLCacheNameEntry* LLCacheName::Impl::getEntry(const LLUUID& id) const
+{
+	Cache::const_iterator iter = mCache.find(id);
+	return iter != mCache.end() ? iter->second : NULL;
+}
+
+void LLCacheName::Impl::addEntry(const LLUUID& id, LLCacheNameEntry* entry)
+{
+	LLCacheNameEntry*& slot = mCache[id];
+	if (slot && slot != entry)
+	{
+		delete slot;
+	}
+	slot = entry;
+}
+
 
 void LLCacheName::setUpstream(const LLHost& upstream_host)
 {
@@ -389,7 +427,7 @@ void LLCacheName::importFile(LLFILE* fp)
 		entry->mCreateTime = create_time;
 		entry->mFirstName = firstname;
 		entry->mLastName = lastname;
-		impl.mCache[id] = entry;
+		impl.addEntry(id, entry);
 
 		count++;
 	}
@@ -425,7 +463,7 @@ bool LLCacheName::importFile(std::istream& istr)
 		entry->mCreateTime = ctime;
 		entry->mFirstName = agent[FIRST].asString();
 		entry->mLastName = agent[LAST].asString();
-		impl.mCache[id] = entry;
+		impl.addEntry(id, entry);
 		++count;
 	}
 	llinfos << "LLCacheName loaded " << count << " agent names" << llendl;
@@ -445,7 +483,7 @@ bool LLCacheName::importFile(std::istream& istr)
 		entry->mIsGroup = true;
 		entry->mCreateTime = ctime;
 		entry->mGroupName = group[NAME].asString();
-		impl.mCache[id] = entry;
+		impl.addEntry(id, entry);
 		++count;
 	}
 	llinfos << "LLCacheName loaded " << count << " group names" << llendl;
@@ -487,6 +525,161 @@ void LLCacheName::exportFile(std::ostream& ostr)
 	LLSDSerialize::toPrettyXML(data, ostr);
 }
 
+// The binary snapshot is a "LLCN" tag and a version, followed by a count
+// and that many records of:
+//   uuid (16 bytes), create time (U32), is group (U8),
+//   first or group name length (U8) and bytes, last name length (U8) and bytes.
+// Numbers are stored in host byte order; the cache never leaves the machine.
+
+static void write_string(std::ostream& ostr, const std::string& str)
+{
+	U8 length = (U8)llmin((S32)str.size(), 255);
+	ostr.put((char)length);
+	ostr.write(str.data(), length);
+}
+
+static bool read_string(const U8*& ptr, const U8* end, std::string& str)
+{
+	if (ptr >= end || ptr + 1 + *ptr > end)
+	{
+		return false;
+	}
+	str.assign((const char*)ptr + 1, *ptr);
+	ptr += 1 + *ptr;
+	return true;
+}
+
+bool LLCacheName::importBinary(std::istream& istr)
+{
+	// Slurp the whole file, parsing from memory is much faster than
+	// going through the stream for every field.
+	istr.seekg(0, std::ios::end);
+	std::streamoff size = istr.tellg();
+	istr.seekg(0, std::ios::beg);
+	const S32 HEADER_SIZE = sizeof(CN_BINARY_MAGIC) + 2 * sizeof(U32);
+	if (size < HEADER_SIZE)
+	{
+		return false;
+	}
+	std::vector<U8> buffer((size_t)size);
+	if (!istr.read((char*)&buffer[0], size))
+	{
+		return false;
+	}
+
+	const U8* ptr = &buffer[0];
+	const U8* end = ptr + buffer.size();
+	U32 version, count;
+	memcpy(&version, ptr + sizeof(CN_BINARY_MAGIC), sizeof(U32));		/* Flawfinder: ignore */
+	memcpy(&count, ptr + sizeof(CN_BINARY_MAGIC) + sizeof(U32), sizeof(U32));	/* Flawfinder: ignore */
+	if (memcmp(ptr, CN_BINARY_MAGIC, sizeof(CN_BINARY_MAGIC)) || version != CN_BINARY_VERSION)
+	{
+		llwarns << "Ignoring unknown binary name cache format" << llendl;
+		return false;
+	}
+	ptr += HEADER_SIZE;
+
+	// We'll expire entries more than a week old
+	U32 now = (U32)time(NULL);
+	const U32 SECS_PER_DAY = 60 * 60 * 24;
+	U32 delete_before_time = now - (7 * SECS_PER_DAY);
+
+	const S32 RECORD_SIZE = UUID_BYTES + sizeof(U32) + 1;
+	impl.mCache.rehash(impl.mCache.size() + count);
+	S32 agents = 0;
+	S32 groups = 0;
+	std::string first, last;
+	for (U32 i = 0; i < count; ++i)
+	{
+		if (ptr + RECORD_SIZE > end)
+		{
+			break;
+		}
+		LLUUID id;
+		U32 ctime;
+		memcpy(id.mData, ptr, UUID_BYTES);		/* Flawfinder: ignore */
+		memcpy(&ctime, ptr + UUID_BYTES, sizeof(U32));		/* Flawfinder: ignore */
+		bool is_group = ptr[UUID_BYTES + sizeof(U32)] != 0;
+		ptr += RECORD_SIZE;
+		if (!read_string(ptr, end, first) || !read_string(ptr, end, last))
+		{
+			break;
+		}
+		if (ctime < delete_before_time || id.isNull()) continue;
+
+		LLCacheNameEntry* entry = new LLCacheNameEntry();
+		entry->mIsGroup = is_group;
+		entry->mCreateTime = ctime;
+		if (is_group)
+		{
+			entry->mGroupName = first;
+			++groups;
+		}
+		else
+		{
+			entry->mFirstName = first;
+			entry->mLastName = last;
+			++agents;
+		}
+		impl.addEntry(id, entry);
+	}
+	if (ptr != end)
+	{
+		llwarns << "Binary name cache is truncated or corrupt" << llendl;
+	}
+
+	llinfos << "LLCacheName loaded " << agents << " agent names and "
+			<< groups << " group names" << llendl;
+	return true;
+}
+
+void LLCacheName::exportBinary(std::ostream& ostr)
+{
+	U32 count = 0;
+	ostr.write(CN_BINARY_MAGIC, sizeof(CN_BINARY_MAGIC));
+	ostr.write((const char*)&CN_BINARY_VERSION, sizeof(U32));
+	std::streampos count_pos = ostr.tellp();
+	ostr.write((const char*)&count, sizeof(U32));
+
+	for (Cache::iterator iter = impl.mCache.begin(), end = impl.mCache.end();
+		 iter != end; ++iter)
+	{
+		// Same filtering as exportFile()
+		LLCacheNameEntry* entry = iter->second;
+		if(!entry
+		   || (std::string::npos != entry->mFirstName.find('?'))
+		   || (std::string::npos != entry->mGroupName.find('?')))
+		{
+			continue;
+		}
+
+		bool is_agent = !entry->mFirstName.empty() && !entry->mLastName.empty();
+		if (!is_agent && !(entry->mIsGroup && !entry->mGroupName.empty()))
+		{
+			continue;
+		}
+
+		ostr.write((const char*)iter->first.mData, UUID_BYTES);
+		ostr.write((const char*)&entry->mCreateTime, sizeof(U32));
+		ostr.put(is_agent ? 0 : 1);
+		if (is_agent)
+		{
+			write_string(ostr, entry->mFirstName);
+			write_string(ostr, entry->mLastName);
+		}
+		else
+		{
+			write_string(ostr, entry->mGroupName);
+			write_string(ostr, LLStringUtil::null);
+		}
+		++count;
+	}
+
+	ostr.seekp(count_pos);
+	ostr.write((const char*)&count, sizeof(U32));
+	ostr.seekp(0, std::ios::end);
+}
+
 
 BOOL LLCacheName::getName(const LLUUID& id, std::string& first, std::string& last)
 {
@@ -497,7 +690,7 @@ BOOL LLCacheName::getName(const LLUUID& id, std::string& first, std::string& las
 		return FALSE;
 	}
 
-	LLCacheNameEntry* entry = get_ptr_in_map(impl.mCache, id );
+	LLCacheNameEntry* entry = impl.getEntry(id);
 	if (entry)
 	{
 		first = entry->mFirstName;
@@ -533,7 +726,7 @@ BOOL LLCacheName::getGroupName(const LLUUID& id, std::string& group)
 		return FALSE;
 	}
 
-	LLCacheNameEntry* entry = get_ptr_in_map(impl.mCache,id);
+	LLCacheNameEntry* entry = impl.getEntry(id);
 	if (entry && entry->mGroupName.empty())
 	{
 		// COUNTER-HACK to combat James' HACK in exportFile()...
@@ -569,7 +762,7 @@ void LLCacheName::get(const LLUUID& id, BOOL is_group, LLCacheNameCallback callb
 		return;
 	}
 
-	LLCacheNameEntry* entry = get_ptr_in_map(impl.mCache, id );
+	LLCacheNameEntry* entry = impl.getEntry(id);
 	if (entry)
 	{
 		// id found in map therefore we can call the callback immediately.
@@ -600,12 +793,23 @@ void LLCacheName::get(const LLUUID& id, BOOL is_group, LLCacheNameCallback callb
 	}
 }
 
+void LLCacheName::setFlushInterval(F32 secs, U32 batch_size)
+{
+	impl.mFlushInterval = llmax(secs, 0.f);
+	impl.mFlushBatch = batch_size;
+}
+
 void LLCacheName::processPending()
 {
-	const F32 SECS_BETWEEN_PROCESS = 0.1f;
-	if(!impl.mProcessTimer.checkExpirationAndReset(SECS_BETWEEN_PROCESS))
+	if(!impl.mProcessTimer.checkExpirationAndReset(impl.mFlushInterval))
 	{
-		return;
+		// Don't sit on a full batch of requests until the timer runs out.
+		if (!impl.mFlushBatch
+			|| impl.mAskNameQueue.size() + impl.mAskGroupQueue.size() < impl.mFlushBatch)
+		{
+			return;
+		}
+		impl.mProcessTimer.resetWithExpiry(impl.mFlushInterval);
 	}
 
 	if(!impl.mUpstreamHost.isOk())
@@ -709,7 +913,7 @@ void LLCacheName::Impl::processPendingReplies()
 	// First call all the callbacks, because they might send messages.
 	for(; it != end; ++it)
 	{
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, it->mID);
+		LLCacheNameEntry* entry = getEntry(it->mID);
 		if(!entry) continue;
 
 		if (it->mCallback)
@@ -732,7 +936,7 @@ void LLCacheName::Impl::processPendingReplies()
 	ReplySender sender(mMsg);
 	for (it = mReplyQueue.begin(); it != end; ++it)
 	{
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, it->mID);
+		LLCacheNameEntry* entry = getEntry(it->mID);
 		if(!entry) continue;
 
 		if (it->mHost.isOk())
@@ -831,7 +1035,7 @@ void LLCacheName::Impl::processUUIDRequest(LLMessageSystem* msg, bool isGroup)
 	{
 		LLUUID id;
 		msg->getUUIDFast(_PREHASH_UUIDNameBlock, _PREHASH_ID, id, i);
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, id);
+		LLCacheNameEntry* entry = getEntry(id);
 		if(entry)
 		{
 			if (isGroup != entry->mIsGroup)
@@ -876,11 +1080,11 @@ void LLCacheName::Impl::processUUIDReply(LLMessageSystem* msg, bool isGroup)
 	{
 		LLUUID id;
 		msg->getUUIDFast(_PREHASH_UUIDNameBlock, _PREHASH_ID, id, i);
-		LLCacheNameEntry* entry = get_ptr_in_map(mCache, id);
+		LLCacheNameEntry* entry = getEntry(id);
 		if (!entry)
 		{
 			entry = new LLCacheNameEntry;
-			mCache[id] = entry;
+			addEntry(id, entry);
 		}
 
 		mPendingQueue.erase(id);
@@ -73,6 +73,12 @@ public:
 	bool importFile(std::istream& istr);
 	void exportFile(std::ostream& ostr);
 
+	// Compact binary snapshot of the cache, much quicker to load than the
+	// LLSD one. Returns false if the stream isn't a snapshot we understand.
+	// The streams must be opened in binary mode.
+	bool importBinary(std::istream& istr);
+	void exportBinary(std::ostream& ostr);
+
 	// If available, copies the first and last name into the strings provided.
 	// first must be at least DB_FIRST_NAME_BUF_SIZE characters.
 	// last must be at least DB_LAST_NAME_BUF_SIZE characters.
@@ -97,6 +103,10 @@ public:
 	void getName(const LLUUID& id, LLCacheNameCallback callback, void* user_data = NULL)
 			{ get(id, FALSE, callback, user_data); }
 
+	// Requests are batched and sent out at most every "secs" seconds,
+	// or as soon as "batch_size" of them are queued (0 means no limit).
+	void setFlushInterval(F32 secs, U32 batch_size = 0);
+
 	// This method needs to be called from time to time to send out
 	// requests.
 	void processPending();
@@ -0,0 +1,266 @@
+/**
+ * @file llmessagecapture.cpp
+ * @brief Binary capture of the raw message stream, for offline replay.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llmessagecapture.h"
+
+#include "llerror.h"
+#include "lltimer.h"
+#include "timing.h"
+
+static const char CAPTURE_MAGIC[4] = { 'L', 'L', 'M', 'C' };
+const U32 CAPTURE_VERSION = 1;
+
+//---------------------------------------------------------------------------
+// LLMessageCaptureWriter
+//---------------------------------------------------------------------------
+
+LLMessageCaptureWriter::LLMessageCaptureWriter(const std::string& filename, U32 ring_size)
+:	LLThread("Message capture"),
+	mOpen(FALSE),
+	mMask(0),
+	mHead(0),
+	mTail(0),
+	mFailed(0),
+	mStartTime(totalTime()),
+	mNumWritten(0),
+	mNumDropped(0)
+{
+	U32 size = 1;
+	while (size < ring_size)
+	{
+		size <<= 1;
+	}
+	mRing.resize(size);
+	mMask = size - 1;
+
+	if (mFile.open(filename, LL_APR_WB, LLAPRFile::global) != APR_SUCCESS)
+	{
+		llwarns << "Unable to open message capture " << filename << llendl;
+		return;
+	}
+
+	LLMessageCaptureHeader header;
+	memcpy(header.mMagic, CAPTURE_MAGIC, sizeof(header.mMagic));		/* Flawfinder: ignore */
+	header.mVersion = CAPTURE_VERSION;
+	header.mStartTime = mStartTime;
+	if (mFile.write(&header, sizeof(header)) != (S32)sizeof(header))
+	{
+		llwarns << "Unable to write message capture " << filename << llendl;
+		mFile.close();
+		return;
+	}
+
+	mOpen = TRUE;
+	start();
+}
+
+LLMessageCaptureWriter::~LLMessageCaptureWriter()
+{
+	close();
+}
+
+void LLMessageCaptureWriter::write(const LLHost& from, const LLHost& to, const U8* data, S32 size, BOOL incoming)
+{
+	if (!mOpen || mFailed || size <= 0 || size > 0xffff)
+	{
+		return;
+	}
+
+	U32 head = mHead;
+	U32 tail = mTail;
+	U32 total = sizeof(LLMessageCaptureRecord) + size;
+	if (total > mRing.size() - (head - tail))
+	{
+		// The writer thread fell behind.
+		mNumDropped++;
+		return;
+	}
+
+	LLMessageCaptureRecord record;
+	record.mTime = totalTime() - mStartTime;
+	record.mFromIP = from.getAddress();
+	record.mToIP = to.getAddress();
+	record.mFromPort = (U16)from.getPort();
+	record.mToPort = (U16)to.getPort();
+	record.mSize = (U16)size;
+	record.mFlags = incoming ? LLMessageCaptureRecord::INCOMING : 0;
+	copyToRing(head, &record, sizeof(record));
+	copyToRing(head + sizeof(record), data, size);
+
+	// Publishing the new head hands the record over to the writer thread.
+	mHead = head + total;
+	mNumWritten++;
+}
+
+void LLMessageCaptureWriter::copyToRing(U32 pos, const void* src, U32 size)
+{
+	pos &= mMask;
+	U32 first = llmin(size, (U32)mRing.size() - pos);
+	memcpy(&mRing[pos], src, first);		/* Flawfinder: ignore */
+	if (first < size)
+	{
+		memcpy(&mRing[0], (const U8*)src + first, size - first);		/* Flawfinder: ignore */
+	}
+}
+
+BOOL LLMessageCaptureWriter::drain()
+{
+	U32 head = mHead;
+	U32 tail = mTail;
+	if (head == tail || mFailed)
+	{
+		return FALSE;
+	}
+
+	U32 pos = tail & mMask;
+	U32 avail = head - tail;
+	U32 first = llmin(avail, (U32)mRing.size() - pos);
+	S32 written = mFile.write(&mRing[pos], first);
+	if (written == (S32)first && first < avail)
+	{
+		written += mFile.write(&mRing[0], avail - first);
+	}
+	if (written != (S32)avail)
+	{
+		// Likely the disk filled up. A record cut short leaves the rest of
+		// the file unreadable, so there's no point writing any more.
+		llwarns << "Unable to write message capture, capture stopped" << llendl;
+		mFailed = 1;
+		return FALSE;
+	}
+
+	// Hands the space back to write().
+	mTail = head;
+	return TRUE;
+}
+
+void LLMessageCaptureWriter::run()
+{
+	while (!isQuitting() && !mFailed)
+	{
+		if (!drain())
+		{
+			ms_sleep(10);
+		}
+	}
+	drain();
+}
+
+BOOL LLMessageCaptureWriter::close()
+{
+	if (!mOpen)
+	{
+		return TRUE;
+	}
+
+	// The writer might be stuck on a disk that went away, in which case it
+	// still has the ring and the file.
+	if (!stopAndWait(5000))
+	{
+		llwarns << "Message capture writer didn't stop, capture left open" << llendl;
+		return FALSE;
+	}
+	mOpen = FALSE;
+	mFile.close();
+
+	llinfos << "Message capture closed, " << mNumWritten << " packets written, "
+			<< mNumDropped << " dropped" << llendl;
+	return TRUE;
+}
+
+//---------------------------------------------------------------------------
+// LLMessageCaptureReader
+//---------------------------------------------------------------------------
+
+LLMessageCaptureReader::LLMessageCaptureReader()
+:	mPos(0)
+{
+}
+
+BOOL LLMessageCaptureReader::open(const std::string& filename)
+{
+	mBuffer.clear();
+	mPos = 0;
+
+	LLAPRFile infile;
+	S32 size = 0;
+	if (infile.open(filename, LL_APR_RB, LLAPRFile::global, &size) != APR_SUCCESS
+		|| size < (S32)sizeof(LLMessageCaptureHeader))
+	{
+		llwarns << "Unable to open message capture " << filename << llendl;
+		return FALSE;
+	}
+	mBuffer.resize(size);
+	if (infile.read(&mBuffer[0], size) != size)
+	{
+		llwarns << "Unable to read message capture " << filename << llendl;
+		mBuffer.clear();
+		return FALSE;
+	}
+
+	LLMessageCaptureHeader header;
+	memcpy(&header, &mBuffer[0], sizeof(header));		/* Flawfinder: ignore */
+	if (memcmp(header.mMagic, CAPTURE_MAGIC, sizeof(header.mMagic))
+		|| header.mVersion != CAPTURE_VERSION)
+	{
+		llwarns << filename << " is not a message capture we understand" << llendl;
+		mBuffer.clear();
+		return FALSE;
+	}
+
+	rewind();
+	return TRUE;
+}
+
+BOOL LLMessageCaptureReader::next(LLMessageCaptureRecord& record, const U8*& data)
+{
+	if (mPos + sizeof(LLMessageCaptureRecord) > mBuffer.size())
+	{
+		return FALSE;
+	}
+	memcpy(&record, &mBuffer[mPos], sizeof(record));		/* Flawfinder: ignore */
+	if (mPos + sizeof(record) + record.mSize > mBuffer.size())
+	{
+		// Truncated, the viewer probably didn't exit cleanly.
+		return FALSE;
+	}
+	data = &mBuffer[mPos + sizeof(record)];
+	mPos += sizeof(record) + record.mSize;
+	return TRUE;
+}
+
+void LLMessageCaptureReader::rewind()
+{
+	mPos = mBuffer.empty() ? 0 : sizeof(LLMessageCaptureHeader);
+}
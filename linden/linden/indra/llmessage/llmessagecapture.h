@@ -0,0 +1,139 @@
+/**
+ * @file llmessagecapture.h
+ * @brief Binary capture of the raw message stream, for offline replay.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#ifndef LL_LLMESSAGECAPTURE_H
+#define LL_LLMESSAGECAPTURE_H
+
+#include "llapr.h"
+#include "llhost.h"
+#include "llthread.h"
+
+// A capture file is an LLMessageCaptureHeader followed by records, each
+// an LLMessageCaptureRecord and mSize bytes of packet data exactly as it
+// went over the wire (zero coded, with any appended acks).
+struct LLMessageCaptureHeader
+{
+	char	mMagic[4];		// "LLMC"
+	U32		mVersion;
+	U64		mStartTime;		// totalTime() when the capture was started
+};
+
+struct LLMessageCaptureRecord
+{
+	enum
+	{
+		INCOMING = 1		// received by us, as opposed to sent
+	};
+
+	U64		mTime;			// usec since the start of the capture
+	U32		mFromIP;
+	U32		mToIP;
+	U16		mFromPort;
+	U16		mToPort;
+	U16		mSize;
+	U16		mFlags;
+
+	LLHost getFrom() const	{ return LLHost(mFromIP, mFromPort); }
+	LLHost getTo() const	{ return LLHost(mToIP, mToPort); }
+	BOOL isIncoming() const	{ return (mFlags & INCOMING) != 0; }
+};
+
+// Writes a capture file from a background thread.
+//
+// write() only copies the packet into a ring buffer and never blocks or
+// takes a lock, so it is cheap enough to call for every packet. It must
+// always be called from the same thread (the one running the message
+// system). If the disk can't keep up the ring fills and packets are
+// dropped rather than stalling that thread.
+class LLMessageCaptureWriter : public LLThread
+{
+public:
+	static const U32 DEFAULT_RING_SIZE = 4 * 1024 * 1024;
+
+	// ring_size is rounded up to a power of two.
+	LLMessageCaptureWriter(const std::string& filename, U32 ring_size = DEFAULT_RING_SIZE);
+	~LLMessageCaptureWriter();
+
+	BOOL isOpen() const		{ return mOpen; }
+
+	void write(const LLHost& from, const LLHost& to, const U8* data, S32 size, BOOL incoming);
+
+	// Writes out what is left in the ring and stops the thread. Returns
+	// FALSE if the thread wouldn't stop, in which case it may still use
+	// the writer: try again later, or leak it, but don't delete it.
+	BOOL close();
+
+	U32 getNumWritten() const	{ return mNumWritten; }
+	U32 getNumDropped() const	{ return mNumDropped; }
+
+protected:
+	/*virtual*/ void run();
+
+private:
+	void copyToRing(U32 pos, const void* src, U32 size);
+	// Writes everything between the tail and the head. Returns FALSE if
+	// there was nothing to write, or it couldn't be written.
+	BOOL drain();
+
+	LLAPRFile			mFile;
+	BOOL				mOpen;
+	std::vector<U8>		mRing;
+	U32					mMask;
+	LLAtomicU32			mHead;			// only moved by write()
+	LLAtomicU32			mTail;			// only moved by the writer thread
+	LLAtomicU32			mFailed;		// set by the writer thread when the file can't be written
+	U64					mStartTime;
+	U32					mNumWritten;
+	U32					mNumDropped;
+};
+
+// Reads a capture file back.
+class LLMessageCaptureReader
+{
+public:
+	LLMessageCaptureReader();
+
+	// Loads the whole file. Returns FALSE if it can't be read or isn't
+	// a capture.
+	BOOL open(const std::string& filename);
+
+	// Returns the next record and points data at its packet, or FALSE at
+	// the end of the capture.
+	BOOL next(LLMessageCaptureRecord& record, const U8*& data);
+	void rewind();
+
+private:
+	std::vector<U8>		mBuffer;
+	size_t				mPos;
+};
+
+#endif
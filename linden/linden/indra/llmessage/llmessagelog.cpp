@@ -1,5 +1,7 @@
 // <edit>
+#include "linden_common.h"
 #include "llmessagelog.h"
+#include "llmessagecapture.h"
 
 LLMessageLogEntry::LLMessageLogEntry(EType type, LLHost from_host, LLHost to_host, U8* data, S32 data_size)
 :	mType(type),
@@ -27,6 +29,7 @@ LLMessageLogEntry::~LLMessageLogEntry()
 U32 LLMessageLog::sMaxSize = 4096; // testzone fixme todo boom
 std::deque<LLMessageLogEntry> LLMessageLog::sDeque;
 void (*(LLMessageLog::sCallback))(LLMessageLogEntry);
+LLMessageCaptureWriter* LLMessageLog::sCapture = NULL;
 void LLMessageLog::setMaxSize(U32 size)
 {
 	sMaxSize = size;
@@ -39,6 +42,11 @@ void LLMessageLog::setCallback(void (*callback)(LLMessageLogEntry))
 }
 void LLMessageLog::log(LLHost from_host, LLHost to_host, U8* data, S32 data_size)
 {
+	if(sCapture && data)
+	{
+		// 127.0.0.1 stands in for ourselves
+		sCapture->write(from_host, to_host, data, data_size, from_host.getAddress() != 16777343);
+	}
 	LLMessageLogEntry entry = LLMessageLogEntry(LLMessageLogEntry::TEMPLATE, from_host, to_host, data, data_size);
 	if(!entry.mDataSize || !entry.mData.size()) return;
 	if(sCallback) sCallback(entry);
@@ -51,4 +59,27 @@ std::deque<LLMessageLogEntry> LLMessageLog::getDeque()
 {
 	return sDeque;
 }
+void LLMessageLog::startCapture(const std::string& filename)
+{
+	stopCapture();
+	sCapture = new LLMessageCaptureWriter(filename);
+	if(!sCapture->isOpen())
+	{
+		delete sCapture;
+		sCapture = NULL;
+	}
+}
+void LLMessageLog::stopCapture()
+{
+	if(sCapture && !sCapture->close())
+	{
+		// Its thread still has hold of it, so it can't be deleted.
+		llwarns << "Leaking the message capture writer" << llendl;
+	}
+	else
+	{
+		delete sCapture;
+	}
+	sCapture = NULL;
+}
 // </edit>
@@ -7,6 +7,7 @@
 #include <string.h>
 
 class LLMessageSystem;
+class LLMessageCaptureWriter;
 class LLMessageLogEntry
 {
 public:
@@ -32,7 +33,11 @@ public:
 	static void setCallback(void (*callback)(LLMessageLogEntry));
 	static void log(LLHost from_host, LLHost to_host, U8* data, S32 data_size);
 	static std::deque<LLMessageLogEntry> getDeque();
+	// Also write every packet to a capture file, see llmessagecapture.h
+	static void startCapture(const std::string& filename);
+	static void stopCapture();
 private:
+	static LLMessageCaptureWriter* sCapture;
 	static U32 sMaxSize;
 	static void (*sCallback)(LLMessageLogEntry);
 	static std::deque<LLMessageLogEntry> sDeque;
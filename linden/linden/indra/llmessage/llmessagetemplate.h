@@ -291,6 +291,7 @@ public:
 		mTotalDecoded(0),
 		mTotalDecodeTime(0.f),
 		mMaxDecodeTimePerMsg(0.f),
+		mTotalUnpackTime(0.f),
 		mBanFromTrusted(false),
 		mBanFromUntrusted(false),
 		mHandlerFunc(NULL), 
@@ -416,6 +417,7 @@ public:
 	U32										mTotalDecoded;		// Total messages successfully decoded
 	F32										mTotalDecodeTime;	// Total time successfully decoding messages
 	F32										mMaxDecodeTimePerMsg;
+	F32										mTotalUnpackTime;	// Total time unpacking blocks, before the handler is called
 
 	bool									mBanFromTrusted;
 	bool									mBanFromUntrusted;
@@ -64,7 +64,8 @@ LLPacketRing::LLPacketRing () :
 	mInBufferLength(0),
 	mOutBufferLength(0),
 	mDropPercentage(0.0f),
-	mPacketsToDrop(0x0)
+	mPacketsToDrop(0x0),
+	mReplayMode(FALSE)
 {
 }
 
@@ -92,6 +93,13 @@ void LLPacketRing::cleanup ()
 		delete packetp;
 		mSendQueue.pop();
 	}
+
+	while (!mReplayQueue.empty())
+	{
+		packetp = mReplayQueue.front();
+		delete packetp;
+		mReplayQueue.pop();
+	}
 }
 
 ///////////////////////////////////////////////////////////
@@ -162,11 +170,33 @@ S32 LLPacketRing::receiveFromRing (S32 socket, char *datap)
 	return packet_size;
 }
 
+///////////////////////////////////////////////////////////
+void LLPacketRing::injectPacket(const LLHost& sender, const char* datap, S32 size)
+{
+	mReplayQueue.push(new LLPacketBuffer(sender, datap, size));
+}
+
 ///////////////////////////////////////////////////////////
 S32 LLPacketRing::receivePacket (S32 socket, char *datap)
 {
 	S32 packet_size = 0;
 
+	if (mReplayMode)
+	{
+		if (mReplayQueue.empty())
+		{
+			return 0;
+		}
+		LLPacketBuffer *packetp = mReplayQueue.front();
+		mReplayQueue.pop();
+		packet_size = packetp->getSize();
+		memcpy(datap, packetp->getData(), packet_size);	/*Flawfinder: ignore*/
+		mLastSender = packetp->getHost();
+		mLastReceivingIF = LLHost::invalid;
+		delete packetp;
+		return packet_size;
+	}
+
 	// If using the throttle, simulate a limited size input buffer.
 	if (mUseInThrottle)
 	{
@@ -277,6 +307,12 @@ BOOL LLPacketRing::sendPacket(int h_socket, char * send_buffer, S32 buf_size, LL
 	//<edit>
 	LLMessageLog::log(LLHost(16777343, gMessageSystem->getListenPort()), host, (U8*)send_buffer, buf_size);
 	//</edit>
+	if (mReplayMode)
+	{
+		// Never answer the hosts in a capture.
+		return TRUE;
+	}
+
 	BOOL status = TRUE;
 	if (!mUseOutThrottle)
 	{
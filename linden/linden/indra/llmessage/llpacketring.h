@@ -61,6 +61,12 @@ public:
 
 	BOOL sendPacket(int h_socket, char * send_buffer, S32 buf_size, LLHost host);
 
+	// In replay mode the socket is left alone: only packets handed to
+	// injectPacket() are received and everything sent is discarded.
+	void setReplayMode(const BOOL replay)		{ mReplayMode = replay; }
+	BOOL getReplayMode() const					{ return mReplayMode; }
+	void injectPacket(const LLHost& sender, const char* datap, S32 size);
+
 	inline LLHost getLastSender();
 	inline LLHost getLastReceivingInterface();
 
@@ -86,6 +92,9 @@ protected:
 	std::queue<LLPacketBuffer *> mReceiveQueue;
 	std::queue<LLPacketBuffer *> mSendQueue;
 
+	BOOL mReplayMode;
+	std::queue<LLPacketBuffer *> mReplayQueue;
+
 	LLHost mLastSender;
 	LLHost mLastReceivingIF;
 
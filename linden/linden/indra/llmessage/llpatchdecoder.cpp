@@ -0,0 +1,263 @@
+/**
+ * @file llpatchdecoder.cpp
+ * @brief Batched, vectorized decompression of layer patches.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "llpatchdecoder.h"
+
+#include "llfasttimer.h"
+#include "llmath.h"
+
+// patch_idct.cpp
+extern F32 gPatchDequantizeTable[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+extern F32 gPatchICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+extern S32 gDeCopyMatrix[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+
+LLPatchDecoder::decompress_func_t LLPatchDecoder::sDecompress = &LLPatchDecoder::decompressScalar;
+
+LLPatchDecoder::LLPatchDecoder(S32 patch_size)
+	: mTables(getTables(patch_size))
+{
+}
+
+// static
+const LLPatchDecoder::Tables* LLPatchDecoder::getTables(S32 size)
+{
+	static Tables tables[2];	// all zero to start with
+
+	if (size != NORMAL_PATCH_SIZE && size != LARGE_PATCH_SIZE)
+	{
+		llerrs << "Bad patch size " << size << llendl;
+	}
+	Tables& sized_tables = tables[size == LARGE_PATCH_SIZE];
+	if (!sized_tables.mSize)
+	{
+		// Copied rather than rebuilt, so that they are sure to be the same.
+		// Callers of decompress_patch() always set its tables up first.
+		init_patch_decompressor(size);
+		memcpy(sized_tables.mDequantize, gPatchDequantizeTable, sizeof(gPatchDequantizeTable));
+		memcpy(sized_tables.mICosines, gPatchICosines, sizeof(gPatchICosines));
+		memcpy(sized_tables.mDeCopy, gDeCopyMatrix, sizeof(gDeCopyMatrix));
+		sized_tables.mSize = size;
+	}
+	return &sized_tables;
+}
+
+S32 LLPatchDecoder::addPatch(const LLPatchHeader& header, const S32* coefficients, void* user_data)
+{
+	S32 count = mTables->mSize * mTables->mSize;
+	mHeaders.push_back(header);
+	mUserData.push_back(user_data);
+	mCoefficients.insert(mCoefficients.end(), coefficients, coefficients + count);
+	return getNumPatches() - 1;
+}
+
+static LLFastTimer::DeclareTimer FTM_PATCH_DECOMPRESS("Patch Decompression");
+
+void LLPatchDecoder::decompress()
+{
+	LLFastTimer t(FTM_PATCH_DECOMPRESS);
+
+	S32 count = mTables->mSize * mTables->mSize;
+	mPatches.resize(mHeaders.size() * count);
+	for (S32 i = 0; i < getNumPatches(); i++)
+	{
+		sDecompress(*mTables, mHeaders[i], &mCoefficients[i * count], &mPatches[i * count]);
+	}
+}
+
+void LLPatchDecoder::copyPatch(S32 i, F32* dest, S32 stride) const
+{
+	S32 size = mTables->mSize;
+	const F32* patch = getPatch(i);
+	for (S32 j = 0; j < size; j++)
+	{
+		memcpy(dest + j * stride, patch + j * size, size * sizeof(F32));
+	}
+}
+
+// static
+void LLPatchDecoder::useSSE2(BOOL use_sse2)
+{
+	sDecompress = (use_sse2 && hasSSE2()) ? &decompressSSE2 : &decompressScalar;
+}
+
+// static
+void LLPatchDecoder::getDequantization(const LLPatchHeader& header, F32& mult, F32& addval)
+{
+	F32 range = header.range;
+	S32 prequant = (header.quant_wbits >> 4) + 2;
+	S32 quantize = 1<<prequant;
+	F32 ooq = 1.f/(F32)quantize;
+
+	mult = ooq*range;
+	addval = mult*(F32)(1<<(prequant - 1))+header.dc_offset;
+}
+
+// Sized at compile time, as idct_patch() and idct_patch_large() are.
+template <S32 SIZE>
+inline void idct_patch_scalar(const LLPatchDecoder::Tables& tables, const LLPatchHeader& header,
+							  const S32* coefficients, F32* patch)
+{
+	const F32* icosines = tables.mICosines;
+	F32 block[SIZE*SIZE];
+	F32 temp[SIZE*SIZE];
+
+	for (S32 i = 0; i < SIZE*SIZE; i++)
+	{
+		block[i] = coefficients[tables.mDeCopy[i]]*tables.mDequantize[i];
+	}
+
+	// Columns, then rows, summed in the order idct_column() and idct_line()
+	// sum them.
+	for (S32 column = 0; column < SIZE; column++)
+	{
+		for (S32 n = 0; n < SIZE; n++)
+		{
+			F32 total = OO_SQRT2*block[column];
+			for (S32 u = 1; u < SIZE; u++)
+			{
+				total += block[u*SIZE + column]*icosines[u*SIZE + n];
+			}
+			temp[n*SIZE + column] = total;
+		}
+	}
+
+	F32 oosob = 2.f/SIZE;
+	F32 mult, addval;
+	LLPatchDecoder::getDequantization(header, mult, addval);
+	for (S32 line = 0; line < SIZE; line++)
+	{
+		const F32* linein = temp + line*SIZE;
+		for (S32 n = 0; n < SIZE; n++)
+		{
+			F32 total = OO_SQRT2*linein[0];
+			for (S32 u = 1; u < SIZE; u++)
+			{
+				total += linein[u]*icosines[u*SIZE + n];
+			}
+			F32 height = total*oosob;
+			patch[line*SIZE + n] = height*mult+addval;
+		}
+	}
+}
+
+// static
+void LLPatchDecoder::decompressScalar(const Tables& tables, const LLPatchHeader& header,
+									  const S32* coefficients, F32* patch)
+{
+	if (tables.mSize == LARGE_PATCH_SIZE)
+	{
+		idct_patch_scalar<LARGE_PATCH_SIZE>(tables, header, coefficients, patch);
+	}
+	else
+	{
+		idct_patch_scalar<NORMAL_PATCH_SIZE>(tables, header, coefficients, patch);
+	}
+}
+
+//----------------------------------------------------------------------------
+
+LLPatchDecoderThread::LLPatchDecoderThread(bool threaded)
+	: LLQueuedThread("patchdecoder", threaded)
+{
+}
+
+// MAIN THREAD
+LLPatchDecoderThread::handle_t LLPatchDecoderThread::decompress(LLPatchDecoder* decoder, U32 priority)
+{
+	handle_t handle = generateHandle();
+	DecompressRequest* req = new DecompressRequest(handle, priority, decoder);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLPatchDecoderThread::shutdown()" << llendl;
+	}
+	return handle;
+}
+
+// MAIN THREAD
+BOOL LLPatchDecoderThread::getResult(handle_t handle, LLPatchDecoder*& decoder)
+{
+	decoder = NULL;
+	status_t status = getRequestStatus(handle);
+	if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+	{
+		return FALSE;
+	}
+	DecompressRequest* req = (DecompressRequest*)getRequest(handle);
+	if (req)
+	{
+		decoder = req->takeDecoder();
+		if (status != STATUS_COMPLETE)
+		{
+			delete decoder;
+			decoder = NULL;
+		}
+		completeRequest(handle);
+	}
+	return TRUE;
+}
+
+//----------------------------------------------------------------------------
+
+LLPatchDecoderThread::DecompressRequest::DecompressRequest(handle_t handle, U32 priority,
+														   LLPatchDecoder* decoder)
+	: LLQueuedThread::QueuedRequest(handle, priority, 0),
+	  mDecoder(decoder)
+{
+}
+
+LLPatchDecoderThread::DecompressRequest::~DecompressRequest()
+{
+	delete mDecoder;
+}
+
+bool LLPatchDecoderThread::DecompressRequest::processRequest()
+{
+	mDecoder->decompress();
+	return true;
+}
+
+void LLPatchDecoderThread::DecompressRequest::finishRequest(bool completed)
+{
+	// Collected by LLPatchDecoderThread::getResult()
+}
+
+// MAIN THREAD
+LLPatchDecoder* LLPatchDecoderThread::DecompressRequest::takeDecoder()
+{
+	LLPatchDecoder* decoder = mDecoder;
+	mDecoder = NULL;
+	return decoder;
+}
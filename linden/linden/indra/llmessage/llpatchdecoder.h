@@ -0,0 +1,157 @@
+/**
+ * @file llpatchdecoder.h
+ * @brief Batched, vectorized decompression of layer patches.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLPATCHDECODER_H
+#define LL_LLPATCHDECODER_H
+
+#include <vector>
+
+#include "llqueuedthread.h"
+#include "patch_dct.h"
+
+// Dequantizes and inverse transforms the layer patches decode_patch()
+// unpacks, as decompress_patch() does, a batch at a time. It keeps none of
+// decompress_patch()'s global state, so a batch can be decompressed on any
+// thread.
+//
+// The inverse DCT is separable, a pass down the columns of a patch and one
+// along its rows. The SSE2 version runs both on four columns at a time, in
+// the same order of operations as decompress_patch(), which keeps the
+// heights it comes up with bit for bit the same.
+class LLPatchDecoder
+{
+public:
+	// patch_size is that of the group header, NORMAL_PATCH_SIZE or
+	// LARGE_PATCH_SIZE.
+	LLPatchDecoder(S32 patch_size);
+
+	S32 getPatchSize() const						{ return mTables->mSize; }
+
+	// Adds a patch, with the coefficients decode_patch() unpacked for it.
+	// Returns its index in the batch.
+	S32 addPatch(const LLPatchHeader& header, const S32* coefficients, void* user_data = NULL);
+
+	S32 getNumPatches() const						{ return (S32)mHeaders.size(); }
+	const LLPatchHeader& getHeader(S32 i) const		{ return mHeaders[i]; }
+	void* getUserData(S32 i) const					{ return mUserData[i]; }
+
+	// Decompresses every patch added. Safe on any thread, as long as
+	// nothing else uses the decoder meanwhile.
+	void decompress();
+
+	// Patch i, patch size rows of patch size heights.
+	const F32* getPatch(S32 i) const				{ return &mPatches[i * mTables->mSize * mTables->mSize]; }
+	// Writes patch i where decompress_patch() would have, with rows stride
+	// heights apart.
+	void copyPatch(S32 i, F32* dest, S32 stride) const;
+
+	// The tables decompress_patch() sets up with init_patch_decompressor().
+	struct Tables
+	{
+		S32 mSize;
+		F32 mDequantize[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		F32 mICosines[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+		S32 mDeCopy[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
+	};
+
+	// Decompresses one patch into size * size heights.
+	//
+	// As with LLVertexXform, sDecompress is the one to call, and the SSE2
+	// version gives exactly the same results as the scalar one.
+	typedef void (*decompress_func_t)(const Tables& tables, const LLPatchHeader& header,
+									  const S32* coefficients, F32* patch);
+
+	static decompress_func_t sDecompress;
+
+	// Falls back to the scalar version if this build has no SSE2 version.
+	// Don't turn SSE2 on for CPUs that lack it.
+	static void useSSE2(BOOL use_sse2);
+	static BOOL usingSSE2()							{ return sDecompress == &decompressSSE2; }
+	// Whether the SSE2 version was compiled in.
+	static BOOL hasSSE2();
+
+	static void decompressScalar(const Tables& tables, const LLPatchHeader& header,
+								 const S32* coefficients, F32* patch);
+	// llpatchdecoder_sse2.cpp
+	static void decompressSSE2(const Tables& tables, const LLPatchHeader& header,
+							   const S32* coefficients, F32* patch);
+
+	// The scale and offset decompress_patch() applies to the inverse DCT.
+	static void getDequantization(const LLPatchHeader& header, F32& mult, F32& addval);
+
+private:
+	// Built on the main thread, the first time a decoder of the size is.
+	static const Tables* getTables(S32 size);
+
+	const Tables* mTables;
+	std::vector<LLPatchHeader> mHeaders;
+	std::vector<void*> mUserData;
+	std::vector<S32> mCoefficients;
+	std::vector<F32> mPatches;
+};
+
+// Runs LLPatchDecoders on a thread of its own.
+class LLPatchDecoderThread : public LLQueuedThread
+{
+public:
+	class DecompressRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~DecompressRequest(); // use deleteRequest()
+
+	public:
+		// Takes ownership of decoder.
+		DecompressRequest(handle_t handle, U32 priority, LLPatchDecoder* decoder);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		LLPatchDecoder* takeDecoder();
+
+	private:
+		LLPatchDecoder* mDecoder;
+	};
+
+public:
+	LLPatchDecoderThread(bool threaded = true);
+
+	// Takes ownership of decoder, and decompresses its patches.
+	handle_t decompress(LLPatchDecoder* decoder, U32 priority = PRIORITY_NORMAL);
+
+	// Returns FALSE while the request is still being worked on. Otherwise
+	// ends the request and hands back its decoder, with the patches
+	// decompressed, or NULL if it was aborted.
+	BOOL getResult(handle_t handle, LLPatchDecoder*& decoder);
+};
+
+#endif // LL_LLPATCHDECODER_H
@@ -0,0 +1,165 @@
+/**
+ * @file llpatchdecoder_sse2.cpp
+ * @brief SSE2 version of the LLPatchDecoder kernel.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+// Visual Studio required settings for this file:
+// Precompiled Headers OFF
+// Code Generation: SSE2
+
+#include "linden_common.h"
+
+#include "llpatchdecoder.h"
+
+#include "llmath.h"
+#include "llv4math.h"		// for LL_VECTORIZE
+
+#if LL_VECTORIZE && (defined(__SSE2__) || _M_IX86_FP >= 2 || defined(_M_X64))
+
+#include <emmintrin.h>
+
+// Sized at compile time. Each pass keeps four sums of four lanes going at
+// once, so that their chains of dependent adds overlap.
+template <S32 SIZE>
+inline void idct_patch_sse2(const LLPatchDecoder::Tables& tables, const LLPatchHeader& header,
+							const S32* coefficients, F32* patch)
+{
+	const F32* icosines = tables.mICosines;
+	F32 block[SIZE*SIZE];
+	F32 temp[SIZE*SIZE];
+
+	// Gathered through the zigzag one at a time, converted four at a time.
+	for (S32 i = 0; i < SIZE*SIZE; i += 4)
+	{
+		const S32* decopy = tables.mDeCopy + i;
+		__m128i c = _mm_setr_epi32(coefficients[decopy[0]], coefficients[decopy[1]],
+								   coefficients[decopy[2]], coefficients[decopy[3]]);
+		_mm_storeu_ps(block + i, _mm_mul_ps(_mm_cvtepi32_ps(c), _mm_loadu_ps(tables.mDequantize + i)));
+	}
+
+	// Columns, four at a time, for four outputs n at a time. Each sum is
+	// added up in the same order as decompressScalar() does it.
+	const __m128 oo_sqrt2 = _mm_set1_ps(OO_SQRT2);
+	for (S32 column = 0; column < SIZE; column += 4)
+	{
+		const __m128 first = _mm_mul_ps(oo_sqrt2, _mm_loadu_ps(block + column));
+		for (S32 n = 0; n < SIZE; n += 4)
+		{
+			__m128 t0 = first, t1 = first, t2 = first, t3 = first;
+			for (S32 u = 1; u < SIZE; u++)
+			{
+				__m128 c = _mm_loadu_ps(block + u*SIZE + column);
+				__m128 icosine = _mm_loadu_ps(icosines + u*SIZE + n);
+				t0 = _mm_add_ps(t0, _mm_mul_ps(c, _mm_shuffle_ps(icosine, icosine, 0x00)));
+				t1 = _mm_add_ps(t1, _mm_mul_ps(c, _mm_shuffle_ps(icosine, icosine, 0x55)));
+				t2 = _mm_add_ps(t2, _mm_mul_ps(c, _mm_shuffle_ps(icosine, icosine, 0xaa)));
+				t3 = _mm_add_ps(t3, _mm_mul_ps(c, _mm_shuffle_ps(icosine, icosine, 0xff)));
+			}
+			_mm_storeu_ps(temp + n*SIZE + column, t0);
+			_mm_storeu_ps(temp + (n + 1)*SIZE + column, t1);
+			_mm_storeu_ps(temp + (n + 2)*SIZE + column, t2);
+			_mm_storeu_ps(temp + (n + 3)*SIZE + column, t3);
+		}
+	}
+
+	// Rows, four lines at a time, for four heights n at a time.
+	F32 mult, addval;
+	LLPatchDecoder::getDequantization(header, mult, addval);
+	const __m128 oosob = _mm_set1_ps(2.f/SIZE);
+	const __m128 mult4 = _mm_set1_ps(mult);
+	const __m128 addval4 = _mm_set1_ps(addval);
+	for (S32 line = 0; line < SIZE; line += 4)
+	{
+		const F32* l0 = temp + line*SIZE;
+		const F32* l1 = l0 + SIZE;
+		const F32* l2 = l1 + SIZE;
+		const F32* l3 = l2 + SIZE;
+		for (S32 n = 0; n < SIZE; n += 4)
+		{
+			__m128 t0 = _mm_set1_ps(OO_SQRT2*l0[0]);
+			__m128 t1 = _mm_set1_ps(OO_SQRT2*l1[0]);
+			__m128 t2 = _mm_set1_ps(OO_SQRT2*l2[0]);
+			__m128 t3 = _mm_set1_ps(OO_SQRT2*l3[0]);
+			for (S32 u = 1; u < SIZE; u++)
+			{
+				__m128 icosine = _mm_loadu_ps(icosines + u*SIZE + n);
+				t0 = _mm_add_ps(t0, _mm_mul_ps(_mm_set1_ps(l0[u]), icosine));
+				t1 = _mm_add_ps(t1, _mm_mul_ps(_mm_set1_ps(l1[u]), icosine));
+				t2 = _mm_add_ps(t2, _mm_mul_ps(_mm_set1_ps(l2[u]), icosine));
+				t3 = _mm_add_ps(t3, _mm_mul_ps(_mm_set1_ps(l3[u]), icosine));
+			}
+			F32* out = patch + line*SIZE + n;
+			_mm_storeu_ps(out, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(t0, oosob), mult4), addval4));
+			_mm_storeu_ps(out + SIZE, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(t1, oosob), mult4), addval4));
+			_mm_storeu_ps(out + 2*SIZE, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(t2, oosob), mult4), addval4));
+			_mm_storeu_ps(out + 3*SIZE, _mm_add_ps(_mm_mul_ps(_mm_mul_ps(t3, oosob), mult4), addval4));
+		}
+	}
+}
+
+// static
+BOOL LLPatchDecoder::hasSSE2()
+{
+	return TRUE;
+}
+
+// static
+void LLPatchDecoder::decompressSSE2(const Tables& tables, const LLPatchHeader& header,
+									const S32* coefficients, F32* patch)
+{
+	if (tables.mSize == LARGE_PATCH_SIZE)
+	{
+		idct_patch_sse2<LARGE_PATCH_SIZE>(tables, header, coefficients, patch);
+	}
+	else
+	{
+		idct_patch_sse2<NORMAL_PATCH_SIZE>(tables, header, coefficients, patch);
+	}
+}
+
+#else
+
+// static
+BOOL LLPatchDecoder::hasSSE2()
+{
+	return FALSE;
+}
+
+// static
+void LLPatchDecoder::decompressSSE2(const Tables& tables, const LLPatchHeader& header,
+									const S32* coefficients, F32* patch)
+{
+	decompressScalar(tables, header, coefficients, patch);
+}
+
+#endif
@@ -557,6 +557,12 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 		mCurrentRMessageData = 0;
 	}
 
+	static LLTimer unpack_timer;
+	if (LLMessageReader::getTimeDecodes())
+	{
+		unpack_timer.reset();
+	}
+
 	// The offset tells us how may bytes to skip after the end of the
 	// message name.
 	U8 offset = buffer[PHL_OFFSET];
@@ -733,6 +739,11 @@ BOOL LLTemplateMessageReader::decodeData(const U8* buffer, const LLHost& sender,
 	{
 		static LLTimer decode_timer;
 
+		if (LLMessageReader::getTimeDecodes())
+		{
+			mCurrentRMessageTemplate->mTotalUnpackTime += unpack_timer.getElapsedTimeF32();
+		}
+
 		if(LLMessageReader::getTimeDecodes() || gMessageSystem->getTimingCallback())
 		{
 			decode_timer.reset();
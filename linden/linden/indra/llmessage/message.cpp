@@ -553,17 +553,16 @@ BOOL LLMessageSystem::checkMessages( S64 frame_count, bool faked_message, U8 fak
 		mTrueReceiveSize = mPacketRing.receivePacket(mSocket, (char *)mTrueReceiveBuffer.buffer);
 		// If you want to dump all received packets into SecondLife.log, uncomment this
 		//dumpPacketToLog();
- 		// <edit>
- 		if(mTrueReceiveSize && receive_size > (S32) LL_MINIMUM_VALID_PACKET_SIZE)
- 		{
- 			LLMessageLog::log(mLastSender, LLHost(16777343, mPort), buffer, mTrueReceiveSize);
- 		}
- 		// </edit>
-
 		
 		receive_size = mTrueReceiveSize;
 		mLastSender = mPacketRing.getLastSender();
 		mLastReceivingIF = mPacketRing.getLastReceivingInterface();
+ 		// <edit>
+ 		if(receive_size >= (S32) LL_MINIMUM_VALID_PACKET_SIZE)
+ 		{
+ 			LLMessageLog::log(mLastSender, LLHost(16777343, mPort), buffer, receive_size);
+ 		}
+ 		// </edit>
 		
 		if (receive_size < (S32) LL_MINIMUM_VALID_PACKET_SIZE)
 		{
@@ -2674,7 +2673,7 @@ void LLMessageSystem::summarizeLogs(std::ostream& str)
 	str << buffer << std::endl << std::endl;
 
 	str << "Decoding: " << std::endl;
-	buffer = llformat( "%35s%10s%10s%10s%10s", "Message", "Count", "Time", "Max", "Avg");
+	buffer = llformat( "%35s%10s%10s%10s%10s%10s", "Message", "Count", "Unpack", "Time", "Max", "Avg");
 	str << buffer << std:: endl;	
 	F32 avg;
 	for (message_template_name_map_t::const_iterator iter = mMessageTemplates.begin(),
@@ -2685,7 +2684,7 @@ void LLMessageSystem::summarizeLogs(std::ostream& str)
 		if(mt->mTotalDecoded > 0)
 		{
 			avg = mt->mTotalDecodeTime / (F32)mt->mTotalDecoded;
-			buffer = llformat( "%35s%10u%10f%10f%10f", mt->mName, mt->mTotalDecoded, mt->mTotalDecodeTime, mt->mMaxDecodeTimePerMsg, avg);
+			buffer = llformat( "%35s%10u%10f%10f%10f%10f", mt->mName, mt->mTotalDecoded, mt->mTotalUnpackTime, mt->mTotalDecodeTime, mt->mMaxDecodeTimePerMsg, avg);
 			str << buffer << std::endl;
 		}
 	}
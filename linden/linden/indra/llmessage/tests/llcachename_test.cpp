@@ -0,0 +1,285 @@
+/**
+ * @file llcachename_test.cpp
+ * @brief LLCacheName unit tests and load time benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "llcachename.h"
+#include "../test/lltut.h"
+
+#include "llhost.cpp" // LLHost is a value type for test purposes.
+#include "net.cpp" // Needed by LLHost.
+
+#include "llframetimer.h"
+#include "lltimer.h"
+#include "message.h"
+
+// Only the names LLCacheName uses.
+char* _PREHASH_UUIDNameRequest = (char*)"UUIDNameRequest";
+char* _PREHASH_UUIDNameReply = (char*)"UUIDNameReply";
+char* _PREHASH_UUIDGroupNameRequest = (char*)"UUIDGroupNameRequest";
+char* _PREHASH_UUIDGroupNameReply = (char*)"UUIDGroupNameReply";
+char* _PREHASH_UUIDNameBlock = (char*)"UUIDNameBlock";
+char* _PREHASH_ID = (char*)"ID";
+char* _PREHASH_FirstName = (char*)"FirstName";
+char* _PREHASH_LastName = (char*)"LastName";
+char* _PREHASH_GroupName = (char*)"GroupName";
+
+// The message system stub records what gets sent and plays back
+// replyBlocks to the handlers.
+struct ReplyBlock
+{
+	LLUUID mID;
+	std::string mFirst;
+	std::string mLast;
+};
+
+std::map<std::string, void (*)(LLMessageSystem*, void**)> handlers;
+void** handlerData = NULL;
+std::vector<ReplyBlock> replyBlocks;
+S32 messagesSent = 0;
+S32 blocksSent = 0;
+
+void LLMessageSystem::setHandlerFuncFast(const char *name, void (*handler_func)(LLMessageSystem *msgsystem, void **user_data), void **user_data)
+{
+	handlers[name] = handler_func;
+	handlerData = user_data;
+}
+
+void LLMessageSystem::newMessageFast(const char *name)
+{
+}
+
+void LLMessageSystem::nextBlockFast(const char *blockname)
+{
+	++blocksSent;
+}
+
+void LLMessageSystem::addUUIDFast(const char *varname, const LLUUID& uuid)
+{
+}
+
+void LLMessageSystem::addStringFast(const char* varname, const std::string& s)
+{
+}
+
+BOOL LLMessageSystem::isSendFullFast(const char* blockname)
+{
+	return FALSE;
+}
+
+S32 LLMessageSystem::sendReliable(const LLHost &host)
+{
+	++messagesSent;
+	return 0;
+}
+
+const LLHost& LLMessageSystem::getSender() const
+{
+	return LLHost::invalid;
+}
+
+S32 LLMessageSystem::getNumberOfBlocksFast(const char *blockname) const
+{
+	return replyBlocks.size();
+}
+
+void LLMessageSystem::getUUIDFast(const char *block, const char *var, LLUUID &uuid, S32 blocknum)
+{
+	uuid = replyBlocks[blocknum].mID;
+}
+
+void LLMessageSystem::getStringFast(const char *block, const char *var, std::string& outstr, S32 blocknum)
+{
+	outstr = (var == _PREHASH_LastName) ? replyBlocks[blocknum].mLast : replyBlocks[blocknum].mFirst;
+}
+
+namespace tut
+{
+	struct LLCacheNameData
+	{
+		LLCacheNameData()
+		:	mCache(NULL, LLHost(0x7f000001, 12035))
+		{
+			messagesSent = 0;
+			blocksSent = 0;
+			replyBlocks.clear();
+			LLFrameTimer::updateFrameTime();
+		}
+
+		// Feeds count agent names through the reply handler.
+		void reply(S32 count)
+		{
+			replyBlocks.resize(count);
+			for (S32 i = 0; i < count; ++i)
+			{
+				std::ostringstream first;
+				first << "Resident" << i;
+				replyBlocks[i].mID.generate();
+				replyBlocks[i].mFirst = first.str();
+				replyBlocks[i].mLast = "Linden";
+			}
+			handlers[_PREHASH_UUIDNameReply](NULL, handlerData);
+		}
+
+		void ensureNames(const char* msg, LLCacheName& cache)
+		{
+			std::string first, last;
+			for (std::vector<ReplyBlock>::iterator iter = replyBlocks.begin();
+				 iter != replyBlocks.end(); ++iter)
+			{
+				ensure(msg, cache.getName(iter->mID, first, last));
+				ensure_equals(msg, first, iter->mFirst);
+				ensure_equals(msg, last, iter->mLast);
+			}
+		}
+
+		LLCacheName mCache;
+	};
+
+	typedef test_group<LLCacheNameData> factory;
+	typedef factory::object object;
+}
+
+namespace
+{
+	tut::factory tf("LLCacheName test");
+}
+
+namespace tut
+{
+	template<> template<>
+	void object::test<1>()
+	{
+		// replies land in the cache
+		reply(10);
+		ensureNames("reply cached", mCache);
+
+		LLUUID unknown;
+		unknown.generate();
+		std::string first, last;
+		ensure("miss", !mCache.getName(unknown, first, last));
+		ensure_equals("waiting", first, LLCacheName::getDefaultName());
+	}
+
+	template<> template<>
+	void object::test<2>()
+	{
+		// requests wait for the flush interval, unless a full batch is queued
+		mCache.setFlushInterval(1000.f, 10);
+		std::string first, last;
+		LLUUID id;
+		id.generate();
+		mCache.getName(id, first, last);
+		mCache.processPending();
+		ensure_equals("first batch sent", messagesSent, 1);
+
+		for (S32 i = 0; i < 9; ++i)
+		{
+			id.generate();
+			mCache.getName(id, first, last);
+		}
+		mCache.processPending();
+		ensure_equals("partial batch held back", messagesSent, 1);
+
+		id.generate();
+		mCache.getName(id, first, last);
+		mCache.processPending();
+		ensure_equals("full batch sent", messagesSent, 2);
+		ensure_equals("all requested", blocksSent, 11);
+
+		// asking again while the request is in flight is a no-op
+		mCache.getName(id, first, last);
+		mCache.setFlushInterval(1000.f, 1);
+		mCache.processPending();
+		ensure_equals("no duplicate request", blocksSent, 11);
+	}
+
+	template<> template<>
+	void object::test<3>()
+	{
+		// binary snapshot round trip, timed against the LLSD cache
+		const S32 COUNT = 100000;
+		reply(COUNT);
+
+		std::stringstream llsd_stream;
+		mCache.exportFile(llsd_stream);
+		std::stringstream binary_stream;
+		LLTimer timer;
+		mCache.exportBinary(binary_stream);
+		F32 save_time = timer.getElapsedTimeF32();
+
+		LLCacheName llsd_cache(NULL);
+		timer.reset();
+		ensure("LLSD loaded", llsd_cache.importFile(llsd_stream));
+		F32 llsd_time = timer.getElapsedTimeF32();
+
+		LLCacheName binary_cache(NULL);
+		timer.reset();
+		ensure("binary loaded", binary_cache.importBinary(binary_stream));
+		F32 binary_time = timer.getElapsedTimeF32();
+
+		timer.reset();
+		ensureNames("binary round trip", binary_cache);
+		F32 query_time = timer.getElapsedTimeF32();
+
+		llinfos << COUNT << " names: binary saved in " << save_time
+				<< "s, loaded in " << binary_time << "s (LLSD " << llsd_time
+				<< "s), queried in " << query_time << "s" << llendl;
+	}
+
+	template<> template<>
+	void object::test<4>()
+	{
+		// foreign and damaged snapshots
+		std::stringstream llsd_stream;
+		reply(3);
+		mCache.exportFile(llsd_stream);
+		LLCacheName cache(NULL);
+		ensure("not a snapshot", !cache.importBinary(llsd_stream));
+
+		std::stringstream binary_stream;
+		mCache.exportBinary(binary_stream);
+		std::string data = binary_stream.str();
+		std::stringstream truncated(data.substr(0, data.size() - 4));
+		ensure("truncated still loads", cache.importBinary(truncated));
+		S32 found = 0;
+		std::string first, last;
+		for (S32 i = 0; i < 3; ++i)
+		{
+			if (cache.getName(replyBlocks[i].mID, first, last))
+			{
+				++found;
+			}
+		}
+		ensure_equals("intact records kept", found, 2);
+	}
+}
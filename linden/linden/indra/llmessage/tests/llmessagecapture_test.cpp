@@ -0,0 +1,211 @@
+/**
+ * @file llmessagecapture_test.cpp
+ * @brief LLMessageCaptureWriter and LLMessageCaptureReader unit tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include "../llmessagecapture.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	const LLHost SIM_HOST(0x0a000001, 13000);
+	const LLHost SELF_HOST(0x7f000001, 12035);
+
+	S32 packet_size(S32 i)
+	{
+		return 20 + (i * 53) % 1200;
+	}
+
+	void fill_packet(U8* buffer, S32 i)
+	{
+		for (S32 j = 0; j < packet_size(i); ++j)
+		{
+			buffer[j] = (U8)(i * 31 + j);
+		}
+	}
+}
+
+namespace tut
+{
+	struct messagecapture_test
+	{
+		messagecapture_test()
+		{
+			std::ostringstream oStr;
+			oStr << "/tmp/llmessagecapture-test-" << ll_rand() << ".llmc";
+			mFilename = oStr.str();
+		}
+
+		~messagecapture_test()
+		{
+			LLAPRFile::remove(mFilename);
+		}
+
+		// Writes count packets, waiting for the writer thread whenever
+		// the ring is full so that none are dropped.
+		void write_all(LLMessageCaptureWriter& writer, S32 count)
+		{
+			U8 buffer[2048];
+			for (S32 i = 0; i < count; ++i)
+			{
+				fill_packet(buffer, i);
+				BOOL incoming = (i % 3 != 0);
+				while (TRUE)
+				{
+					U32 dropped = writer.getNumDropped();
+					writer.write(incoming ? SIM_HOST : SELF_HOST, incoming ? SELF_HOST : SIM_HOST,
+								 buffer, packet_size(i), incoming);
+					if (writer.getNumDropped() == dropped)
+					{
+						break;
+					}
+					ms_sleep(1);
+				}
+			}
+		}
+
+		void ensure_all(S32 count)
+		{
+			LLMessageCaptureReader reader;
+			ensure("opened", reader.open(mFilename));
+
+			LLMessageCaptureRecord record;
+			const U8* data = NULL;
+			U8 expected[2048];
+			U64 last_time = 0;
+			for (S32 i = 0; i < count; ++i)
+			{
+				ensure("record present", reader.next(record, data));
+				ensure_equals("size", (S32)record.mSize, packet_size(i));
+				fill_packet(expected, i);
+				ensure("data", !memcmp(data, expected, packet_size(i)));
+				ensure_equals("direction", record.isIncoming(), (BOOL)(i % 3 != 0));
+				ensure("sender", record.getFrom() == (record.isIncoming() ? SIM_HOST : SELF_HOST));
+				ensure("time ordered", record.mTime >= last_time);
+				last_time = record.mTime;
+			}
+			ensure("no more records", !reader.next(record, data));
+		}
+
+		std::string mFilename;
+	};
+
+	typedef test_group<messagecapture_test> messagecapture_test_t;
+	typedef messagecapture_test_t::object messagecapture_test_object_t;
+	tut::messagecapture_test_t tut_messagecapture_test("messagecapture_test");
+
+	template<> template<>
+	void messagecapture_test_object_t::test<1>()
+	{
+		// round trip
+		const S32 COUNT = 10000;
+		LLTimer timer;
+		{
+			LLMessageCaptureWriter writer(mFilename);
+			ensure("open", writer.isOpen());
+			write_all(writer, COUNT);
+			llinfos << "Captured " << COUNT << " packets in " << timer.getElapsedTimeF32()
+					<< " seconds" << llendl;
+			ensure("closed", writer.close());
+			ensure("closing again", writer.close());
+			ensure_equals("written", writer.getNumWritten(), (U32)COUNT);
+		}
+		ensure_all(COUNT);
+	}
+
+	template<> template<>
+	void messagecapture_test_object_t::test<2>()
+	{
+		// records wrap around a small ring
+		{
+			LLMessageCaptureWriter writer(mFilename, 4000);
+			write_all(writer, 200);
+		}
+		ensure_all(200);
+	}
+
+	template<> template<>
+	void messagecapture_test_object_t::test<3>()
+	{
+		// packets that can't fit are dropped, not written half way
+		{
+			LLMessageCaptureWriter writer(mFilename, 64);
+			U8 buffer[100];
+			memset(buffer, 0, sizeof(buffer));
+			writer.write(SIM_HOST, SELF_HOST, buffer, sizeof(buffer), TRUE);
+			ensure_equals("dropped", writer.getNumDropped(), (U32)1);
+			ensure_equals("none written", writer.getNumWritten(), (U32)0);
+		}
+		LLMessageCaptureReader reader;
+		ensure("opened", reader.open(mFilename));
+		LLMessageCaptureRecord record;
+		const U8* data = NULL;
+		ensure("empty", !reader.next(record, data));
+	}
+
+	template<> template<>
+	void messagecapture_test_object_t::test<4>()
+	{
+		// foreign and truncated files
+		LLAPRFile outfile;
+		outfile.open(mFilename, LL_APR_WB, LLAPRFile::global);
+		outfile.write((void*)"not a capture file", 18);
+		outfile.close();
+		LLMessageCaptureReader reader;
+		ensure("foreign file rejected", !reader.open(mFilename));
+
+		{
+			LLMessageCaptureWriter writer(mFilename);
+			write_all(writer, 3);
+		}
+		S32 size = 0;
+		std::vector<U8> buffer;
+		LLAPRFile infile;
+		infile.open(mFilename, LL_APR_RB, LLAPRFile::global, &size);
+		buffer.resize(size);
+		infile.read(&buffer[0], size);
+		infile.close();
+		outfile.open(mFilename, LL_APR_WB, LLAPRFile::global);
+		outfile.write(&buffer[0], size - 1);
+		outfile.close();
+
+		ensure("opened", reader.open(mFilename));
+		LLMessageCaptureRecord record;
+		const U8* data = NULL;
+		ensure("first", reader.next(record, data));
+		ensure("second", reader.next(record, data));
+		ensure("truncated third", !reader.next(record, data));
+	}
+}
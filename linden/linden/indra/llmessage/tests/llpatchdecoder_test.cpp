@@ -0,0 +1,313 @@
+/**
+ * @file llpatchdecoder_test.cpp
+ * @brief LLPatchDecoder unit tests and region benchmark
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+
+#include "linden_common.h"
+
+#include "../llpatchdecoder.h"
+#include "../test/lltut.h"
+
+#include "llmath.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	const S32 REGION_WIDTH = 256;
+
+	// Coefficients as decode_patch() would unpack them, with most of the
+	// high frequency ones zero.
+	void random_coefficients(S32 size, S32* coefficients)
+	{
+		for (S32 i = 0; i < size * size; i++)
+		{
+			coefficients[i] = (i < 3 * size || !ll_rand(8)) ? ll_rand(2048) - 1024 : 0;
+		}
+	}
+
+	void random_header(LLPatchHeader& header)
+	{
+		header.dc_offset = ll_frand(100.f) - 20.f;
+		header.range = (U16)(ll_rand(200) + 1);
+		S32 prequant = ll_rand(6) + 8;
+		header.quant_wbits = (U8)(((prequant - 2) << 4) | (prequant - 2));
+		header.patchids = 0;
+	}
+
+	// Rolling hills, compressed the way the simulator sends them.
+	void compress_region(std::vector<LLPatchHeader>& headers, std::vector<S32>& coefficients)
+	{
+		const S32 size = NORMAL_PATCH_SIZE;
+		const S32 patches_per_edge = REGION_WIDTH / size;
+		std::vector<F32> heights(REGION_WIDTH * REGION_WIDTH);
+		for (S32 y = 0; y < REGION_WIDTH; y++)
+		{
+			for (S32 x = 0; x < REGION_WIDTH; x++)
+			{
+				heights[y * REGION_WIDTH + x] = 20.f + 15.f * sinf(x * 0.05f) * cosf(y * 0.07f)
+												+ 3.f * sinf((x + y) * 0.3f) + ll_frand(0.5f);
+			}
+		}
+
+		init_patch_compressor(size, REGION_WIDTH, 0);
+		headers.resize(patches_per_edge * patches_per_edge);
+		coefficients.resize(patches_per_edge * patches_per_edge * size * size);
+		for (S32 j = 0; j < patches_per_edge; j++)
+		{
+			for (S32 i = 0; i < patches_per_edge; i++)
+			{
+				S32 patch = j * patches_per_edge + i;
+				F32* patch_heights = &heights[j * size * REGION_WIDTH + i * size];
+				LLPatchHeader& header = headers[patch];
+				F32 zmax, zmin;
+				prescan_patch(patch_heights, &header, zmax, zmin);
+				compress_patch(patch_heights, &coefficients[patch * size * size], &header, 10);
+				header.patchids = (i << 5) | j;
+			}
+		}
+	}
+
+	// decompress_patch(), into patch size rows of patch size heights.
+	void reference_patch(S32 size, const LLPatchHeader& header, S32* coefficients, F32* patch)
+	{
+		LLGroupHeader group_header;
+		group_header.stride = size;
+		group_header.patch_size = size;
+		group_header.layer_type = 0;
+		set_group_of_patch_header(&group_header);
+		init_patch_decompressor(size);
+		LLPatchHeader ph = header;
+		decompress_patch(patch, coefficients, &ph);
+		set_group_of_patch_header(NULL);
+	}
+}
+
+namespace tut
+{
+	struct patchdecoder_test
+	{
+		~patchdecoder_test()
+		{
+			LLPatchDecoder::useSSE2(FALSE);
+		}
+	};
+
+	typedef test_group<patchdecoder_test> patchdecoder_test_t;
+	typedef patchdecoder_test_t::object patchdecoder_test_object_t;
+	tut::patchdecoder_test_t tut_patchdecoder_test("patchdecoder_test");
+
+	template<> template<>
+	void patchdecoder_test_object_t::test<1>()
+	{
+		// both kernels give decompress_patch()'s heights, bit for bit, for
+		// either patch size
+		const S32 NUM_PATCHES = 20;
+		const S32 sizes[] = { NORMAL_PATCH_SIZE, LARGE_PATCH_SIZE };
+
+		for (S32 s = 0; s < 2; s++)
+		{
+			S32 size = sizes[s];
+			std::vector<S32> coefficients(NUM_PATCHES * size * size);
+			std::vector<F32> expected(NUM_PATCHES * size * size);
+			std::vector<LLPatchHeader> headers(NUM_PATCHES);
+			for (S32 i = 0; i < NUM_PATCHES; i++)
+			{
+				random_header(headers[i]);
+				random_coefficients(size, &coefficients[i * size * size]);
+				reference_patch(size, headers[i], &coefficients[i * size * size], &expected[i * size * size]);
+			}
+
+			for (S32 use_sse2 = 0; use_sse2 < (LLPatchDecoder::hasSSE2() ? 2 : 1); use_sse2++)
+			{
+				LLPatchDecoder::useSSE2(use_sse2);
+				LLPatchDecoder decoder(size);
+				ensure_equals("patch size", decoder.getPatchSize(), size);
+				for (S32 i = 0; i < NUM_PATCHES; i++)
+				{
+					ensure_equals("index", decoder.addPatch(headers[i], &coefficients[i * size * size], &headers[i]), i);
+				}
+				decoder.decompress();
+				ensure_equals("patch count", decoder.getNumPatches(), NUM_PATCHES);
+				for (S32 i = 0; i < NUM_PATCHES; i++)
+				{
+					ensure("user data", decoder.getUserData(i) == &headers[i]);
+					ensure(llformat("size %d, SSE2 %d, patch %d matches decompress_patch()", size, use_sse2, i),
+						   !memcmp(decoder.getPatch(i), &expected[i * size * size], size * size * sizeof(F32)));
+				}
+			}
+		}
+	}
+
+	template<> template<>
+	void patchdecoder_test_object_t::test<2>()
+	{
+		// a region compressed by compress_patch() comes back the same as
+		// decompress_patch() gives it, and close to what was compressed
+		std::vector<LLPatchHeader> headers;
+		std::vector<S32> coefficients;
+		compress_region(headers, coefficients);
+
+		const S32 size = NORMAL_PATCH_SIZE;
+		LLGroupHeader group_header;
+		group_header.stride = REGION_WIDTH;
+		group_header.patch_size = size;
+		group_header.layer_type = 0;
+		set_group_of_patch_header(&group_header);
+		init_patch_decompressor(size);
+		std::vector<F32> expected(REGION_WIDTH * REGION_WIDTH);
+		for (S32 patch = 0; patch < (S32)headers.size(); patch++)
+		{
+			S32 i = headers[patch].patchids >> 5;
+			S32 j = headers[patch].patchids & 0x1f;
+			decompress_patch(&expected[j * size * REGION_WIDTH + i * size], &coefficients[patch * size * size], &headers[patch]);
+		}
+		set_group_of_patch_header(NULL);
+
+		for (S32 use_sse2 = 0; use_sse2 < (LLPatchDecoder::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLPatchDecoder::useSSE2(use_sse2);
+			LLPatchDecoder decoder(size);
+			for (S32 patch = 0; patch < (S32)headers.size(); patch++)
+			{
+				decoder.addPatch(headers[patch], &coefficients[patch * size * size]);
+			}
+			decoder.decompress();
+
+			std::vector<F32> region(REGION_WIDTH * REGION_WIDTH);
+			for (S32 patch = 0; patch < decoder.getNumPatches(); patch++)
+			{
+				S32 i = decoder.getHeader(patch).patchids >> 5;
+				S32 j = decoder.getHeader(patch).patchids & 0x1f;
+				decoder.copyPatch(patch, &region[j * size * REGION_WIDTH + i * size], REGION_WIDTH);
+			}
+			ensure(llformat("SSE2 %d region matches decompress_patch()", use_sse2),
+				   !memcmp(&region[0], &expected[0], REGION_WIDTH * REGION_WIDTH * sizeof(F32)));
+			for (S32 i = 0; i < REGION_WIDTH * REGION_WIDTH; i++)
+			{
+				// a sensible terrain height at all
+				ensure("height in range", region[i] > -10.f && region[i] < 50.f);
+			}
+		}
+	}
+
+	template<> template<>
+	void patchdecoder_test_object_t::test<3>()
+	{
+		// batches decompressed on a thread come out the same as on this one,
+		// and how long a region takes
+		const S32 NUM_REGIONS = 20;
+		const S32 size = NORMAL_PATCH_SIZE;
+		std::vector<LLPatchHeader> headers;
+		std::vector<S32> coefficients;
+		compress_region(headers, coefficients);
+		const S32 num_patches = (S32)headers.size();
+
+		// decompress_patch(), a patch at a time
+		LLGroupHeader group_header;
+		group_header.stride = size;
+		group_header.patch_size = size;
+		group_header.layer_type = 0;
+		set_group_of_patch_header(&group_header);
+		init_patch_decompressor(size);
+		std::vector<F32> expected(num_patches * size * size);
+		LLTimer timer;
+		for (S32 r = 0; r < NUM_REGIONS; r++)
+		{
+			for (S32 patch = 0; patch < num_patches; patch++)
+			{
+				decompress_patch(&expected[patch * size * size], &coefficients[patch * size * size], &headers[patch]);
+			}
+		}
+		F32 original_time = timer.getElapsedTimeF32();
+		set_group_of_patch_header(NULL);
+
+		F32 times[2] = { 0.f, 0.f };
+		for (S32 use_sse2 = 0; use_sse2 < (LLPatchDecoder::hasSSE2() ? 2 : 1); use_sse2++)
+		{
+			LLPatchDecoder::useSSE2(use_sse2);
+			timer.reset();
+			for (S32 r = 0; r < NUM_REGIONS; r++)
+			{
+				LLPatchDecoder decoder(size);
+				for (S32 patch = 0; patch < num_patches; patch++)
+				{
+					decoder.addPatch(headers[patch], &coefficients[patch * size * size]);
+				}
+				decoder.decompress();
+				if (r == 0)
+				{
+					ensure("batch matches decompress_patch()",
+						   !memcmp(decoder.getPatch(0), &expected[0], expected.size() * sizeof(F32)));
+				}
+			}
+			times[use_sse2] = timer.getElapsedTimeF32();
+		}
+
+		LLPatchDecoderThread thread;
+		timer.reset();
+		std::vector<LLQueuedThread::handle_t> handles;
+		for (S32 r = 0; r < NUM_REGIONS; r++)
+		{
+			LLPatchDecoder* decoder = new LLPatchDecoder(size);
+			for (S32 patch = 0; patch < num_patches; patch++)
+			{
+				decoder->addPatch(headers[patch], &coefficients[patch * size * size]);
+			}
+			handles.push_back(thread.decompress(decoder));
+		}
+		for (S32 r = 0; r < NUM_REGIONS; r++)
+		{
+			LLPatchDecoder* decoder = NULL;
+			while (!thread.getResult(handles[r], decoder))
+			{
+				thread.update(0);
+				ms_sleep(1);
+			}
+			ensure("decompressed", decoder != NULL);
+			ensure("threaded batch matches",
+				   !memcmp(decoder->getPatch(0), &expected[0], expected.size() * sizeof(F32)));
+			delete decoder;
+		}
+		F32 threaded_time = timer.getElapsedTimeF32();
+
+		llinfos << "Region of " << num_patches << " patches: decompress_patch() "
+				<< original_time * 1000.f / NUM_REGIONS << "ms, batched scalar "
+				<< times[0] * 1000.f / NUM_REGIONS << "ms";
+		if (times[1] > 0.f)
+		{
+			llcont << ", SSE2 " << times[1] * 1000.f / NUM_REGIONS << "ms";
+		}
+		llcont << ", on a thread " << threaded_time * 1000.f / NUM_REGIONS << "ms" << llendl;
+	}
+}
@@ -0,0 +1,91 @@
+/**
+ * @file llbatchlayout.cpp
+ * @brief Remembers how a group of faces was batched, to tell when it still holds
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llbatchlayout.h"
+
+LLBatchLayout::LLBatchLayout()
+:	mContext(0),
+	mNext(0),
+	mValid(FALSE)
+{
+}
+
+void LLBatchLayout::clear()
+{
+	mFaces.clear();
+	mNext = 0;
+	mValid = FALSE;
+}
+
+void LLBatchLayout::beginRecord()
+{
+	clear();
+}
+
+void LLBatchLayout::record(const void* face, const Key& key)
+{
+	Face entry;
+	entry.mFace = face;
+	entry.mKey = key;
+	mFaces.push_back(entry);
+}
+
+void LLBatchLayout::endRecord(U32 context)
+{
+	mContext = context;
+	mValid = TRUE;
+}
+
+BOOL LLBatchLayout::beginCheck(U32 context)
+{
+	mNext = 0;
+	return mValid && context == mContext;
+}
+
+BOOL LLBatchLayout::check(const void* face, const Key& key)
+{
+	if (!mValid || mNext >= mFaces.size())
+	{
+		return FALSE;
+	}
+
+	const Face& entry = mFaces[mNext++];
+	return entry.mFace == face && entry.mKey == key;
+}
+
+BOOL LLBatchLayout::endCheck() const
+{
+	return mValid && mNext == mFaces.size();
+}
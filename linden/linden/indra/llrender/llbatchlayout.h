@@ -0,0 +1,105 @@
+/**
+ * @file llbatchlayout.h
+ * @brief Remembers how a group of faces was batched, to tell when it still holds
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLBATCHLAYOUT_H
+#define LL_LLBATCHLAYOUT_H
+
+#include <vector>
+
+// What the faces of a group were batched by at its last full rebuild: for
+// each face, in the order a rebuild visits them, a key of everything that
+// decided which vertex buffer and draw info it went in, and where. A later
+// rebuild that meets the same faces with the same keys, under the same
+// context, can write the changed faces' geometry where it already is and
+// keep the buffers and draw info as they are.
+class LLBatchLayout
+{
+public:
+	struct Key
+	{
+		Key()
+		:	mTexture(NULL), mFlags(0), mState(0), mGeomCount(0), mIndicesCount(0)
+		{ }
+
+		bool operator==(const Key& rhs) const
+		{
+			return mTexture == rhs.mTexture &&
+				mFlags == rhs.mFlags &&
+				mState == rhs.mState &&
+				mGeomCount == rhs.mGeomCount &&
+				mIndicesCount == rhs.mIndicesCount;
+		}
+		bool operator!=(const Key& rhs) const	{ return !(*this == rhs); }
+
+		const void* mTexture;	// texture the face is drawn with
+		U32 mFlags;				// whatever else breaks batches, as bits
+		U32 mState;				// and as values
+		U32 mGeomCount;
+		U32 mIndicesCount;
+	};
+
+	LLBatchLayout();
+
+	// Forgets the layout, so that the next rebuild must be a full one.
+	void clear();
+	BOOL isValid() const					{ return mValid; }
+	S32 getNumFaces() const					{ return (S32) mFaces.size(); }
+
+	// During a full rebuild: starts a new layout, records each face as it is
+	// visited, and makes the layout valid once all are.
+	void beginRecord();
+	void record(const void* face, const Key& key);
+	void endRecord(U32 context);
+
+	// During an incremental rebuild: checks each face as it is visited
+	// against the layout, in the same order. Returns FALSE as soon as
+	// anything differs, after which the rebuild must be a full one.
+	BOOL beginCheck(U32 context);
+	BOOL check(const void* face, const Key& key);
+	// Whether every face of the layout was met
+	BOOL endCheck() const;
+
+private:
+	struct Face
+	{
+		const void* mFace;
+		Key mKey;
+	};
+
+	std::vector<Face> mFaces;
+	U32 mContext;	// settings the layout depends on, such as the buffer size limits
+	U32 mNext;		// next face to check
+	BOOL mValid;
+};
+
+#endif // LL_LLBATCHLAYOUT_H
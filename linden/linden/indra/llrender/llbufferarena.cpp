@@ -0,0 +1,285 @@
+/**
+ * @file llbufferarena.cpp
+ * @brief Hands out parts of a large GPU buffer to many small ones
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "llbufferarena.h"
+
+LLBufferArena::LLBufferArena(U32 size, U32 alignment)
+:	mSize(size / alignment * alignment),
+	mAlignment(alignment),
+	mUsedBytes(0),
+	mFreeBytes(0),
+	mNumBlocks(0)
+{
+	if (mSize)
+	{
+		Block block;
+		block.mSize = mSize;
+		block.mOwner = NULL;
+		block.mFence = 0;
+		block.mState = BLOCK_FREE;
+		addFree(0, mBlocks.insert(std::make_pair(0U, block)).first->second);
+	}
+}
+
+S32 LLBufferArena::allocate(U32 size, void* owner)
+{
+	size = llmax((size + mAlignment - 1) / mAlignment * mAlignment, mAlignment);
+	block_map_t::iterator iter = findFree(size, mSize);
+	if (iter == mBlocks.end())
+	{
+		return -1;
+	}
+	S32 offset = (S32)iter->first;
+	take(iter, size, owner);
+	return offset;
+}
+
+void LLBufferArena::free(U32 offset, U32 fence)
+{
+	block_map_t::iterator iter = mBlocks.find(offset);
+	if (iter == mBlocks.end() || iter->second.mState != BLOCK_USED)
+	{
+		llerrs << "Freeing a buffer arena block not in use at " << offset << llendl;
+	}
+	Block& block = iter->second;
+	mUsedBytes -= block.mSize;
+	mNumBlocks--;
+	block.mState = BLOCK_PENDING;
+	block.mOwner = NULL;
+	block.mFence = fence;
+	mPending.push_back(offset);
+}
+
+void LLBufferArena::retire(U32 fence)
+{
+	while (!mPending.empty())
+	{
+		block_map_t::iterator iter = mBlocks.find(mPending.front());
+		if (iter->second.mFence > fence)
+		{
+			break;
+		}
+		mPending.pop_front();
+		release(iter);
+	}
+}
+
+U32 LLBufferArena::defragment(U32 max_bytes, U32 fence, std::vector<Move>& moves, movable_callback_t movable)
+{
+	std::vector<U32> offsets;
+	for (block_map_t::reverse_iterator iter = mBlocks.rbegin(); iter != mBlocks.rend(); ++iter)
+	{
+		if (iter->second.mState == BLOCK_USED)
+		{
+			offsets.push_back(iter->first);
+		}
+	}
+
+	U32 moved = 0;
+	for (std::vector<U32>::iterator offset = offsets.begin(); offset != offsets.end() && moved < max_bytes; ++offset)
+	{
+		Block& block = mBlocks.find(*offset)->second;
+		if (movable && !movable(block.mOwner))
+		{
+			continue;
+		}
+		block_map_t::iterator dest = findFree(block.mSize, *offset);
+		if (dest == mBlocks.end())
+		{
+			continue;
+		}
+
+		Move move;
+		move.mOwner = block.mOwner;
+		move.mFrom = *offset;
+		move.mTo = dest->first;
+		move.mSize = block.mSize;
+		take(dest, block.mSize, block.mOwner);
+		free(*offset, fence);
+		moves.push_back(move);
+		moved += move.mSize;
+	}
+	return moved;
+}
+
+U32 LLBufferArena::getLargestFree() const
+{
+	for (S32 i = NUM_SIZE_CLASSES - 1; i >= 0; --i)
+	{
+		U32 largest = 0;
+		for (std::set<U32>::const_iterator iter = mFreeLists[i].begin(); iter != mFreeLists[i].end(); ++iter)
+		{
+			largest = llmax(largest, mBlocks.find(*iter)->second.mSize);
+		}
+		if (largest)
+		{
+			return largest;
+		}
+	}
+	return 0;
+}
+
+F32 LLBufferArena::getFragmentation() const
+{
+	if (!mFreeBytes)
+	{
+		return 0.f;
+	}
+	return 1.f - (F32)getLargestFree() / (F32)mFreeBytes;
+}
+
+U32 LLBufferArena::getBlockSize(U32 offset) const
+{
+	block_map_t::const_iterator iter = mBlocks.find(offset);
+	if (iter == mBlocks.end() || iter->second.mState != BLOCK_USED)
+	{
+		return 0;
+	}
+	return iter->second.mSize;
+}
+
+U32 LLBufferArena::getHighWater() const
+{
+	for (block_map_t::const_reverse_iterator iter = mBlocks.rbegin(); iter != mBlocks.rend(); ++iter)
+	{
+		if (iter->second.mState == BLOCK_USED)
+		{
+			return iter->first + iter->second.mSize;
+		}
+	}
+	return 0;
+}
+
+S32 LLBufferArena::sizeClass(U32 size) const
+{
+	U32 units = size / mAlignment;
+	S32 size_class = 0;
+	while (units > 1 && size_class < NUM_SIZE_CLASSES - 1)
+	{
+		units >>= 1;
+		size_class++;
+	}
+	return size_class;
+}
+
+void LLBufferArena::addFree(U32 offset, Block& block)
+{
+	block.mState = BLOCK_FREE;
+	block.mOwner = NULL;
+	mFreeLists[sizeClass(block.mSize)].insert(offset);
+	mFreeBytes += block.mSize;
+}
+
+void LLBufferArena::removeFree(U32 offset, Block& block)
+{
+	mFreeLists[sizeClass(block.mSize)].erase(offset);
+	mFreeBytes -= block.mSize;
+}
+
+LLBufferArena::block_map_t::iterator LLBufferArena::findFree(U32 size, U32 limit)
+{
+	block_map_t::iterator found = mBlocks.end();
+	S32 size_class = sizeClass(size);
+
+	// The blocks of its own class may be too small: take the first that fits.
+	const std::set<U32>& free_list = mFreeLists[size_class];
+	for (std::set<U32>::const_iterator iter = free_list.begin(); iter != free_list.end() && *iter < limit; ++iter)
+	{
+		block_map_t::iterator block = mBlocks.find(*iter);
+		if (block->second.mSize >= size)
+		{
+			found = block;
+			break;
+		}
+	}
+
+	// Any block of a larger class fits: take the lowest of them all.
+	for (S32 i = size_class + 1; i < NUM_SIZE_CLASSES; ++i)
+	{
+		if (mFreeLists[i].empty())
+		{
+			continue;
+		}
+		U32 offset = *mFreeLists[i].begin();
+		if (offset < limit && (found == mBlocks.end() || offset < found->first))
+		{
+			found = mBlocks.find(offset);
+		}
+	}
+	return found;
+}
+
+void LLBufferArena::take(block_map_t::iterator iter, U32 size, void* owner)
+{
+	Block& block = iter->second;
+	removeFree(iter->first, block);
+	if (block.mSize > size)
+	{
+		Block rest;
+		rest.mSize = block.mSize - size;
+		rest.mFence = 0;
+		addFree(iter->first + size, mBlocks.insert(std::make_pair(iter->first + size, rest)).first->second);
+		block.mSize = size;
+	}
+	block.mState = BLOCK_USED;
+	block.mOwner = owner;
+	mUsedBytes += size;
+	mNumBlocks++;
+}
+
+void LLBufferArena::release(block_map_t::iterator iter)
+{
+	block_map_t::iterator next = iter;
+	++next;
+	if (next != mBlocks.end() && next->second.mState == BLOCK_FREE)
+	{
+		removeFree(next->first, next->second);
+		iter->second.mSize += next->second.mSize;
+		mBlocks.erase(next);
+	}
+	if (iter != mBlocks.begin())
+	{
+		block_map_t::iterator prev = iter;
+		--prev;
+		if (prev->second.mState == BLOCK_FREE)
+		{
+			removeFree(prev->first, prev->second);
+			prev->second.mSize += iter->second.mSize;
+			mBlocks.erase(iter);
+			iter = prev;
+		}
+	}
+	addFree(iter->first, iter->second);
+}
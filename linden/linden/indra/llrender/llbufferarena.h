@@ -0,0 +1,143 @@
+/**
+ * @file llbufferarena.h
+ * @brief Hands out parts of a large GPU buffer to many small ones
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LLBUFFERARENA_H
+#define LL_LLBUFFERARENA_H
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+
+// Keeps track of the parts of one large buffer handed out as blocks, so that
+// many small vertex buffers can live in one GL buffer object. Nothing here
+// touches GL: the arena only deals in offsets, and its owner moves the data.
+//
+// Free blocks are kept in lists by size class, the power of two their size
+// in alignment units falls under, and a block is taken from the lowest
+// offset that fits, so that what is in use packs towards the start.
+//
+// A freed block may still be read by frames the GPU has not finished, so it
+// is only reused once the fence it was freed at has been retired; fences are
+// any increasing count, such as a frame number.
+class LLBufferArena
+{
+public:
+	enum
+	{
+		DEFAULT_ALIGNMENT = 64,
+		NUM_SIZE_CLASSES = 32
+	};
+
+	// A block defragment() moved, for its owner to follow
+	struct Move
+	{
+		void* mOwner;
+		U32 mFrom;
+		U32 mTo;
+		U32 mSize;
+	};
+
+	// Whether the block of owner may be moved now
+	typedef BOOL (*movable_callback_t)(void* owner);
+
+	LLBufferArena(U32 size, U32 alignment = DEFAULT_ALIGNMENT);
+
+	// Returns the offset of a block of at least size bytes for owner, or -1
+	// if there is no room.
+	S32 allocate(U32 size, void* owner);
+	// Gives back the block at offset, to be reused once fence is retired.
+	void free(U32 offset, U32 fence);
+	// Makes the blocks freed at or before fence free again.
+	void retire(U32 fence);
+
+	// Moves blocks from the end of the arena down into free space nearer its
+	// start, the last first, until max_bytes have moved. The blocks they
+	// leave are freed at fence. Appends what moved to moves, and returns the
+	// number of bytes moved.
+	U32 defragment(U32 max_bytes, U32 fence, std::vector<Move>& moves, movable_callback_t movable = NULL);
+
+	U32 getSize() const						{ return mSize; }
+	U32 getUsedBytes() const				{ return mUsedBytes; }
+	U32 getFreeBytes() const				{ return mFreeBytes; }
+	U32 getPendingBytes() const				{ return mSize - mUsedBytes - mFreeBytes; }
+	S32 getNumBlocks() const				{ return mNumBlocks; }
+	BOOL isEmpty() const					{ return mUsedBytes == 0 && mPending.empty(); }
+	U32 getLargestFree() const;
+	// How much of the free space is not in the largest free block, from 0
+	// when it is all in one to nearly 1 when it is in crumbs.
+	F32 getFragmentation() const;
+	// The size of the block at offset, rounded up to the alignment, or 0
+	U32 getBlockSize(U32 offset) const;
+	// The end of the last block in use
+	U32 getHighWater() const;
+
+private:
+	enum
+	{
+		BLOCK_FREE,
+		BLOCK_USED,
+		BLOCK_PENDING
+	};
+
+	struct Block
+	{
+		U32 mSize;
+		void* mOwner;
+		U32 mFence;
+		U8 mState;
+	};
+
+	typedef std::map<U32, Block> block_map_t;
+
+	S32 sizeClass(U32 size) const;
+	void addFree(U32 offset, Block& block);
+	void removeFree(U32 offset, Block& block);
+	// The lowest free block below limit with at least size bytes
+	block_map_t::iterator findFree(U32 size, U32 limit);
+	// Takes size bytes from the start of the free block at iter for owner.
+	void take(block_map_t::iterator iter, U32 size, void* owner);
+	// Frees the block at iter, merged with the free blocks next to it.
+	void release(block_map_t::iterator iter);
+
+	U32 mSize;
+	U32 mAlignment;
+	U32 mUsedBytes;
+	U32 mFreeBytes;
+	S32 mNumBlocks;
+	block_map_t mBlocks;						// All of the blocks, by offset
+	std::set<U32> mFreeLists[NUM_SIZE_CLASSES];	// Offsets of the free blocks of each size class
+	std::deque<U32> mPending;					// Offsets of the blocks waiting for their fences, oldest first
+};
+
+#endif // LL_LLBUFFERARENA_H
@@ -0,0 +1,125 @@
+/**
+ * @file llocclusionschedule.cpp
+ * @brief Decides when to ask whether a group is occluded, and when to read the answer
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "llocclusionschedule.h"
+
+#include "llmath.h"
+
+U32 LLOcclusionSchedule::sNextPhase = 0;
+
+LLOcclusionSchedule::LLOcclusionSchedule()
+:	mPhase(sNextPhase++)
+{
+	reset();
+}
+
+void LLOcclusionSchedule::reset()
+{
+	mIssued = -1;
+	mAnswered = -1;
+	mStreak = 0;
+	mPending = FALSE;
+	mOccluded = FALSE;
+}
+
+S32 LLOcclusionSchedule::getInterval(S32 period, BOOL occluded, BOOL still) const
+{
+	S32 interval = occluded ? 1 : llmax(period, 1);
+	if (still && hasAnswer() && mOccluded == occluded)
+	{ //back off by doubling for each answer in a row that agreed
+		interval <<= llmin(mStreak, (U32) MAX_BACKOFF);
+	}
+	return interval;
+}
+
+BOOL LLOcclusionSchedule::isDue(S32 frame, S32 period, BOOL occluded, BOOL still) const
+{
+	if (mPending)
+	{ //wait for the answer already asked for
+		return FALSE;
+	}
+
+	if (!hasAnswer())
+	{
+		return TRUE;
+	}
+
+	S32 interval = getInterval(period, occluded, still);
+	return (frame + mPhase) % interval == 0 ? TRUE : FALSE;
+}
+
+BOOL LLOcclusionSchedule::isCurrent(S32 frame, S32 period, BOOL still) const
+{
+	if (!hasAnswer() || !mOccluded)
+	{
+		return FALSE;
+	}
+
+	// spreading over an interval can put up to twice it between answers
+	return frame - mAnswered < 2 * getInterval(period, TRUE, still) ? TRUE : FALSE;
+}
+
+void LLOcclusionSchedule::issue(S32 frame)
+{
+	mIssued = frame;
+	mPending = TRUE;
+}
+
+BOOL LLOcclusionSchedule::isReadable(S32 frame, BOOL available, S32 max_latency) const
+{
+	return mPending && (available || frame - mIssued >= max_latency) ? TRUE : FALSE;
+}
+
+void LLOcclusionSchedule::answer(S32 frame, BOOL occluded)
+{
+	if (hasAnswer() && mOccluded == occluded)
+	{
+		mStreak++;
+	}
+	else
+	{
+		mStreak = 0;
+	}
+
+	mOccluded = occluded;
+	mAnswered = frame;
+	mPending = FALSE;
+}
+
+void LLOcclusionSchedule::discard()
+{
+	mPending = FALSE;
+}
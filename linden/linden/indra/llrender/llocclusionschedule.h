@@ -0,0 +1,102 @@
+/**
+ * @file llocclusionschedule.h
+ * @brief Decides when to ask whether a group is occluded, and when to read the answer
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#ifndef LL_LLOCCLUSIONSCHEDULE_H
+#define LL_LLOCCLUSIONSCHEDULE_H
+
+// When to ask again whether a group is occluded, and when to read the answer,
+// from the answers it had before. Answers are read without waiting for them:
+// one that is not in yet is looked for again next frame, and is only waited
+// for once it is as many frames old as the caller will put up with. While the
+// view holds still, answers that have held for a few queries in a row are
+// trusted for longer before they are asked for again.
+//
+// Frames are counted by the caller; a group that is visible is asked every
+// period frames, and one that is occluded every frame, while the view moves.
+class LLOcclusionSchedule
+{
+public:
+	enum
+	{
+		MAX_BACKOFF = 2		// while the view holds still, intervals double this many times at most
+	};
+
+	LLOcclusionSchedule();
+
+	// Forgets the answers so far, so the next query is due at once.
+	void reset();
+
+	BOOL isPending() const					{ return mPending; }
+	BOOL hasAnswer() const					{ return mAnswered >= 0; }
+	BOOL isOccluded() const					{ return mOccluded; }
+	S32 getAnsweredFrame() const			{ return mAnswered; }
+
+	// How many frames apart queries are for a group that is occluded or not,
+	// and whether the view held still since the last frame.
+	S32 getInterval(S32 period, BOOL occluded, BOOL still) const;
+
+	// Whether a query is due in frame: none is pending, and either there has
+	// been no answer yet or the interval since the last one is up. Groups are
+	// spread over the frames of an interval, so they are not all due at once.
+	BOOL isDue(S32 frame, S32 period, BOOL occluded, BOOL still) const;
+
+	// Whether the last answer says occluded, and is recent enough in frame
+	// to keep a group occluded without a query of its own.
+	BOOL isCurrent(S32 frame, S32 period, BOOL still) const;
+
+	// A query was issued in frame.
+	void issue(S32 frame);
+
+	// Whether to read the pending answer in frame: once it is available, or
+	// once it is max_latency frames old, when the read will wait for it.
+	BOOL isReadable(S32 frame, BOOL available, S32 max_latency) const;
+
+	// The pending answer was read in frame.
+	void answer(S32 frame, BOOL occluded);
+
+	// The pending query was dropped without an answer.
+	void discard();
+
+private:
+	S32 mIssued;	// frame the pending query was issued in
+	S32 mAnswered;	// frame of the last answer, or -1 if none
+	U32 mStreak;	// answers in a row that agreed with the last one
+	U32 mPhase;		// offsets the frames this schedule is due in
+	BOOL mPending;
+	BOOL mOccluded;	// what the last answer said
+
+	static U32 sNextPhase;
+};
+
+#endif // LL_LLOCCLUSIONSCHEDULE_H
@@ -32,6 +32,7 @@
 
 #include "linden_common.h"
 
+#include <algorithm>
 #include <boost/static_assert.hpp>
 
 #include "llvertexbuffer.h"
@@ -43,6 +44,42 @@
 
 //============================================================================
 
+// Static buffers no bigger than an eighth of an arena share arenas; larger
+// ones keep a buffer object of their own.
+const U32 VERTEX_ARENA_SIZE = 4*1024*1024;
+const U32 INDEX_ARENA_SIZE = 1024*1024;
+const U32 ARENA_MAX_FRACTION = 8;
+// Frames a freed block waits before it is reused, so that the driver need not
+// wait for the GPU to finish drawing from it before writing to it.
+const U32 ARENA_FENCE_FRAMES = 3;
+// Bytes of each kind of arena updateArenas() may move a frame
+const U32 ARENA_DEFRAG_BYTES = 256*1024;
+// How fragmented an arena must be before it is defragmented
+const F32 ARENA_DEFRAG_THRESHOLD = 0.5f;
+
+LLVBOArena::LLVBOArena(U32 target, U32 size)
+:	mTarget(target),
+	mGLName(0),
+	mBlocks(size)
+{
+	BOOST_STATIC_ASSERT(sizeof(mGLName) == sizeof(GLuint));
+	glGenBuffersARB(1, (GLuint*) &mGLName);
+	stop_glerror();
+	glBindBufferARB(mTarget, mGLName);
+	glBufferDataARB(mTarget, size, NULL, GL_STATIC_DRAW_ARB);
+	glBindBufferARB(mTarget, 0);
+	stop_glerror();
+	LLVertexBuffer::sGLCount++;
+}
+
+LLVBOArena::~LLVBOArena()
+{
+	glDeleteBuffersARB(1, (GLuint*) &mGLName);
+	LLVertexBuffer::sGLCount--;
+}
+
+//============================================================================
+
 //static
 LLVBOPool LLVertexBuffer::sStreamVBOPool;
 LLVBOPool LLVertexBuffer::sDynamicVBOPool;
@@ -57,11 +94,16 @@ S32 LLVertexBuffer::sMappedCount = 0;
 BOOL LLVertexBuffer::sEnableVBOs = TRUE;
 U32 LLVertexBuffer::sGLRenderBuffer = 0;
 U32 LLVertexBuffer::sGLRenderIndices = 0;
+U32 LLVertexBuffer::sGLRenderOffset = 0;
 U32 LLVertexBuffer::sLastMask = 0;
 BOOL LLVertexBuffer::sVBOActive = FALSE;
 BOOL LLVertexBuffer::sIBOActive = FALSE;
 U32 LLVertexBuffer::sAllocatedBytes = 0;
 BOOL LLVertexBuffer::sMapped = FALSE;
+BOOL LLVertexBuffer::sUseArenas = TRUE;
+U32 LLVertexBuffer::sArenaFence = 0;
+std::vector<LLVBOArena*> LLVertexBuffer::sVertexArenas;
+std::vector<LLVBOArena*> LLVertexBuffer::sIndexArenas;
 
 std::vector<U32> LLVertexBuffer::sDeleteList;
 
@@ -308,6 +350,7 @@ void LLVertexBuffer::unbind()
 
 	sGLRenderBuffer = 0;
 	sGLRenderIndices = 0;
+	sGLRenderOffset = 0;
 
 	setupClientArrays(0);
 }
@@ -318,6 +361,157 @@ void LLVertexBuffer::cleanupClass()
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
 	unbind();
 	clientCopy(); // deletes GL buffers
+	releaseArenas(sVertexArenas, TRUE);
+	releaseArenas(sIndexArenas, TRUE);
+}
+
+//static
+void LLVertexBuffer::updateArenas()
+{
+	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
+	sArenaFence++;
+	if (sArenaFence > ARENA_FENCE_FRAMES)
+	{
+		U32 fence = sArenaFence - ARENA_FENCE_FRAMES;
+		for (std::vector<LLVBOArena*>::iterator iter = sVertexArenas.begin(); iter != sVertexArenas.end(); ++iter)
+		{
+			(*iter)->mBlocks.retire(fence);
+		}
+		for (std::vector<LLVBOArena*>::iterator iter = sIndexArenas.begin(); iter != sIndexArenas.end(); ++iter)
+		{
+			(*iter)->mBlocks.retire(fence);
+		}
+	}
+
+	defragmentArenas(sVertexArenas, FALSE);
+	defragmentArenas(sIndexArenas, TRUE);
+
+	releaseArenas(sVertexArenas, FALSE);
+	releaseArenas(sIndexArenas, FALSE);
+}
+
+//static
+LLVBOArena* LLVertexBuffer::allocateArenaBlock(std::vector<LLVBOArena*>& arenas, U32 target, U32 arena_size,
+											   U32 size, LLVertexBuffer* owner, LLVBOArena* preferred, U32& offset)
+{
+	// the arena the buffer was in before, so that what is drawn together
+	// stays together, if it is still around and has room
+	if (preferred && std::find(arenas.begin(), arenas.end(), preferred) != arenas.end())
+	{
+		S32 block = preferred->mBlocks.allocate(size, owner);
+		if (block >= 0)
+		{
+			offset = (U32) block;
+			return preferred;
+		}
+	}
+
+	// then the first arena with room, so that buffers crowd into as few as possible
+	for (std::vector<LLVBOArena*>::iterator iter = arenas.begin(); iter != arenas.end(); ++iter)
+	{
+		S32 block = (*iter)->mBlocks.allocate(size, owner);
+		if (block >= 0)
+		{
+			offset = (U32) block;
+			return *iter;
+		}
+	}
+
+	LLVBOArena* arena = new LLVBOArena(target, arena_size);
+	arenas.push_back(arena);
+	unbind(); // the new arena's binding went behind our back
+
+	S32 block = arena->mBlocks.allocate(size, owner);
+	if (block < 0)
+	{
+		llerrs << "Vertex buffer of " << size << " bytes does not fit in an empty arena." << llendl;
+	}
+	offset = (U32) block;
+	return arena;
+}
+
+//static
+BOOL LLVertexBuffer::isArenaMovable(void* owner)
+{
+	// data still in client memory has yet to be copied to where it is now
+	return !((LLVertexBuffer*) owner)->mLocked;
+}
+
+//static
+void LLVertexBuffer::defragmentArenas(std::vector<LLVBOArena*>& arenas, BOOL indices)
+{
+	U32 budget = ARENA_DEFRAG_BYTES;
+	std::vector<LLBufferArena::Move> moves;
+	std::vector<U8> data;
+
+	for (std::vector<LLVBOArena*>::iterator iter = arenas.begin(); iter != arenas.end() && budget > 0; ++iter)
+	{
+		LLVBOArena* arena = *iter;
+		if (arena->mBlocks.getFragmentation() < ARENA_DEFRAG_THRESHOLD)
+		{
+			continue;
+		}
+
+		moves.clear();
+		budget -= llmin(budget, arena->mBlocks.defragment(budget, sArenaFence, moves, isArenaMovable));
+		if (moves.empty())
+		{
+			continue;
+		}
+
+		// no copy between buffer objects without ARB_copy_buffer, so through client memory
+		stop_glerror();
+		glBindBufferARB(arena->mTarget, arena->mGLName);
+		for (std::vector<LLBufferArena::Move>::iterator move = moves.begin(); move != moves.end(); ++move)
+		{
+			data.resize(move->mSize);
+			glGetBufferSubDataARB(arena->mTarget, move->mFrom, move->mSize, &data[0]);
+			glBufferSubDataARB(arena->mTarget, move->mTo, move->mSize, &data[0]);
+
+			LLVertexBuffer* buffer = (LLVertexBuffer*) move->mOwner;
+			if (indices)
+			{
+				buffer->mIndexArenaOffset = move->mTo;
+			}
+			else
+			{
+				buffer->mArenaOffset = move->mTo;
+			}
+		}
+		glBindBufferARB(arena->mTarget, 0);
+		stop_glerror();
+
+		// forget the bindings, and the pointers set up at the old offsets
+		unbind();
+	}
+}
+
+//static
+void LLVertexBuffer::releaseArenas(std::vector<LLVBOArena*>& arenas, BOOL all)
+{
+	if (all)
+	{
+		for (std::vector<LLVBOArena*>::iterator iter = arenas.begin(); iter != arenas.end(); ++iter)
+		{
+			(*iter)->mBlocks.retire(sArenaFence);
+		}
+	}
+
+	// keep the first arena around for the next buffers, unless releasing all
+	U32 keep = all ? 0 : 1;
+	for (U32 i = keep; i < arenas.size(); )
+	{
+		if (arenas[i]->mBlocks.isEmpty())
+		{
+			delete arenas[i];
+			arenas.erase(arenas.begin() + i);
+			unbind();
+		}
+		else
+		{
+			++i;
+		}
+	}
 }
 
 void LLVertexBuffer::clientCopy(F64 max_time)
@@ -340,7 +534,13 @@ LLVertexBuffer::LLVertexBuffer(U32 typemask, S32 usage) :
 	mFilthy(FALSE),
 	mEmpty(TRUE),
 	mResized(FALSE),
-	mDynamicSize(FALSE)
+	mDynamicSize(FALSE),
+	mArena(NULL),
+	mIndexArena(NULL),
+	mArenaOffset(0),
+	mIndexArenaOffset(0),
+	mLastArena(NULL),
+	mLastIndexArena(NULL)
 {
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
 	if (!sEnableVBOs)
@@ -474,7 +674,14 @@ void LLVertexBuffer::createGLBuffer()
 
 	mEmpty = TRUE;
 
-	if (useVBOs())
+	if (useArena())
+	{
+		mMappedData = NULL;
+		mArena = allocateArenaBlock(sVertexArenas, GL_ARRAY_BUFFER_ARB, VERTEX_ARENA_SIZE, size, this, mLastArena, mArenaOffset);
+		mLastArena = mArena;
+		mGLBuffer = mArena->mGLName;
+	}
+	else if (useVBOs())
 	{
 		mMappedData = NULL;
 		genBuffer();
@@ -506,7 +713,14 @@ void LLVertexBuffer::createGLIndices()
 
 	mEmpty = TRUE;
 
-	if (useVBOs())
+	if (useArena())
+	{
+		mMappedIndexData = NULL;
+		mIndexArena = allocateArenaBlock(sIndexArenas, GL_ELEMENT_ARRAY_BUFFER_ARB, INDEX_ARENA_SIZE, size, this, mLastIndexArena, mIndexArenaOffset);
+		mLastIndexArena = mIndexArena;
+		mGLIndices = mIndexArena->mGLName;
+	}
+	else if (useVBOs())
 	{
 		mMappedIndexData = NULL;
 		genIndices();
@@ -524,7 +738,23 @@ void LLVertexBuffer::createGLIndices()
 void LLVertexBuffer::destroyGLBuffer()
 {
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
-	if (mGLBuffer)
+	if (mArena)
+	{
+		// unwritten data is only client memory, so may be dropped
+		delete [] mMappedData;
+		mMappedData = NULL;
+		if (mLocked && !mMappedIndexData)
+		{
+			mLocked = FALSE;
+			sMappedCount--;
+		}
+
+		mArena->mBlocks.free(mArenaOffset, sArenaFence);
+		mArena = NULL;
+		mArenaOffset = 0;
+		sAllocatedBytes -= getSize();
+	}
+	else if (mGLBuffer)
 	{
 		if (useVBOs())
 		{
@@ -551,7 +781,22 @@ void LLVertexBuffer::destroyGLBuffer()
 void LLVertexBuffer::destroyGLIndices()
 {
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
-	if (mGLIndices)
+	if (mIndexArena)
+	{
+		delete [] mMappedIndexData;
+		mMappedIndexData = NULL;
+		if (mLocked && !mMappedData)
+		{
+			mLocked = FALSE;
+			sMappedCount--;
+		}
+
+		mIndexArena->mBlocks.free(mIndexArenaOffset, sArenaFence);
+		mIndexArena = NULL;
+		mIndexArenaOffset = 0;
+		sAllocatedBytes -= getIndicesSize();
+	}
+	else if (mGLIndices)
 	{
 		if (useVBOs())
 		{
@@ -774,6 +1019,16 @@ BOOL LLVertexBuffer::useVBOs() const
 	return sEnableVBOs;
 }
 
+BOOL LLVertexBuffer::useArena() const
+{
+	// only static buffers: the others are rewritten too often to share
+	return sUseArenas &&
+		mUsage == GL_STATIC_DRAW_ARB &&
+		useVBOs() &&
+		(U32) getSize() <= VERTEX_ARENA_SIZE / ARENA_MAX_FRACTION &&
+		(U32) getIndicesSize() <= INDEX_ARENA_SIZE / ARENA_MAX_FRACTION;
+}
+
 //----------------------------------------------------------------------------
 
 // Map for data access
@@ -789,7 +1044,23 @@ U8* LLVertexBuffer::mapBuffer(S32 access)
 		llerrs << "LLVertexBuffer::mapBuffer() called on unallocated buffer." << llendl;
 	}
 		
-	if (!mLocked && useVBOs())
+	if (!mLocked && isInArena())
+	{
+		// written in client memory, and copied into the arenas by setBuffer()
+		mLocked = TRUE;
+		if (mArena)
+		{
+			mMappedData = new U8[getSize()];
+			memset(mMappedData, 0, getSize());
+		}
+		if (mIndexArena)
+		{
+			mMappedIndexData = new U8[getIndicesSize()];
+			memset(mMappedIndexData, 0, getIndicesSize());
+		}
+		sMappedCount++;
+	}
+	else if (!mLocked && useVBOs())
 	{
 		setBuffer(0);
 		mLocked = TRUE;
@@ -843,7 +1114,30 @@ void LLVertexBuffer::unmapBuffer()
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
 	if (mMappedData || mMappedIndexData)
 	{
-		if (useVBOs() && mLocked)
+		if (isInArena() && mLocked)
+		{
+			stop_glerror();
+			if (mMappedData)
+			{
+				glBufferSubDataARB(GL_ARRAY_BUFFER_ARB, mArenaOffset, getSize(), mMappedData);
+			}
+			if (mMappedIndexData)
+			{
+				glBufferSubDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mIndexArenaOffset, getIndicesSize(), mMappedIndexData);
+			}
+			stop_glerror();
+			sMappedCount--;
+
+			// arenas only hold static buffers, which are only mapped once
+			delete [] mMappedData;
+			delete [] mMappedIndexData;
+			mMappedIndexData = NULL;
+			mMappedData = NULL;
+			mEmpty = TRUE;
+			mFinal = TRUE;
+			mLocked = FALSE;
+		}
+		else if (useVBOs() && mLocked)
 		{
 			stop_glerror();
 			glUnmapBufferARB(GL_ARRAY_BUFFER_ARB);
@@ -987,6 +1281,10 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
 	//set up pointers if the data mask is different ...
 	BOOL setup = (sLastMask != data_mask);
+	if (mArenaOffset != sGLRenderOffset)
+	{
+		setup = TRUE; // ... or the data is elsewhere in the same arena
+	}
 
 	if (useVBOs())
 	{
@@ -1115,6 +1413,7 @@ void LLVertexBuffer::setBuffer(U32 data_mask)
 		{
 			setupVertexBuffer(data_mask); // subclass specific setup (virtual function)
 			sSetCount++;
+			sGLRenderOffset = mArenaOffset;
 		}
 	}
 }
@@ -1124,7 +1423,7 @@ void LLVertexBuffer::setupVertexBuffer(U32 data_mask) const
 {
 	LLMemType mt(LLMemType::MTYPE_VERTEX_DATA);
 	stop_glerror();
-	U8* base = useVBOs() ? NULL : mMappedData;
+	U8* base = getVerticesPointer();
 	S32 stride = mStride;
 
 	if ((data_mask & mTypeMask) != data_mask)
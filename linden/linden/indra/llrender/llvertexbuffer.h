@@ -41,6 +41,7 @@
 #include "llstrider.h"
 #include "llmemory.h"
 #include "llrender.h"
+#include "llbufferarena.h"
 #include <set>
 #include <vector>
 #include <list>
@@ -73,6 +74,20 @@ protected:
 	}
 };
 
+//============================================================================
+// a gl buffer object shared by many small static buffers
+
+class LLVBOArena
+{
+public:
+	LLVBOArena(U32 target, U32 size);
+	~LLVBOArena();
+
+	U32 mTarget;			// GL_ARRAY_BUFFER_ARB or GL_ELEMENT_ARRAY_BUFFER_ARB
+	U32 mGLName;
+	LLBufferArena mBlocks;	// which parts of the buffer object are whose
+};
+
 
 //============================================================================
 // base class
@@ -90,6 +105,7 @@ public:
 	static void setupClientArrays(U32 data_mask);
  	static void clientCopy(F64 max_time = 0.005); //copy data from client to GL
 	static void unbind(); //unbind any bound vertex buffer
+	static void updateArenas(); //once a frame: reuse what the GPU is done with, defragment, free empty arenas
 
 	//get the size of a vertex with the given typemask
 	//if offsets is not NULL, its contents will be filled
@@ -145,6 +161,14 @@ protected:
 	void	updateNumIndices(S32 nindices); 
 	virtual BOOL	useVBOs() const;
 	void	unmapBuffer();
+	BOOL	useArena() const;	// whether this buffer's data should go in the shared arenas
+	BOOL	isInArena() const		{ return mArena || mIndexArena; }
+
+	static LLVBOArena* allocateArenaBlock(std::vector<LLVBOArena*>& arenas, U32 target, U32 arena_size,
+										  U32 size, LLVertexBuffer* owner, LLVBOArena* preferred, U32& offset);
+	static void defragmentArenas(std::vector<LLVBOArena*>& arenas, BOOL indices);
+	static void releaseArenas(std::vector<LLVBOArena*>& arenas, BOOL all);
+	static BOOL isArenaMovable(void* owner);
 		
 public:
 	LLVertexBuffer(U32 typemask, S32 usage);
@@ -181,8 +205,9 @@ public:
 	S32 getRequestedVerts() const			{ return mRequestedNumVerts; }
 	S32 getRequestedIndices() const			{ return mRequestedNumIndices; }
 
-	U8* getIndicesPointer() const			{ return useVBOs() ? NULL : mMappedIndexData; }
-	U8* getVerticesPointer() const			{ return useVBOs() ? NULL : mMappedData; }
+	// offsets into the bound buffer objects when using VBOs, or client memory
+	U8* getIndicesPointer() const			{ return useVBOs() ? (U8*) NULL + mIndexArenaOffset : mMappedIndexData; }
+	U8* getVerticesPointer() const			{ return useVBOs() ? (U8*) NULL + mArenaOffset : mMappedData; }
 	S32 getStride() const					{ return mStride; }
 	S32 getTypeMask() const					{ return mTypeMask; }
 	BOOL hasDataType(S32 type) const		{ return ((1 << type) & getTypeMask()) ? TRUE : FALSE; }
@@ -221,6 +246,12 @@ protected:
 	S32		mOffsets[TYPE_MAX];
 	BOOL	mResized;		// if TRUE, client buffer has been resized and GL buffer has not
 	BOOL	mDynamicSize;	// if TRUE, buffer has been resized at least once (and should be padded)
+	LLVBOArena* mArena;			// arena holding the vertices, or NULL if they have a buffer object of their own
+	LLVBOArena* mIndexArena;	// arena holding the indices, or NULL
+	U32		mArenaOffset;		// offset of the vertices in mArena
+	U32		mIndexArenaOffset;	// offset of the indices in mIndexArena
+	LLVBOArena* mLastArena;		// arenas the buffer was last in, tried first when it is remade
+	LLVBOArena* mLastIndexArena;
 
 	class DirtyRegion
 	{
@@ -250,12 +281,18 @@ public:
 	static U32 sGLMode[LLRender::NUM_MODES];
 	static U32 sGLRenderBuffer;
 	static U32 sGLRenderIndices;
+	static U32 sGLRenderOffset;
 	static BOOL sVBOActive;
 	static BOOL sIBOActive;
 	static U32 sLastMask;
 	static U32 sAllocatedBytes;
 	static U32 sBindCount;
 	static U32 sSetCount;
+
+	static BOOL sUseArenas;		// put small static buffers in shared arenas
+	static U32 sArenaFence;		// frames counted by updateArenas()
+	static std::vector<LLVBOArena*> sVertexArenas;
+	static std::vector<LLVBOArena*> sIndexArenas;
 };
 
 
@@ -0,0 +1,144 @@
+/**
+ * @file llwatergrid.cpp
+ * @brief The grid of quads water patches are made of
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "llwatergrid.h"
+
+#include "llvertexxform.h"
+#include "m4math.h"
+
+LLWaterGrid::grid_map_t LLWaterGrid::sGrids;
+
+LLWaterGrid::LLWaterGrid(S32 size)
+:	mSize(size)
+{
+	mPositions.reserve(4 * size * size);
+	mTexCoords.reserve(4 * size * size);
+	mIndices.reserve(6 * size * size);
+
+	F32 size_inv = 1.f / size;
+	for (S32 y = 0; y < size; y++)
+	{
+		for (S32 x = 0; x < size; x++)
+		{
+			U16 offset = (U16) mPositions.size();
+			F32 left = x * size_inv;
+			F32 right = (x + 1) * size_inv;
+			F32 bottom = y * size_inv;
+			F32 top = (y + 1) * size_inv;
+
+			mPositions.push_back(LLVector3(left, top, 0.f));
+			mPositions.push_back(LLVector3(left, bottom, 0.f));
+			mPositions.push_back(LLVector3(right, top, 0.f));
+			mPositions.push_back(LLVector3(right, bottom, 0.f));
+
+			mTexCoords.push_back(LLVector2(left, top));
+			mTexCoords.push_back(LLVector2(left, bottom));
+			mTexCoords.push_back(LLVector2(right, top));
+			mTexCoords.push_back(LLVector2(right, bottom));
+
+			mIndices.push_back(offset + 0);
+			mIndices.push_back(offset + 1);
+			mIndices.push_back(offset + 2);
+
+			mIndices.push_back(offset + 1);
+			mIndices.push_back(offset + 3);
+			mIndices.push_back(offset + 2);
+		}
+	}
+}
+
+//static
+const LLWaterGrid& LLWaterGrid::getGrid(S32 size)
+{
+	grid_map_t::iterator iter = sGrids.find(size);
+	if (iter == sGrids.end())
+	{
+		iter = sGrids.insert(std::make_pair(size, new LLWaterGrid(size))).first;
+	}
+	return *iter->second;
+}
+
+//static
+void LLWaterGrid::cleanupClass()
+{
+	for (grid_map_t::iterator iter = sGrids.begin(); iter != sGrids.end(); ++iter)
+	{
+		delete iter->second;
+	}
+	sGrids.clear();
+}
+
+void LLWaterGrid::fill(const LLVector3& origin, F32 width, F32 height,
+					   LLVector3* positions, U32 position_stride,
+					   LLVector3* normals, U32 normal_stride,
+					   LLVector2* tex_coords, U32 tex_coord_stride,
+					   U16* indices, U16 index_offset) const
+{
+	S32 count = getNumVertices();
+
+	LLMatrix4 mat;
+	mat.mMatrix[0][0] = width;
+	mat.mMatrix[1][1] = height;
+	mat.mMatrix[3][0] = origin.mV[VX];
+	mat.mMatrix[3][1] = origin.mV[VY];
+	mat.mMatrix[3][2] = origin.mV[VZ];
+	LLVertexXform::sTransformPoints(mat, &mPositions[0], sizeof(LLVector3),
+									positions, position_stride, count);
+
+	const LLVector3 normal(0.f, 0.f, 1.f);
+	U8* normalp = (U8*) normals;
+	U8* tex_coordp = (U8*) tex_coords;
+	for (S32 i = 0; i < count; i++)
+	{
+		*(LLVector3*) normalp = normal;
+		*(LLVector2*) tex_coordp = mTexCoords[i];
+		normalp += normal_stride;
+		tex_coordp += tex_coord_stride;
+	}
+
+	S32 num_indices = getNumIndices();
+	if (index_offset == 0)
+	{
+		memcpy(indices, &mIndices[0], num_indices * sizeof(U16));
+	}
+	else
+	{
+		for (S32 i = 0; i < num_indices; i++)
+		{
+			indices[i] = mIndices[i] + index_offset;
+		}
+	}
+}
@@ -0,0 +1,82 @@
+/**
+ * @file llwatergrid.h
+ * @brief The grid of quads water patches are made of
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#ifndef LL_LLWATERGRID_H
+#define LL_LLWATERGRID_H
+
+#include <map>
+#include <vector>
+
+#include "v2math.h"
+#include "v3math.h"
+
+// The grid of quads a water patch is made of, in a unit square, worked out
+// once for each resolution and shared by every patch that has it. A patch's
+// vertices are the grid's scaled and moved into place, in one batched
+// transform, and its normals, texture coordinates and indices are the
+// grid's as they are. Each quad is four vertices, top left, bottom left,
+// top right and bottom right, and two triangles.
+class LLWaterGrid
+{
+public:
+	// The grid of size by size quads, worked out the first time it is asked for.
+	static const LLWaterGrid& getGrid(S32 size);
+	static void cleanupClass();
+
+	S32 getSize() const						{ return mSize; }
+	S32 getNumVertices() const				{ return (S32) mPositions.size(); }
+	S32 getNumIndices() const				{ return (S32) mIndices.size(); }
+
+	// Writes the grid into strided vertex arrays, scaled to width by height
+	// with its south west corner at origin, and its indices counting from
+	// index_offset. Strides are in bytes, as LLStrider has them.
+	void fill(const LLVector3& origin, F32 width, F32 height,
+			  LLVector3* positions, U32 position_stride,
+			  LLVector3* normals, U32 normal_stride,
+			  LLVector2* tex_coords, U32 tex_coord_stride,
+			  U16* indices, U16 index_offset) const;
+
+private:
+	LLWaterGrid(S32 size);
+
+	S32 mSize;
+	std::vector<LLVector3> mPositions;	// in the unit square, at z = 0
+	std::vector<LLVector2> mTexCoords;
+	std::vector<U16> mIndices;			// counting from 0
+
+	typedef std::map<S32, LLWaterGrid*> grid_map_t;
+	static grid_map_t sGrids;
+};
+
+#endif // LL_LLWATERGRID_H
@@ -0,0 +1,377 @@
+/**
+ * @file llbatchlayout_test.cpp
+ * @brief LLBatchLayout tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../llbatchlayout.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "lltimer.h"
+
+#include <algorithm>
+
+namespace
+{
+	// A face of a synthetic group: what it is batched by, and a seed its
+	// vertices are made from.
+	struct SynthFace
+	{
+		U32 mTexture;
+		U32 mFlags;
+		U32 mGeomCount;
+		U32 mSeed;
+
+		// where the last build put it
+		U32 mBuffer;
+		U32 mGeomIndex;
+	};
+
+	struct SynthVertex
+	{
+		F32 mPosition[3];
+		F32 mNormal[3];
+		F32 mTexCoord[2];
+	};
+
+	struct SynthBatch
+	{
+		U32 mBuffer;
+		U32 mTexture;
+		U32 mFlags;
+		U32 mStart;
+		U32 mEnd;
+	};
+
+	// A group as genDrawInfo() leaves it: buffers cut by texture and size,
+	// and batches of neighbouring faces that draw alike.
+	struct SynthGroup
+	{
+		std::vector<SynthFace> mFaces;
+		std::vector<std::vector<SynthVertex> > mBuffers;
+		std::vector<SynthBatch> mBatches;
+		LLBatchLayout mLayout;
+	};
+
+	const U32 MAX_VERTICES = 65535;
+
+	LLBatchLayout::Key make_key(const SynthFace& face)
+	{
+		LLBatchLayout::Key key;
+		key.mTexture = (const void*) (size_t) face.mTexture;
+		key.mFlags = face.mFlags;
+		key.mGeomCount = face.mGeomCount;
+		key.mIndicesCount = face.mGeomCount * 3 / 2;
+		return key;
+	}
+
+	void write_face(SynthGroup& group, const SynthFace& face)
+	{
+		SynthVertex* vertex = &group.mBuffers[face.mBuffer][face.mGeomIndex];
+		for (U32 i = 0; i < face.mGeomCount; ++i, ++vertex)
+		{
+			F32 t = (F32) (face.mSeed + i);
+			vertex->mPosition[0] = t;
+			vertex->mPosition[1] = t * 0.5f;
+			vertex->mPosition[2] = t * 0.25f;
+			vertex->mNormal[0] = 0.f;
+			vertex->mNormal[1] = 0.f;
+			vertex->mNormal[2] = 1.f;
+			vertex->mTexCoord[0] = t * 0.125f;
+			vertex->mTexCoord[1] = 1.f - t * 0.125f;
+		}
+	}
+
+	struct CompareBatchBreaker
+	{
+		const std::vector<SynthFace>* mFaces;
+		bool operator()(U32 lhs, U32 rhs) const
+		{
+			const SynthFace& a = (*mFaces)[lhs];
+			const SynthFace& b = (*mFaces)[rhs];
+			return a.mTexture != b.mTexture ? a.mTexture < b.mTexture : a.mFlags < b.mFlags;
+		}
+	};
+
+	// As rebuildGeom() does it: record the layout, sort the faces by what
+	// breaks batches, cut buffers, write every face and merge batches.
+	void full_rebuild(SynthGroup& group)
+	{
+		group.mLayout.beginRecord();
+		std::vector<U32> order(group.mFaces.size());
+		for (U32 i = 0; i < group.mFaces.size(); ++i)
+		{
+			group.mLayout.record(&group.mFaces[i], make_key(group.mFaces[i]));
+			order[i] = i;
+		}
+
+		CompareBatchBreaker compare;
+		compare.mFaces = &group.mFaces;
+		std::sort(order.begin(), order.end(), compare);
+
+		group.mBuffers.clear();
+		group.mBatches.clear();
+		U32 last_texture = 0xFFFFFFFF;
+		U32 geom_index = 0;
+		for (U32 i = 0; i < order.size(); ++i)
+		{
+			SynthFace& face = group.mFaces[order[i]];
+			if (face.mTexture != last_texture || geom_index + face.mGeomCount > MAX_VERTICES)
+			{
+				group.mBuffers.push_back(std::vector<SynthVertex>());
+				last_texture = face.mTexture;
+				geom_index = 0;
+			}
+			face.mBuffer = group.mBuffers.size() - 1;
+			face.mGeomIndex = geom_index;
+			geom_index += face.mGeomCount;
+			group.mBuffers.back().resize(geom_index);
+			write_face(group, face);
+
+			SynthBatch* last = group.mBatches.empty() ? NULL : &group.mBatches.back();
+			if (last && last->mBuffer == face.mBuffer && last->mFlags == face.mFlags &&
+				last->mEnd == face.mGeomIndex - 1)
+			{
+				last->mEnd += face.mGeomCount;
+			}
+			else
+			{
+				SynthBatch batch;
+				batch.mBuffer = face.mBuffer;
+				batch.mTexture = face.mTexture;
+				batch.mFlags = face.mFlags;
+				batch.mStart = face.mGeomIndex;
+				batch.mEnd = face.mGeomIndex + face.mGeomCount - 1;
+				group.mBatches.push_back(batch);
+			}
+		}
+		group.mLayout.endRecord(1);
+	}
+
+	// As rebuildGeomInPlace() does it: check every face against the layout,
+	// then write only the dirty one where it is.
+	BOOL rebuild_in_place(SynthGroup& group, U32 dirty)
+	{
+		if (!group.mLayout.beginCheck(1))
+		{
+			return FALSE;
+		}
+		for (U32 i = 0; i < group.mFaces.size(); ++i)
+		{
+			if (!group.mLayout.check(&group.mFaces[i], make_key(group.mFaces[i])))
+			{
+				return FALSE;
+			}
+		}
+		if (!group.mLayout.endCheck())
+		{
+			return FALSE;
+		}
+		write_face(group, group.mFaces[dirty]);
+		return TRUE;
+	}
+
+	void make_group(SynthGroup& group, U32 num_faces, U32 num_textures)
+	{
+		group.mFaces.resize(num_faces);
+		for (U32 i = 0; i < num_faces; ++i)
+		{
+			SynthFace& face = group.mFaces[i];
+			face.mTexture = 1 + ll_rand(num_textures);
+			face.mFlags = ll_rand(4);
+			face.mGeomCount = 4 + ll_rand(i % 10 ? 100 : 600);
+			face.mSeed = ll_rand(1000);
+			face.mBuffer = 0;
+			face.mGeomIndex = 0;
+		}
+	}
+
+	bool same_buffers(const SynthGroup& a, const SynthGroup& b)
+	{
+		if (a.mBuffers.size() != b.mBuffers.size())
+		{
+			return false;
+		}
+		for (U32 i = 0; i < a.mBuffers.size(); ++i)
+		{
+			if (a.mBuffers[i].size() != b.mBuffers[i].size() ||
+				memcmp(&a.mBuffers[i][0], &b.mBuffers[i][0], a.mBuffers[i].size() * sizeof(SynthVertex)))
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+}
+
+namespace tut
+{
+	struct batchlayout_test
+	{
+	};
+	typedef test_group<batchlayout_test> batchlayout_test_t;
+	typedef batchlayout_test_t::object batchlayout_test_object_t;
+	tut::batchlayout_test_t tut_batchlayout_test("batchlayout_test");
+
+	template<> template<>
+	void batchlayout_test_object_t::test<1>()
+	{
+		// the same faces with the same keys pass, anything else fails
+		int faces[3];
+		LLBatchLayout::Key keys[3];
+		for (S32 i = 0; i < 3; ++i)
+		{
+			keys[i].mTexture = &faces[i];
+			keys[i].mGeomCount = 10 * (i + 1);
+		}
+
+		LLBatchLayout layout;
+		ensure("not valid until recorded", !layout.beginCheck(0));
+
+		layout.beginRecord();
+		for (S32 i = 0; i < 3; ++i)
+		{
+			layout.record(&faces[i], keys[i]);
+		}
+		ensure("not valid while recording", !layout.isValid());
+		layout.endRecord(7);
+		ensure_equals("faces", layout.getNumFaces(), 3);
+
+		ensure("other context", !layout.beginCheck(8));
+
+		ensure("same context", layout.beginCheck(7));
+		for (S32 i = 0; i < 3; ++i)
+		{
+			ensure("same face", layout.check(&faces[i], keys[i]));
+		}
+		ensure("all met", layout.endCheck());
+
+		layout.beginCheck(7);
+		ensure("first", layout.check(&faces[0], keys[0]));
+		ensure("second", layout.check(&faces[1], keys[1]));
+		ensure("one missing", !layout.endCheck());
+
+		layout.beginCheck(7);
+		ensure("out of order", !layout.check(&faces[1], keys[1]));
+
+		layout.beginCheck(7);
+		LLBatchLayout::Key changed = keys[0];
+		changed.mGeomCount++;
+		ensure("other size", !layout.check(&faces[0], changed));
+
+		layout.beginCheck(7);
+		changed = keys[0];
+		changed.mState = 1;
+		ensure("other state", !layout.check(&faces[0], changed));
+
+		layout.beginCheck(7);
+		for (S32 i = 0; i < 3; ++i)
+		{
+			layout.check(&faces[i], keys[i]);
+		}
+		ensure("one too many", !layout.check(&faces[0], keys[0]));
+
+		layout.clear();
+		ensure("cleared", !layout.beginCheck(7));
+	}
+
+	template<> template<>
+	void batchlayout_test_object_t::test<2>()
+	{
+		// a face rebuilt in place leaves the buffers as a full rebuild would,
+		// and a face that would batch differently forces a full rebuild
+		SynthGroup group;
+		make_group(group, 500, 8);
+		full_rebuild(group);
+
+		for (S32 i = 0; i < 50; ++i)
+		{
+			U32 dirty = ll_rand(group.mFaces.size());
+			group.mFaces[dirty].mSeed = ll_rand(1000);
+			ensure("in place", rebuild_in_place(group, dirty));
+
+			SynthGroup full = group;
+			full_rebuild(full);
+			ensure("same as a full rebuild", same_buffers(group, full));
+		}
+
+		U32 dirty = ll_rand(group.mFaces.size());
+		group.mFaces[dirty].mTexture++;
+		ensure("texture changed", !rebuild_in_place(group, dirty));
+		full_rebuild(group);
+		group.mFaces[dirty].mGeomCount++;
+		ensure("size changed", !rebuild_in_place(group, dirty));
+		full_rebuild(group);
+		group.mFaces.pop_back();
+		ensure("face gone", !rebuild_in_place(group, 0));
+	}
+
+	template<> template<>
+	void batchlayout_test_object_t::test<3>()
+	{
+		// toggle single faces of large synthetic groups, rebuilding the
+		// whole group each time and rebuilding in place
+		const U32 NUM_FACES[] = { 1000, 4000, 16000 };
+		const S32 NUM_TOGGLES = 100;
+
+		for (S32 g = 0; g < 3; ++g)
+		{
+			SynthGroup full;
+			make_group(full, NUM_FACES[g], 32);
+			full_rebuild(full);
+			SynthGroup in_place = full;
+			full_rebuild(in_place); // a layout of its own faces
+
+			LLTimer timer;
+			for (S32 i = 0; i < NUM_TOGGLES; ++i)
+			{
+				full.mFaces[ll_rand(NUM_FACES[g])].mSeed ^= 1;
+				full_rebuild(full);
+			}
+			F32 full_time = timer.getElapsedTimeF32();
+
+			timer.reset();
+			for (S32 i = 0; i < NUM_TOGGLES; ++i)
+			{
+				U32 dirty = ll_rand(NUM_FACES[g]);
+				in_place.mFaces[dirty].mSeed ^= 1;
+				ensure("in place", rebuild_in_place(in_place, dirty));
+			}
+			F32 in_place_time = timer.getElapsedTimeF32();
+
+			llinfos << NUM_FACES[g] << " faces: full rebuild " << full_time * 1000.f / NUM_TOGGLES
+					<< "ms, in place " << in_place_time * 1000.f / NUM_TOGGLES << "ms a toggle" << llendl;
+			ensure("in place is cheaper", in_place_time * 4.f < full_time);
+		}
+	}
+}
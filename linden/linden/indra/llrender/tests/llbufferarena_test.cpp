@@ -0,0 +1,433 @@
+/**
+ * @file llbufferarena_test.cpp
+ * @brief LLBufferArena tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "../llbufferarena.h"
+#include "../test/lltut.h"
+
+#include "llrand.h"
+#include "llstl.h"
+#include "lltimer.h"
+
+#include <map>
+
+namespace
+{
+	typedef std::map<U32, U32> live_map_t;	// offset to size of the blocks in use
+
+	// The blocks in use do not overlap, and the arena counts them all.
+	bool check_arena(const LLBufferArena& arena, const live_map_t& live)
+	{
+		U32 end = 0;
+		U32 used = 0;
+		for (live_map_t::const_iterator iter = live.begin(); iter != live.end(); ++iter)
+		{
+			U32 size = arena.getBlockSize(iter->first);
+			if (iter->first < end || size < iter->second || iter->first + size > arena.getSize())
+			{
+				return false;
+			}
+			end = iter->first + size;
+			used += size;
+		}
+		return used == arena.getUsedBytes() &&
+			(S32)live.size() == arena.getNumBlocks() &&
+			arena.getUsedBytes() + arena.getFreeBytes() + arena.getPendingBytes() == arena.getSize();
+	}
+
+	BOOL is_movable(void* owner)
+	{
+		// Odd owners are pinned.
+		return ((size_t)owner & 1) == 0;
+	}
+
+	// A vertex buffer of a synthetic scene: its GL buffer objects, whether
+	// its own or an arena's, and its blocks in the arenas.
+	struct SceneBuffer
+	{
+		U32 mVertexName;
+		U32 mIndexName;
+		S32 mVertexArena;
+		S32 mIndexArena;
+		S32 mVertexOffset;
+		S32 mIndexOffset;
+		U32 mVertexSize;
+		U32 mIndexSize;
+	};
+
+	// Binds as LLVertexBuffer::setBuffer() does them: only when the bound
+	// buffer object changes.
+	struct BindCounter
+	{
+		BindCounter() : mVertexName(0), mIndexName(0), mBinds(0) { }
+
+		void set(const SceneBuffer& buffer)
+		{
+			if (buffer.mVertexName != mVertexName)
+			{
+				mVertexName = buffer.mVertexName;
+				mBinds++;
+			}
+			if (buffer.mIndexName != mIndexName)
+			{
+				mIndexName = buffer.mIndexName;
+				mBinds++;
+			}
+		}
+
+		U32 mVertexName;
+		U32 mIndexName;
+		U32 mBinds;
+	};
+}
+
+namespace tut
+{
+	struct bufferarena_test
+	{
+	};
+
+	typedef test_group<bufferarena_test> bufferarena_test_t;
+	typedef bufferarena_test_t::object bufferarena_test_object_t;
+	tut::bufferarena_test_t tut_bufferarena_test("bufferarena_test");
+
+	template<> template<>
+	void bufferarena_test_object_t::test<1>()
+	{
+		// blocks are aligned, reused only once their fence is retired, and
+		// merge back into one free block
+		LLBufferArena arena(4096, 64);
+		S32 a = arena.allocate(100, NULL);
+		S32 b = arena.allocate(64, NULL);
+		S32 c = arena.allocate(1, NULL);
+		ensure_equals("first", a, 0);
+		ensure_equals("rounded up", b, 128);
+		ensure_equals("third", c, 192);
+		ensure_equals("smallest block", arena.getBlockSize(c), 64U);
+		ensure_equals("used", arena.getUsedBytes(), 256U);
+
+		arena.free(b, 1);
+		ensure_equals("pending", arena.getPendingBytes(), 64U);
+		ensure_equals("not reused before its fence", arena.allocate(64, NULL), 256);
+		arena.retire(0);
+		ensure_equals("still pending", arena.getPendingBytes(), 64U);
+		arena.retire(1);
+		ensure_equals("retired", arena.getPendingBytes(), 0U);
+		ensure_equals("reused after its fence", arena.allocate(64, NULL), 128);
+
+		ensure_equals("too big", arena.allocate(4096, NULL), -1);
+
+		arena.free(a, 2);
+		arena.free(128, 2);
+		arena.free(c, 3);
+		arena.free(256, 3);
+		arena.retire(3);
+		ensure("empty", arena.isEmpty());
+		ensure_equals("one free block", arena.getLargestFree(), 4096U);
+		ensure_equals("not fragmented", arena.getFragmentation(), 0.f);
+		ensure_equals("whole", arena.allocate(4096, NULL), 0);
+	}
+
+	template<> template<>
+	void bufferarena_test_object_t::test<2>()
+	{
+		// a block comes from the lowest free block that fits, of its size
+		// class or above
+		LLBufferArena arena(64 * 64, 64);
+		S32 offsets[8];
+		U32 sizes[8] = { 64, 256, 64, 512, 64, 128, 64, 256 };
+		for (S32 i = 0; i < 8; ++i)
+		{
+			offsets[i] = arena.allocate(sizes[i], NULL);
+		}
+		for (S32 i = 1; i < 8; i += 2)
+		{
+			arena.free(offsets[i], 0);
+		}
+		arena.retire(0);
+		ensure("fragmented", arena.getFragmentation() > 0.f);
+
+		ensure_equals("fits the first hole", arena.allocate(256, NULL), offsets[1]);
+		ensure_equals("a larger class", arena.allocate(192, NULL), offsets[3]);
+		ensure_equals("the rest of it", arena.allocate(320, NULL), offsets[3] + 192);
+		ensure_equals("its own class", arena.allocate(128, NULL), offsets[5]);
+	}
+
+	template<> template<>
+	void bufferarena_test_object_t::test<3>()
+	{
+		// random allocations and frees never overlap and are all counted
+		LLBufferArena arena(1024 * 1024, 64);
+		live_map_t live;
+		U32 fence = 0;
+		for (S32 i = 0; i < 20000; ++i)
+		{
+			if (live.empty() || ll_rand(3) != 0)
+			{
+				U32 size = 1 + ll_rand(ll_rand(2) ? 1024 : 32768);
+				S32 offset = arena.allocate(size, NULL);
+				if (offset >= 0)
+				{
+					ensure("not in use", live.find(offset) == live.end());
+					live[offset] = size;
+				}
+			}
+			else
+			{
+				live_map_t::iterator iter = live.lower_bound(ll_rand(arena.getSize()));
+				if (iter == live.end())
+				{
+					iter = live.begin();
+				}
+				arena.free(iter->first, fence);
+				live.erase(iter);
+			}
+			if (i % 16 == 0)
+			{
+				arena.retire(fence - llmin(fence, 2U));
+				fence++;
+			}
+			if (i % 1000 == 0)
+			{
+				ensure("consistent", check_arena(arena, live));
+			}
+		}
+		ensure("consistent at the end", check_arena(arena, live));
+	}
+
+	template<> template<>
+	void bufferarena_test_object_t::test<4>()
+	{
+		// defragmenting moves blocks down into the holes, but not pinned
+		// ones, and the owners can follow them
+		LLBufferArena arena(256 * 1024, 64);
+		live_map_t live;
+		std::map<U32, size_t> owners;
+		for (S32 i = 0; i < 1000; ++i)
+		{
+			U32 size = 64 + ll_rand(512);
+			size_t owner = (i + 1) * 2 + ((i % 10 == 0) ? 1 : 0);	// every tenth one pinned
+			S32 offset = arena.allocate(size, (void*)owner);
+			if (offset < 0)
+			{
+				break;
+			}
+			live[offset] = size;
+			owners[offset] = owner;
+		}
+		// Free two thirds of them.
+		S32 i = 0;
+		for (live_map_t::iterator iter = live.begin(); iter != live.end(); ++i)
+		{
+			if (i % 3)
+			{
+				arena.free(iter->first, 0);
+				owners.erase(iter->first);
+				live.erase(iter++);
+			}
+			else
+			{
+				++iter;
+			}
+		}
+		arena.retire(0);
+		U32 high_water = arena.getHighWater();
+		F32 fragmentation = arena.getFragmentation();
+
+		std::vector<LLBufferArena::Move> moves;
+		arena.defragment(U32_MAX, 1, moves, is_movable);
+		ensure("moved some", !moves.empty());
+		for (U32 m = 0; m < moves.size(); ++m)
+		{
+			const LLBufferArena::Move& move = moves[m];
+			ensure("down", move.mTo < move.mFrom);
+			ensure("not pinned", is_movable(move.mOwner));
+			ensure_equals("its owner", (size_t)move.mOwner, owners[move.mFrom]);
+			ensure_equals("its size", move.mSize, arena.getBlockSize(move.mTo));
+			live[move.mTo] = live[move.mFrom];
+			owners[move.mTo] = owners[move.mFrom];
+			live.erase(move.mFrom);
+			owners.erase(move.mFrom);
+		}
+		ensure("consistent", check_arena(arena, live));
+		ensure_equals("left blocks pending", arena.getPendingBytes() > 0, true);
+		arena.retire(1);
+		ensure("lower", arena.getHighWater() < high_water);
+		ensure("less fragmented", arena.getFragmentation() < fragmentation);
+
+		// A budget stops it early.
+		moves.clear();
+		LLBufferArena small(64 * 64, 64);
+		for (S32 j = 0; j < 64; ++j)
+		{
+			small.allocate(64, (void*)(size_t)((j + 1) * 2));
+		}
+		for (S32 j = 0; j < 32; ++j)
+		{
+			small.free(j * 64, 0);
+		}
+		small.retire(0);
+		ensure_equals("within the budget", small.defragment(256, 1, moves), 256U);
+		ensure_equals("four moved", moves.size(), 4U);
+		ensure_equals("the last first", moves[0].mFrom, 63U * 64U);
+		ensure_equals("to the first hole", moves[0].mTo, 0U);
+	}
+
+	template<> template<>
+	void bufferarena_test_object_t::test<5>()
+	{
+		// a synthetic scene of small face and group buffers, rebuilt now and
+		// then, drawn with a buffer object each and out of shared arenas:
+		// binds and buffer objects made per frame, and the arenas' time
+		const S32 NUM_BUFFERS = 5000;
+		const S32 NUM_FRAMES = 100;
+		const S32 REBUILDS_PER_FRAME = 100;
+		const U32 VERTEX_ARENA_SIZE = 4 * 1024 * 1024;
+		const U32 INDEX_ARENA_SIZE = 1024 * 1024;
+		const U32 FENCE_FRAMES = 3;
+
+		std::vector<SceneBuffer> own(NUM_BUFFERS);
+		std::vector<SceneBuffer> shared(NUM_BUFFERS);
+		std::vector<LLBufferArena*> vertex_arenas;
+		std::vector<LLBufferArena*> index_arenas;
+		U32 next_name = 1;
+
+		// As LLVertexBuffer does it, without the GL: the arena the buffer
+		// was in first, then any, then a new one.
+		struct Allocator
+		{
+			static S32 allocate(std::vector<LLBufferArena*>& arenas, U32 arena_size, U32 size, void* owner,
+								U32& next_name, S32& arena_index)
+			{
+				if (arena_index >= 0)
+				{
+					S32 offset = arenas[arena_index]->allocate(size, owner);
+					if (offset >= 0)
+					{
+						return offset;
+					}
+				}
+				for (U32 a = 0; a < arenas.size(); ++a)
+				{
+					S32 offset = arenas[a]->allocate(size, owner);
+					if (offset >= 0)
+					{
+						arena_index = a;
+						return offset;
+					}
+				}
+				arenas.push_back(new LLBufferArena(arena_size));
+				next_name++;
+				arena_index = arenas.size() - 1;
+				return arenas.back()->allocate(size, owner);
+			}
+		};
+
+		U32 own_names_made = 0;
+		F32 arena_time = 0.f;
+		LLTimer timer;
+		for (S32 i = 0; i < NUM_BUFFERS; ++i)
+		{
+			U32 verts = 4 + ll_rand(i % 20 ? 200 : 2000);
+			own[i].mVertexSize = shared[i].mVertexSize = verts * 40;
+			own[i].mIndexSize = shared[i].mIndexSize = verts * 3 / 2 * sizeof(U16);
+			own[i].mVertexName = next_name++;
+			own[i].mIndexName = next_name++;
+			own_names_made += 2;
+			shared[i].mVertexArena = shared[i].mIndexArena = -1;
+
+			timer.reset();
+			shared[i].mVertexOffset = Allocator::allocate(vertex_arenas, VERTEX_ARENA_SIZE, shared[i].mVertexSize,
+														  &shared[i], next_name, shared[i].mVertexArena);
+			shared[i].mIndexOffset = Allocator::allocate(index_arenas, INDEX_ARENA_SIZE, shared[i].mIndexSize,
+														 &shared[i], next_name, shared[i].mIndexArena);
+			arena_time += timer.getElapsedTimeF32();
+			shared[i].mVertexName = 1000000 + shared[i].mVertexArena;
+			shared[i].mIndexName = 2000000 + shared[i].mIndexArena;
+		}
+		U32 startup_arenas = vertex_arenas.size() + index_arenas.size();
+
+		BindCounter own_binds;
+		BindCounter shared_binds;
+		U32 own_rebuild_names = 0;
+		for (S32 frame = 1; frame <= NUM_FRAMES; ++frame)
+		{
+			timer.reset();
+			for (U32 a = 0; a < vertex_arenas.size(); ++a)
+			{
+				vertex_arenas[a]->retire(frame - llmin((U32)frame, FENCE_FRAMES));
+			}
+			for (U32 a = 0; a < index_arenas.size(); ++a)
+			{
+				index_arenas[a]->retire(frame - llmin((U32)frame, FENCE_FRAMES));
+			}
+			for (S32 r = 0; r < REBUILDS_PER_FRAME; ++r)
+			{
+				SceneBuffer& buffer = shared[ll_rand(NUM_BUFFERS)];
+				vertex_arenas[buffer.mVertexArena]->free(buffer.mVertexOffset, frame);
+				index_arenas[buffer.mIndexArena]->free(buffer.mIndexOffset, frame);
+				buffer.mVertexOffset = Allocator::allocate(vertex_arenas, VERTEX_ARENA_SIZE, buffer.mVertexSize,
+														   &buffer, next_name, buffer.mVertexArena);
+				buffer.mIndexOffset = Allocator::allocate(index_arenas, INDEX_ARENA_SIZE, buffer.mIndexSize,
+														  &buffer, next_name, buffer.mIndexArena);
+				buffer.mVertexName = 1000000 + buffer.mVertexArena;
+				buffer.mIndexName = 2000000 + buffer.mIndexArena;
+				// With a buffer object each, a static buffer is remade.
+				own_rebuild_names += 2;
+			}
+			arena_time += timer.getElapsedTimeF32();
+
+			// Drawn in the order they were made, as walking the octree
+			// about visits the groups in the order they were built.
+			for (S32 b = 0; b < NUM_BUFFERS; ++b)
+			{
+				own_binds.set(own[b]);
+				shared_binds.set(shared[b]);
+			}
+		}
+
+		U32 arenas = vertex_arenas.size() + index_arenas.size();
+		llinfos << NUM_BUFFERS << " buffers over " << NUM_FRAMES << " frames: with a buffer object each "
+				<< own_binds.mBinds / NUM_FRAMES << " binds and " << own_rebuild_names / NUM_FRAMES
+				<< " buffer objects made a frame, " << own_names_made << " in all; in " << arenas << " arenas "
+				<< shared_binds.mBinds / NUM_FRAMES << " binds a frame, "
+				<< arena_time * 1000.f / (NUM_FRAMES + 1) << "ms a frame in the arenas" << llendl;
+
+		ensure("a fraction of the binds", shared_binds.mBinds * 4 < own_binds.mBinds);
+		ensure("arenas kept up", arenas <= startup_arenas + 2);
+
+		for_each(vertex_arenas.begin(), vertex_arenas.end(), DeletePointer());
+		for_each(index_arenas.begin(), index_arenas.end(), DeletePointer());
+	}
+}
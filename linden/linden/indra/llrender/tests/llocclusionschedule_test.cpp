@@ -0,0 +1,318 @@
+/**
+ * @file llocclusionschedule_test.cpp
+ * @brief LLOcclusionSchedule tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "../llocclusionschedule.h"
+#include "../test/lltut.h"
+
+#include <vector>
+
+namespace
+{
+	const S32 NUM_GROUPS = 2000;
+	const S32 NUM_FRAMES = 600;
+	const S32 MOVING_FRAMES = 300;	// the view moves for these, then holds still
+
+	// A small random number generator of its own, so runs compare alike
+	U32 next_random(U32& seed)
+	{
+		seed = seed * 1664525 + 1013904223;
+		return seed >> 16;
+	}
+
+	// Whether group g of a synthetic scene is occluded in frame: while the
+	// view moves each group comes in and out of view every few dozen frames,
+	// and once it holds still only a few, behind moving things, still do.
+	bool is_occluded(S32 g, S32 frame)
+	{
+		S32 span = 20 + g % 13;
+		if (frame >= MOVING_FRAMES)
+		{
+			if (g % 100 != 0)
+			{
+				frame = MOVING_FRAMES - 1;
+			}
+			span = 50;
+		}
+		return ((g * 7919 + frame / span) % 3) == 0;
+	}
+
+	// A group of the scene as the renderer sees it, and its query on a
+	// simulated GPU that answers after one to three frames.
+	struct SynthGroup
+	{
+		SynthGroup()
+		:	mOccluded(false), mPending(false), mReady(0), mAnswer(false),
+			mPeriod(1), mIndex(0)
+		{ }
+
+		bool mOccluded;
+		bool mPending;
+		S32 mReady;		// frame the answer is available in
+		bool mAnswer;
+		S32 mPeriod;	// how often a visible group is asked
+		S32 mIndex;
+		LLOcclusionSchedule mSchedule;
+	};
+
+	struct Counts
+	{
+		Counts() : mQueries(0), mStalls(0), mPopping(0) { }
+
+		S32 mQueries;
+		S32 mStalls;	// reads that had to wait for the GPU
+		S32 mPopping;	// frames a visible group was left out
+	};
+
+	void make_groups(std::vector<SynthGroup>& groups)
+	{
+		groups.resize(NUM_GROUPS);
+		for (S32 g = 0; g < NUM_GROUPS; ++g)
+		{
+			groups[g].mIndex = g;
+			groups[g].mPeriod = g % 2 ? 16 : 1;
+		}
+	}
+
+	void issue(SynthGroup& group, S32 frame, U32& seed, Counts& counts)
+	{
+		group.mPending = true;
+		group.mReady = frame + 1 + next_random(seed) % 3;
+		group.mAnswer = is_occluded(group.mIndex, frame);
+		counts.mQueries++;
+	}
+
+	// Runs the scene, reading answers as they are asked for and asking
+	// again whenever a group is visible in its LOD frame or occluded, as
+	// checkOcclusion() and doOcclusion() did before the schedule.
+	Counts run_blocking()
+	{
+		std::vector<SynthGroup> groups;
+		make_groups(groups);
+		Counts counts;
+		U32 seed = 1;
+
+		for (S32 frame = 0; frame < NUM_FRAMES; ++frame)
+		{
+			for (S32 g = 0; g < NUM_GROUPS; ++g)
+			{
+				SynthGroup& group = groups[g];
+				bool was_visible = !group.mOccluded;
+				if (group.mPending)
+				{
+					if (frame < group.mReady)
+					{
+						counts.mStalls++;
+					}
+					group.mOccluded = group.mAnswer;
+					group.mPending = false;
+				}
+				else
+				{
+					group.mOccluded = false;
+				}
+
+				if (group.mOccluded && !is_occluded(g, frame))
+				{
+					counts.mPopping++;
+				}
+
+				if (group.mOccluded || !was_visible || frame % group.mPeriod == g % group.mPeriod)
+				{
+					issue(group, frame, seed, counts);
+				}
+			}
+		}
+		return counts;
+	}
+
+	// The same scene with LLOcclusionSchedule deciding, as checkOcclusion()
+	// and doOcclusion() do now.
+	Counts run_scheduled(S32 max_latency)
+	{
+		std::vector<SynthGroup> groups;
+		make_groups(groups);
+		Counts counts;
+		U32 seed = 1;
+
+		for (S32 frame = 0; frame < NUM_FRAMES; ++frame)
+		{
+			BOOL still = frame > MOVING_FRAMES;
+			for (S32 g = 0; g < NUM_GROUPS; ++g)
+			{
+				SynthGroup& group = groups[g];
+				LLOcclusionSchedule& schedule = group.mSchedule;
+				bool was_visible = !group.mOccluded;
+				if (group.mPending)
+				{
+					BOOL available = frame >= group.mReady;
+					if (schedule.isReadable(frame, available, max_latency))
+					{
+						if (!available)
+						{
+							counts.mStalls++;
+						}
+						group.mOccluded = group.mAnswer;
+						group.mPending = false;
+						schedule.answer(frame, group.mAnswer);
+					}
+				}
+				else if (group.mOccluded && !schedule.isCurrent(frame, group.mPeriod, still))
+				{
+					group.mOccluded = false;
+				}
+
+				if (group.mOccluded && !is_occluded(g, frame))
+				{
+					counts.mPopping++;
+				}
+
+				if (!group.mPending &&
+					((!group.mOccluded && !was_visible) ||
+					 schedule.isDue(frame, group.mPeriod, group.mOccluded, still)))
+				{
+					issue(group, frame, seed, counts);
+					schedule.issue(frame);
+				}
+			}
+		}
+		return counts;
+	}
+}
+
+namespace tut
+{
+	struct occlusionschedule_test
+	{
+	};
+	typedef test_group<occlusionschedule_test> occlusionschedule_test_t;
+	typedef occlusionschedule_test_t::object occlusionschedule_test_object_t;
+	tut::occlusionschedule_test_t tut_occlusionschedule_test("occlusionschedule_test");
+
+	template<> template<>
+	void occlusionschedule_test_object_t::test<1>()
+	{
+		// answers are read once available, or once they are too old to wait for
+		LLOcclusionSchedule schedule;
+		ensure("nothing to read", !schedule.isReadable(10, TRUE, 2));
+		ensure("due with no answer", schedule.isDue(10, 16, FALSE, FALSE));
+
+		schedule.issue(10);
+		ensure("pending", schedule.isPending());
+		ensure("not due while pending", !schedule.isDue(11, 1, TRUE, FALSE));
+		ensure("not in yet", !schedule.isReadable(11, FALSE, 2));
+		ensure("in", schedule.isReadable(11, TRUE, 2));
+		ensure("too old to wait for", schedule.isReadable(12, FALSE, 2));
+		ensure("waits at once with no latency", schedule.isReadable(10, FALSE, 0));
+
+		schedule.answer(11, TRUE);
+		ensure("answered", !schedule.isPending() && schedule.hasAnswer());
+		ensure("occluded", schedule.isOccluded());
+		ensure_equals("answered frame", schedule.getAnsweredFrame(), 11);
+
+		schedule.issue(12);
+		schedule.discard();
+		ensure("dropped", !schedule.isPending());
+		ensure("keeps the answer", schedule.isOccluded());
+
+		schedule.reset();
+		ensure("forgotten", !schedule.hasAnswer() && !schedule.isOccluded());
+	}
+
+	template<> template<>
+	void occlusionschedule_test_object_t::test<2>()
+	{
+		// intervals back off for answers that hold, only while the view holds still
+		LLOcclusionSchedule schedule;
+		ensure_equals("occluded, no answer", schedule.getInterval(16, TRUE, TRUE), 1);
+		ensure_equals("visible, no answer", schedule.getInterval(16, FALSE, TRUE), 16);
+
+		for (S32 i = 0; i < 4; ++i)
+		{
+			schedule.issue(i);
+			schedule.answer(i, TRUE);
+		}
+		ensure_equals("occluded, moving", schedule.getInterval(16, TRUE, FALSE), 1);
+		ensure_equals("occluded, still", schedule.getInterval(16, TRUE, TRUE),
+					  1 << LLOcclusionSchedule::MAX_BACKOFF);
+		ensure_equals("visible against an occluded answer", schedule.getInterval(16, FALSE, TRUE), 16);
+
+		ensure("current", schedule.isCurrent(4, 16, TRUE));
+		ensure("not current once moving", !schedule.isCurrent(5, 16, FALSE));
+		ensure("not current once old", !schedule.isCurrent(3 + 2 * (1 << LLOcclusionSchedule::MAX_BACKOFF), 16, TRUE));
+
+		S32 due = 0;
+		for (S32 frame = 100; frame < 164; ++frame)
+		{
+			due += schedule.isDue(frame, 16, TRUE, TRUE) ? 1 : 0;
+		}
+		ensure_equals("due every fourth frame", due, 16);
+
+		schedule.issue(10);
+		schedule.answer(10, FALSE);
+		ensure_equals("a new answer starts over", schedule.getInterval(16, FALSE, TRUE), 16);
+		ensure("visible is never current", !schedule.isCurrent(10, 16, TRUE));
+		schedule.issue(11);
+		schedule.answer(11, FALSE);
+		ensure_equals("visible, held once", schedule.getInterval(16, FALSE, TRUE), 32);
+	}
+
+	template<> template<>
+	void occlusionschedule_test_object_t::test<3>()
+	{
+		// a synthetic scene on a GPU that answers one to three frames late:
+		// reads that wait, and queries a frame, before and with the schedule
+		Counts blocking = run_blocking();
+		Counts scheduled = run_scheduled(2);
+
+		llinfos << NUM_GROUPS << " groups, " << NUM_FRAMES << " frames: blocking reads "
+				<< (F32) blocking.mQueries / NUM_FRAMES << " queries and "
+				<< (F32) blocking.mStalls / NUM_FRAMES << " stalls a frame, "
+				<< blocking.mPopping << " group frames left out; scheduled "
+				<< (F32) scheduled.mQueries / NUM_FRAMES << " queries and "
+				<< (F32) scheduled.mStalls / NUM_FRAMES << " stalls a frame, "
+				<< scheduled.mPopping << " group frames left out" << llendl;
+
+		ensure("fewer stalls", scheduled.mStalls * 4 < blocking.mStalls);
+		ensure("fewer queries", scheduled.mQueries < blocking.mQueries);
+		ensure("few more left out", scheduled.mPopping < blocking.mPopping + NUM_GROUPS * NUM_FRAMES / 100);
+
+		Counts patient = run_scheduled(3);
+		ensure_equals("none wait for answers never later than that", patient.mStalls, 0);
+
+		Counts waiting = run_scheduled(0);
+		ensure("no latency waits as before", waiting.mStalls > 0);
+	}
+}
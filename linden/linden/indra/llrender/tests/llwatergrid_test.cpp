@@ -0,0 +1,321 @@
+/**
+ * @file llwatergrid_test.cpp
+ * @brief LLWaterGrid tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+
+#include "linden_common.h"
+
+#include "../llwatergrid.h"
+#include "../test/lltut.h"
+
+#include "llvertexxform.h"
+#include "lltimer.h"
+
+namespace
+{
+	// Interleaved like the water draw pool's vertex buffers
+	struct WaterVertex
+	{
+		LLVector3 mPosition;
+		LLVector3 mNormal;
+		LLVector2 mTexCoord;
+	};
+
+	const S32 GRID_SIZE = 16;	// as LLVOWater has it
+	const F32 TOLERANCE = 1.0e-3f;
+
+	struct Patch
+	{
+		LLVector3 mPosition;	// center
+		LLVector3 mScale;
+	};
+
+	// The water of a 7x7 region view, as LLWorld::updateWaterObjects() lays
+	// it out: a patch for each region, and eight edge patches out to the horizon.
+	void make_view(std::vector<Patch>& patches)
+	{
+		const F32 rwidth = 256.f;
+		const F32 water_height = 20.f;
+		const S32 regions = 7;
+		const F32 range = (regions / 2) * rwidth;
+		for (S32 y = 0; y < regions; ++y)
+		{
+			for (S32 x = 0; x < regions; ++x)
+			{
+				Patch patch;
+				patch.mPosition.setVec((x + 0.5f) * rwidth, (y + 0.5f) * rwidth, water_height);
+				patch.mScale.setVec(rwidth, rwidth, 0.f);
+				patches.push_back(patch);
+			}
+		}
+
+		const F32 width = rwidth + 2.f * range;
+		const F32 horizon_extend = 2048.f + 512.f - range;
+		const F32 box_height = 1024.f;
+		const F32 center = regions * rwidth * 0.5f;
+		for (S32 dir = 0; dir < 8; ++dir)
+		{
+			static const S32 axes[8][2] = { {1, 0}, {0, 1}, {-1, 0}, {0, -1}, {1, 1}, {-1, 1}, {-1, -1}, {1, -1} };
+			Patch patch;
+			patch.mScale.setVec(axes[dir][0] == 0 ? width : horizon_extend + 1.f,
+								axes[dir][1] == 0 ? width : horizon_extend + 1.f,
+								box_height);
+			patch.mPosition.setVec(center + (width + horizon_extend) * 0.5f * axes[dir][0],
+								   center + (width + horizon_extend) * 0.5f * axes[dir][1],
+								   water_height + box_height * 0.5f);
+			patches.push_back(patch);
+		}
+	}
+
+	// A patch's geometry as LLVOWater::updateGeometry() worked it out
+	// before the grid was shared, a vertex at a time.
+	void build_per_vertex(const Patch& patch, WaterVertex* vertices, U16* indices)
+	{
+		S32 size = GRID_SIZE;
+		F32 step_x = patch.mScale.mV[0] / size;
+		F32 step_y = patch.mScale.mV[1] / size;
+
+		const LLVector3 up(0.f, step_y * 0.5f, 0.f);
+		const LLVector3 right(step_x * 0.5f, 0.f, 0.f);
+		const LLVector3 normal(0.f, 0.f, 1.f);
+
+		F32 size_inv = 1.f / size;
+
+		for (S32 y = 0; y < size; y++)
+		{
+			for (S32 x = 0; x < size; x++)
+			{
+				S32 toffset = 4*(y*size + x);
+				LLVector3 position_agent = patch.mPosition - patch.mScale * 0.5f;
+				position_agent.mV[VX] += (x + 0.5f) * step_x;
+				position_agent.mV[VY] += (y + 0.5f) * step_y;
+
+				(vertices++)->mPosition = position_agent - right + up;
+				(vertices++)->mPosition = position_agent - right - up;
+				(vertices++)->mPosition = position_agent + right + up;
+				(vertices++)->mPosition = position_agent + right - up;
+				vertices -= 4;
+
+				(vertices++)->mTexCoord = LLVector2(x*size_inv, (y+1)*size_inv);
+				(vertices++)->mTexCoord = LLVector2(x*size_inv, y*size_inv);
+				(vertices++)->mTexCoord = LLVector2((x+1)*size_inv, (y+1)*size_inv);
+				(vertices++)->mTexCoord = LLVector2((x+1)*size_inv, y*size_inv);
+				vertices -= 4;
+
+				(vertices++)->mNormal = normal;
+				(vertices++)->mNormal = normal;
+				(vertices++)->mNormal = normal;
+				(vertices++)->mNormal = normal;
+
+				*indices++ = toffset + 0;
+				*indices++ = toffset + 1;
+				*indices++ = toffset + 2;
+
+				*indices++ = toffset + 1;
+				*indices++ = toffset + 3;
+				*indices++ = toffset + 2;
+			}
+		}
+	}
+
+	void build_from_grid(const Patch& patch, WaterVertex* vertices, U16* indices)
+	{
+		const LLWaterGrid& grid = LLWaterGrid::getGrid(GRID_SIZE);
+		grid.fill(patch.mPosition - patch.mScale * 0.5f, patch.mScale.mV[0], patch.mScale.mV[1],
+				  &vertices->mPosition, sizeof(WaterVertex),
+				  &vertices->mNormal, sizeof(WaterVertex),
+				  &vertices->mTexCoord, sizeof(WaterVertex),
+				  indices, 0);
+	}
+}
+
+namespace tut
+{
+	struct watergrid_test
+	{
+		watergrid_test()
+		{
+			LLVertexXform::useSSE2(LLVertexXform::hasSSE2());
+		}
+	};
+	typedef test_group<watergrid_test> watergrid_test_t;
+	typedef watergrid_test_t::object watergrid_test_object_t;
+	tut::watergrid_test_t tut_watergrid_test("watergrid_test");
+
+	template<> template<>
+	void watergrid_test_object_t::test<1>()
+	{
+		// grids are shared, and made as the per vertex build made them
+		const LLWaterGrid& grid = LLWaterGrid::getGrid(GRID_SIZE);
+		ensure("shared", &grid == &LLWaterGrid::getGrid(GRID_SIZE));
+		ensure("one a resolution", &grid != &LLWaterGrid::getGrid(GRID_SIZE / 2));
+		ensure_equals("vertices", grid.getNumVertices(), 4 * GRID_SIZE * GRID_SIZE);
+		ensure_equals("indices", grid.getNumIndices(), 6 * GRID_SIZE * GRID_SIZE);
+
+		std::vector<Patch> patches;
+		make_view(patches);
+		std::vector<WaterVertex> expected(grid.getNumVertices());
+		std::vector<WaterVertex> actual(grid.getNumVertices());
+		std::vector<U16> expected_indices(grid.getNumIndices());
+		std::vector<U16> actual_indices(grid.getNumIndices());
+		for (U32 p = 0; p < patches.size(); ++p)
+		{
+			build_per_vertex(patches[p], &expected[0], &expected_indices[0]);
+			build_from_grid(patches[p], &actual[0], &actual_indices[0]);
+			for (S32 i = 0; i < grid.getNumVertices(); ++i)
+			{
+				F32 scale = llmax(patches[p].mScale.mV[0], patches[p].mScale.mV[1], 1.f);
+				ensure("position", dist_vec(expected[i].mPosition, actual[i].mPosition) < TOLERANCE * scale);
+				ensure("normal", expected[i].mNormal == actual[i].mNormal);
+				ensure("tex coord", dist_vec(expected[i].mTexCoord, actual[i].mTexCoord) < TOLERANCE);
+			}
+			ensure("indices", expected_indices == actual_indices);
+		}
+
+		// indices count from the offset given
+		grid.fill(LLVector3::zero, 1.f, 1.f,
+				  &actual[0].mPosition, sizeof(WaterVertex),
+				  &actual[0].mNormal, sizeof(WaterVertex),
+				  &actual[0].mTexCoord, sizeof(WaterVertex),
+				  &actual_indices[0], 100);
+		for (S32 i = 0; i < grid.getNumIndices(); ++i)
+		{
+			ensure_equals("offset index", actual_indices[i], expected_indices[i] + 100);
+		}
+	}
+
+	template<> template<>
+	void watergrid_test_object_t::test<2>()
+	{
+		// the cost of rebuilding the water of a 7x7 region view
+		const S32 NUM_REBUILDS = 200;
+		std::vector<Patch> patches;
+		make_view(patches);
+
+		const LLWaterGrid& grid = LLWaterGrid::getGrid(GRID_SIZE);
+		std::vector<WaterVertex> vertices(grid.getNumVertices() * patches.size());
+		std::vector<U16> indices(grid.getNumIndices() * patches.size());
+
+		LLTimer timer;
+		for (S32 r = 0; r < NUM_REBUILDS; ++r)
+		{
+			for (U32 p = 0; p < patches.size(); ++p)
+			{
+				build_per_vertex(patches[p], &vertices[p * grid.getNumVertices()],
+								 &indices[p * grid.getNumIndices()]);
+			}
+		}
+		F32 per_vertex_time = timer.getElapsedTimeF32();
+
+		timer.reset();
+		for (S32 r = 0; r < NUM_REBUILDS; ++r)
+		{
+			for (U32 p = 0; p < patches.size(); ++p)
+			{
+				build_from_grid(patches[p], &vertices[p * grid.getNumVertices()],
+								&indices[p * grid.getNumIndices()]);
+			}
+		}
+		F32 grid_time = timer.getElapsedTimeF32();
+
+		// both are bound by writing the vertices out, so this is about even
+		llinfos << patches.size() << " water patches: per vertex "
+				<< per_vertex_time * 1000.f / NUM_REBUILDS << "ms, from the shared grid "
+				<< grid_time * 1000.f / NUM_REBUILDS << "ms a rebuild of the view" << llendl;
+	}
+
+	template<> template<>
+	void watergrid_test_object_t::test<3>()
+	{
+		// regions of a 7x7 view arriving one at a time: each arrival puts
+		// every water patch in place again, as LLWorld::updateWaterObjects()
+		// does, and only those that moved need their geometry rebuilt
+		const S32 NUM_SEQUENCES = 10;
+		std::vector<Patch> patches;
+		make_view(patches);
+		const U32 num_regions = patches.size() - 8;
+
+		const LLWaterGrid& grid = LLWaterGrid::getGrid(GRID_SIZE);
+		std::vector<WaterVertex> vertices(grid.getNumVertices() * patches.size());
+		std::vector<U16> indices(grid.getNumIndices() * patches.size());
+
+		S32 per_vertex_builds = 0;
+		LLTimer timer;
+		for (S32 r = 0; r < NUM_SEQUENCES; ++r)
+		{
+			for (U32 arrived = 1; arrived <= num_regions; ++arrived)
+			{
+				for (U32 p = 0; p < patches.size(); ++p)
+				{
+					if (p < num_regions && p >= arrived)
+					{
+						continue;
+					}
+					build_per_vertex(patches[p], &vertices[p * grid.getNumVertices()],
+									 &indices[p * grid.getNumIndices()]);
+					per_vertex_builds++;
+				}
+			}
+		}
+		F32 per_vertex_time = timer.getElapsedTimeF32();
+
+		S32 grid_builds = 0;
+		timer.reset();
+		for (S32 r = 0; r < NUM_SEQUENCES; ++r)
+		{
+			std::vector<Patch> built(patches.size());
+			for (U32 arrived = 1; arrived <= num_regions; ++arrived)
+			{
+				for (U32 p = 0; p < patches.size(); ++p)
+				{
+					if ((p < num_regions && p >= arrived) ||
+						(built[p].mPosition == patches[p].mPosition && built[p].mScale == patches[p].mScale))
+					{
+						continue;
+					}
+					build_from_grid(patches[p], &vertices[p * grid.getNumVertices()],
+									&indices[p * grid.getNumIndices()]);
+					built[p] = patches[p];
+					grid_builds++;
+				}
+			}
+		}
+		F32 grid_time = timer.getElapsedTimeF32();
+
+		llinfos << num_regions << " regions arriving: " << per_vertex_builds / NUM_SEQUENCES
+				<< " patch rebuilds in " << per_vertex_time * 1000.f / NUM_SEQUENCES << "ms per vertex, "
+				<< grid_builds / NUM_SEQUENCES << " in " << grid_time * 1000.f / NUM_SEQUENCES
+				<< "ms from the shared grid, skipping patches that did not move" << llendl;
+		ensure_equals("one rebuild a patch", grid_builds, (S32) patches.size() * NUM_SEQUENCES);
+		ensure("cheaper", grid_time * 4.f < per_vertex_time);
+	}
+}
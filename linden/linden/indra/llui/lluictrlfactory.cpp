@@ -40,6 +40,7 @@
 // other library includes
 #include "llcontrol.h"
 #include "lldir.h"
+#include "llmd5.h"
 #include "v4color.h"
 
 // this library includes
@@ -77,6 +78,7 @@ const S32 FLOATER_H_MARGIN = 15;
 const S32 MIN_WIDGET_HEIGHT = 10;
 
 std::vector<std::string> LLUICtrlFactory::sXUIPaths;
+std::string LLUICtrlFactory::sXUICacheDir;
 
 // UI Ctrl class for padding
 class LLUICtrlLocate : public LLUICtrl
@@ -163,6 +165,33 @@ const std::vector<std::string>& LLUICtrlFactory::getXUIPaths()
 	return sXUIPaths;
 }
 
+// static
+void LLUICtrlFactory::setXUICacheDir(const std::string& dir)
+{
+	sXUICacheDir = dir;
+	if (!sXUICacheDir.empty() && !LLFile::isdir(sXUICacheDir))
+	{
+		LLFile::mkdir(sXUICacheDir);
+	}
+}
+
+static bool read_file(const std::string& filename, std::string& contents)
+{
+	LLFILE* fp = LLFile::fopen(filename, "rb");		/* Flawfinder: ignore */
+	if (fp == NULL)
+	{
+		return false;
+	}
+	fseek(fp, 0, SEEK_END);
+	long length = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	contents.resize(length > 0 ? length : 0);
+	size_t nread = length > 0 ? fread(&contents[0], 1, length, fp) : 0;
+	fclose(fp);
+	contents.resize(nread);
+	return true;
+}
+
 //-----------------------------------------------------------------------------
 // getLayeredXMLNode()
 //-----------------------------------------------------------------------------
@@ -183,31 +212,109 @@ bool LLUICtrlFactory::getLayeredXMLNode(const std::string &xui_filename, LLXMLNo
 		}
 	}
 
-	if (!LLXMLNode::parseFile(full_filename, root, NULL))
+	std::vector<std::string> layers(1, full_filename);
+	std::vector<std::string>::const_iterator itor;
+	for (itor = sXUIPaths.begin(), ++itor; itor != sXUIPaths.end(); ++itor)
 	{
-		llwarns << "Problem reading UI description file: " << full_filename << llendl;
-		return false;
+		std::string layer_filename = gDirUtilp->findSkinnedFilename((*itor), xui_filename);
+		if (!layer_filename.empty())
+		{
+			layers.push_back(layer_filename);
+		}
+		// else no localized version of this file, that's ok, keep looking
 	}
 
-	LLXMLNodePtr updateRoot;
+	if (sXUICacheDir.empty())
+	{
+		return parseLayeredXMLNode(layers, NULL, root);
+	}
 
-	std::vector<std::string>::const_iterator itor;
+	// The sources get read anyway to check the cache against them, and are
+	// parsed from memory if it is stale.
+	std::vector<std::string> contents(layers.size());
+	LLMD5 source_hash;
+	LLMD5 layers_hash;
+	for (U32 i = 0; i < layers.size(); i++)
+	{
+		if (!read_file(layers[i], contents[i]))
+		{
+			return parseLayeredXMLNode(layers, NULL, root);
+		}
+		// The terminating null keeps "a" + "bc" and "ab" + "c" apart.
+		layers_hash.update((const U8*)layers[i].c_str(), layers[i].length() + 1);
+		source_hash.update((const U8*)layers[i].c_str(), layers[i].length() + 1);
+		source_hash.update((const U8*)contents[i].data(), contents[i].length());
+	}
+	layers_hash.finalize();
+	source_hash.finalize();
 
-	for (itor = sXUIPaths.begin(), ++itor; itor != sXUIPaths.end(); ++itor)
+	char cache_name[33];		/* Flawfinder: ignore */
+	layers_hash.hex_digest(cache_name);
+	std::string cache_filename = sXUICacheDir + gDirUtilp->getDirDelimiter() + cache_name + ".xuib";
+	U8 digest[16];
+	source_hash.raw_digest(digest);
+
+	std::string cached;
+	if (read_file(cache_filename, cached)
+		&& cached.length() > sizeof(digest)
+		&& !memcmp(cached.data(), digest, sizeof(digest))
+		&& LLXMLNode::parseBinary((const U8*)cached.data() + sizeof(digest),
+								  cached.length() - sizeof(digest), root))
 	{
-		std::string nodeName;
-		std::string updateName;
+		return true;
+	}
 
-		std::string layer_filename = gDirUtilp->findSkinnedFilename((*itor), xui_filename);
-		if(layer_filename.empty())
+	if (!parseLayeredXMLNode(layers, &contents, root))
+	{
+		return false;
+	}
+
+	// Written aside and moved into place, so that another viewer reading
+	// the same cache never sees half a file.
+	std::vector<U8> buffer(digest, digest + sizeof(digest));
+	root->writeBinary(buffer);
+	std::string temp_filename = cache_filename + ".tmp";
+	LLFILE* fp = LLFile::fopen(temp_filename, "wb");		/* Flawfinder: ignore */
+	if (fp)
+	{
+		size_t written = fwrite(&buffer[0], 1, buffer.size(), fp);
+		fclose(fp);
+		LLFile::remove(cache_filename);
+		if (written != buffer.size() || LLFile::rename(temp_filename, cache_filename) != 0)
 		{
-			// no localized version of this file, that's ok, keep looking
-			continue;
+			LLFile::remove(temp_filename);
 		}
+	}
+	return true;
+}
+
+// Parses the first of layers and merges the others on top. contents, if
+// given, holds what is in each file.
+// static
+bool LLUICtrlFactory::parseLayeredXMLNode(const std::vector<std::string>& layers,
+										  const std::vector<std::string>* contents,
+										  LLXMLNodePtr& root)
+{
+	if (contents
+		? !LLXMLNode::parseBuffer((*contents)[0].data(), (*contents)[0].length(), root, NULL)
+		: !LLXMLNode::parseFile(layers[0], root, NULL))
+	{
+		llwarns << "Problem reading UI description file: " << layers[0] << llendl;
+		return false;
+	}
+
+	LLXMLNodePtr updateRoot;
+
+	for (U32 i = 1; i < layers.size(); i++)
+	{
+		std::string nodeName;
+		std::string updateName;
 
-		if (!LLXMLNode::parseFile(layer_filename, updateRoot, NULL))
+		if (contents
+			? !LLXMLNode::parseBuffer((*contents)[i].data(), (*contents)[i].length(), updateRoot, NULL)
+			: !LLXMLNode::parseFile(layers[i], updateRoot, NULL))
 		{
-			llwarns << "Problem reading localized UI description file: " << (*itor) + gDirUtilp->getDirDelimiter() + xui_filename << llendl;
+			llwarns << "Problem reading localized UI description file: " << layers[i] << llendl;
 			return false;
 		}
 
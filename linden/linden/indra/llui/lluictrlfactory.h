@@ -80,7 +80,17 @@ public:
 
 	static const std::vector<std::string>& getXUIPaths();
 
+	// Keeps what getLayeredXMLNode() puts together from each file and its
+	// localized layers in dir, in the form of LLXMLNode::writeBinary(), and
+	// loads that instead for as long as the source files are unchanged.
+	// Empty, the default, turns this off.
+	static void setXUICacheDir(const std::string& dir);
+
 private:
+	static bool parseLayeredXMLNode(const std::vector<std::string>& layers,
+									const std::vector<std::string>* contents,
+									LLXMLNodePtr& root);
+
 	bool getLayeredXMLNodeImpl(const std::string &filename, LLXMLNodePtr& root);
 
 	typedef std::map<LLHandle<LLPanel>, std::string> built_panel_t;
@@ -92,6 +102,7 @@ private:
 	std::deque<const LLCallbackMap::map_t*> mFactoryStack;
 
 	static std::vector<std::string> sXUIPaths;
+	static std::string sXUICacheDir;
 
 	LLPanel* mDummyPanel;
 };
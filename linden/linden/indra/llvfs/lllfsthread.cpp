@@ -34,6 +34,7 @@
 #include "lllfsthread.h"
 #include "llstl.h"
 #include "llapr.h"
+#include "llfasttimer.h"
 
 //============================================================================
 
@@ -178,8 +179,11 @@ void LLLFSThread::Request::deleteRequest()
 	LLQueuedThread::QueuedRequest::deleteRequest();
 }
 
+static LLFastTimer::DeclareTimer FTM_LFS_REQUEST("LFS Request");
+
 bool LLLFSThread::Request::processRequest()
 {
+	LLFastTimer t(FTM_LFS_REQUEST);
 	bool complete = false;
 	if (mOperation ==  FILE_READ)
 	{
@@ -115,6 +115,7 @@ LLControlVariable::LLControlVariable(const std::string& name, eControlType type,
 	}
 	//Push back versus setValue'ing here, since we don't want to call a signal yet
 	mValues.push_back(initial);
+	updateCache();
 }
 
 
@@ -123,6 +124,51 @@ LLControlVariable::~LLControlVariable()
 {
 }
 
+void LLControlVariable::updateCache()
+{
+	const LLSD& value = mValues.back();
+	switch (mType)
+	{
+	case TYPE_BOOLEAN:
+		mCache.mInteger = value.asBoolean();
+		break;
+	case TYPE_S32:
+	case TYPE_U32:
+		mCache.mInteger = value.asInteger();
+		break;
+	case TYPE_F32:
+		mCache.mReal = (F32)value.asReal();
+		break;
+	case TYPE_VEC3:
+		memcpy(mCache.mVector, LLVector3(value).mV, 3 * sizeof(F32));		/* Flawfinder: ignore */
+		break;
+	case TYPE_COL3:
+		memcpy(mCache.mVector, LLColor3(value).mV, 3 * sizeof(F32));		/* Flawfinder: ignore */
+		break;
+	case TYPE_COL4:
+		memcpy(mCache.mVector, LLColor4(value).mV, 4 * sizeof(F32));		/* Flawfinder: ignore */
+		break;
+	case TYPE_VEC3D:
+		memcpy(mCache.mVector3d, LLVector3d(value).mdV, 3 * sizeof(F64));	/* Flawfinder: ignore */
+		break;
+	case TYPE_RECT:
+		{
+			LLRect rect(value);
+			mCache.mRect[0] = rect.mLeft;
+			mCache.mRect[1] = rect.mTop;
+			mCache.mRect[2] = rect.mRight;
+			mCache.mRect[3] = rect.mBottom;
+		}
+		break;
+	case TYPE_COL4U:
+		memcpy(mCache.mColor4U, LLColor4U(value).mV, 4);		/* Flawfinder: ignore */
+		break;
+	default:
+		// Strings and LLSD are read from mValues.
+		break;
+	}
+}
+
 LLSD LLControlVariable::getComparableValue(const LLSD& value)
 {
 	// *FIX:MEP - The following is needed to make the LLSD::ImplString 
@@ -184,6 +230,7 @@ void LLControlVariable::setValue(const LLSD& value, bool saved_value)
             mValues.push_back(storable_value);
 	    }
     }
+	updateCache();
 
 
     if(value_changed)
@@ -203,6 +250,7 @@ void LLControlVariable::setDefaultValue(const LLSD& value)
 	bool value_changed = (llsd_compare(getValue(), comparable_value) == FALSE);
 	resetToDefault(false);
 	mValues[0] = comparable_value;
+	updateCache();
 	if(value_changed)
 	{
 		firePropertyChanged();
@@ -233,6 +281,7 @@ void LLControlVariable::resetToDefault(bool fire_signal)
 	{
 		mValues.pop_back();
 	}
+	updateCache();
 	
 	if(fire_signal) 
 	{
@@ -256,8 +305,25 @@ LLSD LLControlVariable::getSaveValue() const
 
 LLPointer<LLControlVariable> LLControlGroup::getControl(const std::string& name)
 {
-	ctrl_name_table_t::iterator iter = mNameTable.find(name);
-	return iter == mNameTable.end() ? LLPointer<LLControlVariable>() : iter->second;
+	return findControl(name);
+}
+
+LLControlVariable* LLControlGroup::findControl(const std::string& name) const
+{
+	ctrl_name_table_t::const_iterator iter = mNameTable.find(name);
+	return iter == mNameTable.end() ? NULL : iter->second.get();
+}
+
+LLPointer<LLControlVariable> LLControlGroup::getTypedControl(const std::string& name, eControlType type)
+{
+	LLControlVariable* control = findControl(name);
+	if (control && control->isType(type))
+	{
+		return control;
+	}
+	CONTROL_ERRS << "Invalid " << typeEnumToString(type) << " control " << name << llendl;
+	// Not in the name table, so never saved.
+	return new LLControlVariable(name, type, LLSD(), LLStringUtil::null, false);
 }
 
 
@@ -305,7 +371,7 @@ std::string LLControlGroup::typeEnumToString(eControlType typeenum)
 
 BOOL LLControlGroup::declareControl(const std::string& name, eControlType type, const LLSD initial_val, const std::string& comment, BOOL persist, BOOL hidefromsettingseditor)
 {
-	LLControlVariable* existing_control = getControl(name);
+	LLControlVariable* existing_control = findControl(name);
 	if (existing_control)
  	{
 		if (persist && existing_control->isType(type))
@@ -393,10 +459,10 @@ BOOL LLControlGroup::declareLLSD(const std::string& name, const LLSD &initial_va
 
 BOOL LLControlGroup::getBOOL(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_BOOLEAN))
-		return control->get().asBoolean();
+		return control->mCache.mInteger;
 	else
 	{
 		CONTROL_ERRS << "Invalid BOOL control " << name << llendl;
@@ -406,10 +472,10 @@ BOOL LLControlGroup::getBOOL(const std::string& name)
 
 S32 LLControlGroup::getS32(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_S32))
-		return control->get().asInteger();
+		return control->mCache.mInteger;
 	else
 	{
 		CONTROL_ERRS << "Invalid S32 control " << name << llendl;
@@ -419,10 +485,10 @@ S32 LLControlGroup::getS32(const std::string& name)
 
 U32 LLControlGroup::getU32(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_U32))		
-		return control->get().asInteger();
+		return (U32)control->mCache.mInteger;
 	else
 	{
 		CONTROL_ERRS << "Invalid U32 control " << name << llendl;
@@ -432,10 +498,10 @@ U32 LLControlGroup::getU32(const std::string& name)
 
 F32 LLControlGroup::getF32(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_F32))
-		return (F32) control->get().asReal();
+		return control->mCache.mReal;
 	else
 	{
 		CONTROL_ERRS << "Invalid F32 control " << name << llendl;
@@ -445,7 +511,7 @@ F32 LLControlGroup::getF32(const std::string& name)
 
 std::string LLControlGroup::findString(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_STRING))
 		return control->get().asString();
@@ -454,7 +520,7 @@ std::string LLControlGroup::findString(const std::string& name)
 
 std::string LLControlGroup::getString(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_STRING))
 		return control->get().asString();
@@ -480,7 +546,7 @@ std::string LLControlGroup::getText(const std::string& name)
 
 LLVector3 LLControlGroup::getVector3(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_VEC3))
 		return control->get();
@@ -493,7 +559,7 @@ LLVector3 LLControlGroup::getVector3(const std::string& name)
 
 LLVector3d LLControlGroup::getVector3d(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_VEC3D))
 		return control->get();
@@ -506,7 +572,7 @@ LLVector3d LLControlGroup::getVector3d(const std::string& name)
 
 LLRect LLControlGroup::getRect(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_RECT))
 		return control->get();
@@ -552,7 +618,7 @@ LLColor4 LLControlGroup::getColor(const std::string& name)
 
 LLColor4U LLControlGroup::getColor4U(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_COL4U))
 		return control->get();
@@ -565,7 +631,7 @@ LLColor4U LLControlGroup::getColor4U(const std::string& name)
 
 LLColor4 LLControlGroup::getColor4(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_COL4))
 		return control->get();
@@ -578,7 +644,7 @@ LLColor4 LLControlGroup::getColor4(const std::string& name)
 
 LLColor3 LLControlGroup::getColor3(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_COL3))
 		return control->get();
@@ -591,7 +657,7 @@ LLColor3 LLControlGroup::getColor3(const std::string& name)
 
 LLSD LLControlGroup::getLLSD(const std::string& name)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_LLSD))
 		return control->getValue();
@@ -611,7 +677,7 @@ BOOL LLControlGroup::controlExists(const std::string& name)
 
 void LLControlGroup::setBOOL(const std::string& name, BOOL val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_BOOLEAN))
 	{
@@ -626,7 +692,7 @@ void LLControlGroup::setBOOL(const std::string& name, BOOL val)
 
 void LLControlGroup::setS32(const std::string& name, S32 val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_S32))
 	{
@@ -641,7 +707,7 @@ void LLControlGroup::setS32(const std::string& name, S32 val)
 
 void LLControlGroup::setF32(const std::string& name, F32 val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_F32))
 	{
@@ -656,7 +722,7 @@ void LLControlGroup::setF32(const std::string& name, F32 val)
 
 void LLControlGroup::setU32(const std::string& name, U32 val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_U32))
 	{
@@ -671,7 +737,7 @@ void LLControlGroup::setU32(const std::string& name, U32 val)
 
 void LLControlGroup::setString(const std::string& name, const std::string &val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_STRING))
 	{
@@ -686,7 +752,7 @@ void LLControlGroup::setString(const std::string& name, const std::string &val)
 
 void LLControlGroup::setVector3(const std::string& name, const LLVector3 &val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_VEC3))
 	{
@@ -700,7 +766,7 @@ void LLControlGroup::setVector3(const std::string& name, const LLVector3 &val)
 
 void LLControlGroup::setVector3d(const std::string& name, const LLVector3d &val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_VEC3D))
 	{
@@ -714,7 +780,7 @@ void LLControlGroup::setVector3d(const std::string& name, const LLVector3d &val)
 
 void LLControlGroup::setRect(const std::string& name, const LLRect &val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 
 	if (control && control->isType(TYPE_RECT))
 	{
@@ -728,7 +794,7 @@ void LLControlGroup::setRect(const std::string& name, const LLRect &val)
 
 void LLControlGroup::setColor4U(const std::string& name, const LLColor4U &val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_COL4U))
 	{
@@ -742,7 +808,7 @@ void LLControlGroup::setColor4U(const std::string& name, const LLColor4U &val)
 
 void LLControlGroup::setColor4(const std::string& name, const LLColor4 &val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_COL4))
 	{
@@ -756,7 +822,7 @@ void LLControlGroup::setColor4(const std::string& name, const LLColor4 &val)
 
 void LLControlGroup::setLLSD(const std::string& name, const LLSD& val)
 {
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control && control->isType(TYPE_LLSD))
 	{
@@ -775,7 +841,7 @@ void LLControlGroup::setValue(const std::string& name, const LLSD& val)
 		return;
 	}
 
-	LLControlVariable* control = getControl(name);
+	LLControlVariable* control = findControl(name);
 	
 	if (control)
 	{
@@ -1109,7 +1175,7 @@ U32 LLControlGroup::loadFromFile(const std::string& filename, bool set_default_v
 // [/RLVa:KB]
 
 		// If the control exists just set the value from the input file.
-		LLControlVariable* existing_control = getControl(name);
+		LLControlVariable* existing_control = findControl(name);
 		if(existing_control)
 		{
 			if(set_default_values)
@@ -1226,6 +1292,80 @@ void LLControlGroup::resetWarnings()
 	}
 }
 
+//============================================================================
+// LLControlHandle
+
+template <> std::string LLControlHandle<std::string>::get() const
+{
+	return mControl->getValue().asString();
+}
+
+template <> LLVector3 LLControlHandle<LLVector3>::get() const
+{
+	return LLVector3(mControl->mCache.mVector);
+}
+
+template <> LLVector3d LLControlHandle<LLVector3d>::get() const
+{
+	return LLVector3d(mControl->mCache.mVector3d);
+}
+
+template <> LLRect LLControlHandle<LLRect>::get() const
+{
+	const S32* rect = mControl->mCache.mRect;
+	return LLRect(rect[0], rect[1], rect[2], rect[3]);
+}
+
+template <> LLColor4 LLControlHandle<LLColor4>::get() const
+{
+	return LLColor4(mControl->mCache.mVector);
+}
+
+template <> LLColor3 LLControlHandle<LLColor3>::get() const
+{
+	return LLColor3(mControl->mCache.mVector);
+}
+
+template <> LLColor4U LLControlHandle<LLColor4U>::get() const
+{
+	const U8* color = mControl->mCache.mColor4U;
+	return LLColor4U(color[0], color[1], color[2], color[3]);
+}
+
+template <> LLSD LLControlHandle<LLSD>::get() const
+{
+	return mControl->getValue();
+}
+
+// The LLSD each type is stored as, the same as LLControlGroup::setX().
+static LLSD handle_value(bool val)					{ return LLSD(val); }
+static LLSD handle_value(S32 val)					{ return LLSD(val); }
+static LLSD handle_value(U32 val)					{ return LLSD((LLSD::Integer)val); }
+static LLSD handle_value(F32 val)					{ return LLSD(val); }
+static LLSD handle_value(const std::string& val)	{ return LLSD(val); }
+static LLSD handle_value(const LLSD& val)			{ return val; }
+template <class T> static LLSD handle_value(const T& val)	{ return val.getValue(); }
+
+template <class T> void LLControlHandle<T>::set(const T& val)
+{
+	mControl->setValue(handle_value(val));
+}
+
+template class LLControlHandle<bool>;
+template class LLControlHandle<S32>;
+template class LLControlHandle<U32>;
+template class LLControlHandle<F32>;
+template class LLControlHandle<std::string>;
+template class LLControlHandle<LLVector3>;
+template class LLControlHandle<LLVector3d>;
+template class LLControlHandle<LLRect>;
+template class LLControlHandle<LLColor4>;
+template class LLControlHandle<LLColor3>;
+template class LLControlHandle<LLColor4U>;
+template class LLControlHandle<LLSD>;
+
+//============================================================================
+
 template <>					void jc_rebind::rebind_callback<S32>(const LLSD &data, S32 *reciever){ *reciever = data.asInteger(); }
 template <>					void jc_rebind::rebind_callback<F32>(const LLSD &data, F32 *reciever){ *reciever = data.asReal(); }
 template <>					void jc_rebind::rebind_callback<U32>(const LLSD &data, U32 *reciever){ *reciever = data.asInteger(); }
@@ -42,6 +42,7 @@
 #include "llcontrolgroupreader.h"
 
 #include <vector>
+#include <boost/unordered_map.hpp>
 
 // *NOTE: boost::visit_each<> generates warning 4675 on .net 2003
 // Disable the warning for the boost includes.
@@ -89,6 +90,7 @@ typedef enum e_control_type
 class LLControlVariable : public LLRefCount
 {
 	friend class LLControlGroup;
+	template <class T> friend class LLControlHandle;
 	typedef boost::signal<void(const LLSD&)> signal_t;
 
 private:
@@ -100,6 +102,18 @@ private:
 	std::vector<LLSD> mValues;
 	
 	signal_t mSignal;
+
+	// The current value of the fixed size types, converted once whenever
+	// it changes, for LLControlHandle and the scalar getters to read.
+	union
+	{
+		S32	mInteger;		// TYPE_BOOLEAN, TYPE_S32, TYPE_U32
+		F32	mReal;			// TYPE_F32
+		F32	mVector[4];		// TYPE_VEC3, TYPE_COL3, TYPE_COL4
+		F64	mVector3d[3];	// TYPE_VEC3D
+		S32	mRect[4];		// TYPE_RECT
+		U8	mColor4U[4];	// TYPE_COL4U
+	} mCache;
 	
 public:
 	LLControlVariable(const std::string& name, eControlType type,
@@ -139,6 +153,7 @@ public:
 		mSignal(mValues.back());
 	}
 private:
+	void updateCache();
 	LLSD getComparableValue(const LLSD& value);
 	bool llsd_compare(const LLSD& a, const LLSD & b);
 
@@ -148,25 +163,31 @@ private:
 class LLControlGroup : public LLControlGroupReader
 {
 protected:
-	typedef std::map<std::string, LLPointer<LLControlVariable> > ctrl_name_table_t;
+	typedef boost::unordered_map<std::string, LLPointer<LLControlVariable> > ctrl_name_table_t;
 	ctrl_name_table_t mNameTable;
 	std::set<std::string> mWarnings;
 	std::string mTypeString[TYPE_COUNT];
 
 	eControlType typeStringToEnum(const std::string& typestr);
 	std::string typeEnumToString(eControlType typeenum);	
+
+	LLControlVariable* findControl(const std::string& name) const;
 public:
 	LLControlGroup();
 	~LLControlGroup();
 	void cleanup();
 	
 	LLPointer<LLControlVariable> getControl(const std::string& name);
+	// Returns the control for an LLControlHandle. If there is no such
+	// control of this type, returns a stand-in that reads as zero or empty.
+	LLPointer<LLControlVariable> getTypedControl(const std::string& name, eControlType type);
 
 	struct ApplyFunctor
 	{
 		virtual ~ApplyFunctor() {};
 		virtual void apply(const std::string& name, LLControlVariable* control) = 0;
 	};
+	// Visits the controls in no particular order.
 	void applyToAll(ApplyFunctor* func);
 	
 	BOOL declareControl(const std::string& name, eControlType type, const LLSD initial_val, const std::string& comment, BOOL persist, BOOL hidefromsettingseditor = FALSE);
@@ -242,6 +263,69 @@ public:
 	void resetWarnings();
 };
 
+// A control looked up once, for code that reads it often. Reading one of
+// the fixed size types is a load from the control, with no name lookup
+// and no LLSD conversion; strings and LLSD are still converted. set() goes
+// through LLControlVariable::setValue(), so signals fire and the value is
+// saved just as with LLControlGroup::setX().
+//
+// Boolean controls are read with LLControlHandle<bool> (BOOL is an S32).
+// Bind handles on the main thread, once the settings are loaded, e.g.
+//	static LLControlHandle<bool> render_water(gSavedSettings, "RenderWater");
+// Other threads may read the scalar types; the others can be torn.
+template <class T>
+class LLControlHandle
+{
+public:
+	LLControlHandle() {}
+	LLControlHandle(LLControlGroup& group, const std::string& name)
+	{
+		bind(group, name);
+	}
+
+	void bind(LLControlGroup& group, const std::string& name)
+	{
+		mControl = group.getTypedControl(name, getType());
+	}
+	bool isBound() const			{ return mControl.notNull(); }
+	LLControlVariable* getControl() const	{ return mControl; }
+
+	T get() const;
+	operator T() const				{ return get(); }
+	void set(const T& val);
+
+	static eControlType getType();
+
+private:
+	LLPointer<LLControlVariable> mControl;
+};
+
+template <> inline eControlType LLControlHandle<bool>::getType()			{ return TYPE_BOOLEAN; }
+template <> inline eControlType LLControlHandle<S32>::getType()			{ return TYPE_S32; }
+template <> inline eControlType LLControlHandle<U32>::getType()			{ return TYPE_U32; }
+template <> inline eControlType LLControlHandle<F32>::getType()			{ return TYPE_F32; }
+template <> inline eControlType LLControlHandle<std::string>::getType()	{ return TYPE_STRING; }
+template <> inline eControlType LLControlHandle<LLVector3>::getType()		{ return TYPE_VEC3; }
+template <> inline eControlType LLControlHandle<LLVector3d>::getType()		{ return TYPE_VEC3D; }
+template <> inline eControlType LLControlHandle<LLRect>::getType()			{ return TYPE_RECT; }
+template <> inline eControlType LLControlHandle<LLColor4>::getType()		{ return TYPE_COL4; }
+template <> inline eControlType LLControlHandle<LLColor3>::getType()		{ return TYPE_COL3; }
+template <> inline eControlType LLControlHandle<LLColor4U>::getType()		{ return TYPE_COL4U; }
+template <> inline eControlType LLControlHandle<LLSD>::getType()			{ return TYPE_LLSD; }
+
+template <> inline bool LLControlHandle<bool>::get() const	{ return mControl->mCache.mInteger != 0; }
+template <> inline S32 LLControlHandle<S32>::get() const	{ return mControl->mCache.mInteger; }
+template <> inline U32 LLControlHandle<U32>::get() const	{ return (U32)mControl->mCache.mInteger; }
+template <> inline F32 LLControlHandle<F32>::get() const	{ return mControl->mCache.mReal; }
+template <> std::string LLControlHandle<std::string>::get() const;
+template <> LLVector3 LLControlHandle<LLVector3>::get() const;
+template <> LLVector3d LLControlHandle<LLVector3d>::get() const;
+template <> LLRect LLControlHandle<LLRect>::get() const;
+template <> LLColor4 LLControlHandle<LLColor4>::get() const;
+template <> LLColor3 LLControlHandle<LLColor3>::get() const;
+template <> LLColor4U LLControlHandle<LLColor4U>::get() const;
+template <> LLSD LLControlHandle<LLSD>::get() const;
+
 ///////////////////////
 namespace jc_you_suck
 {
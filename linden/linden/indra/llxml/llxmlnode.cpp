@@ -1008,6 +1008,306 @@ void LLXMLNode::writeToOstream(std::ostream& output_stream, const std::string& i
 	}
 }
 
+//-----------------------------------------------------------------------------
+// Binary form
+//
+// header:	magic, format version, strip flags, string count
+// strings:	length, bytes; names, ids and values share the table
+// node:	name and value (string indices), then a byte of type and flags,
+//			then, as the flags say, the id, the encoding, version, length
+//			and precision, and the attribute and child counts followed by
+//			the attribute nodes and the child nodes in document order
+//
+// Numbers after the magic are variable length, seven bits to a byte, low
+// bits first. Most attributes come to five bytes or so.
+//-----------------------------------------------------------------------------
+
+static const char BINARY_MAGIC[4] = { 'L', 'L', 'X', 'B' };
+const U32 BINARY_VERSION = 1;
+const U32 BINARY_MAX_DEPTH = 256;
+
+const U8 BINARY_TYPE_MASK		= 0x07;
+const U8 BINARY_IS_ATTRIBUTE	= 0x08;
+const U8 BINARY_HAS_ID			= 0x10;
+const U8 BINARY_HAS_FORMAT		= 0x20;	// encoding, version, length or precision set
+const U8 BINARY_HAS_NODES		= 0x40;	// attributes or children
+
+static U32 binary_strip_flags()
+{
+	return (LLXMLNode::sStripEscapedStrings ? 1 : 0)
+		   | (LLXMLNode::sStripWhitespaceValues ? 2 : 0);
+}
+
+namespace
+{
+	class LLXMLBinaryWriter
+	{
+	public:
+		LLXMLBinaryWriter() {}
+
+		void putNode(LLXMLNode* node)
+		{
+			putString(node->getName() ? std::string(node->getName()->mString) : LLStringUtil::null);
+			putString(node->getValue());
+
+			U32 num_children = 0;
+			for (LLXMLNodePtr child = node->getFirstChild(); child.notNull(); child = child->getNextSibling())
+			{
+				num_children++;
+			}
+			bool has_format = node->mEncoding != LLXMLNode::ENCODING_DEFAULT
+							  || node->mVersionMajor || node->mVersionMinor
+							  || node->mLength || node->mPrecision != 64;
+			bool has_nodes = num_children || !node->mAttributes.empty();
+			mNodes.push_back(((U8)node->mType & BINARY_TYPE_MASK)
+							 | (node->mIsAttribute ? BINARY_IS_ATTRIBUTE : 0)
+							 | (node->mID.empty() ? 0 : BINARY_HAS_ID)
+							 | (has_format ? BINARY_HAS_FORMAT : 0)
+							 | (has_nodes ? BINARY_HAS_NODES : 0));
+			if (!node->mID.empty())
+			{
+				putString(node->mID);
+			}
+			if (has_format)
+			{
+				putU32((U32)node->mEncoding, mNodes);
+				putU32(node->mVersionMajor, mNodes);
+				putU32(node->mVersionMinor, mNodes);
+				putU32(node->mLength, mNodes);
+				putU32(node->mPrecision, mNodes);
+			}
+			if (!has_nodes)
+			{
+				return;
+			}
+
+			putU32((U32)node->mAttributes.size(), mNodes);
+			for (LLXMLAttribList::const_iterator iter = node->mAttributes.begin();
+				 iter != node->mAttributes.end(); ++iter)
+			{
+				putNode(iter->second);
+			}
+			putU32(num_children, mNodes);
+			for (LLXMLNodePtr child = node->getFirstChild(); child.notNull(); child = child->getNextSibling())
+			{
+				putNode(child);
+			}
+		}
+
+		void finish(std::vector<U8>& buffer)
+		{
+			buffer.insert(buffer.end(), BINARY_MAGIC, BINARY_MAGIC + sizeof(BINARY_MAGIC));
+			putU32(BINARY_VERSION, buffer);
+			putU32(binary_strip_flags(), buffer);
+			putU32((U32)mStrings.size(), buffer);
+			for (U32 i = 0; i < mStrings.size(); i++)
+			{
+				const std::string& str = *mStrings[i];
+				putU32((U32)str.length(), buffer);
+				buffer.insert(buffer.end(), str.begin(), str.end());
+			}
+			buffer.insert(buffer.end(), mNodes.begin(), mNodes.end());
+		}
+
+	private:
+		static void putU32(U32 value, std::vector<U8>& buffer)
+		{
+			while (value >= 0x80)
+			{
+				buffer.push_back((U8)(value | 0x80));
+				value >>= 7;
+			}
+			buffer.push_back((U8)value);
+		}
+
+		void putString(const std::string& str)
+		{
+			std::pair<string_map_t::iterator, bool> result =
+				mStringIndex.insert(std::make_pair(str, (U32)mStrings.size()));
+			if (result.second)
+			{
+				mStrings.push_back(&result.first->first);
+			}
+			putU32(result.first->second, mNodes);
+		}
+
+		typedef std::map<std::string, U32> string_map_t;
+		string_map_t mStringIndex;
+		std::vector<const std::string*> mStrings;
+		std::vector<U8> mNodes;
+	};
+
+	class LLXMLBinaryReader
+	{
+	public:
+		LLXMLBinaryReader(const U8* buffer, U32 length)
+		:	mPos(buffer),
+			mEnd(buffer + length),
+			mOK(true)
+		{
+		}
+
+		bool readHeader()
+		{
+			if (mEnd - mPos < (S32)sizeof(BINARY_MAGIC)
+				|| memcmp(mPos, BINARY_MAGIC, sizeof(BINARY_MAGIC)))
+			{
+				return false;
+			}
+			mPos += sizeof(BINARY_MAGIC);
+			if (getU32() != BINARY_VERSION || getU32() != binary_strip_flags())
+			{
+				return false;
+			}
+
+			// Every string takes at least a byte.
+			U32 num_strings = getU32();
+			if (!mOK || num_strings > (U32)(mEnd - mPos))
+			{
+				return false;
+			}
+			mStrings.resize(num_strings);
+			mEntries.resize(num_strings, NULL);
+			for (U32 i = 0; i < num_strings; i++)
+			{
+				U32 length = getU32();
+				if (!mOK || length > (U32)(mEnd - mPos))
+				{
+					return false;
+				}
+				mStrings[i].assign((const char*)mPos, length);
+				mPos += length;
+			}
+			return mOK;
+		}
+
+		LLXMLNodePtr getNode(U32 depth)
+		{
+			U32 name = getString();
+			U32 value = getString();
+			U8 flags = getU8();
+			if (!mOK || depth > BINARY_MAX_DEPTH)
+			{
+				mOK = false;
+				return NULL;
+			}
+
+			// Each distinct name goes through the string table once per file.
+			if (!mEntries[name])
+			{
+				mEntries[name] = gStringTable.addStringEntry(mStrings[name]);
+			}
+			LLXMLNodePtr node = new LLXMLNode(mEntries[name], (flags & BINARY_IS_ATTRIBUTE) ? TRUE : FALSE);
+			node->setValue(mStrings[value]);
+			node->mType = (LLXMLNode::ValueType)(flags & BINARY_TYPE_MASK);
+			if (flags & BINARY_HAS_ID)
+			{
+				node->mID = mStrings[getString()];
+			}
+			if (flags & BINARY_HAS_FORMAT)
+			{
+				node->mEncoding = (LLXMLNode::Encoding)getU32();
+				node->mVersionMajor = getU32();
+				node->mVersionMinor = getU32();
+				node->mLength = getU32();
+				node->mPrecision = getU32();
+			}
+			if (flags & BINARY_HAS_NODES)
+			{
+				U32 num_attributes = getU32();
+				for (U32 i = 0; mOK && i < num_attributes; i++)
+				{
+					LLXMLNodePtr attribute = getNode(depth + 1);
+					if (attribute.notNull())
+					{
+						node->addChild(attribute);
+					}
+				}
+				U32 num_children = getU32();
+				for (U32 i = 0; mOK && i < num_children; i++)
+				{
+					LLXMLNodePtr child = getNode(depth + 1);
+					if (child.notNull())
+					{
+						node->addChild(child);
+					}
+				}
+			}
+			return mOK ? node : LLXMLNodePtr(NULL);
+		}
+
+		bool atEnd() const		{ return mOK && mPos == mEnd; }
+
+	private:
+		U8 getU8()
+		{
+			if (mPos == mEnd)
+			{
+				mOK = false;
+				return 0;
+			}
+			return *mPos++;
+		}
+
+		U32 getU32()
+		{
+			U32 value = 0;
+			for (U32 shift = 0; shift < 32; shift += 7)
+			{
+				U8 byte = getU8();
+				value |= (U32)(byte & 0x7f) << shift;
+				if (!(byte & 0x80))
+				{
+					return value;
+				}
+			}
+			mOK = false;
+			return 0;
+		}
+
+		U32 getString()
+		{
+			U32 index = getU32();
+			if (index >= mStrings.size())
+			{
+				mOK = false;
+				return 0;
+			}
+			return index;
+		}
+
+		const U8* mPos;
+		const U8* mEnd;
+		bool mOK;
+		std::vector<std::string> mStrings;
+		std::vector<LLStringTableEntry*> mEntries;
+	};
+}
+
+void LLXMLNode::writeBinary(std::vector<U8>& buffer)
+{
+	LLXMLBinaryWriter writer;
+	writer.putNode(this);
+	writer.finish(buffer);
+}
+
+// static
+bool LLXMLNode::parseBinary(const U8* buffer, U32 length, LLXMLNodePtr& node)
+{
+	LLXMLBinaryReader reader(buffer, length);
+	if (reader.readHeader())
+	{
+		LLXMLNodePtr root = reader.getNode(0);
+		if (root.notNull() && reader.atEnd())
+		{
+			node = root;
+			return true;
+		}
+	}
+	node = new LLXMLNode();
+	return false;
+}
+
 void LLXMLNode::findName(const std::string& name, LLXMLNodeList &results)
 {
     LLStringTableEntry* name_entry = gStringTable.checkStringEntry(name);
@@ -42,6 +42,7 @@
 #include "expat/expat.h"
 #endif
 #include <map>
+#include <vector>
 
 #include "indra_constants.h"
 #include "llmemory.h"
@@ -149,6 +150,12 @@ public:
 		std::istream& str,
 		LLXMLNodePtr& node, 
 		LLXMLNode* defaults);
+	// Reads a tree written by writeBinary(). Fails on anything written by
+	// another format version or under different strip settings.
+	static bool parseBinary(
+		const U8* buffer,
+		U32 length,
+		LLXMLNodePtr& node);
 	static bool updateNode(
 		LLXMLNodePtr& node,
 		LLXMLNodePtr& update_node);
@@ -156,6 +163,11 @@ public:
 	static void writeHeaderToFile(LLFILE *fOut);
     void writeToFile(LLFILE *fOut, const std::string& indent = std::string());
     void writeToOstream(std::ostream& output_stream, const std::string& indent = std::string());
+	// Appends this tree to buffer in a compact binary form that loads
+	// without expat: each distinct string is stored once and interned once
+	// on load, and the type, encoding and size attributes are stored
+	// already converted.
+	void writeBinary(std::vector<U8>& buffer);
 
     // Utility
     void findName(const std::string& name, LLXMLNodeList &results);
@@ -1199,9 +1199,9 @@ remote_data
 		LLScriptIdentifier	*id4 = new LLScriptIdentifier(gLine, gColumn, $13);	
 		gAllocationManager->addAllocation(id4);
 		LLScriptIdentifier	*id5 = new LLScriptIdentifier(gLine, gColumn, $16);	
-		gAllocationManager->addAllocation(id4);
+		gAllocationManager->addAllocation(id5);
 		LLScriptIdentifier	*id6 = new LLScriptIdentifier(gLine, gColumn, $19);	
-		gAllocationManager->addAllocation(id4);
+		gAllocationManager->addAllocation(id6);
 		$$ = new LLScriptRemoteEvent(gLine, gColumn, id1, id2, id3, id4, id5, id6);
 		gAllocationManager->addAllocation($$);
 	}
@@ -1789,7 +1789,7 @@ lvalue
 		LLScriptIdentifier	*id = new LLScriptIdentifier(gLine, gColumn, $1);	
 		gAllocationManager->addAllocation(id);
 		LLScriptIdentifier	*ac = new LLScriptIdentifier(gLine, gColumn, $3);	
-		gAllocationManager->addAllocation(id);
+		gAllocationManager->addAllocation(ac);
 		$$ = new LLScriptLValue(gLine, gColumn, id, ac);
 		gAllocationManager->addAllocation($$);
 	}
@@ -33,6 +33,7 @@
 #ifndef LL_LSCRIPT_BYTECODE_H
 #define LL_LSCRIPT_BYTECODE_H
 
+#include "llmap.h"
 #include "lscript_byteconvert.h"
 #include "lscript_scope.h"
 
@@ -70,6 +71,12 @@ public:
 	U8					*mCodeChunk;
 	S32					mCurrentOffset;
 	LLScriptJumpTable	*mJumpTable;
+
+private:
+	// Makes room for size more bytes, growing geometrically.
+	void reserve(S32 size);
+
+	S32					mAllocatedSize;
 };
 
 class LLScriptScriptCodeChunk
@@ -0,0 +1,174 @@
+/**
+ * @file lscript_compile_thread.cpp
+ * @brief Compiles scripts on a worker thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "lscript_compile_thread.h"
+#include "lscript_rt_interface.h"
+#include "llfasttimer.h"
+
+//----------------------------------------------------------------------------
+
+LLScriptCompileThread::Responder::~Responder()
+{
+}
+
+//----------------------------------------------------------------------------
+
+// MAIN THREAD
+LLScriptCompileThread::LLScriptCompileThread(bool threaded)
+	: LLQueuedThread("scriptcompile", threaded)
+{
+}
+
+// MAIN THREAD
+LLScriptCompileThread::handle_t LLScriptCompileThread::compile(const std::string& src_filename,
+	const std::string& dst_filename, const std::string& err_filename, BOOL compile_to_mono,
+	const std::string& class_name, BOOL is_god_like, Responder* responder)
+{
+	handle_t handle = generateHandle();
+	CompileRequest* req = new CompileRequest(handle, PRIORITY_NORMAL, src_filename, dst_filename,
+											 err_filename, compile_to_mono, class_name, is_god_like,
+											 responder);
+	if (!addRequest(req))
+	{
+		llerrs << "request added after LLScriptCompileThread::shutdown()" << llendl;
+	}
+	mRequests.push_back(handle);
+	return handle;
+}
+
+// MAIN THREAD
+S32 LLScriptCompileThread::update(U32 max_time_ms)
+{
+	LLQueuedThread::update(max_time_ms);
+
+	// Responders may queue more compiles, so collect first and deliver after.
+	std::vector<LLPointer<Responder> > responders;
+	std::vector<BOOL> successes;
+	std::vector<std::vector<std::string> > errors;
+	for (S32 i = 0; i < (S32)mRequests.size(); )
+	{
+		handle_t handle = mRequests[i];
+		status_t status = getRequestStatus(handle);
+		if (status == STATUS_QUEUED || status == STATUS_INPROGRESS)
+		{
+			i++;
+			continue;
+		}
+		CompileRequest* req = (CompileRequest*)getRequest(handle);
+		if (req)
+		{
+			responders.push_back(req->takeResponder());
+			successes.push_back(status == STATUS_COMPLETE && req->getSuccess());
+			errors.push_back(req->getErrors());
+			completeRequest(handle);
+		}
+		mRequests.erase(mRequests.begin() + i);
+	}
+
+	for (S32 i = 0; i < (S32)responders.size(); i++)
+	{
+		if (responders[i].notNull())
+		{
+			responders[i]->completed(successes[i], errors[i]);
+		}
+	}
+	return (S32)mRequests.size();
+}
+
+//----------------------------------------------------------------------------
+
+LLScriptCompileThread::CompileRequest::CompileRequest(handle_t handle, U32 priority,
+													  const std::string& src_filename,
+													  const std::string& dst_filename,
+													  const std::string& err_filename,
+													  BOOL compile_to_mono,
+													  const std::string& class_name,
+													  BOOL is_god_like,
+													  Responder* responder)
+	: LLQueuedThread::QueuedRequest(handle, priority, 0),
+	  mSrcFilename(src_filename),
+	  mDstFilename(dst_filename),
+	  mErrFilename(err_filename),
+	  mCompileToMono(compile_to_mono),
+	  mClassName(class_name),
+	  mIsGodLike(is_god_like),
+	  mResponder(responder),
+	  mSuccess(FALSE)
+{
+}
+
+LLScriptCompileThread::CompileRequest::~CompileRequest()
+{
+}
+
+static LLFastTimer::DeclareTimer FTM_SCRIPT_COMPILE("Script Compile");
+
+bool LLScriptCompileThread::CompileRequest::processRequest()
+{
+	LLFastTimer t(FTM_SCRIPT_COMPILE);
+	mSuccess = lscript_compile(mSrcFilename.c_str(), mDstFilename.c_str(), mErrFilename.c_str(),
+							   mCompileToMono, mClassName.c_str(), mIsGodLike);
+	if (mSuccess)
+	{
+		return true;
+	}
+
+	LLFILE* fp = LLFile::fopen(mErrFilename, "r");
+	if (fp)
+	{
+		char buffer[MAX_STRING];		/*Flawfinder: ignore*/
+		while (fgets(buffer, MAX_STRING, fp))
+		{
+			std::string line(buffer);
+			LLStringUtil::stripNonprintable(line);
+			mErrors.push_back(line);
+		}
+		fclose(fp);
+	}
+	return true;
+}
+
+void LLScriptCompileThread::CompileRequest::finishRequest(bool completed)
+{
+	// Collected by LLScriptCompileThread::update()
+}
+
+// MAIN THREAD
+LLPointer<LLScriptCompileThread::Responder> LLScriptCompileThread::CompileRequest::takeResponder()
+{
+	LLPointer<Responder> responder = mResponder;
+	mResponder = NULL;
+	return responder;
+}
@@ -0,0 +1,112 @@
+/**
+ * @file lscript_compile_thread.h
+ * @brief Compiles scripts on a worker thread.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LSCRIPT_COMPILE_THREAD_H
+#define LL_LSCRIPT_COMPILE_THREAD_H
+
+#include <vector>
+
+#include "llqueuedthread.h"
+
+// Runs lscript_compile() on its own thread, so compiling a big script
+// doesn't stall the caller.
+//
+// The compiler keeps its state in globals, so it can only compile one
+// script at a time, and only on one thread. Once one of these exists,
+// all compiles should go through it.
+class LLScriptCompileThread : public LLQueuedThread
+{
+public:
+	class Responder : public LLThreadSafeRefCount
+	{
+	protected:
+		virtual ~Responder();
+	public:
+		// Called from update(), on the thread that queued the compile.
+		// errors holds the compiler's diagnostics, one per line.
+		virtual void completed(BOOL success, const std::vector<std::string>& errors) = 0;
+	};
+
+	class CompileRequest : public LLQueuedThread::QueuedRequest
+	{
+	protected:
+		virtual ~CompileRequest(); // use deleteRequest()
+
+	public:
+		CompileRequest(handle_t handle, U32 priority,
+					   const std::string& src_filename, const std::string& dst_filename,
+					   const std::string& err_filename, BOOL compile_to_mono,
+					   const std::string& class_name, BOOL is_god_like,
+					   Responder* responder);
+
+		/*virtual*/ bool processRequest();
+		/*virtual*/ void finishRequest(bool completed);
+
+		// So the responder is released on the main thread.
+		LLPointer<Responder> takeResponder();
+		BOOL getSuccess() const						{ return mSuccess; }
+		const std::vector<std::string>& getErrors() const	{ return mErrors; }
+
+	private:
+		// input
+		std::string mSrcFilename;
+		std::string mDstFilename;
+		std::string mErrFilename;
+		BOOL mCompileToMono;
+		std::string mClassName;
+		BOOL mIsGodLike;
+		LLPointer<Responder> mResponder;
+		// output
+		BOOL mSuccess;
+		std::vector<std::string> mErrors;
+	};
+
+public:
+	LLScriptCompileThread(bool threaded = true);
+
+	// Same arguments as lscript_compile(). Scripts are compiled in the
+	// order they are queued.
+	handle_t compile(const std::string& src_filename, const std::string& dst_filename,
+					 const std::string& err_filename, BOOL compile_to_mono,
+					 const std::string& class_name, BOOL is_god_like,
+					 Responder* responder);
+
+	// Hands finished compiles to their responders. Returns the number of
+	// compiles still to deliver.
+	/*virtual*/ S32 update(U32 max_time_ms);
+
+private:
+	std::vector<handle_t> mRequests;	// still to be delivered
+};
+
+#endif // LL_LSCRIPT_COMPILE_THREAD_H
@@ -33,8 +33,9 @@
 #ifndef LL_LSCRIPT_SCOPE_H
 #define LL_LSCRIPT_SCOPE_H
 
+#include <boost/unordered_map.hpp>
+
 #include "string_table.h"
-#include "llmap.h"
 #include "lscript_byteformat.h"
 
 typedef enum e_lscript_identifier_type
@@ -307,21 +308,25 @@ public:
 
 	~LLScriptScope()	
 	{
-		mEntryMap.deleteAllData();
+		for (entry_map_t::iterator iter = mEntryMap.begin(); iter != mEntryMap.end(); ++iter)
+		{
+			delete iter->second;
+		}
 	}
 
 	LLScriptScopeEntry *addEntry(const char *identifier, LSCRIPTIdentifierType idtype, LSCRIPTType type)
 	{
 		const char *name = mSTable->addString(identifier);
-		if (!mEntryMap.checkData(name))
+		LLScriptScopeEntry *&entry = mEntryMap[name];
+		if (!entry)
 		{
 			if (idtype == LIT_FUNCTION)
-				mEntryMap[name] = new LLScriptScopeEntry(name, idtype, type, mFunctionCount++);
+				entry = new LLScriptScopeEntry(name, idtype, type, mFunctionCount++);
 			else if (idtype == LIT_STATE)
-				mEntryMap[name] = new LLScriptScopeEntry(name, idtype, type, mStateCount++);
+				entry = new LLScriptScopeEntry(name, idtype, type, mStateCount++);
 			else
-				mEntryMap[name] = new LLScriptScopeEntry(name, idtype, type);
-			return mEntryMap[name];
+				entry = new LLScriptScopeEntry(name, idtype, type);
+			return entry;
 		}
 		else
 		{
@@ -333,15 +338,7 @@ public:
 	BOOL checkEntry(const char *identifier)
 	{
 		const char *name = mSTable->addString(identifier);
-		if (mEntryMap.checkData(name))
-		{
-			return TRUE;
-		}
-		else
-		{
-			// identifier already exists at this scope
-			return FALSE;
-		}
+		return mEntryMap.find(name) != mEntryMap.end();
 	}
 
 	LLScriptScopeEntry *findEntry(const char *identifier)
@@ -351,10 +348,11 @@ public:
 
 		while (scope)
 		{
-			if (scope->mEntryMap.checkData(name))
+			entry_map_t::iterator iter = scope->mEntryMap.find(name);
+			if (iter != scope->mEntryMap.end())
 			{
 				// cool, we found it at this scope
-				return scope->mEntryMap[name];
+				return iter->second;
 			}
 			scope = scope->mParentScope;
 		}
@@ -368,24 +366,26 @@ public:
 
 		while (scope)
 		{
-			if (scope->mEntryMap.checkData(name))
+			entry_map_t::iterator iter = scope->mEntryMap.find(name);
+			if (iter != scope->mEntryMap.end())
 			{
+				LLScriptScopeEntry *entry = iter->second;
 				// need to check type, and if type is function we need to check both types
 				if (idtype == LIT_FUNCTION)
 				{
-					if (scope->mEntryMap[name]->mIDType == LIT_FUNCTION)
+					if (entry->mIDType == LIT_FUNCTION)
 					{
-						return scope->mEntryMap[name];
+						return entry;
 					}
-					else if (scope->mEntryMap[name]->mIDType == LIT_LIBRARY_FUNCTION)
+					else if (entry->mIDType == LIT_LIBRARY_FUNCTION)
 					{
-						return scope->mEntryMap[name];
+						return entry;
 					}
 				}
-				else if (scope->mEntryMap[name]->mIDType == idtype)
+				else if (entry->mIDType == idtype)
 				{
 					// cool, we found it at this scope
-					return scope->mEntryMap[name];
+					return entry;
 				}
 			}
 			scope = scope->mParentScope;
@@ -398,7 +398,11 @@ public:
 		mParentScope = scope;
 	}
 
-	LLMap<const char *, LLScriptScopeEntry *>	mEntryMap;
+	// Names come from mSTable, so the same name is always the same pointer
+	// and the pointer itself can be hashed.
+	typedef boost::unordered_map<const char *, LLScriptScopeEntry *> entry_map_t;
+
+	entry_map_t							mEntryMap;
 	LLScriptScope						*mParentScope;
 	LLStringTable						*mSTable;
 	S32									mFunctionCount;
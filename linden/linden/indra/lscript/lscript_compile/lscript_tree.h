@@ -33,9 +33,13 @@
 #ifndef LL_LSCRIPT_TREE_H
 #define LL_LSCRIPT_TREE_H
 
+#include <algorithm>
+#include <vector>
+
 #include "v3math.h"
 #include "llquaternion.h"
 #include "linked_lists.h"
+#include "llstl.h"
 #include "lscript_error.h"
 #include "lscript_typecheck.h"
 #include "lscript_byteformat.h"
@@ -2309,20 +2313,25 @@ public:
 	LLScriptAllocationManager() {}
 	~LLScriptAllocationManager() 
 	{
-		mAllocationList.deleteAllData();
+		deleteAllocations();
 	}
 
+	// Each node is added once, as the parser creates it. The list used
+	// to check for duplicates, which made parsing quadratic, so that check
+	// is left to debug builds.
 	void addAllocation(LLScriptFilePosition *ptr)
 	{
-		mAllocationList.addData(ptr);
+		llassert(std::find(mAllocationList.begin(), mAllocationList.end(), ptr) == mAllocationList.end());
+		mAllocationList.push_back(ptr);
 	}
 
 	void deleteAllocations()
 	{
-		mAllocationList.deleteAllData();
+		for_each(mAllocationList.begin(), mAllocationList.end(), DeletePointer());
+		mAllocationList.clear();
 	}
 
-	LLLinkedList<LLScriptFilePosition> mAllocationList;
+	std::vector<LLScriptFilePosition *> mAllocationList;
 };
 
 extern LLScriptAllocationManager *gAllocationManager;
@@ -43,6 +43,8 @@ const U32 NO_DELETE_FLAG	= 0x0000;
 const U32 DELETE_FLAG		= 0x0001;
 const U32 CREDIT_MONEY_FLAG	= 0x0002;
 
+class LLScriptDecodedCode;
+
 // list of op code execute functions
 BOOL run_noop(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
 BOOL run_pop(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
@@ -534,8 +536,18 @@ public:
 	// Returns new set of handled events.
 	virtual U64 nextState(); 
 
+	// Runs through the decoded code unless printing, see LLScriptDecodedCode.
+	virtual F32 runQuanta(BOOL b_print, const LLUUID &id,
+						  const char **errorstr, 
+						  F32 quanta,
+						  U32& events_processed, LLTimer& timer);
+
 	void init();
 
+	// Off runs every instruction through mExecuteFuncs, for comparison.
+	static void		setUseDecodedCode( BOOL use )			{ sUseDecodedCode = use;		}
+	static BOOL		getUseDecodedCode()						{ return sUseDecodedCode;		}
+
 	BOOL (*mExecuteFuncs[0x100])(U8 *buffer, S32 &offset, BOOL b_print, const LLUUID &id);
 
 	U32						mInstructionCount;
@@ -545,6 +557,10 @@ public:
 	U32						mBytecodeSize;
 
 private:
+	LLScriptDecodedCode*	mDecodedCode;
+
+	static BOOL				sUseDecodedCode;
+
 	S32 getMajorVersion() const;
 	void		recordBoundaryError( const LLUUID &id );
 	void		setStateEventOpcoodeStartSafely( S32 state, LSCRIPTStateEventType event, const LLUUID &id );
@@ -0,0 +1,1059 @@
+/**
+ * @file lscript_decoded.cpp
+ * @brief Pre-decoded LSL2 bytecode with a threaded-dispatch interpreter.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include "lscript_decoded.h"
+#include "lscript_execute.h"
+
+// Computed goto is a GCC extension, everybody else gets a switch.
+#if defined(__GNUC__)
+#define LSO_THREADED_DISPATCH 1
+#else
+#define LSO_THREADED_DISPATCH 0
+#endif
+
+namespace
+{
+	// Bytecode to opcode enum, for decoding.
+	class LLScriptOpcodeTable
+	{
+	public:
+		LLScriptOpcodeTable()
+		{
+			for (S32 i = 0; i < 256; i++)
+			{
+				mOpcodes[i] = LOPC_INVALID;
+			}
+			// LOPC_INVALID and LOPC_NOOP share 0x00, NOOP wins as it does
+			// in LLScriptExecuteLSL2::init().
+			for (S32 i = LOPC_INVALID; i < LOPC_EOF; i++)
+			{
+				mOpcodes[LSCRIPTOpCodes[i]] = (LSCRIPTOpCodesEnum)i;
+			}
+		}
+
+		LSCRIPTOpCodesEnum mOpcodes[256];
+	};
+	const LLScriptOpcodeTable sOpcodeTable;
+
+	// Decoded kinds of the typed binary operations, in LOPC_ADD to
+	// LOPC_GREATER order. Floats have no MOD.
+	const S32 INTEGER_INTEGER_KINDS[] =
+	{
+		LLScriptDecodedCode::OP_ADD_II, LLScriptDecodedCode::OP_SUB_II, LLScriptDecodedCode::OP_MUL_II,
+		LLScriptDecodedCode::OP_DIV_II, LLScriptDecodedCode::OP_MOD_II,
+		LLScriptDecodedCode::OP_EQ_II, LLScriptDecodedCode::OP_NEQ_II, LLScriptDecodedCode::OP_LEQ_II,
+		LLScriptDecodedCode::OP_GEQ_II, LLScriptDecodedCode::OP_LESS_II, LLScriptDecodedCode::OP_GREATER_II
+	};
+	const S32 FLOAT_FLOAT_KINDS[] =
+	{
+		LLScriptDecodedCode::OP_ADD_FF, LLScriptDecodedCode::OP_SUB_FF, LLScriptDecodedCode::OP_MUL_FF,
+		LLScriptDecodedCode::OP_DIV_FF, LLScriptDecodedCode::OP_GENERIC,
+		LLScriptDecodedCode::OP_EQ_FF, LLScriptDecodedCode::OP_NEQ_FF, LLScriptDecodedCode::OP_LEQ_FF,
+		LLScriptDecodedCode::OP_GEQ_FF, LLScriptDecodedCode::OP_LESS_FF, LLScriptDecodedCode::OP_GREATER_FF
+	};
+	const S32 INTEGER_FLOAT_KINDS[] =
+	{
+		LLScriptDecodedCode::OP_ADD_IF, LLScriptDecodedCode::OP_SUB_IF, LLScriptDecodedCode::OP_MUL_IF,
+		LLScriptDecodedCode::OP_DIV_IF, LLScriptDecodedCode::OP_GENERIC,
+		LLScriptDecodedCode::OP_EQ_IF, LLScriptDecodedCode::OP_NEQ_IF, LLScriptDecodedCode::OP_LEQ_IF,
+		LLScriptDecodedCode::OP_GEQ_IF, LLScriptDecodedCode::OP_LESS_IF, LLScriptDecodedCode::OP_GREATER_IF
+	};
+	const S32 FLOAT_INTEGER_KINDS[] =
+	{
+		LLScriptDecodedCode::OP_ADD_FI, LLScriptDecodedCode::OP_SUB_FI, LLScriptDecodedCode::OP_MUL_FI,
+		LLScriptDecodedCode::OP_DIV_FI, LLScriptDecodedCode::OP_GENERIC,
+		LLScriptDecodedCode::OP_EQ_FI, LLScriptDecodedCode::OP_NEQ_FI, LLScriptDecodedCode::OP_LEQ_FI,
+		LLScriptDecodedCode::OP_GEQ_FI, LLScriptDecodedCode::OP_LESS_FI, LLScriptDecodedCode::OP_GREATER_FI
+	};
+
+	inline S32 read_int(const U8* buffer, S32 offset)
+	{
+		return bytestream2integer(buffer, offset);
+	}
+
+	inline void write_int(U8* buffer, S32 offset, S32 value)
+	{
+		integer2bytestream(buffer, offset, value);
+	}
+
+	// Unlike bytestream2float() this doesn't fault, it returns FALSE for
+	// values the original code would fault on.
+	inline BOOL read_float(const U8* buffer, S32 offset, F32& value)
+	{
+		S32 bits = bytestream2integer(buffer, offset);
+		memcpy(&value, &bits, sizeof(value));		/* Flawfinder: ignore */
+		return llfinite(value);
+	}
+
+	inline void write_float(U8* buffer, S32 offset, F32 value)
+	{
+		float2bytestream(buffer, offset, value);
+	}
+}
+
+LLScriptDecodedCode::LLScriptDecodedCode()
+:	mGFR(0),
+	mHR(0),
+	mSR(0)
+{
+}
+
+void LLScriptDecodedCode::invalidate()
+{
+	mOps.clear();
+	mOpIndex.clear();
+	mGFR = 0;
+	mHR = 0;
+	mSR = 0;
+}
+
+S32 LLScriptDecodedCode::getOp(const U8* buffer, S32 ip)
+{
+	S32 index = mOpIndex[ip - mGFR];
+	if (index < 0)
+	{
+		Op op;
+		op.mIP = ip;
+		decode(buffer, op);
+		index = (S32)mOps.size();
+		mOps.push_back(op);
+		mOpIndex[ip - mGFR] = index;
+	}
+	return index;
+}
+
+void LLScriptDecodedCode::decode(const U8* buffer, Op& op) const
+{
+	op.mKind = OP_GENERIC;
+	op.mNext = op.mIP;
+	op.mArg = 0;
+	op.mNextOp = -1;
+	op.mTargetOp = -1;
+
+	// Operands must be in the code, as safe_instruction_bytestream2*()
+	// would otherwise fault.
+	S32 offset = op.mIP + 1;
+	S32 kind = OP_GENERIC;
+	LSCRIPTOpCodesEnum opcode = sOpcodeTable.mOpcodes[buffer[op.mIP]];
+	switch (opcode)
+	{
+	case LOPC_NOOP:		kind = OP_NOOP;		break;
+	case LOPC_POP:		kind = OP_POP;		break;
+	case LOPC_POPIP:	kind = OP_POPIP;	break;
+	case LOPC_POPBP:	kind = OP_POPBP;	break;
+	case LOPC_DUP:		kind = OP_DUP;		break;
+	case LOPC_PUSHIP:	kind = OP_PUSHIP;	break;
+	case LOPC_PUSHBP:	kind = OP_PUSHBP;	break;
+	case LOPC_PUSHSP:	kind = OP_PUSHSP;	break;
+	case LOPC_BITAND:	kind = OP_BITAND;	break;
+	case LOPC_BITOR:	kind = OP_BITOR;	break;
+	case LOPC_BITXOR:	kind = OP_BITXOR;	break;
+	case LOPC_BOOLAND:	kind = OP_BOOLAND;	break;
+	case LOPC_BOOLOR:	kind = OP_BOOLOR;	break;
+	case LOPC_SHL:		kind = OP_SHL;		break;
+	case LOPC_SHR:		kind = OP_SHR;		break;
+	case LOPC_BITNOT:	kind = OP_BITNOT;	break;
+	case LOPC_BOOLNOT:	kind = OP_BOOLNOT;	break;
+	case LOPC_RETURN:	kind = OP_RETURN;	break;
+
+	case LOPC_PUSHE:
+		kind = OP_PUSHARGE;
+		op.mArg = LSCRIPTDataSize[LST_INTEGER];
+		break;
+	case LOPC_PUSHEV:
+		kind = OP_PUSHARGE;
+		op.mArg = LSCRIPTDataSize[LST_VECTOR];
+		break;
+	case LOPC_PUSHEQ:
+		kind = OP_PUSHARGE;
+		op.mArg = LSCRIPTDataSize[LST_QUATERNION];
+		break;
+
+	case LOPC_PUSHARGB:
+		if (offset + 1 <= mHR)
+		{
+			kind = OP_PUSHARGB;
+			op.mArg = buffer[offset++];
+		}
+		break;
+
+	case LOPC_POPARG:
+	case LOPC_STORE:
+	case LOPC_STOREG:
+	case LOPC_LOADP:
+	case LOPC_LOADGP:
+	case LOPC_PUSH:
+	case LOPC_PUSHG:
+	case LOPC_PUSHARGI:
+	case LOPC_PUSHARGF:
+	case LOPC_PUSHARGE:
+		if (offset + 4 <= mHR)
+		{
+			op.mArg = bytestream2integer(buffer, offset);
+			switch (opcode)
+			{
+			case LOPC_POPARG:	kind = OP_POPARG;	break;
+			case LOPC_STORE:	kind = OP_STORE;	break;
+			case LOPC_STOREG:	kind = OP_STOREG;	break;
+			case LOPC_LOADP:	kind = OP_LOADP;	break;
+			case LOPC_LOADGP:	kind = OP_LOADGP;	break;
+			case LOPC_PUSH:		kind = OP_PUSH;		break;
+			case LOPC_PUSHG:	kind = OP_PUSHG;	break;
+			case LOPC_PUSHARGI:	kind = OP_PUSHARGI;	break;
+			case LOPC_PUSHARGE:
+				// pushes nothing for negative sizes, leave that to run_pusharge()
+				kind = op.mArg >= 0 ? OP_PUSHARGE : OP_GENERIC;
+				break;
+			case LOPC_PUSHARGF:
+				{
+					// pushed as is, unless it would fault
+					F32 value;
+					kind = read_float(buffer, offset - 4, value) ? OP_PUSHARGI : OP_GENERIC;
+				}
+				break;
+			default:
+				break;
+			}
+		}
+		break;
+
+	case LOPC_ADD:
+	case LOPC_SUB:
+	case LOPC_MUL:
+	case LOPC_DIV:
+	case LOPC_MOD:
+	case LOPC_EQ:
+	case LOPC_NEQ:
+	case LOPC_LEQ:
+	case LOPC_GEQ:
+	case LOPC_LESS:
+	case LOPC_GREATER:
+		if (offset + 1 <= mHR)
+		{
+			U8 types = buffer[offset++];
+			U8 ltype = types >> 4;
+			U8 rtype = types & 0xf;
+			S32 which = opcode - LOPC_ADD;
+			if (ltype == LST_INTEGER && rtype == LST_INTEGER)
+			{
+				kind = INTEGER_INTEGER_KINDS[which];
+			}
+			else if (ltype == LST_FLOATINGPOINT && rtype == LST_FLOATINGPOINT)
+			{
+				kind = FLOAT_FLOAT_KINDS[which];
+			}
+			else if (ltype == LST_INTEGER && rtype == LST_FLOATINGPOINT)
+			{
+				kind = INTEGER_FLOAT_KINDS[which];
+			}
+			else if (ltype == LST_FLOATINGPOINT && rtype == LST_INTEGER)
+			{
+				kind = FLOAT_INTEGER_KINDS[which];
+			}
+		}
+		break;
+
+	case LOPC_NEG:
+		if (offset + 1 <= mHR)
+		{
+			U8 type = buffer[offset++];
+			if (type == LST_INTEGER)
+			{
+				kind = OP_NEG_I;
+			}
+			else if (type == LST_FLOATINGPOINT)
+			{
+				kind = OP_NEG_F;
+			}
+		}
+		break;
+
+	case LOPC_JUMP:
+		if (offset + 4 <= mHR)
+		{
+			S32 arg = bytestream2integer(buffer, offset);
+			op.mArg = offset + arg;
+			kind = OP_JUMP;
+		}
+		break;
+
+	case LOPC_JUMPIF:
+	case LOPC_JUMPNIF:
+		if (offset + 5 <= mHR)
+		{
+			U8 type = buffer[offset++];
+			S32 arg = bytestream2integer(buffer, offset);
+			op.mArg = offset + arg;
+			BOOL jumpif = (opcode == LOPC_JUMPIF);
+			if (type == LST_INTEGER)
+			{
+				kind = jumpif ? OP_JUMPIF_I : OP_JUMPNIF_I;
+			}
+			else if (type == LST_FLOATINGPOINT)
+			{
+				kind = jumpif ? OP_JUMPIF_F : OP_JUMPNIF_F;
+			}
+		}
+		break;
+
+	case LOPC_CALL:
+		if (offset + 4 <= mHR)
+		{
+			// The same lookup as run_call(), done once.
+			S32 func = bytestream2integer(buffer, offset);
+			S32 lookup = mGFR + func*4 + 4;
+			if (lookup >= mGFR && lookup < mSR && lookup + 4 <= mHR)
+			{
+				S32 function = bytestream2integer(buffer, lookup) + mGFR;
+				if (function >= mGFR && function + 4 <= mHR)
+				{
+					S32 entry = function;
+					op.mArg = function + bytestream2integer(buffer, entry);
+					kind = OP_CALL;
+				}
+			}
+		}
+		break;
+
+	default:
+		break;
+	}
+
+	// set_ip() faults on the next instruction, or the branch target, being
+	// outside the code.
+	if (kind != OP_GENERIC
+		&& (offset >= mHR
+			|| ((kind == OP_JUMP || kind == OP_CALL || (kind >= OP_JUMPIF_I && kind <= OP_JUMPNIF_F))
+				&& !isValidIP(op.mArg))))
+	{
+		kind = OP_GENERIC;
+	}
+	op.mKind = kind;
+	op.mNext = offset;
+}
+
+S32 LLScriptDecodedCode::run(LLScriptExecuteLSL2* execute, S32 max_instructions, const LLUUID& id, F32 quanta)
+{
+	U8* buffer = execute->mBuffer;
+	S32 ip = get_register(buffer, LREG_IP);
+	if (!ip || max_instructions <= 0)
+	{
+		return 0;
+	}
+
+	S32 gfr = get_register(buffer, LREG_GFR);
+	S32 hr = get_register(buffer, LREG_HR);
+	S32 sr = get_register(buffer, LREG_SR);
+	if (gfr != mGFR || hr != mHR || sr != mSR || mOpIndex.empty())
+	{
+		invalidate();
+		if (gfr <= 0 || hr <= gfr)
+		{
+			return 0;
+		}
+		mGFR = gfr;
+		mHR = hr;
+		mSR = sr;
+		mOpIndex.resize(hr - gfr, -1);
+	}
+	if (ip < gfr || ip >= hr)
+	{
+		return 0;
+	}
+
+	F32 esr;
+	if (!read_float(buffer, gLSCRIPTRegisterAddresses[LREG_ESR], esr))
+	{
+		return 0;
+	}
+
+	const S32 tm = get_register(buffer, LREG_TM);
+	const S32 gvr = get_register(buffer, LREG_GVR);
+	S32 sp = get_register(buffer, LREG_SP);
+	S32 bp = get_register(buffer, LREG_BP);
+	S32 hp = get_register(buffer, LREG_HP);
+
+	S32 executed = 0;
+	S32 fast_executed = 0;	// not yet added to mInstructionCount
+
+	S32 cur = getOp(buffer, ip);
+	Op* ops = &mOps[0];
+	Op* op = ops + cur;
+
+// The stack pointer checks of set_sp().
+#define LSO_VALID_SP(new_sp)	((new_sp) > hp && (new_sp) < tm)
+
+// Bookkeeping of resumeEventHandler(), then on to the op at new_ip. Energy
+// can't become non finite here, as ESR was finite and only 0.1 goes.
+#define LSO_FINISH(new_ip)									\
+	ip = (new_ip);											\
+	executed++;												\
+	fast_executed++;										\
+	esr += -0.1f;											\
+	if (!ip || executed >= max_instructions)				\
+	{														\
+		goto done;											\
+	}
+
+#define LSO_RESOLVE(field)									\
+	cur = op->field;										\
+	if (cur < 0)											\
+	{														\
+		S32 from = (S32)(op - ops);							\
+		cur = getOp(buffer, ip);							\
+		ops = &mOps[0];										\
+		ops[from].field = cur;								\
+	}														\
+	op = ops + cur;											\
+	LSO_DISPATCH()
+
+#define LSO_NEXT()											\
+	LSO_FINISH(op->mNext)									\
+	LSO_RESOLVE(mNextOp)
+
+#define LSO_BRANCH()										\
+	LSO_FINISH(op->mArg)									\
+	LSO_RESOLVE(mTargetOp)
+
+#define LSO_RETURN_TO(new_ip)								\
+	LSO_FINISH(new_ip)										\
+	cur = getOp(buffer, ip);								\
+	ops = &mOps[0];											\
+	op = ops + cur;											\
+	LSO_DISPATCH()
+
+#define LSO_INTEGER(name, offset)							\
+	S32 name = read_int(buffer, offset)
+
+#define LSO_FLOAT(name, offset)								\
+	F32 name;												\
+	if (!read_float(buffer, offset, name))					\
+	{														\
+		goto generic;										\
+	}
+
+// Pops two operands, left first, and pushes the result.
+#define LSO_BINARY(kind, LTYPE, RTYPE, write, expr)			\
+	LSO_CASE(kind)											\
+	{														\
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp + 8))	\
+		{													\
+			goto generic;									\
+		}													\
+		LTYPE(lside, sp);									\
+		RTYPE(rside, sp + 4);								\
+		sp += 4;											\
+		write(buffer, sp, (expr));							\
+		LSO_NEXT();											\
+	}
+
+// As above, leaving division by zero to fault in the original code.
+#define LSO_DIVIDE(kind, LTYPE, RTYPE)						\
+	LSO_CASE(kind)											\
+	{														\
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp + 8))	\
+		{													\
+			goto generic;									\
+		}													\
+		LTYPE(lside, sp);									\
+		RTYPE(rside, sp + 4);								\
+		if (!rside)											\
+		{													\
+			goto generic;									\
+		}													\
+		sp += 4;											\
+		F32 resultf = lside / rside;						\
+		write_float(buffer, sp, resultf);					\
+		LSO_NEXT();											\
+	}
+
+#if LSO_THREADED_DISPATCH
+	// In EOpKind order.
+	static void* const sDispatch[OP_COUNT] =
+	{
+		&&L_OP_GENERIC,
+		&&L_OP_NOOP,
+		&&L_OP_POP,
+		&&L_OP_POPARG,
+		&&L_OP_POPIP,
+		&&L_OP_POPBP,
+		&&L_OP_DUP,
+		&&L_OP_STORE,
+		&&L_OP_STOREG,
+		&&L_OP_LOADP,
+		&&L_OP_LOADGP,
+		&&L_OP_PUSH,
+		&&L_OP_PUSHG,
+		&&L_OP_PUSHIP,
+		&&L_OP_PUSHBP,
+		&&L_OP_PUSHSP,
+		&&L_OP_PUSHARGB,
+		&&L_OP_PUSHARGI,
+		&&L_OP_PUSHARGE,
+		&&L_OP_ADD_II, &&L_OP_SUB_II, &&L_OP_MUL_II, &&L_OP_DIV_II, &&L_OP_MOD_II,
+		&&L_OP_EQ_II, &&L_OP_NEQ_II, &&L_OP_LEQ_II, &&L_OP_GEQ_II, &&L_OP_LESS_II, &&L_OP_GREATER_II,
+		&&L_OP_BITAND, &&L_OP_BITOR, &&L_OP_BITXOR, &&L_OP_BOOLAND, &&L_OP_BOOLOR, &&L_OP_SHL, &&L_OP_SHR,
+		&&L_OP_ADD_FF, &&L_OP_SUB_FF, &&L_OP_MUL_FF, &&L_OP_DIV_FF,
+		&&L_OP_EQ_FF, &&L_OP_NEQ_FF, &&L_OP_LEQ_FF, &&L_OP_GEQ_FF, &&L_OP_LESS_FF, &&L_OP_GREATER_FF,
+		&&L_OP_ADD_IF, &&L_OP_SUB_IF, &&L_OP_MUL_IF, &&L_OP_DIV_IF,
+		&&L_OP_EQ_IF, &&L_OP_NEQ_IF, &&L_OP_LEQ_IF, &&L_OP_GEQ_IF, &&L_OP_LESS_IF, &&L_OP_GREATER_IF,
+		&&L_OP_ADD_FI, &&L_OP_SUB_FI, &&L_OP_MUL_FI, &&L_OP_DIV_FI,
+		&&L_OP_EQ_FI, &&L_OP_NEQ_FI, &&L_OP_LEQ_FI, &&L_OP_GEQ_FI, &&L_OP_LESS_FI, &&L_OP_GREATER_FI,
+		&&L_OP_NEG_I,
+		&&L_OP_NEG_F,
+		&&L_OP_BITNOT,
+		&&L_OP_BOOLNOT,
+		&&L_OP_JUMP,
+		&&L_OP_JUMPIF_I,
+		&&L_OP_JUMPIF_F,
+		&&L_OP_JUMPNIF_I,
+		&&L_OP_JUMPNIF_F,
+		&&L_OP_CALL,
+		&&L_OP_RETURN
+	};
+#define LSO_DISPATCH()	goto *sDispatch[op->mKind]
+#define LSO_CASE(kind)	L_##kind:
+
+	LSO_DISPATCH();
+#else
+#define LSO_DISPATCH()	continue
+#define LSO_CASE(kind)	case kind:
+
+	while (TRUE)
+	{
+	switch (op->mKind)
+	{
+#endif
+
+	LSO_CASE(OP_GENERIC)
+generic:
+	{
+		// The original instruction function, with the registers it might
+		// look at written back.
+		set_register(buffer, LREG_IP, op->mIP);
+		set_register(buffer, LREG_SP, sp);
+		set_register(buffer, LREG_BP, bp);
+		set_register_fp(buffer, LREG_ESR, esr);
+		execute->mInstructionCount += fast_executed;
+		fast_executed = 0;
+
+		execute->resumeEventHandler(FALSE, id, quanta);
+		executed++;
+
+		if (get_register(buffer, LREG_FR)
+			|| execute->isYieldDue()
+			|| executed >= max_instructions)
+		{
+			return executed;
+		}
+		ip = get_register(buffer, LREG_IP);
+		sp = get_register(buffer, LREG_SP);
+		bp = get_register(buffer, LREG_BP);
+		hp = get_register(buffer, LREG_HP);
+		if (ip < gfr || ip >= hr
+			|| !read_float(buffer, gLSCRIPTRegisterAddresses[LREG_ESR], esr))
+		{
+			return executed;
+		}
+		cur = getOp(buffer, ip);
+		ops = &mOps[0];
+		op = ops + cur;
+		LSO_DISPATCH();
+	}
+
+	LSO_CASE(OP_NOOP)
+	{
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_POP)
+	{
+		if (!LSO_VALID_SP(sp + 4))
+		{
+			goto generic;
+		}
+		sp += 4;
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_POPARG)
+	{
+		if (!LSO_VALID_SP(sp + op->mArg))
+		{
+			goto generic;
+		}
+		sp += op->mArg;
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_POPIP)
+	{
+		if (!LSO_VALID_SP(sp + 4))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(new_ip, sp);
+		if (!isValidIP(new_ip))
+		{
+			goto generic;
+		}
+		sp += 4;
+		LSO_RETURN_TO(new_ip);
+	}
+
+	LSO_CASE(OP_POPBP)
+	{
+		if (!LSO_VALID_SP(sp + 4))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(new_bp, sp);
+		// set_bp() checks against the SP after the pop
+		if (new_bp <= hp || new_bp >= tm || new_bp < sp + 4)
+		{
+			goto generic;
+		}
+		sp += 4;
+		bp = new_bp;
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_DUP)
+	{
+		if (sp + 4 > tm || !LSO_VALID_SP(sp - 4))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(value, sp);
+		sp -= 4;
+		write_int(buffer, sp, value);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_STORE)
+	{
+		// lscript_check_local()
+		S32 address = bp - (op->mArg + LSCRIPTDataSize[LST_INTEGER]);
+		if (sp + 4 > tm || address < sp - 4 || address + 4 > tm)
+		{
+			goto generic;
+		}
+		write_int(buffer, address, read_int(buffer, sp));
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_STOREG)
+	{
+		// lscript_check_global()
+		S32 address = op->mArg;
+		if (sp + 4 > tm || address < 0 || address + gvr + 4 > gfr)
+		{
+			goto generic;
+		}
+		write_int(buffer, address + gvr, read_int(buffer, sp));
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_LOADP)
+	{
+		// lscript_check_local() sees the SP after the pop
+		S32 address = bp - (op->mArg + LSCRIPTDataSize[LST_INTEGER]);
+		if (!LSO_VALID_SP(sp + 4) || address < sp || address + 4 > tm)
+		{
+			goto generic;
+		}
+		LSO_INTEGER(value, sp);
+		sp += 4;
+		write_int(buffer, address, value);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_LOADGP)
+	{
+		S32 address = op->mArg;
+		if (!LSO_VALID_SP(sp + 4) || address < 0 || address + gvr + 4 > gfr)
+		{
+			goto generic;
+		}
+		LSO_INTEGER(value, sp);
+		sp += 4;
+		write_int(buffer, address + gvr, value);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSH)
+	{
+		S32 address = bp - (op->mArg + LSCRIPTDataSize[LST_INTEGER]);
+		if (address < sp - 4 || address + 4 > tm || !LSO_VALID_SP(sp - 4))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(value, address);
+		sp -= 4;
+		write_int(buffer, sp, value);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSHG)
+	{
+		S32 address = op->mArg;
+		if (address < 0 || address + gvr + 4 > gfr || !LSO_VALID_SP(sp - 4))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(value, address + gvr);
+		sp -= 4;
+		write_int(buffer, sp, value);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSHIP)
+	{
+		if (!LSO_VALID_SP(sp - 4))
+		{
+			goto generic;
+		}
+		sp -= 4;
+		write_int(buffer, sp, op->mNext);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSHBP)
+	{
+		if (!LSO_VALID_SP(sp - 4))
+		{
+			goto generic;
+		}
+		sp -= 4;
+		write_int(buffer, sp, bp);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSHSP)
+	{
+		if (!LSO_VALID_SP(sp - 4))
+		{
+			goto generic;
+		}
+		// the SP from before the push
+		sp -= 4;
+		write_int(buffer, sp, sp + 4);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSHARGB)
+	{
+		if (!LSO_VALID_SP(sp - 1))
+		{
+			goto generic;
+		}
+		sp -= 1;
+		buffer[sp] = (U8)op->mArg;
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSHARGI)
+	{
+		if (!LSO_VALID_SP(sp - 4))
+		{
+			goto generic;
+		}
+		sp -= 4;
+		write_int(buffer, sp, op->mArg);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_PUSHARGE)
+	{
+		if (!LSO_VALID_SP(sp - op->mArg))
+		{
+			goto generic;
+		}
+		sp -= op->mArg;
+		memset(buffer + sp, 0, op->mArg);
+		LSO_NEXT();
+	}
+
+	LSO_BINARY(OP_ADD_II, LSO_INTEGER, LSO_INTEGER, write_int, lside + rside)
+	LSO_BINARY(OP_SUB_II, LSO_INTEGER, LSO_INTEGER, write_int, lside - rside)
+	LSO_BINARY(OP_MUL_II, LSO_INTEGER, LSO_INTEGER, write_int, lside * rside)
+	LSO_BINARY(OP_EQ_II, LSO_INTEGER, LSO_INTEGER, write_int, lside == rside)
+	LSO_BINARY(OP_NEQ_II, LSO_INTEGER, LSO_INTEGER, write_int, lside != rside)
+	LSO_BINARY(OP_LEQ_II, LSO_INTEGER, LSO_INTEGER, write_int, lside <= rside)
+	LSO_BINARY(OP_GEQ_II, LSO_INTEGER, LSO_INTEGER, write_int, lside >= rside)
+	LSO_BINARY(OP_LESS_II, LSO_INTEGER, LSO_INTEGER, write_int, lside < rside)
+	LSO_BINARY(OP_GREATER_II, LSO_INTEGER, LSO_INTEGER, write_int, lside > rside)
+	LSO_BINARY(OP_BITAND, LSO_INTEGER, LSO_INTEGER, write_int, lside & rside)
+	LSO_BINARY(OP_BITOR, LSO_INTEGER, LSO_INTEGER, write_int, lside | rside)
+	LSO_BINARY(OP_BITXOR, LSO_INTEGER, LSO_INTEGER, write_int, lside ^ rside)
+	LSO_BINARY(OP_BOOLAND, LSO_INTEGER, LSO_INTEGER, write_int, lside && rside)
+	LSO_BINARY(OP_BOOLOR, LSO_INTEGER, LSO_INTEGER, write_int, lside || rside)
+	LSO_BINARY(OP_SHL, LSO_INTEGER, LSO_INTEGER, write_int, lside << rside)
+	LSO_BINARY(OP_SHR, LSO_INTEGER, LSO_INTEGER, write_int, lside >> rside)
+
+	LSO_CASE(OP_DIV_II)
+	{
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp + 8))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(lside, sp);
+		LSO_INTEGER(rside, sp + 4);
+		if (!rside)
+		{
+			goto generic;
+		}
+		sp += 4;
+		// as integer_integer_operation(), SL-31252
+		S32 result = (rside == -1) ? -1 * lside : lside / rside;
+		write_int(buffer, sp, result);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_MOD_II)
+	{
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp + 8))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(lside, sp);
+		LSO_INTEGER(rside, sp + 4);
+		if (!rside)
+		{
+			goto generic;
+		}
+		sp += 4;
+		S32 result = (rside == -1 || rside == 1) ? 0 : lside % rside;
+		write_int(buffer, sp, result);
+		LSO_NEXT();
+	}
+
+	LSO_BINARY(OP_ADD_FF, LSO_FLOAT, LSO_FLOAT, write_float, lside + rside)
+	LSO_BINARY(OP_SUB_FF, LSO_FLOAT, LSO_FLOAT, write_float, lside - rside)
+	LSO_BINARY(OP_MUL_FF, LSO_FLOAT, LSO_FLOAT, write_float, lside * rside)
+	LSO_DIVIDE(OP_DIV_FF, LSO_FLOAT, LSO_FLOAT)
+	LSO_BINARY(OP_EQ_FF, LSO_FLOAT, LSO_FLOAT, write_int, lside == rside)
+	LSO_BINARY(OP_NEQ_FF, LSO_FLOAT, LSO_FLOAT, write_int, lside != rside)
+	LSO_BINARY(OP_LEQ_FF, LSO_FLOAT, LSO_FLOAT, write_int, lside <= rside)
+	LSO_BINARY(OP_GEQ_FF, LSO_FLOAT, LSO_FLOAT, write_int, lside >= rside)
+	LSO_BINARY(OP_LESS_FF, LSO_FLOAT, LSO_FLOAT, write_int, lside < rside)
+	LSO_BINARY(OP_GREATER_FF, LSO_FLOAT, LSO_FLOAT, write_int, lside > rside)
+
+	LSO_BINARY(OP_ADD_IF, LSO_INTEGER, LSO_FLOAT, write_float, lside + rside)
+	LSO_BINARY(OP_SUB_IF, LSO_INTEGER, LSO_FLOAT, write_float, lside - rside)
+	LSO_BINARY(OP_MUL_IF, LSO_INTEGER, LSO_FLOAT, write_float, lside * rside)
+	LSO_DIVIDE(OP_DIV_IF, LSO_INTEGER, LSO_FLOAT)
+	LSO_BINARY(OP_EQ_IF, LSO_INTEGER, LSO_FLOAT, write_int, lside == rside)
+	LSO_BINARY(OP_NEQ_IF, LSO_INTEGER, LSO_FLOAT, write_int, lside != rside)
+	LSO_BINARY(OP_LEQ_IF, LSO_INTEGER, LSO_FLOAT, write_int, lside <= rside)
+	LSO_BINARY(OP_GEQ_IF, LSO_INTEGER, LSO_FLOAT, write_int, lside >= rside)
+	LSO_BINARY(OP_LESS_IF, LSO_INTEGER, LSO_FLOAT, write_int, lside < rside)
+	LSO_BINARY(OP_GREATER_IF, LSO_INTEGER, LSO_FLOAT, write_int, lside > rside)
+
+	LSO_BINARY(OP_ADD_FI, LSO_FLOAT, LSO_INTEGER, write_float, lside + rside)
+	LSO_BINARY(OP_SUB_FI, LSO_FLOAT, LSO_INTEGER, write_float, lside - rside)
+	LSO_BINARY(OP_MUL_FI, LSO_FLOAT, LSO_INTEGER, write_float, lside * rside)
+	LSO_DIVIDE(OP_DIV_FI, LSO_FLOAT, LSO_INTEGER)
+	LSO_BINARY(OP_EQ_FI, LSO_FLOAT, LSO_INTEGER, write_int, lside == rside)
+	LSO_BINARY(OP_NEQ_FI, LSO_FLOAT, LSO_INTEGER, write_int, lside != rside)
+	LSO_BINARY(OP_LEQ_FI, LSO_FLOAT, LSO_INTEGER, write_int, lside <= rside)
+	LSO_BINARY(OP_GEQ_FI, LSO_FLOAT, LSO_INTEGER, write_int, lside >= rside)
+	LSO_BINARY(OP_LESS_FI, LSO_FLOAT, LSO_INTEGER, write_int, lside < rside)
+	LSO_BINARY(OP_GREATER_FI, LSO_FLOAT, LSO_INTEGER, write_int, lside > rside)
+
+	LSO_CASE(OP_NEG_I)
+	{
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp))
+		{
+			goto generic;
+		}
+		write_int(buffer, sp, -read_int(buffer, sp));
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_NEG_F)
+	{
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp))
+		{
+			goto generic;
+		}
+		LSO_FLOAT(value, sp);
+		write_float(buffer, sp, -value);
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_BITNOT)
+	{
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp))
+		{
+			goto generic;
+		}
+		write_int(buffer, sp, ~read_int(buffer, sp));
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_BOOLNOT)
+	{
+		if (!LSO_VALID_SP(sp + 4) || !LSO_VALID_SP(sp))
+		{
+			goto generic;
+		}
+		write_int(buffer, sp, !read_int(buffer, sp));
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_JUMP)
+	{
+		LSO_BRANCH();
+	}
+
+	LSO_CASE(OP_JUMPIF_I)
+	{
+		if (!LSO_VALID_SP(sp + 4))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(test, sp);
+		sp += 4;
+		if (test)
+		{
+			LSO_BRANCH();
+		}
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_JUMPIF_F)
+	{
+		if (!LSO_VALID_SP(sp + 4))
+		{
+			goto generic;
+		}
+		LSO_FLOAT(test, sp);
+		sp += 4;
+		if (test)
+		{
+			LSO_BRANCH();
+		}
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_JUMPNIF_I)
+	{
+		if (!LSO_VALID_SP(sp + 4))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(test, sp);
+		sp += 4;
+		if (!test)
+		{
+			LSO_BRANCH();
+		}
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_JUMPNIF_F)
+	{
+		if (!LSO_VALID_SP(sp + 4))
+		{
+			goto generic;
+		}
+		LSO_FLOAT(test, sp);
+		sp += 4;
+		if (!test)
+		{
+			LSO_BRANCH();
+		}
+		LSO_NEXT();
+	}
+
+	LSO_CASE(OP_CALL)
+	{
+		// the return address goes in local -8, just above BP
+		S32 address = bp - (-8 + LSCRIPTDataSize[LST_INTEGER]);
+		if (address < sp - 4 || address + 4 > tm)
+		{
+			goto generic;
+		}
+		write_int(buffer, address, op->mNext);
+		LSO_BRANCH();
+	}
+
+	LSO_CASE(OP_RETURN)
+	{
+		// run_return(): SP from BP, then pop BP and IP
+		if (!LSO_VALID_SP(bp) || !LSO_VALID_SP(bp + 4) || !LSO_VALID_SP(bp + 8))
+		{
+			goto generic;
+		}
+		LSO_INTEGER(new_bp, bp);
+		LSO_INTEGER(new_ip, bp + 4);
+		if (new_bp <= hp || new_bp >= tm || new_bp < bp + 4 || !isValidIP(new_ip))
+		{
+			goto generic;
+		}
+		sp = bp + 8;
+		bp = new_bp;
+		LSO_RETURN_TO(new_ip);
+	}
+
+#if !LSO_THREADED_DISPATCH
+	default:
+		goto generic;
+	}
+	}
+#endif
+
+done:
+	set_register(buffer, LREG_IP, ip);
+	set_register(buffer, LREG_SP, sp);
+	set_register(buffer, LREG_BP, bp);
+	set_register_fp(buffer, LREG_ESR, esr);
+	execute->mInstructionCount += fast_executed;
+	return executed;
+
+#undef LSO_VALID_SP
+#undef LSO_FINISH
+#undef LSO_RESOLVE
+#undef LSO_NEXT
+#undef LSO_BRANCH
+#undef LSO_RETURN_TO
+#undef LSO_INTEGER
+#undef LSO_FLOAT
+#undef LSO_BINARY
+#undef LSO_DIVIDE
+#undef LSO_DISPATCH
+#undef LSO_CASE
+}
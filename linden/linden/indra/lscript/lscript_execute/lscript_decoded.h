@@ -0,0 +1,145 @@
+/**
+ * @file lscript_decoded.h
+ * @brief Pre-decoded LSL2 bytecode with a threaded-dispatch interpreter.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#ifndef LL_LSCRIPT_DECODED_H
+#define LL_LSCRIPT_DECODED_H
+
+#include <vector>
+
+#include "lluuid.h"
+
+class LLScriptExecuteLSL2;
+
+// A faster way of running an LSL2 script's bytecode, producing the same
+// buffer, registers and faults as LLScriptExecuteLSL2::resumeEventHandler()
+// one instruction at a time.
+//
+// Instructions are decoded on first use into ops that have their operands
+// read, their typed operation picked and their branch targets resolved, and
+// the ops are run with computed goto dispatch where the compiler has it.
+// SP, BP and ESR live in locals while running and go back into the buffer
+// whenever anything else could look at them.
+//
+// Only common instructions on integers and floats are decoded. Everything
+// else, and any decoded op whose checks would fail (stack overflow, a bad
+// address, a division by zero, a non finite float...), goes through the
+// original instruction function, so faults are raised by the same code as
+// before. Code lives between GFR and HR and never changes while a script
+// runs, which is what makes decoding it once safe.
+class LLScriptDecodedCode
+{
+public:
+	LLScriptDecodedCode();
+
+	// Drops the decoded code, for when the buffer has been reloaded.
+	void invalidate();
+
+	// Runs at most max_instructions instructions of the current event
+	// handler. Returns early after an instruction that finishes the handler,
+	// faults or makes a yield due, and returns 0 without running anything
+	// if there is no handler running or the registers aren't fit for the
+	// decoded code, in which case the caller should run an instruction the
+	// usual way.
+	S32 run(LLScriptExecuteLSL2* execute, S32 max_instructions, const LLUUID& id, F32 quanta);
+
+	S32 getNumDecoded() const		{ return (S32)mOps.size(); }
+
+	enum EOpKind
+	{
+		OP_GENERIC,
+		OP_NOOP,
+		OP_POP,
+		OP_POPARG,
+		OP_POPIP,
+		OP_POPBP,
+		OP_DUP,
+		OP_STORE,
+		OP_STOREG,
+		OP_LOADP,
+		OP_LOADGP,
+		OP_PUSH,
+		OP_PUSHG,
+		OP_PUSHIP,
+		OP_PUSHBP,
+		OP_PUSHSP,
+		OP_PUSHARGB,
+		OP_PUSHARGI,
+		OP_PUSHARGE,
+		OP_ADD_II, OP_SUB_II, OP_MUL_II, OP_DIV_II, OP_MOD_II,
+		OP_EQ_II, OP_NEQ_II, OP_LEQ_II, OP_GEQ_II, OP_LESS_II, OP_GREATER_II,
+		OP_BITAND, OP_BITOR, OP_BITXOR, OP_BOOLAND, OP_BOOLOR, OP_SHL, OP_SHR,
+		OP_ADD_FF, OP_SUB_FF, OP_MUL_FF, OP_DIV_FF,
+		OP_EQ_FF, OP_NEQ_FF, OP_LEQ_FF, OP_GEQ_FF, OP_LESS_FF, OP_GREATER_FF,
+		OP_ADD_IF, OP_SUB_IF, OP_MUL_IF, OP_DIV_IF,
+		OP_EQ_IF, OP_NEQ_IF, OP_LEQ_IF, OP_GEQ_IF, OP_LESS_IF, OP_GREATER_IF,
+		OP_ADD_FI, OP_SUB_FI, OP_MUL_FI, OP_DIV_FI,
+		OP_EQ_FI, OP_NEQ_FI, OP_LEQ_FI, OP_GEQ_FI, OP_LESS_FI, OP_GREATER_FI,
+		OP_NEG_I,
+		OP_NEG_F,
+		OP_BITNOT,
+		OP_BOOLNOT,
+		OP_JUMP,
+		OP_JUMPIF_I,
+		OP_JUMPIF_F,
+		OP_JUMPNIF_I,
+		OP_JUMPNIF_F,
+		OP_CALL,
+		OP_RETURN,
+		OP_COUNT
+	};
+
+private:
+	struct Op
+	{
+		S32 mKind;
+		S32 mIP;		// of the instruction
+		S32 mNext;		// IP of the instruction after it
+		S32 mArg;		// operand, or the branch or call target
+		S32 mNextOp;	// index of the op at mNext, -1 until first needed
+		S32 mTargetOp;	// index of the op at mArg for branches and calls
+	};
+
+	// Returns the index of the op for the instruction at ip, decoding it if
+	// need be. ip must be in [mGFR, mHR).
+	S32 getOp(const U8* buffer, S32 ip);
+	void decode(const U8* buffer, Op& op) const;
+	BOOL isValidIP(S32 ip) const	{ return ip == 0 || (ip >= mGFR && ip < mHR); }
+
+	std::vector<Op> mOps;
+	std::vector<S32> mOpIndex;		// op index by IP - GFR, -1 if not decoded
+	S32 mGFR;
+	S32 mHR;
+	S32 mSR;
+};
+
+#endif // LL_LSCRIPT_DECODED_H
@@ -37,6 +37,7 @@
 
 #include "lscript_execute.h"
 #include "lltimer.h"
+#include "lscript_decoded.h"
 #include "lscript_readlso.h"
 #include "lscript_library.h"
 #include "lscript_heapruntime.h"
@@ -45,6 +46,7 @@
 // Static
 const	S32	DEFAULT_SCRIPT_TIMER_CHECK_SKIP = 4;
 S32		LLScriptExecute::sTimerCheckSkip = DEFAULT_SCRIPT_TIMER_CHECK_SKIP;
+BOOL	LLScriptExecuteLSL2::sUseDecodedCode = TRUE;
 
 void (*binary_operations[LST_EOF][LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
 void (*unary_operations[LST_EOF])(U8 *buffer, LSCRIPTOpCodesEnum opcode);
@@ -114,6 +116,7 @@ LLScriptExecuteLSL2::~LLScriptExecuteLSL2()
 {
 	delete[] mBuffer;
 	delete[] mBytecode;
+	delete mDecodedCode;
 }
 
 void LLScriptExecuteLSL2::init()
@@ -121,6 +124,7 @@ void LLScriptExecuteLSL2::init()
 	S32 i, j;
 
 	mInstructionCount = 0;
+	mDecodedCode = new LLScriptDecodedCode;
 
 	for (i = 0; i < 256; i++)
 	{
@@ -663,6 +667,8 @@ S32 LLScriptExecuteLSL2::writeBytecode(U8 **dest)
 
 S32 LLScriptExecuteLSL2::readState(U8 *src)
 {
+	mDecodedCode->invalidate();
+
 	// first, blitz heap and stack
 	S32 hr = get_register(mBuffer, LREG_HR);
 	S32 tm = get_register(mBuffer, LREG_TM);
@@ -730,6 +736,8 @@ void LLScriptExecuteLSL2::reset()
 	if (!src)
 		return;
 
+	mDecodedCode->invalidate();
+
 	// first, blitz heap and stack
 	S32 hr = get_register(mBuffer, LREG_HR);
 	S32 tm = get_register(mBuffer, LREG_TM);
@@ -967,6 +975,66 @@ F32 LLScriptExecute::runQuanta(BOOL b_print, const LLUUID &id, const char **erro
 	return inloop;
 }
 
+// As LLScriptExecute::runQuanta(), but the instructions between two timer
+// checks are run through the decoded code in one go. The timer is checked
+// after the same instructions, and yields happen after the same
+// instructions, as they would one instruction at a time.
+F32 LLScriptExecuteLSL2::runQuanta(BOOL b_print, const LLUUID &id, const char **errorstr, F32 quanta, U32& events_processed, LLTimer& timer)
+{
+	if (b_print || !sUseDecodedCode)
+	{
+		return LLScriptExecute::runQuanta(b_print, id, errorstr, quanta, events_processed, timer);
+	}
+
+	S32 timer_checks = 0;
+	F32 inloop = 0;
+	S32 timer_check_skip = LLScriptExecute::getTimerCheckSkip();
+
+	while(true)
+	{
+		// runInstructions() would have to report a fault or bad version
+		S32 executed = 0;
+		S32 version = getVersion();
+		S32 fault = getFaults();
+		if ((version == LSL2_VERSION1_END_NUMBER || version == LSL2_VERSION_NUMBER)
+			&& !(fault > LSRF_INVALID && fault < LSRF_EOF))
+		{
+			*errorstr = NULL;
+			executed = mDecodedCode->run(this, llmax(timer_check_skip - timer_checks + 1, 1), id, quanta);
+		}
+
+		if (executed)
+		{
+			// none of them but the last was followed by a yield or timer check
+			timer_checks += executed - 1;
+		}
+		else
+		{
+			runInstructions(b_print, id, errorstr,
+							events_processed, quanta);
+		}
+
+		if(isYieldDue())
+		{
+			break;
+		}
+		else if(timer_checks++ >= timer_check_skip)
+		{
+			inloop = timer.getElapsedTimeF32();
+			if(inloop > quanta)
+			{
+				break;
+			}
+			timer_checks = 0;
+		}
+	}
+	if (inloop == 0.0f)
+	{
+		inloop = timer.getElapsedTimeF32();
+	}
+	return inloop;
+}
+
 F32 LLScriptExecute::runNested(BOOL b_print, const LLUUID &id, const char **errorstr, F32 quanta, U32& events_processed, LLTimer& timer)
 {
 	return LLScriptExecute::runQuanta(b_print, id, errorstr, quanta, events_processed, timer);
@@ -48,6 +48,7 @@
 #include "llmd5.h"
 #include "llpumpio.h"
 #include "llimpanel.h"
+#include "llmessagelog.h"
 #include "llmimetypes.h"
 #include "llstartup.h"
 #include "llfloaterchat.h"
@@ -95,6 +96,7 @@
 #include "lltexturecache.h"
 #include "lltexturefetch.h"
 #include "llimageworker.h"
+#include "lscript_compile_thread.h"
 
 // The files below handle dependencies from cleanup.
 #include "llkeyframemotion.h"
@@ -144,6 +146,7 @@
 #include "llsurface.h"
 #include "llvosky.h"
 #include "llvotree.h"
+#include "llvocache.h"
 #include "llvoavatar.h"
 #include "llfolderview.h"
 #include "lltoolbar.h"
@@ -553,6 +556,7 @@ const std::string LLAppViewer::sCrashSettingsName = "CrashSettings";
 LLTextureCache* LLAppViewer::sTextureCache = NULL; 
 LLImageDecodeThread* LLAppViewer::sImageDecodeThread = NULL; 
 LLTextureFetch* LLAppViewer::sTextureFetch = NULL; 
+LLScriptCompileThread* LLAppViewer::sScriptCompileThread = NULL; 
 
 LLAppViewer::LLAppViewer() : 
 	mMarkerFile(),
@@ -707,7 +711,7 @@ bool LLAppViewer::init()
 
 	LLAgent::parseTeleportMessages("teleport_strings.xml");
 
-	LLViewerJointMesh::updateVectorize();
+	update_vectorize();
 
 	// load MIME type -> media impl mappings
 	std::string mime_types_name;
@@ -1077,6 +1081,8 @@ bool LLAppViewer::mainLoop()
 				}
 
 
+				LLAppViewer::getScriptCompileThread()->update(1); // delivers finished script compiles
+
 				const F64 max_idle_time = run_multiple_threads ? 0.0 : llmin(.005*10.0*gFrameIntervalSeconds, 0.005); // 50ms/second, no more than 5ms/frame
 				idleTimer.reset();
 				while(1)
@@ -1175,6 +1181,9 @@ bool LLAppViewer::cleanup()
 	// to ensure shutdown order
 	LLMortician::setZealous(TRUE);
 
+	// Closes the trace while the threads it covers are still around.
+	LLFastTimer::stopTrace();
+
 	if (mQuitRequested)
 	{
 		LLVoiceClient::terminate();
@@ -1413,6 +1422,7 @@ bool LLAppViewer::cleanup()
 	//LLVolumeMgr::cleanupClass();
 	LLPrimitive::cleanupVolumeManager();
 	LLWorldMapView::cleanupClass();
+	LLSurface::cleanupClass();
 	LLFolderViewItem::cleanupClass();
 	LLUI::cleanupClass();
 	
@@ -1466,6 +1476,9 @@ bool LLAppViewer::cleanup()
 	LLMuteList::getInstance()->cache(gAgent.getID());
 
 
+	// Regions have written back their objects by now
+	LLVOCache::getInstance()->destroyClass();
+
 	if (mPurgeOnExit)
 	{
 		llinfos << "Purging all cache files on exit" << llendflush;
@@ -1505,12 +1518,16 @@ bool LLAppViewer::cleanup()
 	sTextureCache->shutdown();
 	sTextureFetch->shutdown();
 	sImageDecodeThread->shutdown();
+	// Compiles still queued are dropped.
+	sScriptCompileThread->shutdown();
 	delete sTextureCache;
     sTextureCache = NULL;
 	delete sTextureFetch;
     sTextureFetch = NULL;
 	delete sImageDecodeThread;
     sImageDecodeThread = NULL;
+	delete sScriptCompileThread;
+	sScriptCompileThread = NULL;
 
 	gSavedSettings.cleanup();//do this after last time gSavedSettings is used  *surprise*
 
@@ -1545,6 +1562,7 @@ bool LLAppViewer::cleanup()
 
 	LLWatchdog::getInstance()->cleanup();
 
+	LLMessageLog::stopCapture();
 	end_messaging_system();
 	llinfos << "Message system deleted." << llendflush;
 
@@ -1619,6 +1637,9 @@ bool LLAppViewer::initThreads()
 	LLAppViewer::sTextureFetch = new LLTextureFetch(LLAppViewer::getTextureCache(), sImageDecodeThread, enable_threads && true);
 	LLImage::initClass(gSavedSettings.getBOOL("UseKDUIfAvailable"));
 
+	// The LSL compiler, for grids without the script compile capabilities
+	LLAppViewer::sScriptCompileThread = new LLScriptCompileThread(enable_threads && true);
+
 	// *FIX: no error handling here!
 	return true;
 }
@@ -3009,6 +3030,11 @@ bool LLAppViewer::initCache()
 		purgeCache();
 	}
 
+	if (gSavedSettings.getBOOL("XUIBinaryCache"))
+	{
+		LLUICtrlFactory::setXUICacheDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "xui"));
+	}
+
 	LLSplashScreen::update("Initializing Texture Cache...");
 	
 	// Init the texture cache
@@ -3022,6 +3048,12 @@ bool LLAppViewer::initCache()
 	S64 extra = LLAppViewer::getTextureCache()->initCache(LL_PATH_CACHE, texture_cache_size, read_only);
 	texture_cache_size -= extra;
 
+	// The object cache used to be one file per region.
+	removeCacheFiles("objects_*.slc");
+	U32 object_cache_size = llmin(gSavedSettings.getU32("ObjectCacheSize"), (U32)1024) * MB;
+	LLVOCache::getInstance()->initCache(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "objects.slc"),
+										object_cache_size, read_only);
+
 	LLSplashScreen::update("Initializing VFS...");
 	
 	// Init the VFS
@@ -3178,6 +3210,7 @@ void LLAppViewer::purgeCache()
 	LLAppViewer::getTextureCache()->purgeCache(LL_PATH_CACHE);
 	std::string mask = gDirUtilp->getDirDelimiter() + "*.*";
 	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE,""),mask);
+	gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "xui"), mask);
 }
 
 const std::string& LLAppViewer::getSecondLifeTitle() const
@@ -3317,6 +3350,14 @@ void LLAppViewer::loadNameCache()
 
 	if (!gCacheName) return;
 
+	std::string binary_cache = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "name_cache.bin");
+	llifstream binary_file(binary_cache, std::ios::in | std::ios::binary);
+	if (binary_file.is_open())
+	{
+		if (gCacheName->importBinary(binary_file)) return;
+	}
+
+	// Fall back to the LLSD cache written by older versions.
 	std::string name_cache;
 	name_cache = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "name.cache");
 	llifstream cache_file(name_cache);
@@ -3348,11 +3389,18 @@ void LLAppViewer::saveNameCache()
 	if (!gCacheName) return;
 
 	std::string name_cache;
-	name_cache = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "name.cache");
-	llofstream cache_file(name_cache);
+	name_cache = gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "name_cache.bin");
+	llofstream cache_file(name_cache, std::ios::out | std::ios::binary);
 	if(cache_file.is_open())
 	{
-		gCacheName->exportFile(cache_file);
+		gCacheName->exportBinary(cache_file);
+		cache_file.close();
+		if(!cache_file.fail())
+		{
+			// The LLSD cache is only read when there's no binary one, and
+			// is never written again, so it can only be stale from now on.
+			LLFile::remove(gDirUtilp->getExpandedFilename(LL_PATH_CACHE, "name.cache"));
+		}
 	}
 }
 
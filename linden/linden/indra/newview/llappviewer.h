@@ -38,6 +38,7 @@
 class LLTextureCache;
 class LLImageDecodeThread;
 class LLTextureFetch;
+class LLScriptCompileThread;
 class LLWatchdogTimeout;
 class LLCommandLineParser;
 
@@ -95,6 +96,7 @@ public:
 	static LLTextureCache* getTextureCache() { return sTextureCache; }
 	static LLImageDecodeThread* getImageDecodeThread() { return sImageDecodeThread; }
 	static LLTextureFetch* getTextureFetch() { return sTextureFetch; }
+	static LLScriptCompileThread* getScriptCompileThread() { return sScriptCompileThread; }
 
 	const std::string& getSerialNumber() { return mSerialNumber; }
 	
@@ -218,6 +220,7 @@ private:
 	static LLTextureCache* sTextureCache; 
 	static LLImageDecodeThread* sImageDecodeThread; 
 	static LLTextureFetch* sTextureFetch;
+	static LLScriptCompileThread* sScriptCompileThread;
 
 	S32 mNumSessions;
 
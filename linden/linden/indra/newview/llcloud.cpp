@@ -57,30 +57,17 @@
 
 extern LLPipeline gPipeline;
 
-enum
-{
-	LL_PUFF_GROWING = 0,
-	LL_PUFF_DYING = 1
-};
-
 // Used for patch decoder
 S32 gBuffer[16*16];
 
 
 //static
-S32 LLCloudPuff::sPuffCount = 0;
-
-LLCloudPuff::LLCloudPuff() :
-	mAlpha(0.01f),
-	mRate((gSavedSettings.getF32("CloudGrowRate")/100)*gSavedSettings.getF32("CloudUpdateRate")),
-	mLifeState(LL_PUFF_GROWING)
-{
-}
+LLCloudPuffs LLCloudGroup::sPuffs(256.f/CLOUD_GROUPS_PER_EDGE);
 
 LLCloudGroup::LLCloudGroup() :
 	mCloudLayerp(NULL),
 	mDensity(0.f),
-	mTargetPuffCount(0),
+	mCell(-1),
 	mVOCloudsp(NULL)
 {
 }
@@ -95,6 +82,7 @@ void LLCloudGroup::cleanup()
 		}
 		mVOCloudsp = NULL;
 	}
+	removeCell();
 }
 
 void LLCloudGroup::setCenterRegion(const LLVector3 &center)
@@ -102,7 +90,37 @@ void LLCloudGroup::setCenterRegion(const LLVector3 &center)
 	mCenterRegion = center;
 }
 
-void LLCloudGroup::updatePuffs(const F32 dt)
+void LLCloudGroup::updateCell()
+{
+	LLViewerRegion *regionp = mCloudLayerp->getRegion();
+
+	LLCloudPuffs::Wind wind;
+	wind.mVelX = regionp->mWind.getCloudVelX();
+	wind.mVelY = regionp->mWind.getCloudVelY();
+	wind.mSize = regionp->mWind.getSize();
+	wind.mOriginGlobal = regionp->getOriginGlobal();
+
+	LLVector3d center_global = regionp->getPosGlobalFromRegion(mCenterRegion);
+	if (mCell < 0)
+	{
+		mCell = sPuffs.addCell(center_global, wind);
+	}
+	else
+	{
+		sPuffs.moveCell(mCell, center_global, wind);
+	}
+}
+
+void LLCloudGroup::removeCell()
+{
+	if (mCell >= 0)
+	{
+		sPuffs.removeCell(mCell);
+		mCell = -1;
+	}
+}
+
+void LLCloudGroup::updateDensity()
 {
 	mDensity = mCloudLayerp->getDensityRegion(mCenterRegion);
 
@@ -116,63 +134,11 @@ void LLCloudGroup::updatePuffs(const F32 dt)
 										 gSavedSettings.getF32("ClassicCloudRange") + CLOUD_PUFF_HEIGHT)*0.5f);
 		gPipeline.createObject(mVOCloudsp);
 	}
-
-	LLVector3 velocity;
-	LLVector3d vel_d;
-	// Update the positions of all of the clouds
-	for (U32 i = 0; i < mCloudPuffs.size(); i++)
-	{
-		LLCloudPuff &puff = mCloudPuffs[i];
-		velocity = mCloudLayerp->getRegion()->mWind.getCloudVelocity(mCloudLayerp->getRegion()->getPosRegionFromGlobal(puff.mPositionGlobal));
-		velocity *= (gSavedSettings.getF32("CloudVelocityScale")/100)*gSavedSettings.getF32("CloudUpdateRate");
-		vel_d.setVec(velocity);
-		mCloudPuffs[i].mPositionGlobal += vel_d;
-		mCloudPuffs[i].mAlpha += mCloudPuffs[i].mRate * dt;
-		mCloudPuffs[i].mAlpha = llmin(1.f, mCloudPuffs[i].mAlpha);
-		mCloudPuffs[i].mAlpha = llmax(0.f, mCloudPuffs[i].mAlpha);
-	}
-}
-
-void LLCloudGroup::updatePuffOwnership()
-{
-	U32 i = 0;
-	while (i < mCloudPuffs.size())
-	{
-		if (mCloudPuffs[i].getLifeState() == LL_PUFF_DYING)
-		{
-			i++;
-			continue;
-		}
-		if (inGroup(mCloudPuffs[i]))
-		{
-			i++;
-			continue;
-		}
-
-		//llinfos << "Cloud moving to new group" << llendl;
-		LLCloudGroup *new_cgp = LLWorld::getInstance()->findCloudGroup(mCloudPuffs[i]);
-		if (!new_cgp)
-		{
-			//llinfos << "Killing puff not in group" << llendl;
-			mCloudPuffs[i].setLifeState(LL_PUFF_DYING);
-			mCloudPuffs[i].mRate = (gSavedSettings.getF32("CloudDecayRate")/100)*gSavedSettings.getF32("CloudUpdateRate");
-			i++;
-			continue;
-		}
-		//llinfos << "Puff handed off!" << llendl;
-		LLCloudPuff puff;
-		puff.mPositionGlobal = mCloudPuffs[i].mPositionGlobal;
-		puff.mAlpha = mCloudPuffs[i].mAlpha;
-		mCloudPuffs.erase(mCloudPuffs.begin() + i);
-		new_cgp->mCloudPuffs.push_back(puff);
-	}
-
-	//llinfos << "Puff count: " << LLCloudPuff::sPuffCount << llendl;
 }
 
 void LLCloudGroup::updatePuffCount()
 {
-	if (!mVOCloudsp)
+	if (!mVOCloudsp || mCell < 0)
 	{
 		return;
 	}
@@ -180,88 +146,28 @@ void LLCloudGroup::updatePuffCount()
 	S32 target_puff_count = llround((S32)gSavedSettings.getF32("CloudDensity") * mDensity);
 	target_puff_count = llmax(0, target_puff_count);
 	target_puff_count = llmin((S32)gSavedSettings.getF32("CloudCountMax"), target_puff_count);
-	S32 current_puff_count = (S32) mCloudPuffs.size();
+	S32 current_puff_count = sPuffs.getCellCount(mCell);
+	S32 live_puff_count = sPuffs.getCellLiveCount(mCell);
 	// Create a new cloud if we need one
 	if (current_puff_count < target_puff_count)
 	{
+		F32 range = gSavedSettings.getF32("ClassicCloudRange");
 		LLVector3d puff_pos_global;
-		mCloudPuffs.resize(target_puff_count);
 		for (i = current_puff_count; i < target_puff_count; i++)
 		{
 			puff_pos_global = mVOCloudsp->getPositionGlobal();
 			F32 x = ll_frand(256.f/CLOUD_GROUPS_PER_EDGE) - 128.f/CLOUD_GROUPS_PER_EDGE;
 			F32 y = ll_frand(256.f/CLOUD_GROUPS_PER_EDGE) - 128.f/CLOUD_GROUPS_PER_EDGE;
-			F32 z = ll_frand(gSavedSettings.getF32("ClassicCloudRange")) - 0.5f*gSavedSettings.getF32("ClassicCloudRange");
+			F32 z = ll_frand(range) - 0.5f*range;
 			puff_pos_global += LLVector3d(x, y, z);
-			mCloudPuffs[i].mPositionGlobal = puff_pos_global;
-			mCloudPuffs[i].mAlpha = 0.01f;
-			LLCloudPuff::sPuffCount++;
-		}
-	}
-
-	// Count the number of live puffs
-	S32 live_puff_count = 0;
-	for (i = 0; i < (S32) mCloudPuffs.size(); i++)
-	{
-		if (mCloudPuffs[i].getLifeState() != LL_PUFF_DYING)
-		{
+			sPuffs.addPuff(mCell, puff_pos_global, 0.01f);
 			live_puff_count++;
 		}
 	}
 
-
-	// Start killing enough puffs so the live puff count == target puff count
-	S32 new_dying_count = llmax(0, live_puff_count - target_puff_count);
-	i = 0;
-	while (new_dying_count > 0)
-	{
-		if (mCloudPuffs[i].getLifeState() != LL_PUFF_DYING)
-		{
-			//llinfos << "Killing extra live cloud" << llendl;
-			mCloudPuffs[i].setLifeState(LL_PUFF_DYING);
-			mCloudPuffs[i].mRate = (gSavedSettings.getF32("CloudDecayRate")/100)*gSavedSettings.getF32("CloudUpdateRate");
-			new_dying_count--;
-		}
-		i++;
-	}
-
-	// Remove fully dead puffs
-	i = 0;
-	while (i < (S32) mCloudPuffs.size())
-	{
-		if (mCloudPuffs[i].isDead())
-		{
-			//llinfos << "Removing dead puff!" << llendl;
-			mCloudPuffs.erase(mCloudPuffs.begin() + i);
-			LLCloudPuff::sPuffCount--;
-		}
-		else
-		{
-			i++;
-		}
-	}
-}
-
-BOOL LLCloudGroup::inGroup(const LLCloudPuff &puff) const
-{
-	// Do min/max check on center of the cloud puff
-	F32 min_x, min_y, max_x, max_y;
-	F32 delta = 128.f/CLOUD_GROUPS_PER_EDGE;
-	min_x = mCenterRegion.mV[VX] - delta;
-	min_y = mCenterRegion.mV[VY] - delta;
-	max_x = mCenterRegion.mV[VX] + delta;
-	max_y = mCenterRegion.mV[VY] + delta;
-
-	LLVector3 pos_region = mCloudLayerp->getRegion()->getPosRegionFromGlobal(puff.getPositionGlobal());
-
-	if ((pos_region.mV[VX] < min_x)
-		|| (pos_region.mV[VY] < min_y)
-		|| (pos_region.mV[VX] > max_x)
-		|| (pos_region.mV[VY] > max_y))
-	{
-		return FALSE;
-	}
-	return TRUE;
+	// Start killing enough puffs so the live puff count == target puff count.
+	// sortAllPuffs() kills them, and removes the fully dead ones.
+	sPuffs.killPuffs(mCell, llmax(0, live_puff_count - target_puff_count));
 }
 
 LLCloudLayer::LLCloudLayer()
@@ -269,6 +175,7 @@ LLCloudLayer::LLCloudLayer()
 	mMetersPerEdge(1.0f),
 	mMetersPerGrid(1.0f),
 	mWindp(NULL),
+	mRegionp(NULL),
 	mDensityp(NULL)
 {
 	S32 i, j;
@@ -311,6 +218,33 @@ void LLCloudLayer::create(LLViewerRegion *regionp)
 	{
 		mDensityp[i] = 0.f;
 	}
+
+	S32 j;
+	for (i = 0; i < CLOUD_GROUPS_PER_EDGE; i++)
+	{
+		for (j = 0; j < CLOUD_GROUPS_PER_EDGE; j++)
+		{
+			mCloudGroups[i][j].updateCell();
+		}
+	}
+}
+
+void LLCloudLayer::setOriginGlobal(const LLVector3d &origin_global)
+{
+	mOriginGlobal = origin_global;
+
+	if (mDensityp)
+	{
+		// Created, so the groups have cells to move
+		S32 i, j;
+		for (i = 0; i < CLOUD_GROUPS_PER_EDGE; i++)
+		{
+			for (j = 0; j < CLOUD_GROUPS_PER_EDGE; j++)
+			{
+				mCloudGroups[i][j].updateCell();
+			}
+		}
+	}
 }
 
 void LLCloudLayer::setRegion(LLViewerRegion *regionp)
@@ -432,7 +366,7 @@ void LLCloudLayer::decompress(LLBitPack &bitpack, LLGroupHeader *group_headerp)
 	decompress_patch(mDensityp, gBuffer, &patch_header); 
 }
 
-void LLCloudLayer::updatePuffs(const F32 dt)
+void LLCloudLayer::updateDensity()
 {
 	// We want to iterate through all of the cloud groups
 	// and update their density targets
@@ -443,12 +377,12 @@ void LLCloudLayer::updatePuffs(const F32 dt)
 	{
 		for (j = 0; j < CLOUD_GROUPS_PER_EDGE; j++)
 		{
-			mCloudGroups[i][j].updatePuffs(dt);
+			mCloudGroups[i][j].updateDensity();
 		}
 	}
 }
 
-void LLCloudLayer::updatePuffOwnership()
+void LLCloudLayer::updatePuffCount()
 {
 	S32 i, j;
 	
@@ -456,39 +390,37 @@ void LLCloudLayer::updatePuffOwnership()
 	{
 		for (j = 0; j < CLOUD_GROUPS_PER_EDGE; j++)
 		{
-			mCloudGroups[i][j].updatePuffOwnership();
+			mCloudGroups[i][j].updatePuffCount();
 		}
 	}
 }
 
-void LLCloudLayer::updatePuffCount()
+// static
+void LLCloudLayer::updateAllPuffs(const F32 dt)
 {
-	S32 i, j;
-	
-	for (i = 0; i < CLOUD_GROUPS_PER_EDGE; i++)
-	{
-		for (j = 0; j < CLOUD_GROUPS_PER_EDGE; j++)
-		{
-			mCloudGroups[i][j].updatePuffCount();
-		}
-	}
+	// Read the settings once a frame, rather than once a puff
+	F32 update_rate = gSavedSettings.getF32("CloudUpdateRate");
+	LLCloudPuffs::Params params;
+	params.mRegionWidth = LLWorld::getInstance()->getRegionWidthInMeters();
+	// LLWind::getCloudVelocity() scales the wind by WIND_SCALE_HACK too.
+	params.mVelocityScale = WIND_SCALE_HACK * (gSavedSettings.getF32("CloudVelocityScale")/100)*update_rate;
+	params.mGrowRate = (gSavedSettings.getF32("CloudGrowRate")/100)*update_rate;
+	params.mDecayRate = (gSavedSettings.getF32("CloudDecayRate")/100)*update_rate;
+	LLCloudGroup::sPuffs.setParams(params);
+
+	LLCloudGroup::sPuffs.update(dt);
 }
 
-LLCloudGroup *LLCloudLayer::findCloudGroup(const LLCloudPuff &puff)
+// static
+void LLCloudLayer::updateAllPuffOwnership()
 {
-	S32 i, j;
-	
-	for (i = 0; i < CLOUD_GROUPS_PER_EDGE; i++)
-	{
-		for (j = 0; j < CLOUD_GROUPS_PER_EDGE; j++)
-		{
-			if (mCloudGroups[i][j].inGroup(puff))
-			{
-				return &(mCloudGroups[i][j]);
-			}
-		}
-	}
-	return NULL;
+	LLCloudGroup::sPuffs.updateOwnership();
+}
+
+// static
+void LLCloudLayer::sortAllPuffs()
+{
+	LLCloudGroup::sPuffs.sortPuffs();
 }
 
 
@@ -74,6 +74,7 @@
 #include "v4color.h"
 #include "llmemory.h"
 #include "lldarray.h"
+#include "llcloudpuffs.h"
 
 #include "llframetimer.h"
 
@@ -91,30 +92,21 @@ class LLGroupHeader;
 
 const S32 CLOUD_GROUPS_PER_EDGE = 4;
 
+// A puff of a cloud group, as LLCloudGroup::sPuffs keeps it, until the
+// puffs next move or are sorted.
 class LLCloudPuff
 {
 public:
-	LLCloudPuff();
+	LLCloudPuff(const LLCloudPuffs &puffs, const S32 i) : mPuffs(puffs), mIndex(i) {}
 
-	const LLVector3d &getPositionGlobal() const		{ return mPositionGlobal; }
-	friend class LLCloudGroup;
+	LLVector3d getPositionGlobal() const			{ return mPuffs.getPositionGlobal(mIndex); }
+	F32 getAlpha() const							{ return mPuffs.getAlpha(mIndex); }
+	U32 getLifeState() const						{ return mPuffs.getLifeState(mIndex); }
+	BOOL isDead() const								{ return getAlpha() <= 0.f; }
 
-	void updatePuffs(const F32 dt);
-	void updatePuffOwnership();
-
-	F32 getAlpha() const							{ return mAlpha; }
-	U32 getLifeState() const						{ return mLifeState; }
-	void setLifeState(const U32 state)				{ mLifeState = state; }
-	BOOL isDead() const								{ return mAlpha <= 0.f; }	
-
-
-	static S32	sPuffCount;
 protected:
-	F32			mAlpha;
-	F32			mRate;
-	LLVector3d	mPositionGlobal;
-
-	BOOL		mLifeState;
+	const LLCloudPuffs &mPuffs;
+	S32 mIndex;
 };
 
 class LLCloudGroup
@@ -127,22 +119,29 @@ public:
 	void setCloudLayerp(LLCloudLayer *clp)			{ mCloudLayerp = clp; }
 	void setCenterRegion(const LLVector3 &center);
 
-	void updatePuffs(const F32 dt);
-	void updatePuffOwnership();
-	void updatePuffCount();
+	// Puts the group's cell on the grid where its layer's region is, or
+	// takes it off along with its puffs.
+	void updateCell();
+	void removeCell();
 
-	BOOL inGroup(const LLCloudPuff &puff) const;
+	// Samples the density at the center, and makes the group's
+	// LLVOClouds the first time.
+	void updateDensity();
+	void updatePuffCount();
 
 	F32 getDensity() const							{ return mDensity; }
-	S32 getNumPuffs() const							{ return (S32) mCloudPuffs.size(); }
-	const LLCloudPuff &getPuff(const S32 i)			{ return mCloudPuffs[i]; }
+	S32 getNumPuffs() const							{ return mCell < 0 ? 0 : sPuffs.getCellEnd(mCell) - sPuffs.getCellBegin(mCell); }
+	LLCloudPuff getPuff(const S32 i) const			{ return LLCloudPuff(sPuffs, sPuffs.getCellBegin(mCell) + i); }
+
+	// The puffs of every group, of every layer, each group's a cell.
+	static LLCloudPuffs sPuffs;
+
 protected:
 	LLCloudLayer *mCloudLayerp;
 	LLVector3 mCenterRegion;
 	F32 mDensity;
-	S32 mTargetPuffCount;
+	S32 mCell;
 
-	std::vector<LLCloudPuff> mCloudPuffs;
 	LLPointer<LLVOClouds> mVOCloudsp;
 };
 
@@ -159,16 +158,24 @@ public:
 	void reset();						// Clears all active cloud puffs
 
 
-	void updatePuffs(const F32 dt);
-	void updatePuffOwnership();
+	void updateDensity();
 	void updatePuffCount();
 
-	LLCloudGroup *findCloudGroup(const LLCloudPuff &puff);
+	// A frame of every layer's puffs goes: updateDensity() on each layer,
+	// updateAllPuffs(), updateAllPuffOwnership(), updatePuffCount() on each
+	// layer and sortAllPuffs().
+	//
+	// Moves every puff by the wind, and grows or fades it.
+	static void updateAllPuffs(const F32 dt);
+	// Reshuffles who owns which puffs.
+	static void updateAllPuffOwnership();
+	// Adds and kills the puffs updatePuffCount() asked for.
+	static void sortAllPuffs();
 
 	void setRegion(LLViewerRegion *regionp);
 	LLViewerRegion* getRegion() const						{ return mRegionp; }
 	void setWindPointer(LLWind *windp);
-	void setOriginGlobal(const LLVector3d &origin_global)	{ mOriginGlobal = origin_global; }
+	void setOriginGlobal(const LLVector3d &origin_global);
 	void setWidth(F32 width);
 
 	void setBrightness(F32 brightness);
@@ -43,6 +43,7 @@
 #include "llcompilequeue.h"
 
 #include "llagent.h"
+#include "llappviewer.h"
 #include "llassetuploadqueue.h"
 #include "llassetuploadresponders.h"
 #include "llchat.h"
@@ -50,7 +51,7 @@
 #include "llviewerobject.h"
 #include "llviewerobjectlist.h"
 #include "llviewerregion.h"
-#include "lscript_rt_interface.h"
+#include "lscript_compile_thread.h"
 #include "llviewercontrol.h"
 #include "llresmgr.h"
 #include "llbutton.h"
@@ -85,6 +86,25 @@ struct LLScriptQueueData
 
 };
 
+// Saves the bytecode once LLFloaterCompileQueue::compile() has compiled it.
+class LLCompileQueueResponder : public LLScriptCompileThread::Responder
+{
+public:
+	LLCompileQueueResponder(const LLUUID& queue_id, const LLUUID& item_id, const LLUUID& asset_id,
+							const std::string& filename, const std::string& dst_filename,
+							const std::string& err_filename);
+
+	/*virtual*/ void completed(BOOL success, const std::vector<std::string>& errors);
+
+private:
+	LLUUID mQueueID;
+	LLUUID mItemID;
+	LLUUID mAssetID;
+	std::string mFilename;
+	std::string mDstFilename;
+	std::string mErrFilename;
+};
+
 ///----------------------------------------------------------------------------
 /// Class LLFloaterScriptQueue
 ///----------------------------------------------------------------------------
@@ -476,10 +496,8 @@ void LLFloaterCompileQueue::scriptArrived(LLVFS *vfs, const LLUUID& asset_id,
 				}
 
 				// TODO: babbage: No compile if no cap.
+				// The file is deleted once it has compiled.
 				queue->compile(filename, data->mItemId);
-					
-				// Delete it after we're done compiling?
-				LLFile::remove(filename);
 			}
 		}
 	}
@@ -572,24 +590,55 @@ void LLFloaterCompileQueue::compile(const std::string& filename,
 								  &onSaveTextComplete, NULL, FALSE);
 
 	const BOOL compile_to_mono = FALSE;
-	if(!lscript_compile(filename.c_str(), dst_filename.c_str(),
-						err_filename.c_str(), compile_to_mono,
-						uuid_string.c_str(), gAgent.isGodlike()))
+	LLAppViewer::getScriptCompileThread()->compile(filename, dst_filename,
+												   err_filename, compile_to_mono,
+												   uuid_string, gAgent.isGodlike(),
+												   new LLCompileQueueResponder(mID, item_id, new_asset_id, filename,
+																			   dst_filename, err_filename));
+}
+
+LLCompileQueueResponder::LLCompileQueueResponder(const LLUUID& queue_id,
+												 const LLUUID& item_id,
+												 const LLUUID& asset_id,
+												 const std::string& filename,
+												 const std::string& dst_filename,
+												 const std::string& err_filename)
+:	mQueueID(queue_id),
+	mItemID(item_id),
+	mAssetID(asset_id),
+	mFilename(filename),
+	mDstFilename(dst_filename),
+	mErrFilename(err_filename)
+{
+}
+
+void LLCompileQueueResponder::completed(BOOL success, const std::vector<std::string>& errors)
+{
+	if(!success)
 	{
 		llwarns << "compile failed" << llendl;
-		removeItemByItemID(item_id);
+		LLFloaterCompileQueue* queue = static_cast<LLFloaterCompileQueue*>
+				(LLFloaterScriptQueue::findInstance(mQueueID));
+		if(queue)
+		{
+			queue->removeItemByItemID(mItemID);
+		}
 	}
 	else
 	{
 		llinfos << "compile successful." << llendl;
 		
 		// Save LSL bytecode
-		LLCompileQueueData* data = new LLCompileQueueData(mID, item_id);
-		gAssetStorage->storeAssetData(dst_filename, new_asset_id,
+		LLCompileQueueData* data = new LLCompileQueueData(mQueueID, mItemID);
+		gAssetStorage->storeAssetData(mDstFilename, mAssetID,
 									LLAssetType::AT_LSL_BYTECODE,
 									&LLFloaterCompileQueue::onSaveBytecodeComplete,
 									(void*)data, FALSE);
 	}
+
+	LLFile::remove(mFilename);
+	LLFile::remove(mErrFilename);
+	LLFile::remove(mDstFilename);
 }
 
 void LLFloaterCompileQueue::removeItemByItemID(const LLUUID& asset_id)
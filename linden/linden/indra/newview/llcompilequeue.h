@@ -131,6 +131,8 @@ class LLAssetUploadQueue;
 
 class LLFloaterCompileQueue : public LLFloaterScriptQueue
 {
+	friend class LLCompileQueueResponder;
+
 public:
 	// Use this method to create a compile queue. Once created, it
 	// will be responsible for it's own destruction.
@@ -162,7 +164,7 @@ protected:
 									   void* user_data,
 									   S32 status, LLExtStat ext_status);
 
-	// compile the file given and save it out.
+	// compile the file given and save it out. The file is deleted afterwards.
 	void compile(const std::string& filename, const LLUUID& asset_id);
 	
 	// remove any object in mScriptScripts with the matching uuid.
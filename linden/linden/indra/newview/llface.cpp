@@ -37,6 +37,7 @@
 #include "llviewertextureanim.h"
 
 #include "llviewercontrol.h"
+#include "llvertexxform.h"
 #include "llvolume.h"
 #include "m3math.h"
 #include "v3color.h"
@@ -614,29 +615,8 @@ void LLFace::printDebugInfo() const
 // Transform the texture coordinates for this face.
 static void xform(LLVector2 &tex_coord, F32 cosAng, F32 sinAng, F32 offS, F32 offT, F32 magS, F32 magT)
 {
-	// New, good way
-	F32 s = tex_coord.mV[0];
-	F32 t = tex_coord.mV[1];
-
-	// Texture transforms are done about the center of the face.
-	s -= 0.5; 
-	t -= 0.5;
-
-	// Handle rotation
-	F32 temp = s;
-	s  = s     * cosAng + t * sinAng;
-	t  = -temp * sinAng + t * cosAng;
-
-	// Then scale
-	s *= magS;
-	t *= magT;
-
-	// Then offset
-	s += offS + 0.5f; 
-	t += offT + 0.5f;
-
-	tex_coord.mV[0] = s;
-	tex_coord.mV[1] = t;
+	LLVertexXform::TexCoordXform tc_xform = { cosAng, sinAng, offS, offT, magS, magT };
+	LLVertexXform::transformTexCoord(tc_xform, tex_coord);
 }
 
 
@@ -1140,92 +1120,109 @@ BOOL LLFace::getGeometryVolume(const LLVolume& volume,
 		mVObjp->getVolume()->genBinormals(f);
 	}
 
-	for (S32 i = 0; i < num_vertices; i++)
+	// Whatever comes straight from the volume face goes through the batch
+	// transforms, the rest is done a vertex at a time.
+	const LLVolumeFace::VertexData* src = num_vertices ? &vf.mVertices[0] : NULL;
+	const U32 src_stride = sizeof(LLVolumeFace::VertexData);
+
+	if (rebuild_tcoord && num_vertices)
 	{
-		if (rebuild_tcoord)
+		if (texgen == LLTextureEntry::TEX_GEN_DEFAULT
+			&& !(tex_mode && mTextureMatrix)
+			&& !(bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1)))
 		{
-			LLVector2 tc = vf.mVertices[i].mTexCoord;
-		
-			if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
+			LLVertexXform::TexCoordXform tc_xform = { cos_ang, sin_ang, os, ot, ms, mt };
+			LLVertexXform::sTransformTexCoords(tc_xform, &src->mTexCoord, src_stride,
+											   tex_coords.get(), tex_coords.getSkip(), num_vertices);
+		}
+		else
+		{
+			for (S32 i = 0; i < num_vertices; i++)
 			{
-				LLVector3 vec = vf.mVertices[i].mPosition; 
+				LLVector2 tc = vf.mVertices[i].mTexCoord;
+		
+				if (texgen != LLTextureEntry::TEX_GEN_DEFAULT)
+				{
+					LLVector3 vec = vf.mVertices[i].mPosition; 
 			
-				vec.scaleVec(scale);
+					vec.scaleVec(scale);
+
+					switch (texgen)
+					{
+						case LLTextureEntry::TEX_GEN_PLANAR:
+							planarProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+							break;
+						case LLTextureEntry::TEX_GEN_SPHERICAL:
+							sphericalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+							break;
+						case LLTextureEntry::TEX_GEN_CYLINDRICAL:
+							cylindricalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
+							break;
+						default:
+							break;
+					}		
+				}
 
-				switch (texgen)
+				if (tex_mode && mTextureMatrix)
 				{
-					case LLTextureEntry::TEX_GEN_PLANAR:
-						planarProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
-						break;
-					case LLTextureEntry::TEX_GEN_SPHERICAL:
-						sphericalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
-						break;
-					case LLTextureEntry::TEX_GEN_CYLINDRICAL:
-						cylindricalProjection(tc, vf.mVertices[i].mNormal, vf.mCenter, vec);
-						break;
-					default:
-						break;
-				}		
-			}
-
-			if (tex_mode && mTextureMatrix)
-			{
-				LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
-				tmp = tmp * *mTextureMatrix;
-				tc.mV[0] = tmp.mV[0];
-				tc.mV[1] = tmp.mV[1];
-			}
-			else
-			{
-				xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
-			}
+					LLVector3 tmp(tc.mV[0], tc.mV[1], 0.f);
+					tmp = tmp * *mTextureMatrix;
+					tc.mV[0] = tmp.mV[0];
+					tc.mV[1] = tmp.mV[1];
+				}
+				else
+				{
+					xform(tc, cos_ang, sin_ang, os, ot, ms, mt);
+				}
 
-			*tex_coords++ = tc;
+				*tex_coords++ = tc;
 		
-			if (bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1))
-			{
-				LLVector3 tangent = vf.mVertices[i].mBinormal % vf.mVertices[i].mNormal;
+				if (bump_code && mVertexBuffer->hasDataType(LLVertexBuffer::TYPE_TEXCOORD1))
+				{
+					LLVector3 tangent = vf.mVertices[i].mBinormal % vf.mVertices[i].mNormal;
 
-				LLMatrix3 tangent_to_object;
-				tangent_to_object.setRows(tangent, vf.mVertices[i].mBinormal, vf.mVertices[i].mNormal);
-				LLVector3 binormal = binormal_dir * tangent_to_object;
-				binormal = binormal * mat_normal;
+					LLMatrix3 tangent_to_object;
+					tangent_to_object.setRows(tangent, vf.mVertices[i].mBinormal, vf.mVertices[i].mNormal);
+					LLVector3 binormal = binormal_dir * tangent_to_object;
+					binormal = binormal * mat_normal;
 				
-				if (mDrawablep->isActive())
-				{
-					binormal *= bump_quat;
-				}
+					if (mDrawablep->isActive())
+					{
+						binormal *= bump_quat;
+					}
 
-				binormal.normVec();
-				tc += LLVector2( bump_s_primary_light_ray * tangent, bump_t_primary_light_ray * binormal );
+					binormal.normVec();
+					tc += LLVector2( bump_s_primary_light_ray * tangent, bump_t_primary_light_ray * binormal );
 				
-				*tex_coords2++ = tc;
-			}	
-		}
-			
-		if (rebuild_pos)
-		{
-			*vertices++ = vf.mVertices[i].mPosition * mat_vert;
-		}
-		
-		if (rebuild_normal)
-		{
-			LLVector3 normal = vf.mVertices[i].mNormal * mat_normal;
-			normal.normVec();
-			
-			*normals++ = normal;
-		}
-		
-		if (rebuild_binormal)
-		{
-			LLVector3 binormal = vf.mVertices[i].mBinormal * mat_normal;
-			binormal.normVec();
-			*binormals++ = binormal;
+					*tex_coords2++ = tc;
+				}
+			}
 		}
-		
-		if (rebuild_color)
+	}
+
+	if (rebuild_pos && num_vertices)
+	{
+		LLVertexXform::sTransformPoints(mat_vert, &src->mPosition, src_stride,
+										vertices.get(), vertices.getSkip(), num_vertices);
+	}
+
+	if (rebuild_normal && num_vertices)
+	{
+		LLVertexXform::sTransformNormals(mat_normal, &src->mNormal, src_stride,
+										 normals.get(), normals.getSkip(), num_vertices);
+	}
+
+	if (rebuild_binormal && num_vertices)
+	{
+		LLVertexXform::sTransformNormals(mat_normal, &src->mBinormal, src_stride,
+										 binormals.get(), binormals.getSkip(), num_vertices);
+	}
+
+	if (rebuild_color)
+	{
+		for (S32 i = 0; i < num_vertices; i++)
 		{
-			*colors++ = color;		
+			*colors++ = color;
 		}
 	}
 
@@ -645,6 +645,39 @@ void LLFastTimerView::draw()
 		if (textw > legendwidth)
 			legendwidth = textw;
 	}
+
+	// Declared timers, which include the worker threads' time, are listed
+	// below the fixed ones with their average over recent frames.
+	const std::vector<LLFastTimer::DeclareTimer*>& declared = LLFastTimer::DeclareTimer::getTimers();
+	for (U32 i = 0; i < declared.size(); i++)
+	{
+		const LLFastTimer::DeclareTimer* timer = declared[i];
+		if (timer->getIndex() < 0)
+		{
+			continue;
+		}
+		S32 level = 0;
+		for (const LLFastTimer::DeclareTimer* parent = timer->getParent(); parent; parent = parent->getParent())
+		{
+			level++;
+		}
+		if (mDisplayCalls)
+		{
+			tdesc = llformat("%s (%d)", timer->getName().c_str(), (S32)timer->getCallAverage());
+		}
+		else
+		{
+			tdesc = llformat("%s [%.1f]", timer->getName().c_str(), (F32)((F64)timer->getCountAverage() * iclock_freq));
+		}
+		dx = (texth+4) + level*8;
+		LLFontGL::getFontMonospace()->renderUTF8(tdesc, 0, xleft + dx, y, LLColor4::white, LLFontGL::LEFT, LLFontGL::TOP);
+		y -= (texth + 2);
+
+		textw = dx + LLFontGL::getFontMonospace()->getWidth(timer->getName()) + 40;
+		if (textw > legendwidth)
+			legendwidth = textw;
+	}
+
 	for (S32 i=cur_line; i<FTV_DISPLAY_NUM; i++)
 	{
 		ft_display_idx[i] = -1;
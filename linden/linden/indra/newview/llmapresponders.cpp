@@ -165,13 +165,12 @@ void LLMapLayerResponder::result(const LLSD& result)
 					{
 						siminfo->mMapImageID[image] = oldinfo->mMapImageID[image];
 					}
-					delete oldinfo;
 				}
-				LLWorldMap::getInstance()->mSimInfoMap[handle] = siminfo;
-
 				siminfo->mHandle = handle;
 				siminfo->msizeX = size_x_regions;
 				siminfo->msizeY = size_y_regions;
+				LLWorldMap::getInstance()->addSimInfo(siminfo);
+
 				siminfo->mName.assign( name );
 				siminfo->mAccess = access;		/*Flawfinder: ignore*/
 				siminfo->mRegionFlags = region_flags;
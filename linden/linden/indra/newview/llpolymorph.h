@@ -36,6 +36,7 @@
 #include <string>
 #include <vector>
 
+#include "llmorphdeltas.h"
 #include "llviewervisualparam.h"
 
 class LLPolyMeshSharedData;
@@ -66,6 +67,8 @@ public:
 	LLVector3*			mNormals;
 	LLVector3*			mBinormals;
 	LLVector2*			mTexCoords;
+	// the same deltas, blocked for LLPolyMorphTarget::apply()
+	LLMorphDeltas		mDeltas;
 
 	F32					mTotalDistortion;	// vertex distortion summed over entire morph
 	F32					mMaxDistortion;		// maximum single vertex distortion in a given morph
@@ -49,7 +49,7 @@
 #include "llscrollcontainer.h"
 #include "llscrolllistctrl.h"
 #include "llslider.h"
-#include "lscript_rt_interface.h"
+#include "lscript_compile_thread.h"
 #include "lscript_export.h"
 #include "lltextbox.h"
 #include "lltooldraganddrop.h"
@@ -1012,6 +1012,24 @@ BOOL LLScriptEdCore::handleKeyHere(KEY key, MASK mask)
 /// LLPreviewLSL
 /// ---------------------------------------------------------------------------
 
+// Finishes LLPreviewLSL::uploadAssetLegacy() once the script has compiled.
+class LLPreviewLSLCompileResponder : public LLScriptCompileThread::Responder
+{
+public:
+	LLPreviewLSLCompileResponder(const LLUUID& item_id, const LLTransactionID& tid,
+								 const std::string& filename, const std::string& dst_filename,
+								 const std::string& err_filename);
+
+	/*virtual*/ void completed(BOOL success, const std::vector<std::string>& errors);
+
+private:
+	LLUUID mItemUUID;
+	LLTransactionID mTransactionID;
+	std::string mFilename;
+	std::string mDstFilename;
+	std::string mErrFilename;
+};
+
 struct LLScriptSaveInfo
 {
 	LLUUID mItemUUID;
@@ -1095,7 +1113,12 @@ void LLPreviewLSL::callbackLSLCompileSucceeded()
 void LLPreviewLSL::callbackLSLCompileFailed(const LLSD& compile_errors)
 {
 	llinfos << "Compile failed!" << llendl;
+	showCompileErrors(compile_errors);
+	closeIfNeeded();
+}
 
+void LLPreviewLSL::showCompileErrors(const LLSD& compile_errors)
+{
 	for(LLSD::array_const_iterator line = compile_errors.beginArray();
 		line < compile_errors.endArray();
 		line++)
@@ -1111,7 +1134,6 @@ void LLPreviewLSL::callbackLSLCompileFailed(const LLSD& compile_errors)
 		mScriptEd->mErrorList->addElement(row);
 	}
 	mScriptEd->selectFirstError();
-	closeIfNeeded();
 }
 
 void LLPreviewLSL::loadAsset()
@@ -1310,70 +1332,87 @@ void LLPreviewLSL::uploadAssetLegacy(const std::string& filename,
 	std::string dst_filename = llformat("%s.lso", filepath.c_str());
 	std::string err_filename = llformat("%s.out", filepath.c_str());
 
+	// Counts until the compile is done. The responder takes it from there.
+	getWindow()->incBusyCount();
+	mPendingUploads++;
 	const BOOL compile_to_mono = FALSE;
-	if(!lscript_compile(filename.c_str(),
-						dst_filename.c_str(),
-						err_filename.c_str(),
-						compile_to_mono,
-						asset_id.asString().c_str(),
-						gAgent.isGodlike()))
+	LLAppViewer::getScriptCompileThread()->compile(filename,
+												   dst_filename,
+												   err_filename,
+												   compile_to_mono,
+												   asset_id.asString(),
+												   gAgent.isGodlike(),
+												   new LLPreviewLSLCompileResponder(mItemUUID, tid, filename,
+																				   dst_filename, err_filename));
+}
+
+LLPreviewLSLCompileResponder::LLPreviewLSLCompileResponder(const LLUUID& item_id,
+														   const LLTransactionID& tid,
+														   const std::string& filename,
+														   const std::string& dst_filename,
+														   const std::string& err_filename)
+:	mItemUUID(item_id),
+	mTransactionID(tid),
+	mFilename(filename),
+	mDstFilename(dst_filename),
+	mErrFilename(err_filename)
+{
+}
+
+void LLPreviewLSLCompileResponder::completed(BOOL success, const std::vector<std::string>& errors)
+{
+	// uploadAssetLegacy() counted the window busy until the compile was
+	// done, whatever has become of the preview since.
+	gViewerWindow->getWindow()->decBusyCount();
+
+	LLPreviewLSL* self = LLPreviewLSL::getInstance(mItemUUID);
+	if (!success)
 	{
 		llinfos << "Compile failed!" << llendl;
-		//char command[256];
-		//sprintf(command, "type %s\n", err_filename.c_str());
-		//system(command);
-
-		// load the error file into the error scrolllist
-		LLFILE* fp = LLFile::fopen(err_filename, "r");
-		if(fp)
+		if (self)
 		{
-			char buffer[MAX_STRING];		/*Flawfinder: ignore*/
-			std::string line;
-			while(!feof(fp)) 
+			LLSD compile_errors = LLSD::emptyArray();
+			for (S32 i = 0; i < (S32)errors.size(); i++)
 			{
-				if (fgets(buffer, MAX_STRING, fp) == NULL)
-				{
-					buffer[0] = '\0';
-				}
-				if(feof(fp))
-				{
-					break;
-				}
-				else
-				{
-					line.assign(buffer);
-					LLStringUtil::stripNonprintable(line);
-
-					LLSD row;
-					row["columns"][0]["value"] = line;
-					row["columns"][0]["font"] = "OCRA";
-					mScriptEd->mErrorList->addElement(row);
-				}
+				compile_errors.append(errors[i]);
 			}
-			fclose(fp);
-			mScriptEd->selectFirstError();
+			self->showCompileErrors(compile_errors);
 		}
 	}
 	else
 	{
 		llinfos << "Compile worked!" << llendl;
-		if(gAssetStorage)
+		if (gAssetStorage)
 		{
-			getWindow()->incBusyCount();
-			mPendingUploads++;
+			// Busy again until onSaveBytecodeComplete().
+			gViewerWindow->getWindow()->incBusyCount();
+			if (self)
+			{
+				self->mPendingUploads++;
+			}
 			LLUUID* this_uuid = new LLUUID(mItemUUID);
-			gAssetStorage->storeAssetData(dst_filename,
-										  tid,
+			gAssetStorage->storeAssetData(mDstFilename,
+										  mTransactionID,
 										  LLAssetType::AT_LSL_BYTECODE,
 										  &LLPreviewLSL::onSaveBytecodeComplete,
 										  (void**)this_uuid);
 		}
 	}
 
+	if (self)
+	{
+		self->mPendingUploads--;
+		if (self->mPendingUploads <= 0
+			&& self->mCloseAfterSave)
+		{
+			self->close();
+		}
+	}
+
 	// get rid of any temp files left lying around
-	LLFile::remove(filename);
-	LLFile::remove(err_filename);
-	LLFile::remove(dst_filename);
+	LLFile::remove(mFilename);
+	LLFile::remove(mErrFilename);
+	LLFile::remove(mDstFilename);
 }
 
 
@@ -1660,6 +1699,12 @@ void LLLiveLSLEditor::callbackLSLCompileSucceeded(const LLUUID& task_id,
 void LLLiveLSLEditor::callbackLSLCompileFailed(const LLSD& compile_errors)
 {
 	lldebugs << "Compile failed!" << llendl;
+	showCompileErrors(compile_errors);
+	closeIfNeeded();
+}
+
+void LLLiveLSLEditor::showCompileErrors(const LLSD& compile_errors)
+{
 	for(LLSD::array_const_iterator line = compile_errors.beginArray();
 		line < compile_errors.endArray();
 		line++)
@@ -1675,7 +1720,6 @@ void LLLiveLSLEditor::callbackLSLCompileFailed(const LLSD& compile_errors)
 		mScriptEd->mErrorList->addElement(row);
 	}
 	mScriptEd->selectFirstError();
-	closeIfNeeded();
 }
 
 void LLLiveLSLEditor::loadAsset(BOOL is_new)
@@ -2027,6 +2071,26 @@ void LLLiveLSLEditor::onSearchReplace(void* userdata)
 	}
 }
 
+// Finishes LLLiveLSLEditor::uploadAssetLegacy() once the script has compiled.
+class LLLiveLSLCompileResponder : public LLScriptCompileThread::Responder
+{
+public:
+	LLLiveLSLCompileResponder(const LLUUID& object_id, LLViewerInventoryItem* item, BOOL is_running,
+							  const LLTransactionID& tid, const std::string& filename,
+							  const std::string& dst_filename, const std::string& err_filename);
+
+	/*virtual*/ void completed(BOOL success, const std::vector<std::string>& errors);
+
+private:
+	LLUUID mObjectID;
+	LLPointer<LLViewerInventoryItem> mItem;
+	BOOL mIsRunning;
+	LLTransactionID mTransactionID;
+	std::string mFilename;
+	std::string mDstFilename;
+	std::string mErrFilename;
+};
+
 struct LLLiveLSLSaveData
 {
 	LLLiveLSLSaveData(const LLUUID& id, const LLViewerInventoryItem* item, BOOL active);
@@ -2173,69 +2237,93 @@ void LLLiveLSLEditor::uploadAssetLegacy(const std::string& filename,
 	std::string dst_filename = llformat("%s.lso", filepath.c_str());
 	std::string err_filename = llformat("%s.out", filepath.c_str());
 
-	LLFILE *fp;
+	// Counts until the compile is done. The responder takes it from there.
+	getWindow()->incBusyCount();
+	mPendingUploads++;
 	const BOOL compile_to_mono = FALSE;
-	if(!lscript_compile(filename.c_str(),
-						dst_filename.c_str(),
-						err_filename.c_str(),
-						compile_to_mono,
-						asset_id.asString().c_str(),
-						gAgent.isGodlike()))
-	{
-		// load the error file into the error scrolllist
+	LLAppViewer::getScriptCompileThread()->compile(filename,
+												   dst_filename,
+												   err_filename,
+												   compile_to_mono,
+												   asset_id.asString(),
+												   gAgent.isGodlike(),
+												   new LLLiveLSLCompileResponder(mObjectID, mItem, is_running, tid,
+																				filename, dst_filename, err_filename));
+
+	// If we successfully saved it, then we should be able to check/uncheck the running box!
+	LLCheckBoxCtrl* runningCheckbox = getChild<LLCheckBoxCtrl>( "running");
+	runningCheckbox->setLabel(getString("script_running"));
+	runningCheckbox->setEnabled(TRUE);
+}
+
+LLLiveLSLCompileResponder::LLLiveLSLCompileResponder(const LLUUID& object_id,
+													 LLViewerInventoryItem* item,
+													 BOOL is_running,
+													 const LLTransactionID& tid,
+													 const std::string& filename,
+													 const std::string& dst_filename,
+													 const std::string& err_filename)
+:	mObjectID(object_id),
+	mItem(item),
+	mIsRunning(is_running),
+	mTransactionID(tid),
+	mFilename(filename),
+	mDstFilename(dst_filename),
+	mErrFilename(err_filename)
+{
+}
+
+void LLLiveLSLCompileResponder::completed(BOOL success, const std::vector<std::string>& errors)
+{
+	// uploadAssetLegacy() counted the window busy until the compile was
+	// done, whatever has become of the editor since.
+	gViewerWindow->getWindow()->decBusyCount();
+
+	LLLiveLSLEditor* self = LLLiveLSLEditor::find(mItem->getUUID(), mObjectID);
+	if (!success)
+	{
 		llinfos << "Compile failed!" << llendl;
-		if(NULL != (fp = LLFile::fopen(err_filename, "r")))
+		// don't set the asset id, because we want to save the
+		// script, even though the compile failed.
+		LLViewerObject* object = gObjectList.findObject(mObjectID);
+		if (object)
 		{
-			char buffer[MAX_STRING];		/*Flawfinder: ignore*/
-			std::string line;
-			while(!feof(fp)) 
-			{
-				
-				if (fgets(buffer, MAX_STRING, fp) == NULL)
-				{
-					buffer[0] = '\0';
-				}
-				if(feof(fp))
-				{
-					break;
-				}
-				else
-				{
-					line.assign(buffer);
-					LLStringUtil::stripNonprintable(line);
-				
-					LLSD row;
-					row["columns"][0]["value"] = line;
-					row["columns"][0]["font"] = "OCRA";
-					mScriptEd->mErrorList->addElement(row);
-				}
-			}
-			fclose(fp);
-			mScriptEd->selectFirstError();
-			// don't set the asset id, because we want to save the
-			// script, even though the compile failed.
-			//mItem->setAssetUUID(LLUUID::null);
 			object->saveScript(mItem, FALSE, false);
 			dialog_refresh_all();
 		}
+		if (self)
+		{
+			LLSD compile_errors = LLSD::emptyArray();
+			for (S32 i = 0; i < (S32)errors.size(); i++)
+			{
+				compile_errors.append(errors[i]);
+			}
+			self->showCompileErrors(compile_errors);
+		}
 	}
 	else
 	{
 		llinfos << "Compile worked!" << llendl;
-		// *TODO: Translate
-		mScriptEd->mErrorList->addCommentText(std::string("Compile successful, saving..."));
-		if(gAssetStorage)
+		if (self)
+		{
+			// *TODO: Translate
+			self->mScriptEd->mErrorList->addCommentText(std::string("Compile successful, saving..."));
+		}
+		if (gAssetStorage)
 		{
 			llinfos << "LLLiveLSLEditor::saveAsset "
 					<< mItem->getAssetUUID() << llendl;
-			getWindow()->incBusyCount();
-			mPendingUploads++;
-			LLLiveLSLSaveData* data = NULL;
-			data = new LLLiveLSLSaveData(mObjectID,
-										 mItem,
-										 is_running);
-			gAssetStorage->storeAssetData(dst_filename,
-										  tid,
+			// Busy again until onSaveBytecodeComplete().
+			gViewerWindow->getWindow()->incBusyCount();
+			if (self)
+			{
+				self->mPendingUploads++;
+			}
+			LLLiveLSLSaveData* data = new LLLiveLSLSaveData(mObjectID,
+															mItem,
+															mIsRunning);
+			gAssetStorage->storeAssetData(mDstFilename,
+										  mTransactionID,
 										  LLAssetType::AT_LSL_BYTECODE,
 										  &LLLiveLSLEditor::onSaveBytecodeComplete,
 										  (void*)data);
@@ -2243,15 +2331,20 @@ void LLLiveLSLEditor::uploadAssetLegacy(const std::string& filename,
 		}
 	}
 
-	// get rid of any temp files left lying around
-	LLFile::remove(filename);
-	LLFile::remove(err_filename);
-	LLFile::remove(dst_filename);
+	if (self)
+	{
+		self->mPendingUploads--;
+		if (self->mPendingUploads <= 0
+			&& self->mCloseAfterSave)
+		{
+			self->close();
+		}
+	}
 
-	// If we successfully saved it, then we should be able to check/uncheck the running box!
-	LLCheckBoxCtrl* runningCheckbox = getChild<LLCheckBoxCtrl>( "running");
-	runningCheckbox->setLabel(getString("script_running"));
-	runningCheckbox->setEnabled(TRUE);
+	// get rid of any temp files left lying around
+	LLFile::remove(mFilename);
+	LLFile::remove(mErrFilename);
+	LLFile::remove(mDstFilename);
 }
 
 void LLLiveLSLEditor::onSaveTextComplete(const LLUUID& asset_uuid, void* user_data, S32 status, LLExtStat ext_status) // StoreAssetData callback (fixed)
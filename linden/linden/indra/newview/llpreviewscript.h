@@ -58,6 +58,7 @@ class LLScriptEdCore : public LLPanel
 	friend class LLPreviewScript;
 	friend class LLPreviewLSL;
 	friend class LLLiveLSLEditor;
+	friend class LLLiveLSLCompileResponder;
 
 public:
 	LLScriptEdCore(
@@ -162,6 +163,8 @@ private:
 // Used to view and edit a LSL from your inventory.
 class LLPreviewLSL : public LLPreview
 {
+	friend class LLPreviewLSLCompileResponder;
+
 public:
 	LLPreviewLSL(const std::string& name, const LLRect& rect, const std::string& title,
 				 const LLUUID& item_uuid );
@@ -173,6 +176,7 @@ public:
 protected:
 	virtual BOOL canClose();
 	void closeIfNeeded();
+	void showCompileErrors(const LLSD& compile_errors);
 	virtual void reshape(S32 width, S32 height, BOOL called_from_parent = TRUE);
 
 	virtual void loadAsset();
@@ -213,6 +217,8 @@ protected:
 // Used to view and edit an LSL that is attached to an object.
 class LLLiveLSLEditor : public LLPreview
 {
+	friend class LLLiveLSLCompileResponder;
+
 public: 
 	LLLiveLSLEditor(const std::string& name, const LLRect& rect,
 					const std::string& title,
@@ -237,6 +243,7 @@ public:
 protected:
 	virtual BOOL canClose();
 	void closeIfNeeded();
+	void showCompileErrors(const LLSD& compile_errors);
 	virtual void draw();
 	virtual void reshape(S32 width, S32 height, BOOL called_from_parent = TRUE);
 
@@ -64,6 +64,7 @@ const F32 SG_OCCLUSION_FUDGE = 0.25f;
 static U32 sZombieGroups = 0;
 U32 LLSpatialGroup::sNodeCount = 0;
 BOOL LLSpatialGroup::sNoDelete = FALSE;
+BOOL LLSpatialGroup::sOcclusionViewStill = FALSE;
 
 static F32 sLastMaxTexPriority = 1.f;
 static F32 sCurMaxTexPriority = 1.f;
@@ -307,6 +308,7 @@ LLSpatialGroup::~LLSpatialGroup()
 void LLSpatialGroup::clearDrawMap()
 {
 	mDrawMap.clear();
+	mBatchLayout.clear();
 }
 
 BOOL LLSpatialGroup::isVisible() const
@@ -468,7 +470,7 @@ void validate_draw_info(LLDrawInfo& params)
 	}
 	
 	//bad indices
-	U32* indicesp = (U32*) params.mVertexBuffer->getIndicesPointer();
+	U32* indicesp = params.mVertexBuffer->isLocked() ? NULL : (U32*) params.mVertexBuffer->getMappedIndices();
 	if (indicesp)
 	{
 		for (U32 i = params.mOffset; i < params.mOffset+params.mCount; i++)
@@ -540,6 +542,7 @@ BOOL LLSpatialGroup::addObject(LLDrawable *drawablep, BOOL add_all, BOOL from_oc
 		drawablep->setSpatialGroup(this);
 		validate_drawable(drawablep);
 		setState(OBJECT_DIRTY | GEOM_DIRTY | DISCARD_QUERY);
+		mBatchLayout.clear();
 		if (drawablep->isSpatialBridge())
 		{
 			mBridgeList.push_back((LLSpatialBridge*) drawablep);
@@ -763,6 +766,7 @@ BOOL LLSpatialGroup::removeObject(LLDrawable *drawablep, BOOL from_octree)
 	{
 		drawablep->setSpatialGroup(NULL);
 		setState(GEOM_DIRTY);
+		mBatchLayout.clear();
 		if (drawablep->isSpatialBridge())
 		{
 			for (bridge_list_t::iterator i = mBridgeList.begin(); i != mBridgeList.end(); ++i)
@@ -799,6 +803,7 @@ void LLSpatialGroup::shift(const LLVector3 &offset)
 	//if (!mSpatialPartition->mRenderByGroup)
 	{
 		setState(GEOM_DIRTY);
+		mBatchLayout.clear(); //every face moved
 	}
 
 	if (mOcclusionVerts)
@@ -1168,6 +1173,7 @@ void LLSpatialGroup::destroyGL()
 		sQueryPool.release(mOcclusionQuery);
 		mOcclusionQuery = 0;
 	}
+	mOcclusionSchedule.reset();
 
 	delete [] mOcclusionVerts;
 	mOcclusionVerts = NULL;
@@ -1264,6 +1270,7 @@ void LLSpatialGroup::checkOcclusion()
 		if (parent && parent->isState(LLSpatialGroup::OCCLUDED))
 		{	//if the parent has been marked as occluded, the child is implicitly occluded
 			clearState(QUERY_PENDING | DISCARD_QUERY);
+			mOcclusionSchedule.discard();
 		}
 		else if (isState(QUERY_PENDING))
 		{	//otherwise, if a query is pending, read it back
@@ -1271,7 +1278,21 @@ void LLSpatialGroup::checkOcclusion()
 			GLuint res = 1;
 			if (!isState(DISCARD_QUERY) && mOcclusionQuery)
 			{
+				static LLCachedControl<S32> render_occlusion_latency("RenderOcclusionLatency", 2);
+				S32 frame = LLDrawable::getCurrentFrame();
+				GLuint available = 0;
+				glGetQueryObjectuivARB(mOcclusionQuery, GL_QUERY_RESULT_AVAILABLE_ARB, &available);
+				if (!mOcclusionSchedule.isReadable(frame, available, render_occlusion_latency))
+				{	//not in yet, keep the last answer rather than wait for this one
+					return;
+				}
+
 				glGetQueryObjectuivARB(mOcclusionQuery, GL_QUERY_RESULT_ARB, &res);	
+				mOcclusionSchedule.answer(frame, res > 0 ? FALSE : TRUE);
+			}
+			else
+			{
+				mOcclusionSchedule.discard();
 			}
 
 			if (res > 0)
@@ -1289,8 +1310,10 @@ void LLSpatialGroup::checkOcclusion()
 
 			clearState(QUERY_PENDING | DISCARD_QUERY);
 		}
-		else if (mSpatialPartition->isOcclusionEnabled() && isState(LLSpatialGroup::OCCLUDED))
-		{	//check occlusion has been issued for occluded node that has not had a query issued
+		else if (mSpatialPartition->isOcclusionEnabled() && isState(LLSpatialGroup::OCCLUDED) &&
+				 !mOcclusionSchedule.isCurrent(LLDrawable::getCurrentFrame(), mSpatialPartition->mLODPeriod, sOcclusionViewStill))
+		{	//check occlusion has been issued for occluded node that has not had a query issued,
+			//and whose last answer is too old to keep it occluded
 			assert_states_valid(this);
 			clearState(LLSpatialGroup::OCCLUDED, LLSpatialGroup::STATE_MODE_DIFF);
 			assert_states_valid(this);
@@ -1313,6 +1336,10 @@ void LLSpatialGroup::doOcclusion(LLCamera* camera)
 			clearState(LLSpatialGroup::OCCLUDED, LLSpatialGroup::STATE_MODE_DIFF);
 			assert_states_valid(this);
 		}
+		else if (isState(LLSpatialGroup::QUERY_PENDING) && !isState(LLSpatialGroup::DISCARD_QUERY))
+		{
+			//the last query has not been read back yet, wait for it
+		}
 		else
 		{
 			{
@@ -1354,10 +1381,49 @@ void LLSpatialGroup::doOcclusion(LLCamera* camera)
 
 			setState(LLSpatialGroup::QUERY_PENDING);
 			clearState(LLSpatialGroup::DISCARD_QUERY);
+			mOcclusionSchedule.issue(LLDrawable::getCurrentFrame());
 		}
 	}
 }
 
+BOOL LLSpatialGroup::isOcclusionDue()
+{
+	return mOcclusionSchedule.isDue(LLDrawable::getCurrentFrame(), mSpatialPartition->mLODPeriod,
+									isState(LLSpatialGroup::OCCLUDED), sOcclusionViewStill);
+}
+
+BOOL LLSpatialGroup::hasVisibleChild()
+{
+	S32 last_frame = LLDrawable::getCurrentFrame() - 1;
+	for (U32 i = 0; i < mOctreeNode->getChildCount(); i++)
+	{	//a child's bounds are inside ours, so if it was visible, so were we
+		LLSpatialGroup* child = (LLSpatialGroup*) mOctreeNode->getChild(i)->getListener(0);
+		if (child && child->mVisible == last_frame &&
+			child->mOcclusionSchedule.hasAnswer() && !child->mOcclusionSchedule.isOccluded())
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+//static
+void LLSpatialGroup::updateOcclusionView(LLCamera& camera)
+{
+	static LLVector3 last_origin;
+	static LLVector3 last_at;
+	static F32 last_view = 0.f;
+
+	sOcclusionViewStill = (camera.getOrigin() - last_origin).magVecSquared() < 0.0001f &&
+						  camera.getAtAxis() * last_at > 0.99999f &&
+						  camera.getView() == last_view;
+
+	last_origin = camera.getOrigin();
+	last_at = camera.getAtAxis();
+	last_view = camera.getView();
+}
+
 //==============================================
 
 LLSpatialPartition::LLSpatialPartition(U32 data_mask, U32 buffer_usage)
@@ -1591,9 +1657,9 @@ public:
 	
 	virtual void processGroup(LLSpatialGroup* group)
 	{
-		if (group->needsUpdate() ||
-			group->mVisible < LLDrawable::getCurrentFrame() - 1)
-		{
+		if (group->mVisible < LLDrawable::getCurrentFrame() - 1 ||
+			(group->isOcclusionDue() && !group->hasVisibleChild()))
+		{ //groups coming into view are queried at once, others when due unless a child shows them visible
 			group->doOcclusion(mCamera);
 		}
 		gPipeline.markNotCulled(group, *mCamera);
@@ -43,6 +43,8 @@
 #include "llcubemap.h"
 #include "lldrawpool.h"
 #include "llface.h"
+#include "llbatchlayout.h"
+#include "llocclusionschedule.h"
 
 #include <queue>
 
@@ -156,6 +158,7 @@ class LLSpatialGroup : public LLOctreeListener<LLDrawable>
 public:
 	static U32 sNodeCount;
 	static BOOL sNoDelete; //deletion of spatial groups and draw info not allowed if TRUE
+	static BOOL sOcclusionViewStill; //TRUE if the view has not moved since the last frame
 
 	typedef std::vector<LLPointer<LLSpatialGroup> > sg_vector_t;
 	typedef std::set<LLPointer<LLSpatialGroup> > sg_set_t;
@@ -248,6 +251,9 @@ public:
 	void buildOcclusion(); //rebuild mOcclusionVerts
 	void checkOcclusion(); //read back last occlusion query (if any)
 	void doOcclusion(LLCamera* camera); //issue occlusion query
+	BOOL isOcclusionDue(); //is an occlusion query due this frame, from the answers so far
+	BOOL hasVisibleChild(); //was a child, and so this group, visible last frame
+	static void updateOcclusionView(LLCamera& camera); //note whether the view moved since the last frame
 	void destroyGL();
 	
 	void updateDistance(LLCamera& camera);
@@ -290,8 +296,10 @@ public:
 	LLVector3 mObjectBounds[2];
 
 	LLPointer<LLVertexBuffer> mVertexBuffer;
+	LLBatchLayout			mBatchLayout; //how the faces were batched at the last full rebuild
 	F32*					mOcclusionVerts;
 	GLuint					mOcclusionQuery;
+	LLOcclusionSchedule		mOcclusionSchedule; //when to ask mOcclusionQuery again, and read its answer
 
 	U32 mBufferUsage;
 	draw_map_t mDrawMap;
@@ -552,6 +560,16 @@ public:
 class LLVolumeGeometryManager: public LLGeometryManager
 {
 public:
+	//lists of faces genDrawInfo batches separately
+	enum
+	{
+		FACES_SIMPLE,
+		FACES_BUMP,
+		FACES_FULLBRIGHT,
+		FACES_ALPHA,
+		NUM_FACE_LISTS
+	};
+
 	virtual ~LLVolumeGeometryManager() { }
 	virtual void rebuildGeom(LLSpatialGroup* group);
 	virtual void rebuildMesh(LLSpatialGroup* group);
@@ -559,6 +577,12 @@ public:
 	void genDrawInfo(LLSpatialGroup* group, U32 mask, std::vector<LLFace*>& faces, BOOL distance_sort = FALSE);
 	void registerFace(LLSpatialGroup* group, LLFace* facep, U32 type);
 
+protected:
+	//pick the face list for a face with geometry, setting up its pool type and state
+	S32 sortFace(LLDrawable* drawablep, LLVOVolume* vobj, LLFace* facep);
+	//if the group's faces would batch as they did at the last full rebuild,
+	//rebuild the dirty ones in place and return TRUE
+	BOOL rebuildGeomInPlace(LLSpatialGroup* group, U32 context, U32 max_total);
 };
 
 //spatial partition that uses volume geometry manager (implemented in LLVOVolume.cpp)
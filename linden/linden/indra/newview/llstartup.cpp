@@ -67,6 +67,7 @@
 #include "llmd5.h"
 #include "llmemorystream.h"
 #include "llmessageconfig.h"
+#include "llmessagelog.h"
 #include "llmoveview.h"
 #include "llregionhandle.h"
 #include "llsd.h"
@@ -599,6 +600,13 @@ bool idle_startup()
 				msg->startLogging();
 			}
 
+			if (gSavedSettings.getBOOL("MessageCapture"))
+			{
+				std::string capture_file = gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "messages.llmc");
+				LL_INFOS("AppInit") << "Capturing messages to " << capture_file << LL_ENDL;
+				LLMessageLog::startCapture(capture_file);
+			}
+
 			// start the xfer system. by default, choke the downloads
 			// a lot...
 			const S32 VIEWER_MAX_XFER = 3;
@@ -2142,6 +2150,8 @@ bool idle_startup()
 		{
 			gCacheName = new LLCacheName(gMessageSystem);
 			gCacheName->addObserver(callback_cache_name);
+			gCacheName->setFlushInterval(gSavedSettings.getF32("NameCacheFlushInterval"),
+										 gSavedSettings.getU32("NameCacheFlushBatch"));
 	
 			// Load stored cache if possible
 			LLAppViewer::instance()->loadNameCache();
@@ -38,6 +38,9 @@
 
 #include "llviewerimagelist.h"
 #include "llpatchvertexarray.h"
+#include "llpatchdecoder.h"
+#include "llpatchnormals.h"
+#include "llterraincomposer.h"
 #include "patch_dct.h"
 #include "patch_code.h"
 #include "bitpack.h"
@@ -70,6 +73,10 @@ S32 LLSurface::sTextureSize = 256;
 S32 LLSurface::sTexelsUpdated = 0;
 F32 LLSurface::sTextureUpdateTime = 0.f;
 LLStat LLSurface::sTexelsUpdatedPerSecStat;
+LLPatchDecoderThread* LLSurface::sDecoderThread = NULL;
+LLPatchNormalsThread* LLSurface::sNormalsThread = NULL;
+LLTerrainComposerThread* LLSurface::sComposerThread = NULL;
+std::set<LLSurface*> LLSurface::sPending;
 
 // ---------------- LLSurface:: Public Members ---------------
 
@@ -117,6 +124,10 @@ LLSurface::LLSurface(U32 type, LLViewerRegion *regionp) :
 
 LLSurface::~LLSurface()
 {
+	cancelDecodedPatches();
+	cancelPatchNormals();
+	cancelCompositions();
+
 	delete [] mSurfaceZ;
 	mSurfaceZ = NULL;
 
@@ -156,6 +167,46 @@ LLSurface::~LLSurface()
 
 void LLSurface::initClasses()
 {
+	updateThreads();
+}
+
+// static
+void LLSurface::cleanupClass()
+{
+	// The simulator won't send these again, so they go in rather than away.
+	// Decoding dirties normals, so those are collected last.
+	while (!sPending.empty())
+	{
+		LLSurface* surfacep = *sPending.begin();
+		surfacep->collectDecodedPatches(TRUE);
+		surfacep->collectPatchNormals(TRUE);
+		surfacep->collectCompositions(TRUE);
+		sPending.erase(surfacep);
+	}
+	delete sDecoderThread;
+	sDecoderThread = NULL;
+	delete sNormalsThread;
+	sNormalsThread = NULL;
+	delete sComposerThread;
+	sComposerThread = NULL;
+}
+
+// static
+void LLSurface::updateThreads()
+{
+	cleanupClass();
+	if (gSavedSettings.getBOOL("TerrainDecompressOnThread"))
+	{
+		sDecoderThread = new LLPatchDecoderThread();
+	}
+	if (gSavedSettings.getBOOL("TerrainNormalsOnThread"))
+	{
+		sNormalsThread = new LLPatchNormalsThread();
+	}
+	if (gSavedSettings.getBOOL("TerrainComposeOnThread"))
+	{
+		sComposerThread = new LLTerrainComposerThread();
+	}
 }
 
 void LLSurface::setRegion(LLViewerRegion *regionp)
@@ -654,6 +705,20 @@ void LLSurface::updatePatchVisibilities(LLAgent &agent)
 
 BOOL LLSurface::idleUpdate(F32 max_update_time)
 {
+	// Heights are needed whether or not terrain is drawn.
+	if (!mDecodeHandles.empty())
+	{
+		collectDecodedPatches(FALSE);
+	}
+	if (!mNormalsHandles.empty())
+	{
+		collectPatchNormals(FALSE);
+	}
+	if (!mComposeHandles.empty())
+	{
+		collectCompositions(FALSE);
+	}
+
 	if (!gPipeline.hasRenderType(LLPipeline::RENDER_TYPE_TERRAIN))
 	{
 		return FALSE;
@@ -673,16 +738,43 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 
 	// Always call updateNormals() / updateVerticalStats()
 	//  every frame to avoid artifacts
+	patch_normals_vec_t normals;
+	terrain_composer_vec_t composers;
 	for(std::set<LLSurfacePatch *>::iterator iter = mDirtyPatchList.begin();
 		iter != mDirtyPatchList.end(); )
 	{
 		std::set<LLSurfacePatch *>::iterator curiter = iter++;
 		LLSurfacePatch *patchp = *curiter;
-		patchp->updateNormals();
+		if (sNormalsThread)
+		{
+			LLPatchNormals* patch_normals = patchp->prepareNormals();
+			if (patch_normals)
+			{
+				normals.push_back(patch_normals);
+			}
+		}
+		else
+		{
+			patchp->updateNormals();
+		}
 		patchp->updateVerticalStats();
 		if (max_update_time == 0.f || update_timer.getElapsedTimeF32() < max_update_time)
 		{
-			if (patchp->updateTexture())
+			BOOL updated;
+			if (sComposerThread)
+			{
+				LLTerrainComposer* composer = NULL;
+				updated = patchp->prepareTexture(composer);
+				if (composer)
+				{
+					composers.push_back(composer);
+				}
+			}
+			else
+			{
+				updated = patchp->updateTexture();
+			}
+			if (updated)
 			{
 				did_update = TRUE;
 				patchp->clearDirty();
@@ -690,6 +782,16 @@ BOOL LLSurface::idleUpdate(F32 max_update_time)
 			}
 		}
 	}
+	if (!normals.empty())
+	{
+		mNormalsHandles.push_back(sNormalsThread->calculate(normals));
+		sPending.insert(this);
+	}
+	if (!composers.empty())
+	{
+		mComposeHandles.push_back(sComposerThread->compose(composers));
+		sPending.insert(this);
+	}
 	return did_update;
 }
 
@@ -701,10 +803,10 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 	S32 patch[LARGE_PATCH_SIZE*LARGE_PATCH_SIZE];
 	LLSurfacePatch *patchp;
 
-	init_patch_decompressor(gopp->patch_size);
 	gopp->stride = mGridsPerEdge;
 	set_group_of_patch_header(gopp);
 
+	LLPatchDecoder* decoder = new LLPatchDecoder(gopp->patch_size);
 	while (1)
 	{
 		decode_patch_header(bitpack, &ph, b_large_patch);
@@ -735,6 +837,7 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 				<< " quant_wbits " << (S32)ph.quant_wbits
 				<< " patchids " << (S32)ph.patchids
 				<< llendl;
+			delete decoder;
             LLAppViewer::instance()->badNetworkHandler();
 			return;
 		}
@@ -743,7 +846,61 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 
 
 		decode_patch(bitpack, patch);
-		decompress_patch(patchp->getDataZ(), patch, &ph);
+		decoder->addPatch(ph, patch, patchp);
+	}
+
+	if (sDecoderThread)
+	{
+		mDecodeHandles.push_back(sDecoderThread->decompress(decoder));
+		sPending.insert(this);
+	}
+	else
+	{
+		decoder->decompress();
+		applyDecodedPatches(*decoder);
+		delete decoder;
+	}
+}
+
+void LLSurface::applyDecodedPatches(const LLPatchDecoder& decoder)
+{
+	for (S32 k = 0; k < decoder.getNumPatches(); k++)
+	{
+		LLSurfacePatch* patchp = (LLSurfacePatch*)decoder.getUserData(k);
+
+		// Terraforming resends whole patches for a few changed heights.
+		// Only the normals around those need working out again.
+		BOOL had_data = patchp->getHasReceivedData();
+		LLRect changed;
+		if (had_data)
+		{
+			S32 size = decoder.getPatchSize();
+			const F32* patch = decoder.getPatch(k);
+			const F32* dest = patchp->getDataZ();
+			for (S32 y = 0; y < size; y++)
+			{
+				for (S32 x = 0; x < size; x++)
+				{
+					if (patch[y * size + x] != dest[y * mGridsPerEdge + x])
+					{
+						LLRect point(x, y + 1, x + 1, y);
+						if (changed.isEmpty())
+						{
+							changed = point;
+						}
+						else
+						{
+							changed.unionWith(point);
+						}
+					}
+				}
+			}
+			if (changed.isEmpty())
+			{
+				continue;
+			}
+		}
+		decoder.copyPatch(k, patchp->getDataZ(), mGridsPerEdge);
 
 		// Update edges for neighbors.  Need to guarantee that this gets done before we generate vertical stats.
 		patchp->updateNorthEdge();
@@ -763,11 +920,188 @@ void LLSurface::decompressDCTPatch(LLBitPack &bitpack, LLGroupHeader *gopp, BOOL
 		}
 
 		// Dirty patch statistics, and flag that the patch has data.
-		patchp->dirtyZ();
+		if (had_data)
+		{
+			patchp->dirtyZ(changed);
+		}
+		else
+		{
+			patchp->dirtyZ();
+		}
 		patchp->setHasReceivedData();
 	}
 }
 
+void LLSurface::collectDecodedPatches(BOOL wait)
+{
+	while (!mDecodeHandles.empty())
+	{
+		LLPatchDecoder* decoder = NULL;
+		if (!sDecoderThread->getResult(mDecodeHandles.front(), decoder))
+		{
+			if (!wait)
+			{
+				break;
+			}
+			// A region's worth takes a millisecond or so.
+			sDecoderThread->update(0);
+			ms_sleep(1);
+			continue;
+		}
+		mDecodeHandles.pop_front();
+		if (decoder)
+		{
+			applyDecodedPatches(*decoder);
+			delete decoder;
+		}
+	}
+	if (mDecodeHandles.empty() && mNormalsHandles.empty() && mComposeHandles.empty())
+	{
+		sPending.erase(this);
+	}
+}
+
+void LLSurface::cancelDecodedPatches()
+{
+	for (std::deque<LLQueuedThread::handle_t>::iterator iter = mDecodeHandles.begin();
+		 iter != mDecodeHandles.end(); ++iter)
+	{
+		sDecoderThread->abortRequest(*iter, false);
+	}
+	while (!mDecodeHandles.empty())
+	{
+		LLPatchDecoder* decoder = NULL;
+		if (sDecoderThread->getResult(mDecodeHandles.front(), decoder))
+		{
+			delete decoder;
+			mDecodeHandles.pop_front();
+		}
+		else
+		{
+			sDecoderThread->update(0);
+			ms_sleep(1);
+		}
+	}
+	if (mNormalsHandles.empty() && mComposeHandles.empty())
+	{
+		sPending.erase(this);
+	}
+}
+
+void LLSurface::collectPatchNormals(BOOL wait)
+{
+	while (!mNormalsHandles.empty())
+	{
+		patch_normals_vec_t normals;
+		if (!sNormalsThread->getResult(mNormalsHandles.front(), normals))
+		{
+			if (!wait)
+			{
+				break;
+			}
+			sNormalsThread->update(0);
+			ms_sleep(1);
+			continue;
+		}
+		mNormalsHandles.pop_front();
+		for (patch_normals_vec_t::iterator iter = normals.begin();
+			 iter != normals.end(); ++iter)
+		{
+			LLSurfacePatch* patchp = (LLSurfacePatch*)(*iter)->getUserData();
+			patchp->applyNormals(**iter);
+		}
+		for_each(normals.begin(), normals.end(), DeletePointer());
+	}
+	if (mDecodeHandles.empty() && mNormalsHandles.empty() && mComposeHandles.empty())
+	{
+		sPending.erase(this);
+	}
+}
+
+void LLSurface::cancelPatchNormals()
+{
+	for (std::deque<LLQueuedThread::handle_t>::iterator iter = mNormalsHandles.begin();
+		 iter != mNormalsHandles.end(); ++iter)
+	{
+		sNormalsThread->abortRequest(*iter, false);
+	}
+	while (!mNormalsHandles.empty())
+	{
+		patch_normals_vec_t normals;
+		if (sNormalsThread->getResult(mNormalsHandles.front(), normals))
+		{
+			for_each(normals.begin(), normals.end(), DeletePointer());
+			mNormalsHandles.pop_front();
+		}
+		else
+		{
+			sNormalsThread->update(0);
+			ms_sleep(1);
+		}
+	}
+	if (mDecodeHandles.empty() && mComposeHandles.empty())
+	{
+		sPending.erase(this);
+	}
+}
+
+void LLSurface::collectCompositions(BOOL wait)
+{
+	while (!mComposeHandles.empty())
+	{
+		terrain_composer_vec_t composers;
+		if (!sComposerThread->getResult(mComposeHandles.front(), composers))
+		{
+			if (!wait)
+			{
+				break;
+			}
+			sComposerThread->update(0);
+			ms_sleep(1);
+			continue;
+		}
+		mComposeHandles.pop_front();
+		for (terrain_composer_vec_t::iterator iter = composers.begin();
+			 iter != composers.end(); ++iter)
+		{
+			LLSurfacePatch* patchp = (LLSurfacePatch*)(*iter)->getUserData();
+			patchp->applyComposition(**iter);
+		}
+		for_each(composers.begin(), composers.end(), DeletePointer());
+	}
+	if (mDecodeHandles.empty() && mNormalsHandles.empty() && mComposeHandles.empty())
+	{
+		sPending.erase(this);
+	}
+}
+
+void LLSurface::cancelCompositions()
+{
+	for (std::deque<LLQueuedThread::handle_t>::iterator iter = mComposeHandles.begin();
+		 iter != mComposeHandles.end(); ++iter)
+	{
+		sComposerThread->abortRequest(*iter, false);
+	}
+	while (!mComposeHandles.empty())
+	{
+		terrain_composer_vec_t composers;
+		if (sComposerThread->getResult(mComposeHandles.front(), composers))
+		{
+			for_each(composers.begin(), composers.end(), DeletePointer());
+			mComposeHandles.pop_front();
+		}
+		else
+		{
+			sComposerThread->update(0);
+			ms_sleep(1);
+		}
+	}
+	if (mDecodeHandles.empty() && mNormalsHandles.empty())
+	{
+		sPending.erase(this);
+	}
+}
+
 
 // Retrurns TRUE if "position" is within the bounds of surface.
 // "position" is region-local
@@ -33,6 +33,8 @@
 #ifndef LL_LLSURFACE_H
 #define LL_LLSURFACE_H
 
+#include <deque>
+
 //#include "vmath.h"
 #include "v3math.h"
 #include "v3dmath.h"
@@ -46,6 +48,7 @@
 
 #include "llvowater.h"
 #include "llpatchvertexarray.h"
+#include "llqueuedthread.h"
 #include "llviewerimage.h"
 
 class LLTimer;
@@ -69,6 +72,10 @@ class LLViewerRegion;
 class LLSurfacePatch;
 class LLBitPack;
 class LLGroupHeader;
+class LLPatchDecoder;
+class LLPatchDecoderThread;
+class LLPatchNormalsThread;
+class LLTerrainComposerThread;
 
 class LLSurface 
 {
@@ -77,6 +84,11 @@ public:
 	virtual ~LLSurface();
 
 	static void initClasses(); // Do class initialization for LLSurface and its child classes.
+	static void cleanupClass();
+	// Starts or stops the decoder, normals and composer threads, from the
+	// TerrainDecompressOnThread, TerrainNormalsOnThread and
+	// TerrainComposeOnThread settings.
+	static void updateThreads();
 
 	void create(const S32 surface_grid_width,
 				const S32 surface_patch_width,
@@ -187,6 +199,24 @@ protected:
 	void createPatchData();		// Allocates memory for patches.
 	void destroyPatchData();    // Deallocates memory for patches.
 
+	// Copies decompressed patches into place and updates their edges.
+	void applyDecodedPatches(const LLPatchDecoder& decoder);
+	// Applies the patches decompressed on the thread so far, in the order
+	// they arrived. With wait set, waits for all of them.
+	void collectDecodedPatches(BOOL wait);
+	// Drops the patches still on the thread.
+	void cancelDecodedPatches();
+	// Applies the normals worked out on the thread so far, oldest first.
+	// With wait set, waits for all of them.
+	void collectPatchNormals(BOOL wait);
+	// Drops the normals still on the thread.
+	void cancelPatchNormals();
+	// Applies the compositions done on the thread so far, oldest first.
+	// With wait set, waits for all of them.
+	void collectCompositions(BOOL wait);
+	// Drops the compositions still on the thread.
+	void cancelCompositions();
+
 	BOOL generateWaterTexture(const F32 x, const F32 y,
 						const F32 width, const F32 height);		// Generate texture from composition values.
 
@@ -206,6 +236,13 @@ protected:
 
 	std::set<LLSurfacePatch *> mDirtyPatchList;
 
+	// Batches of patches on the decoder thread, oldest first.
+	std::deque<LLQueuedThread::handle_t> mDecodeHandles;
+	// Batches of patch normals on the normals thread, oldest first.
+	std::deque<LLQueuedThread::handle_t> mNormalsHandles;
+	// Batches of patch compositions on the composer thread, oldest first.
+	std::deque<LLQueuedThread::handle_t> mComposeHandles;
+
 
 	// The textures should never be directly initialized - use the setter methods!
 	LLPointer<LLViewerImage> mSTexturep;		// Texture for surface
@@ -231,6 +268,11 @@ protected:
 private:
 	LLViewerRegion *mRegionp; // Patch whose coordinate system this surface is using.
 	static S32	sTextureSize;				// Size of the surface texture
+
+	static LLPatchDecoderThread* sDecoderThread;
+	static LLPatchNormalsThread* sNormalsThread;
+	static LLTerrainComposerThread* sComposerThread;
+	static std::set<LLSurface*> sPending;	// Surfaces with work on any of them
 };
 
 
@@ -33,6 +33,7 @@
 #include "llviewerprecompiledheaders.h"
 
 #include "llsurfacepatch.h"
+#include "llpatchnormals.h"
 #include "llpatchvertexarray.h"
 #include "llviewerobjectlist.h"
 #include "llvosurfacepatch.h"
@@ -58,6 +59,7 @@ LLSurfacePatch::LLSurfacePatch() :
 	mDirty(FALSE),
 	mDirtyZStats(TRUE),
 	mHeightsGenerated(FALSE),
+	mComposing(FALSE),
 	mDataOffset(0),
 	mDataZ(NULL),
 	mVObjp(NULL),
@@ -248,114 +250,74 @@ void LLSurfacePatch::eval(const U32 x, const U32 y, const U32 stride, LLVector3
 
 void LLSurfacePatch::calcNormal(const U32 x, const U32 y, const U32 stride)
 {
-	U32 patch_width = mSurfacep->mPVArray.mPatchWidth;
 	U32 surface_stride = mSurfacep->getGridsPerEdge();
 
 	const F32 mpg = mSurfacep->getMetersPerGrid() * stride;
 
-	S32 poffsets[2][2][2];
-	poffsets[0][0][0] = x - stride;
-	poffsets[0][0][1] = y - stride;
-
-	poffsets[0][1][0] = x - stride;
-	poffsets[0][1][1] = y + stride;
-
-	poffsets[1][0][0] = x + stride;
-	poffsets[1][0][1] = y - stride;
-
-	poffsets[1][1][0] = x + stride;
-	poffsets[1][1][1] = y + stride;
-
-	const LLSurfacePatch *ppatches[2][2];
-
-	// LLVector3 p1, p2, p3, p4;
+	*(mDataNorm + surface_stride * y + x) =
+		LLPatchNormals::calcNormal(resolveZ(x - stride, y - stride),
+								   resolveZ(x - stride, y + stride),
+								   resolveZ(x + stride, y - stride),
+								   resolveZ(x + stride, y + stride),
+								   mpg);
+}
 
-	ppatches[0][0] = this;
-	ppatches[0][1] = this;
-	ppatches[1][0] = this;
-	ppatches[1][1] = this;
+F32 LLSurfacePatch::resolveZ(S32 x, S32 y) const
+{
+	S32 patch_width = mSurfacep->mPVArray.mPatchWidth;
+	U32 surface_stride = mSurfacep->getGridsPerEdge();
+	const LLSurfacePatch *patchp = this;
 
-	U32 i, j;
-	for (i = 0; i < 2; i++)
+	if (x < 0)
 	{
-		for (j = 0; j < 2; j++)
+		if (!patchp->getNeighborPatch(WEST))
 		{
-			if (poffsets[i][j][0] < 0)
-			{
-				if (!ppatches[i][j]->getNeighborPatch(WEST))
-				{
-					poffsets[i][j][0] = 0;
-				}
-				else
-				{
-					poffsets[i][j][0] += patch_width;
-					ppatches[i][j] = ppatches[i][j]->getNeighborPatch(WEST);
-				}
-			}
-			if (poffsets[i][j][1] < 0)
-			{
-				if (!ppatches[i][j]->getNeighborPatch(SOUTH))
-				{
-					poffsets[i][j][1] = 0;
-				}
-				else
-				{
-					poffsets[i][j][1] += patch_width;
-					ppatches[i][j] = ppatches[i][j]->getNeighborPatch(SOUTH);
-				}
-			}
-			if (poffsets[i][j][0] >= (S32)patch_width)
-			{
-				if (!ppatches[i][j]->getNeighborPatch(EAST))
-				{
-					poffsets[i][j][0] = patch_width - 1;
-				}
-				else
-				{
-					poffsets[i][j][0] -= patch_width;
-					ppatches[i][j] = ppatches[i][j]->getNeighborPatch(EAST);
-				}
-			}
-			if (poffsets[i][j][1] >= (S32)patch_width)
-			{
-				if (!ppatches[i][j]->getNeighborPatch(NORTH))
-				{
-					poffsets[i][j][1] = patch_width - 1;
-				}
-				else
-				{
-					poffsets[i][j][1] -= patch_width;
-					ppatches[i][j] = ppatches[i][j]->getNeighborPatch(NORTH);
-				}
-			}
+			x = 0;
+		}
+		else
+		{
+			x += patch_width;
+			patchp = patchp->getNeighborPatch(WEST);
+		}
+	}
+	if (y < 0)
+	{
+		if (!patchp->getNeighborPatch(SOUTH))
+		{
+			y = 0;
+		}
+		else
+		{
+			y += patch_width;
+			patchp = patchp->getNeighborPatch(SOUTH);
+		}
+	}
+	if (x >= patch_width)
+	{
+		if (!patchp->getNeighborPatch(EAST))
+		{
+			x = patch_width - 1;
+		}
+		else
+		{
+			x -= patch_width;
+			patchp = patchp->getNeighborPatch(EAST);
+		}
+	}
+	if (y >= patch_width)
+	{
+		if (!patchp->getNeighborPatch(NORTH))
+		{
+			y = patch_width - 1;
+		}
+		else
+		{
+			y -= patch_width;
+			patchp = patchp->getNeighborPatch(NORTH);
 		}
 	}
 
-	LLVector3 p00(-mpg,-mpg,
-				  *(ppatches[0][0]->mDataZ
-				  + poffsets[0][0][0]
-				  + poffsets[0][0][1]*surface_stride));
-	LLVector3 p01(-mpg,+mpg,
-				  *(ppatches[0][1]->mDataZ
-				  + poffsets[0][1][0]
-				  + poffsets[0][1][1]*surface_stride));
-	LLVector3 p10(+mpg,-mpg,
-				  *(ppatches[1][0]->mDataZ
-				  + poffsets[1][0][0]
-				  + poffsets[1][0][1]*surface_stride));
-	LLVector3 p11(+mpg,+mpg,
-				  *(ppatches[1][1]->mDataZ
-				  + poffsets[1][1][0]
-				  + poffsets[1][1][1]*surface_stride));
-
-	LLVector3 c1 = p11 - p00;
-	LLVector3 c2 = p01 - p10;
-
-	LLVector3 normal = c1;
-	normal %= c2;
-	normal.normVec();
-
-	*(mDataNorm + surface_stride * y + x) = normal;
+	return *(patchp->mDataZ + x + y*surface_stride);
 }
 
 const LLVector3 &LLSurfacePatch::getNormal(const U32 x, const U32 y) const
@@ -451,63 +413,50 @@ void LLSurfacePatch::updateVerticalStats()
 
 
 void LLSurfacePatch::updateNormals() 
+{
+	LLPatchNormals* normals = prepareNormals();
+	if (normals)
+	{
+		normals->calculate();
+		applyNormals(*normals);
+		delete normals;
+	}
+}
+
+LLPatchNormals* LLSurfacePatch::prepareNormals()
 {
 	if (mSurfacep->mType == 'w')
 	{
-		return;
+		return NULL;
 	}
 	U32 grids_per_patch_edge = mSurfacep->getGridsPerPatchEdge();
 	U32 grids_per_edge = mSurfacep->getGridsPerEdge();
+	S32 width = (S32)grids_per_patch_edge;
 
-	BOOL dirty_patch = FALSE;
+	LLPatchNormals* normals = new LLPatchNormals(width, mSurfacep->getMetersPerGrid(), this);
 
-	U32 i, j;
 	// update the east edge
 	if (mNormalsInvalid[EAST] || mNormalsInvalid[NORTHEAST] || mNormalsInvalid[SOUTHEAST])
 	{
-		for (j = 0; j <= grids_per_patch_edge; j++)
-		{
-			calcNormal(grids_per_patch_edge, j, 2);
-			calcNormal(grids_per_patch_edge - 1, j, 2);
-			calcNormal(grids_per_patch_edge - 2, j, 2);
-		}
-
-		dirty_patch = TRUE;
+		normals->addRect(LLRect(width - 2, width + 1, width + 1, 0));
 	}
 
 	// update the north edge
 	if (mNormalsInvalid[NORTHEAST] || mNormalsInvalid[NORTH] || mNormalsInvalid[NORTHWEST])
 	{
-		for (i = 0; i <= grids_per_patch_edge; i++)
-		{
-			calcNormal(i, grids_per_patch_edge, 2);
-			calcNormal(i, grids_per_patch_edge - 1, 2);
-			calcNormal(i, grids_per_patch_edge - 2, 2);
-		}
-
-		dirty_patch = TRUE;
+		normals->addRect(LLRect(0, width + 1, width + 1, width - 2));
 	}
 
 	// update the west edge
 	if (mNormalsInvalid[NORTHWEST] || mNormalsInvalid[WEST] || mNormalsInvalid[SOUTHWEST])
 	{
-		for (j = 0; j < grids_per_patch_edge; j++)
-		{
-			calcNormal(0, j, 2);
-			calcNormal(1, j, 2);
-		}
-		dirty_patch = TRUE;
+		normals->addRect(LLRect(0, width, 2, 0));
 	}
 
 	// update the south edge
 	if (mNormalsInvalid[SOUTHWEST] || mNormalsInvalid[SOUTH] || mNormalsInvalid[SOUTHEAST])
 	{
-		for (i = 0; i < grids_per_patch_edge; i++)
-		{
-			calcNormal(i, 0, 2);
-			calcNormal(i, 1, 2);
-		}
-		dirty_patch = TRUE;
+		normals->addRect(LLRect(0, 2, width, 0));
 	}
 
 	// Invalidating the northeast corner is different, because depending on what the adjacent neighbors are,
@@ -581,35 +530,72 @@ void LLSurfacePatch::updateNormals()
 			// We've got a northeast patch in the same surface.
 			// The z and normals will be handled by that patch.
 		}
-		calcNormal(grids_per_patch_edge, grids_per_patch_edge, 2);
-		calcNormal(grids_per_patch_edge, grids_per_patch_edge - 1, 2);
-		calcNormal(grids_per_patch_edge - 1, grids_per_patch_edge, 2);
-		calcNormal(grids_per_patch_edge - 1, grids_per_patch_edge - 1, 2);
-		dirty_patch = TRUE;
+		normals->addRect(LLRect(width - 1, width + 1, width + 1, width - 1));
 	}
 
 	// update the middle normals
 	if (mNormalsInvalid[MIDDLE])
 	{
-		for (j=2; j < grids_per_patch_edge - 2; j++)
+		normals->addRect(LLRect(2, width - 2, width - 2, 2));
+	}
+
+	// and those under heights that changed
+	normals->addRect(mDirtyNormals);
+	mDirtyNormals = LLRect(0, 0, 0, 0);
+
+	for (U32 i = 0; i < 9; i++)
+	{
+		mNormalsInvalid[i] = FALSE;
+	}
+
+	if (normals->isEmpty())
+	{
+		delete normals;
+		return NULL;
+	}
+
+	// Looked up here, where the neighbors are.
+	LLRect heights = normals->getHeightsRect();
+	for (S32 y = heights.mBottom; y < heights.mTop; y++)
+	{
+		for (S32 x = heights.mLeft; x < heights.mRight; x++)
 		{
-			for (i=2; i < grids_per_patch_edge - 2; i++)
+			normals->setHeight(x, y, resolveZ(x, y));
+		}
+	}
+	return normals;
+}
+
+void LLSurfacePatch::applyNormals(const LLPatchNormals& normals)
+{
+	U32 grids_per_edge = mSurfacep->getGridsPerEdge();
+	const LLRect& rect = normals.getRect();
+	for (S32 y = rect.mBottom; y < rect.mTop; y++)
+	{
+		for (S32 x = rect.mLeft; x < rect.mRight; x++)
+		{
+			if (normals.contains(x, y))
 			{
-				calcNormal(i, j, 2);
+				*(mDataNorm + grids_per_edge * y + x) = normals.getNormal(x, y);
 			}
 		}
-		dirty_patch = TRUE;
 	}
 
-	if (dirty_patch)
+	// Normals worked out on another thread may come in after the geometry
+	// was rebuilt, along with that of the neighbors that share the edges.
+	if (mVObjp)
 	{
-		mSurfacep->dirtySurfacePatch(this);
+		mVObjp->dirtyGeom();
 	}
-
-	for (i = 0; i < 9; i++)
+	if (rect.mLeft == 0 && getNeighborPatch(WEST) && getNeighborPatch(WEST)->mVObjp)
 	{
-		mNormalsInvalid[i] = FALSE;
+		getNeighborPatch(WEST)->mVObjp->dirtyGeom();
+	}
+	if (rect.mBottom == 0 && getNeighborPatch(SOUTH) && getNeighborPatch(SOUTH)->mVObjp)
+	{
+		getNeighborPatch(SOUTH)->mVObjp->dirtyGeom();
 	}
+	mSurfacep->dirtySurfacePatch(this);
 }
 
 void LLSurfacePatch::updateEastEdge()
@@ -735,6 +721,72 @@ BOOL LLSurfacePatch::updateTexture()
 	}
 }
 
+BOOL LLSurfacePatch::prepareTexture(LLTerrainComposer*& composer)
+{
+	composer = NULL;
+	if (mComposing)
+	{
+		// Not until the last one is back, which may be out of date already.
+		return FALSE;
+	}
+	if (!mSTexUpdate)
+	{
+		return TRUE;
+	}
+
+	if ((!getNeighborPatch(EAST) || getNeighborPatch(EAST)->getHasReceivedData())
+		&& (!getNeighborPatch(WEST) || getNeighborPatch(WEST)->getHasReceivedData())
+		&& (!getNeighborPatch(SOUTH) || getNeighborPatch(SOUTH)->getHasReceivedData())
+		&& (!getNeighborPatch(NORTH) || getNeighborPatch(NORTH)->getHasReceivedData()))
+	{
+		LLViewerRegion *regionp = getSurface()->getRegion();
+		LLVector3d origin_region = getOriginGlobal() - getSurface()->getOriginGlobal();
+		LLVLComposition* comp = regionp->getComposition();
+
+		BOOL generate_heights = !mHeightsGenerated;
+		BOOL generate_texture = comp->generateComposition();
+		if (generate_heights || generate_texture)
+		{
+			F32 tex_patch_size = getSurface()->getMetersPerGrid()*(F32)getSurface()->getGridsPerPatchEdge();
+			composer = comp->prepareComposition((F32)origin_region[VX], (F32)origin_region[VY],
+												tex_patch_size, generate_heights, generate_texture, this);
+		}
+		if (composer)
+		{
+			// Dirtying the patch meanwhile clears these again.
+			mComposing = TRUE;
+			mHeightsGenerated = TRUE;
+			if (composer->hasTexture())
+			{
+				mSTexUpdate = FALSE;
+			}
+		}
+	}
+	return FALSE;
+}
+
+void LLSurfacePatch::applyComposition(const LLTerrainComposer& composer)
+{
+	mComposing = FALSE;
+
+	LLVLComposition* comp = getSurface()->getRegion()->getComposition();
+	comp->applyComposition(composer);
+	if (mVObjp)
+	{
+		mVObjp->dirtyGeom();
+	}
+	updateCompositionStats();
+
+	if (composer.hasTexture())
+	{
+		// Also generate the water texture
+		LLVector3d origin_region = getOriginGlobal() - getSurface()->getOriginGlobal();
+		F32 tex_patch_size = getSurface()->getMetersPerGrid()*(F32)getSurface()->getGridsPerPatchEdge();
+		mSurfacep->generateWaterTexture((F32)origin_region.mdV[VX], (F32)origin_region.mdV[VY],
+										tex_patch_size, tex_patch_size);
+	}
+}
+
 
 void LLSurfacePatch::dirtyZ()
 {
@@ -767,6 +819,56 @@ void LLSurfacePatch::dirtyZ()
 }
 
 
+void LLSurfacePatch::dirtyZ(const LLRect& rect)
+{
+	mSTexUpdate = TRUE;
+
+	// Only the normals near the heights that changed, here and across the
+	// edges, need working out again.
+	S32 width = (S32)mSurfacep->getGridsPerPatchEdge();
+	LLRect affected = LLPatchNormals::getAffectedRect(rect, width);
+	addDirtyNormals(affected);
+
+	for (U32 i = 0; i < 8; i++)
+	{
+		LLSurfacePatch *neighborp = getNeighborPatch(i);
+		if (!neighborp)
+		{
+			continue;
+		}
+		affected = LLPatchNormals::getAffectedRect(rect, width, gDirAxes[i][0], gDirAxes[i][1]);
+		if (affected.notNull())
+		{
+			neighborp->addDirtyNormals(affected);
+			neighborp->dirty();
+		}
+	}
+
+	dirty();
+	mLastUpdateTime = gFrameTime;
+}
+
+
+void LLSurfacePatch::addDirtyNormals(const LLRect& rect)
+{
+	// The northeast corner height is filled in from whichever neighbor has it.
+	S32 width = (S32)mSurfacep->getGridsPerPatchEdge();
+	if (rect.mRight > width && rect.mTop > width)
+	{
+		mNormalsInvalid[NORTHEAST] = TRUE;
+	}
+
+	if (mDirtyNormals.isEmpty())
+	{
+		mDirtyNormals = rect;
+	}
+	else if (rect.notNull())
+	{
+		mDirtyNormals.unionWith(rect);
+	}
+}
+
+
 const U64 &LLSurfacePatch::getLastUpdateTime() const
 {
 	return mLastUpdateTime;
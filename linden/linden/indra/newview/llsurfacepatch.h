@@ -36,12 +36,15 @@
 #include "v3math.h"
 #include "v3dmath.h"
 #include "llmemory.h"
+#include "llrect.h"
 
 class LLSurface;
 class LLVOSurfacePatch;
 class LLVector2;
 class LLColor4U;
 class LLAgent;
+class LLPatchNormals;
+class LLTerrainComposer;
 
 // A patch shouldn't know about its visibility since that really depends on the 
 // camera that is looking (or not looking) at it.  So, anything about a patch
@@ -80,10 +83,19 @@ public:
 	void colorPatch(const U8 r, const U8 g, const U8 b);
 
 	BOOL updateTexture();
+	// As updateTexture(), but sets up the composition it would do, to be
+	// composed elsewhere and handed to applyComposition(), in composer.
+	// Returns FALSE until the texture is up to date.
+	BOOL prepareTexture(LLTerrainComposer*& composer);
+	void applyComposition(const LLTerrainComposer& composer);
 
 	void updateVerticalStats();
 	void updateCompositionStats();
 	void updateNormals();
+	// Sets up the normals updateNormals() would work out, to be worked out
+	// elsewhere and handed to applyNormals(). NULL if none need it.
+	LLPatchNormals* prepareNormals();
+	void applyNormals(const LLPatchNormals& normals);
 
 	void updateEastEdge();
 	void updateNorthEdge();
@@ -92,6 +104,7 @@ public:
 	void updateVisibility();
 
 	void dirtyZ(); // Dirty the z values of this patch
+	void dirtyZ(const LLRect& rect); // Dirty the z values in rect, in the grid of this patch
 	void setHasReceivedData();
 	BOOL getHasReceivedData() const;
 
@@ -108,6 +121,9 @@ public:
 	LLVector2 getTexCoords(const U32 x, const U32 y) const;
 
 	void calcNormal(const U32 x, const U32 y, const U32 stride);
+	// The height at x, y in the grid of this patch, which may be past its
+	// edges, from the neighbor there or the nearest point if there is none.
+	F32 resolveZ(S32 x, S32 y) const;
 	const LLVector3 &getNormal(const U32 x, const U32 y) const;
 
 	void eval(const U32 x, const U32 y, const U32 stride,
@@ -143,6 +159,9 @@ public:
 
 	void clearVObj();
 
+protected:
+	void addDirtyNormals(const LLRect& rect);
+
 public:
 	BOOL mHasReceivedData;	// has the patch EVER received height data?
 	BOOL mSTexUpdate;		// Does the surface texture need to be updated?
@@ -150,10 +169,12 @@ public:
 protected:
 	LLSurfacePatch *mNeighborPatches[8]; // Adjacent patches
 	BOOL mNormalsInvalid[9];  // Which normals are invalid
+	LLRect mDirtyNormals;	  // and any others the heights changed under
 
 	BOOL mDirty;
 	BOOL mDirtyZStats;
 	BOOL mHeightsGenerated;
+	BOOL mComposing;		// Is a composition on its way to applyComposition()?
 
 	U32 mDataOffset;
 	F32 *mDataZ;
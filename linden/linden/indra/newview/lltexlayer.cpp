@@ -45,6 +45,7 @@
 #include "lltexlayer.h"
 #include "llui.h"
 #include "llvfile.h"
+#include "llviewercontrol.h"
 #include "llviewerimagelist.h"
 #include "llviewerimagelist.h"
 #include "llviewerregion.h"
@@ -65,6 +66,10 @@ const S32 MAX_BAKE_UPLOAD_ATTEMPTS = 4;
 
 // static
 S32 LLTexLayerSetBuffer::sGLByteCount = 0;
+BOOL LLTexLayerSetBuffer::sCompositeOnCPU = FALSE;
+LLTexLayerSetBuffer::composite_thread_list_t LLTexLayerSetBuffer::sCompositeThreads;
+S32 LLTexLayerSetBuffer::sNextCompositeThread = 0;
+LLTexLayerSetBuffer::buffer_set_t LLTexLayerSetBuffer::sCompositing;
 
 //-----------------------------------------------------------------------------
 // LLBakedUploadData()
@@ -102,13 +107,17 @@ LLTexLayerSetBuffer::LLTexLayerSetBuffer(LLTexLayerSet* owner, S32 width, S32 he
 	mUploadPending( FALSE ), // Not used for any logic here, just to sync sending of updates
 	mUploadFailCount( 0 ),
 	mUploadAfter( 0 ),
-	mTexLayerSet( owner )	
+	mTexLayerSet( owner ),
+	mCompositeThread( NULL ),
+	mCompositeHandle( LLQueuedThread::nullHandle() ),
+	mCompositeForUpload( FALSE )
 {
 	LLTexLayerSetBuffer::sGLByteCount += getSize();
 }
 
 LLTexLayerSetBuffer::~LLTexLayerSetBuffer()
 {
+	cancelComposite();
 	LLTexLayerSetBuffer::sGLByteCount -= getSize();
 	destroyGLTexture();
 	for (S32 order = 0; order < ORDER_COUNT; order++)
@@ -210,6 +219,12 @@ void LLTexLayerSetBuffer::popProjection()
 
 BOOL LLTexLayerSetBuffer::needsRender()
 {
+	if (mCompositeThread)
+	{
+		finishComposite();
+		return FALSE;
+	}
+
 	LLVOAvatar* avatar = mTexLayerSet->getAvatar();
 	BOOL upload_now = needsUploadNow();
 	BOOL needs_update = (mNeedsUpdate || upload_now) && !avatar->mAppearanceAnimating;
@@ -230,6 +245,10 @@ BOOL LLTexLayerSetBuffer::needsRender()
 			needs_update &= mTexLayerSet->isLocalTextureDataAvailable();
 		}
 	}
+	if (needs_update && sCompositeOnCPU && startComposite())
+	{
+		return FALSE;
+	}
 	return needs_update;
 }
 
@@ -347,7 +366,13 @@ void LLTexLayerSetBuffer::readBackAndUpload()
 	mTexLayerSet->gatherAlphaMasks(baked_mask_data, mWidth, mHeight);
 //	imdebug("lum b=8 w=%d h=%d %p", mWidth, mHeight, baked_mask_data);
 
+	uploadBakedImage(baked_color_data, baked_mask_data);
 
+	delete [] baked_color_data;
+}
+
+void LLTexLayerSetBuffer::uploadBakedImage(const U8* baked_color_data, const U8* baked_mask_data)
+{
 	// writes into baked_color_data
 	const char* comment_text = NULL;
 
@@ -446,8 +471,136 @@ void LLTexLayerSetBuffer::readBackAndUpload()
 		mUploadPending = FALSE;
 		llinfos << "unable to create baked upload file" << llendl;
 	}
+}
 
-	delete [] baked_color_data;
+BOOL LLTexLayerSetBuffer::startComposite()
+{
+	if (sCompositeThreads.empty())
+	{
+		return FALSE;
+	}
+
+	BOOL for_upload = needsUploadNow();
+	LLImageCompositor* compositor = new LLImageCompositor(mWidth, mHeight);
+	if (!mTexLayerSet->composite(*compositor, for_upload))
+	{
+		// render() it is, which also reports layers that fail.
+		delete compositor;
+		return FALSE;
+	}
+
+	mCompositeThread = sCompositeThreads[sNextCompositeThread];
+	sNextCompositeThread = (sNextCompositeThread + 1) % (S32)sCompositeThreads.size();
+	mCompositeHandle = mCompositeThread->composite(compositor);
+	mCompositeThread->update(0); // unpauses the thread
+	mCompositeForUpload = for_upload;
+	sCompositing.insert(this);
+
+	// Changes from here on need another composite.
+	mNeedsUpdate = FALSE;
+	return TRUE;
+}
+
+void LLTexLayerSetBuffer::finishComposite()
+{
+	LLImageCompositor* compositor = NULL;
+	if (!mCompositeThread->getResult(mCompositeHandle, compositor))
+	{
+		return;
+	}
+	mCompositeThread = NULL;
+	mCompositeHandle = LLQueuedThread::nullHandle();
+	sCompositing.erase(this);
+	if (!compositor || mTexture.isNull() || !mTexture->getHasGLTexture())
+	{
+		mNeedsUpdate = TRUE;
+		delete compositor;
+		return;
+	}
+
+	LLImageRaw* canvas = compositor->getCanvas();
+	mTexture->setSubImage(canvas->getData(), mWidth, mHeight, 0, 0, mWidth, mHeight);
+	// we have valid texture data now
+	mTexture->setGLTextureCreated(true);
+
+	// As render() does it, though with the alpha masks composited along
+	// with the rest.
+	if (mCompositeForUpload && needsUploadNow())
+	{
+		llinfos << "Baked " << mTexLayerSet->getBodyRegion() << llendl;
+		LLViewerStats::getInstance()->incStat(LLViewerStats::ST_TEX_BAKES);
+
+		llassert( gAgent.getAvatarObject() == mTexLayerSet->getAvatar() );
+
+		if (!mTexLayerSet->isVisible())
+		{
+			LLVOAvatar*	avatar = mTexLayerSet->getAvatar();
+			if (avatar)
+			{
+				avatar->setNewBakedTexture(avatar->getBakedTE(mTexLayerSet), IMG_INVISIBLE);
+				llinfos << "Invisible baked texture set for " << mTexLayerSet->getBodyRegion() << llendl;
+			}
+		}
+
+		LLPointer<LLImageRaw> baked_mask_image = new LLImageRaw(mWidth, mHeight, 1);
+		mTexLayerSet->gatherAlphaMasks(*compositor, baked_mask_image->getData());
+		mTexLayerSet->deleteCaches();
+
+		uploadBakedImage(canvas->getData(), baked_mask_image->getData());
+	}
+
+	mTexLayerSet->finishComposite(*compositor);
+	delete compositor;
+}
+
+void LLTexLayerSetBuffer::cancelComposite()
+{
+	if (!mCompositeThread)
+	{
+		return;
+	}
+	mCompositeThread->abortRequest(mCompositeHandle, false);
+	LLImageCompositor* compositor = NULL;
+	while (!mCompositeThread->getResult(mCompositeHandle, compositor))
+	{
+		// A bake takes milliseconds at most.
+		mCompositeThread->update(0);
+		ms_sleep(1);
+	}
+	delete compositor;
+	mCompositeThread = NULL;
+	mCompositeHandle = LLQueuedThread::nullHandle();
+	sCompositing.erase(this);
+	mNeedsUpdate = TRUE;
+}
+
+// static
+void LLTexLayerSetBuffer::updateCompositing()
+{
+	cleanupClass();
+	sCompositeOnCPU = gSavedSettings.getBOOL("AvatarCompositeOnCPU");
+	if (sCompositeOnCPU)
+	{
+		S32 num_threads = llmax(gSavedSettings.getS32("AvatarCompositeThreads"), 1);
+		for (S32 i = 0; i < num_threads; i++)
+		{
+			sCompositeThreads.push_back(new LLImageCompositorThread());
+		}
+	}
+}
+
+// static
+void LLTexLayerSetBuffer::cleanupClass()
+{
+	// The composites in progress go with their threads, and get redone.
+	while (!sCompositing.empty())
+	{
+		(*sCompositing.begin())->cancelComposite();
+	}
+	std::for_each(sCompositeThreads.begin(), sCompositeThreads.end(), DeletePointer());
+	sCompositeThreads.clear();
+	sNextCompositeThread = 0;
+	sCompositeOnCPU = FALSE;
 }
 
 
@@ -689,6 +842,7 @@ BOOL LLTexLayerSet::parseData(LLXmlTreeNode* node)
 
 void LLTexLayerSet::deleteCaches()
 {
+	mLocalTextureRaws.clear();
 	for( layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++ )
 	{
 		LLTexLayer* layer = *iter;
@@ -843,6 +997,167 @@ BOOL LLTexLayerSet::render( S32 x, S32 y, S32 width, S32 height )
 	return success;
 }
 
+BOOL LLTexLayerSet::compositeAlphaMaskTextures(LLImageCompositor& compositor, BOOL force_clear)
+{
+	BOOL success = TRUE;
+	const LLTexLayerSetInfo *info = getInfo();
+
+	compositor.setColorMask(FALSE, TRUE);
+	compositor.setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ZERO);
+
+	// (Optionally) replace alpha with a single component image from a tga file.
+	if (!info->mStaticAlphaFileName.empty())
+	{
+		LLImageRaw* image_raw = gTexStaticImageList.getImageRaw(info->mStaticAlphaFileName);
+		if (image_raw)
+		{
+			compositor.setTextureBlendType(LLImageCompositor::TB_REPLACE);
+			compositor.drawImage(image_raw, TRUE, FALSE);
+		}
+	}
+	else if (force_clear || info->mClearAlpha || (mMaskLayerList.size() > 0))
+	{
+		// Set the alpha channel to one (clean up after previous blending)
+		compositor.setAlphaTest(FALSE);
+		compositor.setColor(LLColor4(0.f, 0.f, 0.f, 1.f));
+		compositor.drawRect();
+		compositor.setAlphaTest(TRUE);
+	}
+
+	// (Optional) Mask out part of the baked texture with alpha masks
+	if (mMaskLayerList.size() > 0)
+	{
+		compositor.setBlendFunc(LLImageCompositor::BF_DEST_ALPHA, LLImageCompositor::BF_ZERO);
+		compositor.setTextureBlendType(LLImageCompositor::TB_REPLACE);
+		for (layer_list_t::iterator iter = mMaskLayerList.begin(); iter != mMaskLayerList.end(); iter++)
+		{
+			LLTexLayer* layer = *iter;
+			success &= layer->compositeAlphaTexture(compositor);
+		}
+	}
+
+	compositor.setTextureBlendType(LLImageCompositor::TB_MULT);
+	compositor.setColorMask(TRUE, TRUE);
+	compositor.setBlendFunc(LLImageCompositor::BF_SOURCE_ALPHA, LLImageCompositor::BF_ONE_MINUS_SOURCE_ALPHA);
+	return success;
+}
+
+BOOL LLTexLayerSet::composite(LLImageCompositor& compositor, BOOL for_upload)
+{
+	mIsVisible = TRUE;
+	for (layer_list_t::iterator iter = mMaskLayerList.begin(); iter != mMaskLayerList.end(); iter++)
+	{
+		LLTexLayer* layer = *iter;
+		if (layer->isInvisibleAlphaMask())
+		{
+			mIsVisible = FALSE;
+		}
+	}
+	for (layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+	{
+		(*iter)->clearCompositeAlpha();
+	}
+
+	// clear buffer area to ensure we don't pick up UI elements
+	compositor.setAlphaTest(FALSE);
+	compositor.setColor(LLColor4(0.f, 0.f, 0.f, 1.f));
+	compositor.drawRect();
+	compositor.setAlphaTest(TRUE);
+
+	if (mIsVisible)
+	{
+		// composite color layers
+		for (layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+		{
+			LLTexLayer* layer = *iter;
+			if (layer->getRenderPass() == RP_COLOR || layer->getRenderPass() == RP_BUMP)
+			{
+				if (!layer->composite(compositor))
+				{
+					return FALSE;
+				}
+			}
+		}
+
+		if (!compositeAlphaMaskTextures(compositor))
+		{
+			return FALSE;
+		}
+	}
+	else
+	{
+		compositor.setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ZERO);
+		compositor.setAlphaTest(FALSE);
+		compositor.setColor(LLColor4(0.f, 0.f, 0.f, 0.f));
+		compositor.drawRect();
+		compositor.setBlendFunc(LLImageCompositor::BF_SOURCE_ALPHA, LLImageCompositor::BF_ONE_MINUS_SOURCE_ALPHA);
+		compositor.setAlphaTest(TRUE);
+	}
+
+	if (for_upload)
+	{
+		// The alpha masks the layers above didn't composite, as
+		// gatherAlphaMasks() renders them after the color is read back.
+		for (layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+		{
+			LLTexLayer* layer = *iter;
+			if (layer->getCompositeAlpha() < 0 && layer->hasAlphaParams())
+			{
+				LLColor4 net_color;
+				layer->findNetColor(&net_color);
+				layer->invalidateMorphMasks();
+				if (!layer->compositeAlphaMasks(compositor, &net_color))
+				{
+					return FALSE;
+				}
+			}
+		}
+
+		// Set alpha back to that of our alpha masks.
+		if (!compositeAlphaMaskTextures(compositor, TRUE))
+		{
+			return FALSE;
+		}
+	}
+
+	// Don't keep the read back local textures of other people's avatars.
+	if (!mAvatar->isSelf())
+	{
+		mLocalTextureRaws.clear();
+	}
+	return TRUE;
+}
+
+void LLTexLayerSet::finishComposite(const LLImageCompositor& compositor)
+{
+	for (layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+	{
+		LLTexLayer* layer = *iter;
+		layer->finishComposite(compositor);
+	}
+}
+
+LLImageRaw* LLTexLayerSet::getLocalTextureRaw(ETextureIndex te, LLImageGL* image_gl)
+{
+	const LLUUID& id = mAvatar->getLocalTextureID(te);
+	S32 discard_level = image_gl->getDiscardLevel();
+	LocalTextureRaw& local_raw = mLocalTextureRaws[te];
+	if (local_raw.mImageRaw.isNull() || local_raw.mID != id || local_raw.mDiscardLevel != discard_level)
+	{
+		local_raw.mID = id;
+		local_raw.mDiscardLevel = discard_level;
+		local_raw.mImageRaw = new LLImageRaw;
+		if (!image_gl->readBackRaw(-1, local_raw.mImageRaw, false))
+		{
+			mLocalTextureRaws.erase(te);
+			return NULL;
+		}
+		// We now have something in one of our caches
+		sHasCaches = TRUE;
+	}
+	return local_raw.mImageRaw;
+}
+
 void LLTexLayerSet::requestUpdate()
 {
 	if( mUpdatesEnabled )
@@ -909,6 +1224,19 @@ LLTexLayerSetBuffer* LLTexLayerSet::getComposite()
 	return mComposite;
 }
 
+// data *= alpha_data, with the rounding the bakes have always had.
+static void multiply_alpha_mask(U8* data, const U8* alpha_data, S32 size)
+{
+	for( S32 i = 0; i < size; i++ )
+	{
+		U8 curAlpha = data[i];
+		U16 resultAlpha = curAlpha;
+		resultAlpha *= (alpha_data[i] + 1);
+		resultAlpha = resultAlpha >> 8;
+		data[i] = (U8)resultAlpha;
+	}
+}
+
 void LLTexLayerSet::gatherAlphaMasks(U8 *data, S32 width, S32 height)
 {
 	S32 size = width * height;
@@ -929,14 +1257,7 @@ void LLTexLayerSet::gatherAlphaMasks(U8 *data, S32 width, S32 height)
 		}
 		if (alphaData)
 		{
-			for( S32 i = 0; i < size; i++ )
-			{
-				U8 curAlpha = data[i];
-				U16 resultAlpha = curAlpha;
-				resultAlpha *= (alphaData[i] + 1);
-				resultAlpha = resultAlpha >> 8;
-				data[i] = (U8)resultAlpha;
-			}
+			multiply_alpha_mask(data, alphaData, size);
 		}
 	}
 	
@@ -944,6 +1265,22 @@ void LLTexLayerSet::gatherAlphaMasks(U8 *data, S32 width, S32 height)
 	renderAlphaMaskTextures(mComposite->getOriginX(), mComposite->getOriginY(), width, height, true);
 }
 
+void LLTexLayerSet::gatherAlphaMasks(const LLImageCompositor& compositor, U8* data)
+{
+	S32 size = compositor.getWidth() * compositor.getHeight();
+
+	memset(data, 255, size);
+
+	for (layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++)
+	{
+		LLTexLayer* layer = *iter;
+		if (layer->getCompositeAlpha() >= 0)
+		{
+			multiply_alpha_mask(data, compositor.getAlpha(layer->getCompositeAlpha())->getData(), size);
+		}
+	}
+}
+
 void LLTexLayerSet::applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components)
 {
 	for( layer_list_t::iterator iter = mLayerList.begin(); iter != mLayerList.end(); iter++ )
@@ -951,6 +1288,7 @@ void LLTexLayerSet::applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_
 		LLTexLayer* layer = *iter;
 		layer->applyMorphMask(tex_data, width, height, num_components);
 	}
+	getAvatar()->dirtyMesh();
 }
 
 //-----------------------------------------------------------------------------
@@ -1207,6 +1545,8 @@ LLTexLayer::LLTexLayer( LLTexLayerSet* layer_set )
 	mTexLayerSet( layer_set ),
 	mMorphMasksValid( FALSE ),
 	mStaticImageInvalid( FALSE ),
+	mCompositeAlpha( -1 ),
+	mCompositeAlphaCacheIndex( 0 ),
 	mInfo( NULL )
 {
 }
@@ -1332,13 +1672,7 @@ BOOL LLTexLayer::render( S32 x, S32 y, S32 width, S32 height )
 	gPipeline.disableLights();
 
 	LLColor4 net_color;
-	BOOL color_specified = findNetColor(&net_color);
-
-	if (mTexLayerSet->getAvatar()->mIsDummy)
-	{
-		color_specified = true;
-		net_color = LLVOAvatar::getDummyColor();
-	}
+	BOOL color_specified = findRenderColor(&net_color);
 
 	BOOL success = TRUE;
 	
@@ -1473,6 +1807,100 @@ BOOL LLTexLayer::render( S32 x, S32 y, S32 width, S32 height )
 	return success;
 }
 
+BOOL LLTexLayer::composite(LLImageCompositor& compositor)
+{
+	LLColor4 net_color;
+	BOOL color_specified = findRenderColor(&net_color);
+
+	// If you can't see the layer, don't render it.
+	if( is_approx_zero( net_color.mV[VW] ) )
+	{
+		return TRUE;
+	}
+
+	BOOL alpha_mask_specified = FALSE;
+	if( !mParamAlphaList.empty() )
+	{
+		if (!compositeAlphaMasks(compositor, &net_color))
+		{
+			return FALSE;
+		}
+		alpha_mask_specified = TRUE;
+		compositor.setBlendFunc(LLImageCompositor::BF_DEST_ALPHA, LLImageCompositor::BF_ONE_MINUS_DEST_ALPHA);
+	}
+
+	compositor.setColor(net_color);
+
+	if( getInfo()->mWriteAllChannels )
+	{
+		compositor.setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ZERO);
+	}
+	else if (getInfo()->mUseLocalTextureAlphaOnly)
+	{
+		// Use the alpha channel only
+		compositor.setColorMask(FALSE, TRUE);
+	}
+
+	if( (getInfo()->mLocalTexture != -1) && !getInfo()->mUseLocalTextureAlphaOnly )
+	{
+		ETextureIndex te = (ETextureIndex)getInfo()->mLocalTexture;
+		LLImageGL* image_gl = NULL;
+		if( mTexLayerSet->getAvatar()->getLocalTextureGL(te, &image_gl ) )
+		{
+			if (mTexLayerSet->getAvatar()->getLocalTextureID(te) == IMG_DEFAULT_AVATAR)
+			{
+				image_gl = NULL;
+			}
+			if( image_gl )
+			{
+				LLImageRaw* image_raw = mTexLayerSet->getLocalTextureRaw(te, image_gl);
+				if (!image_raw)
+				{
+					return FALSE;
+				}
+				compositor.setAlphaTest(!getInfo()->mWriteAllChannels);
+				compositor.drawImage(image_raw, FALSE, image_gl->getUseMipMaps());
+				compositor.setAlphaTest(TRUE);
+			}
+		}
+	}
+
+	if( !getInfo()->mStaticImageFileName.empty() )
+	{
+		LLImageRaw* image_raw = gTexStaticImageList.getImageRaw( getInfo()->mStaticImageFileName );
+		if (!image_raw)
+		{
+			return FALSE;
+		}
+		compositor.drawImage(image_raw, getInfo()->mStaticImageIsMask, FALSE);
+	}
+
+	if( ((-1 == getInfo()->mLocalTexture) ||
+		 getInfo()->mUseLocalTextureAlphaOnly) &&
+		getInfo()->mStaticImageFileName.empty() &&
+		color_specified )
+	{
+		compositor.setAlphaTest(FALSE);
+		compositor.setColor(net_color);
+		compositor.drawRect();
+		compositor.setAlphaTest(TRUE);
+	}
+
+	if( alpha_mask_specified || getInfo()->mWriteAllChannels )
+	{
+		// Restore standard blend func value
+		compositor.setBlendFunc(LLImageCompositor::BF_SOURCE_ALPHA, LLImageCompositor::BF_ONE_MINUS_SOURCE_ALPHA);
+	}
+
+	if (getInfo()->mUseLocalTextureAlphaOnly)
+	{
+		// Restore color + alpha mode.
+		compositor.setColorMask(TRUE, TRUE);
+	}
+
+	return TRUE;
+}
+
 BOOL LLTexLayer::blendAlphaTexture(S32 x, S32 y, S32 width, S32 height)
 {
 	BOOL success = TRUE;
@@ -1516,7 +1944,39 @@ BOOL LLTexLayer::blendAlphaTexture(S32 x, S32 y, S32 width, S32 height)
 	return success;
 }
 
-U8*	LLTexLayer::getAlphaData()
+BOOL LLTexLayer::compositeAlphaTexture(LLImageCompositor& compositor)
+{
+	if (!getInfo()->mStaticImageFileName.empty())
+	{
+		LLImageRaw* image_raw = gTexStaticImageList.getImageRaw(getInfo()->mStaticImageFileName);
+		if (!image_raw)
+		{
+			return FALSE;
+		}
+		compositor.setAlphaTest(FALSE);
+		compositor.drawImage(image_raw, getInfo()->mStaticImageIsMask, FALSE);
+		compositor.setAlphaTest(TRUE);
+	}
+	else if (getInfo()->mLocalTexture >=0 && getInfo()->mLocalTexture < TEX_NUM_INDICES)
+	{
+		ETextureIndex te = (ETextureIndex)getInfo()->mLocalTexture;
+		LLImageGL* image_gl = NULL;
+		if (mTexLayerSet->getAvatar()->getLocalTextureGL(te, &image_gl) && image_gl)
+		{
+			LLImageRaw* image_raw = mTexLayerSet->getLocalTextureRaw(te, image_gl);
+			if (!image_raw)
+			{
+				return FALSE;
+			}
+			compositor.setAlphaTest(FALSE);
+			compositor.drawImage(image_raw, FALSE, image_gl->getUseMipMaps());
+			compositor.setAlphaTest(TRUE);
+		}
+	}
+	return TRUE;
+}
+
+U32 LLTexLayer::getAlphaCacheIndex()
 {
 	LLCRC alpha_mask_crc;
 	const LLUUID& uuid = mTexLayerSet->getAvatar()->getLocalTextureID((ETextureIndex)getInfo()->mLocalTexture);
@@ -1529,10 +1989,54 @@ U8*	LLTexLayer::getAlphaData()
 		alpha_mask_crc.update((U8*)&param_weight, sizeof(F32));
 	}
 
-	U32 cache_index = alpha_mask_crc.getCRC();
+	return alpha_mask_crc.getCRC();
+}
+
+U8*	LLTexLayer::getAlphaData()
+{
+	alpha_cache_t::iterator iter = mAlphaCache.find(getAlphaCacheIndex());
+	return (iter == mAlphaCache.end()) ? 0 : iter->second;
+}
+
+U8* LLTexLayer::addAlphaData(U32 cache_index, S32 size)
+{
+	// clear out a slot if we have filled our cache
+	S32 max_cache_entries = getTexLayerSet()->getAvatar()->isSelf() ? 4 : 1;
+	while ((S32)mAlphaCache.size() >= max_cache_entries)
+	{
+		alpha_cache_t::iterator iter = mAlphaCache.begin(); // arbitrarily grab the first entry
+		delete [] iter->second;
+		mAlphaCache.erase(iter);
+	}
+	U8* alpha_data = new U8[size];
+	mAlphaCache[cache_index] = alpha_data;
+	return alpha_data;
+}
 
-	alpha_cache_t::iterator iter2 = mAlphaCache.find(cache_index);
-	return (iter2 == mAlphaCache.end()) ? 0 : iter2->second;
+void LLTexLayer::applyAlphaData(U8* alpha_data, S32 width, S32 height)
+{
+	getTexLayerSet()->getAvatar()->dirtyMesh();
+
+	mMorphMasksValid = TRUE;
+
+	for( morph_list_t::iterator iter = mMaskedMorphs.begin();
+		 iter != mMaskedMorphs.end(); iter++ )
+	{
+		LLMaskedMorph* maskedMorph = &(*iter);
+		maskedMorph->mMorphTarget->applyMask(alpha_data, width, height, 1, maskedMorph->mInvert);
+	}
+}
+
+BOOL LLTexLayer::findRenderColor( LLColor4* net_color )
+{
+	BOOL color_specified = findNetColor(net_color);
+
+	if (mTexLayerSet->getAvatar()->mIsDummy)
+	{
+		color_specified = TRUE;
+		*net_color = LLVOAvatar::getDummyColor();
+	}
+	return color_specified;
 }
 
 BOOL LLTexLayer::findNetColor( LLColor4* net_color )
@@ -1703,19 +2207,7 @@ BOOL LLTexLayer::renderAlphaMasks( S32 x, S32 y, S32 width, S32 height, LLColor4
 	
 	if (success && !mMorphMasksValid && !mMaskedMorphs.empty())
 	{
-		LLCRC alpha_mask_crc;
-		const LLUUID& uuid = mTexLayerSet->getAvatar()->getLocalTextureID((ETextureIndex)getInfo()->mLocalTexture);
-		alpha_mask_crc.update((U8*)(&uuid.mData), UUID_BYTES);
-		
-		for( alpha_list_t::iterator iter = mParamAlphaList.begin(); iter != mParamAlphaList.end(); iter++ )
-		{
-			LLTexLayerParamAlpha* param = *iter;
-			F32 param_weight = param->getWeight();
-			alpha_mask_crc.update((U8*)&param_weight, sizeof(F32));
-		}
-
-		U32 cache_index = alpha_mask_crc.getCRC();
-
+		U32 cache_index = getAlphaCacheIndex();
 		alpha_cache_t::iterator iter2 = mAlphaCache.find(cache_index);
 		U8* alpha_data;
 		if (iter2 != mAlphaCache.end())
@@ -1724,35 +2216,131 @@ BOOL LLTexLayer::renderAlphaMasks( S32 x, S32 y, S32 width, S32 height, LLColor4
 		}
 		else
 		{
-			// clear out a slot if we have filled our cache
-			S32 max_cache_entries = getTexLayerSet()->getAvatar()->isSelf() ? 4 : 1;
-			while ((S32)mAlphaCache.size() >= max_cache_entries)
-			{
-				iter2 = mAlphaCache.begin(); // arbitrarily grab the first entry
-				alpha_data = iter2->second;
-				delete [] alpha_data;
-				mAlphaCache.erase(iter2);
-			}
-			alpha_data = new U8[width * height];
-			mAlphaCache[cache_index] = alpha_data;
+			alpha_data = addAlphaData(cache_index, width * height);
 			glReadPixels(x, y, width, height, GL_ALPHA, GL_UNSIGNED_BYTE, alpha_data);
 		}
 		
-		getTexLayerSet()->getAvatar()->dirtyMesh();
+		applyAlphaData(alpha_data, width, height);
+	}
 
-		mMorphMasksValid = TRUE;
+	return success;
+}
+
+BOOL LLTexLayer::compositeAlphaMasks(LLImageCompositor& compositor, LLColor4* colorp)
+{
+	BOOL success = TRUE;
 
-		for( morph_list_t::iterator iter3 = mMaskedMorphs.begin();
-			 iter3 != mMaskedMorphs.end(); iter3++ )
+	llassert( !mParamAlphaList.empty() );
+
+	compositor.setColorMask(FALSE, TRUE);
+	compositor.setAlphaTest(FALSE);
+
+	alpha_list_t::iterator iter = mParamAlphaList.begin();
+	LLTexLayerParamAlpha* first_param = *iter;
+
+	// Note: if the first param is a mulitply, multiply against the current buffer's alpha
+	if( !first_param || !first_param->getMultiplyBlend() )
+	{
+		// Clear the alpha
+		compositor.setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ZERO);
+		compositor.setColor(LLColor4(0.f, 0.f, 0.f, 0.f));
+		compositor.drawRect();
+	}
+
+	// Accumulate alphas
+	compositor.setColor(LLColor4(1.f, 1.f, 1.f, 1.f));
+
+	for( iter = mParamAlphaList.begin(); iter != mParamAlphaList.end(); iter++ )
+	{
+		LLTexLayerParamAlpha* param = *iter;
+		success &= param->composite(compositor);
+	}
+
+	// Approximates a min() function
+	compositor.setBlendFunc(LLImageCompositor::BF_DEST_ALPHA, LLImageCompositor::BF_ZERO);
+
+	// Accumulate the alpha component of the texture
+	if( getInfo()->mLocalTexture != -1 )
+	{
+		ETextureIndex te = (ETextureIndex)getInfo()->mLocalTexture;
+		LLImageGL* image_gl = NULL;
+		if( mTexLayerSet->getAvatar()->getLocalTextureGL(te, &image_gl ) )
 		{
-			LLMaskedMorph* maskedMorph = &(*iter3);
-			maskedMorph->mMorphTarget->applyMask(alpha_data, width, height, 1, maskedMorph->mInvert);
+			if( image_gl && (image_gl->getComponents() == 4) )
+			{
+				LLImageRaw* image_raw = mTexLayerSet->getLocalTextureRaw(te, image_gl);
+				if (!image_raw)
+				{
+					return FALSE;
+				}
+				compositor.drawImage(image_raw, FALSE, image_gl->getUseMipMaps());
+			}
 		}
 	}
 
+	if( !getInfo()->mStaticImageFileName.empty() )
+	{
+		LLImageRaw* image_raw = gTexStaticImageList.getImageRaw( getInfo()->mStaticImageFileName );
+		if( image_raw )
+		{
+			if(	(image_raw->getComponents() == 4) ||
+				( (image_raw->getComponents() == 1) && getInfo()->mStaticImageIsMask ) )
+			{
+				compositor.drawImage(image_raw, getInfo()->mStaticImageIsMask, FALSE);
+			}
+		}
+	}
+
+	// Draw a rectangle with the layer color to multiply the alpha by that color's alpha.
+	if( colorp->mV[VW] != 1.f )
+	{
+		compositor.setColor(*colorp);
+		compositor.drawRect();
+	}
+
+	compositor.setAlphaTest(TRUE);
+	compositor.setColorMask(TRUE, TRUE);
+
+	// Only layers that mask morphs keep their alpha, see finishComposite().
+	if (success && !mMaskedMorphs.empty())
+	{
+		mCompositeAlpha = compositor.readAlpha();
+		mCompositeAlphaCacheIndex = getAlphaCacheIndex();
+	}
+
 	return success;
 }
 
+void LLTexLayer::finishComposite(const LLImageCompositor& compositor)
+{
+	if (mCompositeAlpha < 0)
+	{
+		return;
+	}
+
+	// Unless the alpha masks changed since
+	if (!mMorphMasksValid && !mMaskedMorphs.empty() && mCompositeAlphaCacheIndex == getAlphaCacheIndex())
+	{
+		LLImageRaw* alpha = compositor.getAlpha(mCompositeAlpha);
+		S32 width = alpha->getWidth();
+		S32 height = alpha->getHeight();
+		alpha_cache_t::iterator iter = mAlphaCache.find(mCompositeAlphaCacheIndex);
+		U8* alpha_data;
+		if (iter != mAlphaCache.end())
+		{
+			alpha_data = iter->second;
+		}
+		else
+		{
+			alpha_data = addAlphaData(mCompositeAlphaCacheIndex, width * height);
+			memcpy(alpha_data, alpha->getData(), width * height);
+		}
+
+		applyAlphaData(alpha_data, width, height);
+	}
+	mCompositeAlpha = -1;
+}
+
 void LLTexLayer::applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components)
 {
 	for( morph_list_t::iterator iter = mMaskedMorphs.begin();
@@ -2171,6 +2759,67 @@ BOOL LLTexLayerParamAlpha::render( S32 x, S32 y, S32 width, S32 height )
 	return success;
 }
 
+BOOL LLTexLayerParamAlpha::composite(LLImageCompositor& compositor)
+{
+	F32 effective_weight = ( mTexLayer->getTexLayerSet()->getAvatar()->getSex() & getSex() ) ? mCurWeight : getDefaultWeight();
+	BOOL weight_changed = effective_weight != mCachedEffectiveWeight;
+	if( getSkip() )
+	{
+		return TRUE;
+	}
+
+	if( getInfo()->mMultiplyBlend )
+	{
+		compositor.setBlendFunc(LLImageCompositor::BF_DEST_ALPHA, LLImageCompositor::BF_ZERO); // Multiplication: approximates a min() function
+	}
+	else
+	{
+		compositor.setBlendFunc(LLImageCompositor::BF_ONE, LLImageCompositor::BF_ONE);  // Addition: approximates a max() function
+	}
+
+	if( !getInfo()->mStaticImageFileName.empty() && !mStaticImageInvalid)
+	{
+		if( mStaticImageTGA.isNull() )
+		{
+			// Don't load the image file until we actually need it the first time.  Like now.
+			mStaticImageTGA = gTexStaticImageList.getImageTGA( getInfo()->mStaticImageFileName );  
+			// We now have something in one of our caches
+			LLTexLayerSet::sHasCaches |= mStaticImageTGA.notNull() ? TRUE : FALSE;
+
+			if( mStaticImageTGA.isNull() )
+			{
+				llwarns << "Unable to load static file: " << getInfo()->mStaticImageFileName << llendl;
+				mStaticImageInvalid = TRUE; // don't try again.
+				return FALSE;
+			}
+		}
+
+		if( mStaticImageRaw.isNull() || weight_changed )
+		{
+			mCachedEffectiveWeight = effective_weight;
+
+			// A new image rather than decoding into the old one, which earlier
+			// composites may still be reading.
+			mStaticImageRaw = new LLImageRaw;
+			mStaticImageTGA->decodeAndProcess( mStaticImageRaw, getInfo()->mDomain, effective_weight );
+			mNeedsCreateTexture = TRUE;
+		}
+
+		compositor.setAlphaTest(FALSE);
+		compositor.drawImage(mStaticImageRaw, TRUE, FALSE);
+		compositor.setAlphaTest(TRUE);
+	}
+	else
+	{
+		compositor.setAlphaTest(FALSE);
+		compositor.setColor(LLColor4(0.f, 0.f, 0.f, effective_weight));
+		compositor.drawRect();
+		compositor.setAlphaTest(TRUE);
+	}
+
+	return TRUE;
+}
+
 //-----------------------------------------------------------------------------
 // LLTexGlobalColorInfo
 //-----------------------------------------------------------------------------
@@ -2503,7 +3152,8 @@ LLStringTable LLTexStaticImageList::sImageNames(16384);
 LLTexStaticImageList::LLTexStaticImageList()
 	:
 	mGLBytes( 0 ),
-	mTGABytes( 0 )
+	mTGABytes( 0 ),
+	mRawBytes( 0 )
 {}
 
 LLTexStaticImageList::~LLTexStaticImageList()
@@ -2515,24 +3165,28 @@ void LLTexStaticImageList::dumpByteCount()
 {
 	llinfos << "Avatar Static Textures " <<
 		"KB GL:" << (mGLBytes / 1024) <<
-		"KB TGA:" << (mTGABytes / 1024) << "KB" << llendl;
+		"KB TGA:" << (mTGABytes / 1024) <<
+		"KB Raw:" << (mRawBytes / 1024) << "KB" << llendl;
 }
 
 void LLTexStaticImageList::deleteCachedImages()
 {
-	if( mGLBytes || mTGABytes )
+	if( mGLBytes || mTGABytes || mRawBytes )
 	{
 		llinfos << "Clearing Static Textures " <<
 			"KB GL:" << (mGLBytes / 1024) <<
-			"KB TGA:" << (mTGABytes / 1024) << "KB" << llendl;
+			"KB TGA:" << (mTGABytes / 1024) <<
+			"KB Raw:" << (mRawBytes / 1024) << "KB" << llendl;
 
 		//mStaticImageLists uses LLPointers, clear() will cause deletion
 		
 		mStaticImageListTGA.clear();
 		mStaticImageListGL.clear();
+		mStaticImageListRaw.clear();
 		
 		mGLBytes = 0;
 		mTGABytes = 0;
+		mRawBytes = 0;
 	}
 }
 
@@ -2612,6 +3266,28 @@ LLImageGL* LLTexStaticImageList::getImageGL(const std::string& file_name, BOOL i
 	return image_gl;
 }
 
+// Returns the decoded data from a tga file named file_name, for
+// LLImageCompositor to draw the way getImageGL()'s texture would be.
+// Caches the result to speed identical subsequent requests.
+LLImageRaw* LLTexStaticImageList::getImageRaw(const std::string& file_name)
+{
+	const char *namekey = sImageNames.addString(file_name);
+	image_raw_map_t::iterator iter = mStaticImageListRaw.find(namekey);
+	if( iter != mStaticImageListRaw.end() )
+	{
+		return iter->second;
+	}
+
+	LLPointer<LLImageRaw> image_raw = new LLImageRaw;
+	if( !loadImageRaw( file_name, image_raw ) )
+	{
+		return NULL;
+	}
+	mStaticImageListRaw[ namekey ] = image_raw;
+	mRawBytes += image_raw->getDataSize();
+	return image_raw;
+}
+
 // Reads a .tga file, decodes it, and puts the decoded data in image_raw.
 // Returns TRUE if successful.
 BOOL LLTexStaticImageList::loadImageRaw( const std::string& file_name, LLImageRaw* image_raw )
@@ -34,8 +34,10 @@
 #define LL_LLTEXLAYER_H
 
 #include <deque>
+#include <set>
 #include "llassetstorage.h"
 #include "lldynamictexture.h"
+#include "llimagecompositor.h"
 #include "llrect.h"
 #include "llstring.h"
 #include "lluuid.h"
@@ -229,6 +231,11 @@ public:
 													 S32 result, LLExtStat ext_status);
 	static void				dumpTotalByteCount();
 
+	// Picks between baking with GL and compositing on the CPU, on
+	// AvatarCompositeThreads threads, from the AvatarCompositeOnCPU setting.
+	static void				updateCompositing();
+	static void				cleanupClass();
+
 	virtual void restoreGLTexture() ;
 	virtual void destroyGLTexture() ;
 
@@ -236,6 +243,13 @@ private:
 	void					pushProjection();
 	void					popProjection();
 	BOOL					needsUploadNow() const;
+	void					uploadBakedImage(const U8* baked_color_data, const U8* baked_mask_data);
+
+	// The CPU path. startComposite() returns FALSE if the layers need GL.
+	BOOL					startComposite();
+	void					finishComposite();
+	// Waits for the composite in progress, if any, and drops it.
+	void					cancelComposite();
 
 private:
 	BOOL					mNeedsUpdate;
@@ -245,8 +259,18 @@ private:
 	S32						mUploadFailCount;
 	U64						mUploadAfter;	// delay upload until after this time (in microseconds)
 	LLTexLayerSet*			mTexLayerSet;
+	LLImageCompositorThread* mCompositeThread;	// running our composite, if any
+	LLQueuedThread::handle_t mCompositeHandle;
+	BOOL					mCompositeForUpload;
 
 	static S32				sGLByteCount;
+
+	static BOOL				sCompositeOnCPU;
+	typedef std::vector<LLImageCompositorThread*> composite_thread_list_t;
+	static composite_thread_list_t sCompositeThreads;
+	static S32				sNextCompositeThread;
+	typedef std::set<LLTexLayerSetBuffer*> buffer_set_t;
+	static buffer_set_t		sCompositing;
 };
 
 //-----------------------------------------------------------------------------
@@ -267,6 +291,14 @@ public:
 	
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
 	void					renderAlphaMaskTextures(S32 x, S32 y, S32 width, S32 height, bool forceClear = false);
+	// Records what render() would draw, plus the alpha masks gatherAlphaMasks()
+	// needs if for_upload. Returns FALSE if some of it can only be done with GL.
+	BOOL					composite(LLImageCompositor& compositor, BOOL for_upload);
+	BOOL					compositeAlphaMaskTextures(LLImageCompositor& compositor, BOOL force_clear = FALSE);
+	// Hands the alpha masks of a finished composite() to the layers.
+	void					finishComposite(const LLImageCompositor& compositor);
+	// Local texture te as GL has it, read back once and kept until deleteCaches().
+	LLImageRaw*				getLocalTextureRaw(LLVOAvatarDefines::ETextureIndex te, LLImageGL* image_gl);
 	BOOL					isBodyRegion( const std::string& region ) { return mInfo->mBodyRegion == region; }
 	LLTexLayerSetBuffer*	getComposite();
 	void					requestUpdate();
@@ -282,6 +314,7 @@ public:
 	BOOL					getUpdatesEnabled()						{ return mUpdatesEnabled; }
 	void					deleteCaches();
 	void					gatherAlphaMasks(U8 *data, S32 width, S32 height);
+	void					gatherAlphaMasks(const LLImageCompositor& compositor, U8* data);
 	void					applyMorphMask(U8* tex_data, S32 width, S32 height, S32 num_components);
 	const std::string		getBodyRegion() 				{ return mInfo->mBodyRegion; }
 	BOOL					hasComposite()					{ return (mComposite != NULL); }
@@ -305,6 +338,15 @@ protected:
 	LLVOAvatarDefines::EBakedTextureIndex mBakedTexIndex;
 
 	LLTexLayerSetInfo 		*mInfo;
+
+	struct LocalTextureRaw
+	{
+		LLUUID					mID;
+		S32						mDiscardLevel;
+		LLPointer<LLImageRaw>	mImageRaw;
+	};
+	typedef std::map<S32, LocalTextureRaw> local_texture_raw_map_t;
+	local_texture_raw_map_t	mLocalTextureRaws;
 };
 
 //-----------------------------------------------------------------------------
@@ -337,6 +379,7 @@ public:
 	BOOL					setInfo(LLTexLayerInfo *info);
 	
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
+	BOOL					composite(LLImageCompositor& compositor);
 	void					requestUpdate();
 	LLTexLayerSet*			getTexLayerSet()						{ return mTexLayerSet; }
 
@@ -351,14 +394,28 @@ public:
 	ERenderPass				getRenderPass() 						{ return mInfo->mRenderPass; }
 	const std::string&			getGlobalColor() 						{ return mInfo->mGlobalColor; }
 	BOOL					findNetColor( LLColor4* color );
+	// findNetColor(), or the dummy avatar's color.
+	BOOL					findRenderColor( LLColor4* color );
 	BOOL					renderImageRaw( U8* in_data, S32 in_width, S32 in_height, S32 in_components, S32 width, S32 height, BOOL is_mask );
 	BOOL					renderAlphaMasks(  S32 x, S32 y, S32 width, S32 height, LLColor4* colorp );
+	BOOL					compositeAlphaMasks(LLImageCompositor& compositor, LLColor4* colorp);
+	void					finishComposite(const LLImageCompositor& compositor);
+	S32						getCompositeAlpha() const { return mCompositeAlpha; }
+	void					clearCompositeAlpha() { mCompositeAlpha = -1; }
 	BOOL					hasAlphaParams() { return (!mParamAlphaList.empty());}
 	BOOL					blendAlphaTexture(S32 x, S32 y, S32 width, S32 height);
+	BOOL					compositeAlphaTexture(LLImageCompositor& compositor);
 	BOOL					isVisibilityMask() const;
 	BOOL					isInvisibleAlphaMask();
 
 protected:
+	// Of the current local texture and alpha weights in mAlphaCache.
+	U32						getAlphaCacheIndex();
+	// Makes room for, and adds, a size byte mAlphaCache entry.
+	U8*						addAlphaData(U32 cache_index, S32 size);
+	// Masks the morphs with the layer's alpha mask.
+	void					applyAlphaData(U8* alpha_data, S32 width, S32 height);
+
 	LLTexLayerSet*			mTexLayerSet;
 	LLPointer<LLImageRaw>	mStaticImageRaw;
 
@@ -378,6 +435,10 @@ protected:
 	alpha_cache_t			mAlphaCache;
 	BOOL					mMorphMasksValid;
 	BOOL					mStaticImageInvalid;
+	// The LLImageCompositor alpha with this layer's alpha mask, and the alpha
+	// cache index it was composited for.
+	S32						mCompositeAlpha;
+	U32						mCompositeAlphaCacheIndex;
 
 	LLTexLayerInfo			*mInfo;
 };
@@ -413,6 +474,7 @@ public:
 
 	// New functions
 	BOOL					render( S32 x, S32 y, S32 width, S32 height );
+	BOOL					composite(LLImageCompositor& compositor);
 	BOOL					getSkip();
 	void					deleteCaches();
 	LLTexLayer*				getTexLayer()		{ return mTexLayer; }
@@ -534,12 +596,15 @@ private:
 
 	typedef std::map< const char *, LLPointer<LLImageGL> > image_gl_map_t;
 	typedef std::map< const char *, LLPointer<LLImageTGA> > image_tga_map_t;
+	typedef std::map< const char *, LLPointer<LLImageRaw> > image_raw_map_t;
 	image_gl_map_t mStaticImageListGL;
 	image_tga_map_t mStaticImageListTGA;
+	image_raw_map_t mStaticImageListRaw;
 
 public:
 	S32 mGLBytes;
 	S32 mTGABytes;
+	S32 mRawBytes;
 };
 
 // Used by LLTexLayerSetBuffer for a callback.
@@ -658,9 +658,12 @@ bool LLTextureCacheRemoteWorker::doWrite()
 	return done;
 }
 
+static LLFastTimer::DeclareTimer FTM_TEXTURE_CACHE_WORK("Texture Cache");
+
 //virtual
 bool LLTextureCacheWorker::doWork(S32 param)
 {
+	LLFastTimer t(FTM_TEXTURE_CACHE_WORK);
 	bool res = false;
 	if (param == 0) // read
 	{
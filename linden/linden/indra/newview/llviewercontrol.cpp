@@ -51,6 +51,8 @@
 #include "llpanelgeneral.h"
 #include "llpanelinput.h"
 #include "llsky.h"
+#include "llsurface.h"
+#include "lltexlayer.h"
 #include "llvieweraudio.h"
 #include "llviewerimagelist.h"
 #include "llviewerthrottle.h"
@@ -75,6 +77,13 @@
 #include "llrender.h"
 #include "llslider.h"
 #include "llfloaterchat.h"
+#include "llcloudpuffs.h"
+#include "llimagecompositor.h"
+#include "llmorphdeltas.h"
+#include "llpatchdecoder.h"
+#include "llskyatmosphere.h"
+#include "llterraincomposer.h"
+#include "llvertexxform.h"
 
 
 #ifdef TOGGLE_HACKED_GODLIKE_VIEWER
@@ -369,6 +378,16 @@ static bool handleRenderUseVBOChanged(const LLSD& newvalue)
 	return true;
 }
 
+static bool handleRenderVBOArenasChanged(const LLSD& newvalue)
+{
+	LLVertexBuffer::sUseArenas = newvalue.asBoolean();
+	if (gPipeline.isInit())
+	{
+		gPipeline.resetVertexBuffers();
+	}
+	return true;
+}
+
 static bool handleWLSkyDetailChanged(const LLSD&)
 {
 	if (gSky.mVOWLSkyp.notNull())
@@ -496,9 +515,79 @@ bool handleEffectColorChanged(const LLSD& newvalue)
 	return true;
 }
 
-bool handleVectorizeChanged(const LLSD& newvalue)
+void update_vectorize()
 {
 	LLViewerJointMesh::updateVectorize();
+
+	// The rest only come in SSE2 and scalar versions. Those that work on
+	// avatars go with skinning.
+	BOOL sse2 = gSavedSettings.getBOOL("VectorizeEnable") && gSavedSettings.getU32("VectorizeProcessor") == 2;
+	BOOL sse2_avatar = sse2 && gSavedSettings.getBOOL("VectorizeSkin");
+	LLVertexXform::useSSE2(sse2 && gSavedSettings.getBOOL("VectorizeVolumeFaces"));
+	LLMorphDeltas::useSSE2(sse2_avatar);
+	LLImageCompositor::useSSE2(sse2_avatar);
+	LLPatchDecoder::useSSE2(sse2);
+	LLTerrainComposer::useSSE2(sse2);
+	LLSkyCubeFace::useSSE2(sse2);
+	LLCloudPuffs::useSSE2(sse2);
+
+	std::string kernels;
+	if (LLVertexXform::usingSSE2()) kernels += " faces";
+	if (LLMorphDeltas::usingSSE2()) kernels += " morphs";
+	if (LLImageCompositor::usingSSE2()) kernels += " compositing";
+	if (LLPatchDecoder::usingSSE2()) kernels += " terrain";
+	if (LLTerrainComposer::usingSSE2()) kernels += " terrain_textures";
+	if (LLSkyCubeFace::usingSSE2()) kernels += " sky";
+	if (LLCloudPuffs::usingSSE2()) kernels += " clouds";
+	LL_INFOS("AppInit") << "SSE2 Kernels          :" << (kernels.empty() ? std::string(" NONE") : kernels) << LL_ENDL;
+}
+
+bool handleVectorizeChanged(const LLSD& newvalue)
+{
+	update_vectorize();
+	return true;
+}
+
+static bool handleBatchAvatarSkinningChanged(const LLSD& newvalue)
+{
+	LLVOAvatar::updateSkinningPool();
+	return true;
+}
+
+static bool handleAvatarMotionBudgetChanged(const LLSD& newvalue)
+{
+	LLVOAvatar::updateMotionBudget();
+	return true;
+}
+
+static bool handleAvatarCompositingChanged(const LLSD& newvalue)
+{
+	LLTexLayerSetBuffer::updateCompositing();
+	return true;
+}
+
+static bool handleTerrainThreadsChanged(const LLSD& newvalue)
+{
+	LLSurface::updateThreads();
+	return true;
+}
+
+static bool handleSkyThreadsChanged(const LLSD& newvalue)
+{
+	LLVOSky::updateThreads();
+	return true;
+}
+
+static bool handleFastTimerTraceChanged(const LLSD& newvalue)
+{
+	if (newvalue.asBoolean())
+	{
+		LLFastTimer::startTrace(gDirUtilp->getExpandedFilename(LL_PATH_LOGS, "fast_timers.json"));
+	}
+	else
+	{
+		LLFastTimer::stopTrace();
+	}
 	return true;
 }
 
@@ -609,6 +698,7 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("MuteUI")->getSignal()->connect(boost::bind(&handleAudioVolumeChanged, _1));
 	gSavedSettings.getControl("MuteGestures")->getSignal()->connect(boost::bind(&handleAudioVolumeChanged, _1));
 	gSavedSettings.getControl("RenderVBOEnable")->getSignal()->connect(boost::bind(&handleRenderUseVBOChanged, _1));
+	gSavedSettings.getControl("RenderVBOArenas")->getSignal()->connect(boost::bind(&handleRenderVBOArenasChanged, _1));
 	gSavedSettings.getControl("WLSkyDetail")->getSignal()->connect(boost::bind(&handleWLSkyDetailChanged, _1));
 	gSavedSettings.getControl("RenderLightingDetail")->getSignal()->connect(boost::bind(&handleRenderLightingDetailChanged, _1));
 	gSavedSettings.getControl("NumpadControl")->getSignal()->connect(boost::bind(&handleNumpadControlChanged, _1));
@@ -665,6 +755,21 @@ void settings_setup_listeners()
 	gSavedSettings.getControl("VectorizeEnable")->getSignal()->connect(boost::bind(&handleVectorizeChanged, _1));
 	gSavedSettings.getControl("VectorizeProcessor")->getSignal()->connect(boost::bind(&handleVectorizeChanged, _1));
 	gSavedSettings.getControl("VectorizeSkin")->getSignal()->connect(boost::bind(&handleVectorizeChanged, _1));
+	gSavedSettings.getControl("VectorizeVolumeFaces")->getSignal()->connect(boost::bind(&handleVectorizeChanged, _1));
+	gSavedSettings.getControl("BatchAvatarSkinning")->getSignal()->connect(boost::bind(&handleBatchAvatarSkinningChanged, _1));
+	gSavedSettings.getControl("BatchAvatarSkinningThreads")->getSignal()->connect(boost::bind(&handleBatchAvatarSkinningChanged, _1));
+	gSavedSettings.getControl("AvatarMotionBudget")->getSignal()->connect(boost::bind(&handleAvatarMotionBudgetChanged, _1));
+	gSavedSettings.getControl("AvatarMotionFullRateDistance")->getSignal()->connect(boost::bind(&handleAvatarMotionBudgetChanged, _1));
+	gSavedSettings.getControl("AvatarMotionMaxTimeStep")->getSignal()->connect(boost::bind(&handleAvatarMotionBudgetChanged, _1));
+	gSavedSettings.getControl("AvatarMotionMinRateDistance")->getSignal()->connect(boost::bind(&handleAvatarMotionBudgetChanged, _1));
+	gSavedSettings.getControl("AvatarCompositeOnCPU")->getSignal()->connect(boost::bind(&handleAvatarCompositingChanged, _1));
+	gSavedSettings.getControl("AvatarCompositeThreads")->getSignal()->connect(boost::bind(&handleAvatarCompositingChanged, _1));
+	gSavedSettings.getControl("TerrainDecompressOnThread")->getSignal()->connect(boost::bind(&handleTerrainThreadsChanged, _1));
+	gSavedSettings.getControl("TerrainNormalsOnThread")->getSignal()->connect(boost::bind(&handleTerrainThreadsChanged, _1));
+	gSavedSettings.getControl("TerrainComposeOnThread")->getSignal()->connect(boost::bind(&handleTerrainThreadsChanged, _1));
+	gSavedSettings.getControl("SkyCubeMapOnThreads")->getSignal()->connect(boost::bind(&handleSkyThreadsChanged, _1));
+	gSavedSettings.getControl("SkyCubeMapThreads")->getSignal()->connect(boost::bind(&handleSkyThreadsChanged, _1));
+	gSavedSettings.getControl("FastTimerTrace")->getSignal()->connect(boost::bind(&handleFastTimerTraceChanged, _1));
 	gSavedSettings.getControl("EnableVoiceChat")->getSignal()->connect(boost::bind(&handleVoiceClientPrefsChanged, _1));
 	gSavedSettings.getControl("PTTCurrentlyEnabled")->getSignal()->connect(boost::bind(&handleVoiceClientPrefsChanged, _1));
 	gSavedSettings.getControl("PushToTalkButton")->getSignal()->connect(boost::bind(&handleVoiceClientPrefsChanged, _1));
@@ -47,6 +47,9 @@ extern BOOL gHackGodmode;
 //setting variables are declared in this function
 void settings_setup_listeners();
 
+// Picks the vectorized code paths the Vectorize* settings ask for.
+void update_vectorize();
+
 extern std::map<std::string, LLControlGroup*> gSettings;
 
 // for the graphics settings
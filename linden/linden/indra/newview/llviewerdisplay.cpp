@@ -319,13 +319,23 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 
 	LLImageGL::updateStats(gFrameTimeSeconds);
 	
-	S32 RenderName = gSavedSettings.getS32("RenderName");
+	// Read every frame, so looked up once.
+	static LLControlHandle<S32> render_name(gSavedSettings, "RenderName");
+	static LLControlHandle<bool> render_hide_group_title_all(gSavedSettings, "RenderHideGroupTitleAll");
+	static LLControlHandle<bool> use_occlusion(gSavedSettings, "UseOcclusion");
+	static LLControlHandle<bool> render_fast_alpha(gSavedSettings, "RenderFastAlpha");
+	static LLControlHandle<bool> render_use_far_clip(gSavedSettings, "RenderUseFarClip");
+	static LLControlHandle<S32> render_avatar_max_visible(gSavedSettings, "RenderAvatarMaxVisible");
+	static LLControlHandle<bool> render_delay_vb_update(gSavedSettings, "RenderDelayVBUpdate");
+	static LLControlHandle<bool> render_water(gSavedSettings, "RenderWater");
+
+	S32 RenderName = render_name;
 
 	if(RenderName > gHippoLimits->mRenderName)//The most restricted gets set here
 		RenderName = gHippoLimits->mRenderName;
 
 	LLVOAvatar::sRenderName = RenderName;
-	LLVOAvatar::sRenderGroupTitles = !gSavedSettings.getBOOL("RenderHideGroupTitleAll");
+	LLVOAvatar::sRenderGroupTitles = !render_hide_group_title_all;
 	
 	gPipeline.mBackfaceCull = TRUE;
 	gFrameCount++;
@@ -615,6 +625,10 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 		gPipeline.createObjects(max_geom_update_time);
 		gPipeline.updateGeom(max_geom_update_time);
 		stop_glerror();
+
+		// Ahead of the shadow, impostor and reflection passes, which all draw avatars.
+		LLVOAvatar::skinBatchedAvatars();
+		stop_glerror();
 		
 		gFrameStats.start(LLFrameStats::UPDATE_CULL);
 		S32 water_clip = 0;
@@ -636,12 +650,13 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 		
 		//Increment drawable frame counter
 		LLDrawable::incrementVisible();
+		LLSpatialGroup::updateOcclusionView(*LLViewerCamera::getInstance());
 
 		LLSpatialGroup::sNoDelete = TRUE;
 		LLPipeline::sUseOcclusion = 
 				(!gUseWireframe
 				&& LLFeatureManager::getInstance()->isFeatureAvailable("UseOcclusion") 
-				&& gSavedSettings.getBOOL("UseOcclusion") 
+				&& use_occlusion 
 				&& gGLManager.mHasOcclusionQuery) ? 2 : 0;
 
 		if (LLPipeline::sUseOcclusion && LLPipeline::sRenderDeferred)
@@ -649,10 +664,10 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 			LLPipeline::sUseOcclusion = 3;
 		}
 
-		LLPipeline::sFastAlpha = gSavedSettings.getBOOL("RenderFastAlpha");
-		LLPipeline::sUseFarClip = gSavedSettings.getBOOL("RenderUseFarClip");
-		LLVOAvatar::sMaxVisible = gSavedSettings.getS32("RenderAvatarMaxVisible");
-		LLPipeline::sDelayVBUpdate = gSavedSettings.getBOOL("RenderDelayVBUpdate");
+		LLPipeline::sFastAlpha = render_fast_alpha;
+		LLPipeline::sUseFarClip = render_use_far_clip;
+		LLVOAvatar::sMaxVisible = render_avatar_max_visible;
+		LLPipeline::sDelayVBUpdate = render_delay_vb_update;
 
 		S32 occlusion = LLPipeline::sUseOcclusion;
 		if (gDepthDirty)
@@ -683,6 +698,7 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 			{
  				LLFastTimer ftm(LLFastTimer::FTM_CLIENT_COPY);
 				LLVertexBuffer::clientCopy(0.016);
+				LLVertexBuffer::updateArenas();
 			}
 
 			if (gResizeScreenTexture)
@@ -850,7 +866,7 @@ void display(BOOL rebuild, F32 zoom_factor, int subfield, BOOL for_snapshot)
 		LLPipeline::sUnderWaterRender = LLViewerCamera::getInstance()->cameraUnderWater() ? TRUE : FALSE;
 		
 		//Check for RenderWater
-		if (!gSavedSettings.getBOOL("RenderWater") || !gHippoLimits->mRenderWater)
+		if (!render_water || !gHippoLimits->mRenderWater)
 			LLPipeline::sUnderWaterRender = FALSE;
 		
 		LLPipeline::updateRenderDeferred();
@@ -982,7 +998,8 @@ void render_hud_attachments()
 		hud_cam.setAxes(LLVector3(1,0,0), LLVector3(0,1,0), LLVector3(0,0,1));
 		LLViewerCamera::updateFrustumPlanes(hud_cam, TRUE);
 
-		bool render_particles = gPipeline.hasRenderType(LLPipeline::RENDER_TYPE_PARTICLES) && gSavedSettings.getBOOL("RenderHUDParticles");
+		static LLControlHandle<bool> render_hud_particles(gSavedSettings, "RenderHUDParticles");
+		bool render_particles = gPipeline.hasRenderType(LLPipeline::RENDER_TYPE_PARTICLES) && render_hud_particles;
 		
 		//only render hud objects
 		U32 mask = gPipeline.getRenderTypeMask();
@@ -1271,7 +1288,8 @@ void render_ui_3d()
 	// Debugging stuff goes before the UI.
 
 	// Coordinate axes
-	if (gSavedSettings.getBOOL("ShowAxes"))
+	static LLControlHandle<bool> show_axes(gSavedSettings, "ShowAxes");
+	if (show_axes)
 	{
 		draw_axes();
 	}
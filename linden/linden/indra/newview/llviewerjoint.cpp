@@ -456,6 +456,16 @@ void LLViewerJoint::updateJointGeometry()
 	}
 }
 
+void LLViewerJoint::addSkinJobs(LLSkinningPool& pool)
+{
+	for (child_list_t::iterator iter = mChildren.begin();
+		 iter != mChildren.end(); ++iter)
+	{
+		LLViewerJoint* joint = (LLViewerJoint*)(*iter);
+		joint->addSkinJobs(pool);
+	}
+}
+
 
 BOOL LLViewerJoint::updateLOD(F32 pixel_area, BOOL activate)
 {
@@ -40,6 +40,7 @@
 #include "llapr.h"
 
 class LLFace;
+class LLSkinningPool;
 class LLViewerJointMesh;
 
 //-----------------------------------------------------------------------------
@@ -130,6 +131,8 @@ public:
 	virtual void updateFaceData(LLFace *face, F32 pixel_area, BOOL damp_wind = FALSE);
 	virtual BOOL updateLOD(F32 pixel_area, BOOL activate);
 	virtual void updateJointGeometry();
+	// Queues what updateJointGeometry() would skin, see LLVOAvatar::skinBatchedAvatars().
+	virtual void addSkinJobs(LLSkinningPool& pool);
 	virtual void dump();
 
 	void setVisible( BOOL visible, BOOL recursive );
@@ -457,10 +457,12 @@ void LLViewerObject::initVOClasses()
 
 void LLViewerObject::cleanupVOClasses()
 {
+	LLVOVolume::cleanupClass();
 	LLVOGrass::cleanupClass();
 	LLVOWater::cleanupClass();
 	LLVOTree::cleanupClass();
 	LLVOAvatar::cleanupClass();
+	LLVOSky::cleanupClass();
 }
 
 // Replaces all name value pairs with data from \n delimited list
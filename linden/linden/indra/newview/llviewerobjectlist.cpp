@@ -700,6 +700,11 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 
 	static BOOL* sFreezeTime = rebind_llcontrol<BOOL>("FreezeTime", &gSavedSettings, true);
 
+	// Avatars updated below have their joints updated all together afterwards.
+	LLVOAvatar::startJointBatch();
+	// ...and share a budget of motion updates.
+	LLMotionController::startFrame();
+
 	if ((*sFreezeTime))
 	{
 		for (std::vector<LLViewerObject*>::iterator iter = idle_list.begin();
@@ -737,6 +742,8 @@ void LLViewerObjectList::update(LLAgent &agent, LLWorld &world)
 		}
 	}
 
+	LLVOAvatar::finishJointBatch();
+
 	mNumSizeCulled = 0;
 	mNumVisCulled = 0;
 
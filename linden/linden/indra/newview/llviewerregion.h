@@ -53,7 +53,6 @@
 // Surface id's
 #define LAND  1
 #define WATER 2
-const U32	MAX_OBJECT_CACHE_ENTRIES = 10000;
 
 
 class LLEventPoll;
@@ -379,19 +378,10 @@ private:
 	std::string mProductName;
 	
 	
-	// Maps local ids to cache entries.
-	// Regions can have order 10,000 objects, so assume
-	// a structure of size 2^14 = 16,000
+	// The cache entries themselves live in LLVOCache.
 	BOOL									mCacheLoaded;
-	typedef std::map<U32, LLVOCacheEntry *>	cache_map_t;
-	cache_map_t			  				 	mCacheMap;
-	LLVOCacheEntry							mCacheStart;
-	LLVOCacheEntry							mCacheEnd;
-	U32										mCacheEntriesCount;
 	LLDynamicArray<U32>						mCacheMissFull;
 	LLDynamicArray<U32>						mCacheMissCRC;
-	// time?
-	// LRU info?
 
 	// Cache ID is unique per-region, across renames, moving locations,
 	// etc.
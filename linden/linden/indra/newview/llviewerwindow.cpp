@@ -1316,6 +1316,7 @@ LLViewerWindow::LLViewerWindow(
 	{
 		gSavedSettings.setBOOL("RenderVBOEnable", FALSE);
 	}
+	LLVertexBuffer::sUseArenas = gSavedSettings.getBOOL("RenderVBOArenas");
 	LLVertexBuffer::initClass(gSavedSettings.getBOOL("RenderVBOEnable") && gGLManager.mHasVertexBufferObject);
 
 	if (LLFeatureManager::getInstance()->isSafe()
@@ -48,23 +48,6 @@
 
 
 
-F32 bilinear(const F32 v00, const F32 v01, const F32 v10, const F32 v11, const F32 x_frac, const F32 y_frac)
-{
-	// Not sure if this is the right math...
-	// Take weighted average of all four points (bilinear interpolation)
-	F32 result;
-
-	const F32 inv_x_frac = 1.f - x_frac;
-	const F32 inv_y_frac = 1.f - y_frac;
-	result = inv_x_frac*inv_y_frac*v00
-			+ x_frac*inv_y_frac*v10
-			+ inv_x_frac*y_frac*v01
-			+ x_frac*y_frac*v11;
-
-	return result;
-}
-
-
 LLVLComposition::LLVLComposition(LLSurface *surfacep, const U32 width, const F32 scale) :
 	LLViewerLayer(width, scale),
 	mParamsReady(FALSE)
@@ -126,103 +109,15 @@ void LLVLComposition::setDetailTextureID(S32 corner, const std::string& filename
 BOOL LLVLComposition::generateHeights(const F32 x, const F32 y,
 									  const F32 width, const F32 height)
 {
-	if (!mParamsReady)
-	{
-		// All the parameters haven't been set yet (we haven't gotten the message from the sim)
-		return FALSE;
-	}
-
-	llassert(mSurfacep);
-
-	if (!mSurfacep || !mSurfacep->getRegion()) 
+	// width is a grid more than the texture's, which the composer adds itself.
+	LLTerrainComposer* composer = prepareComposition(x, y, width - mScale, TRUE, FALSE);
+	if (!composer)
 	{
-		// We don't always have the region yet here....
 		return FALSE;
 	}
-
-	S32 x_begin, y_begin, x_end, y_end;
-
-	x_begin = llround( x * mScaleInv );
-	y_begin = llround( y * mScaleInv );
-	x_end = llround( (x + width) * mScaleInv );
-	y_end = llround( (y + width) * mScaleInv );
-
-	if (x_end > mWidth)
-	{
-		x_end = mWidth;
-	}
-	if (y_end > mWidth)
-	{
-		y_end = mWidth;
-	}
-
-	LLVector3d origin_global = from_region_handle(mSurfacep->getRegion()->getHandle());
-
-	// For perlin noise generation...
-	const F32 slope_squared = 1.5f*1.5f;
-	const F32 xyScale = 4.9215f; //0.93284f;
-	const F32 zScale = 4; //0.92165f;
-	const F32 z_offset = 0.f;
-	const F32 noise_magnitude = 2.f;		//  Degree to which noise modulates composition layer (versus
-											//  simple height)
-
-	// Heights map into textures as 0-1 = first, 1-2 = second, etc.
-	// So we need to compress heights into this range.
-	const S32 NUM_TEXTURES = 4;
-
-	const F32 xyScaleInv = (1.f / xyScale);
-	const F32 zScaleInv = (1.f / zScale);
-
-	const F32 inv_width = 1.f/mWidth;
-
-	// OK, for now, just have the composition value equal the height at the point.
-	for (S32 j = y_begin; j < y_end; j++)
-	{
-		for (S32 i = x_begin; i < x_end; i++)
-		{
-
-			F32 vec[3];
-			F32 vec1[3];
-			F32 twiddle;
-
-			// Bilinearly interpolate the start height and height range of the textures
-			F32 start_height = bilinear(mStartHeight[SOUTHWEST],
-										mStartHeight[SOUTHEAST],
-										mStartHeight[NORTHWEST],
-										mStartHeight[NORTHEAST],
-										i*inv_width, j*inv_width); // These will be bilinearly interpolated
-			F32 height_range = bilinear(mHeightRange[SOUTHWEST],
-										mHeightRange[SOUTHEAST],
-										mHeightRange[NORTHWEST],
-										mHeightRange[NORTHEAST],
-										i*inv_width, j*inv_width); // These will be bilinearly interpolated
-
-			LLVector3 location(i*mScale, j*mScale, 0.f);
-
-			F32 height = mSurfacep->resolveHeightRegion(location) + z_offset;
-
-			// Step 0: Measure the exact height at this texel
-			vec[0] = (F32)(origin_global.mdV[VX]+location.mV[VX])*xyScaleInv;	//  Adjust to non-integer lattice
-			vec[1] = (F32)(origin_global.mdV[VY]+location.mV[VY])*xyScaleInv;
-			vec[2] = height*zScaleInv;
-			//
-			//  Choose material value by adding to the exact height a random value 
-			//
-			vec1[0] = vec[0]*(0.2222222222f);
-			vec1[1] = vec[1]*(0.2222222222f);
-			vec1[2] = vec[2]*(0.2222222222f);
-			twiddle = noise2(vec1)*6.5f;					//  Low freq component for large divisions
-
-			twiddle += turbulence2(vec, 2)*slope_squared;	//  High frequency component
-			twiddle *= noise_magnitude;
-
-			F32 scaled_noisy_height = (height + twiddle - start_height) * F32(NUM_TEXTURES) / height_range;
-
-			scaled_noisy_height = llmax(0.f, scaled_noisy_height);
-			scaled_noisy_height = llmin(3.f, scaled_noisy_height);
-			*(mDatap + i + j*mWidth) = scaled_noisy_height;
-		}
-	}
+	composer->compose();
+	applyComposition(*composer);
+	delete composer;
 	return TRUE;
 }
 
@@ -276,22 +171,26 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 
 	LLTimer gen_timer;
 
-	///////////////////////////
-	//
-	// Generate raw data arrays for surface textures
-	//
-	//
+	LLTerrainComposer* composer = prepareComposition(x, y, width, FALSE, TRUE);
+	if (!composer)
+	{
+		return FALSE;
+	}
+	composer->compose();
+	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
+	applyComposition(*composer);
+	delete composer;
+	return TRUE;
+}
 
+BOOL LLVLComposition::prepareRawImages()
+{
 	// These have already been validated by generateComposition.
-	U8* st_data[4];
-	S32 st_data_size[4]; // for debugging
-
 	for (S32 i = 0; i < 4; i++)
 	{
 		if (mRawImages[i].isNull())
 		{
 			// Read back a raw image for this discard level, if it exists
-			mRawImages[i] = new LLImageRaw;
 			S32 min_dim = llmin(mDetailTextures[i]->getWidth(0), mDetailTextures[i]->getHeight(0));
 			S32 ddiscard = 0;
 			while (min_dim > BASE_SIZE && ddiscard < MAX_DISCARD_LEVEL)
@@ -314,155 +213,149 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 				mRawImages[i] = newraw; // deletes old
 			}
 		}
-		st_data[i] = mRawImages[i]->getData();
-		st_data_size[i] = mRawImages[i]->getDataSize();
 	}
+	return TRUE;
+}
 
-	///////////////////////////////////////
-	//
-	// Generate and clamp x/y bounding box.
-	//
-	//
-
-	S32 x_begin, y_begin, x_end, y_end;
-	x_begin = (S32)(x * mScaleInv);
-	y_begin = (S32)(y * mScaleInv);
-	x_end = llround( (x + width) * mScaleInv );
-	y_end = llround( (y + width) * mScaleInv );
+LLTerrainComposer* LLVLComposition::prepareComposition(const F32 x, const F32 y, const F32 width,
+													   BOOL generate_heights, BOOL generate_texture,
+													   void* user_data)
+{
+	llassert(mSurfacep);
 
-	if (x_end > mWidth)
+	if (generate_heights)
 	{
-		llwarns << "x end > width" << llendl;
-		x_end = mWidth;
+		if (!mParamsReady)
+		{
+			// All the parameters haven't been set yet (we haven't gotten the message from the sim)
+			return NULL;
+		}
+		if (!mSurfacep || !mSurfacep->getRegion())
+		{
+			// We don't always have the region yet here....
+			return NULL;
+		}
 	}
-	if (y_end > mWidth)
+	if (generate_texture && !prepareRawImages())
 	{
-		llwarns << "y end > width" << llendl;
-		y_end = mWidth;
+		generate_texture = FALSE;
 	}
 
-
-	///////////////////////////////////////////
-	//
-	// Generate target texture information, stride ratios.
-	//
-	//
-
-	LLViewerImage *texturep;
-	U32 tex_width, tex_height, tex_comps;
-	U32 tex_stride;
-	F32 tex_x_scalef, tex_y_scalef;
-	S32 tex_x_begin, tex_y_begin, tex_x_end, tex_y_end;
-	F32 tex_x_ratiof, tex_y_ratiof;
-
-	texturep = mSurfacep->getSTexture();
-	tex_width = texturep->getWidth();
-	tex_height = texturep->getHeight();
-	tex_comps = texturep->getComponents();
-	tex_stride = tex_width * tex_comps;
-
-	S32 st_comps = 3;
-	S32 st_width = BASE_SIZE;
-	S32 st_height = BASE_SIZE;
-	
-	if (tex_comps != st_comps)
+	LLViewerImage* texturep = mSurfacep->getSTexture();
+	if (generate_texture && texturep->getComponents() != 3)
 	{
 		llwarns << "Base texture comps != input texture comps" << llendl;
-		return FALSE;
+		generate_texture = FALSE;
 	}
-
-	tex_x_scalef = (F32)tex_width / (F32)mWidth;
-	tex_y_scalef = (F32)tex_height / (F32)mWidth;
-	tex_x_begin = (S32)((F32)x_begin * tex_x_scalef);
-	tex_y_begin = (S32)((F32)y_begin * tex_y_scalef);
-	tex_x_end = (S32)((F32)x_end * tex_x_scalef);
-	tex_y_end = (S32)((F32)y_end * tex_y_scalef);
-
-	tex_x_ratiof = (F32)mWidth*mScale / (F32)tex_width;
-	tex_y_ratiof = (F32)mWidth*mScale / (F32)tex_height;
-
-	LLPointer<LLImageRaw> raw = new LLImageRaw(tex_width, tex_height, tex_comps);
-	U8 *rawp = raw->getData();
-
-	F32 tex_width_inv = 1.f/tex_width;
-	F32 tex_height_inv = 1.f/tex_height;
-
-	F32 st_x_stride, st_y_stride;
-	st_x_stride = ((F32)st_width / (F32)mTexScaleX)*((F32)mWidth / (F32)tex_width);
-	st_y_stride = ((F32)st_height / (F32)mTexScaleY)*((F32)mWidth / (F32)tex_height);
-
-	llassert(st_x_stride > 0.f);
-	llassert(st_y_stride > 0.f);
-	////////////////////////////////
-	//
-	// Iterate through the target texture, striding through the
-	// subtextures and interpolating appropriately.
-	//
-	//
-
-	F32 sti, stj;
-	S32 st_offset;
-	sti = (tex_x_begin * st_x_stride) - st_width*(llfloor((tex_x_begin * st_x_stride)/st_width));
-	stj = (tex_y_begin * st_y_stride) - st_height*(llfloor((tex_y_begin * st_y_stride)/st_height));
-
-	st_offset = (llfloor(stj * st_width) + llfloor(sti)) * st_comps;
-	for (S32 j = tex_y_begin; j < tex_y_end; j++)
+	if (!generate_heights && !generate_texture)
 	{
-		U32 offset = j * tex_stride + tex_x_begin * tex_comps;
-		sti = (tex_x_begin * st_x_stride) - st_width*((U32)(tex_x_begin * st_x_stride)/st_width);
-		for (S32 i = tex_x_begin; i < tex_x_end; i++)
-		{
-			S32 tex0, tex1;
-			F32 composition = getValueScaled(i*tex_x_ratiof, j*tex_y_ratiof);
-
-			tex0 = llfloor( composition );
-			tex0 = llclamp(tex0, 0, 3);
-			composition -= tex0;
-			tex1 = tex0 + 1;
-			tex1 = llclamp(tex1, 0, 3);
-
-			F32 xy_int_i, xy_int_j;
+		return NULL;
+	}
 
-			xy_int_i = i * tex_width_inv;
-			xy_int_j = j * tex_height_inv;
+	// The values reach a grid past the texture to the north and east.
+	S32 x_begin = llround(x * mScaleInv);
+	S32 y_begin = llround(y * mScaleInv);
+	S32 x_end = llmin(llround((x + width) * mScaleInv) + 1, mWidth);
+	S32 y_end = llmin(llround((y + width) * mScaleInv) + 1, mWidth);
 
-			st_offset = (lltrunc(sti) + lltrunc(stj)*st_width) * st_comps;
-			for (U32 k = 0; k < tex_comps; k++)
+	LLTerrainComposer* composer = new LLTerrainComposer(getNoiseTables(), mWidth, mScale, user_data);
+	composer->setValuesRect(LLRect(x_begin, y_end, x_end, y_begin), generate_heights);
+	if (generate_heights)
+	{
+		LLVector3d origin_global = from_region_handle(mSurfacep->getRegion()->getHandle());
+		composer->setOrigin(origin_global.mdV[VX], origin_global.mdV[VY]);
+		composer->setCorners(mStartHeight, mHeightRange);
+		for (S32 j = y_begin; j < y_end; j++)
+		{
+			for (S32 i = x_begin; i < x_end; i++)
 			{
-				// Linearly interpolate based on composition.
-				if (st_offset >= st_data_size[tex0] || st_offset >= st_data_size[tex1])
-				{
-					// SJB: This shouldn't be happening, but does... Rounding error?
-					//llwarns << "offset 0 [" << tex0 << "] =" << st_offset << " >= size=" << st_data_size[tex0] << llendl;
-					//llwarns << "offset 1 [" << tex1 << "] =" << st_offset << " >= size=" << st_data_size[tex1] << llendl;
-				}
-				else
-				{
-					F32 a = *(st_data[tex0] + st_offset);
-					F32 b = *(st_data[tex1] + st_offset);
-					rawp[ offset ] = (U8)lltrunc( a + composition * (b - a) );
-				}
-				offset++;
-				st_offset++;
+				LLVector3 location(i*mScale, j*mScale, 0.f);
+				composer->setHeight(i, j, mSurfacep->resolveHeightRegion(location));
 			}
-
-			sti += st_x_stride;
-			if (sti >= st_width)
+		}
+	}
+	else
+	{
+		for (S32 j = y_begin; j < y_end; j++)
+		{
+			for (S32 i = x_begin; i < x_end; i++)
 			{
-				sti -= st_width;
+				composer->setValue(i, j, *(mDatap + i + j*mWidth));
 			}
 		}
+	}
+
+	if (generate_texture)
+	{
+		S32 tex_x_begin = (S32)(x * mScaleInv);
+		S32 tex_y_begin = (S32)(y * mScaleInv);
+		S32 tex_x_end = llround((x + width) * mScaleInv);
+		S32 tex_y_end = llround((y + width) * mScaleInv);
+		if (tex_x_end > mWidth)
+		{
+			llwarns << "x end > width" << llendl;
+			tex_x_end = mWidth;
+		}
+		if (tex_y_end > mWidth)
+		{
+			llwarns << "y end > width" << llendl;
+			tex_y_end = mWidth;
+		}
+		composer->setTexture(LLRect(tex_x_begin, tex_y_end, tex_x_end, tex_y_begin),
+							 texturep->getWidth(), texturep->getHeight(), mTexScaleX, mTexScaleY);
+		for (S32 i = 0; i < 4; i++)
+		{
+			composer->setDetail(i, mRawImages[i]);
+		}
+	}
+	return composer;
+}
 
-		stj += st_y_stride;
-		if (stj >= st_height)
+void LLVLComposition::applyComposition(const LLTerrainComposer& composer)
+{
+	if (composer.getGeneratesValues())
+	{
+		const LLRect& rect = composer.getValuesRect();
+		for (S32 j = rect.mBottom; j < rect.mTop; j++)
 		{
-			stj -= st_height;
+			for (S32 i = rect.mLeft; i < rect.mRight; i++)
+			{
+				*(mDatap + i + j*mWidth) = composer.getValue(i, j);
+			}
 		}
 	}
 
-	texturep->setSubImage(raw, tex_x_begin, tex_y_begin, tex_x_end - tex_x_begin, tex_y_end - tex_y_begin);
+	if (!composer.hasTexture())
+	{
+		return;
+	}
+
+	LLTimer gen_timer;
+
+	LLViewerImage* texturep = mSurfacep->getSTexture();
+	S32 tex_width = texturep->getWidth();
+	S32 tex_height = texturep->getHeight();
+	if (mTextureRaw.isNull() ||
+		mTextureRaw->getWidth() != tex_width ||
+		mTextureRaw->getHeight() != tex_height)
+	{
+		mTextureRaw = new LLImageRaw(tex_width, tex_height, 3);
+	}
+
+	// setSubImage() takes the texels from where they go in a whole texture.
+	const LLRect& rect = composer.getTextureRect();
+	const LLImageRaw* texels = composer.getTexture();
+	S32 row_size = rect.getWidth() * 3;
+	for (S32 j = 0; j < rect.getHeight(); j++)
+	{
+		memcpy(mTextureRaw->getData() + ((rect.mBottom + j) * tex_width + rect.mLeft) * 3,
+			   texels->getData() + j * texels->getWidth() * 3,
+			   row_size);
+	}
+
+	texturep->setSubImage(mTextureRaw, rect.mLeft, rect.mBottom, rect.getWidth(), rect.getHeight());
 	LLSurface::sTextureUpdateTime += gen_timer.getElapsedTimeF32();
-	LLSurface::sTexelsUpdated += (tex_x_end - tex_x_begin) * (tex_y_end - tex_y_begin);
+	LLSurface::sTexelsUpdated += rect.getWidth() * rect.getHeight();
 
 	for (S32 i = 0; i < 4; i++)
 	{
@@ -470,8 +363,18 @@ BOOL LLVLComposition::generateTexture(const F32 x, const F32 y,
 		mDetailTextures[i]->setBoostLevel(LLViewerImageBoostLevel::BOOST_NONE);
 		mDetailTextures[i]->setMinDiscardLevel(MAX_DISCARD_LEVEL + 1);
 	}
-	
-	return TRUE;
+}
+
+// static
+LLTerrainComposer::NoiseTables LLVLComposition::getNoiseTables()
+{
+	if (gNoiseStart)
+	{
+		gNoiseStart = 0;
+		init();
+	}
+	LLTerrainComposer::NoiseTables tables = { p, &g2[0][0] };
+	return tables;
 }
 
 LLUUID LLVLComposition::getDetailTextureID(S32 corner)
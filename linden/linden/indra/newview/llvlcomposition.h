@@ -35,6 +35,7 @@
 
 #include "llviewerlayer.h"
 #include "llviewerimage.h"
+#include "llterraincomposer.h"
 
 class LLSurface;
 
@@ -52,6 +53,19 @@ public:
 	// Generate texture from composition values.
 	BOOL generateTexture(const F32 x, const F32 y, const F32 width, const F32 height);		
 
+	// Sets up what generateHeights() and generateTexture() do for the patch
+	// of width meters at x, y, to be composed elsewhere and handed to
+	// applyComposition(). The values of the patch are copied in rather than
+	// generated unless generate_heights is set. NULL if neither can be done
+	// yet.
+	LLTerrainComposer* prepareComposition(const F32 x, const F32 y, const F32 width,
+										  BOOL generate_heights, BOOL generate_texture,
+										  void* user_data = NULL);
+	void applyComposition(const LLTerrainComposer& composer);
+
+	// The tables of noise2() in noise.h, set up.
+	static LLTerrainComposer::NoiseTables getNoiseTables();
+
 	// Use these as indeces ito the get/setters below that use 'corner'
 	enum ECorner
 	{
@@ -76,12 +90,16 @@ public:
 	void setParamsReady()		{ mParamsReady = TRUE; }
 	BOOL getParamsReady() const	{ return mParamsReady; }
 protected:
+	// Reads back the detail textures generateTexture() blends.
+	BOOL prepareRawImages();
+
 	BOOL mParamsReady;
 	LLSurface *mSurfacep;
 	BOOL mTexturesLoaded;
 
 	LLPointer<LLViewerImage> mDetailTextures[CORNER_COUNT];
 	LLPointer<LLImageRaw> mRawImages[CORNER_COUNT];
+	LLPointer<LLImageRaw> mTextureRaw;	// Texels on their way to the surface texture
 
 	F32 mStartHeight[CORNER_COUNT];
 	F32 mHeightRange[CORNER_COUNT];
@@ -62,6 +62,7 @@
 #include "llregionhandle.h"
 #include "llresmgr.h"
 #include "llselectmgr.h"
+#include "llskinningpool.h"
 #include "llsprite.h"
 #include "lltargetingmotion.h"
 #include "lltexlayer.h"
@@ -685,6 +686,9 @@ S32 LLVOAvatar::sScratchTexBytes = 0;
 F32 LLVOAvatar::sRenderDistance = 256.f;
 S32	LLVOAvatar::sNumVisibleAvatars = 0;
 S32	LLVOAvatar::sNumLODChangesThisFrame = 0;
+LLSkinningPool* LLVOAvatar::sSkinningPool = NULL;
+BOOL LLVOAvatar::sBatchingJoints = FALSE;
+std::vector<LLPointer<LLVOAvatar> > LLVOAvatar::sBatchedJoints;
 LLSD LLVOAvatar::sClientResolutionList;
 
 const LLUUID LLVOAvatar::sStepSoundOnLand("e8af4a28-aa83-4310-a7c4-c047e15ea0df");
@@ -1481,11 +1485,18 @@ void LLVOAvatar::initClass()
 		loadClientTags();
 	}
 	initCloud();
+	updateSkinningPool();
+	updateMotionBudget();
+	LLTexLayerSetBuffer::updateCompositing();
 }
 
 
 void LLVOAvatar::cleanupClass()
 {
+	LLTexLayerSetBuffer::cleanupClass();
+	sBatchedJoints.clear();
+	delete sSkinningPool;
+	sSkinningPool = NULL;
 	delete sAvatarXmlInfo;
 	sAvatarXmlInfo = NULL;
 	delete sAvatarSkeletonInfo;
@@ -2800,8 +2811,10 @@ void LLVOAvatar::idleUpdateVoiceVisualizer(bool voice_enabled)
 					if( mAahMorph ) mAahMorph->setWeight(mAahMorph->getMinWeight(), FALSE);
 
 					mLipSyncActive = false;
-					LLCharacter::updateVisualParams();
-					dirtyMesh();
+					if (LLCharacter::applyChangedVisualParams())
+					{
+						dirtyMesh();
+					}
 				}
 			}
 		}
@@ -3024,6 +3037,7 @@ void LLVOAvatar::idleUpdateBoobEffect()
 			param->stopAnimating(FALSE);
 			param->setWeight(llclamp(newBoobState.boobGrav+getActualBoobGrav(), -1.5f, 2.f), FALSE);
 			param->apply(avatar_sex);
+			dirtyMesh();
 			updateVisualParams();
 		}
 
@@ -3053,6 +3067,7 @@ void LLVOAvatar::idleUpdateBoobEffect()
 			param->stopAnimating(FALSE);
 			param->setWeight(newButtState.boobGrav*0.3f+getActualButtGrav(), FALSE);
 			param->apply(avatar_sex);
+			dirtyMesh();
 			updateVisualParams();
 		}
 
@@ -3082,6 +3097,7 @@ void LLVOAvatar::idleUpdateBoobEffect()
 			param->stopAnimating(FALSE);
 			param->setWeight(newFatState.boobGrav*0.3f+getActualFatGrav(), FALSE);
 			param->apply(avatar_sex);
+			dirtyMesh();
 			updateVisualParams();
 		}
 
@@ -3119,8 +3135,10 @@ void LLVOAvatar::idleUpdateLipSync(bool voice_enabled)
 		}
 
 		mLipSyncActive = true;
-		LLCharacter::updateVisualParams();
-		dirtyMesh();
+		if (LLCharacter::applyChangedVisualParams())
+		{
+			dirtyMesh();
+		}
 	}
 }
 
@@ -4233,9 +4251,8 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 	// change animation time quanta based on avatar render load
 	if (!mIsSelf && !mIsDummy)
 	{
-		F32 time_quantum = clamp_rescale((F32)sInstances.size(), 10.f, 35.f, 0.f, 0.25f);
-		F32 pixel_area_scale = clamp_rescale(mPixelArea, 100, 5000, 1.f, 0.f);
-		F32 time_step = time_quantum * pixel_area_scale;
+		F32 distance = mDrawable.notNull() ? mDrawable->mDistanceWRTCamera : 0.f;
+		F32 time_step = LLMotionController::calcTimeStep((S32)sInstances.size(), mPixelArea, distance);
 		if (time_step != 0.f)
 		{
 			// disable walk motion servo controller as it doesn't work with motion timesteps
@@ -4243,7 +4260,9 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 			removeAnimationData("Walk Speed");
 		}
 		mMotionController.setTimeStep(time_step);
-//		llinfos << "Setting timestep to " << time_quantum * pixel_area_scale << llendl;
+		// only other avatars give up updates to the frame's motion budget
+		mMotionController.setBudgeted(TRUE);
+//		llinfos << "Setting timestep to " << time_step << llendl;
 	}
 
 	if (getParent() && !mIsSitting)
@@ -4595,7 +4614,14 @@ BOOL LLVOAvatar::updateCharacter(LLAgent &agent)
 		}
 	}
 
-	mRoot.updateWorldMatrixChildren();
+	if (sBatchingJoints)
+	{
+		sBatchedJoints.push_back(this);
+	}
+	else
+	{
+		mRoot.updateWorldMatrixChildren();
+	}
 
 	if (!mDebugText.size() && mText.notNull())
 	{
@@ -4792,6 +4818,41 @@ BOOL LLVOAvatar::needsRenderBeam()
 	return is_touching_or_grabbing || (mState & AGENT_STATE_EDITING && LLSelectMgr::getInstance()->shouldShowSelection());
 }
 
+//-----------------------------------------------------------------------------
+// updateDirtyMeshData()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::updateDirtyMeshData()
+{
+	if (mDirtyMesh || mDrawable->isState(LLDrawable::REBUILD_GEOMETRY))
+	{	//LOD changed or new mesh created, allocate new vertex buffer if needed
+		updateMeshData();
+		mDirtyMesh = FALSE;
+		mNeedsSkin = TRUE;
+		mDrawable->clearState(LLDrawable::REBUILD_GEOMETRY);
+	}
+}
+
+//-----------------------------------------------------------------------------
+// getMeshesToSkin()
+//-----------------------------------------------------------------------------
+void LLVOAvatar::getMeshesToSkin(std::vector<LLViewerJoint*>& meshes)
+{
+	meshes.push_back(mMeshLOD[MESH_ID_LOWER_BODY]);
+	meshes.push_back(mMeshLOD[MESH_ID_UPPER_BODY]);
+
+	if( isWearingWearableType( WT_SKIRT ) )
+	{
+		meshes.push_back(mMeshLOD[MESH_ID_SKIRT]);
+	}
+
+	if (!mIsSelf || gAgent.needsRenderHead() || LLPipeline::sShadowRender)
+	{
+		meshes.push_back(mMeshLOD[MESH_ID_EYELASH]);
+		meshes.push_back(mMeshLOD[MESH_ID_HEAD]);
+		meshes.push_back(mMeshLOD[MESH_ID_HAIR]);
+	}
+}
+
 //-----------------------------------------------------------------------------
 // renderSkinned()
 //-----------------------------------------------------------------------------
@@ -4804,32 +4865,19 @@ U32 LLVOAvatar::renderSkinned(EAvatarRenderPass pass)
 		return num_indices;
 	}
 
-	if (mDirtyMesh || mDrawable->isState(LLDrawable::REBUILD_GEOMETRY))
-	{	//LOD changed or new mesh created, allocate new vertex buffer if needed
-		updateMeshData();
-		mDirtyMesh = FALSE;
-		mNeedsSkin = TRUE;
-		mDrawable->clearState(LLDrawable::REBUILD_GEOMETRY);
-	}
+	updateDirtyMeshData();
 
 	if (LLViewerShaderMgr::instance()->getVertexShaderLevel(LLViewerShaderMgr::SHADER_AVATAR) <= 0)
 	{
 		if (mNeedsSkin)
 		{
 			//generate animated mesh
-			mMeshLOD[MESH_ID_LOWER_BODY]->updateJointGeometry();
-			mMeshLOD[MESH_ID_UPPER_BODY]->updateJointGeometry();
-
-			if( isWearingWearableType( WT_SKIRT ) )
-			{
-				mMeshLOD[MESH_ID_SKIRT]->updateJointGeometry();
-			}
-
-			if (!mIsSelf || gAgent.needsRenderHead() || LLPipeline::sShadowRender)
+			std::vector<LLViewerJoint*> meshes;
+			getMeshesToSkin(meshes);
+			for (std::vector<LLViewerJoint*>::iterator iter = meshes.begin();
+				 iter != meshes.end(); ++iter)
 			{
-				mMeshLOD[MESH_ID_EYELASH]->updateJointGeometry();
-				mMeshLOD[MESH_ID_HEAD]->updateJointGeometry();
-				mMeshLOD[MESH_ID_HAIR]->updateJointGeometry();
+				(*iter)->updateJointGeometry();
 			}
 			mNeedsSkin = FALSE;
 
@@ -6361,7 +6409,13 @@ void LLVOAvatar::updateVisualParams()
 
 	setSex( (getVisualParamWeight( "male" ) > 0.5f) ? SEX_MALE : SEX_FEMALE );
 
-	LLCharacter::updateVisualParams();
+	if (!LLCharacter::applyChangedVisualParams()
+		&& mLastSkeletonSerialNum == mSkeletonSerialNum)
+	{
+		// Nothing moved, the mesh doesn't need rebuilding. Callers that
+		// apply params themselves dirty the mesh themselves.
+		return;
+	}
 
 	if (mLastSkeletonSerialNum != mSkeletonSerialNum)
 	{
@@ -9991,6 +10045,121 @@ void LLVOAvatar::updateImpostors()
 	}
 }
 
+//static
+void LLVOAvatar::updateSkinningPool()
+{
+	delete sSkinningPool;
+	sSkinningPool = NULL;
+	if (gSavedSettings.getBOOL("BatchAvatarSkinning"))
+	{
+		sSkinningPool = new LLSkinningPool(llmax(gSavedSettings.getS32("BatchAvatarSkinningThreads"), 0));
+	}
+}
+
+//static
+void LLVOAvatar::updateMotionBudget()
+{
+	LLMotionController::setMotionBudget(gSavedSettings.getS32("AvatarMotionBudget"));
+	LLMotionController::setTimeStepLimits(gSavedSettings.getF32("AvatarMotionMaxTimeStep"),
+										  gSavedSettings.getF32("AvatarMotionFullRateDistance"),
+										  gSavedSettings.getF32("AvatarMotionMinRateDistance"));
+}
+
+//static
+void LLVOAvatar::startJointBatch()
+{
+	sBatchingJoints = sSkinningPool != NULL;
+}
+
+//static
+void LLVOAvatar::finishJointBatch()
+{
+	sBatchingJoints = FALSE;
+	if (sBatchedJoints.empty())
+	{
+		return;
+	}
+	for (std::vector<LLPointer<LLVOAvatar> >::iterator iter = sBatchedJoints.begin();
+		 iter != sBatchedJoints.end(); ++iter)
+	{
+		LLVOAvatar* avatar = *iter;
+		if (avatar->isDead())
+		{
+			continue;
+		}
+		if (sSkinningPool)
+		{
+			sSkinningPool->addJoints(&avatar->mRoot);
+		}
+		else
+		{
+			// The pool went away since the batch started.
+			avatar->mRoot.updateWorldMatrixChildren();
+		}
+	}
+	if (sSkinningPool)
+	{
+		sSkinningPool->run();
+	}
+	sBatchedJoints.clear();
+}
+
+//static
+void LLVOAvatar::skinBatchedAvatars()
+{
+	if (!sSkinningPool
+		|| LLViewerShaderMgr::instance()->getVertexShaderLevel(LLViewerShaderMgr::SHADER_AVATAR) > 0)
+	{
+		return;
+	}
+
+	std::vector<LLVOAvatar*> skinned;
+	std::vector<LLViewerJoint*> meshes;
+	for (std::vector<LLCharacter*>::iterator iter = LLCharacter::sInstances.begin();
+		iter != LLCharacter::sInstances.end(); ++iter)
+	{
+		LLVOAvatar* avatar = (LLVOAvatar*) *iter;
+		// Impostors are skinned when their impostor is redrawn, and which of
+		// our own meshes get skinned depends on the pass.
+		if (avatar->isDead()
+			|| !avatar->mIsBuilt
+			|| avatar->mDrawable.isNull()
+			|| !avatar->isVisible()
+			|| avatar->isImpostor()
+			|| (avatar->mIsSelf && !gAgent.needsRenderHead()))
+		{
+			continue;
+		}
+
+		avatar->updateDirtyMeshData();
+		if (!avatar->mNeedsSkin || !avatar->mDrawable->getFace(0)
+			|| avatar->mDrawable->getFace(0)->mVertexBuffer.isNull())
+		{
+			continue;
+		}
+
+		meshes.clear();
+		avatar->getMeshesToSkin(meshes);
+		for (std::vector<LLViewerJoint*>::iterator mesh_iter = meshes.begin();
+			 mesh_iter != meshes.end(); ++mesh_iter)
+		{
+			(*mesh_iter)->addSkinJobs(*sSkinningPool);
+		}
+		skinned.push_back(avatar);
+	}
+
+	sSkinningPool->run();
+
+	// Upload what the pool wrote.
+	for (std::vector<LLVOAvatar*>::iterator iter = skinned.begin();
+		iter != skinned.end(); ++iter)
+	{
+		LLVOAvatar* avatar = *iter;
+		avatar->mNeedsSkin = FALSE;
+		avatar->mDrawable->getFace(0)->mVertexBuffer->setBuffer(0);
+	}
+}
+
 BOOL LLVOAvatar::isImpostor() const
 {
 	return (sUseImpostors && mUpdatePeriod >= IMPOSTOR_PERIOD) ? TRUE : FALSE;
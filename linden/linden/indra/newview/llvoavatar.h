@@ -63,6 +63,7 @@ extern const LLUUID ANIM_AGENT_PELVIS_FIX;
 extern const LLUUID ANIM_AGENT_TARGET;
 extern const LLUUID ANIM_AGENT_WALK_ADJUST;
 
+class LLSkinningPool;
 class LLTexLayerSet;
 class LLVoiceVisualizer;
 class LLHUDText;
@@ -90,6 +91,20 @@ public:
 
 	static void updateImpostors();
 
+	// While a joint batch is open, avatars leave their joint hierarchy
+	// update to finishJointBatch(), which does all of them together on the
+	// skinning pool. Joint getters bring joints up to date on demand in the
+	// meantime.
+	static void startJointBatch();
+	static void finishJointBatch();
+	// Skins every visible avatar that needs it on the skinning pool, when
+	// avatars are skinned in software. Whatever this leaves out is skinned
+	// by renderSkinned() as before.
+	static void skinBatchedAvatars();
+	// Starts or stops the skinning pool as the BatchAvatarSkinning settings say.
+	static void updateSkinningPool();
+	static void updateMotionBudget();
+
 	//--------------------------------------------------------------------
 	// LLViewerObject interface
 	//--------------------------------------------------------------------
@@ -133,6 +148,9 @@ public:
 	U32 renderImpostor(LLColor4U color = LLColor4U(255,255,255,255));
 	U32 renderRigid();
 	U32 renderSkinned(EAvatarRenderPass pass);
+	void updateDirtyMeshData();
+	// The mesh LODs renderSkinned() skins.
+	void getMeshesToSkin(std::vector<LLViewerJoint*>& meshes);
 	U32 renderTransparent(BOOL first_pass);
 	void renderCollisionVolumes();
 	
@@ -599,6 +617,9 @@ public:
 	static bool sHasCloud;
 
 	static S32 sNumVisibleAvatars; // Number of instances of this class
+	static LLSkinningPool* sSkinningPool; // NULL unless batching joint updates and skinning
+	static BOOL sBatchingJoints;
+	static std::vector<LLPointer<LLVOAvatar> > sBatchedJoints;
 	
 	//--------------------------------------------------------------------
 	// Miscellaneous public variables.
@@ -35,73 +35,90 @@
 #include "llvocache.h"
 
 #include "llerror.h"
+#include "llcrc.h"
+
+// Viewer object cache version, change if object update
+// format changes. JC
+const U32 INDRA_OBJECT_CACHE_VERSION = 15;
+
+// Anything bigger than this is certainly corruption.
+const U32 MAX_OBJECT_CACHE_ENTRY_SIZE = 10000;
+
+static inline S32 padded_size(S32 size)
+{
+	return (size + 7) & ~7;
+}
+
+static inline S32 record_size(S32 payload_size)
+{
+	return (S32)sizeof(LLVOCacheRecord) + padded_size(payload_size);
+}
+
+struct LLVOCacheHeader
+{
+	U32 mZero;			// zero to indicate a version cache file
+	U32 mVersion;
+	U32 mRecordSize;	// sizeof(LLVOCacheRecord) of the writer
+	U32 mPad;
+};
 
 //---------------------------------------------------------------------------
 // LLVOCacheEntry
 //---------------------------------------------------------------------------
 
-LLVOCacheEntry::LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp)
+LLVOCacheEntry::LLVOCacheEntry(U64 region_handle, U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp)
 {
+	mRegionHandle = region_handle;
 	mLocalID = local_id;
 	mCRC = crc;
 	mHitCount = 0;
 	mDupeCount = 0;
 	mCRCChangeCount = 0;
+	mChecksum = 0;
+	mDiskSize = 0;
+	mValidated = TRUE;
+	mDirty = TRUE;
 	mBuffer = new U8[dp.getBufferSize()];
+	mDataPtr = mBuffer;
 	mDP.assignBuffer(mBuffer, dp.getBufferSize());
 	mDP = dp;
 }
 
+LLVOCacheEntry::LLVOCacheEntry(const LLVOCacheRecord &record, U8 *mapped_data)
+{
+	mRegionHandle = record.mRegionHandle;
+	mLocalID = record.mLocalID;
+	mCRC = record.mCRC;
+	mHitCount = record.mHitCount;
+	mDupeCount = record.mDupeCount;
+	mCRCChangeCount = record.mCRCChangeCount;
+	mChecksum = record.mChecksum;
+	mDiskSize = record_size(record.mSize);
+	mValidated = FALSE;
+	mDirty = FALSE;
+	mBuffer = NULL;
+	mDataPtr = mapped_data;
+	// The mapping is read only; this data packer must only ever be unpacked.
+	mDP.assignBuffer(mapped_data, record.mSize);
+}
+
 LLVOCacheEntry::LLVOCacheEntry()
 {
+	mRegionHandle = 0;
 	mLocalID = 0;
 	mCRC = 0;
 	mHitCount = 0;
 	mDupeCount = 0;
 	mCRCChangeCount = 0;
+	mChecksum = 0;
+	mDiskSize = 0;
+	mValidated = TRUE;
+	mDirty = FALSE;
 	mBuffer = NULL;
+	mDataPtr = NULL;
 	mDP.assignBuffer(mBuffer, 0);
 }
 
-
-static inline void checkedRead(LLFILE *fp, void *data, size_t nbytes)
-{
-	if (fread(data, 1, nbytes, fp) != nbytes)
-	{
-		llwarns << "Short read" << llendl;
-		memset(data, 0, nbytes);
-	}
-}
-
-LLVOCacheEntry::LLVOCacheEntry(LLFILE *fp)
-{
-	S32 size;
-	checkedRead(fp, &mLocalID, sizeof(U32));
-	checkedRead(fp, &mCRC, sizeof(U32));
-	checkedRead(fp, &mHitCount, sizeof(S32));
-	checkedRead(fp, &mDupeCount, sizeof(S32));
-	checkedRead(fp, &mCRCChangeCount, sizeof(S32));
-
-	checkedRead(fp, &size, sizeof(S32));
-
-	// Corruption in the cache entries
-	if ((size > 10000) || (size < 1))
-	{
-		// We've got a bogus size, skip reading it.
-		// We won't bother seeking, because the rest of this file
-		// is likely bogus, and will be tossed anyway.
-		llwarns << "Bogus cache entry, size " << size << ", aborting!" << llendl;
-		mLocalID = 0;
-		mCRC = 0;
-		mBuffer = NULL;
-		return;
-	}
-
-	mBuffer = new U8[size];
-	checkedRead(fp, mBuffer, size);
-	mDP.assignBuffer(mBuffer, size);
-}
-
 LLVOCacheEntry::~LLVOCacheEntry()
 {
 	if (mBuffer)
@@ -110,6 +127,10 @@ LLVOCacheEntry::~LLVOCacheEntry()
 	}
 }
 
+S32 LLVOCacheEntry::getRecordSize() const
+{
+	return record_size(mDP.getBufferSize());
+}
 
 // New CRC means the object has changed.
 void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
@@ -121,11 +142,48 @@ void LLVOCacheEntry::assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp)
 		mHitCount = 0;
 		mCRCChangeCount++;
 
-		mDP.freeBuffer();
+		if (mBuffer)
+		{
+			delete [] mBuffer;
+		}
 		mBuffer = new U8[dp.getBufferSize()];
+		mDataPtr = mBuffer;
 		mDP.assignBuffer(mBuffer, dp.getBufferSize());
 		mDP = dp;
+		mValidated = TRUE;
+		mDirty = TRUE;
+	}
+}
+
+BOOL LLVOCacheEntry::validate()
+{
+	if (!mValidated)
+	{
+		LLCRC crc;
+		crc.update(mDataPtr, mDP.getBufferSize());
+		if (crc.getCRC() != mChecksum)
+		{
+			return FALSE;
+		}
+		mValidated = TRUE;
 	}
+	return TRUE;
+}
+
+void LLVOCacheEntry::fillRecord(LLVOCacheRecord &record) const
+{
+	LLCRC crc;
+	crc.update(mDataPtr, mDP.getBufferSize());
+
+	record.mRegionHandle = mRegionHandle;
+	record.mType = LLVOCacheRecord::RECORD_ENTRY;
+	record.mSize = mDP.getBufferSize();
+	record.mLocalID = mLocalID;
+	record.mCRC = mCRC;
+	record.mChecksum = crc.getCRC();
+	record.mHitCount = mHitCount;
+	record.mDupeCount = mDupeCount;
+	record.mCRCChangeCount = mCRCChangeCount;
 }
 
 LLDataPackerBinaryBuffer *LLVOCacheEntry::getDP(U32 crc)
@@ -157,22 +215,645 @@ void LLVOCacheEntry::dump() const
 		<< llendl;
 }
 
-static inline void checkedWrite(LLFILE *fp, const void *data, size_t nbytes)
+//---------------------------------------------------------------------------
+// LLVOCache
+//---------------------------------------------------------------------------
+
+LLVOCache::LLVOCache()
+:	mInitialized(FALSE),
+	mReadOnly(TRUE),
+	mAppendable(FALSE),
+	mRemoved(FALSE),
+	mMaxSize(0),
+	mFileSize(0),
+	mStaleBytes(0),
+	mTotalBytes(0),
+	mNumEntries(0),
+	mMap(NULL),
+	mMapData(NULL)
+{
+	mCacheStart.append(mCacheEnd);
+}
+
+LLVOCache::~LLVOCache()
+{
+	// destroyClass() should have been called by now, this just makes
+	// sure nothing is left mapped.
+	closeCache();
+}
+
+void LLVOCache::initCache(const std::string& filename, U32 max_size, BOOL read_only)
+{
+	if (mInitialized)
+	{
+		llwarns << "Object cache already initialized" << llendl;
+		return;
+	}
+
+	mFilename = filename;
+	mMaxSize = max_size;
+	mReadOnly = read_only;
+	mAppendable = !read_only;
+	mRemoved = FALSE;
+	mInitialized = TRUE;
+
+	if (!openFile())
+	{
+		mAppendable = FALSE;
+		return;
+	}
+
+	LLTimer timer;
+	readCache();
+	llinfos << "Object cache: " << mNumEntries << " entries in " << mRegions.size()
+		<< " regions, " << mTotalBytes << " bytes (" << mStaleBytes << " stale) read in "
+		<< timer.getElapsedTimeF32() << " seconds" << llendl;
+}
+
+BOOL LLVOCache::openFile()
 {
-	if (fwrite(data, 1, nbytes, fp) != nbytes)
+	S32 file_size = 0;
+	apr_int32_t flags = mReadOnly ? LL_APR_RB : (LL_APR_RPB | APR_CREATE);
+	if (mFile.open(mFilename, flags, LLAPRFile::global, &file_size) != APR_SUCCESS)
+	{
+		// no file is normal for a read only instance
+		if (!mReadOnly)
+		{
+			llwarns << "Unable to open object cache " << mFilename << llendl;
+		}
+		return FALSE;
+	}
+
+	BOOL valid = FALSE;
+	if (file_size >= (S32)sizeof(LLVOCacheHeader))
+	{
+		LLVOCacheHeader header;
+		if (mFile.read(&header, sizeof(header)) == (S32)sizeof(header))
+		{
+			valid = (header.mZero == 0
+					 && header.mVersion == INDRA_OBJECT_CACHE_VERSION
+					 && header.mRecordSize == sizeof(LLVOCacheRecord));
+		}
+		if (!valid)
+		{
+			llinfos << "Object cache version changed, discarding" << llendl;
+		}
+	}
+
+	if (valid)
+	{
+		mFileSize = file_size;
+		return mapFile();
+	}
+
+	if (mReadOnly)
+	{
+		mFile.close();
+		return FALSE;
+	}
+
+	// start over with an empty store
+	mFile.close();
+	if (mFile.open(mFilename, LL_APR_WPB, LLAPRFile::global) != APR_SUCCESS)
+	{
+		llwarns << "Unable to create object cache " << mFilename << llendl;
+		return FALSE;
+	}
+	LLVOCacheHeader header;
+	header.mZero = 0;
+	header.mVersion = INDRA_OBJECT_CACHE_VERSION;
+	header.mRecordSize = sizeof(LLVOCacheRecord);
+	header.mPad = 0;
+	if (mFile.write(&header, sizeof(header)) != (S32)sizeof(header))
 	{
 		llwarns << "Short write" << llendl;
+		mFile.close();
+		return FALSE;
+	}
+	mFileSize = sizeof(header);
+	return TRUE;
+}
+
+BOOL LLVOCache::mapFile()
+{
+	mMapPool.create();
+	apr_status_t status = apr_mmap_create(&mMap, mFile.getFileHandle(), 0, mFileSize, APR_MMAP_READ, mMapPool());
+	void* addr = NULL;
+	if (status == APR_SUCCESS)
+	{
+		status = apr_mmap_offset(&addr, mMap, 0);
+	}
+	if (status != APR_SUCCESS)
+	{
+		ll_apr_warn_status(status);
+		llwarns << "Unable to map object cache " << mFilename << ", discarding" << llendl;
+		mMap = NULL;
+		mMapPool.destroy();
+		// Nothing was read, so writing a fresh store on shutdown is all we can do.
+		mFileSize = sizeof(LLVOCacheHeader);
+		mAppendable = FALSE;
+		return TRUE;
+	}
+	mMapData = (U8*)addr;
+	return TRUE;
+}
+
+void LLVOCache::readCache()
+{
+	if (!mMapData)
+	{
+		return;
+	}
+
+	S32 offset = sizeof(LLVOCacheHeader);
+	BOOL corrupt = FALSE;
+	while (offset < mFileSize)
+	{
+		if (offset + (S32)sizeof(LLVOCacheRecord) > mFileSize)
+		{
+			corrupt = TRUE;
+			break;
+		}
+
+		const LLVOCacheRecord* record = (const LLVOCacheRecord*)(mMapData + offset);
+		if (record->mSize > MAX_OBJECT_CACHE_ENTRY_SIZE
+			|| offset + record_size(record->mSize) > mFileSize)
+		{
+			corrupt = TRUE;
+			break;
+		}
+		U8* payload = mMapData + offset + sizeof(LLVOCacheRecord);
+
+		if (record->mType == LLVOCacheRecord::RECORD_REGION)
+		{
+			if (record->mSize != UUID_BYTES)
+			{
+				corrupt = TRUE;
+				break;
+			}
+			LLUUID cache_id;
+			memcpy(cache_id.mData, payload, UUID_BYTES);		/* Flawfinder: ignore */
+			LLVOCacheRegion& region = mRegions[record->mRegionHandle];
+			if (region.mCacheID != cache_id)
+			{
+				purgeRegion(region);
+				region.mCacheID = cache_id;
+			}
+		}
+		else if (record->mType == LLVOCacheRecord::RECORD_ENTRY)
+		{
+			if (record->mSize == 0 || record->mLocalID == 0)
+			{
+				corrupt = TRUE;
+				break;
+			}
+			LLVOCacheRegion& region = mRegions[record->mRegionHandle];
+			entry_map_t::iterator iter = region.mEntries.find(record->mLocalID);
+			if (iter != region.mEntries.end())
+			{
+				// superseded by this record
+				mStaleBytes += iter->second->getDiskSize();
+				iter->second->setDiskSize(0);
+				removeEntry(iter->second);
+			}
+			addEntry(region, new LLVOCacheEntry(*record, payload));
+		}
+		else if (record->mType == LLVOCacheRecord::RECORD_REMOVE)
+		{
+			mStaleBytes += record_size(0);
+			region_map_t::iterator region_iter = mRegions.find(record->mRegionHandle);
+			if (region_iter != mRegions.end())
+			{
+				entry_map_t& entries = region_iter->second.mEntries;
+				entry_map_t::iterator iter = entries.find(record->mLocalID);
+				if (iter != entries.end())
+				{
+					mStaleBytes += iter->second->getDiskSize();
+					iter->second->setDiskSize(0);
+					removeEntry(iter->second);
+				}
+			}
+		}
+		else
+		{
+			corrupt = TRUE;
+			break;
+		}
+		offset += record_size(record->mSize);
+	}
+
+	if (corrupt)
+	{
+		// Keep what we have. Appending after garbage would make the new
+		// records unreachable, so leave it all for the rewrite on shutdown.
+		llwarns << "Object cache " << mFilename << " is corrupt past offset " << offset << llendl;
+		mAppendable = FALSE;
+	}
+	mFileSize = offset;
+
+	evictEntries(NULL);
+}
+
+void LLVOCache::closeCache()
+{
+	for (LLVOCacheEntry* entry = mCacheStart.getNext(); entry && (entry != &mCacheEnd); )
+	{
+		LLVOCacheEntry* next = entry->getNext();
+		delete entry;
+		entry = next;
+	}
+	mRegions.clear();
+	mPendingRemovals.clear();
+	mNumEntries = 0;
+	mTotalBytes = 0;
+	mStaleBytes = 0;
+
+	if (mMap)
+	{
+		apr_mmap_delete(mMap);
+		mMap = NULL;
+		mMapData = NULL;
+		mMapPool.destroy();
+	}
+	mFile.close();
+	mInitialized = FALSE;
+}
+
+void LLVOCache::destroyClass()
+{
+	if (!mInitialized)
+	{
+		return;
+	}
+
+	if (!mReadOnly && !mRemoved)
+	{
+		LLTimer timer;
+		if (!mAppendable || mStaleBytes > mFileSize / 2)
+		{
+			S32 total_bytes = mTotalBytes;
+			if (writeCompacted())
+			{
+				// writeCompacted() already closed the store
+				llinfos << "Object cache compacted to " << total_bytes << " bytes in "
+					<< timer.getElapsedTimeF32() << " seconds" << llendl;
+				return;
+			}
+		}
+		writeRecords(0, TRUE);
+	}
+
+	closeCache();
+	if (mRemoved)
+	{
+		LLAPRFile::remove(mFilename);
+	}
+}
+
+void LLVOCache::removeCache()
+{
+	mRemoved = TRUE;
+	mAppendable = FALSE;
+}
+
+void LLVOCache::openRegion(U64 region_handle, const LLUUID& cache_id)
+{
+	LLVOCacheRegion& region = mRegions[region_handle];
+	if (region.mCacheID == cache_id && cache_id.notNull())
+	{
+		return;
+	}
+	if (!region.mEntries.empty())
+	{
+		llinfos << "Cache ID doesn't match for this region, discarding" << llendl;
+		purgeRegion(region);
+	}
+	region.mCacheID = cache_id;
+	region.mDirty = TRUE;
+}
+
+void LLVOCache::flushRegion(U64 region_handle)
+{
+	writeRecords(region_handle, FALSE);
+}
+
+LLVOCacheEntry* LLVOCache::getEntry(U64 region_handle, U32 local_id)
+{
+	region_map_t::iterator region_iter = mRegions.find(region_handle);
+	if (region_iter == mRegions.end())
+	{
+		return NULL;
+	}
+	entry_map_t::iterator iter = region_iter->second.mEntries.find(local_id);
+	if (iter == region_iter->second.mEntries.end())
+	{
+		return NULL;
+	}
+
+	LLVOCacheEntry* entry = iter->second;
+	if (!entry->validate())
+	{
+		llwarns << "Corrupt object cache entry " << local_id << ", discarding" << llendl;
+		removeEntry(entry);
+		return NULL;
+	}
+
+	// most recently used goes to the back
+	entry->unlink();
+	mCacheEnd.insert(*entry);
+	return entry;
+}
+
+void LLVOCache::updateEntry(U64 region_handle, U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp)
+{
+	if (dp.getBufferSize() <= 0 || dp.getBufferSize() > (S32)MAX_OBJECT_CACHE_ENTRY_SIZE)
+	{
+		return;
+	}
+
+	LLVOCacheRegion& region = mRegions[region_handle];
+	entry_map_t::iterator iter = region.mEntries.find(local_id);
+	LLVOCacheEntry* entry;
+	if (iter != region.mEntries.end())
+	{
+		// we've seen this object before
+		entry = iter->second;
+		if (entry->getCRC() == crc)
+		{
+			// Record a hit
+			entry->recordDupe();
+			return;
+		}
+
+		// Update the cache entry
+		mTotalBytes -= entry->getRecordSize();
+		entry->assignCRC(crc, dp);
+		mTotalBytes += entry->getRecordSize();
+		entry->unlink();
+		mCacheEnd.insert(*entry);
+	}
+	else
+	{
+		// we haven't seen this object before
+		entry = new LLVOCacheEntry(region_handle, local_id, crc, dp);
+		addEntry(region, entry);
+	}
+
+	evictEntries(entry);
+}
+
+void LLVOCache::addEntry(LLVOCacheRegion& region, LLVOCacheEntry* entry)
+{
+	region.mEntries[entry->getLocalID()] = entry;
+	mCacheEnd.insert(*entry);
+	mTotalBytes += entry->getRecordSize();
+	mNumEntries++;
+}
+
+void LLVOCache::removeEntry(LLVOCacheEntry* entry)
+{
+	region_map_t::iterator region_iter = mRegions.find(entry->getRegionHandle());
+	if (region_iter != mRegions.end())
+	{
+		region_iter->second.mEntries.erase(entry->getLocalID());
+	}
+	if (entry->getDiskSize())
+	{
+		// still in the file, it has to be removed there too
+		mPendingRemovals.push_back(std::make_pair(entry->getRegionHandle(), entry->getLocalID()));
+		mStaleBytes += entry->getDiskSize();
+	}
+	mTotalBytes -= entry->getRecordSize();
+	mNumEntries--;
+	delete entry;
+}
+
+void LLVOCache::purgeRegion(LLVOCacheRegion& region)
+{
+	// The region record written for the new cache id drops the old
+	// entries from the file, no removal records are needed.
+	for (entry_map_t::iterator iter = region.mEntries.begin(); iter != region.mEntries.end(); ++iter)
+	{
+		LLVOCacheEntry* entry = iter->second;
+		mStaleBytes += entry->getDiskSize();
+		mTotalBytes -= entry->getRecordSize();
+		mNumEntries--;
+		delete entry;
+	}
+	region.mEntries.clear();
+}
+
+void LLVOCache::evictEntries(LLVOCacheEntry* keep)
+{
+	while (mTotalBytes > (S32)mMaxSize)
+	{
+		LLVOCacheEntry* entry = mCacheStart.getNext();
+		if (!entry || entry == &mCacheEnd || entry == keep)
+		{
+			break;
+		}
+		removeEntry(entry);
+	}
+}
+
+void LLVOCache::writeRecords(U64 region_handle, BOOL all_regions)
+{
+	if (!mInitialized || !mAppendable)
+	{
+		return;
+	}
+
+	std::vector<U8> buffer;
+	LLVOCacheRecord record;
+	memset(&record, 0, sizeof(record));
+
+	// Removals go first so that they can't hide an entry written later on.
+	for (std::vector<std::pair<U64, U32> >::iterator iter = mPendingRemovals.begin();
+		 iter != mPendingRemovals.end(); ++iter)
+	{
+		record.mRegionHandle = iter->first;
+		record.mType = LLVOCacheRecord::RECORD_REMOVE;
+		record.mLocalID = iter->second;
+		const U8* rec = (const U8*)&record;
+		buffer.insert(buffer.end(), rec, rec + sizeof(record));
+		mStaleBytes += sizeof(record);
+	}
+
+	std::vector<LLVOCacheEntry*> written;
+	for (region_map_t::iterator region_iter = mRegions.begin(); region_iter != mRegions.end(); ++region_iter)
+	{
+		if (!all_regions && region_iter->first != region_handle)
+		{
+			continue;
+		}
+		LLVOCacheRegion& region = region_iter->second;
+		if (region.mDirty)
+		{
+			memset(&record, 0, sizeof(record));
+			record.mRegionHandle = region_iter->first;
+			record.mType = LLVOCacheRecord::RECORD_REGION;
+			record.mSize = UUID_BYTES;
+			const U8* rec = (const U8*)&record;
+			buffer.insert(buffer.end(), rec, rec + sizeof(record));
+			buffer.insert(buffer.end(), region.mCacheID.mData, region.mCacheID.mData + UUID_BYTES);
+			buffer.resize(padded_size(buffer.size()), 0);
+		}
+		for (entry_map_t::iterator iter = region.mEntries.begin(); iter != region.mEntries.end(); ++iter)
+		{
+			LLVOCacheEntry* entry = iter->second;
+			if (!entry->isDirty())
+			{
+				continue;
+			}
+			entry->fillRecord(record);
+			const U8* rec = (const U8*)&record;
+			buffer.insert(buffer.end(), rec, rec + sizeof(record));
+			buffer.insert(buffer.end(), entry->getData(), entry->getData() + entry->getSize());
+			buffer.resize(padded_size(buffer.size()), 0);
+			written.push_back(entry);
+		}
+	}
+
+	if (buffer.empty())
+	{
+		return;
+	}
+
+	if (mFile.seek(APR_SET, mFileSize) != mFileSize
+		|| mFile.write(&buffer[0], buffer.size()) != (S32)buffer.size())
+	{
+		llwarns << "Short write to object cache " << mFilename << llendl;
+		mAppendable = FALSE;
+		return;
+	}
+	mFileSize += buffer.size();
+
+	mPendingRemovals.clear();
+	for (region_map_t::iterator region_iter = mRegions.begin(); region_iter != mRegions.end(); ++region_iter)
+	{
+		if (all_regions || region_iter->first == region_handle)
+		{
+			region_iter->second.mDirty = FALSE;
+		}
+	}
+	for (std::vector<LLVOCacheEntry*>::iterator iter = written.begin(); iter != written.end(); ++iter)
+	{
+		LLVOCacheEntry* entry = *iter;
+		mStaleBytes += entry->getDiskSize();
+		entry->setDiskSize(entry->getRecordSize());
+		entry->setDirty(FALSE);
 	}
 }
 
-void LLVOCacheEntry::writeToFile(LLFILE *fp) const
+BOOL LLVOCache::writeCompacted()
 {
-	checkedWrite(fp, &mLocalID, sizeof(U32));
-	checkedWrite(fp, &mCRC, sizeof(U32));
-	checkedWrite(fp, &mHitCount, sizeof(S32));
-	checkedWrite(fp, &mDupeCount, sizeof(S32));
-	checkedWrite(fp, &mCRCChangeCount, sizeof(S32));
-	S32 size = mDP.getBufferSize();
-	checkedWrite(fp, &size, sizeof(S32));
-	checkedWrite(fp, mBuffer, size);
+	std::string temp_filename = mFilename + ".tmp";
+	LLAPRFile outfile;
+	if (outfile.open(temp_filename, LL_APR_WB, LLAPRFile::global) != APR_SUCCESS)
+	{
+		llwarns << "Unable to write object cache " << temp_filename << llendl;
+		return FALSE;
+	}
+
+	std::vector<U8> buffer;
+	buffer.reserve(sizeof(LLVOCacheHeader) + mTotalBytes + mRegions.size() * record_size(UUID_BYTES));
+
+	LLVOCacheHeader header;
+	header.mZero = 0;
+	header.mVersion = INDRA_OBJECT_CACHE_VERSION;
+	header.mRecordSize = sizeof(LLVOCacheRecord);
+	header.mPad = 0;
+	const U8* hdr = (const U8*)&header;
+	buffer.insert(buffer.end(), hdr, hdr + sizeof(header));
+
+	LLVOCacheRecord record;
+	for (region_map_t::iterator region_iter = mRegions.begin(); region_iter != mRegions.end(); ++region_iter)
+	{
+		if (region_iter->second.mEntries.empty())
+		{
+			continue;
+		}
+		memset(&record, 0, sizeof(record));
+		record.mRegionHandle = region_iter->first;
+		record.mType = LLVOCacheRecord::RECORD_REGION;
+		record.mSize = UUID_BYTES;
+		const U8* rec = (const U8*)&record;
+		buffer.insert(buffer.end(), rec, rec + sizeof(record));
+		const LLUUID& cache_id = region_iter->second.mCacheID;
+		buffer.insert(buffer.end(), cache_id.mData, cache_id.mData + UUID_BYTES);
+		buffer.resize(padded_size(buffer.size()), 0);
+	}
+
+	// Entries in LRU order, which is the order they are read back in.
+	for (LLVOCacheEntry* entry = mCacheStart.getNext(); entry && (entry != &mCacheEnd); entry = entry->getNext())
+	{
+		if (!entry->validate())
+		{
+			continue;
+		}
+		entry->fillRecord(record);
+		const U8* rec = (const U8*)&record;
+		buffer.insert(buffer.end(), rec, rec + sizeof(record));
+		buffer.insert(buffer.end(), entry->getData(), entry->getData() + entry->getSize());
+		buffer.resize(padded_size(buffer.size()), 0);
+	}
+
+	BOOL success = (outfile.write(&buffer[0], buffer.size()) == (S32)buffer.size());
+	outfile.close();
+	if (!success)
+	{
+		llwarns << "Short write to object cache " << temp_filename << llendl;
+		LLAPRFile::remove(temp_filename);
+		return FALSE;
+	}
+
+	// The entries point into the old mapping, drop them before replacing it.
+	closeCache();
+	LLAPRFile::remove(mFilename);
+	if (!LLAPRFile::rename(temp_filename, mFilename))
+	{
+		llwarns << "Unable to replace object cache " << mFilename << llendl;
+		LLAPRFile::remove(temp_filename);
+		return FALSE;
+	}
+	return TRUE;
+}
+
+void LLVOCache::dumpRegion(U64 region_handle)
+{
+	const S32 BINS = 4;
+	S32 hit_bin[BINS];
+	S32 change_bin[BINS];
+
+	S32 i;
+	for (i = 0; i < BINS; ++i)
+	{
+		hit_bin[i] = 0;
+		change_bin[i] = 0;
+	}
+
+	LLVOCacheRegion& region = mRegions[region_handle];
+	for (entry_map_t::iterator iter = region.mEntries.begin(); iter != region.mEntries.end(); ++iter)
+	{
+		LLVOCacheEntry* entry = iter->second;
+		S32 hits = entry->getHitCount();
+		S32 changes = entry->getCRCChangeCount();
+
+		hits = llclamp(hits, 0, BINS-1);
+		changes = llclamp(changes, 0, BINS-1);
+
+		hit_bin[hits]++;
+		change_bin[changes]++;
+	}
+
+	llinfos << "Count " << region.mEntries.size() << " of " << mNumEntries << " cached" << llendl;
+	for (i = 0; i < BINS; i++)
+	{
+		llinfos << "Hits " << i << " " << hit_bin[i] << llendl;
+	}
+	for (i = 0; i < BINS; i++)
+	{
+		llinfos << "Changes " << i << " " << change_bin[i] << llendl;
+	}
+	llinfos << "Total " << mTotalBytes << " bytes, stale " << mStaleBytes << " of " << mFileSize << " on disk" << llendl;
 }
@@ -36,7 +36,34 @@
 #include "lluuid.h"
 #include "lldatapacker.h"
 #include "lldlinked.h"
+#include "llapr.h"
+#include "aiaprpool.h"
+#include "llmemory.h"
 
+#include "apr_mmap.h"
+
+//---------------------------------------------------------------------------
+// On-disk record. The object cache is a single log of these, each followed
+// by mSize bytes of payload padded out to an 8 byte boundary.
+struct LLVOCacheRecord
+{
+	enum
+	{
+		RECORD_REGION = 1,		// payload is the region's cache id
+		RECORD_ENTRY = 2,		// payload is the object update data
+		RECORD_REMOVE = 3		// no payload, drops an earlier entry
+	};
+
+	U64		mRegionHandle;
+	U32		mType;
+	U32		mSize;
+	U32		mLocalID;
+	U32		mCRC;
+	U32		mChecksum;
+	S32		mHitCount;
+	S32		mDupeCount;
+	S32		mCRCChangeCount;
+};
 
 //---------------------------------------------------------------------------
 // Cache entries
@@ -45,31 +72,134 @@ class LLVOCacheEntry;
 class LLVOCacheEntry : public LLDLinked<LLVOCacheEntry>
 {
 public:
-	LLVOCacheEntry(U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
-	LLVOCacheEntry(LLFILE *fp);
+	LLVOCacheEntry(U64 region_handle, U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
+	// Entry whose payload lives in the cache store mapping. It is not
+	// checked against the record checksum until validate() is called.
+	LLVOCacheEntry(const LLVOCacheRecord &record, U8 *mapped_data);
 	LLVOCacheEntry();
 	~LLVOCacheEntry();
 
+	U64 getRegionHandle() const		{ return mRegionHandle; }
 	U32 getLocalID() const			{ return mLocalID; }
 	U32 getCRC() const				{ return mCRC; }
 	S32 getHitCount() const			{ return mHitCount; }
 	S32 getCRCChangeCount() const	{ return mCRCChangeCount; }
+	S32 getSize() const				{ return mDP.getBufferSize(); }
+
+	// Bytes this entry takes up in the store, record header included.
+	S32 getRecordSize() const;
+	// Size of the record last written for this entry, 0 if it has never been.
+	S32 getDiskSize() const			{ return mDiskSize; }
+	void setDiskSize(S32 size)		{ mDiskSize = size; }
+	BOOL isDirty() const			{ return mDirty; }
+	void setDirty(BOOL dirty)		{ mDirty = dirty; }
 
 	void dump() const;
-	void writeToFile(LLFILE *fp) const;
+	BOOL validate();
+	void fillRecord(LLVOCacheRecord &record) const;
+	const U8 *getData() const		{ return mDP.getBufferSize() ? mDataPtr : NULL; }
 	void assignCRC(U32 crc, LLDataPackerBinaryBuffer &dp);
 	LLDataPackerBinaryBuffer *getDP(U32 crc);
 	void recordHit();
 	void recordDupe() { mDupeCount++; }
 
 protected:
+	U64							mRegionHandle;
 	U32							mLocalID;
 	U32							mCRC;
 	S32							mHitCount;
 	S32							mDupeCount;
 	S32							mCRCChangeCount;
+	U32							mChecksum;
+	S32							mDiskSize;
+	BOOL						mValidated;
+	BOOL						mDirty;
 	LLDataPackerBinaryBuffer	mDP;
-	U8							*mBuffer;
+	U8							*mDataPtr;
+	U8							*mBuffer;	// owned copy, NULL while the data is mapped
+};
+
+//---------------------------------------------------------------------------
+// Object cache shared by all regions.
+//
+// The store is memory mapped when the viewer starts and only the record
+// headers are read at that point; payloads are checked the first time an
+// entry is used.  Changed entries are appended to the end of the store when
+// a region is left, and the whole file is only rewritten on shutdown once
+// enough of it has gone stale.  The total size is capped, the least recently
+// used entries being evicted first.
+class LLVOCache : public LLSingleton<LLVOCache>
+{
+public:
+	LLVOCache();
+	~LLVOCache();
+
+	void initCache(const std::string& filename, U32 max_size, BOOL read_only);
+	void destroyClass();
+
+	// Drop the store on disk. Entries stay usable for this session, but
+	// nothing is written back.
+	void removeCache();
+
+	// Called once the region handshake gave us the region's cache id.
+	// Entries stored under a different id are discarded.
+	void openRegion(U64 region_handle, const LLUUID& cache_id);
+	// Append whatever changed in this region since it was last written.
+	void flushRegion(U64 region_handle);
+
+	// Returns NULL on a miss, or if the stored data turned out to be corrupt.
+	LLVOCacheEntry* getEntry(U64 region_handle, U32 local_id);
+	void updateEntry(U64 region_handle, U32 local_id, U32 crc, LLDataPackerBinaryBuffer &dp);
+
+	void dumpRegion(U64 region_handle);
+
+	S32 getNumEntries() const		{ return mNumEntries; }
+	S32 getTotalBytes() const		{ return mTotalBytes; }
+	S32 getStaleBytes() const		{ return mStaleBytes; }
+
+private:
+	typedef std::map<U32, LLVOCacheEntry *> entry_map_t;
+	struct LLVOCacheRegion
+	{
+		LLVOCacheRegion() : mDirty(FALSE) {}
+		LLUUID		mCacheID;
+		BOOL		mDirty;
+		entry_map_t	mEntries;
+	};
+	typedef std::map<U64, LLVOCacheRegion> region_map_t;
+
+	BOOL openFile();
+	BOOL mapFile();
+	void readCache();
+	void closeCache();
+	void writeRecords(U64 region_handle, BOOL all_regions);
+	BOOL writeCompacted();
+	void addEntry(LLVOCacheRegion& region, LLVOCacheEntry* entry);
+	void removeEntry(LLVOCacheEntry* entry);
+	void purgeRegion(LLVOCacheRegion& region);
+	void evictEntries(LLVOCacheEntry* keep);
+
+	BOOL				mInitialized;
+	BOOL				mReadOnly;
+	BOOL				mAppendable;	// FALSE once the tail of the file can't be trusted
+	BOOL				mRemoved;
+	std::string			mFilename;
+	U32					mMaxSize;
+	S32					mFileSize;		// end of the last good record
+	S32					mStaleBytes;
+	S32					mTotalBytes;
+	S32					mNumEntries;
+
+	LLAPRFile			mFile;
+	AIAPRPool			mMapPool;
+	apr_mmap_t			*mMap;
+	U8					*mMapData;
+
+	region_map_t		mRegions;
+	// Least recently used first.
+	LLVOCacheEntry		mCacheStart;
+	LLVOCacheEntry		mCacheEnd;
+	std::vector<std::pair<U64, U32> >	mPendingRemovals;
 };
 
 #endif
@@ -204,15 +204,13 @@ S32 LLSkyTex::sCurrent = 0;
 
 
 LLSkyTex::LLSkyTex() :
-	mSkyData(NULL),
-	mSkyDirs(NULL)
+	mSkyData(NULL)
 {
 }
 
 void LLSkyTex::init()
 {
 	mSkyData = new LLColor4[sResolution * sResolution];
-	mSkyDirs = new LLVector3[sResolution * sResolution];
 
 	for (S32 i = 0; i < 2; ++i)
 	{
@@ -243,9 +241,6 @@ LLSkyTex::~LLSkyTex()
 {
 	delete[] mSkyData;
 	mSkyData = NULL;
-
-	delete[] mSkyDirs;
-	mSkyDirs = NULL;
 }
 
 
@@ -311,6 +306,8 @@ F32	LLHeavenBody::sInterpVal = 0;
 S32 LLVOSky::sResolution = LLSkyTex::getResolution();
 S32 LLVOSky::sTileResX = sResolution/NUM_TILES_X;
 S32 LLVOSky::sTileResY = sResolution/NUM_TILES_Y;
+std::vector<LLSkyCubeFaceThread*> LLVOSky::sSkyFaceThreads;
+std::set<LLVOSky*> LLVOSky::sPending;
 
 LLVOSky::LLVOSky(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 :	LLStaticViewerObject(id, pcode, regionp, TRUE),
@@ -323,6 +320,8 @@ LLVOSky::LLVOSky(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 	mWind(0.f),
 	mForceUpdate(FALSE),
 	mWorldScale(1.f),
+	mSkyFacesCached(FALSE),
+	mSkyTexelsDone(0),
 	mBumpSunDir(0.f, 0.f, 1.f)
 {
 	bool error = false;
@@ -361,6 +360,11 @@ LLVOSky::LLVOSky(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 	{
 		mFace[i] = NULL;
 	}
+	for (S32 side = 0; side < 6; side++)
+	{
+		mSkyFaceThreads[side] = NULL;
+		mSkyFaceHandles[side] = LLQueuedThread::nullHandle();
+	}
 	
 	mCameraPosAgent = gAgent.getCameraPositionAgent();
 	mAtmHeight = ATM_HEIGHT;
@@ -398,11 +402,45 @@ LLVOSky::~LLVOSky()
 	// This needs to be done for each texture
 
 	mCubeMap = NULL;
+
+	cancelSkyFaces();
+	for (sky_cube_cache_t::iterator iter = mSkyCubeCache.begin();
+		 iter != mSkyCubeCache.end(); ++iter)
+	{
+		for_each(iter->second.begin(), iter->second.end(), DeletePointer());
+	}
 }
 
 void LLVOSky::initClass()
 {
 	LLHaze::initClass();
+	updateThreads();
+}
+
+// static
+void LLVOSky::cleanupClass()
+{
+	// Sides on the threads are waited for, to go in at the end of the cycle.
+	while (!sPending.empty())
+	{
+		(*sPending.begin())->collectSkyFaces();
+	}
+	for_each(sSkyFaceThreads.begin(), sSkyFaceThreads.end(), DeletePointer());
+	sSkyFaceThreads.clear();
+}
+
+// static
+void LLVOSky::updateThreads()
+{
+	cleanupClass();
+	if (gSavedSettings.getBOOL("SkyCubeMapOnThreads"))
+	{
+		S32 num_threads = llmax(gSavedSettings.getS32("SkyCubeMapThreads"), 1);
+		for (S32 i = 0; i < num_threads; i++)
+		{
+			sSkyFaceThreads.push_back(new LLSkyCubeFaceThread());
+		}
+	}
 }
 
 
@@ -414,15 +452,8 @@ void LLVOSky::init()
 
 	calcAtmospherics();
 
-	// Initialize the cached normalized direction vectors
-	for (S32 side = 0; side < 6; ++side)
-	{
-		for (S32 tile = 0; tile < NUM_TILES; ++tile)
-		{
-			initSkyTextureDirs(side, tile);
-			createSkyTexture(side, tile);
-		}
-	}
+	startSkyFaces();
+	finishSkyFaces();
 
 	for (S32 i = 0; i < 6; ++i)
 	{
@@ -511,57 +542,6 @@ void LLVOSky::restoreGL()
 
 }
 
-void LLVOSky::initSkyTextureDirs(const S32 side, const S32 tile)
-{
-	S32 tile_x = tile % NUM_TILES_X;
-	S32 tile_y = tile / NUM_TILES_X;
-
-	S32 tile_x_pos = tile_x * sTileResX;
-	S32 tile_y_pos = tile_y * sTileResY;
-
-	F32 coeff[3] = {0, 0, 0};
-	const S32 curr_coef = side >> 1; // 0/1 = Z axis, 2/3 = Y, 4/5 = X
-	const S32 side_dir = (((side & 1) << 1) - 1);  // even = -1, odd = 1
-	const S32 x_coef = (curr_coef + 1) % 3;
-	const S32 y_coef = (x_coef + 1) % 3;
-
-	coeff[curr_coef] = (F32)side_dir;
-
-	F32 inv_res = 1.f/sResolution;
-	S32 x, y;
-	for (y = tile_y_pos; y < (tile_y_pos + sTileResY); ++y)
-	{
-		for (x = tile_x_pos; x < (tile_x_pos + sTileResX); ++x)
-		{
-			coeff[x_coef] = F32((x<<1) + 1) * inv_res - 1.f;
-			coeff[y_coef] = F32((y<<1) + 1) * inv_res - 1.f;
-			LLVector3 dir(coeff[0], coeff[1], coeff[2]);
-			dir.normalize();
-			mSkyTex[side].setDir(dir, x, y);
-			mShinyTex[side].setDir(dir, x, y);
-		}
-	}
-}
-
-void LLVOSky::createSkyTexture(const S32 side, const S32 tile)
-{
-	S32 tile_x = tile % NUM_TILES_X;
-	S32 tile_y = tile / NUM_TILES_X;
-
-	S32 tile_x_pos = tile_x * sTileResX;
-	S32 tile_y_pos = tile_y * sTileResY;
-
-	S32 x, y;
-	for (y = tile_y_pos; y < (tile_y_pos + sTileResY); ++y)
-	{
-		for (x = tile_x_pos; x < (tile_x_pos + sTileResX); ++x)
-		{
-			mSkyTex[side].setPixel(calcSkyColorInDir(mSkyTex[side].getDir(x, y)), x, y);
-			mShinyTex[side].setPixel(calcSkyColorInDir(mSkyTex[side].getDir(x, y), true), x, y);
-		}
-	}
-}
-
 static inline LLColor3 componentDiv(LLColor3 const &left, LLColor3 const & right)
 {
 	return LLColor3(left.mV[0]/right.mV[0],
@@ -592,21 +572,6 @@ static inline LLColor3 componentPow(LLColor3 const &v, F32 exponent)
 					pow(v.mV[2], exponent));
 }
 
-static inline LLColor3 componentSaturate(LLColor3 const &v)
-{
-	return LLColor3(std::max(std::min(v.mV[0], 1.f), 0.f),
-					 std::max(std::min(v.mV[1], 1.f), 0.f),
-					 std::max(std::min(v.mV[2], 1.f), 0.f));
-}
-
-
-static inline LLColor3 componentSqrt(LLColor3 const &v)
-{
-	return LLColor3(sqrt(v.mV[0]),
-					 sqrt(v.mV[1]),
-					 sqrt(v.mV[2]));
-}
-
 static inline void componentMultBy(LLColor3 & left, LLColor3 const & right)
 {
 	left.mV[0] *= right.mV[0];
@@ -614,11 +579,6 @@ static inline void componentMultBy(LLColor3 & left, LLColor3 const & right)
 	left.mV[2] *= right.mV[2];
 }
 
-static inline LLColor3 colorMix(LLColor3 const & left, LLColor3 const & right, F32 amount)
-{
-	return (left + ((right - left) * amount));
-}
-
 static inline F32 texture2D(LLPointer<LLImageRaw> const & tex, LLVector2 const & uv)
 {
 	U16 w = tex->getWidth();
@@ -678,255 +638,31 @@ void LLVOSky::initAtmospherics(void)
 	
 }
 
-LLColor4 LLVOSky::calcSkyColorInDir(const LLVector3 &dir, bool isShiny)
+LLSkyAtmosphere::Params LLVOSky::getAtmosphereParams() const
 {
-	F32 saturation = 0.3f;
-	if (dir.mV[VZ] < -0.02f)
-	{
-		LLColor4 col = LLColor4(llmax(mFogColor[0],0.2f), llmax(mFogColor[1],0.2f), llmax(mFogColor[2],0.22f),0.f);
-		if (isShiny)
-		{
-			LLColor3 desat_fog = LLColor3(mFogColor);
-			F32 brightness = desat_fog.brightness();
-			// So that shiny somewhat shows up at night.
-			if (brightness < 0.15f)
-			{
-				brightness = 0.15f;
-				desat_fog = smear(0.15f);
-			}
-			LLColor3 greyscale = smear(brightness);
-			desat_fog = desat_fog * saturation + greyscale * (1.0f - saturation);
-			if (!gPipeline.canUseWindLightShaders())
-			{
-				col = LLColor4(desat_fog, 0.f);
-			}
-			else 
-			{
-				col = LLColor4(desat_fog * 0.5f, 0.f);
-			}
-		}
-		float x = 1.0f-fabsf(-0.1f-dir.mV[VZ]);
-		x *= x;
-		col.mV[0] *= x*x;
-		col.mV[1] *= powf(x, 2.5f);
-		col.mV[2] *= x*x*x;
-		return col;
-	}
-
-	// undo OGL_TO_CFR_ROTATION and negate vertical direction.
-	LLVector3 Pn = LLVector3(-dir[1] , -dir[2], -dir[0]);
-
-	LLColor3 vary_HazeColor(0,0,0);
-	LLColor3 vary_CloudColorSun(0,0,0);
-	LLColor3 vary_CloudColorAmbient(0,0,0);
-	F32 vary_CloudDensity(0);
-	LLVector2 vary_HorizontalProjection[2];
-	vary_HorizontalProjection[0] = LLVector2(0,0);
-	vary_HorizontalProjection[1] = LLVector2(0,0);
-
-	calcSkyColorWLVert(Pn, vary_HazeColor, vary_CloudColorSun, vary_CloudColorAmbient,
-						vary_CloudDensity, vary_HorizontalProjection);
-	
-	LLColor3 sky_color =  calcSkyColorWLFrag(Pn, vary_HazeColor, vary_CloudColorSun, vary_CloudColorAmbient, 
-								vary_CloudDensity, vary_HorizontalProjection);
-	if (isShiny)
-	{
-		F32 brightness = sky_color.brightness();
-		LLColor3 greyscale = smear(brightness);
-		sky_color = sky_color * saturation + greyscale * (1.0f - saturation);
-		sky_color *= (0.5f + 0.5f * brightness);
-	}
-	return LLColor4(sky_color, 0.0f);
-}
-
-// turn on floating point precision
-// in vs2003 for this function.  Otherwise
-// sky is aliased looking 7:10 - 8:50
-#if LL_MSVC && __MSVC_VER__ < 8
-#pragma optimize("p", on)
-#endif
-
-void LLVOSky::calcSkyColorWLVert(LLVector3 & Pn, LLColor3 & vary_HazeColor, LLColor3 & vary_CloudColorSun, 
-							LLColor3 & vary_CloudColorAmbient, F32 & vary_CloudDensity, 
-							LLVector2 vary_HorizontalProjection[2])
-{
-	// project the direction ray onto the sky dome.
-	F32 phi = acos(Pn[1]);
-	F32 sinA = sin(F_PI - phi);
-	F32 Plen = dome_radius * sin(F_PI + phi + asin(dome_offset_ratio * sinA)) / sinA;
-
-	Pn *= Plen;
-
-	vary_HorizontalProjection[0] = LLVector2(Pn[0], Pn[2]);
-	vary_HorizontalProjection[0] /= - 2.f * Plen;
-
-	// Set altitude
-	if (Pn[1] > 0.f)
-	{
-		Pn *= (max_y / Pn[1]);
-	}
-	else
-	{
-		Pn *= (-32000.f / Pn[1]);
-	}
-
-	Plen = Pn.length();
-	Pn /= Plen;
-
-	// Initialize temp variables
-	LLColor3 sunlight = sunlight_color;
-
-	// Sunlight attenuation effect (hue and brightness) due to atmosphere
-	// this is used later for sunlight modulation at various altitudes
-	LLColor3 light_atten =
-		(blue_density * 1.0 + smear(haze_density * 0.25f)) * (density_multiplier * max_y);
-
-	// Calculate relative weights
-	LLColor3 temp2(0.f, 0.f, 0.f);
-	LLColor3 temp1 = blue_density + smear(haze_density);
-	LLColor3 blue_weight = componentDiv(blue_density, temp1);
-	LLColor3 haze_weight = componentDiv(smear(haze_density), temp1);
-
-	// Compute sunlight from P & lightnorm (for long rays like sky)
-	temp2.mV[1] = llmax(F_APPROXIMATELY_ZERO, llmax(0.f, Pn[1]) * 1.0f + lightnorm[1] );
-
-	temp2.mV[1] = 1.f / temp2.mV[1];
-	componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
-
-	// Distance
-	temp2.mV[2] = Plen * density_multiplier;
-
-	// Transparency (-> temp1)
-	temp1 = componentExp((temp1 * -1.f) * temp2.mV[2]);
-
-
-	// Compute haze glow
-	temp2.mV[0] = Pn * LLVector3(lightnorm);
-
-	temp2.mV[0] = 1.f - temp2.mV[0];
-		// temp2.x is 0 at the sun and increases away from sun
-	temp2.mV[0] = llmax(temp2.mV[0], .001f);	
-		// Set a minimum "angle" (smaller glow.y allows tighter, brighter hotspot)
-	temp2.mV[0] *= glow.mV[0];
-		// Higher glow.x gives dimmer glow (because next step is 1 / "angle")
-	temp2.mV[0] = pow(temp2.mV[0], glow.mV[2]);
-		// glow.z should be negative, so we're doing a sort of (1 / "angle") function
-
-	// Add "minimum anti-solar illumination"
-	temp2.mV[0] += .25f;
-
-
-	// Haze color above cloud
-	vary_HazeColor = (blue_horizon * blue_weight * (sunlight + ambient)
-				+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + ambient)
-			 );	
-
-	// Increase ambient when there are more clouds
-	LLColor3 tmpAmbient = ambient + (LLColor3::white - ambient) * cloud_shadow * 0.5f;
-
-	// Dim sunlight by cloud shadow percentage
-	sunlight *= (1.f - cloud_shadow);
-
-	// Haze color below cloud
-	LLColor3 additiveColorBelowCloud = (blue_horizon * blue_weight * (sunlight + tmpAmbient)
-				+ componentMult(haze_horizon.mV[0] * haze_weight, sunlight * temp2.mV[0] + tmpAmbient)
-			 );	
-
-	// Final atmosphere additive
-	componentMultBy(vary_HazeColor, LLColor3::white - temp1);
-
-	sunlight = sunlight_color;
-	temp2.mV[1] = llmax(0.f, lightnorm[1] * 2.f);
-	temp2.mV[1] = 1.f / temp2.mV[1];
-	componentMultBy(sunlight, componentExp((light_atten * -1.f) * temp2.mV[1]));
-
-	// Attenuate cloud color by atmosphere
-	temp1 = componentSqrt(temp1);	//less atmos opacity (more transparency) below clouds
-
-	// At horizon, blend high altitude sky color towards the darker color below the clouds
-	vary_HazeColor +=
-		componentMult(additiveColorBelowCloud - vary_HazeColor, LLColor3::white - componentSqrt(temp1));
-		
-	if (Pn[1] < 0.f)
-	{
-		// Eric's original: 
-		// LLColor3 dark_brown(0.143f, 0.129f, 0.114f);
-		LLColor3 dark_brown(0.082f, 0.076f, 0.066f);
-		LLColor3 brown(0.430f, 0.386f, 0.322f);
-		LLColor3 sky_lighting = sunlight + ambient;
-		F32 haze_brightness = vary_HazeColor.brightness();
-
-		if (Pn[1] < -0.05f)
-		{
-			vary_HazeColor = colorMix(dark_brown, brown, -Pn[1] * 0.9f) * sky_lighting * haze_brightness;
-		}
-		
-		if (Pn[1] > -0.1f)
-		{
-			vary_HazeColor = colorMix(LLColor3::white * haze_brightness, vary_HazeColor, fabs((Pn[1] + 0.05f) * -20.f));
-		}
-	}
+	LLSkyAtmosphere::Params params;
+	params.mDomeRadius = dome_radius;
+	params.mDomeOffsetRatio = dome_offset_ratio;
+	params.mSunlightColor = sunlight_color;
+	params.mAmbient = ambient;
+	params.mBlueDensity = blue_density;
+	params.mBlueHorizon = blue_horizon;
+	params.mHazeDensity = haze_density;
+	params.mHazeHorizon = haze_horizon;
+	params.mDensityMultiplier = density_multiplier;
+	params.mMaxY = max_y;
+	params.mGlow = glow;
+	params.mCloudShadow = cloud_shadow;
+	params.mLightNorm = lightnorm;
+	params.mFogColor = mFogColor;
+	params.mWindLightShaders = gPipeline.canUseWindLightShaders();
+	return params;
 }
 
-#if LL_MSVC && __MSVC_VER__ < 8
-#pragma optimize("p", off)
-#endif
-
-LLColor3 LLVOSky::calcSkyColorWLFrag(LLVector3 & Pn, LLColor3 & vary_HazeColor, LLColor3 & vary_CloudColorSun, 
-							LLColor3 & vary_CloudColorAmbient, F32 & vary_CloudDensity, 
-							LLVector2 vary_HorizontalProjection[2])
+LLColor4 LLVOSky::calcSkyColorInDir(const LLVector3 &dir, bool isShiny)
 {
-	LLColor3 res;
-
-	LLColor3 color0 = vary_HazeColor;
-	
-	if (!gPipeline.canUseWindLightShaders())
-	{
-		LLColor3 color1 = color0 * 2.0f;
-		color1 = smear(1.f) - componentSaturate(color1);
-		componentPow(color1, gamma);
-		res = smear(1.f) - color1;
-	} 
-	else 
-	{
-		res = color0;
-	}
-
-#	ifndef LL_RELEASE_FOR_DOWNLOAD
-
-	LLColor3 color2 = 2.f * color0;
-
-	LLColor3 color3 = LLColor3(1.f, 1.f, 1.f) - componentSaturate(color2);
-	componentPow(color3, gamma);
-	color3 = LLColor3(1.f, 1.f, 1.f) - color3;
-
-	static enum {
-		OUT_DEFAULT		= 0,
-		OUT_SKY_BLUE	= 1,
-		OUT_RED			= 2,
-		OUT_PN			= 3,
-		OUT_HAZE		= 4,
-	} debugOut = OUT_DEFAULT;
-
-	switch(debugOut) 
-	{
-		case OUT_DEFAULT:
-			break;
-		case OUT_SKY_BLUE:
-			res = LLColor3(0.4f, 0.4f, 0.9f);
-			break;
-		case OUT_RED:
-			res = LLColor3(1.f, 0.f, 0.f);
-			break;
-		case OUT_PN:
-			res = LLColor3(Pn[0], Pn[1], Pn[2]);
-			break;
-		case OUT_HAZE:
-			res = vary_HazeColor;
-			break;
-	}
-#	endif // LL_RELEASE_FOR_DOWNLOAD
-	return res;
+	LLSkyAtmosphere atmosphere(getAtmosphereParams());
+	return atmosphere.calcColor(dir, isShiny);
 }
 
 LLColor3 LLVOSky::createDiffuseFromWL(LLColor3 diffuse, LLColor3 ambient, LLColor3 sundiffuse, LLColor3 sunambient)
@@ -1116,13 +852,8 @@ BOOL LLVOSky::updateSky()
                     if (mForceUpdate)
 					{
 						updateFog(LLViewerCamera::getInstance()->getFar());
-						for (int side = 0; side < 6; side++) 
-						{
-							for (int tile = 0; tile < NUM_TILES; tile++) 
-							{
-								createSkyTexture(side, tile);
-							}
-						}
+						startSkyFaces();
+						finishSkyFaces();
 
 						calcAtmospherics();
 
@@ -1146,6 +877,8 @@ BOOL LLVOSky::updateSky()
 			/// *TODO really, sky texture and env map should be shared on a single texture
 			/// I'll let Brad take this at some point
 
+			finishSkyFaces();
+
 			// update the sky texture
 			for (S32 i = 0; i < 6; ++i)
 			{
@@ -1174,9 +907,12 @@ BOOL LLVOSky::updateSky()
 		}
 		else
 		{
-			const S32 side = frame / NUM_TILES;
-			const S32 tile = frame % NUM_TILES;
-			createSkyTexture(side, tile);
+			if (frame == 0)
+			{
+				startSkyFaces();
+			}
+			// A tile's worth of texels a frame.
+			calcSkyFaces((frame + 1) * sTileResX * sTileResY);
 		}
 	}
 
@@ -1187,6 +923,151 @@ BOOL LLVOSky::updateSky()
 	return TRUE;
 }
 
+void LLVOSky::startSkyFaces()
+{
+	cancelSkyFaces();
+
+	LLSkyAtmosphere::Params params = getAtmosphereParams();
+	mSkyFacesKey = LLSkyAtmosphere::getKey(params);
+	for (sky_cube_cache_t::iterator iter = mSkyCubeCache.begin();
+		 iter != mSkyCubeCache.end(); ++iter)
+	{
+		if (iter->first == mSkyFacesKey)
+		{
+			mSkyCubeCache.splice(mSkyCubeCache.begin(), mSkyCubeCache, iter);
+			mSkyFaces = mSkyCubeCache.front().second;
+			mSkyFacesCached = TRUE;
+			mSkyTexelsDone = 6 * sResolution * sResolution;
+			return;
+		}
+	}
+
+	for (S32 side = 0; side < 6; side++)
+	{
+		LLSkyCubeFace* face = new LLSkyCubeFace(params, side, sResolution);
+		if (sSkyFaceThreads.empty())
+		{
+			mSkyFaces.push_back(face);
+			continue;
+		}
+		// A side to a thread, round the threads.
+		sky_cube_face_vec_t batch(1, face);
+		mSkyFaceThreads[side] = sSkyFaceThreads[side % sSkyFaceThreads.size()];
+		mSkyFaceHandles[side] = mSkyFaceThreads[side]->calculate(batch);
+		mSkyFaces.push_back(NULL);
+	}
+	if (!sSkyFaceThreads.empty())
+	{
+		mSkyTexelsDone = 6 * sResolution * sResolution;
+		sPending.insert(this);
+	}
+}
+
+void LLVOSky::calcSkyFaces(const S32 texels)
+{
+	if (mSkyFaces.empty())
+	{
+		return;
+	}
+	const S32 side_texels = sResolution * sResolution;
+	while (mSkyTexelsDone < texels)
+	{
+		const S32 side = mSkyTexelsDone / side_texels;
+		const S32 begin = mSkyTexelsDone % side_texels;
+		const S32 end = llmin(side_texels, begin + texels - mSkyTexelsDone);
+		mSkyFaces[side]->calculate(begin, end);
+		mSkyTexelsDone += end - begin;
+	}
+}
+
+void LLVOSky::finishSkyFaces()
+{
+	if (mSkyFaces.empty())
+	{
+		return;
+	}
+	collectSkyFaces();
+	calcSkyFaces(6 * sResolution * sResolution);
+
+	for (S32 side = 0; side < 6; side++)
+	{
+		mSkyTex[side].setPixels(mSkyFaces[side]->getSky());
+		mShinyTex[side].setPixels(mSkyFaces[side]->getShiny());
+	}
+
+	if (!mSkyFacesCached)
+	{
+		mSkyCubeCache.push_front(std::make_pair(mSkyFacesKey, mSkyFaces));
+		S32 cache_size = llmax(gSavedSettings.getS32("SkyCubeMapCacheSize"), 0);
+		while ((S32)mSkyCubeCache.size() > cache_size)
+		{
+			for_each(mSkyCubeCache.back().second.begin(), mSkyCubeCache.back().second.end(), DeletePointer());
+			mSkyCubeCache.pop_back();
+		}
+	}
+	mSkyFaces.clear();
+	mSkyFacesCached = FALSE;
+	mSkyTexelsDone = 0;
+}
+
+void LLVOSky::collectSkyFaces()
+{
+	for (S32 side = 0; side < 6; side++)
+	{
+		if (!mSkyFaceThreads[side])
+		{
+			continue;
+		}
+		sky_cube_face_vec_t batch;
+		while (!mSkyFaceThreads[side]->getResult(mSkyFaceHandles[side], batch))
+		{
+			mSkyFaceThreads[side]->update(0);
+			ms_sleep(1);
+		}
+		llassert(batch.size() == 1);
+		mSkyFaces[side] = batch[0];
+		mSkyFaceThreads[side] = NULL;
+		mSkyFaceHandles[side] = LLQueuedThread::nullHandle();
+	}
+	sPending.erase(this);
+}
+
+void LLVOSky::cancelSkyFaces()
+{
+	for (S32 side = 0; side < 6; side++)
+	{
+		if (mSkyFaceThreads[side])
+		{
+			mSkyFaceThreads[side]->abortRequest(mSkyFaceHandles[side], false);
+		}
+	}
+	for (S32 side = 0; side < 6; side++)
+	{
+		if (!mSkyFaceThreads[side])
+		{
+			continue;
+		}
+		sky_cube_face_vec_t batch;
+		while (!mSkyFaceThreads[side]->getResult(mSkyFaceHandles[side], batch))
+		{
+			mSkyFaceThreads[side]->update(0);
+			ms_sleep(1);
+		}
+		for_each(batch.begin(), batch.end(), DeletePointer());
+		mSkyFaceThreads[side] = NULL;
+		mSkyFaceHandles[side] = LLQueuedThread::nullHandle();
+	}
+	sPending.erase(this);
+
+	if (!mSkyFacesCached)
+	{
+		for_each(mSkyFaces.begin(), mSkyFaces.end(), DeletePointer());
+	}
+	mSkyFaces.clear();
+	mSkyFacesCached = FALSE;
+	mSkyTexelsDone = 0;
+}
+
 void LLVOSky::updateTextures()
 {
 	if (mSunTexturep)
@@ -33,9 +33,13 @@
 #ifndef LL_LLVOSKY_H
 #define LL_LLVOSKY_H
 
+#include <list>
+#include <set>
+
 #include "stdtypes.h"
 #include "v3color.h"
 #include "v4coloru.h"
+#include "llskyatmosphere.h"
 #include "llviewerimage.h"
 #include "llviewerobject.h"
 #include "llframetimer.h"
@@ -125,7 +129,6 @@ private:
 	LLPointer<LLImageGL> mImageGL[2];
 	LLPointer<LLImageRaw> mImageRaw[2];
 	LLColor4		*mSkyData;
-	LLVector3		*mSkyDirs;			// Cache of sky direction vectors
 	static S32		sCurrent;
 	static F32		sInterpVal;
 
@@ -155,22 +158,16 @@ protected:
 	
 	void create(F32 brightness);
 
-	void setDir(const LLVector3 &dir, const S32 i, const S32 j)
-	{
-		S32 offset = i * sResolution + j;
-		mSkyDirs[offset] = dir;
-	}
-
-	const LLVector3 &getDir(const S32 i, const S32 j) const
+	void setPixel(const LLColor4 &col, const S32 i, const S32 j)
 	{
 		S32 offset = i * sResolution + j;
-		return mSkyDirs[offset];
+		mSkyData[offset] = col;
 	}
 
-	void setPixel(const LLColor4 &col, const S32 i, const S32 j)
+	// All of them, from an LLSkyCubeFace.
+	void setPixels(const LLColor4 *cols)
 	{
-		S32 offset = i * sResolution + j;
-		mSkyData[offset] = col;
+		memcpy(mSkyData, cols, sResolution * sResolution * sizeof(LLColor4));
 	}
 
 	void setPixel(const LLColor4U &col, const S32 i, const S32 j)
@@ -452,13 +449,8 @@ public:
 	LLColor3 createDiffuseFromWL(LLColor3 diffuse, LLColor3 ambient, LLColor3 sundiffuse, LLColor3 sunambient);
 	LLColor3 createAmbientFromWL(LLColor3 ambient, LLColor3 sundiffuse, LLColor3 sunambient);
 
-	void calcSkyColorWLVert(LLVector3 & Pn, LLColor3 & vary_HazeColor, LLColor3 & vary_CloudColorSun, 
-							LLColor3 & vary_CloudColorAmbient, F32 & vary_CloudDensity, 
-							LLVector2 vary_HorizontalProjection[2]);
-
-	LLColor3 calcSkyColorWLFrag(LLVector3 & Pn, LLColor3 & vary_HazeColor,	LLColor3 & vary_CloudColorSun, 
-							LLColor3 & vary_CloudColorAmbient, F32 & vary_CloudDensity, 
-							LLVector2 vary_HorizontalProjection[2]);
+	// The settings above, with the fog color, for working out sky colors.
+	LLSkyAtmosphere::Params getAtmosphereParams() const;
 
 public:
 	enum
@@ -481,6 +473,10 @@ public:
 
 	// Initialize/delete data that's only inited once per class.
 	static void initClass();
+	static void cleanupClass();
+	// Starts or stops the sky cube map threads, from the SkyCubeMapOnThreads
+	// and SkyCubeMapThreads settings.
+	static void updateThreads();
 	void init();
 	void initCubeMap();
 	void initEmpty();
@@ -497,9 +493,6 @@ public:
 	/*virtual*/ LLDrawable* createDrawable(LLPipeline *pipeline);
 	/*virtual*/ BOOL		updateGeometry(LLDrawable *drawable);
 
-	void initSkyTextureDirs(const S32 side, const S32 tile);
-	void createSkyTexture(const S32 side, const S32 tile);
-
 	LLColor4 calcSkyColorInDir(const LLVector3& dir, bool isShiny = false);
 	
 	LLColor3 calcRadianceAtPoint(const LLVector3& pos) const
@@ -580,6 +573,20 @@ public:
 protected:
 	~LLVOSky();
 
+	// The sky and shiny textures are worked out a cycle at a time, from
+	// the settings at the start of it: from the cache if the sky looked
+	// the same lately, otherwise on the sky cube map threads, or a piece a
+	// frame if there are none.
+	void startSkyFaces();
+	// On this thread, works out the texels of all sides up to texels.
+	void calcSkyFaces(const S32 texels);
+	// Waits for the rest and puts them in the textures.
+	void finishSkyFaces();
+	// Waits for the sides on the threads.
+	void collectSkyFaces();
+	// Drops the cycle.
+	void cancelSkyFaces();
+
 	LLPointer<LLViewerImage> mSunTexturep;
 	LLPointer<LLViewerImage> mMoonTexturep;
 	LLPointer<LLViewerImage> mBloomTexturep;
@@ -634,6 +641,20 @@ protected:
 
 	LLFrameTimer		mUpdateTimer;
 
+	LLSkyAtmosphere::key_t	mSkyFacesKey;
+	sky_cube_face_vec_t		mSkyFaces;				// of the cycle, by side
+	BOOL					mSkyFacesCached;		// in mSkyCubeCache, so not ours
+	S32						mSkyTexelsDone;			// worked out on this thread
+	LLSkyCubeFaceThread*	mSkyFaceThreads[6];		// working out each side, if any
+	LLQueuedThread::handle_t mSkyFaceHandles[6];
+
+	// Most recently used first.
+	typedef std::list<std::pair<LLSkyAtmosphere::key_t, sky_cube_face_vec_t> > sky_cube_cache_t;
+	sky_cube_cache_t		mSkyCubeCache;
+
+	static std::vector<LLSkyCubeFaceThread*> sSkyFaceThreads;
+	static std::set<LLVOSky*> sPending;				// Skies with sides on the threads
+
 public:
 	//by bao
 	//fake vertex buffer updating
@@ -42,6 +42,7 @@
 #include "llmaterialtable.h"
 #include "llprimitive.h"
 #include "llvolume.h"
+#include "llvolumegen.h"
 #include "llvolumemgr.h"
 #include "llvolumemessage.h"
 #include "material_codes.h"
@@ -83,6 +84,7 @@ F32 LLVOVolume::sLODFactor = 1.f;
 F32	LLVOVolume::sLODSlopDistanceFactor = 0.5f; //Changing this to zero, effectively disables the LOD transition slop 
 F32 LLVOVolume::sDistanceFactor = 1.0f;
 S32 LLVOVolume::sNumLODChanges = 0;
+LLVolumeGenPool* LLVOVolume::sVolumeGenPool = NULL;
 
 LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 	: LLViewerObject(id, pcode, regionp),
@@ -97,6 +99,7 @@ LLVOVolume::LLVOVolume(const LLUUID &id, const LLPCode pcode, LLViewerRegion *re
 	mVObjRadius = LLVector3(1,1,0.5f).length();
 	mNumFaces = 0;
 	mLODChanged = FALSE;
+	mLODPending = FALSE;
 	mSculptChanged = FALSE;
 	mIndexInTex = 0;
 }
@@ -113,6 +116,17 @@ LLVOVolume::~LLVOVolume()
 // static
 void LLVOVolume::initClass()
 {
+	if (!sVolumeGenPool && gSavedSettings.getBOOL("AsyncVolumeGeneration"))
+	{
+		sVolumeGenPool = new LLVolumeGenPool(gSavedSettings.getS32("AsyncVolumeGenerationThreads"));
+	}
+}
+
+// static
+void LLVOVolume::cleanupClass()
+{
+	delete sVolumeGenPool;
+	sVolumeGenPool = NULL;
 }
 
 
@@ -219,9 +233,7 @@ U32 LLVOVolume::processUpdateMessage(LLMessageSystem *mesgsys,
 				// Well, crap, there's something bogus in the data that we're unpacking.
 				dp->dumpBufferToLog();
 				llwarns << "Flushing cache files" << llendl;
-				std::string mask;
-				mask = gDirUtilp->getDirDelimiter() + "*.slc";
-				gDirUtilp->deleteFilesInDir(gDirUtilp->getExpandedFilename(LL_PATH_CACHE,""), mask);
+				LLVOCache::getInstance()->removeCache();
 // 				llerrs << "Bogus TE data in " << getID() << ", crashing!" << llendl;
 				llwarns << "Bogus TE data in " << getID() << llendl;
 			}
@@ -535,7 +547,8 @@ void LLVOVolume::updateTextureVirtualSize()
 
 			if (texture_discard >= 0 && //texture has some data available
 				(texture_discard < current_discard || //texture has more data than last rebuild
-				current_discard < 0)) //no previous rebuild
+				current_discard < 0) && //no previous rebuild
+				!isSculptPending(texture_discard)) //not already being rebuilt
 			{
 				gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
 				mSculptChanged = TRUE;
@@ -788,6 +801,18 @@ void LLVOVolume::sculpt()
 					   
 			sculpt_data = raw_image->getData();
 		}
+		if (sVolumeGenPool && raw_image)
+		{
+			if (current_discard == -2)
+			{
+				// no geometry at all yet, draw the placeholder meanwhile
+				getVolume()->sculpt(0, 0, 0, NULL, -1);
+			}
+			// everything sharing the volume is rebuilt by preUpdateGeom() once it's done
+			sVolumeGenPool->requestSculpt(getVolume(), discard_level, sculpt_width, sculpt_height, sculpt_components, sculpt_data);
+			return;
+		}
+
 		getVolume()->sculpt(sculpt_width, sculpt_height, sculpt_components, sculpt_data, discard_level);
 
 		//notify rebuild any other VOVolumes that reference this sculpty volume
@@ -871,6 +896,13 @@ BOOL LLVOVolume::updateLOD()
 	
 	BOOL lod_changed = calcLOD();
 
+	if (!lod_changed && mLODPending
+		&& (!sVolumeGenPool || !sVolumeGenPool->isLODPending(getVolume()->getParams(), mLOD)))
+	{
+		// generated, switch over to it
+		lod_changed = TRUE;
+	}
+
 	if (lod_changed)
 	{
 		gPipeline.markRebuild(mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
@@ -1155,6 +1187,7 @@ BOOL LLVOVolume::updateGeometry(LLDrawable *drawable)
 			LLFastTimer ftm(LLFastTimer::FTM_GEN_VOLUME);
 			LLVolumeParams volume_params = getVolume()->getParams();
 			setVolume(volume_params, 0);
+			mLODPending = FALSE;
 			drawable->setState(LLDrawable::REBUILD_VOLUME);
 		}
 
@@ -1164,8 +1197,14 @@ BOOL LLVOVolume::updateGeometry(LLDrawable *drawable)
 			genBBoxes(FALSE);
 		}
 	}
+	else if (mLODChanged && !mSculptChanged && requestLOD())
+	{
+		// keep the current LOD until the new one has been generated
+	}
 	else if ((mLODChanged) || (mSculptChanged))
 	{
+		mLODPending = FALSE;
+
 		LLVolume *old_volumep, *new_volumep;
 		F32 old_lod, new_lod;
 		S32 old_num_faces, new_num_faces ;
@@ -1807,6 +1846,71 @@ const LLMatrix4 LLVOVolume::getRenderMatrix() const
 void LLVOVolume::preUpdateGeom()
 {
 	sNumLODChanges = 0;
+
+	if (sVolumeGenPool)
+	{
+		std::vector<LLPointer<LLVolume> > sculpted;
+		sVolumeGenPool->update(LLPrimitive::getVolumeManager(), &sculpted);
+
+		// rebuild everything using a resculpted volume
+		for (S32 i = 0; i < (S32)sculpted.size(); ++i)
+		{
+			LLViewerImage* imagep = gImageList.hasImage(sculpted[i]->getParams().getSculptID());
+			if (!imagep)
+			{
+				continue;
+			}
+			for (S32 j = 0; j < imagep->getNumVolumes(); ++j)
+			{
+				LLVOVolume* volume = (*(imagep->getVolumeList()))[j];
+				if (volume && volume->getVolume() == sculpted[i] && volume->mDrawable.notNull())
+				{
+					volume->mSculptChanged = TRUE;
+					gPipeline.markRebuild(volume->mDrawable, LLDrawable::REBUILD_VOLUME, FALSE);
+				}
+			}
+		}
+	}
+}
+
+BOOL LLVOVolume::requestLOD()
+{
+	if (!sVolumeGenPool || mVolumeImpl || !getVolume() || getVolume()->isUnique())
+	{
+		return FALSE;
+	}
+
+	const LLVolumeParams& volume_params = getVolume()->getParams();
+	if (LLPrimitive::getVolumeManager()->hasVolume(volume_params, mLOD))
+	{
+		// cached, no need to wait
+		return FALSE;
+	}
+
+	if (isSculpted())
+	{
+		LLImageRaw* raw_image = mSculptTexture.notNull() ? mSculptTexture->getCachedRawImage() : NULL;
+		if (!raw_image)
+		{
+			// only a placeholder to make, which is quick
+			return FALSE;
+		}
+		S32 discard_level = llmin(mSculptTexture->getDiscardLevel(), (S32)mSculptTexture->getMaxDiscardLevel());
+		sVolumeGenPool->requestLOD(volume_params, mLOD, discard_level,
+								   raw_image->getWidth(), raw_image->getHeight(),
+								   raw_image->getComponents(), raw_image->getData());
+	}
+	else
+	{
+		sVolumeGenPool->requestLOD(volume_params, mLOD);
+	}
+	mLODPending = TRUE;
+	return TRUE;
+}
+
+BOOL LLVOVolume::isSculptPending(S32 discard_level) const
+{
+	return sVolumeGenPool && getVolume() && sVolumeGenPool->getSculptPending(getVolume()) == discard_level;
 }
 
 void LLVOVolume::parameterChanged(U16 param_type, bool local_origin)
@@ -2238,6 +2342,233 @@ void LLVolumeGeometryManager::getGeometry(LLSpatialGroup* group)
 
 }
 
+// Everything about a face that decides its batch and its place in the
+// group's buffers, for LLBatchLayout. list is the face list it went in,
+// or -1 if it is not drawn.
+static void get_batch_key(LLFace* facep, S32 list, LLBatchLayout::Key& key)
+{
+	key.mGeomCount = facep->getGeomCount();
+	key.mIndicesCount = facep->getIndicesCount();
+	if (list < 0)
+	{
+		return;
+	}
+
+	const LLTextureEntry* te = facep->getTextureEntry();
+	LLViewerImage* tex = facep->getTexture();
+	BOOL tex_anim = facep->isState(LLFace::TEXTURE_ANIM) && facep->getVirtualSize() > MIN_TEX_ANIM_SIZE;
+
+	key.mTexture = tex;
+	key.mFlags = (list + 1) |
+		(facep->isState(LLFace::FULLBRIGHT) ? 0x08 : 0) |
+		(tex_anim ? 0x10 : 0) |
+		(facep->getPixelArea() < FORCE_SIMPLE_RENDER_AREA ? 0x20 : 0) |
+		(facep->getDrawable()->isActive() ? 0x40 : 0) |
+		(facep->getViewerObject()->isSelected() ? 0x80 : 0) |
+		(te->getFullbright() ? 0x100 : 0) |
+		(te->getColor().mV[VW] == 1.0f ? 0x200 : 0) |
+		(te->getGlow() > 0.f ? 0x400 : 0) |
+		(tex && tex->getIsAlphaMask() ? 0x800 : 0) |
+		(tex && tex->getPrimaryFormat() == GL_ALPHA ? 0x1000 : 0);
+	key.mState = te->getBumpmap() |
+		(te->getShiny() << 8) |
+		((U32) (U8) (te->getGlow() * 255) << 16) |
+		(facep->getPoolType() << 24);
+}
+
+// The settings the batches of every group depend on, for LLBatchLayout
+static U32 get_batch_context(U32 max_vertices)
+{
+	return (LLPipeline::sRenderBump ? 0x01 : 0) |
+		(LLPipeline::sRenderDeferred ? 0x02 : 0) |
+		(LLPipeline::sFastAlpha ? 0x04 : 0) |
+		(LLPipeline::sRenderGlow ? 0x08 : 0) |
+		(LLPipeline::sTextureBindTest ? 0x10 : 0) |
+		(gPipeline.canUseVertexShaders() ? 0x20 : 0) |
+		(gPipeline.canUseWindLightShadersOnObjects() ? 0x40 : 0) |
+		(gHideSelectedObjects ? 0x80 : 0) |
+		(max_vertices << 8);
+}
+
+S32 LLVolumeGeometryManager::sortFace(LLDrawable* drawablep, LLVOVolume* vobj, LLFace* facep)
+{
+	const LLTextureEntry* te = facep->getTextureEntry();
+	LLViewerImage* tex = facep->getTexture();
+
+	if (facep->isState(LLFace::TEXTURE_ANIM))
+	{
+		if (!vobj->mTexAnimMode)
+		{
+			facep->clearState(LLFace::TEXTURE_ANIM);
+		}
+	}
+
+	BOOL force_simple = (facep->mPixelArea < FORCE_SIMPLE_RENDER_AREA);
+	U32 type = gPipeline.getPoolTypeFromTE(te, tex);
+	if (type != LLDrawPool::POOL_ALPHA && force_simple)
+	{
+		type = LLDrawPool::POOL_SIMPLE;
+	}
+	facep->setPoolType(type);
+
+	if (vobj->isHUDAttachment())
+	{
+		facep->setState(LLFace::FULLBRIGHT);
+	}
+
+	if (vobj->mTextureAnimp && vobj->mTexAnimMode)
+	{
+		if (vobj->mTextureAnimp->mFace <= -1)
+		{
+			S32 face;
+			for (face = 0; face < vobj->getNumTEs(); face++)
+			{
+				drawablep->getFace(face)->setState(LLFace::TEXTURE_ANIM);
+			}
+		}
+		else if (vobj->mTextureAnimp->mFace < vobj->getNumTEs())
+		{
+			drawablep->getFace(vobj->mTextureAnimp->mFace)->setState(LLFace::TEXTURE_ANIM);
+		}
+	}
+
+	if (type == LLDrawPool::POOL_ALPHA)
+	{
+		if (LLPipeline::sFastAlpha &&
+			(te->getColor().mV[VW] == 1.0f) &&
+			facep->getTexture()->getIsAlphaMask())
+		{ //can be treated as alpha mask
+			return FACES_SIMPLE;
+		}
+		else
+		{
+			return FACES_ALPHA;
+		}
+	}
+
+	if (drawablep->isState(LLDrawable::REBUILD_VOLUME))
+	{
+		facep->mLastUpdateTime = gFrameTimeSeconds;
+	}
+
+	if (gPipeline.canUseWindLightShadersOnObjects()
+		&& LLPipeline::sRenderBump)
+	{
+		if (te->getBumpmap())
+		{ //needs normal + binormal
+			return FACES_BUMP;
+		}
+		else if (te->getShiny() || !te->getFullbright())
+		{ //needs normal
+			return FACES_SIMPLE;
+		}
+		else 
+		{ //doesn't need normal
+			facep->setState(LLFace::FULLBRIGHT);
+			return FACES_FULLBRIGHT;
+		}
+	}
+	else
+	{
+		if (te->getBumpmap() && LLPipeline::sRenderBump)
+		{ //needs normal + binormal
+			return FACES_BUMP;
+		}
+		else if ((te->getShiny() && LLPipeline::sRenderBump) ||
+			!te->getFullbright())
+		{ //needs normal
+			return FACES_SIMPLE;
+		}
+		else 
+		{ //doesn't need normal
+			facep->setState(LLFace::FULLBRIGHT);
+			return FACES_FULLBRIGHT;
+		}
+	}
+}
+
+BOOL LLVolumeGeometryManager::rebuildGeomInPlace(LLSpatialGroup* group, U32 context, U32 max_total)
+{
+	//static buffers can't be mapped again, and alpha needs sorting again
+	if (group->mBufferUsage == GL_STATIC_DRAW_ARB ||
+		group->isState(LLSpatialGroup::ALPHA_DIRTY) ||
+		!group->mBatchLayout.beginCheck(context))
+	{
+		return FALSE;
+	}
+
+	U32 useage = group->mSpatialPartition->mBufferUsage;
+	U32 cur_total = 0;
+
+	//visit the faces as a full rebuild would, checking each against the layout
+	for (LLSpatialGroup::element_iter drawable_iter = group->getData().begin(); drawable_iter != group->getData().end(); ++drawable_iter)
+	{
+		LLDrawable* drawablep = *drawable_iter;
+		
+		if (drawablep->isDead() || drawablep->isState(LLDrawable::FORCE_INVISIBLE) )
+		{
+			continue;
+		}
+	
+		if (drawablep->isAnimating())
+		{
+			useage = GL_STREAM_DRAW_ARB;
+		}
+
+		LLVOVolume* vobj = drawablep->getVOVolume();
+		llassert_always(vobj);
+
+		if (vobj->mSculptSurfaceArea > sSculptSAThresh)
+		{ //leave the sculpt budget to the full rebuild
+			return FALSE;
+		}
+
+		vobj->updateTextureVirtualSize();
+		vobj->preRebuild();
+
+		for (S32 i = 0; i < drawablep->getNumFaces(); i++)
+		{
+			drawablep->updateFaceSize(i);
+			LLFace* facep = drawablep->getFace(i);
+
+			S32 list = -1;
+			if (cur_total <= max_total)
+			{
+				cur_total += facep->getGeomCount();
+				if (facep->hasGeometry() && facep->mPixelArea > FORCE_CULL_AREA)
+				{
+					list = sortFace(drawablep, vobj, facep);
+				}
+			}
+
+			LLBatchLayout::Key key;
+			get_batch_key(facep, list, key);
+			if (!group->mBatchLayout.check(facep, key) ||
+				(list >= 0 && facep->mVertexBuffer.isNull()))
+			{
+				return FALSE;
+			}
+		}
+	}
+
+	if (!group->mBatchLayout.endCheck() || useage != group->mBufferUsage)
+	{
+		return FALSE;
+	}
+
+	//same batches as before, so only the dirty drawables' geometry needs writing
+	group->setState(LLSpatialGroup::MESH_DIRTY);
+	if (!LLPipeline::sDelayVBUpdate)
+	{
+		rebuildMesh(group);
+	}
+
+	group->mLastUpdateTime = gFrameTimeSeconds;
+	group->mBuilt = 1.f;
+	group->clearState(LLSpatialGroup::GEOM_DIRTY);
+	return TRUE;
+}
+
 void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 {
 	if (LLPipeline::sSkipUpdate)
@@ -2269,7 +2600,23 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 
 	LLFastTimer ftm2(LLFastTimer::FTM_REBUILD_VOLUME_VB);
 
+	static S32* sRenderMaxVBOSize = rebind_llcontrol<S32>("RenderMaxVBOSize", &gSavedSettings, true);
+	static S32* sRenderMaxNodeSize = rebind_llcontrol<S32>("RenderMaxNodeSize", &gSavedSettings, true);
+	static BOOL* sRenderIncrementalRebuild = rebind_llcontrol<BOOL>("RenderIncrementalRebuild", &gSavedSettings, true);
+
+	U32 max_vertices = ((*sRenderMaxVBOSize)*1024)/LLVertexBuffer::calcStride(group->mSpatialPartition->mVertexDataMask);
+	U32 max_total = ((*sRenderMaxNodeSize)*1024)/LLVertexBuffer::calcStride(group->mSpatialPartition->mVertexDataMask);
+	max_vertices = llmin(max_vertices, (U32) 65535);
+
+	U32 context = get_batch_context(max_vertices);
+
+	if (*sRenderIncrementalRebuild && rebuildGeomInPlace(group, context, max_total))
+	{
+		return;
+	}
+
 	group->clearDrawMap();
+	group->mBatchLayout.beginRecord();
 
 	mFaceList.clear();
 
@@ -2278,17 +2625,9 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 	std::vector<LLFace*> simple_faces;
 
 	std::vector<LLFace*> alpha_faces;
+	std::vector<LLFace*>* face_lists[NUM_FACE_LISTS] = { &simple_faces, &bump_faces, &fullbright_faces, &alpha_faces };
 	U32 useage = group->mSpatialPartition->mBufferUsage;
 
-
-	static S32* sRenderMaxVBOSize = rebind_llcontrol<S32>("RenderMaxVBOSize", &gSavedSettings, true);
-	static S32* sRenderMaxNodeSize = rebind_llcontrol<S32>("RenderMaxNodeSize", &gSavedSettings, true);
-
-
-	U32 max_vertices = ((*sRenderMaxVBOSize)*1024)/LLVertexBuffer::calcStride(group->mSpatialPartition->mVertexDataMask);
-	U32 max_total = ((*sRenderMaxNodeSize)*1024)/LLVertexBuffer::calcStride(group->mSpatialPartition->mVertexDataMask);
-	max_vertices = llmin(max_vertices, (U32) 65535);
-
 	U32 cur_total = 0;
 
 	//get all the faces into a list
@@ -2328,118 +2667,31 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 			drawablep->updateFaceSize(i);
 			LLFace* facep = drawablep->getFace(i);
 
+			S32 list = -1;
 			if (cur_total > max_total)
 			{
 				facep->mVertexBuffer = NULL;
 				facep->mLastVertexBuffer = NULL;
-				continue;
 			}
-
-			cur_total += facep->getGeomCount();
-
-			if (facep->hasGeometry() && facep->mPixelArea > FORCE_CULL_AREA)
+			else
 			{
-				const LLTextureEntry* te = facep->getTextureEntry();
-				LLViewerImage* tex = facep->getTexture();
-
-				if (facep->isState(LLFace::TEXTURE_ANIM))
-				{
-					if (!vobj->mTexAnimMode)
-					{
-						facep->clearState(LLFace::TEXTURE_ANIM);
-					}
-				}
-
-				BOOL force_simple = (facep->mPixelArea < FORCE_SIMPLE_RENDER_AREA);
-				U32 type = gPipeline.getPoolTypeFromTE(te, tex);
-				if (type != LLDrawPool::POOL_ALPHA && force_simple)
-				{
-					type = LLDrawPool::POOL_SIMPLE;
-				}
-				facep->setPoolType(type);
+				cur_total += facep->getGeomCount();
 
-				if (vobj->isHUDAttachment())
+				if (facep->hasGeometry() && facep->mPixelArea > FORCE_CULL_AREA)
 				{
-					facep->setState(LLFace::FULLBRIGHT);
-				}
-
-				if (vobj->mTextureAnimp && vobj->mTexAnimMode)
-				{
-					if (vobj->mTextureAnimp->mFace <= -1)
-					{
-						S32 face;
-						for (face = 0; face < vobj->getNumTEs(); face++)
-						{
-							drawablep->getFace(face)->setState(LLFace::TEXTURE_ANIM);
-						}
-					}
-					else if (vobj->mTextureAnimp->mFace < vobj->getNumTEs())
-					{
-						drawablep->getFace(vobj->mTextureAnimp->mFace)->setState(LLFace::TEXTURE_ANIM);
-					}
-				}
-
-				if (type == LLDrawPool::POOL_ALPHA)
-				{
-					if (LLPipeline::sFastAlpha &&
-						(te->getColor().mV[VW] == 1.0f) &&
-						facep->getTexture()->getIsAlphaMask())
-					{ //can be treated as alpha mask
-						simple_faces.push_back(facep);
-					}
-					else
-					{
-						alpha_faces.push_back(facep);
-					}
+					list = sortFace(drawablep, vobj, facep);
+					face_lists[list]->push_back(facep);
 				}
 				else
-				{
-					if (drawablep->isState(LLDrawable::REBUILD_VOLUME))
-					{
-						facep->mLastUpdateTime = gFrameTimeSeconds;
-					}
-
-					if (gPipeline.canUseWindLightShadersOnObjects()
-						&& LLPipeline::sRenderBump)
-					{
-						if (te->getBumpmap())
-						{ //needs normal + binormal
-							bump_faces.push_back(facep);
-						}
-						else if (te->getShiny() || !te->getFullbright())
-						{ //needs normal
-							simple_faces.push_back(facep);
-						}
-						else 
-						{ //doesn't need normal
-							facep->setState(LLFace::FULLBRIGHT);
-							fullbright_faces.push_back(facep);
-						}
-					}
-					else
-					{
-						if (te->getBumpmap() && LLPipeline::sRenderBump)
-						{ //needs normal + binormal
-							bump_faces.push_back(facep);
-						}
-						else if ((te->getShiny() && LLPipeline::sRenderBump) ||
-							!te->getFullbright())
-						{ //needs normal
-							simple_faces.push_back(facep);
-						}
-						else 
-						{ //doesn't need normal
-							facep->setState(LLFace::FULLBRIGHT);
-							fullbright_faces.push_back(facep);
-						}
-					}
+				{	//face has no renderable geometry
+					facep->mVertexBuffer = NULL;
+					facep->mLastVertexBuffer = NULL;
 				}
 			}
-			else
-			{	//face has no renderable geometry
-				facep->mVertexBuffer = NULL;
-				facep->mLastVertexBuffer = NULL;
-			}		
+
+			LLBatchLayout::Key key;
+			get_batch_key(facep, list, key);
+			group->mBatchLayout.record(facep, key);
 		}
 	}
 
@@ -2461,6 +2713,8 @@ void LLVolumeGeometryManager::rebuildGeom(LLSpatialGroup* group)
 	genDrawInfo(group, fullbright_mask, fullbright_faces);
 	genDrawInfo(group, alpha_mask, alpha_faces, TRUE);
 
+	group->mBatchLayout.endRecord(context);
+
 	if (!LLPipeline::sDelayVBUpdate)
 	{
 		//drawables have been rebuilt, clear rebuild status
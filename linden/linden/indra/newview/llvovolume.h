@@ -42,6 +42,7 @@
 class LLViewerTextureAnim;
 class LLDrawPool;
 class LLSelectNode;
+class LLVolumeGenPool;
 
 enum LLVolumeInterfaceType
 {
@@ -78,6 +79,7 @@ protected:
 
 public:
 	static		void	initClass();
+	static		void	cleanupClass();
 	static 		void 	preUpdateGeom();
 	
 	enum 
@@ -220,6 +222,9 @@ public:
 protected:
 	S32	computeLODDetail(F32	distance, F32 radius);
 	BOOL calcLOD();
+	// Queues generation of mLOD if it isn't cached, returns TRUE if so.
+	BOOL requestLOD();
+	BOOL isSculptPending(S32 discard_level) const;
 	LLFace* addFace(S32 face_index);
 	void updateTEData();
 
@@ -233,6 +238,7 @@ private:
 	LLFrameTimer mTextureUpdateTimer;
 	S32			mLOD;
 	BOOL		mLODChanged;
+	BOOL		mLODPending;		// drawing the old LOD until mLOD is generated
 	BOOL		mSculptChanged;
 	LLMatrix4	mRelativeXform;
 	LLMatrix3	mRelativeXformInvTrans;
@@ -250,6 +256,7 @@ public:
 		
 protected:
 	static S32 sNumLODChanges;
+	static LLVolumeGenPool* sVolumeGenPool;	// NULL unless AsyncVolumeGeneration
 	
 	friend class LLVolumeImplFlexible;
 };
@@ -47,6 +47,7 @@
 #include "llviewercamera.h"
 #include "llviewerimagelist.h"
 #include "llviewerregion.h"
+#include "llwatergrid.h"
 #include "llworld.h"
 #include "pipeline.h"
 #include "llspatialpartition.h"
@@ -68,6 +69,8 @@ const U32 N_RES_HALF	= (N_RES >> 1);
 const U32 WIDTH			= (N_RES * WAVE_STEP); //128.f //64		// width of wave tile, in meters
 const F32 WAVE_STEP_INV	= (1. / WAVE_STEP);
 
+const S32 WATER_GRID_SIZE = 16;	// quads on a side of a water patch
+
 
 LLVOWater::LLVOWater(const LLUUID &id, const LLPCode pcode, LLViewerRegion *regionp)
 :	LLStaticViewerObject(id, pcode, regionp)
@@ -151,22 +154,25 @@ BOOL LLVOWater::updateGeometry(LLDrawable *drawable)
 	}
 	face = drawable->getFace(0);
 
-//	LLVector2 uvs[4];
-//	LLVector3 vtx[4];
+	LLVector3 position_agent = getPositionAgent();
+	if (face->mVertexBuffer.notNull() &&
+		position_agent == mBuiltPosition &&
+		getScale() == mBuiltScale)
+	{ //placed where it already was, as LLWorld::updateWaterObjects() does for most patches
+		return TRUE;
+	}
 
 	LLStrider<LLVector3> verticesp, normalsp;
 	LLStrider<LLVector2> texCoordsp;
 	LLStrider<U16> indicesp;
 	U16 index_offset;
 
-	S32 size = 16;
-
-	S32 num_quads = size*size;	
-	face->setSize(4*num_quads, 6*num_quads);
+	const LLWaterGrid& grid = LLWaterGrid::getGrid(WATER_GRID_SIZE);
+	face->setSize(grid.getNumVertices(), grid.getNumIndices());
 
 	if (face->mVertexBuffer.isNull())
 	{
-		face->mVertexBuffer = new LLVertexBuffer(LLDrawPoolWater::VERTEX_DATA_MASK, GL_DYNAMIC_DRAW_ARB);
+		face->mVertexBuffer = new LLVertexBuffer(LLDrawPoolWater::VERTEX_DATA_MASK, GL_STATIC_DRAW_ARB);
 		face->mVertexBuffer->allocateBuffer(face->getGeomCount(), face->getIndicesCount(), TRUE);
 		face->setIndicesIndex(0);
 		face->setGeomIndex(0);
@@ -178,56 +184,19 @@ BOOL LLVOWater::updateGeometry(LLDrawable *drawable)
 		
 	index_offset = face->getGeometry(verticesp,normalsp,texCoordsp, indicesp);
 		
-	LLVector3 position_agent;
-	position_agent = getPositionAgent();
 	face->mCenterAgent = position_agent;
 	face->mCenterLocal = position_agent;
 
-	S32 x, y;
-	F32 step_x = getScale().mV[0] / size;
-	F32 step_y = getScale().mV[1] / size;
-
-	const LLVector3 up(0.f, step_y * 0.5f, 0.f);
-	const LLVector3 right(step_x * 0.5f, 0.f, 0.f);
-	const LLVector3 normal(0.f, 0.f, 1.f);
-
-	F32 size_inv = 1.f / size;
-
-	for (y = 0; y < size; y++)
-	{
-		for (x = 0; x < size; x++)
-		{
-			S32 toffset = index_offset + 4*(y*size + x);
-			position_agent = getPositionAgent() - getScale() * 0.5f;
-			position_agent.mV[VX] += (x + 0.5f) * step_x;
-			position_agent.mV[VY] += (y + 0.5f) * step_y;
-
-			*verticesp++  = position_agent - right + up;
-			*verticesp++  = position_agent - right - up;
-			*verticesp++  = position_agent + right + up;
-			*verticesp++  = position_agent + right - up;
-
-			*texCoordsp++ = LLVector2(x*size_inv, (y+1)*size_inv);
-			*texCoordsp++ = LLVector2(x*size_inv, y*size_inv);
-			*texCoordsp++ = LLVector2((x+1)*size_inv, (y+1)*size_inv);
-			*texCoordsp++ = LLVector2((x+1)*size_inv, y*size_inv);
-			
-			*normalsp++   = normal;
-			*normalsp++   = normal;
-			*normalsp++   = normal;
-			*normalsp++   = normal;
-
-			*indicesp++ = toffset + 0;
-			*indicesp++ = toffset + 1;
-			*indicesp++ = toffset + 2;
-
-			*indicesp++ = toffset + 1;
-			*indicesp++ = toffset + 3;
-			*indicesp++ = toffset + 2;
-		}
-	}
+	// the shared grid, scaled and moved into place in one batched transform
+	grid.fill(position_agent - getScale() * 0.5f, getScale().mV[VX], getScale().mV[VY],
+			  verticesp.get(), verticesp.getSkip(),
+			  normalsp.get(), normalsp.getSkip(),
+			  texCoordsp.get(), texCoordsp.getSkip(),
+			  indicesp.get(), index_offset);
 	
 	face->mVertexBuffer->setBuffer(0);
+	mBuiltPosition = position_agent;
+	mBuiltScale = getScale();
 
 	mDrawable->movePartition();
 	LLPipeline::sCompiles++;
@@ -240,6 +209,7 @@ void LLVOWater::initClass()
 
 void LLVOWater::cleanupClass()
 {
+	LLWaterGrid::cleanupClass();
 }
 
 void setVecZ(LLVector3& v)
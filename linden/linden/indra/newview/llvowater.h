@@ -85,6 +85,10 @@ protected:
 	BOOL mUseTexture;
 	BOOL mIsEdgePatch;
 	LLPipeline::LLRenderTypeMask mRenderType;
+
+	// Where the geometry was last built, to skip rebuilds that would not move it
+	LLVector3 mBuiltPosition;
+	LLVector3 mBuiltScale;
 };
 
 class LLVOVoidWater : public LLVOWater
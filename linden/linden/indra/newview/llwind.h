@@ -57,6 +57,12 @@ public:
 	LLVector3 getAverage();
 	void setCloudDensityPointer(F32 *densityp);
 
+	// The cloud velocity grid, getSize() by getSize(), which the cloud
+	// puffs drift on.
+	S32 getSize() const								{ return mSize; }
+	const F32* getCloudVelX() const					{ return mCloudVelX; }
+	const F32* getCloudVelY() const					{ return mCloudVelY; }
+
 	void setOriginGlobal(const LLVector3d &origin_global);
 private:
 	S32 mSize;
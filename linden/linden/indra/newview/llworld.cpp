@@ -679,22 +679,20 @@ void LLWorld::updateClouds(const F32 dt)
 	}
 	if (mActiveRegionList.size())
 	{
-		// Update all the cloud puff positions, and timer based stuff
-		// such as death decay
+		// Update the groups' densities
 		for (region_list_t::iterator iter = mActiveRegionList.begin();
 			 iter != mActiveRegionList.end(); ++iter)
 		{
 			LLViewerRegion* regionp = *iter;
-			regionp->mCloudLayer.updatePuffs(dt);
+			regionp->mCloudLayer.updateDensity();
 		}
 
+		// Update all the cloud puff positions, and timer based stuff
+		// such as death decay
+		LLCloudLayer::updateAllPuffs(dt);
+
 		// Reshuffle who owns which puffs
-		for (region_list_t::iterator iter = mActiveRegionList.begin();
-			 iter != mActiveRegionList.end(); ++iter)
-		{
-			LLViewerRegion* regionp = *iter;
-			regionp->mCloudLayer.updatePuffOwnership();
-		}
+		LLCloudLayer::updateAllPuffOwnership();
 
 		// Add new puffs
 		for (region_list_t::iterator iter = mActiveRegionList.begin();
@@ -703,29 +701,10 @@ void LLWorld::updateClouds(const F32 dt)
 			LLViewerRegion* regionp = *iter;
 			regionp->mCloudLayer.updatePuffCount();
 		}
+		LLCloudLayer::sortAllPuffs();
 	}
 }
 
-LLCloudGroup* LLWorld::findCloudGroup(const LLCloudPuff &puff)
-{
-	if (mActiveRegionList.size())
-	{
-		// Update all the cloud puff positions, and timer based stuff
-		// such as death decay
-		for (region_list_t::iterator iter = mActiveRegionList.begin();
-			 iter != mActiveRegionList.end(); ++iter)
-		{
-			LLViewerRegion* regionp = *iter;
-			LLCloudGroup *groupp = regionp->mCloudLayer.findCloudGroup(puff);
-			if (groupp)
-			{
-				return groupp;
-			}
-		}
-	}
-	return NULL;
-}
-
 
 void LLWorld::renderPropertyLines()
 {
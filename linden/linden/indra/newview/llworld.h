@@ -57,8 +57,6 @@ class LLHost;
 class LLViewerObject;
 class LLSurfacePatch;
 
-class LLCloudPuff;
-class LLCloudGroup;
 class LLVOAvatar;
 
 // LLWorld maintains a stack of unused viewer_regions and an array of pointers to viewer regions
@@ -124,7 +122,6 @@ public:
 	void					updateVisibilities();
 	void					updateParticles();
 	void					updateClouds(const F32 dt);
-	LLCloudGroup *			findCloudGroup(const LLCloudPuff &puff);
 
 	void					renderPropertyLines();
 
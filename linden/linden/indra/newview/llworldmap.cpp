@@ -50,6 +50,8 @@
  #include "hippogridmanager.h"
 bool LLWorldMap::sGotMapURL =  false;
 const F32 REQUEST_ITEMS_TIMER =  10.f * 60.f; // 10 minutes
+// Width of the cells sims and items are indexed by, a map block of 8x8 regions
+const F64 MAP_INDEX_CELL_WIDTH = 8.0 * REGION_WIDTH_METERS;
 
 // For DEV-17507, do lazy image loading in llworldmapview.cpp instead,
 // limiting requests to currently visible regions and minimizing the
@@ -73,6 +75,30 @@ LLItemInfo::LLItemInfo(F32 global_x, F32 global_y,
 	mRegionHandle = to_region_handle(mPosGlobal);
 }
 
+LLItemInfoList::LLItemInfoList()
+:	mIndex(MAP_INDEX_CELL_WIDTH)
+{
+}
+
+void LLItemInfoList::push_back(const LLItemInfo& item)
+{
+	mIndex.insert((S32)mItems.size(), item.mPosGlobal.mdV[VX], item.mPosGlobal.mdV[VY]);
+	mItems.push_back(item);
+}
+
+void LLItemInfoList::clear()
+{
+	mItems.clear();
+	mIndex.clear();
+}
+
+void LLItemInfoList::find(F64 min_x, F64 min_y, F64 max_x, F64 max_y, std::vector<S32>& indices) const
+{
+	S32 first = (S32)indices.size();
+	mIndex.query(min_x, min_y, max_x, max_y, indices);
+	std::sort(indices.begin() + first, indices.end());
+}
+
 LLSimInfo::LLSimInfo()
 :	mHandle(0),
 	mName(),
@@ -123,6 +149,7 @@ LLWorldMap::LLWorldMap() :
 	mTelehubCoverageMap(NULL),
 	mNeighborMapWidth(0),
 	mNeighborMapHeight(0),
+	mSimIndex(MAP_INDEX_CELL_WIDTH),
 	mSLURLRegionName(),
 	mSLURLRegionHandle(0),
 	mSLURL(),
@@ -155,6 +182,7 @@ void LLWorldMap::reset()
 {
 	for_each(mSimInfoMap.begin(), mSimInfoMap.end(), DeletePairedPointer());
 	mSimInfoMap.clear();
+	mSimIndex.clear();
 
 	for (S32 m=0; m<MAP_SIM_IMAGE_TYPES; ++m)
 	{
@@ -239,29 +267,64 @@ LLSimInfo* LLWorldMap::simInfoFromPosGlobal(const LLVector3d& pos_global)
 	return simInfoFromHandle(handle);
 }
 
+void LLWorldMap::addSimInfo(LLSimInfo* siminfo)
+{
+	sim_info_map_t::iterator iter = mSimInfoMap.find(siminfo->mHandle);
+	if (iter != mSimInfoMap.end())
+	{
+		LLSimInfo* oldinfo = iter->second;
+		LLVector3d origin = oldinfo->getGlobalOrigin();
+		mSimIndex.remove(oldinfo, origin.mdV[VX], origin.mdV[VY],
+						 origin.mdV[VX] + oldinfo->msizeX, origin.mdV[VY] + oldinfo->msizeY);
+		delete oldinfo;
+		iter->second = siminfo;
+	}
+	else
+	{
+		mSimInfoMap[siminfo->mHandle] = siminfo;
+	}
+	LLVector3d origin = siminfo->getGlobalOrigin();
+	mSimIndex.insert(siminfo, origin.mdV[VX], origin.mdV[VY],
+					 origin.mdV[VX] + siminfo->msizeX, origin.mdV[VY] + siminfo->msizeY);
+}
+
+void LLWorldMap::findSimInfos(F64 min_x, F64 min_y, F64 max_x, F64 max_y, std::vector<LLSimInfo*>& sims) const
+{
+	mSimIndex.query(min_x, min_y, max_x, max_y, sims);
+}
+
 LLSimInfo* LLWorldMap::simInfoFromHandle(const U64 findhandle)
 {
-	std::map<U64, LLSimInfo*>::const_iterator it;
-	for (it = LLWorldMap::getInstance()->mSimInfoMap.begin(); it != LLWorldMap::getInstance()->mSimInfoMap.end(); ++it)
+	sim_info_map_t::const_iterator it = mSimInfoMap.find(findhandle);
+	if (it != mSimInfoMap.end())
 	{
-		const U64 handle = (*it).first;
-		LLSimInfo* info = (*it).second;
-		if(handle == findhandle)
-		{
-			return info;
-		}
-		U32 x = 0, y = 0;
-		from_region_handle(findhandle, &x, &y);
+		return (*it).second;
+	}
+
+	// Otherwise look for a var region the handle is inside of.
+	U32 x = 0, y = 0;
+	from_region_handle(findhandle, &x, &y);
+	std::vector<LLSimInfo*> sims;
+	mSimIndex.query(x, y, x, y, sims);
+
+	LLSimInfo* found = NULL;
+	for (std::vector<LLSimInfo*>::iterator iter = sims.begin(); iter != sims.end(); ++iter)
+	{
+		LLSimInfo* info = *iter;
 		U32 checkRegionX, checkRegionY;
-		from_region_handle(handle, &checkRegionX, &checkRegionY);
+		from_region_handle(info->mHandle, &checkRegionX, &checkRegionY);
 
-        if(x > checkRegionX && x < (checkRegionX + info->msizeX) &&
+		if (x > checkRegionX && x < (checkRegionX + info->msizeX) &&
 			y > checkRegionY && y < (checkRegionY + info->msizeY))
 		{
-			return info;
+			// The one first in the map, if more than one overlap here
+			if (!found || info->mHandle < found->mHandle)
+			{
+				found = info;
+			}
 		}
 	}
-	return NULL;
+	return found;
 }
 
 
@@ -673,11 +736,10 @@ void LLWorldMap::processMapBlockReply(LLMessageSystem* msg, void**)
 				{
 					siminfo->mMapImageID[image] = oldinfo->mMapImageID[image];
 				}
-				delete oldinfo;
 			}
-			LLWorldMap::getInstance()->mSimInfoMap[handle] = siminfo;
-
 			siminfo->mHandle = handle;
+			LLWorldMap::getInstance()->addSimInfo(siminfo);
+
 			siminfo->mName.assign( name );
 			siminfo->mAccess = accesscode;
 			siminfo->mRegionFlags = region_flags;
@@ -42,6 +42,7 @@
 #include "llframetimer.h"
 #include "llmapimagetype.h"
 #include "lluuid.h"
+#include "llgridindex.h"
 #include "llmemory.h"
 #include "llviewerimage.h"
 #include "lleventinfo.h"
@@ -65,6 +66,38 @@ public:
 	U64			mRegionHandle;
 };
 
+// A list of map items of one kind, indexed by where they are, so that the
+// ones in the map view can be found without looking at all of them.
+class LLItemInfoList
+{
+public:
+	typedef std::vector<LLItemInfo> list_t;
+	typedef list_t::iterator iterator;
+	typedef list_t::const_iterator const_iterator;
+
+	LLItemInfoList();
+
+	iterator begin()							{ return mItems.begin(); }
+	iterator end()								{ return mItems.end(); }
+	const_iterator begin() const				{ return mItems.begin(); }
+	const_iterator end() const					{ return mItems.end(); }
+	U32 size() const							{ return mItems.size(); }
+	bool empty() const							{ return mItems.empty(); }
+	LLItemInfo& operator[](S32 index)			{ return mItems[index]; }
+	const LLItemInfo& operator[](S32 index) const	{ return mItems[index]; }
+
+	void push_back(const LLItemInfo& item);
+	void clear();
+
+	// Appends the indices of the items inside the rectangle, in global
+	// meters, to indices, in the order the items were added.
+	void find(F64 min_x, F64 min_y, F64 max_x, F64 max_y, std::vector<S32>& indices) const;
+
+private:
+	list_t mItems;
+	LLGridIndex<S32> mIndex;
+};
+
 #define MAP_SIM_IMAGE_TYPES 3
 // 0 - Prim
 // 1 - Terrain Only
@@ -136,6 +169,14 @@ public:
 	// Causes a re-request of the sim info without erasing extisting info
 	void clearSimFlags();
 
+	// Adds siminfo, with its handle and size set, in place of the
+	// simulator information there was for its handle, which is deleted.
+	void addSimInfo(LLSimInfo* siminfo);
+
+	// Appends the simulators overlapping the rectangle, in global meters,
+	// to sims, in no particular order.
+	void findSimInfos(F64 min_x, F64 min_y, F64 max_x, F64 max_y, std::vector<LLSimInfo*>& sims) const;
+
 	// Returns simulator information, or NULL if out of range
 	LLSimInfo* simInfoFromHandle(const U64 handle);
 
@@ -195,17 +236,17 @@ public:
 
 	bool mRequestLandForSale;
 
-	typedef std::vector<LLItemInfo> item_info_list_t;
-	item_info_list_t mTelehubs;
-	item_info_list_t mInfohubs;
-	item_info_list_t mPGEvents;
-	item_info_list_t mMatureEvents;
-	item_info_list_t mAdultEvents;
-	item_info_list_t mLandForSale;
-	item_info_list_t mLandForSaleAdult;
+	LLItemInfoList mTelehubs;
+	LLItemInfoList mInfohubs;
+	LLItemInfoList mPGEvents;
+	LLItemInfoList mMatureEvents;
+	LLItemInfoList mAdultEvents;
+	LLItemInfoList mLandForSale;
+	LLItemInfoList mLandForSaleAdult;
 
 	std::map<U64,S32> mNumAgents;
 
+	typedef std::vector<LLItemInfo> item_info_list_t;
 	typedef std::map<U64, item_info_list_t> agent_list_map_t;
 	agent_list_map_t mAgentLocationsMap;
 	
@@ -226,6 +267,9 @@ public:
 	S32		mNeighborMapHeight;
 
 private:
+	// The simulators of mSimInfoMap, by the area they cover
+	LLGridIndex<LLSimInfo*> mSimIndex;
+
 	LLTimer	mRequestTimer;
 
 	// search for named region for url processing
@@ -117,6 +117,32 @@ std::map<std::string,std::string> LLWorldMapView::sStringsMap;
 // Updates for agent locations.
 #define AGENTS_UPDATE_TIME 60.0 // in seconds
 
+// Orders sims by how far their middles are from a point
+class LLSimInfoNearer
+{
+public:
+	LLSimInfoNearer(const LLVector3d& pos_global) : mPosGlobal(pos_global) { }
+
+	bool operator()(const LLSimInfo* a, const LLSimInfo* b) const
+	{
+		F64 distance_a = distanceSquared(a);
+		F64 distance_b = distanceSquared(b);
+		return distance_a < distance_b || (distance_a == distance_b && a->mHandle < b->mHandle);
+	}
+
+private:
+	F64 distanceSquared(const LLSimInfo* info) const
+	{
+		LLVector3d center = info->getGlobalOrigin();
+		center.mdV[VX] += info->msizeX * 0.5;
+		center.mdV[VY] += info->msizeY * 0.5;
+		center.mdV[VZ] = mPosGlobal.mdV[VZ];
+		return (center - mPosGlobal).magVecSquared();
+	}
+
+	LLVector3d mPosGlobal;
+};
+
 
 
 void LLWorldMapView::initClass()
@@ -304,7 +330,8 @@ void LLWorldMapView::draw()
 
 	F64 current_time = LLTimer::getElapsedSeconds();
 
-	mVisibleRegions.clear();
+	handle_list_t last_visible_regions;
+	last_visible_regions.swap(mVisibleRegions);
 	
 	// animate pan if necessary
 	sPanX = lerp(sPanX, sTargetPanX, LLCriticalDamp::getInterpolant(0.1f));
@@ -444,24 +471,37 @@ void LLWorldMapView::draw()
 
 	bool use_web_map_tiles = LLWorldMap::useWebMapTiles();
 
-	for (LLWorldMap::sim_info_map_t::iterator it = LLWorldMap::getInstance()->mSimInfoMap.begin();
-		 it != LLWorldMap::getInstance()->mSimInfoMap.end(); ++it)
+	// Only the sims in the view are looked at, nearest its middle first, as
+	// that is where their textures are wanted first.
+	std::vector<LLSimInfo*> sims;
+	if (sMapScale >= SIM_MAP_SCALE)
 	{
-		U64 handle = (*it).first;
-		LLSimInfo* info = (*it).second;
+		F64 min_x, min_y, max_x, max_y;
+		getGlobalViewRect(0.f, min_x, min_y, max_x, max_y);
+		LLWorldMap::getInstance()->findSimInfos(min_x, min_y, max_x, max_y, sims);
+		std::sort(sims.begin(), sims.end(), LLSimInfoNearer(LLVector3d((min_x + max_x) * 0.5, (min_y + max_y) * 0.5, 0.0)));
+	}
+
+	// Sims that come into the view start unfaded, as if they had been
+	// fading while out of it.
+	std::sort(last_visible_regions.begin(), last_visible_regions.end());
+	for (std::vector<LLSimInfo*>::iterator it = sims.begin(); it != sims.end(); ++it)
+	{
+		if (!std::binary_search(last_visible_regions.begin(), last_visible_regions.end(), (*it)->mHandle))
+		{
+			(*it)->mAlpha = -1.f;
+		}
+	}
+
+	for (std::vector<LLSimInfo*>::iterator it = sims.begin(); it != sims.end(); ++it)
+	{
+		LLSimInfo* info = *it;
+		U64 handle = info->mHandle;
 
 		LLViewerImage* simimage = info->mCurrentImage;
 		LLViewerImage* overlayimage = info->mOverlayImage;
 
-		if (sMapScale < SIM_MAP_SCALE)
-		{
-			if (simimage != NULL) simimage->setBoostLevel(0);
-			if (overlayimage != NULL) overlayimage->setBoostLevel(0);
-			continue;
-		}
-		
 		LLVector3d origin_global = from_region_handle(handle);
-		LLVector3d camera_global = gAgent.getCameraPositionGlobal();
 
 		// Find x and y position relative to camera's center.
 		LLVector3d rel_region_pos = origin_global - camera_global;
@@ -795,6 +835,34 @@ void LLWorldMapView::draw()
 	}
 	// #endif used to be here
 
+	// Sims that have left the view since last frame give up their boost.
+	if (!last_visible_regions.empty())
+	{
+		handle_list_t visible_regions = mVisibleRegions;
+		std::sort(visible_regions.begin(), visible_regions.end());
+		for (handle_list_t::iterator iter = last_visible_regions.begin(); iter != last_visible_regions.end(); ++iter)
+		{
+			if (std::binary_search(visible_regions.begin(), visible_regions.end(), *iter))
+			{
+				continue;
+			}
+			LLWorldMap::sim_info_map_t::iterator it = LLWorldMap::getInstance()->mSimInfoMap.find(*iter);
+			if (it == LLWorldMap::getInstance()->mSimInfoMap.end())
+			{
+				continue;
+			}
+			LLSimInfo* info = (*it).second;
+			if (info->mCurrentImage.notNull())
+			{
+				info->mCurrentImage->setBoostLevel(0);
+			}
+			if (info->mOverlayImage.notNull())
+			{
+				info->mOverlayImage->setBoostLevel(0);
+			}
+		}
+	}
+
 
 	// there used to be an #if 1 here, but it was uncommented; perhaps marking a block of code?
 	// Draw background rectangle
@@ -952,12 +1020,15 @@ void LLWorldMapView::setVisible(BOOL visible)
 	}
 }
 
-void LLWorldMapView::drawGenericItems(const LLWorldMap::item_info_list_t& items, LLUIImagePtr image)
+void LLWorldMapView::drawGenericItems(const LLItemInfoList& items, LLUIImagePtr image)
 {
-	LLWorldMap::item_info_list_t::const_iterator e;
-	for (e = items.begin(); e != items.end(); ++e)
+	F64 min_x, min_y, max_x, max_y;
+	getGlobalViewRect((F32)llmax(image->getWidth(), image->getHeight()), min_x, min_y, max_x, max_y);
+	std::vector<S32> indices;
+	items.find(min_x, min_y, max_x, max_y, indices);
+	for (std::vector<S32>::iterator e = indices.begin(); e != indices.end(); ++e)
 	{
-		drawGenericItem(*e, image);
+		drawGenericItem(items[*e], image);
 	}
 }
 
@@ -1060,69 +1131,71 @@ void LLWorldMapView::drawEvents()
     BOOL show_mature = mature_enabled && gSavedSettings.getBOOL("ShowMatureEvents");
 	BOOL show_adult = adult_enabled && gSavedSettings.getBOOL("ShowAdultEvents");
 
-    // First the non-selected events
-    LLWorldMap::item_info_list_t::const_iterator e;
+	// Only the events in the view
+	F64 min_x, min_y, max_x, max_y;
+	getGlobalViewRect((F32)llmax(sEventImage->getWidth(), sEventImage->getHeight()), min_x, min_y, max_x, max_y);
+	const LLItemInfoList& pg_events = LLWorldMap::getInstance()->mPGEvents;
+	const LLItemInfoList& mature_events = LLWorldMap::getInstance()->mMatureEvents;
+	const LLItemInfoList& adult_events = LLWorldMap::getInstance()->mAdultEvents;
+	std::vector<S32> pg_visible, mature_visible, adult_visible;
 	if (show_pg)
 	{
-		for (e = LLWorldMap::getInstance()->mPGEvents.begin(); e != LLWorldMap::getInstance()->mPGEvents.end(); ++e)
+		pg_events.find(min_x, min_y, max_x, max_y, pg_visible);
+	}
+	if (show_mature)
+	{
+		mature_events.find(min_x, min_y, max_x, max_y, mature_visible);
+	}
+	if (show_adult)
+	{
+		adult_events.find(min_x, min_y, max_x, max_y, adult_visible);
+	}
+
+	// First the non-selected events
+	std::vector<S32>::iterator e;
+	for (e = pg_visible.begin(); e != pg_visible.end(); ++e)
+	{
+		if (!pg_events[*e].mSelected)
 		{
-			if (!e->mSelected)
-			{
-				drawGenericItem(*e, sEventImage);   
-			}
+			drawGenericItem(pg_events[*e], sEventImage);
 		}
 	}
-    if (show_mature)
-    {
-        for (e = LLWorldMap::getInstance()->mMatureEvents.begin(); e != LLWorldMap::getInstance()->mMatureEvents.end(); ++e)
-        {
-            if (!e->mSelected)
-            {
-                drawGenericItem(*e, sEventMatureImage);       
-            }
-        }
-    }
-	if (show_adult)
-    {
-        for (e = LLWorldMap::getInstance()->mAdultEvents.begin(); e != LLWorldMap::getInstance()->mAdultEvents.end(); ++e)
-        {
-            if (!e->mSelected)
-            {
-                drawGenericItem(*e, sEventAdultImage);       
-            }
-        }
-    }
-    // Then the selected events
-	if (show_pg)
+	for (e = mature_visible.begin(); e != mature_visible.end(); ++e)
 	{
-		for (e = LLWorldMap::getInstance()->mPGEvents.begin(); e != LLWorldMap::getInstance()->mPGEvents.end(); ++e)
+		if (!mature_events[*e].mSelected)
 		{
-			if (e->mSelected)
-			{
-				drawGenericItem(*e, sEventImage);
-			}
+			drawGenericItem(mature_events[*e], sEventMatureImage);
+		}
+	}
+	for (e = adult_visible.begin(); e != adult_visible.end(); ++e)
+	{
+		if (!adult_events[*e].mSelected)
+		{
+			drawGenericItem(adult_events[*e], sEventAdultImage);
+		}
+	}
+	// Then the selected events
+	for (e = pg_visible.begin(); e != pg_visible.end(); ++e)
+	{
+		if (pg_events[*e].mSelected)
+		{
+			drawGenericItem(pg_events[*e], sEventImage);
+		}
+	}
+	for (e = mature_visible.begin(); e != mature_visible.end(); ++e)
+	{
+		if (mature_events[*e].mSelected)
+		{
+			drawGenericItem(mature_events[*e], sEventMatureImage);
+		}
+	}
+	for (e = adult_visible.begin(); e != adult_visible.end(); ++e)
+	{
+		if (adult_events[*e].mSelected)
+		{
+			drawGenericItem(adult_events[*e], sEventAdultImage);
 		}
 	}
-    if (show_mature)
-    {
-        for (e = LLWorldMap::getInstance()->mMatureEvents.begin(); e != LLWorldMap::getInstance()->mMatureEvents.end(); ++e)
-        {
-            if (e->mSelected)
-            {
-                drawGenericItem(*e, sEventMatureImage);       
-            }
-        }
-    }
-	if (show_adult)
-    {
-        for (e = LLWorldMap::getInstance()->mAdultEvents.begin(); e != LLWorldMap::getInstance()->mAdultEvents.end(); ++e)
-        {
-            if (e->mSelected)
-            {
-                drawGenericItem(*e, sEventAdultImage);       
-            }
-        }
-    }
 }
 
 
@@ -1182,6 +1255,19 @@ LLVector3 LLWorldMapView::globalPosToView( const LLVector3d& global_pos )
 }
 
 
+void LLWorldMapView::getGlobalViewRect(F32 margin, F64& min_x, F64& min_y, F64& max_x, F64& max_y)
+{
+	LLVector3d camera_global = gAgent.getCameraPositionGlobal();
+	F64 meters_per_pixel = REGION_WIDTH_METERS / sMapScale;
+	F32 left = -(getRect().getWidth() / 2.f + sPanX) - margin;
+	F32 bottom = -(getRect().getHeight() / 2.f + sPanY) - margin;
+	min_x = camera_global.mdV[VX] + left * meters_per_pixel;
+	min_y = camera_global.mdV[VY] + bottom * meters_per_pixel;
+	max_x = camera_global.mdV[VX] + (left + getRect().getWidth() + 2.f * margin) * meters_per_pixel;
+	max_y = camera_global.mdV[VY] + (bottom + getRect().getHeight() + 2.f * margin) * meters_per_pixel;
+}
+
+
 void LLWorldMapView::drawTracking(const LLVector3d& pos_global, const LLColor4& color, BOOL draw_arrow,
 								  const std::string& label, const std::string& tooltip, S32 vert_offset )
 {
@@ -1876,16 +1962,30 @@ BOOL LLWorldMapView::handleMouseUp( S32 x, S32 y, MASK mask )
 	return FALSE;
 }
 
-U32 LLWorldMapView::updateBlock(S32 block_x, S32 block_y)
+U32 LLWorldMapView::updateBlocks(S32 block_x_lo, S32 block_x_hi, S32 block_y, U32 max_blocks)
 {
+	BOOL* block_loaded = LLWorldMap::getInstance()->mMapBlockLoaded[LLWorldMap::getInstance()->mCurrentMap];
 	U32 blocks_requested = 0;
-	S32 offset = block_x | (block_y * MAP_BLOCK_RES);
-	if (!LLWorldMap::getInstance()->mMapBlockLoaded[LLWorldMap::getInstance()->mCurrentMap][offset])
+	S32 block_x = block_x_lo;
+	while (block_x <= block_x_hi && blocks_requested < max_blocks)
 	{
-// 		llinfos << "Loading Block (" << block_x << "," << block_y << ")" << llendl;
-		LLWorldMap::getInstance()->sendMapBlockRequest(block_x << 3, block_y << 3, (block_x << 3) + 7, (block_y << 3) + 7);
-		LLWorldMap::getInstance()->mMapBlockLoaded[LLWorldMap::getInstance()->mCurrentMap][offset] = TRUE;
-		blocks_requested++;
+		if (block_loaded[block_x | (block_y * MAP_BLOCK_RES)])
+		{
+			++block_x;
+			continue;
+		}
+
+		// Ask for the blocks not loaded next to this one in the same request.
+		S32 first_block_x = block_x;
+		while (block_x <= block_x_hi && blocks_requested < max_blocks &&
+			   !block_loaded[block_x | (block_y * MAP_BLOCK_RES)])
+		{
+			block_loaded[block_x | (block_y * MAP_BLOCK_RES)] = TRUE;
+			++blocks_requested;
+			++block_x;
+		}
+// 		llinfos << "Loading Blocks (" << first_block_x << "-" << block_x - 1 << "," << block_y << ")" << llendl;
+		LLWorldMap::getInstance()->sendMapBlockRequest(first_block_x << 3, block_y << 3, (block_x << 3) - 1, (block_y << 3) + 7);
 	}
 	return blocks_requested;
 }
@@ -1910,22 +2010,27 @@ U32 LLWorldMapView::updateVisibleBlocks()
 	S32 world_center_y_hi = S32(((-sPanY + height/2)/ pixels_per_region) + (camera_global.mdV[1] / REGION_WIDTH_METERS));
 	
 	// Find the corresponding 8x8 block
-	S32 world_block_x_lo = world_center_x_lo >> 3;
-	S32 world_block_x_hi = world_center_x_hi >> 3;
-	S32 world_block_y_lo = world_center_y_lo >> 3;
-	S32 world_block_y_hi = world_center_y_hi >> 3;
+	S32 world_block_x_lo = llmax(world_center_x_lo >> 3, 0);
+	S32 world_block_x_hi = llmin(world_center_x_hi >> 3, MAP_BLOCK_RES-1);
+	S32 world_block_y_lo = llmax(world_center_y_lo >> 3, 0);
+	S32 world_block_y_hi = llmin(world_center_y_hi >> 3, MAP_BLOCK_RES-1);
 	
 	U32 blocks_requested = 0;
 	const U32 max_blocks_requested = 9;
 
-	for (S32 block_x = llmax(world_block_x_lo, 0); block_x <= llmin(world_block_x_hi, MAP_BLOCK_RES-1); ++block_x)
+	// Rows of blocks from the middle of the view out, so that what is
+	// nearest it comes first.
+	S32 world_block_y_mid = (world_block_y_lo + world_block_y_hi) / 2;
+	for (S32 i = 0; i <= 2 * (world_block_y_hi - world_block_y_lo); ++i)
 	{
-		for (S32 block_y = llmax(world_block_y_lo, 0); block_y <= llmin(world_block_y_hi, MAP_BLOCK_RES-1); ++block_y)
+		S32 block_y = world_block_y_mid + ((i & 1) ? -(i + 1) / 2 : i / 2);
+		if (block_y < world_block_y_lo || block_y > world_block_y_hi)
 		{
-			blocks_requested += updateBlock(block_x, block_y);
-			if (blocks_requested >= max_blocks_requested)
-				return blocks_requested;
+			continue;
 		}
+		blocks_requested += updateBlocks(world_block_x_lo, world_block_x_hi, block_y, max_blocks_requested - blocks_requested);
+		if (blocks_requested >= max_blocks_requested)
+			return blocks_requested;
 	}
 	return blocks_requested;
 } 
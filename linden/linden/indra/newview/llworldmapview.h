@@ -85,9 +85,12 @@ public:
 
 	LLVector3		globalPosToView(const LLVector3d& global_pos);
 	LLVector3d		viewPosToGlobal(S32 x,S32 y);
+	// The part of the world in the view, in global meters, with margin
+	// pixels more on each side
+	void			getGlobalViewRect(F32 margin, F64& min_x, F64& min_y, F64& max_x, F64& max_y);
 
 	virtual void	draw();
-	void			drawGenericItems(const LLWorldMap::item_info_list_t& items, LLUIImagePtr image);
+	void			drawGenericItems(const LLItemInfoList& items, LLUIImagePtr image);
 	void			drawGenericItem(const LLItemInfo& item, LLUIImagePtr image);
 	void			drawImage(const LLVector3d& global_pos, LLUIImagePtr image, const LLColor4& color = LLColor4::white);
 	void			drawImageStack(const LLVector3d& global_pos, LLUIImagePtr image, U32 count, F32 offset, const LLColor4& color);
@@ -131,7 +134,7 @@ public:
 
 	// if the view changes, download additional sim info as needed
 	// return value is number of blocks newly requested.
-	U32				updateBlock(S32 block_x, S32 block_y);
+	U32				updateBlocks(S32 block_x_lo, S32 block_x_hi, S32 block_y, U32 max_blocks);
 	U32				updateVisibleBlocks();
 
 protected:
@@ -1548,7 +1548,10 @@ void LLPipeline::doOcclusion(LLCamera& camera)
 		for (LLCullResult::sg_list_t::iterator iter = sCull->beginOcclusionGroups(); iter != sCull->endOcclusionGroups(); ++iter)
 		{
 			LLSpatialGroup* group = *iter;
-			group->doOcclusion(&camera);
+			if (group->isOcclusionDue())
+			{ //occluded groups are asked again each frame, or less often while the view holds still
+				group->doOcclusion(&camera);
+			}
 			group->clearState(LLSpatialGroup::ACTIVE_OCCLUSION);
 		}
 	}
@@ -38,6 +38,10 @@
 
 #include "llcontrol.h"
 #include "llsdserialize.h"
+#include "lltimer.h"
+#include "v3math.h"
+#include "v4color.h"
+#include "v4coloru.h"
 
 namespace tut
 {
@@ -145,4 +149,129 @@ namespace tut
 		ensure("listener fired on changed setting", mListenerFired);	   
 	}
 
+	//handles
+	template<> template<>
+	void control_group_t::test<5>()
+	{
+		mCG->loadFromFile(mTestConfigFile.c_str());
+		LLControlHandle<U32> handle(*mCG, "TestSetting");
+		ensure("bound", handle.isBound());
+		ensure_equals("loaded value", handle.get(), 12);
+		mCG->setU32("TestSetting", 13);
+		ensure_equals("set by name", (U32)handle, 13);
+
+		mListenerFired = false;
+		mCG->getControl("TestSetting")->getSignal()->connect(boost::bind(&this->handleListenerTest, _1));
+		handle.set(14);
+		ensure("listener fired on handle set", mListenerFired);
+		ensure_equals("set by handle", mCG->getU32("TestSetting"), 14);
+
+		handle.getControl()->setValue(15, FALSE);
+		ensure_equals("unsaved value", handle.get(), 15);
+		mCG->resetToDefaults();
+		ensure_equals("reset", handle.get(), (U32)handle.getControl()->getDefault().asInteger());
+	}
+
+	//handles of every type read what the getters do, and save the same
+	template<> template<>
+	void control_group_t::test<6>()
+	{
+		mCG->declareBOOL("TestBOOL", FALSE, "test");
+		mCG->declareS32("TestS32", -3, "test");
+		mCG->declareF32("TestF32", 0.25f, "test");
+		mCG->declareString("TestString", "text", "test");
+		mCG->declareVec3("TestVec3", LLVector3(1.f, 2.f, 3.f), "test");
+		mCG->declareRect("TestRect", LLRect(1, 4, 3, 2), "test");
+		mCG->declareColor4("TestColor4", LLColor4(0.1f, 0.2f, 0.3f, 0.4f), "test");
+		mCG->declareColor4U("TestColor4U", LLColor4U(10, 20, 30, 40), "test");
+
+		LLControlHandle<bool> bool_handle(*mCG, "TestBOOL");
+		LLControlHandle<S32> s32_handle(*mCG, "TestS32");
+		LLControlHandle<F32> f32_handle(*mCG, "TestF32");
+		LLControlHandle<std::string> string_handle(*mCG, "TestString");
+		LLControlHandle<LLVector3> vec3_handle(*mCG, "TestVec3");
+		LLControlHandle<LLRect> rect_handle(*mCG, "TestRect");
+		LLControlHandle<LLColor4> color4_handle(*mCG, "TestColor4");
+		LLControlHandle<LLColor4U> color4u_handle(*mCG, "TestColor4U");
+
+		ensure_equals("bool", bool_handle.get(), false);
+		ensure_equals("S32", s32_handle.get(), -3);
+		ensure_equals("F32", f32_handle.get(), 0.25f);
+		ensure_equals("string", string_handle.get(), std::string("text"));
+		ensure("vec3", vec3_handle.get() == mCG->getVector3("TestVec3"));
+		ensure("rect", rect_handle.get() == mCG->getRect("TestRect"));
+		ensure("color4", color4_handle.get() == mCG->getColor4("TestColor4"));
+		ensure("color4u", color4u_handle.get() == mCG->getColor4U("TestColor4U"));
+
+		bool_handle.set(true);
+		s32_handle.set(7);
+		f32_handle.set(1.5f);
+		string_handle.set("other");
+		vec3_handle.set(LLVector3(4.f, 5.f, 6.f));
+		rect_handle.set(LLRect(5, 8, 7, 6));
+		color4_handle.set(LLColor4(0.5f, 0.6f, 0.7f, 0.8f));
+		color4u_handle.set(LLColor4U(50, 60, 70, 80));
+		mCG->setBOOL("TestBOOL", FALSE);
+		ensure_equals("bool set by name", bool_handle.get(), false);
+		bool_handle.set(true);
+
+		std::string temp_test_file = (mTestConfigDir + "setting_handles_temp.xml");
+		mCG->saveToFile(temp_test_file.c_str(), TRUE);
+		LLControlGroup test_cg;
+		ensure_equals("changed settings loaded", test_cg.loadFromFile(temp_test_file.c_str()), (U32)8);
+		ensure("bool saved", test_cg.getBOOL("TestBOOL"));
+		ensure_equals("S32 saved", test_cg.getS32("TestS32"), 7);
+		ensure_equals("F32 saved", test_cg.getF32("TestF32"), 1.5f);
+		ensure_equals("string saved", test_cg.getString("TestString"), std::string("other"));
+		ensure("vec3 saved", test_cg.getVector3("TestVec3") == LLVector3(4.f, 5.f, 6.f));
+		ensure("rect saved", test_cg.getRect("TestRect") == LLRect(5, 8, 7, 6));
+		ensure("color4 saved", test_cg.getColor4("TestColor4") == LLColor4(0.5f, 0.6f, 0.7f, 0.8f));
+		ensure("color4u saved", test_cg.getColor4U("TestColor4U") == LLColor4U(50, 60, 70, 80));
+	}
+
+	//a million lookups by name and by handle
+	template<> template<>
+	void control_group_t::test<7>()
+	{
+		// About as many settings as the viewer has.
+		const S32 NUM_SETTINGS = 1800;
+		const S32 NUM_READ = 64;
+		const S32 NUM_LOOKUPS = 1000000;
+
+		std::vector<std::string> names;
+		for (S32 i = 0; i < NUM_SETTINGS; i++)
+		{
+			names.push_back(llformat("RenderTestSetting%04d", i));
+			mCG->declareF32(names.back(), (F32)i, "benchmark");
+		}
+		// Spread over the table, the way a frame's reads are.
+		std::vector<std::string> read_names;
+		std::vector<LLControlHandle<F32> > handles(NUM_READ);
+		for (S32 i = 0; i < NUM_READ; i++)
+		{
+			read_names.push_back(names[(i * 997) % NUM_SETTINGS]);
+			handles[i].bind(*mCG, read_names[i]);
+		}
+
+		LLTimer timer;
+		F32 name_sum = 0.f;
+		for (S32 i = 0; i < NUM_LOOKUPS; i++)
+		{
+			name_sum += mCG->getF32(read_names[i % NUM_READ]);
+		}
+		F32 name_time = timer.getElapsedTimeF32();
+
+		timer.reset();
+		F32 handle_sum = 0.f;
+		for (S32 i = 0; i < NUM_LOOKUPS; i++)
+		{
+			handle_sum += handles[i % NUM_READ];
+		}
+		F32 handle_time = timer.getElapsedTimeF32();
+
+		llinfos << NUM_LOOKUPS << " lookups of " << NUM_SETTINGS << " settings: "
+				<< name_time * 1000.f << " ms by name, " << handle_time * 1000.f << " ms by handle" << llendl;
+		ensure_equals("same values", handle_sum, name_sum);
+	}
+
 }
@@ -47,8 +47,12 @@ namespace
 
 #include <vector>
 
+#include "llapp.h"
 #include "llerrorcontrol.h"
+#include "llfile.h"
 #include "llsd.h"
+#include "llthread.h"
+#include "lltimer.h"
 
 namespace
 {
@@ -752,13 +756,233 @@ namespace tut
 	}
 }	
 
+namespace
+{
+	const std::string TEST_LOG_FILE("llerror_tut.log");
+
+	std::vector<std::string> readLogFile()
+	{
+		std::vector<std::string> lines;
+		llifstream file(TEST_LOG_FILE);
+		std::string line;
+		while (std::getline(file, line))
+		{
+			lines.push_back(line);
+		}
+		return lines;
+	}
+
+	class LoggingThread : public LLThread
+	{
+	public:
+		LoggingThread(S32 id, S32 count)
+			: LLThread("Logging"), mID(id), mCount(count), mTotal(0.0), mMax(0.0), mDone(0)
+		{ }
+
+		/*virtual*/ void run()
+		{
+			LLTimer timer;
+			for (S32 i = 0; i < mCount; i++)
+			{
+				timer.reset();
+				llinfos << "thread " << mID << " message " << i << llendl;
+				F64 elapsed = timer.getElapsedTimeF64();
+				mTotal += elapsed;
+				mMax = llmax(mMax, elapsed);
+			}
+			mDone = 1;
+		}
+
+		S32 mID;
+		S32 mCount;
+		F64 mTotal;
+		F64 mMax;
+		volatile S32 mDone;
+	};
+}
+
+namespace tut
+{
+	template<> template<>
+		// the file recorder writes everything, in order, once flushed
+	void ErrorTestObject::test<17>()
+	{
+		LLFile::remove(TEST_LOG_FILE);
+		LLError::logToFile(TEST_LOG_FILE);
+		for (int i = 0; i < 1000; ++i)
+		{
+			llinfos << "line " << i << llendl;
+		}
+		LLError::flushLogs();
+
+		std::vector<std::string> lines = readLogFile();
+		ensure_equals("all written", (int)lines.size(), 1000);
+		for (int i = 0; i < 1000; ++i)
+		{
+			std::ostringstream expected;
+			expected << "line " << i;
+			ensure_contains("in order", lines[i], expected.str());
+		}
+		ensure_message_count(1000);
+
+		// a message bigger than the whole buffer is dropped, and counted
+		std::string big(2 << 20, 'x');
+		llinfos << big << llendl;
+		LLError::logToFile("");
+		lines = readLogFile();
+		ensure_equals("big one counted", (int)lines.size(), 1001);
+		ensure_contains("big one", lines[1000], "(1 log messages dropped)");
+		LLFile::remove(TEST_LOG_FILE);
+	}
+
+	template<> template<>
+		// many threads logging to file, with what each call costs
+	void ErrorTestObject::test<18>()
+	{
+		const S32 NUM_THREADS = 4;
+		const S32 NUM_MESSAGES = 50000;
+		LLError::removeRecorder(&mRecorder);
+		LLFile::remove(TEST_LOG_FILE);
+		LLError::logToFile(TEST_LOG_FILE);
+
+		LLTimer timer;
+		std::vector<LoggingThread*> threads;
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			threads.push_back(new LoggingThread(i, NUM_MESSAGES));
+			threads.back()->start();
+		}
+		F64 total = 0.0;
+		F64 max = 0.0;
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			while (!threads[i]->mDone)
+			{
+				ms_sleep(1);
+			}
+			total += threads[i]->mTotal;
+			max = llmax(max, threads[i]->mMax);
+		}
+		F64 elapsed = timer.getElapsedTimeF64();
+		LLError::logToFile("");
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+
+		// Each thread's messages are there in the order it sent them, and
+		// those the writer thread couldn't keep up with are counted.
+		std::vector<std::string> lines = readLogFile();
+		LLFile::remove(TEST_LOG_FILE);
+		std::vector<S32> next(NUM_THREADS, 0);
+		S32 written = 0;
+		S32 dropped = 0;
+		for (U32 i = 0; i < lines.size(); i++)
+		{
+			S32 n = -1;
+			if (sscanf(lines[i].c_str(), "(%d log messages dropped)", &n) == 1)
+			{
+				dropped += n;
+				continue;
+			}
+			std::string::size_type pos = lines[i].find("thread ");
+			if (pos == std::string::npos)
+			{
+				continue;
+			}
+			S32 id = -1;
+			sscanf(lines[i].c_str() + pos, "thread %d message %d", &id, &n);
+			ensure("thread", id >= 0 && id < NUM_THREADS);
+			ensure("in order", n >= next[id]);
+			next[id] = n + 1;
+			written++;
+		}
+		ensure_equals("all accounted for", written + dropped, NUM_THREADS * NUM_MESSAGES);
+
+		// Logging is all redirected while these tests run.
+		S32 count = NUM_THREADS * NUM_MESSAGES;
+		std::cerr << count << " messages from " << NUM_THREADS << " threads logged in " << elapsed
+				<< "s, " << (S32)(count / elapsed) << " per second, " << dropped << " dropped. Per call: "
+				<< (S32)(total * 1e9 / count) << "ns on average, "
+				<< (S32)(max * 1e6) << "us at most" << std::endl;
+	}
+}
+
+namespace
+{
+	// Holds on to the log lock while it records "block", as a thread
+	// that hit llerrs does while the error thread runs.
+	class BlockingRecorder : public LLError::Recorder
+	{
+	public:
+		BlockingRecorder() : mBlocking(0), mRelease(0) { }
+
+		/*virtual*/ void recordMessage(LLError::ELevel level, const std::string& message)
+		{
+			if (message.find("block") != std::string::npos)
+			{
+				mBlocking = 1;
+				while (!mRelease)
+				{
+					ms_sleep(1);
+				}
+			}
+		}
+
+		volatile S32 mBlocking;
+		volatile S32 mRelease;
+	};
+
+	class BlockingThread : public LLThread
+	{
+	public:
+		BlockingThread() : LLThread("Blocking") { }
+
+		/*virtual*/ void run()
+		{
+			llinfos << "block" << llendl;
+		}
+	};
+}
+
+namespace tut
+{
+	template<> template<>
+		// once the app is in error, logging doesn't wait on the log lock
+	void ErrorTestObject::test<19>()
+	{
+		BlockingRecorder blocker;
+		LLError::addRecorder(&blocker);
+		BlockingThread thread;
+		thread.start();
+		while (!blocker.mBlocking)
+		{
+			ms_sleep(1);
+		}
+
+		LLApp::setError();
+		LLTimer timer;
+		llinfos << "while in error" << llendl;
+		F32 elapsed = timer.getElapsedTimeF32();
+
+		blocker.mRelease = 1;
+		ensure("blocking thread stopped", thread.stopAndWait(5000));
+		LLApp::setStopped();
+		LLError::removeRecorder(&blocker);
+		ensure("gave up on the lock", elapsed < 1.f);
+	}
+}
+
 /* Tests left:
 	handling of classes without LOG_CLASS
 
 	live update of filtering from file	
 	
 	syslog recorder
-	file recorder
 	cerr/stderr recorder
 	fixed buffer recorder
 	windows recorder
@@ -0,0 +1,271 @@
+/**
+ * @file llfasttimer_tut.cpp
+ * @brief Tests for the declared fast timers, and what they cost
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include <tut/tut.hpp>
+#include "lltut.h"
+
+#include "llfasttimer.h"
+#include "llfile.h"
+#include "llthread.h"
+#include "lltimer.h"
+
+namespace
+{
+	LLFastTimer::DeclareTimer FTM_TEST_OUTER("Test Outer");
+	LLFastTimer::DeclareTimer FTM_TEST_INNER("Test Inner", &FTM_TEST_OUTER);
+	LLFastTimer::DeclareTimer FTM_TEST_WORKER("Test \"Worker\"");
+	LLFastTimer::DeclareTimer FTM_TEST_OVERHEAD("Test Overhead");
+
+	// Keeps the clock busy for about usec microseconds.
+	void spin(U64 usec)
+	{
+		LLTimer timer;
+		while (timer.getElapsedTimeF64() * 1000000.0 < (F64)usec)
+		{
+		}
+	}
+
+	F64 to_usec(U64 count)
+	{
+		return (F64)count * 1000000.0 / (F64)LLFastTimer::countsPerSecond();
+	}
+
+	class TimedThread : public LLThread
+	{
+	public:
+		TimedThread(S32 calls)
+		:	LLThread("Timed"),
+			mCalls(calls),
+			mDone(0)
+		{
+		}
+
+		/*virtual*/ void run()
+		{
+			for (S32 i = 0; i < mCalls; i++)
+			{
+				LLFastTimer t(FTM_TEST_WORKER);
+				spin(50);
+			}
+			mDone = 1;
+		}
+
+		S32 mCalls;
+		volatile S32 mDone;
+	};
+}
+
+namespace tut
+{
+	struct fasttimer_test
+	{
+		fasttimer_test()
+		{
+			// Starts a clean frame.
+			LLFastTimer::reset();
+		}
+	};
+
+	typedef test_group<fasttimer_test> fasttimer_test_t;
+	typedef fasttimer_test_t::object fasttimer_test_object_t;
+	tut::fasttimer_test_t tut_fasttimer_test("fasttimer");
+
+	template<> template<>
+	void fasttimer_test_object_t::test<1>()
+	{
+		// nested declared timers count their own time only
+		ensure("parent", FTM_TEST_INNER.getParent() == &FTM_TEST_OUTER);
+		ensure_equals("name", FTM_TEST_OUTER.getName(), std::string("Test Outer"));
+		for (S32 i = 0; i < 3; i++)
+		{
+			LLFastTimer outer(FTM_TEST_OUTER);
+			spin(2000);
+			{
+				LLFastTimer inner(FTM_TEST_INNER);
+				spin(6000);
+			}
+		}
+		LLFastTimer::reset();
+
+		ensure_equals("outer calls", FTM_TEST_OUTER.getFrameCalls(), (U64)3);
+		ensure_equals("inner calls", FTM_TEST_INNER.getFrameCalls(), (U64)3);
+		F64 outer = to_usec(FTM_TEST_OUTER.getFrameCount());
+		F64 inner = to_usec(FTM_TEST_INNER.getFrameCount());
+		ensure("outer leaves out inner", outer >= 6000.0 && outer < 12000.0);
+		ensure("inner", inner >= 18000.0 && inner < 30000.0);
+
+		// nothing happened since
+		LLFastTimer::reset();
+		ensure_equals("next frame", FTM_TEST_OUTER.getFrameCalls(), (U64)0);
+	}
+
+	template<> template<>
+	void fasttimer_test_object_t::test<2>()
+	{
+		// other threads' time adds up on the main thread
+		const S32 NUM_THREADS = 4;
+		const S32 NUM_CALLS = 20;
+		std::vector<TimedThread*> threads;
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			threads.push_back(new TimedThread(NUM_CALLS));
+			threads.back()->start();
+		}
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			while (!threads[i]->mDone)
+			{
+				ms_sleep(1);
+			}
+		}
+		LLFastTimer::reset();
+		for (S32 i = 0; i < NUM_THREADS; i++)
+		{
+			while (!threads[i]->isStopped())
+			{
+				ms_sleep(1);
+			}
+			delete threads[i];
+		}
+
+		ensure_equals("calls", FTM_TEST_WORKER.getFrameCalls(), (U64)(NUM_THREADS * NUM_CALLS));
+		ensure("time", to_usec(FTM_TEST_WORKER.getFrameCount()) >= NUM_THREADS * NUM_CALLS * 50.0);
+
+		// ended threads hand their timers on
+		TimedThread* thread = new TimedThread(1);
+		thread->start();
+		while (!thread->mDone)
+		{
+			ms_sleep(1);
+		}
+		LLFastTimer::reset();
+		ensure_equals("reused", FTM_TEST_WORKER.getFrameCalls(), (U64)1);
+		while (!thread->isStopped())
+		{
+			ms_sleep(1);
+		}
+		delete thread;
+	}
+
+	template<> template<>
+	void fasttimer_test_object_t::test<3>()
+	{
+		// the trace is a Chrome trace event array
+		std::string filename("fasttimer_trace.json");
+		ensure("started", LLFastTimer::startTrace(filename));
+		ensure("tracing", LLFastTimer::isTracing());
+		{
+			LLFastTimer outer(FTM_TEST_OUTER);
+			LLFastTimer inner(FTM_TEST_INNER);
+		}
+		{
+			LLFastTimer t(LLFastTimer::FTM_IDLE);
+		}
+		TimedThread thread(2);
+		thread.start();
+		while (!thread.mDone)
+		{
+			ms_sleep(1);
+		}
+		LLFastTimer::reset();
+		LLFastTimer::stopTrace();
+		ensure("stopped", !LLFastTimer::isTracing());
+		while (!thread.isStopped())
+		{
+			ms_sleep(1);
+		}
+
+		std::string trace;
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		ensure("written", fp != NULL);
+		char buffer[1024];		/* Flawfinder: ignore */
+		size_t read;
+		while ((read = fread(buffer, 1, sizeof(buffer), fp)) > 0)
+		{
+			trace.append(buffer, read);
+		}
+		fclose(fp);
+		LLFile::remove(filename);
+
+		ensure("array", trace.size() > 4 && trace[0] == '[' && trace.substr(trace.size() - 4) == "{}]\n");
+		ensure("outer", trace.find("{\"name\":\"Test Outer\",\"ph\":\"X\"") != std::string::npos);
+		ensure("inner", trace.find("{\"name\":\"Test Inner\",\"ph\":\"X\"") != std::string::npos);
+		ensure("fixed", trace.find("{\"name\":\"FTM_IDLE\",\"ph\":\"X\"") != std::string::npos);
+		ensure("escaped", trace.find("\"Test \\\"Worker\\\"\"") != std::string::npos);
+		ensure("thread", trace.find("\"args\":{\"name\":\"Timed\"}") != std::string::npos);
+		ensure("main thread", trace.find("\"args\":{\"name\":\"Main\"}") != std::string::npos);
+	}
+
+	template<> template<>
+	void fasttimer_test_object_t::test<4>()
+	{
+		// what a sample costs, with and without tracing
+		const S32 SAMPLES = 1000000;
+		LLTimer timer;
+		for (S32 i = 0; i < SAMPLES; i++)
+		{
+			LLFastTimer t(LLFastTimer::FTM_IDLE);
+		}
+		F64 fixed_ns = timer.getElapsedTimeF64() * 1e9 / SAMPLES;
+
+		timer.reset();
+		for (S32 i = 0; i < SAMPLES; i++)
+		{
+			LLFastTimer t(FTM_TEST_OVERHEAD);
+		}
+		F64 declared_ns = timer.getElapsedTimeF64() * 1e9 / SAMPLES;
+		LLFastTimer::reset();
+		ensure_equals("counted", FTM_TEST_OVERHEAD.getFrameCalls(), (U64)SAMPLES);
+
+		std::string filename("fasttimer_overhead.json");
+		LLFastTimer::startTrace(filename);
+		timer.reset();
+		for (S32 i = 0; i < SAMPLES; i++)
+		{
+			LLFastTimer t(FTM_TEST_OVERHEAD);
+			if ((i & 4095) == 4095)
+			{
+				// the ring is emptied every frame
+				LLFastTimer::reset();
+			}
+		}
+		F64 traced_ns = timer.getElapsedTimeF64() * 1e9 / SAMPLES;
+		LLFastTimer::stopTrace();
+		LLFile::remove(filename);
+
+		llinfos << "Fast timer overhead per sample: fixed " << fixed_ns << "ns, declared "
+				<< declared_ns << "ns, declared while tracing " << traced_ns << "ns" << llendl;
+	}
+}
@@ -0,0 +1,284 @@
+/**
+ * @file llvocache_tut.cpp
+ * @brief LLVOCache unit tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+#include "linden_common.h"
+
+#include <tut/tut.hpp>
+#include "lltut.h"
+
+#include "../newview/llvocache.cpp" // include TU to pull in the viewer implementation.
+
+#include "llapr.h"
+#include "llrand.h"
+#include "lltimer.h"
+
+namespace
+{
+	const S32 NUM_REGIONS = 3;
+	const S32 OBJECTS_PER_REGION = 5000;
+	const U32 LARGE_CACHE_SIZE = 64 * 1024 * 1024;
+
+	U64 region_handle(S32 i)
+	{
+		return ((U64)(256000 + i * 256) << 32) | (U64)(256000);
+	}
+
+	// Object updates vary in size, roughly like real ones do.
+	S32 object_size(U32 local_id)
+	{
+		return 60 + (local_id * 37) % 400;
+	}
+
+	void fill_object(U8* buffer, U32 local_id, U32 crc)
+	{
+		S32 size = object_size(local_id);
+		for (S32 i = 0; i < size; ++i)
+		{
+			buffer[i] = (U8)(local_id + crc * 7 + i);
+		}
+	}
+
+	BOOL check_object(LLVOCacheEntry* entry, U32 local_id, U32 crc)
+	{
+		U8 expected[1024];
+		fill_object(expected, local_id, crc);
+		return entry
+			&& entry->getCRC() == crc
+			&& entry->getSize() == object_size(local_id)
+			&& !memcmp(entry->getData(), expected, object_size(local_id));
+	}
+
+	void add_objects(LLVOCache& cache, U64 handle, U32 crc)
+	{
+		U8 buffer[1024];
+		for (U32 local_id = 1; local_id <= (U32)OBJECTS_PER_REGION; ++local_id)
+		{
+			fill_object(buffer, local_id, crc);
+			LLDataPackerBinaryBuffer dp(buffer, object_size(local_id));
+			cache.updateEntry(handle, local_id, crc, dp);
+		}
+	}
+
+	S32 file_size(const std::string& filename)
+	{
+		LLAPRFile infile;
+		S32 size = 0;
+		infile.open(filename, LL_APR_RB, LLAPRFile::global, &size);
+		return size;
+	}
+}
+
+namespace tut
+{
+	struct vocache_test
+	{
+		vocache_test()
+		{
+			std::ostringstream oStr;
+			oStr << "/tmp/llvocache-test-" << ll_rand() << ".slc";
+			mFilename = oStr.str();
+			for (S32 i = 0; i < NUM_REGIONS; ++i)
+			{
+				mCacheIDs[i].generate();
+			}
+		}
+
+		~vocache_test()
+		{
+			LLAPRFile::remove(mFilename);
+		}
+
+		// Fills a store with NUM_REGIONS * OBJECTS_PER_REGION objects.
+		void populate(U32 crc)
+		{
+			LLVOCache cache;
+			cache.initCache(mFilename, LARGE_CACHE_SIZE, FALSE);
+			for (S32 i = 0; i < NUM_REGIONS; ++i)
+			{
+				cache.openRegion(region_handle(i), mCacheIDs[i]);
+				add_objects(cache, region_handle(i), crc);
+			}
+
+			LLTimer timer;
+			for (S32 i = 0; i < NUM_REGIONS; ++i)
+			{
+				cache.flushRegion(region_handle(i));
+			}
+			llinfos << "Saved " << cache.getNumEntries() << " objects in "
+				<< timer.getElapsedTimeF32() << " seconds" << llendl;
+			cache.destroyClass();
+		}
+
+		std::string mFilename;
+		LLUUID mCacheIDs[NUM_REGIONS];
+	};
+
+	typedef test_group<vocache_test> vocache_test_t;
+	typedef vocache_test_t::object vocache_test_object_t;
+	tut::vocache_test_t tut_vocache_test("vocache_test");
+
+	template<> template<>
+	void vocache_test_object_t::test<1>()
+	{
+		// round trip through the store
+		populate(1);
+
+		LLTimer timer;
+		LLVOCache cache;
+		cache.initCache(mFilename, LARGE_CACHE_SIZE, FALSE);
+		F32 load_time = timer.getElapsedTimeF32();
+		ensure_equals("entries loaded", cache.getNumEntries(), NUM_REGIONS * OBJECTS_PER_REGION);
+		ensure_equals("nothing stale", cache.getStaleBytes(), 0);
+
+		timer.reset();
+		for (S32 i = 0; i < NUM_REGIONS; ++i)
+		{
+			cache.openRegion(region_handle(i), mCacheIDs[i]);
+			for (U32 local_id = 1; local_id <= (U32)OBJECTS_PER_REGION; ++local_id)
+			{
+				ensure("entry matches", check_object(cache.getEntry(region_handle(i), local_id), local_id, 1));
+			}
+		}
+		F32 lookup_time = timer.getElapsedTimeF32();
+		llinfos << "Loaded " << cache.getNumEntries() << " objects in " << load_time
+			<< " seconds, looked them all up in " << lookup_time << " seconds" << llendl;
+
+		ensure("unknown object", cache.getEntry(region_handle(0), OBJECTS_PER_REGION + 1) == NULL);
+		ensure("unknown region", cache.getEntry(region_handle(NUM_REGIONS), 1) == NULL);
+		cache.destroyClass();
+	}
+
+	template<> template<>
+	void vocache_test_object_t::test<2>()
+	{
+		// only changed objects are written back
+		populate(1);
+		S32 full_size = file_size(mFilename);
+
+		LLVOCache cache;
+		cache.initCache(mFilename, LARGE_CACHE_SIZE, FALSE);
+		cache.openRegion(region_handle(0), mCacheIDs[0]);
+		U8 buffer[1024];
+		fill_object(buffer, 10, 2);
+		LLDataPackerBinaryBuffer dp(buffer, object_size(10));
+		cache.updateEntry(region_handle(0), 10, 2, dp);
+
+		LLTimer timer;
+		cache.flushRegion(region_handle(0));
+		llinfos << "Saved one changed object in " << timer.getElapsedTimeF32() << " seconds" << llendl;
+		S32 grown = file_size(mFilename) - full_size;
+		ensure("one record appended", grown > object_size(10) && grown < object_size(10) + 64);
+		cache.destroyClass();
+
+		LLVOCache reread;
+		reread.initCache(mFilename, LARGE_CACHE_SIZE, TRUE);
+		ensure("new version read back", check_object(reread.getEntry(region_handle(0), 10), 10, 2));
+		ensure("others untouched", check_object(reread.getEntry(region_handle(0), 11), 11, 1));
+		ensure("old version is stale", reread.getStaleBytes() > 0);
+		reread.destroyClass();
+	}
+
+	template<> template<>
+	void vocache_test_object_t::test<3>()
+	{
+		// a new cache id drops the region's objects and nothing else
+		populate(1);
+
+		LLVOCache cache;
+		cache.initCache(mFilename, LARGE_CACHE_SIZE, FALSE);
+		LLUUID new_id;
+		new_id.generate();
+		cache.openRegion(region_handle(0), new_id);
+		ensure("region dropped", cache.getEntry(region_handle(0), 1) == NULL);
+		ensure("other region kept", check_object(cache.getEntry(region_handle(1), 1), 1, 1));
+		cache.destroyClass();
+
+		LLVOCache reread;
+		reread.initCache(mFilename, LARGE_CACHE_SIZE, TRUE);
+		ensure_equals("dropped on disk", reread.getNumEntries(), (NUM_REGIONS - 1) * OBJECTS_PER_REGION);
+		reread.destroyClass();
+	}
+
+	template<> template<>
+	void vocache_test_object_t::test<4>()
+	{
+		// least recently used objects go first
+		populate(1);
+
+		LLVOCache probe;
+		probe.initCache(mFilename, LARGE_CACHE_SIZE, TRUE);
+		S32 region_bytes = probe.getTotalBytes() / NUM_REGIONS;
+		probe.destroyClass();
+
+		LLVOCache cache;
+		cache.initCache(mFilename, region_bytes * 2, FALSE);
+		ensure("limit enforced on load", cache.getTotalBytes() <= region_bytes * 2);
+		ensure("oldest region evicted", cache.getEntry(region_handle(0), 1) == NULL);
+
+		// touch the oldest surviving object, then push new ones in
+		ensure("touched", cache.getEntry(region_handle(1), 1) != NULL);
+		add_objects(cache, region_handle(0), 3);
+		ensure("limit enforced on update", cache.getTotalBytes() <= region_bytes * 2);
+		ensure("recently used kept", check_object(cache.getEntry(region_handle(1), 1), 1, 1));
+		ensure("least recently used evicted", cache.getEntry(region_handle(1), 2) == NULL);
+		cache.destroyClass();
+	}
+
+	template<> template<>
+	void vocache_test_object_t::test<5>()
+	{
+		// corrupt payloads are caught when they are first used
+		populate(1);
+
+		// object 1 of the first region directly follows the file header
+		// and the region's record
+		LLAPRFile outfile;
+		outfile.open(mFilename, LL_APR_RPB, LLAPRFile::global);
+		S32 offset = 16 + (sizeof(LLVOCacheRecord) + UUID_BYTES) + sizeof(LLVOCacheRecord) + 5;
+		U8 garbage = 0xff;
+		outfile.seek(APR_SET, offset);
+		outfile.write(&garbage, 1);
+		outfile.close();
+
+		LLVOCache cache;
+		cache.initCache(mFilename, LARGE_CACHE_SIZE, FALSE);
+		ensure_equals("corruption not noticed on load", cache.getNumEntries(), NUM_REGIONS * OBJECTS_PER_REGION);
+		ensure("corrupt entry dropped", cache.getEntry(region_handle(0), 1) == NULL);
+		ensure("next entry fine", check_object(cache.getEntry(region_handle(0), 2), 2, 1));
+		cache.destroyClass();
+
+		LLVOCache reread;
+		reread.initCache(mFilename, LARGE_CACHE_SIZE, TRUE);
+		ensure_equals("removal written", reread.getNumEntries(), NUM_REGIONS * OBJECTS_PER_REGION - 1);
+		reread.destroyClass();
+	}
+}
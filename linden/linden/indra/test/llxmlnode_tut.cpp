@@ -0,0 +1,191 @@
+/**
+ * @file llxmlnode_tut.cpp
+ * @brief LLXMLNode binary form unit tests
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+#include "linden_common.h"
+
+#include <tut/tut.hpp>
+#include "lltut.h"
+
+#include "llxmlnode.h"
+
+namespace
+{
+	const char* TEST_XML =
+		"<?xml version=\"1.0\" encoding=\"utf-8\" standalone=\"yes\" ?>\n"
+		"<floater name=\"test\" title=\"Test &amp; more\" width=\"320\" height=\"200\" can_close=\"true\">\n"
+		"	<button name=\"ok\" label=\"OK\" left=\"10\" bottom=\"-30\" width=\"90\" height=\"20\" />\n"
+		"	<text name=\"label\" font=\"SansSerif\">Some text</text>\n"
+		"	<button name=\"cancel\" label=\"Cancel\" left_delta=\"100\" bottom_delta=\"0\" />\n"
+		"	<data id=\"d1\" type=\"integer\" length=\"3\" precision=\"16\" encoding=\"decimal\" version=\"2.5\">26 43 60</data>\n"
+		"	<panel name=\"inner\">\n"
+		"		<text name=\"label\">\"Escaped \\\"quote\\\"\"</text>\n"
+		"		<check_box name=\"check\" initial_value=\"false\" />\n"
+		"	</panel>\n"
+		"</floater>\n";
+
+	const char* TEST_UPDATE_XML =
+		"<floater name=\"test\" title=\"Prueba\">\n"
+		"	<button name=\"ok\" label=\"Aceptar\" />\n"
+		"	<panel name=\"inner\">\n"
+		"		<text name=\"label\">Etiqueta</text>\n"
+		"	</panel>\n"
+		"</floater>\n";
+
+	std::string to_string(LLXMLNodePtr node)
+	{
+		std::ostringstream str;
+		node->writeToOstream(str);
+		return str.str();
+	}
+
+	LLXMLNodePtr parse(const char* xml)
+	{
+		LLXMLNodePtr node;
+		LLXMLNode::parseBuffer(xml, (U32)strlen(xml), node, NULL);
+		return node;
+	}
+}
+
+namespace tut
+{
+	struct xmlnode_binary
+	{
+	};
+
+	typedef test_group<xmlnode_binary> xmlnode_binary_t;
+	typedef xmlnode_binary_t::object xmlnode_binary_object_t;
+	tut::xmlnode_binary_t tut_xmlnode_binary("xmlnode_binary");
+
+	template<> template<>
+	void xmlnode_binary_object_t::test<1>()
+	{
+		// a parsed tree comes back unchanged
+		LLXMLNodePtr parsed = parse(TEST_XML);
+		ensure("parsed", parsed->hasName("floater"));
+
+		std::vector<U8> buffer;
+		parsed->writeBinary(buffer);
+		LLXMLNodePtr loaded;
+		ensure("loaded", LLXMLNode::parseBinary(&buffer[0], (U32)buffer.size(), loaded));
+		ensure_equals("same tree", to_string(loaded), to_string(parsed));
+
+		std::vector<U8> again;
+		loaded->writeBinary(again);
+		ensure("same binary", again == buffer);
+
+		// children keep their order, attributes their values
+		LLXMLNodePtr child = loaded->getFirstChild();
+		ensure_equals("first", child->getName()->mString, std::string("button"));
+		child = child->getNextSibling();
+		ensure_equals("second", child->getName()->mString, std::string("text"));
+		ensure_equals("text value", child->getValue(), std::string("Some text"));
+		S32 width = 0;
+		ensure("width", loaded->getAttributeS32("width", width));
+		ensure_equals("width value", width, 320);
+		std::string title;
+		ensure("title", loaded->getAttributeString("title", title));
+		ensure_equals("title value", title, std::string("Test & more"));
+
+		// the special attributes are stored converted
+		LLXMLNodePtr data;
+		ensure("data", loaded->getChild("data", data));
+		ensure_equals("id", data->mID, std::string("d1"));
+		ensure_equals("type", (S32)data->mType, (S32)LLXMLNode::TYPE_INTEGER);
+		ensure_equals("encoding", (S32)data->mEncoding, (S32)LLXMLNode::ENCODING_DECIMAL);
+		ensure_equals("length", data->mLength, 3U);
+		ensure_equals("precision", data->mPrecision, 16U);
+		ensure_equals("version", data->mVersionMajor, 2U);
+		ensure_equals("minor", data->mVersionMinor, 5U);
+		U32 values[3];
+		ensure_equals("values", data->getUnsignedValue(3, values), 3U);
+		ensure_equals("value", values[2], 60U);
+
+		// names are interned like the parser does it
+		ensure("interned", child->getName() == parsed->getFirstChild()->getNextSibling()->getName());
+	}
+
+	template<> template<>
+	void xmlnode_binary_object_t::test<2>()
+	{
+		// a localized layer merged on top survives too
+		LLXMLNodePtr root = parse(TEST_XML);
+		LLXMLNodePtr update = parse(TEST_UPDATE_XML);
+		ensure("merged", LLXMLNode::updateNode(root, update));
+
+		std::vector<U8> buffer;
+		root->writeBinary(buffer);
+		LLXMLNodePtr loaded;
+		ensure("loaded", LLXMLNode::parseBinary(&buffer[0], (U32)buffer.size(), loaded));
+		ensure_equals("same tree", to_string(loaded), to_string(root));
+		std::string label;
+		LLXMLNodePtr ok;
+		ensure("ok", loaded->getChild("button", ok));
+		ensure("label", ok->getAttributeString("label", label));
+		ensure_equals("translated", label, std::string("Aceptar"));
+	}
+
+	template<> template<>
+	void xmlnode_binary_object_t::test<3>()
+	{
+		// anything damaged or stale is refused
+		std::vector<U8> buffer;
+		parse(TEST_XML)->writeBinary(buffer);
+		LLXMLNodePtr loaded;
+
+		for (U32 length = 0; length < buffer.size(); length += 7)
+		{
+			ensure("truncated", !LLXMLNode::parseBinary(&buffer[0], length, loaded));
+			ensure("empty node", loaded.notNull() && loaded->isNull());
+		}
+
+		std::vector<U8> longer = buffer;
+		longer.push_back(0);
+		ensure("trailing bytes", !LLXMLNode::parseBinary(&longer[0], (U32)longer.size(), loaded));
+
+		std::vector<U8> versioned = buffer;
+		versioned[4]++;
+		ensure("other version", !LLXMLNode::parseBinary(&versioned[0], (U32)versioned.size(), loaded));
+
+		// written under other strip settings, the parser would have done differently
+		BOOL strip = LLXMLNode::sStripWhitespaceValues;
+		LLXMLNode::sStripWhitespaceValues = !strip;
+		ensure("other settings", !LLXMLNode::parseBinary(&buffer[0], (U32)buffer.size(), loaded));
+		LLXMLNode::sStripWhitespaceValues = strip;
+		ensure("loads again", LLXMLNode::parseBinary(&buffer[0], (U32)buffer.size(), loaded));
+
+		// impossible child counts
+		std::vector<U8> garbled = buffer;
+		memset(&garbled[garbled.size() - 8], 0xff, 8);
+		ensure("garbled", !LLXMLNode::parseBinary(&garbled[0], (U32)garbled.size(), loaded));
+	}
+}
@@ -0,0 +1,385 @@
+/**
+ * @file llmessagereplay.cpp
+ * @brief Replays a message capture through the message system and
+ * reports where the time went, per message type.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Usage:
+//   llmessagereplay [-t message_template.msg] <capture>
+//     Feeds every incoming packet in the capture through the message
+//     system as fast as it will take them, then prints the time spent
+//     unpacking and handling each message type.
+//   llmessagereplay [-t message_template.msg] --generate <capture> <count>
+//     Writes a synthetic capture of count messages with random contents,
+//     drawn from every template. The contents only depend on count, so
+//     the same capture can be regenerated anywhere for comparisons.
+//
+// Viewer captures are written by setting the MessageCapture debug
+// setting, see LLMessageLog::startCapture().
+
+#include "linden_common.h"
+
+#include <algorithm>
+#include <iostream>
+#include <set>
+
+#include "llerrorcontrol.h"
+#include "llmessagecapture.h"
+#include "llmessagelog.h"
+#include "llmessagetemplate.h"
+#include "lltimer.h"
+#include "message.h"
+
+namespace
+{
+	// The message system handles these itself. Random contents would
+	// tear down circuits, so they are neither generated nor timed.
+	const char* SYSTEM_MESSAGES[] =
+	{
+		"PacketAck",
+		"StartPingCheck",
+		"CompletePingCheck",
+		"OpenCircuit",
+		"CloseCircuit",
+		"AddCircuitCode",
+		"UseCircuitCode",
+		"CreateTrustedCircuit",
+		"DenyTrustedCircuit",
+		"RequestTrustedCircuit",
+		"Error",
+		"TransferRequest",
+		"TransferInfo",
+		"TransferPacket",
+		"TransferAbort",
+		NULL
+	};
+
+	const LLHost SYNTHETIC_SIM(0x0100000a, 13000);	// 10.0.0.1
+
+	LLMessageCaptureWriter* sSyntheticWriter = NULL;
+
+	bool is_system_message(const char* name)
+	{
+		for (S32 i = 0; SYSTEM_MESSAGES[i]; ++i)
+		{
+			if (!strcmp(name, SYSTEM_MESSAGES[i]))
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool template_less(const LLMessageTemplate* a, const LLMessageTemplate* b)
+	{
+		return strcmp(a->mName, b->mName) < 0;
+	}
+
+	// Templates we generate and time, in name order so that generated
+	// captures don't depend on where the string table put the names.
+	std::vector<LLMessageTemplate*> get_templates(LLMessageSystem* msg)
+	{
+		std::vector<LLMessageTemplate*> templates;
+		for (LLMessageSystem::message_template_name_map_t::iterator iter = msg->mMessageTemplates.begin();
+			 iter != msg->mMessageTemplates.end(); ++iter)
+		{
+			LLMessageTemplate* mt = iter->second;
+			if (!is_system_message(mt->mName) && mt->getDeprecation() == MD_NOTDEPRECATED)
+			{
+				templates.push_back(mt);
+			}
+		}
+		std::sort(templates.begin(), templates.end(), template_less);
+		return templates;
+	}
+
+	// Stands in for a real handler: reads every variable of every block.
+	void process_any_message(LLMessageSystem* msg, void** user_data)
+	{
+		const LLMessageTemplate* mt = (const LLMessageTemplate*)user_data;
+		U8 buffer[MAX_BUFFER_SIZE];		/* Flawfinder: ignore */
+		for (LLMessageTemplate::message_block_map_t::const_iterator block_iter = mt->mMemberBlocks.begin();
+			 block_iter != mt->mMemberBlocks.end(); ++block_iter)
+		{
+			const LLMessageBlock* block = *block_iter;
+			S32 count = msg->getNumberOfBlocksFast(block->mName);
+			for (S32 i = 0; i < count; ++i)
+			{
+				for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = block->mMemberVariables.begin();
+					 var_iter != block->mMemberVariables.end(); ++var_iter)
+				{
+					msg->getBinaryDataFast(block->mName, (*var_iter)->getName(), buffer, 0, i, sizeof(buffer));
+				}
+			}
+		}
+	}
+
+	// Park-Miller, so generated captures are the same on every platform.
+	U32 sSeed = 1;
+	U32 next_random()
+	{
+		sSeed = (U32)(((U64)sSeed * 48271) % 0x7fffffff);
+		return sSeed;
+	}
+
+	void capture_synthetic(LLMessageLogEntry entry)
+	{
+		// Everything we "send" is recorded as if the sim had sent it to us.
+		// Unlike the viewer we can afford to wait for the disk.
+		while (TRUE)
+		{
+			U32 dropped = sSyntheticWriter->getNumDropped();
+			sSyntheticWriter->write(SYNTHETIC_SIM, entry.mFromHost, &entry.mData[0], entry.mDataSize, TRUE);
+			if (sSyntheticWriter->getNumDropped() == dropped)
+			{
+				break;
+			}
+			ms_sleep(1);
+		}
+	}
+
+	int generate(LLMessageSystem* msg, const std::string& filename, S32 count)
+	{
+		// On the heap, as it can't be deleted if its thread won't stop.
+		LLMessageCaptureWriter* writer = new LLMessageCaptureWriter(filename);
+		if (!writer->isOpen())
+		{
+			delete writer;
+			return 1;
+		}
+		sSyntheticWriter = writer;
+		LLMessageLog::setMaxSize(0);
+		LLMessageLog::setCallback(capture_synthetic);
+		msg->enableCircuit(SYNTHETIC_SIM, TRUE);
+
+		std::vector<LLMessageTemplate*> templates = get_templates(msg);
+		U8 buffer[MAX_BUFFER_SIZE];		/* Flawfinder: ignore */
+		S32 generated = 0;
+		while (generated < count)
+		{
+			LLMessageTemplate* mt = templates[next_random() % templates.size()];
+			msg->newMessageFast(mt->mName);
+			for (LLMessageTemplate::message_block_map_t::const_iterator block_iter = mt->mMemberBlocks.begin();
+				 block_iter != mt->mMemberBlocks.end(); ++block_iter)
+			{
+				const LLMessageBlock* block = *block_iter;
+				S32 blocks = 1;
+				if (block->mType == MBT_MULTIPLE)
+				{
+					blocks = block->mNumber;
+				}
+				else if (block->mType == MBT_VARIABLE)
+				{
+					blocks = 1 + next_random() % 3;
+				}
+				for (S32 i = 0; i < blocks; ++i)
+				{
+					msg->nextBlockFast(block->mName);
+					for (LLMessageBlock::message_variable_map_t::const_iterator var_iter = block->mMemberVariables.begin();
+						 var_iter != block->mMemberVariables.end(); ++var_iter)
+					{
+						const LLMessageVariable* var = *var_iter;
+						S32 size = var->getSize();
+						if (var->getType() == MVT_VARIABLE)
+						{
+							size = 1 + next_random() % 63;
+						}
+						for (S32 j = 0; j < size; ++j)
+						{
+							buffer[j] = (U8)next_random();
+						}
+						msg->addBinaryDataFast(var->getName(), buffer, size);
+					}
+				}
+			}
+
+			if (msg->getCurrentSendTotal() > MTUBYTES - 100)
+			{
+				// Wouldn't fit in a packet, pick another.
+				msg->clearMessage();
+				continue;
+			}
+			msg->sendMessage(SYNTHETIC_SIM);
+			++generated;
+		}
+
+		LLMessageLog::setCallback(NULL);
+		sSyntheticWriter = NULL;
+		if (!writer->close())
+		{
+			std::cerr << "Couldn't finish writing " << filename << std::endl;
+			return 1;
+		}
+		std::cout << "Wrote " << writer->getNumWritten() << " messages to " << filename << std::endl;
+		delete writer;
+		return 0;
+	}
+
+	// About what a busy region delivers between two viewer frames.
+	const S32 PACKETS_PER_FRAME = 64;
+
+	void process_frame(LLMessageSystem* msg, S64 frame)
+	{
+		while (msg->checkMessages(frame))
+		{
+		}
+		msg->resetReceiveCounts();
+	}
+
+	bool total_time_greater(const LLMessageTemplate* a, const LLMessageTemplate* b)
+	{
+		return a->mTotalUnpackTime + a->mTotalDecodeTime > b->mTotalUnpackTime + b->mTotalDecodeTime;
+	}
+
+	int replay(LLMessageSystem* msg, const std::string& filename)
+	{
+		LLMessageCaptureReader reader;
+		if (!reader.open(filename))
+		{
+			return 1;
+		}
+
+		std::vector<LLMessageTemplate*> templates = get_templates(msg);
+		for (std::vector<LLMessageTemplate*>::iterator iter = templates.begin();
+			 iter != templates.end(); ++iter)
+		{
+			(*iter)->setHandlerFunc(process_any_message, (void**)*iter);
+		}
+		msg->setTimeDecodes(TRUE);
+		msg->setTimeDecodesSpamThreshold(1000.f);
+
+		std::set<LLHost> senders;
+		LLMessageCaptureRecord record;
+		const U8* data = NULL;
+		S64 frame = 0;
+		S32 packets = 0;
+		S32 bytes = 0;
+		LLTimer timer;
+		while (reader.next(record, data))
+		{
+			if (!record.isIncoming())
+			{
+				continue;
+			}
+			LLHost sender = record.getFrom();
+			if (senders.insert(sender).second)
+			{
+				msg->enableCircuit(sender, TRUE);
+			}
+			msg->mPacketRing.injectPacket(sender, (const char*)data, record.mSize);
+			++packets;
+			bytes += record.mSize;
+			if (packets % PACKETS_PER_FRAME == 0)
+			{
+				process_frame(msg, frame++);
+			}
+		}
+		process_frame(msg, frame++);
+		F32 elapsed = timer.getElapsedTimeF32();
+
+		std::cout << "Replayed " << packets << " packets (" << bytes << " bytes) in "
+				  << elapsed << " seconds, " << (elapsed > 0.f ? packets / elapsed : 0.f)
+				  << " packets/sec" << std::endl << std::endl;
+
+		std::sort(templates.begin(), templates.end(), total_time_greater);
+		std::cout << llformat("%35s%10s%12s%12s%10s", "Message", "Count", "Unpack ms", "Handler ms", "us/msg") << std::endl;
+		for (std::vector<LLMessageTemplate*>::iterator iter = templates.begin();
+			 iter != templates.end(); ++iter)
+		{
+			const LLMessageTemplate* mt = *iter;
+			if (mt->mTotalDecoded > 0)
+			{
+				std::cout << llformat("%35s%10u%12.3f%12.3f%10.2f", mt->mName, mt->mTotalDecoded,
+									  mt->mTotalUnpackTime * 1000.f, mt->mTotalDecodeTime * 1000.f,
+									  (mt->mTotalUnpackTime + mt->mTotalDecodeTime) * 1000000.f / mt->mTotalDecoded)
+						  << std::endl;
+			}
+		}
+		return 0;
+	}
+
+	void usage()
+	{
+		std::cerr << "usage: llmessagereplay [-t message_template.msg] <capture>" << std::endl
+				  << "       llmessagereplay [-t message_template.msg] --generate <capture> <count>" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	std::string template_file = "message_template.msg";
+	std::string capture_file;
+	S32 generate_count = 0;
+	for (S32 i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-t" && i + 1 < argc)
+		{
+			template_file = argv[++i];
+		}
+		else if (arg == "--generate" && i + 2 < argc)
+		{
+			capture_file = argv[++i];
+			generate_count = atoi(argv[++i]);
+		}
+		else if (capture_file.empty())
+		{
+			capture_file = arg;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (capture_file.empty())
+	{
+		usage();
+		return 1;
+	}
+
+	if (!start_messaging_system(template_file, 0, 1, 0, 0, FALSE, std::string(), NULL, false, 5.f, 180.f))
+	{
+		std::cerr << "Unable to start the message system with " << template_file << std::endl;
+		return 1;
+	}
+	// Nothing goes out on the wire and only the capture comes in.
+	gMessageSystem->mPacketRing.setReplayMode(TRUE);
+
+	int rv = generate_count > 0
+		? generate(gMessageSystem, capture_file, generate_count)
+		: replay(gMessageSystem, capture_file);
+
+	end_messaging_system(false);
+	return rv;
+}
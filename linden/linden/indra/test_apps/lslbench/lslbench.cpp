@@ -0,0 +1,477 @@
+/**
+ * @file lslbench.cpp
+ * @brief Compiles LSL scripts, runs them with and without the decoded
+ * interpreter, checks they end up the same and reports the speed of both.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+// Usage:
+//   lslbench [-r repeats] [-s timer_check_skip] <script.lsl> ...
+//     Compiles each script to LSL2 bytecode and runs it until it has no
+//     more work to do, once one instruction at a time as before and once
+//     through LLScriptDecodedCode. Fails if the two runs end with different
+//     memory, registers, faults or instruction counts, then reports the
+//     time each took, best of repeats.
+//   lslbench [-r repeats] -c count [-k kilobytes]
+//     Generates count scripts of about kilobytes (default 64) each and
+//     reports how long compiling them takes and how many allocations it
+//     makes, best of repeats. Then compiles them all again on an
+//     LLScriptCompileThread, reporting how long the calling thread was
+//     busy for.
+//
+// The benchmark suite is in scripts/. Library calls are stubs outside the
+// simulator, so scripts should keep to the language itself. Generated
+// scripts are too big to fit in a script's memory, so they fail right at
+// the end, once all the passes have run.
+
+#include "linden_common.h"
+
+#include <iostream>
+
+#include "llerrorcontrol.h"
+#include "lltimer.h"
+#include "lscript_compile_thread.h"
+#include "lscript_execute.h"
+#include "lscript_rt_interface.h"
+
+// Counts every allocation, for the compile benchmark.
+namespace
+{
+	U64 sNumAllocations = 0;
+	U64 sAllocatedBytes = 0;
+}
+
+void* operator new(size_t size)
+{
+	++sNumAllocations;
+	sAllocatedBytes += size;
+	void* p = malloc(size ? size : 1);
+	if (!p)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void operator delete(void* p) throw()
+{
+	free(p);
+}
+
+void operator delete[](void* p) throw()
+{
+	free(p);
+}
+
+namespace
+{
+	// Long enough for the timer never to cut a run short, which would make
+	// the instruction counts depend on the speed of the machine.
+	const F32 QUANTA = 1000.f;
+	// Gives up on scripts that never finish.
+	const S32 MAX_QUANTA = 100000;
+
+	struct Result
+	{
+		std::vector<U8> mMemory;
+		U32 mInstructions;
+		std::string mError;
+		F64 mSeconds;
+	};
+
+	BOOL read_file(const std::string& filename, std::vector<U8>& data)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (!fp)
+		{
+			return FALSE;
+		}
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		data.resize(size > 0 ? size : 0);
+		BOOL ok = size > 0 && fread(&data[0], 1, size, fp) == (size_t)size;
+		fclose(fp);
+		return ok;
+	}
+
+	// Runs the script from the start until it is waiting for events that
+	// will never come, or faults.
+	void run(const std::vector<U8>& bytecode, BOOL decoded, Result& result)
+	{
+		LLScriptExecuteLSL2::setUseDecodedCode(decoded);
+		LLScriptExecuteLSL2 execute(&bytecode[0], (U32)bytecode.size());
+
+		const char* error = NULL;
+		U32 events_processed = 0;
+		LLTimer timer;
+		for (S32 i = 0; i < MAX_QUANTA; ++i)
+		{
+			U32 instructions = execute.mInstructionCount;
+			LLTimer quanta_timer;
+			execute.runQuanta(FALSE, LLUUID::null, &error, QUANTA, events_processed, quanta_timer);
+			if (error || execute.mInstructionCount == instructions)
+			{
+				break;
+			}
+		}
+		result.mSeconds = timer.getElapsedTimeF64();
+
+		result.mMemory.assign(execute.mBuffer, execute.mBuffer + TOP_OF_MEMORY);
+		result.mInstructions = execute.mInstructionCount;
+		result.mError = error ? error : "";
+	}
+
+	// Best of repeats.
+	void time(const std::vector<U8>& bytecode, BOOL decoded, S32 repeats, Result& result)
+	{
+		run(bytecode, decoded, result);
+		for (S32 i = 1; i < repeats; ++i)
+		{
+			Result again;
+			run(bytecode, decoded, again);
+			result.mSeconds = llmin(result.mSeconds, again.mSeconds);
+		}
+	}
+
+	S32 first_difference(const std::vector<U8>& a, const std::vector<U8>& b)
+	{
+		for (S32 i = 0; i < (S32)a.size(); ++i)
+		{
+			if (a[i] != b[i])
+			{
+				return i;
+			}
+		}
+		return -1;
+	}
+
+	// Big scripts in the style of the ones people actually write: lots of
+	// globals, helper functions calling each other and library calls, and
+	// a few states with event handlers.
+	std::string generate_script(S32 seed, S32 target_size)
+	{
+		static const char* types[] = { "integer", "float", "string", "vector", "list" };
+		static const char* values[] = { "42", "1.5", "\"hello\"", "<1.0, 2.0, 3.0>", "[1, \"two\", 3.0]" };
+		const S32 num_types = LL_ARRAY_SIZE(types);
+		U32 rand = seed * 2654435761U + 1;
+	#define NEXT(n) ((rand = rand * 1103515245U + 12345U) >> 16) % (n)
+
+		std::ostringstream script;
+		const S32 num_globals = 150;
+		for (S32 i = 0; i < num_globals; ++i)
+		{
+			script << types[i % num_types] << " g" << i << " = " << values[i % num_types] << ";\n";
+		}
+
+		S32 num_functions = 0;
+		while (!num_functions || (S32)script.tellp() < target_size * 9 / 10)
+		{
+			S32 f = num_functions++;
+			script << "\ninteger f" << f << "(integer a, float b, string s)\n{\n"
+				   << "\tinteger i;\n\tfloat x = b;\n\tlist l = [a, b, s];\n"
+				   << "\tfor (i = 0; i < a; ++i)\n\t{\n"
+				   << "\t\tx += i * 0.5 - g" << NEXT(num_globals / num_types) * num_types + 1 << ";\n"
+				   << "\t\tif (x > 10.0 && (i & 3) == 1)\n\t\t{\n"
+				   << "\t\t\ts += (string)x + llGetSubString(g" << NEXT(num_globals / num_types) * num_types + 2 << ", 0, 3);\n"
+				   << "\t\t}\n\t\telse\n\t\t{\n"
+				   << "\t\t\tg" << NEXT(num_globals / num_types) * num_types << " += llStringLength(s) % 7;\n"
+				   << "\t\t}\n\t}\n"
+				   << "\tvector v = g" << NEXT(num_globals / num_types) * num_types + 3 << " * x;\n"
+				   << "\tl += [v, llVecMag(v)];\n"
+				   << "\tg" << NEXT(num_globals / num_types) * num_types + 4 << " = l + llList2List(l, 1, 2);\n";
+			if (f > 0)
+			{
+				script << "\tinteger r = f" << NEXT(f) << "(a - 1, x, s);\n"
+					   << "\twhile (r > 0)\n\t{\n\t\tr = r / 2 - f" << NEXT(f) << "(r, x * 0.5, \"\");\n\t}\n"
+					   << "\treturn r + (integer)llList2Float(l, 1);\n}\n";
+			}
+			else
+			{
+				script << "\treturn (integer)x;\n}\n";
+			}
+		}
+
+		for (S32 state = 0; (S32)script.tellp() < target_size || state < 2; ++state)
+		{
+			if (state)
+			{
+				script << "\nstate s" << state << "\n{\n";
+			}
+			else
+			{
+				script << "\ndefault\n{\n";
+			}
+			script << "\tstate_entry()\n\t{\n"
+				   << "\t\tg0 = f" << NEXT(num_functions) << "(3, 1.0, \"state\");\n"
+				   << "\t\tllSetTimerEvent(1.0);\n\t}\n\n"
+				   << "\ttouch_start(integer n)\n\t{\n"
+				   << "\t\tinteger i;\n\t\tfor (i = 0; i < n; ++i)\n\t\t{\n"
+				   << "\t\t\tg5 += f" << NEXT(num_functions) << "(i, g1, llDetectedName(i));\n"
+				   << "\t\t}\n\t}\n\n"
+				   << "\ttimer()\n\t{\n"
+				   << "\t\tif (g0 > 10)\n\t\t{\n\t\t\tstate "
+				   << (state == 0 ? "s1" : state == 1 ? "default" : llformat("s%d", state - 1)) << ";\n\t\t}\n"
+				   << "\t\tg2 = llToUpper(g2) + (string)f" << NEXT(num_functions) << "(g0, g1, g2);\n"
+				   << "\t}\n}\n";
+		}
+	#undef NEXT
+		return script.str();
+	}
+
+	class CountResponder : public LLScriptCompileThread::Responder
+	{
+	public:
+		CountResponder(S32& count) : mCount(count) {}
+		/*virtual*/ void completed(BOOL success, const std::vector<std::string>& errors)
+		{
+			mCount++;
+		}
+		S32& mCount;
+	};
+
+	int compile_benchmark(S32 count, S32 kilobytes, S32 repeats)
+	{
+		std::string dir = LLFile::tmpdir();
+		std::vector<std::string> sources;
+		std::vector<S32> sizes;
+		S32 total_size = 0;
+		for (S32 i = 0; i < count; ++i)
+		{
+			std::string text = generate_script(i, kilobytes * 1024);
+			std::string filename = dir + llformat("lslbench_%d.lsl", i);
+			LLFILE* fp = LLFile::fopen(filename, "wb");
+			if (!fp)
+			{
+				std::cerr << "Unable to write " << filename << std::endl;
+				return 1;
+			}
+			fwrite(text.c_str(), 1, text.size(), fp);
+			fclose(fp);
+			sources.push_back(filename);
+			sizes.push_back((S32)text.size());
+			total_size += (S32)text.size();
+		}
+
+		std::cout << llformat("%-24s%10s%12s%14s%14s", "Script", "KB", "Compile ms",
+							  "Allocations", "Allocated KB") << std::endl;
+		F64 total_seconds = 0.0;
+		U64 total_allocations = 0;
+		for (S32 i = 0; i < count; ++i)
+		{
+			std::string bytecode_file = sources[i] + ".lso";
+			std::string error_file = sources[i] + ".out";
+			F64 best = 0.0;
+			U64 allocations = 0;
+			U64 allocated = 0;
+			for (S32 r = 0; r < repeats; ++r)
+			{
+				U64 num_allocations = sNumAllocations;
+				U64 allocated_bytes = sAllocatedBytes;
+				LLTimer timer;
+				lscript_compile(sources[i].c_str(), bytecode_file.c_str(), error_file.c_str(),
+								FALSE, "lslbench");
+				F64 seconds = timer.getElapsedTimeF64();
+				best = r ? llmin(best, seconds) : seconds;
+				allocations = sNumAllocations - num_allocations;
+				allocated = sAllocatedBytes - allocated_bytes;
+			}
+			std::string name = sources[i].substr(dir.size());
+			std::cout << llformat("%-24s%10.1f%12.2f%14llu%14llu", name.c_str(), sizes[i] / 1024.f, best * 1000.0,
+								  allocations, allocated / 1024) << std::endl;
+			total_seconds += best;
+			total_allocations += allocations;
+			LLFile::remove(bytecode_file);
+			LLFile::remove(error_file);
+		}
+		std::cout << llformat("%-24s%10.1f%12.2f%14llu", "Total", total_size / 1024.f,
+							  total_seconds * 1000.0, total_allocations) << std::endl;
+
+		// The same again on a compile thread, timing only the calling thread.
+		LLScriptCompileThread* thread = new LLScriptCompileThread();
+		S32 delivered = 0;
+		LLTimer timer;
+		F64 caller_seconds = 0.0;
+		for (S32 i = 0; i < count; ++i)
+		{
+			thread->compile(sources[i], sources[i] + ".lso", sources[i] + ".out", FALSE, "lslbench",
+							FALSE, new CountResponder(delivered));
+		}
+		caller_seconds += timer.getElapsedTimeF64();
+		while (delivered < count)
+		{
+			ms_sleep(1);
+			LLTimer update_timer;
+			thread->update(0);
+			caller_seconds += update_timer.getElapsedTimeF64();
+		}
+		std::cout << llformat("Compile thread: %.2f ms, of which the caller spent %.2f ms",
+							  timer.getElapsedTimeF64() * 1000.0, caller_seconds * 1000.0) << std::endl;
+		thread->shutdown();
+		delete thread;
+
+		for (S32 i = 0; i < count; ++i)
+		{
+			LLFile::remove(sources[i]);
+			LLFile::remove(sources[i] + ".lso");
+			LLFile::remove(sources[i] + ".out");
+		}
+		return 0;
+	}
+
+	void usage()
+	{
+		std::cerr << "usage: lslbench [-r repeats] [-s timer_check_skip] <script.lsl> ..." << std::endl
+				  << "       lslbench [-r repeats] -c count [-k kilobytes]" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 repeats = 5;
+	S32 generate = 0;
+	S32 kilobytes = 64;
+	std::vector<std::string> scripts;
+	for (S32 i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-r" && i + 1 < argc)
+		{
+			repeats = llmax(atoi(argv[++i]), 1);
+		}
+		else if (arg == "-s" && i + 1 < argc)
+		{
+			LLScriptExecute::setTimerCheckSkip(atoi(argv[++i]));
+		}
+		else if (arg == "-c" && i + 1 < argc)
+		{
+			generate = llmax(atoi(argv[++i]), 1);
+		}
+		else if (arg == "-k" && i + 1 < argc)
+		{
+			kilobytes = llmax(atoi(argv[++i]), 1);
+		}
+		else if (!arg.empty() && arg[0] != '-')
+		{
+			scripts.push_back(arg);
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (generate)
+	{
+		return compile_benchmark(generate, kilobytes, repeats);
+	}
+	if (scripts.empty())
+	{
+		usage();
+		return 1;
+	}
+
+	std::cout << llformat("%-24s%14s%12s%12s%10s%10s", "Script", "Instructions",
+						  "Before ms", "Decoded ms", "Speedup", "Result") << std::endl;
+
+	int rv = 0;
+	F64 total_before = 0.0;
+	F64 total_decoded = 0.0;
+	for (S32 i = 0; i < (S32)scripts.size(); ++i)
+	{
+		const std::string& script = scripts[i];
+		std::string name = script;
+		std::string::size_type slash = name.find_last_of("/\\");
+		if (slash != std::string::npos)
+		{
+			name = name.substr(slash + 1);
+		}
+
+		std::string bytecode_file = script + ".lso";
+		std::string error_file = script + ".out";
+		std::vector<U8> bytecode;
+		if (!lscript_compile(script.c_str(), bytecode_file.c_str(), error_file.c_str(), FALSE, "lslbench")
+			|| !read_file(bytecode_file, bytecode))
+		{
+			std::cout << llformat("%-24s", name.c_str()) << "failed to compile, see " << error_file << std::endl;
+			rv = 1;
+			continue;
+		}
+		LLFile::remove(bytecode_file);
+		LLFile::remove(error_file);
+
+		Result before;
+		Result decoded;
+		time(bytecode, FALSE, repeats, before);
+		time(bytecode, TRUE, repeats, decoded);
+
+		std::string outcome = "same";
+		S32 difference = first_difference(before.mMemory, decoded.mMemory);
+		if (before.mInstructions != decoded.mInstructions
+			|| before.mError != decoded.mError
+			|| difference >= 0)
+		{
+			outcome = "DIFFERENT";
+			rv = 1;
+		}
+		std::cout << llformat("%-24s%14u%12.2f%12.2f%9.2fx%10s", name.c_str(), before.mInstructions,
+							  before.mSeconds * 1000.0, decoded.mSeconds * 1000.0,
+							  decoded.mSeconds > 0.0 ? before.mSeconds / decoded.mSeconds : 0.0,
+							  outcome.c_str()) << std::endl;
+		if (difference >= 0)
+		{
+			std::cout << llformat("  memory differs from 0x%X", difference) << std::endl;
+		}
+		if (before.mInstructions != decoded.mInstructions)
+		{
+			std::cout << "  " << decoded.mInstructions << " instructions decoded" << std::endl;
+		}
+		if (!before.mError.empty() || !decoded.mError.empty())
+		{
+			std::cout << "  faulted: " << before.mError << " / " << decoded.mError << std::endl;
+		}
+		total_before += before.mSeconds;
+		total_decoded += decoded.mSeconds;
+	}
+	if (total_decoded > 0.0)
+	{
+		std::cout << llformat("%-24s%14s%12.2f%12.2f%9.2fx", "Total", "",
+							  total_before * 1000.0, total_decoded * 1000.0,
+							  total_before / total_decoded) << std::endl;
+	}
+	return rv;
+}
@@ -0,0 +1,299 @@
+/**
+ * @file xuibench.cpp
+ * @brief Loads every floater in a skin from XML and from the binary cache
+ * form, checks they come out the same and reports the speed of both.
+ *
+ * $LicenseInfo:firstyear=2010&license=viewergpl$
+ *
+ * Copyright (c) 2010, Linden Research, Inc.
+ *
+ * Second Life Viewer Source Code
+ * The source code in this file ("Source Code") is provided by Linden Lab
+ * to you under the terms of the GNU General Public License, version 2.0
+ * ("GPL"), unless you have obtained a separate licensing agreement
+ * ("Other License"), formally executed by you and Linden Lab.  Terms of
+ * the GPL can be found in doc/GPL-license.txt in this distribution, or
+ * online at http://secondlifegrid.net/programs/open_source/licensing/gplv2
+ *
+ * There are special exceptions to the terms and conditions of the GPL as
+ * it is applied to this Source Code. View the full text of the exception
+ * in the file doc/FLOSS-exception.txt in this software distribution, or
+ * online at
+ * http://secondlifegrid.net/programs/open_source/licensing/flossexception
+ *
+ * By copying, modifying or distributing this software, you acknowledge
+ * that you have read and understood your obligations described above,
+ * and agree to abide by those obligations.
+ *
+ * ALL LINDEN LAB SOURCE CODE IS PROVIDED "AS IS." LINDEN LAB MAKES NO
+ * WARRANTIES, EXPRESS, IMPLIED OR OTHERWISE, REGARDING ITS ACCURACY,
+ * COMPLETENESS OR PERFORMANCE.
+ * $/LicenseInfo$
+ */
+
+
+// Usage:
+//   xuibench [-r repeats] [-l language] <xui directory>
+//     Loads every floater_*.xml in the en-us directory under the given one
+//     (skins/default/xui in the viewer), with the language's version merged
+//     on top when there is one, the way LLUICtrlFactory::getLayeredXMLNode()
+//     does. Then loads each again from its LLXMLNode::writeBinary() form.
+//     Fails if the two trees differ, then reports how long each way took,
+//     best of repeats, and how long the attribute reads of building the
+//     widgets take on top. Files are read into memory first, so only
+//     parsing is timed.
+//
+// Building the widgets themselves needs a GL context and fonts, so the
+// attribute reads are the ones LLView::initFromXML() and createRect()
+// do for every widget.
+
+#include "linden_common.h"
+
+#include <iostream>
+
+#include "lldir.h"
+#include "llerrorcontrol.h"
+#include "lltimer.h"
+#include "llxmlnode.h"
+
+namespace
+{
+	struct Layers
+	{
+		std::string mName;
+		std::vector<std::string> mContents;
+		std::vector<U8> mBinary;
+	};
+
+	BOOL read_file(const std::string& filename, std::string& contents)
+	{
+		LLFILE* fp = LLFile::fopen(filename, "rb");
+		if (!fp)
+		{
+			return FALSE;
+		}
+		fseek(fp, 0, SEEK_END);
+		long size = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		contents.resize(size > 0 ? size : 0);
+		BOOL ok = size > 0 && fread(&contents[0], 1, size, fp) == (size_t)size;
+		fclose(fp);
+		return ok;
+	}
+
+	BOOL parse_layers(const Layers& layers, LLXMLNodePtr& root)
+	{
+		if (!LLXMLNode::parseBuffer(layers.mContents[0].data(), layers.mContents[0].length(), root, NULL))
+		{
+			return FALSE;
+		}
+		for (U32 i = 1; i < layers.mContents.size(); i++)
+		{
+			LLXMLNodePtr update;
+			if (!LLXMLNode::parseBuffer(layers.mContents[i].data(), layers.mContents[i].length(), update, NULL))
+			{
+				return FALSE;
+			}
+			std::string name;
+			std::string update_name;
+			root->getAttributeString("name", name);
+			update->getAttributeString("name", update_name);
+			if (name == update_name)
+			{
+				LLXMLNode::updateNode(root, update);
+			}
+		}
+		return TRUE;
+	}
+
+	// What building a widget reads, whatever kind it is.
+	S32 read_attributes(LLXMLNodePtr node)
+	{
+		std::string str;
+		S32 value = 0;
+		BOOL flag = FALSE;
+		S32 found = 0;
+		found += node->getAttributeString("name", str);
+		found += node->getAttributeString("rect_control", str);
+		found += node->getAttributeS32("left", value);
+		found += node->getAttributeS32("bottom", value);
+		found += node->getAttributeS32("width", value);
+		found += node->getAttributeS32("height", value);
+		found += node->getAttributeS32("left_delta", value);
+		found += node->getAttributeS32("bottom_delta", value);
+		found += node->getAttributeString("control_name", str);
+		found += node->getAttributeString("tool_tip", str);
+		found += node->getAttributeBOOL("enabled", flag);
+		found += node->getAttributeBOOL("visible", flag);
+		found += node->getAttributeBOOL("mouse_opaque", flag);
+		found += node->getAttributeString("follows", str);
+		found += node->getAttributeString("font", str);
+		found += node->getAttributeString("halign", str);
+		found += node->getAttributeString("label", str);
+		for (LLXMLNodePtr child = node->getFirstChild(); child.notNull(); child = child->getNextSibling())
+		{
+			found += read_attributes(child);
+		}
+		return found;
+	}
+
+	std::string to_string(LLXMLNodePtr node)
+	{
+		std::ostringstream str;
+		node->writeToOstream(str);
+		return str.str();
+	}
+
+	void usage()
+	{
+		std::cerr << "usage: xuibench [-r repeats] [-l language] <xui directory>" << std::endl;
+	}
+}
+
+int main(int argc, char** argv)
+{
+	LLError::initForApplication(".");
+	LLError::setDefaultLevel(LLError::LEVEL_WARN);
+
+	S32 repeats = 5;
+	std::string language;
+	std::string xui_dir;
+	for (S32 i = 1; i < argc; ++i)
+	{
+		std::string arg = argv[i];
+		if (arg == "-r" && i + 1 < argc)
+		{
+			repeats = llmax(atoi(argv[++i]), 1);
+		}
+		else if (arg == "-l" && i + 1 < argc)
+		{
+			language = argv[++i];
+		}
+		else if (!arg.empty() && arg[0] != '-' && xui_dir.empty())
+		{
+			xui_dir = arg;
+		}
+		else
+		{
+			usage();
+			return 1;
+		}
+	}
+	if (xui_dir.empty())
+	{
+		usage();
+		return 1;
+	}
+
+	const std::string delim = gDirUtilp->getDirDelimiter();
+	const std::string base_dir = xui_dir + delim + "en-us";
+	std::vector<Layers> files;
+	std::string filename;
+	while (gDirUtilp->getNextFileInDir(base_dir, delim + "floater_*.xml", filename, FALSE))
+	{
+		Layers layers;
+		layers.mName = filename;
+		layers.mContents.resize(1);
+		LLXMLNodePtr root;
+		if (!read_file(base_dir + delim + filename, layers.mContents[0])
+			|| !parse_layers(layers, root))
+		{
+			// The viewer can't load these either.
+			std::cerr << "Skipping " << filename << ", it does not parse" << std::endl;
+			continue;
+		}
+		std::string localized;
+		if (!language.empty() && read_file(xui_dir + delim + language + delim + filename, localized))
+		{
+			layers.mContents.push_back(localized);
+		}
+		files.push_back(layers);
+	}
+	if (files.empty())
+	{
+		std::cerr << "No floaters in " << base_dir << std::endl;
+		return 1;
+	}
+
+	int rv = 0;
+	U64 xml_size = 0;
+	U64 binary_size = 0;
+	S32 num_layered = 0;
+	for (U32 i = 0; i < files.size(); i++)
+	{
+		LLXMLNodePtr parsed;
+		if (!parse_layers(files[i], parsed))
+		{
+			std::cerr << files[i].mName << " does not parse with its " << language << " layer" << std::endl;
+			rv = 1;
+			continue;
+		}
+		parsed->writeBinary(files[i].mBinary);
+		LLXMLNodePtr loaded;
+		if (!LLXMLNode::parseBinary(&files[i].mBinary[0], (U32)files[i].mBinary.size(), loaded)
+			|| to_string(loaded) != to_string(parsed))
+		{
+			std::cerr << files[i].mName << " differs when loaded from binary" << std::endl;
+			rv = 1;
+		}
+		for (U32 j = 0; j < files[i].mContents.size(); j++)
+		{
+			xml_size += files[i].mContents[j].length();
+		}
+		binary_size += files[i].mBinary.size();
+		num_layered += files[i].mContents.size() > 1 ? 1 : 0;
+	}
+	if (rv)
+	{
+		return rv;
+	}
+
+	F64 best_xml = 0.0;
+	F64 best_binary = 0.0;
+	F64 best_attributes = 0.0;
+	S32 num_attributes = 0;
+	LLTimer timer;
+	for (S32 r = 0; r < repeats; r++)
+	{
+		timer.reset();
+		for (U32 i = 0; i < files.size(); i++)
+		{
+			LLXMLNodePtr root;
+			parse_layers(files[i], root);
+		}
+		F64 xml = timer.getElapsedTimeF64();
+
+		std::vector<LLXMLNodePtr> roots(files.size());
+		timer.reset();
+		for (U32 i = 0; i < files.size(); i++)
+		{
+			LLXMLNode::parseBinary(&files[i].mBinary[0], (U32)files[i].mBinary.size(), roots[i]);
+		}
+		F64 binary = timer.getElapsedTimeF64();
+
+		timer.reset();
+		num_attributes = 0;
+		for (U32 i = 0; i < roots.size(); i++)
+		{
+			num_attributes += read_attributes(roots[i]);
+		}
+		F64 attributes = timer.getElapsedTimeF64();
+
+		best_xml = r ? llmin(best_xml, xml) : xml;
+		best_binary = r ? llmin(best_binary, binary) : binary;
+		best_attributes = r ? llmin(best_attributes, attributes) : attributes;
+	}
+
+	std::cout << files.size() << " floaters, ";
+	if (!language.empty())
+	{
+		std::cout << num_layered << " with a " << language << " layer, ";
+	}
+	std::cout << num_attributes << " attributes read" << std::endl;
+	std::cout << llformat("%-10s%10s%12s%12s", "", "KB", "Load ms", "+Attrs ms") << std::endl;
+	std::cout << llformat("%-10s%10.1f%12.2f%12.2f", "XML", xml_size / 1024.0, best_xml * 1000.0,
+						  (best_xml + best_attributes) * 1000.0) << std::endl;
+	std::cout << llformat("%-10s%10.1f%12.2f%12.2f", "Binary", binary_size / 1024.0, best_binary * 1000.0,
+						  (best_binary + best_attributes) * 1000.0) << std::endl;
+	return 0;
+}